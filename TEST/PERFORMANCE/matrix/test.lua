@@ -375,3 +375,33 @@ T("CONVOLUTION 2D TEST", function()
       end))
     end
 end)
+
+-----------------------------------------------------------------------------
+
+T("SIMD 1D TEST", function()
+    local best = mathcore.get_simd_level()
+    local ops = {
+      { "EXP",  function(m,m2,dest) dest:copy(m):exp() end },
+      { "LOG",  function(m,m2,dest) dest:copy(m2):log() end },
+      { "TANH", function(m,m2,dest) dest:copy(m):tanh() end },
+      { "CMUL", function(m,m2,dest) dest:copy(m):cmul(m2) end },
+      { "SUM",  function(m) m:sum() end },
+      { "MAX",  function(m) m:max(1) end },
+    }
+    for _,op in ipairs(ops) do
+      local name,func = table.unpack(op)
+      printf("\t%s (none vs %s)\n", name, best)
+      for i=3,7 do
+        local N = 10^i
+        local m = matrix(N):uniformf(-1,1,rnd)
+        local m2 = matrix(N):uniformf(0.1,1,rnd)
+        local dest = matrix(N)
+        mathcore.set_simd_level("none")
+        local a = measure_process_time(func, m, m2, dest)
+        mathcore.set_simd_level(best)
+        local b = measure_process_time(func, m, m2, dest)
+        printf("\tsize=%10d  %s  %20.9f  %20.9f  speedup=%.2f\n",
+               m:size(), "1D", a, b, a/b)
+      end
+    end
+end)
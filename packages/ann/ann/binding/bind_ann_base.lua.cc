@@ -20,6 +20,7 @@
  *
  */
 //BIND_HEADER_C
+#include <cmath>
 #include <typeinfo>
 
 #include "bind_function_interface.h"
@@ -47,6 +48,28 @@ namespace ANN {
     return false;
   }
 
+  /// Returns the PhiloxRand at field "random" of the table at index n, or
+  /// NULL if the field is not a PhiloxRand object.
+  static Basics::PhiloxRand *getPhiloxField(lua_State *L, int n) {
+    Basics::PhiloxRand *philox = 0;
+    lua_getfield(L, n, "random");
+    if (lua_isPhiloxRand(L, -1)) philox = lua_toPhiloxRand(L, -1);
+    lua_pop(L, 1);
+    return philox;
+  }
+
+  /// Returns the node identifier of a GraphANNComponent at index n, which is
+  /// 1-based in Lua, or one of the strings 'input' or 'output'.
+  static int lua_toGraphNode(lua_State *L, int n) {
+    if (lua_type(L, n) == LUA_TSTRING) {
+      const char *str = lua_tostring(L, n);
+      if (!strcmp(str, "input")) return GraphANNComponent::INPUT_NODE;
+      if (!strcmp(str, "output")) return GraphANNComponent::OUTPUT_NODE;
+      LUABIND_FERROR1("Incorrect node name %s\n", str);
+    }
+    return luaL_checkint(L, n) - 1;
+  }
+
   static void unwrapToDim1(AprilUtils::SharedPtr<Token> &tk) {
     if (tk->getTokenCode() == table_of_token_codes::token_matrix) {
       Basics::TokenMatrixFloat *tk_mat = tk->convertTo<Basics::TokenMatrixFloat*>();
@@ -66,6 +89,15 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value) {
   else if (typeid(*value) == typeid(JoinANNComponent)) {
     lua_pushJoinANNComponent(L, (JoinANNComponent*)value);
   }
+  else if (typeid(*value) == typeid(GraphANNComponent)) {
+    lua_pushGraphANNComponent(L, (GraphANNComponent*)value);
+  }
+  else if (typeid(*value) == typeid(LSTMANNComponent)) {
+    lua_pushLSTMANNComponent(L, (LSTMANNComponent*)value);
+  }
+  else if (typeid(*value) == typeid(GRUANNComponent)) {
+    lua_pushGRUANNComponent(L, (GRUANNComponent*)value);
+  }
   else if (dynamic_cast<ActivationFunctionANNComponent*>(value)) {
     lua_pushActivationFunctionANNComponent(L, (ActivationFunctionANNComponent*)value);
   }
@@ -99,17 +131,22 @@ IMPLEMENT_LUA_TABLE_BIND_SPECIALIZATION(ANNComponent);
 #include "batch_standardization_component.h"
 #include "bias_component.h"
 #include "bind_function_interface.h"
+#include "class_softmax_component.h"
 #include "connection.h"
 #include "const_component.h"
 #include "convolution_bias_component.h"
 #include "convolution_component.h"
 #include "copy_component.h"
+#include "data_parallel_component.h"
 #include "dot_product_component.h"
 #include "dropout_component.h"
+#include "ensemble_component.h"
 #include "error_print.h"
 #include "exp_actf_component.h"
 #include "flatten_component.h"
 #include "gaussian_noise_component.h"
+#include "graph_component.h"
+#include "gru_component.h"
 #include "hardtanh_actf_component.h"
 #include "hyperplane_component.h"
 #include "join_component.h"
@@ -119,8 +156,11 @@ IMPLEMENT_LUA_TABLE_BIND_SPECIALIZATION(ANNComponent);
 #include "log_logistic_actf_component.h"
 #include "log_softmax_actf_component.h"
 #include "logistic_actf_component.h"
+#include "lstm_component.h"
 #include "maxpooling_component.h"
 #include "mul_component.h"
+#include "nce_component.h"
+#include "omp_utils.h"
 #include "prelu_actf_component.h"
 #include "probabilistic_matrix_component.h"
 #include "pca_whitening_component.h"
@@ -128,6 +168,7 @@ IMPLEMENT_LUA_TABLE_BIND_SPECIALIZATION(ANNComponent);
 #include "rewrap_component.h"
 #include "salt_and_pepper_component.h"
 #include "select_component.h"
+#include "sequence_recurrent_component.h"
 #include "sin_actf_component.h"
 #include "slice_component.h"
 #include "softmax_actf_component.h"
@@ -318,6 +359,36 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
 }
 //BIND_END
 
+//BIND_FUNCTION ann.set_memory_planning
+{
+  bool v;
+  LUABIND_CHECK_ARGN(==, 1);
+  LUABIND_GET_PARAMETER(1, bool, v);
+  ANNComponent::setMemoryPlanning(v);
+}
+//BIND_END
+
+//BIND_FUNCTION ann.get_memory_planning
+{
+  LUABIND_RETURN(bool, ANNComponent::getMemoryPlanning());
+}
+//BIND_END
+
+//BIND_FUNCTION ann.set_inter_op_parallelism
+{
+  bool v;
+  LUABIND_CHECK_ARGN(==, 1);
+  LUABIND_GET_PARAMETER(1, bool, v);
+  ANNComponent::setInterOpParallelism(v);
+}
+//BIND_END
+
+//BIND_FUNCTION ann.get_inter_op_parallelism
+{
+  LUABIND_RETURN(bool, ANNComponent::getInterOpParallelism());
+}
+//BIND_END
+
 //BIND_FUNCTION ann.inc_names_id_counter
 {
   ANNComponent::incNamesIdCounter();
@@ -516,6 +587,12 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
 }
 //BIND_END
 
+//BIND_METHOD ANNComponent get_in_place
+{
+  LUABIND_RETURN(bool, obj->getInPlace());
+}
+//BIND_END
+
 //BIND_METHOD ANNComponent build
 {
   LUABIND_CHECK_ARGN(<=, 1);
@@ -634,6 +711,106 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
 }
 //BIND_END
 
+/////////////////////////////////////////////////////
+//            ClassSoftmaxANNComponent             //
+/////////////////////////////////////////////////////
+
+//BIND_LUACLASSNAME ClassSoftmaxANNComponent ann.components.class_softmax
+//BIND_CPP_CLASS    ClassSoftmaxANNComponent
+//BIND_SUBCLASS_OF  ClassSoftmaxANNComponent ANNComponent
+
+//BIND_CONSTRUCTOR ClassSoftmaxANNComponent
+{
+  LUABIND_CHECK_ARGN(==, 1);
+  LUABIND_CHECK_PARAMETER(1, table);
+  check_table_fields(L, 1, "name", "weights", "input", "vocab", "classes",
+                     "matrix", (const char *)0);
+  const char *name=0, *weights_name=0;
+  unsigned int input_size=0, vocab_size, num_classes;
+  MatrixFloat *matrix = 0;
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, name, string, name, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, weights, string, weights_name, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, input, uint, input_size, 0);
+  LUABIND_GET_TABLE_PARAMETER(1, vocab, uint, vocab_size);
+  LUABIND_GET_TABLE_PARAMETER(1, classes, uint, num_classes);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, matrix, MatrixFloat, matrix, 0);
+  obj = new ClassSoftmaxANNComponent(vocab_size, num_classes,
+                                     name, weights_name,
+                                     input_size, matrix);
+  LUABIND_RETURN(ClassSoftmaxANNComponent, obj);
+}
+//BIND_END
+
+//BIND_METHOD ClassSoftmaxANNComponent clone
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  int argn = lua_gettop(L);
+  AprilUtils::LuaTable copies;
+  if (argn == 1) {
+    copies = AprilUtils::LuaTable(L,1);
+  }
+  LUABIND_RETURN(ClassSoftmaxANNComponent,
+		 dynamic_cast<ClassSoftmaxANNComponent*>(obj->clone(copies)));
+}
+//BIND_END
+
+//BIND_METHOD ClassSoftmaxANNComponent get_word_class
+{
+  unsigned int w;
+  LUABIND_GET_PARAMETER(1, uint, w);
+  if (w < 1 || w > obj->getVocabSize()) {
+    LUABIND_FERROR1("Word index out-of-bounds: %u", w);
+  }
+  LUABIND_RETURN(uint, obj->getWordClass(w-1) + 1);
+}
+//BIND_END
+
+/////////////////////////////////////////////////////
+//                 NCEANNComponent                 //
+/////////////////////////////////////////////////////
+
+//BIND_LUACLASSNAME NCEANNComponent ann.components.nce
+//BIND_CPP_CLASS    NCEANNComponent
+//BIND_SUBCLASS_OF  NCEANNComponent ANNComponent
+
+//BIND_CONSTRUCTOR NCEANNComponent
+{
+  LUABIND_CHECK_ARGN(==, 1);
+  LUABIND_CHECK_PARAMETER(1, table);
+  check_table_fields(L, 1, "name", "weights", "input", "vocab", "samples",
+                     "noise", "random", "matrix", (const char *)0);
+  const char *name=0, *weights_name=0;
+  unsigned int input_size=0, vocab_size, num_samples;
+  MatrixFloat *noise = 0, *matrix = 0;
+  Basics::MTRand *random = 0;
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, name, string, name, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, weights, string, weights_name, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, input, uint, input_size, 0);
+  LUABIND_GET_TABLE_PARAMETER(1, vocab, uint, vocab_size);
+  LUABIND_GET_TABLE_PARAMETER(1, samples, uint, num_samples);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, noise, MatrixFloat, noise, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, random, MTRand, random, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, matrix, MatrixFloat, matrix, 0);
+  if (!random) random = new Basics::MTRand();
+  obj = new NCEANNComponent(vocab_size, num_samples, random, noise,
+                            name, weights_name, input_size, matrix);
+  LUABIND_RETURN(NCEANNComponent, obj);
+}
+//BIND_END
+
+//BIND_METHOD NCEANNComponent clone
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  int argn = lua_gettop(L);
+  AprilUtils::LuaTable copies;
+  if (argn == 1) {
+    copies = AprilUtils::LuaTable(L,1);
+  }
+  LUABIND_RETURN(NCEANNComponent,
+		 dynamic_cast<NCEANNComponent*>(obj->clone(copies)));
+}
+//BIND_END
+
 /////////////////////////////////////////////////////
 //         ProbabilisticMatrixANNComponent         //
 /////////////////////////////////////////////////////
@@ -1075,6 +1252,304 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
 }
 //BIND_END
 
+/////////////////////////////////////////////////////
+//               GraphANNComponent                 //
+/////////////////////////////////////////////////////
+
+//BIND_LUACLASSNAME GraphANNComponent ann.components.graph_engine
+//BIND_CPP_CLASS    GraphANNComponent
+//BIND_SUBCLASS_OF  GraphANNComponent ANNComponent
+
+//BIND_CONSTRUCTOR GraphANNComponent
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  int argn = lua_gettop(L);
+  const char *name=0;
+  double backstep=HUGE_VAL;
+  if (argn == 1) {
+    LUABIND_CHECK_PARAMETER(1, table);
+    check_table_fields(L, 1, "name", "backstep", (const char *)0);
+    LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, name, string, name, 0);
+    LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, backstep, double, backstep,
+                                         HUGE_VAL);
+  }
+  obj = new GraphANNComponent(name, (backstep < UINT_MAX) ?
+                              static_cast<unsigned int>(backstep) :
+                              GraphANNComponent::UNTRUNCATED);
+  LUABIND_RETURN(GraphANNComponent, obj);
+}
+//BIND_END
+
+//BIND_METHOD GraphANNComponent add_component
+{
+  LUABIND_CHECK_ARGN(==, 1);
+  ANNComponent *component;
+  LUABIND_GET_PARAMETER(1, ANNComponent, component);
+  LUABIND_RETURN(int, obj->addComponent(component) + 1);
+}
+//BIND_END
+
+//BIND_METHOD GraphANNComponent add_operation
+{
+  LUABIND_CHECK_ARGN(==, 1);
+  LUABIND_CHECK_PARAMETER(1, table);
+  check_table_fields(L, 1, "op", "name", "input", "output", "index",
+                     (const char *)0);
+  const char *op_str, *name;
+  unsigned int input, output, index;
+  LUABIND_GET_TABLE_PARAMETER(1, op, string, op_str);
+  LUABIND_GET_TABLE_PARAMETER(1, name, string, name);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, input, uint, input, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, output, uint, output, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, index, uint, index, 1);
+  GraphANNComponent::NodeOp op;
+  if (!strcmp(op_str, "identity")) op = GraphANNComponent::IDENTITY_OP;
+  else if (!strcmp(op_str, "bind")) op = GraphANNComponent::BIND_OP;
+  else if (!strcmp(op_str, "add")) op = GraphANNComponent::ADD_OP;
+  else if (!strcmp(op_str, "cmul")) op = GraphANNComponent::CMUL_OP;
+  else if (!strcmp(op_str, "index")) op = GraphANNComponent::INDEX_OP;
+  else {
+    LUABIND_FERROR1("Unknown operation %s\n", op_str);
+    op = GraphANNComponent::IDENTITY_OP;
+  }
+  if (index < 1) LUABIND_ERROR("Index should be >= 1\n");
+  LUABIND_RETURN(int, obj->addOperation(op, name, input, output,
+                                        index - 1) + 1);
+}
+//BIND_END
+
+//BIND_METHOD GraphANNComponent connect
+{
+  LUABIND_CHECK_ARGN(>=, 2);
+  LUABIND_CHECK_ARGN(<=, 3);
+  unsigned int delay;
+  int src = lua_toGraphNode(L, 1);
+  int dst = lua_toGraphNode(L, 2);
+  LUABIND_GET_OPTIONAL_PARAMETER(3, uint, delay, 0);
+  obj->connect(src, dst, delay);
+  LUABIND_RETURN(GraphANNComponent, obj);
+}
+//BIND_END
+
+//BIND_METHOD GraphANNComponent get_num_nodes
+{
+  LUABIND_RETURN(uint, obj->getNumNodes());
+}
+//BIND_END
+
+//BIND_METHOD GraphANNComponent get_is_recurrent
+{
+  LUABIND_RETURN(bool, obj->getIsRecurrent());
+}
+//BIND_END
+
+//BIND_METHOD GraphANNComponent get_bptt_step
+{
+  LUABIND_RETURN(uint, obj->getBPTTStep());
+}
+//BIND_END
+
+//BIND_METHOD GraphANNComponent get_bptt_truncation
+{
+  if (obj->getBPTTTruncation() == GraphANNComponent::UNTRUNCATED) {
+    LUABIND_RETURN(double, HUGE_VAL);
+  }
+  else {
+    LUABIND_RETURN(uint, obj->getBPTTTruncation());
+  }
+}
+//BIND_END
+
+//BIND_METHOD GraphANNComponent set_bptt_truncation
+{
+  LUABIND_CHECK_ARGN(==, 1);
+  double backstep;
+  LUABIND_GET_PARAMETER(1, double, backstep);
+  obj->setBPTTTruncation((backstep < UINT_MAX) ?
+                         static_cast<unsigned int>(backstep) :
+                         GraphANNComponent::UNTRUNCATED);
+  LUABIND_RETURN(GraphANNComponent, obj);
+}
+//BIND_END
+
+//BIND_METHOD GraphANNComponent bptt_backprop
+{
+  AprilUtils::vector< AprilUtils::SharedPtr<Token> > result;
+  obj->bpttBackprop(result);
+  LuaTable t(L);
+  for (unsigned int i=0; i<result.size(); ++i) {
+    t.put(static_cast<int>(i+1), result[i]);
+  }
+  LUABIND_RETURN(LuaTable, t);
+}
+//BIND_END
+
+//BIND_METHOD GraphANNComponent get_bptt_state
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  unsigned int step;
+  LUABIND_GET_OPTIONAL_PARAMETER(1, uint, step, obj->getBPTTStep());
+  LuaTable t(L);
+  obj->copyBPTTState(step, t);
+  LUABIND_RETURN(LuaTable, t);
+}
+//BIND_END
+
+//BIND_METHOD GraphANNComponent clone
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  int argn = lua_gettop(L);
+  AprilUtils::LuaTable copies;
+  if (argn == 1) {
+    copies = AprilUtils::LuaTable(L,1);
+  }
+  LUABIND_RETURN(GraphANNComponent,
+		 dynamic_cast<GraphANNComponent*>(obj->clone(copies)));
+}
+//BIND_END
+
+/////////////////////////////////////////////////////
+//        SequenceRecurrentANNComponent            //
+/////////////////////////////////////////////////////
+
+//BIND_LUACLASSNAME SequenceRecurrentANNComponent ann.components.sequence_recurrent
+//BIND_CPP_CLASS    SequenceRecurrentANNComponent
+//BIND_SUBCLASS_OF  SequenceRecurrentANNComponent ANNComponent
+
+//BIND_CONSTRUCTOR SequenceRecurrentANNComponent
+{
+  LUABIND_ERROR("Abstract class!!!");
+}
+//BIND_END
+
+//BIND_METHOD SequenceRecurrentANNComponent get_bptt_truncation
+{
+  LUABIND_RETURN(uint, obj->getBPTTTruncation());
+}
+//BIND_END
+
+//BIND_METHOD SequenceRecurrentANNComponent set_bptt_truncation
+{
+  unsigned int bptt_truncation;
+  LUABIND_CHECK_ARGN(==, 1);
+  LUABIND_GET_PARAMETER(1, uint, bptt_truncation);
+  obj->setBPTTTruncation(bptt_truncation);
+  LUABIND_RETURN(SequenceRecurrentANNComponent, obj);
+}
+//BIND_END
+
+//BIND_METHOD SequenceRecurrentANNComponent get_input_units
+{
+  LUABIND_RETURN(uint, obj->getInputUnits());
+}
+//BIND_END
+
+//BIND_METHOD SequenceRecurrentANNComponent get_hidden_units
+{
+  LUABIND_RETURN(uint, obj->getHiddenUnits());
+}
+//BIND_END
+
+/////////////////////////////////////////////////////
+//                LSTMANNComponent                 //
+/////////////////////////////////////////////////////
+
+//BIND_LUACLASSNAME LSTMANNComponent ann.components.lstm
+//BIND_CPP_CLASS    LSTMANNComponent
+//BIND_SUBCLASS_OF  LSTMANNComponent SequenceRecurrentANNComponent
+
+//BIND_CONSTRUCTOR LSTMANNComponent
+{
+  LUABIND_CHECK_ARGN(==, 1);
+  LUABIND_CHECK_PARAMETER(1, table);
+  const char *name=0, *weights_name=0;
+  unsigned int input, output, bptt_truncation;
+  MatrixFloat *input_matrix=0, *recurrent_matrix=0, *bias_matrix=0;
+  check_table_fields(L, 1, "name", "weights", "input", "output",
+                     "bptt_truncation", "input_matrix", "recurrent_matrix",
+                     "bias_matrix", (const char *)0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, name, string, name, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, weights, string, weights_name, 0);
+  LUABIND_GET_TABLE_PARAMETER(1, input, uint, input);
+  LUABIND_GET_TABLE_PARAMETER(1, output, uint, output);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, bptt_truncation, uint,
+                                       bptt_truncation, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, input_matrix, MatrixFloat,
+                                       input_matrix, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, recurrent_matrix, MatrixFloat,
+                                       recurrent_matrix, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, bias_matrix, MatrixFloat,
+                                       bias_matrix, 0);
+  obj = new LSTMANNComponent(name, weights_name, input, output,
+                             bptt_truncation, input_matrix,
+                             recurrent_matrix, bias_matrix);
+  LUABIND_RETURN(LSTMANNComponent, obj);
+}
+//BIND_END
+
+//BIND_METHOD LSTMANNComponent clone
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  int argn = lua_gettop(L);
+  AprilUtils::LuaTable copies;
+  if (argn == 1) {
+    copies = AprilUtils::LuaTable(L,1);
+  }
+  LUABIND_RETURN(LSTMANNComponent,
+		 dynamic_cast<LSTMANNComponent*>(obj->clone(copies)));
+}
+//BIND_END
+
+/////////////////////////////////////////////////////
+//                 GRUANNComponent                 //
+/////////////////////////////////////////////////////
+
+//BIND_LUACLASSNAME GRUANNComponent ann.components.gru
+//BIND_CPP_CLASS    GRUANNComponent
+//BIND_SUBCLASS_OF  GRUANNComponent SequenceRecurrentANNComponent
+
+//BIND_CONSTRUCTOR GRUANNComponent
+{
+  LUABIND_CHECK_ARGN(==, 1);
+  LUABIND_CHECK_PARAMETER(1, table);
+  const char *name=0, *weights_name=0;
+  unsigned int input, output, bptt_truncation;
+  MatrixFloat *input_matrix=0, *recurrent_matrix=0, *bias_matrix=0;
+  check_table_fields(L, 1, "name", "weights", "input", "output",
+                     "bptt_truncation", "input_matrix", "recurrent_matrix",
+                     "bias_matrix", (const char *)0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, name, string, name, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, weights, string, weights_name, 0);
+  LUABIND_GET_TABLE_PARAMETER(1, input, uint, input);
+  LUABIND_GET_TABLE_PARAMETER(1, output, uint, output);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, bptt_truncation, uint,
+                                       bptt_truncation, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, input_matrix, MatrixFloat,
+                                       input_matrix, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, recurrent_matrix, MatrixFloat,
+                                       recurrent_matrix, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, bias_matrix, MatrixFloat,
+                                       bias_matrix, 0);
+  obj = new GRUANNComponent(name, weights_name, input, output,
+                            bptt_truncation, input_matrix,
+                            recurrent_matrix, bias_matrix);
+  LUABIND_RETURN(GRUANNComponent, obj);
+}
+//BIND_END
+
+//BIND_METHOD GRUANNComponent clone
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  int argn = lua_gettop(L);
+  AprilUtils::LuaTable copies;
+  if (argn == 1) {
+    copies = AprilUtils::LuaTable(L,1);
+  }
+  LUABIND_RETURN(GRUANNComponent,
+		 dynamic_cast<GRUANNComponent*>(obj->clone(copies)));
+}
+//BIND_END
+
 /////////////////////////////////////////////////////
 //               CopyANNComponent                  //
 /////////////////////////////////////////////////////
@@ -1340,11 +1815,11 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
 {
   LUABIND_CHECK_ARGN(==, 1);
   LUABIND_CHECK_PARAMETER(1, table);
-  const char *name=0, *weights=0;
+  const char *name=0, *weights=0, *algorithm_str=0;
   int *kernel, *step, n, input_planes_dim;
   MatrixFloat *matrix=0;
   check_table_fields(L, 1, "name", "weights", "kernel", "input_planes_dim",
-		     "step", "n", "matrix", (const char *)0);
+		     "step", "n", "matrix", "algorithm", (const char *)0);
   LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, input_planes_dim, int,
 				       input_planes_dim, -1);
   if (input_planes_dim > 1) {
@@ -1357,6 +1832,14 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
   LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, weights, string, weights, 0);
   LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, matrix, MatrixFloat, matrix, 0);
   LUABIND_GET_TABLE_PARAMETER(1, n, int, n);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, algorithm, string, algorithm_str,
+                                       "gemm");
+  Kernels::ConvolutionAlgorithm algorithm =
+    Kernels::getConvolutionAlgorithmFromString(algorithm_str);
+  if (algorithm == Kernels::CONV_NUM_ALGORITHMS) {
+    LUABIND_FERROR1("Unknown convolution algorithm %s, expected auto, gemm, "
+                    "direct or winograd", algorithm_str);
+  }
   //
   lua_getfield(L, 1, "kernel");
   if (!lua_istable(L, -1))
@@ -1383,13 +1866,34 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
   }
   lua_pop(L, 1);
   obj = new ConvolutionANNComponent(size, kernel, step, n,
-				    name, weights, matrix);
+				    name, weights, matrix, algorithm);
   LUABIND_RETURN(ConvolutionANNComponent, obj);
   delete[] kernel;
   delete[] step;
 }
 //BIND_END
 
+//BIND_METHOD ConvolutionANNComponent get_algorithm
+{
+  LUABIND_RETURN(string, Kernels::getConvolutionAlgorithmName(obj->getAlgorithm()));
+}
+//BIND_END
+
+//BIND_CLASS_METHOD ConvolutionANNComponent set_benchmark_mode
+{
+  bool v;
+  LUABIND_CHECK_ARGN(==, 1);
+  LUABIND_GET_PARAMETER(1, bool, v);
+  ConvolutionANNComponent::setBenchmarkMode(v);
+}
+//BIND_END
+
+//BIND_CLASS_METHOD ConvolutionANNComponent get_benchmark_mode
+{
+  LUABIND_RETURN(bool, ConvolutionANNComponent::getBenchmarkMode());
+}
+//BIND_END
+
 //BIND_METHOD ConvolutionANNComponent get_kernel_shape
 {
   const int *kernel;
@@ -1530,18 +2034,28 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
 
 //BIND_METHOD StochasticANNComponent set_random
 {
-  Basics::MTRand *random;
   LUABIND_CHECK_ARGN(==,1);
-  LUABIND_CHECK_PARAMETER(1, MTRand);
-  LUABIND_GET_PARAMETER(1, MTRand, random);
-  obj->setRandom(random);
+  if (lua_isPhiloxRand(L, 1)) {
+    obj->setPhilox(lua_toPhiloxRand(L, 1));
+  }
+  else {
+    Basics::MTRand *random;
+    LUABIND_CHECK_PARAMETER(1, MTRand);
+    LUABIND_GET_PARAMETER(1, MTRand, random);
+    obj->setRandom(random);
+  }
   LUABIND_RETURN(StochasticANNComponent, obj);
 }
 //BIND_END
 
 //BIND_METHOD StochasticANNComponent get_random
 {
-  LUABIND_RETURN(MTRand, obj->getRandom());
+  if (obj->getPhilox() != 0) {
+    LUABIND_RETURN(PhiloxRand, obj->getPhilox());
+  }
+  else {
+    LUABIND_RETURN(MTRand, obj->getRandom());
+  }
 }
 //BIND_END
 
@@ -1561,18 +2075,27 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
   float mean=0.0f, var=0.1f;
   unsigned int size=0;
   Basics::MTRand *random=0;
+  Basics::PhiloxRand *philox=0;
   if (argn == 1) {
     LUABIND_CHECK_PARAMETER(1, table);
     check_table_fields(L, 1, "size", "random", "mean", "var", "name",
 		       (const char *)0);
-    LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, random, MTRand, random, random);
+    philox = getPhiloxField(L, 1);
+    if (!philox) {
+      LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, random, MTRand, random, random);
+    }
     LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, mean, float, mean, mean);
     LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, var, float, var, var);
     LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, size, uint, size, size);
     LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, name, string, name, name);
   }
-  if (!random) random = new Basics::MTRand();
-  obj = new GaussianNoiseANNComponent(random, mean, var, name, size);
+  if (philox) {
+    obj = new GaussianNoiseANNComponent(philox, mean, var, name, size);
+  }
+  else {
+    if (!random) random = new Basics::MTRand();
+    obj = new GaussianNoiseANNComponent(random, mean, var, name, size);
+  }
   LUABIND_RETURN(GaussianNoiseANNComponent, obj);
 }
 //BIND_END
@@ -1606,19 +2129,28 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
   float zero=0.0f, one=1.0f, prob=0.2f;
   unsigned int size=0;
   Basics::MTRand *random=0;
+  Basics::PhiloxRand *philox=0;
   if (argn == 1) {
     LUABIND_CHECK_PARAMETER(1, table);
     check_table_fields(L, 1, "size", "random", "one", "zero", "prob", "name",
 		       (const char *)0);
-    LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, random, MTRand, random, random);
+    philox = getPhiloxField(L, 1);
+    if (!philox) {
+      LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, random, MTRand, random, random);
+    }
     LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, prob, float, prob, prob);
     LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, zero, float,  zero, zero);
     LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, one,  float,  one,  one);
     LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, size, uint,   size, size);
     LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, name, string, name, name);
   }
-  if (!random) random = new Basics::MTRand();  
-  obj = new SaltAndPepperANNComponent(random, zero, one, prob, name, size);
+  if (philox) {
+    obj = new SaltAndPepperANNComponent(philox, zero, one, prob, name, size);
+  }
+  else {
+    if (!random) random = new Basics::MTRand();
+    obj = new SaltAndPepperANNComponent(random, zero, one, prob, name, size);
+  }
   LUABIND_RETURN(SaltAndPepperANNComponent, obj);
 }
 //BIND_END
@@ -1652,6 +2184,7 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
   float prob=0.5f, value=0.0f;
   unsigned int size=0;
   Basics::MTRand *random=0;
+  Basics::PhiloxRand *philox=0;
   bool norm = true; // normalize_after_training
   if (argn == 1) {
     LUABIND_CHECK_PARAMETER(1, table);
@@ -1662,10 +2195,18 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
     LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, value, float, value, value);
     LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, prob, float, prob, prob);
     LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, norm, bool, norm, norm);
-    LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, random, MTRand, random, random);
+    philox = getPhiloxField(L, 1);
+    if (!philox) {
+      LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, random, MTRand, random, random);
+    }
+  }
+  if (philox) {
+    obj = new DropoutANNComponent(philox, value, prob, norm, name, size);
+  }
+  else {
+    if (!random) random = new Basics::MTRand();
+    obj = new DropoutANNComponent(random, value, prob, norm, name, size);
   }
-  if (!random) random = new Basics::MTRand();
-  obj = new DropoutANNComponent(random, value, prob, norm, name, size);
   LUABIND_RETURN(DropoutANNComponent, obj);  
 }
 //BIND_END
@@ -2211,3 +2752,141 @@ void lua_pushAuxANNComponent(lua_State *L, ANNComponent *value);
 		 dynamic_cast<ConstANNComponent*>(obj->clone(copies)));
 }
 //BIND_END
+
+//////////////////////////////////////////////
+//        DataParallelANNComponent          //
+//////////////////////////////////////////////
+
+//BIND_LUACLASSNAME DataParallelANNComponent ann.components.data_parallel
+//BIND_CPP_CLASS    DataParallelANNComponent
+//BIND_SUBCLASS_OF  DataParallelANNComponent ANNComponent
+
+//BIND_CONSTRUCTOR DataParallelANNComponent
+{
+  LUABIND_CHECK_ARGN(==, 1);
+  LUABIND_CHECK_PARAMETER(1, table);
+  const char *name=0;
+  ANNComponent *component;
+  unsigned int replicas;
+  check_table_fields(L, 1, "name", "component", "replicas", (const char *)0);
+  LUABIND_GET_TABLE_PARAMETER(1, component, ANNComponent, component);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, replicas, uint, replicas,
+                                       OMPUtils::get_num_threads());
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, name, string, name, 0);
+  //
+  obj = new DataParallelANNComponent(component, replicas, name);
+  LUABIND_RETURN(DataParallelANNComponent, obj);
+}
+//BIND_END
+
+//BIND_METHOD DataParallelANNComponent clone
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  int argn = lua_gettop(L);
+  AprilUtils::LuaTable copies;
+  if (argn == 1) {
+    copies = AprilUtils::LuaTable(L,1);
+  }
+  LUABIND_RETURN(DataParallelANNComponent,
+		 dynamic_cast<DataParallelANNComponent*>(obj->clone(copies)));
+}
+//BIND_END
+
+//BIND_METHOD DataParallelANNComponent get_component
+{
+  LUABIND_RETURN(AuxANNComponent, obj->getWrappedComponent());
+}
+//BIND_END
+
+//BIND_METHOD DataParallelANNComponent get_num_replicas
+{
+  LUABIND_RETURN(uint, obj->getNumReplicas());
+}
+//BIND_END
+
+//////////////////////////////////////////////
+//          EnsembleANNComponent            //
+//////////////////////////////////////////////
+
+//BIND_LUACLASSNAME EnsembleANNComponent ann.components.ensemble
+//BIND_CPP_CLASS    EnsembleANNComponent
+//BIND_SUBCLASS_OF  EnsembleANNComponent ANNComponent
+
+//BIND_CONSTRUCTOR EnsembleANNComponent
+{
+  LUABIND_CHECK_ARGN(==, 1);
+  LUABIND_CHECK_PARAMETER(1, table);
+  const char *name=0;
+  ANNComponent *component;
+  float tolerance;
+  unsigned int block;
+  check_table_fields(L, 1, "name", "component", "samples", "tolerance",
+                     "block", (const char *)0);
+  LUABIND_GET_TABLE_PARAMETER(1, component, ANNComponent, component);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, tolerance, float, tolerance, 0.0f);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, block, uint, block,
+                                       OMPUtils::get_num_threads());
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, name, string, name, 0);
+  // samples is an array of weight dictionaries, one for every member
+  lua_getfield(L, 1, "samples");
+  if (!lua_istable(L, -1)) {
+    LUABIND_ERROR("Needs a samples field with a table of weight dictionaries");
+  }
+  AprilUtils::LuaTable samples = lua_toLuaTable(L, -1);
+  lua_pop(L, 1);
+  //
+  obj = new EnsembleANNComponent(component, tolerance, block, name);
+  for (unsigned int i=1; i<=samples.length(); ++i) {
+    obj->addMember(samples.get<AprilUtils::LuaTable>(static_cast<int>(i)));
+  }
+  LUABIND_RETURN(EnsembleANNComponent, obj);
+}
+//BIND_END
+
+//BIND_METHOD EnsembleANNComponent clone
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  int argn = lua_gettop(L);
+  AprilUtils::LuaTable copies;
+  if (argn == 1) {
+    copies = AprilUtils::LuaTable(L,1);
+  }
+  LUABIND_RETURN(EnsembleANNComponent,
+		 dynamic_cast<EnsembleANNComponent*>(obj->clone(copies)));
+}
+//BIND_END
+
+//BIND_METHOD EnsembleANNComponent get_component
+{
+  LUABIND_RETURN(AuxANNComponent, obj->getPrototype());
+}
+//BIND_END
+
+//BIND_METHOD EnsembleANNComponent get_num_members
+{
+  LUABIND_RETURN(uint, obj->getNumMembers());
+}
+//BIND_END
+
+//BIND_METHOD EnsembleANNComponent get_num_used
+{
+  LUABIND_RETURN(uint, obj->getNumUsed());
+}
+//BIND_END
+
+//BIND_METHOD EnsembleANNComponent set_tolerance
+{
+  float tolerance;
+  LUABIND_CHECK_ARGN(==, 1);
+  LUABIND_GET_PARAMETER(1, float, tolerance);
+  if (tolerance < 0.0f) LUABIND_ERROR("Needs a non-negative tolerance");
+  obj->setTolerance(tolerance);
+  LUABIND_RETURN(EnsembleANNComponent, obj);
+}
+//BIND_END
+
+//BIND_METHOD EnsembleANNComponent get_tolerance
+{
+  LUABIND_RETURN(float, obj->getTolerance());
+}
+//BIND_END
@@ -35,7 +35,8 @@ namespace ANN {
     output(0),
     error_input(0),
     error_output(0),
-    need_flatten(need_flatten) {
+    need_flatten(need_flatten),
+    in_place(false) {
   }
 
   ActivationFunctionANNComponent::~ActivationFunctionANNComponent() {
@@ -64,9 +65,19 @@ namespace ANN {
 #ifdef USE_CUDA
     input_mat->setUseCuda(use_cuda);
 #endif
-    // new  output to fit the bunch
-    MatrixFloat *output_mat = input_mat->cloneOnlyDims();
-    AssignRef(output,new TokenMatrixFloat(output_mat));
+    // new output to fit the bunch, or the input when computing in-place
+    MatrixFloat *output_mat;
+    if (in_place) {
+      output_mat = input_mat;
+      AssignRef(output, input);
+    }
+    else {
+      output_mat = output_buffer.getLike(input_mat);
+#ifdef USE_CUDA
+      output_mat->setUseCuda(use_cuda);
+#endif
+      AssignRef(output,new TokenMatrixFloat(output_mat));
+    }
     // flatten if needed
     flat_input_mat = input_mat;
     flat_output_mat = output_mat;
@@ -99,17 +110,27 @@ namespace ANN {
     error_input_mat->setUseCuda(use_cuda);
 #endif
     // new  output to fit the bunch
-    MatrixFloat *error_output_mat = error_input_mat->cloneOnlyDims();
+    MatrixFloat *error_output_mat = error_output_buffer.getLike(error_input_mat);
+#ifdef USE_CUDA
+    error_output_mat->setUseCuda(use_cuda);
+#endif
     AssignRef(error_output,new TokenMatrixFloat(error_output_mat));
     if (!error_output_mat->sameDim(input->getMatrix()))
       ERROR_EXIT1(129, "Different bunches found at doForward and doBackprop [%s]\n",
 		  name.c_str());
-    // flatten if needed
+    // flatten if needed, input and output are taken again because they could
+    // be changed by setState() (BPTT in ann.graph)
+    MatrixFloat *input_mat = input->getMatrix();
+    MatrixFloat *output_mat = output->getMatrix();
+    flat_input_mat = input_mat;
+    flat_output_mat = output_mat;
     flat_error_input_mat = error_input_mat;
     flat_error_output_mat = error_output_mat;
     if (need_flatten && error_input_mat->getNumDim() > 2) {
       int dims[2] = { error_input_mat->getDimSize(0),
                       error_input_mat->size() / error_input_mat->getDimSize(0) };
+      flat_input_mat = input_mat->rewrap(dims, 2);
+      flat_output_mat = output_mat->rewrap(dims, 2);
       flat_error_input_mat = error_input_mat->rewrap(dims, 2);
       flat_error_output_mat = error_output_mat->rewrap(dims, 2);
     }
@@ -23,6 +23,7 @@
 #define ACTFCOMPONENT_H
 
 #include "ann_component.h"
+#include "matrix_buffer.h"
 #include "MersenneTwister.h"
 #include "smart_ptr.h"
 #include "token_matrix.h"
@@ -41,6 +42,8 @@ namespace ANN {
     APRIL_DISALLOW_COPY_AND_ASSIGN(ActivationFunctionANNComponent);
     Basics::TokenMatrixFloat *input, *output, *error_input, *error_output;
     bool need_flatten;
+    bool in_place;
+    MatrixBuffer output_buffer, error_output_buffer;
     AprilUtils::SharedPtr<Basics::MatrixFloat> flat_input_mat;
     AprilUtils::SharedPtr<Basics::MatrixFloat> flat_output_mat;
     AprilUtils::SharedPtr<Basics::MatrixFloat> flat_error_input_mat;
@@ -71,6 +74,14 @@ namespace ANN {
 				     Basics::MatrixFloat *output_units,
 				     Basics::MatrixFloat *input_errors,
 				     Basics::MatrixFloat *output_errors) = 0;
+    /**
+     * @brief Indicates if applyActivation() and multiplyDerivatives() work
+     * properly when input and output units are the same matrix.
+     *
+     * It is true for element-wise activations whose derivatives can be
+     * computed from the activated values. By default it returns false.
+     */
+    virtual bool supportsInPlace() const { return false; }
   public:
     ActivationFunctionANNComponent(const char *name=0, bool need_flatten=false);
     virtual ~ActivationFunctionANNComponent();
@@ -93,6 +104,12 @@ namespace ANN {
       AssignRef(error_output, tk->convertTo<Basics::TokenMatrixFloat*>());
     }
     
+    virtual bool setInPlace(bool v) {
+      in_place = v && supportsInPlace();
+      return in_place;
+    }
+    virtual bool getInPlace() const { return in_place; }
+    
     virtual Basics::Token *doForward(Basics::Token* input, bool during_training);
     
     virtual Basics::Token *doBackprop(Basics::Token *input_error);
@@ -23,7 +23,10 @@
 #include "cblas_headers.h"
 #include "cmath_overloads.h"
 #include "map_matrix.h"
+#include "maxmin.h"
+#include "omp_utils.h"
 #include "reduce_matrix.h"
+#include "simd_kernels.h"
 #include "smart_ptr.h"
 
 using namespace AprilMath;
@@ -34,6 +37,109 @@ using namespace AprilMath::MatrixExt::Reductions;
 
 namespace ANN {
   namespace Kernels {
+
+    namespace {
+      /// Rows are split in blocks of this size, small enough to stay in L1.
+      const unsigned int SOFTMAX_BLOCK_SIZE = 1024u;
+
+      /// True for CPU bi-dimensional matrices with contiguous rows.
+      bool hasContiguousRows(const Basics::MatrixFloat *m) {
+#ifdef USE_CUDA
+        if (m->getCudaFlag()) return false;
+#endif
+        return m->getNumDim() == 2 && m->getStrideSize(1) == 1;
+      }
+
+      /// Rows are computed in parallel when the matrix is large enough.
+      bool useParallelRows(unsigned int bunch_size, unsigned int size) {
+        return OMPUtils::get_num_threads() > 1 && bunch_size > 1 &&
+          static_cast<size_t>(bunch_size)*size >= OMPUtils::get_parallel_threshold();
+      }
+
+      /**
+       * Computes the maximum of @c x and the log of sum(exp(x - maximum)) in
+       * one pass over memory (online softmax). Every block is read twice while
+       * it is in cache, and the accumulated sum is rescaled when a block has a
+       * larger maximum.
+       */
+      void softmaxRowStats(unsigned int size, const float *x,
+                           float &maximum, float &log_sum) {
+        float sum = 0.0f;
+        maximum = -AprilMath::Limits<float>::infinity();
+        for (unsigned int i=0; i<size; i+=SOFTMAX_BLOCK_SIZE) {
+          const unsigned int n = AprilUtils::min(SOFTMAX_BLOCK_SIZE, size-i);
+          float block_max = maximum;
+          AprilMath::SIMD::vecMaxReduce(n, x+i, block_max);
+          if (block_max > maximum) {
+            if (sum > 0.0f) sum *= AprilMath::m_exp(maximum - block_max);
+            maximum = block_max;
+          }
+          AprilMath::SIMD::vecExpSum(n, x+i, maximum, 0, sum);
+        }
+        log_sum = AprilMath::m_log(sum);
+      }
+
+      /// Row-parallel softmax (or log-softmax) for contiguous rows.
+      void softmaxRows(Basics::MatrixFloat *output,
+                       const Basics::MatrixFloat *input,
+                       bool log_scale) {
+        const int bunch_size = input->getDimSize(0);
+        const unsigned int size = static_cast<unsigned int>(input->getDimSize(1));
+        const int in_stride = input->getStrideSize(0);
+        const int out_stride = output->getStrideSize(0);
+        const float *x0 = input->getRawDataAccess()->getPPALForRead() +
+          input->getOffset();
+        float *y0 = output->getRawDataAccess()->getPPALForWrite() +
+          output->getOffset();
+#ifndef NO_OMP
+#pragma omp parallel for if(useParallelRows(bunch_size, size))
+#endif
+        for (int b=0; b<bunch_size; ++b) {
+          const float *x = x0 + b*in_stride;
+          float *y = y0 + b*out_stride;
+          float maximum, log_sum, dummy = 0.0f;
+          softmaxRowStats(size, x, maximum, log_sum);
+          if (log_scale) {
+            AprilMath::SIMD::vecAffine(size, x, 1.0f, -(maximum + log_sum), y);
+          }
+          else {
+            // exp(x - max - log(sum)) is the normalized probability
+            AprilMath::SIMD::vecExpSum(size, x, maximum + log_sum, y, dummy);
+          }
+        }
+      }
+
+      /// Row-parallel softmax derivative for contiguous rows.
+      void softmaxDerivativeRows(Basics::MatrixFloat *output_errors,
+                                 const Basics::MatrixFloat *input_errors,
+                                 const Basics::MatrixFloat *output_units) {
+        const int bunch_size = output_units->getDimSize(0);
+        const unsigned int size =
+          static_cast<unsigned int>(output_units->getDimSize(1));
+        const int e_stride = input_errors->getStrideSize(0);
+        const int y_stride = output_units->getStrideSize(0);
+        const int d_stride = output_errors->getStrideSize(0);
+        const float *e0 = input_errors->getRawDataAccess()->getPPALForRead() +
+          input_errors->getOffset();
+        const float *y0 = output_units->getRawDataAccess()->getPPALForRead() +
+          output_units->getOffset();
+        float *d0 = output_errors->getRawDataAccess()->getPPALForWrite() +
+          output_errors->getOffset();
+#ifndef NO_OMP
+#pragma omp parallel for if(useParallelRows(bunch_size, size))
+#endif
+        for (int b=0; b<bunch_size; ++b) {
+          const float *e = e0 + b*e_stride;
+          const float *y = y0 + b*y_stride;
+          float *d = d0 + b*d_stride;
+          // d = (e - dot(y,e)) * y
+          float dot = 0.0f;
+          AprilMath::SIMD::vecDot(size, y, e, dot);
+          AprilMath::SIMD::vecAffine(size, e, 1.0f, -dot, d);
+          AprilMath::SIMD::vecMul(size, d, y, d);
+        }
+      }
+    } // anonymous namespace
     
     template<typename T>
     struct prelu {
@@ -206,6 +312,10 @@ namespace ANN {
       }
       else {
 #endif
+        if (hasContiguousRows(input) && hasContiguousRows(output)) {
+          softmaxRows(output, input, false);
+          return;
+        }
         for (unsigned int b = 0; b < bunch_size; ++b) {
           Basics::MatrixFloat::const_iterator input_it(input->iteratorAt(b,0));
           float minimum = *input_it;
@@ -286,6 +396,10 @@ namespace ANN {
       }
       else {
 #endif
+        if (hasContiguousRows(input) && hasContiguousRows(output)) {
+          softmaxRows(output, input, true);
+          return;
+        }
         for (unsigned int b = 0; b < bunch_size; ++b) {
           Basics::MatrixFloat::const_iterator input_it(input->iteratorAt(b,0));
           float maximum = *input_it;
@@ -331,6 +445,13 @@ namespace ANN {
     void applySoftmaxDerivative(Basics::MatrixFloat *output_errors_mat,
                                 const Basics::MatrixFloat *input_errors_mat,
                                 const Basics::MatrixFloat *output_units_mat) {
+      if (hasContiguousRows(output_errors_mat) &&
+          hasContiguousRows(input_errors_mat) &&
+          hasContiguousRows(output_units_mat)) {
+        softmaxDerivativeRows(output_errors_mat, input_errors_mat,
+                              output_units_mat);
+        return;
+      }
       unsigned int size = output_units_mat->getDimSize(1);
       AprilUtils::SharedPtr<Basics::MatrixFloat> column, sums;
       sums = MatrixScalarReduce2OverDimension
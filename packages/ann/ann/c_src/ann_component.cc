@@ -27,6 +27,8 @@ using namespace AprilMath;
 namespace ANN {
   unsigned int ANNComponent::next_name_id    = 1;
   unsigned int ANNComponent::next_weights_id = 1;
+  bool ANNComponent::memory_planning         = true;
+  bool ANNComponent::inter_op_parallelism    = false;
 
   unsigned int mult(const int *v, int n) {
     int m = 1;
@@ -388,6 +388,73 @@ namespace ANN {
     
     /// Getter for @c use_cuda property.
     bool getUseCuda() const { return use_cuda; }
+
+    /**
+     * @brief Indicates if the component output can be overwritten by the next
+     * component once doForward() returns.
+     *
+     * Components which don't use their own output at doBackprop() or at
+     * gradients computation return true, allowing memory planning of composed
+     * components to compute the next output in-place.
+     *
+     * @note By default it returns false.
+     */
+    virtual bool isOutputOverwritable() const { return false; }
+    
+    /**
+     * @brief Asks the component to compute its output over its input matrix.
+     *
+     * @param v - A bool indicating if in-place execution is desired.
+     *
+     * @return The in-place state of the component after the call, which is
+     * false for components without in-place support.
+     *
+     * @note This method is called by build() of composed components when
+     * memory planning is enabled, and only if the component which produces
+     * the input returns true at isOutputOverwritable().
+     */
+    virtual bool setInPlace(bool v) {
+      UNUSED_VARIABLE(v);
+      return false;
+    }
+    
+    /// Returns true if the component computes its output in-place.
+    virtual bool getInPlace() const { return false; }
+    
+    /// Enables or disables memory planning at build() of composed components.
+    static void setMemoryPlanning(bool v) { memory_planning = v; }
+
+    /// Getter for memory planning flag.
+    static bool getMemoryPlanning() { return memory_planning; }
+
+    /**
+     * @brief Indicates if doForward() and doBackprop() can be executed
+     * concurrently with other components.
+     *
+     * Components which share mutable objects (as random generators) or which
+     * use the Lua state during forward or backprop should return false.
+     * Composed components return false when any of their components does.
+     *
+     * @note By default it returns true.
+     */
+    virtual bool getIsThreadSafe() const { return true; }
+
+    /**
+     * @brief Enables or disables concurrent execution of independent
+     * branches in JoinANNComponent and GraphANNComponent.
+     *
+     * Every branch writes its result into its own token, and results are
+     * combined in a fixed order, so the outputs and gradients don't depend on
+     * this flag nor on the number of OMP threads.
+     *
+     * @note It is disabled by default, because branches compete with the
+     * intra-operator threads of BLAS and matrix operations, and it only pays
+     * off when the branches are large enough.
+     */
+    static void setInterOpParallelism(bool v) { inter_op_parallelism = v; }
+
+    /// Getter for inter-operator parallelism flag.
+    static bool getInterOpParallelism() { return inter_op_parallelism; }
     
     /**
      * @brief Method which changes ANNComponent state from non-built to built.
@@ -557,6 +624,10 @@ namespace ANN {
     static unsigned int next_name_id;
     /// The counter for automatic weights_name generation.
     static unsigned int next_weights_id;
+    /// Memory planning flag, see setInPlace() and isOutputOverwritable().
+    static bool memory_planning;
+    /// Inter-operator parallelism flag, see setInterOpParallelism().
+    static bool inter_op_parallelism;
     /// The name which identifies the ANNComponent.
     AprilUtils::string name;
     /// The name which identifies the ANNComponent weight parameters.
@@ -35,7 +35,7 @@ namespace ANN {
 				     const char *weights_name,
                                      MatrixFloat *matrix) :
     VirtualMatrixANNComponent(name, weights_name, size, size),
-    bias_vector(matrix) {
+    bias_vector(matrix), in_place(false) {
     setInputContiguousProperty(true);
     if (weights_name == 0) generateDefaultWeightsName("b");
   }
@@ -52,8 +52,15 @@ namespace ANN {
     if (!bias_vector) ERROR_EXIT1(129, "Not built component %s\n",
                                   name.c_str());
     unsigned int bunch_size = input->getDimSize(0);
-    // linear transfer of input to output
-    MatrixFloat *output = input->clone();
+    // linear transfer of input to output, unless it is computed in-place
+    MatrixFloat *output = input;
+    if (!in_place) {
+      output = output_buffer.getLike(input);
+#ifdef USE_CUDA
+      output->setUseCuda(use_cuda);
+#endif
+      matCopy(output, input);
+    }
     // bias
     MatrixFloat *bias_ptr = bias_vector.get();
     if (bunch_size == 1) {
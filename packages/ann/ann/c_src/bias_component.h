@@ -25,6 +25,7 @@
 #include "cblas_headers.h"
 #include "matrix_component.h"
 #include "connection.h"
+#include "matrix_buffer.h"
 #include "token_matrix.h"
 
 namespace ANN {
@@ -33,6 +34,8 @@ namespace ANN {
   class BiasANNComponent : public VirtualMatrixANNComponent {
     APRIL_DISALLOW_COPY_AND_ASSIGN(BiasANNComponent);
     AprilUtils::SharedPtr<Basics::MatrixFloat> bias_vector;
+    bool in_place;
+    MatrixBuffer output_buffer;
     
   protected:
     
@@ -47,6 +50,10 @@ namespace ANN {
 		     const char *name=0, const char *weights_name=0,
                      Basics::MatrixFloat *matrix=0);
     virtual ~BiasANNComponent();
+    /// The output is not needed at doBackprop() neither at gradients
+    virtual bool isOutputOverwritable() const { return true; }
+    virtual bool setInPlace(bool v) { in_place = v; return in_place; }
+    virtual bool getInPlace() const { return in_place; }
     virtual ANNComponent *clone(AprilUtils::LuaTable &copies);
     virtual void build(unsigned int input_size,
 		       unsigned int output_size,
@@ -0,0 +1,323 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include "activation_function_kernels.h"
+#include "cblas_headers.h"
+#include "class_softmax_component.h"
+#include "cmath_overloads.h"
+#include "connection.h"
+#include "simd_kernels.h"
+#include "unused_variable.h"
+
+using namespace AprilMath;
+using namespace AprilMath::MatrixExt::BLAS;
+using namespace AprilMath::MatrixExt::Initializers;
+using namespace AprilUtils;
+using namespace Basics;
+
+namespace ANN {
+
+  namespace {
+    /// In-place log-softmax of a small contiguous vector.
+    void logSoftmax(unsigned int n, float *x) {
+      float maximum = x[0], sum = 0.0f;
+      SIMD::vecMaxReduce(n, x, maximum);
+      SIMD::vecExpSum(n, x, maximum, 0, sum);
+      SIMD::vecAffine(n, x, 1.0f, -(maximum + m_log(sum)), x);
+    }
+
+    /// In-place gradient of log(softmax(x)[target]) scaled by e, where x
+    /// contains log-probabilities: e * (onehot(target) - exp(x)).
+    void logSoftmaxGradient(unsigned int n, const float *x, unsigned int target,
+                            float e, float *dest) {
+      float dummy = 0.0f;
+      SIMD::vecExpSum(n, x, 0.0f, dest, dummy);
+      SIMD::vecAffine(n, dest, -e, 0.0f, dest);
+      dest[target] += e;
+    }
+  } // anonymous namespace
+
+  ClassSoftmaxANNComponent::ClassSoftmaxANNComponent(unsigned int vocab_size,
+                                                     unsigned int num_classes,
+                                                     const char *name,
+                                                     const char *weights_name,
+                                                     unsigned int input_size,
+                                                     MatrixFloat *matrix) :
+    VirtualMatrixANNComponent(name, weights_name, input_size, 1),
+    vocab_size(vocab_size), num_classes(num_classes), class_size(0),
+    weights_matrix(matrix),
+    hidden_mat(0), class_lp_mat(0), word_lp_mat(0),
+    class_grads_mat(0), word_grads_mat(0) {
+    setInputContiguousProperty(true);
+    if (weights_name == 0) generateDefaultWeightsName("w");
+    if (num_classes < 2 || num_classes > vocab_size) {
+      ERROR_EXIT3(128, "Incorrect number of classes %u for a vocabulary "
+                  "of %u words [%s]\n", num_classes, vocab_size,
+                  this->name.c_str());
+    }
+    class_size = (vocab_size + num_classes - 1u) / num_classes;
+    // with ceil(V/C) words per class, too many classes leave the last empty
+    if ((num_classes - 1u) * class_size >= vocab_size) {
+      ERROR_EXIT3(128, "Too many classes %u for a vocabulary of %u words, "
+                  "the last class is empty [%s]\n", num_classes, vocab_size,
+                  this->name.c_str());
+    }
+  }
+
+  ClassSoftmaxANNComponent::~ClassSoftmaxANNComponent() {
+  }
+
+  MatrixFloat *ClassSoftmaxANNComponent::getClassRows(MatrixFloat *w) const {
+    int coords[2] = { 0, 0 };
+    int sizes[2]  = { static_cast<int>(num_classes), w->getDimSize(1) };
+    return new MatrixFloat(w, coords, sizes, false);
+  }
+
+  MatrixFloat *ClassSoftmaxANNComponent::privateDoForward(MatrixFloat* input,
+                                                          bool during_training) {
+    UNUSED_VARIABLE(during_training);
+    if (weights_matrix.empty()) ERROR_EXIT1(129, "Not built component %s\n",
+                                            name.c_str());
+    if (input->getNumDim() != 2 ||
+        input->getDimSize(1) != static_cast<int>(input_size)) {
+      ERROR_EXIT2(128, "A bi-dimensional matrix with %u columns is expected "
+                  "[%s]\n", input_size, name.c_str());
+    }
+    const int bunch_size = input->getDimSize(0);
+    const int num_inputs = static_cast<int>(input_size);
+    const int hidden_size = num_inputs - 1;
+    // the target column is replaced by ones, to compute the bias
+    hidden_mat = hidden_buffer.getLike(input);
+    matCopy(hidden_mat, input);
+    float *hidden_ptr = hidden_mat->getRawDataAccess()->getPPALForReadAndWrite() +
+      hidden_mat->getOffset();
+    targets.resize(bunch_size);
+    for (int b=0; b<bunch_size; ++b) {
+      float &t = hidden_ptr[b*num_inputs + hidden_size];
+      int w = static_cast<int>(t) - 1;
+      if (w < 0 || w >= static_cast<int>(vocab_size) ||
+          static_cast<float>(w + 1) != t) {
+        ERROR_EXIT3(128, "Incorrect target word %g at row %d [%s]\n",
+                    t, b+1, name.c_str());
+      }
+      targets[b] = w;
+      t = 1.0f;
+    }
+    // log P(c|h) for all the classes
+    int class_dims[2] = { bunch_size, static_cast<int>(num_classes) };
+    class_lp_mat = class_log_probs.get(2, class_dims);
+    AprilUtils::SharedPtr<MatrixFloat> class_rows(getClassRows(weights_matrix.get()));
+    matGemm(class_lp_mat, CblasNoTrans, CblasTrans,
+            1.0f, hidden_mat, class_rows.get(), 0.0f);
+    Kernels::applyLogSoftmax(class_lp_mat, class_lp_mat);
+    // scores of the words in the class of every target
+    int word_dims[2] = { bunch_size, static_cast<int>(class_size) };
+    word_lp_mat = word_log_probs.get(2, word_dims);
+    const int words_offset = weights_matrix->getOffset() + num_classes*num_inputs;
+    for (int b=0; b<bunch_size; ++b) {
+      unsigned int c = getWordClass(targets[b]);
+      doGemv(CblasRowMajor, CblasNoTrans,
+             getClassNumWords(c), num_inputs,
+             1.0f, weights_matrix->getRawDataAccess(), num_inputs,
+             hidden_mat->getRawDataAccess(), 1,
+             0.0f, word_lp_mat->getRawDataAccess(), 1,
+             words_offset + getClassFirstWord(c)*num_inputs,
+             hidden_mat->getOffset() + b*num_inputs,
+             word_lp_mat->getOffset() + b*class_size,
+             false);
+    }
+    // log P(w|h) = log P(c|h) + log P(w|c,h)
+    int output_dims[2] = { bunch_size, 1 };
+    MatrixFloat *output = output_buffer.get(2, output_dims);
+    const float *class_ptr = class_lp_mat->getRawDataAccess()->getPPALForRead() +
+      class_lp_mat->getOffset();
+    float *word_ptr = word_lp_mat->getRawDataAccess()->getPPALForReadAndWrite() +
+      word_lp_mat->getOffset();
+    float *output_ptr = output->getRawDataAccess()->getPPALForWrite() +
+      output->getOffset();
+    for (int b=0; b<bunch_size; ++b) {
+      unsigned int c = getWordClass(targets[b]);
+      float *word_row = word_ptr + b*class_size;
+      logSoftmax(getClassNumWords(c), word_row);
+      output_ptr[b] = class_ptr[b*num_classes + c] +
+        word_row[targets[b] - getClassFirstWord(c)];
+    }
+    return output;
+  }
+
+  MatrixFloat *ClassSoftmaxANNComponent::privateDoBackprop(MatrixFloat *error_input) {
+    const int bunch_size = error_input->getDimSize(0);
+    const int num_inputs = static_cast<int>(input_size);
+    const float *error_ptr = error_input->getRawDataAccess()->getPPALForRead() +
+      error_input->getOffset();
+    const int error_stride = error_input->getStrideSize(0);
+    // gradients of class and word scores
+    class_grads_mat = class_grads.getLike(class_lp_mat);
+    word_grads_mat  = word_grads.getLike(word_lp_mat);
+    const float *class_ptr = class_lp_mat->getRawDataAccess()->getPPALForRead() +
+      class_lp_mat->getOffset();
+    const float *word_ptr = word_lp_mat->getRawDataAccess()->getPPALForRead() +
+      word_lp_mat->getOffset();
+    float *class_grads_ptr = class_grads_mat->getRawDataAccess()->getPPALForWrite() +
+      class_grads_mat->getOffset();
+    float *word_grads_ptr = word_grads_mat->getRawDataAccess()->getPPALForWrite() +
+      word_grads_mat->getOffset();
+    for (int b=0; b<bunch_size; ++b) {
+      unsigned int c = getWordClass(targets[b]);
+      float e = error_ptr[b*error_stride];
+      logSoftmaxGradient(num_classes, class_ptr + b*num_classes, c, e,
+                         class_grads_ptr + b*num_classes);
+      logSoftmaxGradient(getClassNumWords(c), word_ptr + b*class_size,
+                         targets[b] - getClassFirstWord(c), e,
+                         word_grads_ptr + b*class_size);
+    }
+    // error of hidden layer
+    int dims[2] = { bunch_size, num_inputs };
+    MatrixFloat *error_output = error_output_buffer.get(2, dims);
+    AprilUtils::SharedPtr<MatrixFloat> class_rows(getClassRows(weights_matrix.get()));
+    matGemm(error_output, CblasNoTrans, CblasNoTrans,
+            1.0f, class_grads_mat, class_rows.get(), 0.0f);
+    const int words_offset = weights_matrix->getOffset() + num_classes*num_inputs;
+    for (int b=0; b<bunch_size; ++b) {
+      unsigned int c = getWordClass(targets[b]);
+      doGemv(CblasRowMajor, CblasTrans,
+             getClassNumWords(c), num_inputs,
+             1.0f, weights_matrix->getRawDataAccess(), num_inputs,
+             word_grads_mat->getRawDataAccess(), 1,
+             1.0f, error_output->getRawDataAccess(), 1,
+             words_offset + getClassFirstWord(c)*num_inputs,
+             word_grads_mat->getOffset() + b*class_size,
+             error_output->getOffset() + b*num_inputs,
+             false);
+    }
+    // target column is not differentiable
+    AprilUtils::SharedPtr<MatrixFloat> target_col(error_output->select(1, num_inputs-1));
+    matZeros(target_col.get());
+    return error_output;
+  }
+
+  void ClassSoftmaxANNComponent::privateReset(unsigned int it) {
+    UNUSED_VARIABLE(it);
+    weights_matrix->resetSharedCount();
+  }
+
+  void ClassSoftmaxANNComponent::computeGradients(const char *name,
+                                                  AprilUtils::LuaTable &weight_grads_dict) {
+    weights_matrix->addToSharedCount();
+    MatrixFloat *grads_mat = weight_grads_dict.opt<MatrixFloat*>(name, 0);
+    if (grads_mat == 0) {
+      grads_mat = weights_matrix->cloneOnlyDims();
+      matZeros(grads_mat);
+      weight_grads_dict.put(name, grads_mat);
+    }
+    else if (!grads_mat->sameDim(weights_matrix.get()) ||
+             !grads_mat->getIsContiguous()) {
+      ERROR_EXIT(128, "Incorrect weights matrix dimensions\n");
+    }
+    const int bunch_size = class_grads_mat->getDimSize(0);
+    const int num_inputs = static_cast<int>(input_size);
+    AprilUtils::SharedPtr<MatrixFloat> class_rows(getClassRows(grads_mat));
+    matGemm(class_rows.get(), CblasTrans, CblasNoTrans,
+            1.0f, class_grads_mat, hidden_mat, 1.0f);
+    // only rows of target classes words are updated
+    const int words_offset = grads_mat->getOffset() + num_classes*num_inputs;
+    for (int b=0; b<bunch_size; ++b) {
+      unsigned int c = getWordClass(targets[b]);
+      doGer(CblasRowMajor,
+            getClassNumWords(c), num_inputs,
+            1.0f,
+            word_grads_mat->getRawDataAccess(),
+            word_grads_mat->getOffset() + b*class_size, 1,
+            hidden_mat->getRawDataAccess(),
+            hidden_mat->getOffset() + b*num_inputs, 1,
+            grads_mat->getRawDataAccess(),
+            words_offset + getClassFirstWord(c)*num_inputs, num_inputs,
+            false);
+    }
+  }
+
+  ANNComponent *ClassSoftmaxANNComponent::clone(AprilUtils::LuaTable &copies) {
+    UNUSED_VARIABLE(copies);
+    return new ClassSoftmaxANNComponent(vocab_size, num_classes,
+                                        name.c_str(), weights_name.c_str(),
+                                        input_size);
+  }
+
+  void ClassSoftmaxANNComponent::build(unsigned int _input_size,
+                                       unsigned int _output_size,
+                                       AprilUtils::LuaTable &weights_dict,
+                                       AprilUtils::LuaTable &components_dict) {
+    ANNComponent::build(_input_size, _output_size,
+                        weights_dict, components_dict);
+    if (input_size < 2) {
+      ERROR_EXIT1(141, "Impossible to compute input size, it should be the "
+                  "hidden layer size plus one [%s]\n", name.c_str());
+    }
+    MatrixFloat *w = weights_dict.opt<MatrixFloat*>(weights_name, 0);
+    if (w != 0) {
+      weights_matrix = w;
+    }
+    else {
+      if (weights_matrix.empty()) {
+        weights_matrix = Connections::build(input_size,
+                                            num_classes + vocab_size);
+      }
+      weights_dict.put(weights_name, weights_matrix.get());
+    }
+    if (!Connections::checkInputOutputSizes(weights_matrix.get(), input_size,
+                                            num_classes + vocab_size) ||
+        !weights_matrix->getIsContiguous()) {
+      ERROR_EXIT3(256, "Needs a contiguous %ux%u weights matrix [%s]\n",
+                  num_classes + vocab_size, input_size, name.c_str());
+    }
+  }
+
+  void ClassSoftmaxANNComponent::copyWeights(AprilUtils::LuaTable &weights_dict) {
+    if (weights_matrix.empty())
+      ERROR_EXIT1(100, "Component not built, impossible execute copyWeights [%s]\n",
+		  name.c_str());
+    MatrixFloat *w = weights_dict.opt<MatrixFloat*>(weights_name, 0);
+    if (w != 0 && w != weights_matrix.get())
+      ERROR_EXIT2(101, "Weights dictionary contains %s weights name which is "
+		  "not shared with weights_matrix attribute [%s]\n",
+		  weights_name.c_str(),
+		  name.c_str());
+    else if (w == 0) {
+      weights_dict.put(weights_name, weights_matrix.get());
+    }
+  }
+
+  const char *ClassSoftmaxANNComponent::luaCtorName() const {
+    return "ann.components.class_softmax";
+  }
+
+  int ClassSoftmaxANNComponent::exportParamsToLua(lua_State *L) {
+    AprilUtils::LuaTable t(L);
+    t["name"]    = name;
+    t["weights"] = weights_name;
+    t["input"]   = input_size;
+    t["vocab"]   = vocab_size;
+    t["classes"] = num_classes;
+    t["matrix"]  = weights_matrix.get();
+    t.pushTable(L);
+    return 1;
+  }
+
+} // namespace ANN
@@ -0,0 +1,118 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef CLASSSOFTMAXANNCOMPONENT_H
+#define CLASSSOFTMAXANNCOMPONENT_H
+
+#include "matrix_buffer.h"
+#include "matrix_component.h"
+#include "maxmin.h"
+#include "smart_ptr.h"
+#include "token_matrix.h"
+#include "vector.h"
+
+namespace ANN {
+
+  /**
+   * @brief Class-factored softmax output layer for large vocabularies.
+   *
+   * The vocabulary of V words is partitioned in C classes of contiguous word
+   * indices, all of them with ceil(V/C) words except the last one, and the
+   * probability of word w in class c is factored as P(w|h) = P(c|h) P(w|c,h).
+   * Both factors are softmax layers, so forward and backprop cost is
+   * O((C + V/C) H) per sample instead of O(V H). Sorting the vocabulary by
+   * frequency gives frequency binning classes.
+   *
+   * The input is a bi-dimensional matrix with H+1 columns, the hidden layer
+   * followed by the target word index (starting at 1), as produced by an
+   * ann.components.join or an ann.graph.bind. The output is a bunch_size x 1
+   * matrix with log P(target|h), which can be trained with
+   * ann.loss.neg_log_likelihood.
+   *
+   * Weights are a (C+V)x(H+1) matrix, first C rows for classes and next V rows
+   * for words, with the bias at the last column.
+   *
+   * @note Only rows of the target classes and words receive non-zero
+   * gradients, however, optimizers update the whole weights matrix.
+   */
+  class ClassSoftmaxANNComponent : public VirtualMatrixANNComponent {
+    APRIL_DISALLOW_COPY_AND_ASSIGN(ClassSoftmaxANNComponent);
+
+    unsigned int vocab_size, num_classes, class_size;
+    AprilUtils::SharedPtr<Basics::MatrixFloat> weights_matrix;
+    /// Target word of every sample at last doForward(), starting at 0.
+    AprilUtils::vector<int> targets;
+    /// The hidden layer with a column of ones, bunch_size x (H+1).
+    MatrixBuffer hidden_buffer;
+    /// log P(c|h) for all classes, bunch_size x C.
+    MatrixBuffer class_log_probs;
+    /// log P(w|c,h) for all words of target class, bunch_size x class_size.
+    MatrixBuffer word_log_probs;
+    /// Gradients of class and word scores computed at doBackprop().
+    MatrixBuffer class_grads, word_grads;
+    MatrixBuffer output_buffer, error_output_buffer;
+    /// Matrices of the buffers above used at last doForward() and doBackprop()
+    /// calls, they are owned by the buffers.
+    Basics::MatrixFloat *hidden_mat, *class_lp_mat, *word_lp_mat;
+    Basics::MatrixFloat *class_grads_mat, *word_grads_mat;
+
+    unsigned int getClassFirstWord(unsigned int c) const {
+      return c*class_size;
+    }
+    unsigned int getClassNumWords(unsigned int c) const {
+      return AprilUtils::min(class_size, vocab_size - c*class_size);
+    }
+    /// Rows of weights matrix for classes, C x (H+1).
+    Basics::MatrixFloat *getClassRows(Basics::MatrixFloat *w) const;
+
+  protected:
+    virtual Basics::MatrixFloat *privateDoForward(Basics::MatrixFloat *input,
+                                                  bool during_training);
+    virtual Basics::MatrixFloat *privateDoBackprop(Basics::MatrixFloat *input_error);
+    virtual void privateReset(unsigned int it=0);
+    virtual void computeGradients(const char *name,
+                                  AprilUtils::LuaTable &weight_grads_dict);
+
+  public:
+    ClassSoftmaxANNComponent(unsigned int vocab_size,
+                             unsigned int num_classes,
+                             const char *name=0, const char *weights_name=0,
+                             unsigned int input_size=0,
+                             Basics::MatrixFloat *matrix=0);
+    virtual ~ClassSoftmaxANNComponent();
+    virtual ANNComponent *clone(AprilUtils::LuaTable &copies);
+    virtual void build(unsigned int input_size,
+                       unsigned int output_size,
+                       AprilUtils::LuaTable &weights_dict,
+                       AprilUtils::LuaTable &components_dict);
+    virtual void copyWeights(AprilUtils::LuaTable &weights_dict);
+
+    unsigned int getVocabSize() const { return vocab_size; }
+    unsigned int getNumClasses() const { return num_classes; }
+    /// Returns the class of the given word, both starting at 0.
+    unsigned int getWordClass(unsigned int w) const { return w / class_size; }
+
+    virtual const char *luaCtorName() const;
+    virtual int exportParamsToLua(lua_State *L);
+  };
+
+} // namespace ANN
+
+#endif // CLASSSOFTMAXANNCOMPONENT_H
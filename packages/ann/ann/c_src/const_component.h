@@ -56,6 +56,10 @@ namespace ANN {
       component->setState(dict);
     }
     
+    virtual bool getIsThreadSafe() const {
+      return component->getIsThreadSafe();
+    }
+
     virtual Basics::Token *doForward(Basics::Token* input, bool during_training);
     
     virtual Basics::Token *doBackprop(Basics::Token *input_error);
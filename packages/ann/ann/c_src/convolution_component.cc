@@ -20,6 +20,7 @@
  */
 #include "unused_variable.h"
 #include "convolution_component.h"
+#include "stopwatch.h"
 #include "token_matrix.h"
 #include "table_of_token_codes.h"
 
@@ -35,6 +36,14 @@ namespace ANN {
   // ConvolutionANNComponent implementation //
   ////////////////////////////////////////////
 
+  namespace {
+    /// Larger kernels (counting input planes) use the unrolled convolution
+    /// when auto-selected, direct convolution is faster for few planes.
+    const unsigned int MAX_DIRECT_KERNEL_SIZE = 75u;
+  }
+
+  bool ConvolutionANNComponent::benchmark_mode = false;
+
   void ConvolutionANNComponent::initializeArrays(const int *input_dims) {
     for (int i=2; i<=input_num_dims; ++i) {
       output_dims[i] = (input_dims[i] - kernel_dims[i])/kernel_step[i] + 1;
@@ -75,9 +84,13 @@ namespace ANN {
 						   int num_output_planes,
 						   const char *name,
 						   const char *weights_name,
-                                                   MatrixFloat *matrix) :
+                                                   MatrixFloat *matrix,
+                                                   Kernels::ConvolutionAlgorithm algorithm) :
     VirtualMatrixANNComponent(name, weights_name, 0, 0),
     weights_matrix(matrix),
+    algorithm(algorithm),
+    selected_algorithm(Kernels::CONV_GEMM),
+    benchmark_pending(false),
     number_input_windows(0),
     kernel_size(1),
     hidden_size(num_output_planes),
@@ -115,6 +128,14 @@ namespace ANN {
     output_window_rewrap[0] = 0;
     output_window_rewrap[1] = static_cast<int>(hidden_size);
     if (weights_matrix) IncRef(weights_matrix);
+    if (!Kernels::isConvolutionAlgorithmSupported(algorithm, input_num_dims,
+                                                  kernel_dims+1,
+                                                  kernel_step+1)) {
+      ERROR_EXIT2(128, "Convolution algorithm %s not supported by the given "
+                  "kernel and step [%s]\n",
+                  Kernels::getConvolutionAlgorithmName(algorithm),
+                  this->name.c_str());
+    }
   }
   
   ConvolutionANNComponent::~ConvolutionANNComponent() {
@@ -131,28 +152,18 @@ namespace ANN {
     delete[] output_window_rewrap;
   }
   
-  MatrixFloat *ConvolutionANNComponent::
-  privateDoForward(MatrixFloat *input_mat, bool during_training) {
-    UNUSED_VARIABLE(during_training);
-    if (weights_matrix == 0) ERROR_EXIT1(129, "Not built component %s\n",
-					 name.c_str());
-    MatrixFloat *weights_mat = weights_matrix;
-    // error checking
-    if (input_mat->getNumDim() != input_num_dims+1)
-      ERROR_EXIT3(129, "Incorrect input matrix numDims, "
-		  "expected %d, found %d [%s]\n", input_num_dims+1,
-		  input_mat->getNumDim(), name.c_str());
-    const int *input_dims = input_mat->getDimPtr();
-    initializeArrays(input_dims);
-    MatrixFloat *output_mat;
-    output_mat = new MatrixFloat(input_num_dims+1, output_dims);
-    IncRef(output_mat);
+  bool ConvolutionANNComponent::
+  useConvolutionKernels(Kernels::ConvolutionAlgorithm alg) const {
 #ifdef USE_CUDA
-    output_mat->setUseCuda(use_cuda);
+    if (use_cuda) return false;
 #endif
-    
-    /////////////////////////////////////////////////////////////////////////
+    return alg != Kernels::CONV_GEMM &&
+      weights_matrix->getIsContiguous();
+  }
 
+  void ConvolutionANNComponent::forwardUnrolled(MatrixFloat *input_mat,
+                                                MatrixFloat *output_mat) {
+    MatrixFloat *weights_mat = weights_matrix;
     // Prepare sliding windows to compute the convolution
     MatrixFloat::sliding_window *input_sw =
       new MatrixFloat::sliding_window(input_mat, input_window_size,
@@ -213,6 +224,69 @@ namespace ANN {
     DecRef(output_w);
     delete input_sw;
     delete output_sw;
+  }
+
+  void ConvolutionANNComponent::forwardWith(Kernels::ConvolutionAlgorithm alg,
+                                            MatrixFloat *input_mat,
+                                            MatrixFloat *output_mat) {
+    if (useConvolutionKernels(alg)) {
+      Kernels::applyConvolution2D(output_mat, input_mat, weights_matrix,
+                                  kernel_dims[2], kernel_dims[3],
+                                  kernel_step[2], kernel_step[3], alg);
+      // same number of windows as the unrolled convolution
+      number_input_windows = output_dims[2] * output_dims[3];
+    }
+    else {
+      forwardUnrolled(input_mat, output_mat);
+    }
+  }
+
+  void ConvolutionANNComponent::selectFastestAlgorithm(MatrixFloat *input_mat,
+                                                       MatrixFloat *output_mat) {
+    benchmark_pending = false;
+    double best_time = 0.0;
+    for (int i=Kernels::CONV_GEMM; i<Kernels::CONV_NUM_ALGORITHMS; ++i) {
+      Kernels::ConvolutionAlgorithm alg =
+        static_cast<Kernels::ConvolutionAlgorithm>(i);
+      if (!Kernels::isConvolutionAlgorithmSupported(alg, input_num_dims,
+                                                    kernel_dims+1,
+                                                    kernel_step+1)) continue;
+      // first call warms up caches and memory allocations
+      forwardWith(alg, input_mat, output_mat);
+      AprilUtils::stopwatch watch;
+      watch.go();
+      forwardWith(alg, input_mat, output_mat);
+      watch.stop();
+      if (i == Kernels::CONV_GEMM || watch.read_wall_time() < best_time) {
+        best_time = watch.read_wall_time();
+        selected_algorithm = alg;
+      }
+    }
+    // the measured algorithm is kept by clone() and serialization
+    algorithm = selected_algorithm;
+  }
+  
+  MatrixFloat *ConvolutionANNComponent::
+  privateDoForward(MatrixFloat *input_mat, bool during_training) {
+    UNUSED_VARIABLE(during_training);
+    if (weights_matrix == 0) ERROR_EXIT1(129, "Not built component %s\n",
+					 name.c_str());
+    // error checking
+    if (input_mat->getNumDim() != input_num_dims+1)
+      ERROR_EXIT3(129, "Incorrect input matrix numDims, "
+		  "expected %d, found %d [%s]\n", input_num_dims+1,
+		  input_mat->getNumDim(), name.c_str());
+    const int *input_dims = input_mat->getDimPtr();
+    initializeArrays(input_dims);
+    MatrixFloat *output_mat;
+    output_mat = new MatrixFloat(input_num_dims+1, output_dims);
+    IncRef(output_mat);
+#ifdef USE_CUDA
+    output_mat->setUseCuda(use_cuda);
+#endif
+    
+    if (benchmark_pending) selectFastestAlgorithm(input_mat, output_mat);
+    forwardWith(selected_algorithm, input_mat, output_mat);
     ReleaseRef(output_mat);
     return output_mat;
   }
@@ -227,6 +301,18 @@ namespace ANN {
 		  name.c_str());
     MatrixFloat *error_output_mat = input_mat->cloneOnlyDims();
     IncRef(error_output_mat);
+    if (useConvolutionKernels(selected_algorithm)) {
+      SharedPtr<MatrixFloat> error_input_contiguous =
+        error_input_mat->getIsContiguous() ? error_input_mat :
+        error_input_mat->clone();
+      Kernels::applyConvolution2DBackprop(error_output_mat,
+                                          error_input_contiguous.get(),
+                                          weights_mat,
+                                          kernel_dims[2], kernel_dims[3],
+                                          kernel_step[2], kernel_step[3]);
+      ReleaseRef(error_output_mat);
+      return error_output_mat;
+    }
     // initialization of error_output_mat is needed because of kernel
     // overlapping
     matZeros(error_output_mat);
@@ -311,6 +397,17 @@ namespace ANN {
 #endif
     MatrixFloat *input_mat       = getInputMatrix();
     MatrixFloat *error_input_mat = getErrorInputMatrix();
+    if (useConvolutionKernels(selected_algorithm) &&
+        grads_mat->getIsContiguous()) {
+      SharedPtr<MatrixFloat> error_input_contiguous =
+        error_input_mat->getIsContiguous() ? error_input_mat :
+        error_input_mat->clone();
+      Kernels::computeConvolution2DGradients(grads_mat, input_mat,
+                                             error_input_contiguous.get(),
+                                             kernel_dims[2], kernel_dims[3],
+                                             kernel_step[2], kernel_step[3]);
+      return;
+    }
     // Prepare sliding windows to compute the convolution
     MatrixFloat::sliding_window input_sw(input_mat, input_window_size,
 					 0,  // OFFSET
@@ -365,7 +462,8 @@ namespace ANN {
     UNUSED_VARIABLE(copies);
     ConvolutionANNComponent *component = new
       ConvolutionANNComponent(input_num_dims, kernel_dims+1, kernel_step+1,
-                              hidden_size, name.c_str(), weights_name.c_str());
+                              hidden_size, name.c_str(), weights_name.c_str(),
+                              0, algorithm);
     component->input_size     = input_size;
     component->output_size    = output_size;
     return component;
@@ -404,6 +502,28 @@ namespace ANN {
       // else printf("USING PREVIOUS WEIGHTS %s\n", weights_name.c_str());
       weights_dict.put(weights_name.c_str(), weights_matrix);
     }
+    // algorithm selection
+    selected_algorithm = algorithm;
+    benchmark_pending  = false;
+    if (algorithm == Kernels::CONV_AUTO) {
+      if (Kernels::isConvolutionAlgorithmSupported(Kernels::CONV_WINOGRAD,
+                                                   input_num_dims,
+                                                   kernel_dims+1,
+                                                   kernel_step+1)) {
+        selected_algorithm = Kernels::CONV_WINOGRAD;
+      }
+      else if (Kernels::isConvolutionAlgorithmSupported(Kernels::CONV_DIRECT,
+                                                        input_num_dims,
+                                                        kernel_dims+1,
+                                                        kernel_step+1) &&
+               kernel_size <= MAX_DIRECT_KERNEL_SIZE) {
+        selected_algorithm = Kernels::CONV_DIRECT;
+      }
+      else {
+        selected_algorithm = Kernels::CONV_GEMM;
+      }
+      benchmark_pending = benchmark_mode;
+    }
   }
 
   void ConvolutionANNComponent::copyWeights(AprilUtils::LuaTable &weights_dict) {
@@ -432,6 +552,7 @@ namespace ANN {
     t["n"] = hidden_size;
     t["kernel"] = kernel;
     t["step"] = step;
+    t["algorithm"] = Kernels::getConvolutionAlgorithmName(algorithm);
     for (int i=1; i<=input_num_dims; ++i) {
       kernel[i] = kernel_dims[i];
       step[i]   = kernel_step[i];
@@ -25,15 +25,31 @@
 #include "cblas_headers.h"
 #include "matrix_component.h"
 #include "connection.h"
+#include "convolution_kernels.h"
 
 namespace ANN {
 
   /// A component which computes a convolutional layer using given kernel size
   /// and step, and the given number of output planes.
+  ///
+  /// Bi-dimensional convolutions (kernels of PxRxS) can be computed with
+  /// direct or Winograd kernels instead of unrolling every window (GEMM, the
+  /// default). With CONV_AUTO the algorithm is chosen at build(), and in
+  /// benchmark mode (see setBenchmarkMode()) the first forward measures all
+  /// the supported algorithms and keeps the fastest one.
   class ConvolutionANNComponent : public VirtualMatrixANNComponent {
     APRIL_DISALLOW_COPY_AND_ASSIGN(ConvolutionANNComponent);
     
+    static bool benchmark_mode;
+
     Basics::MatrixFloat *weights_matrix;
+
+    /// The algorithm given at constructor (or measured in benchmark mode)
+    Kernels::ConvolutionAlgorithm algorithm;
+    /// The algorithm used by forward, backprop and gradients
+    Kernels::ConvolutionAlgorithm selected_algorithm;
+    /// True when the first forward has to measure the algorithms
+    bool benchmark_pending;
     
     // parameters of the convolution
     
@@ -86,6 +102,23 @@ namespace ANN {
     }
     
     void initializeArrays(const int *input_dims);
+
+    /// True when the given algorithm kernels can be used with the current
+    /// weights and device.
+    bool useConvolutionKernels(Kernels::ConvolutionAlgorithm alg) const;
+
+    /// Computes the convolution unrolling every input window.
+    void forwardUnrolled(Basics::MatrixFloat *input_mat,
+                         Basics::MatrixFloat *output_mat);
+
+    /// Computes the convolution with the given algorithm.
+    void forwardWith(Kernels::ConvolutionAlgorithm alg,
+                     Basics::MatrixFloat *input_mat,
+                     Basics::MatrixFloat *output_mat);
+
+    /// Measures every supported algorithm and selects the fastest one.
+    void selectFastestAlgorithm(Basics::MatrixFloat *input_mat,
+                                Basics::MatrixFloat *output_mat);
     
   protected:
 
@@ -102,7 +135,8 @@ namespace ANN {
 			    const int *_kernel_step,  // step
 			    int num_output_planes,      // hidden layer size
 			    const char *name=0, const char *weights_name=0,
-                            Basics::MatrixFloat *matrix=0);
+                            Basics::MatrixFloat *matrix=0,
+                            Kernels::ConvolutionAlgorithm algorithm=Kernels::CONV_GEMM);
     virtual ~ConvolutionANNComponent();
     virtual void precomputeOutputSize(const AprilUtils::vector<unsigned int> &input_size,
 				      AprilUtils::vector<unsigned int> &output_size) {
@@ -124,6 +158,16 @@ namespace ANN {
       return kernel_dims + 1;
     }
 
+    /// Returns the algorithm in use, it is known after build().
+    Kernels::ConvolutionAlgorithm getAlgorithm() const {
+      return selected_algorithm;
+    }
+
+    /// Enables the measurement of algorithms in components built with
+    /// CONV_AUTO.
+    static void setBenchmarkMode(bool v) { benchmark_mode = v; }
+    static bool getBenchmarkMode() { return benchmark_mode; }
+
     virtual const char *luaCtorName() const;
     virtual int exportParamsToLua(lua_State *L);
   };
@@ -0,0 +1,445 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include <cstring>
+
+#include "april_assert.h"
+#include "cblas_headers.h"
+#include "convolution_kernels.h"
+#include "error_print.h"
+#include "maxmin.h"
+#include "omp_utils.h"
+#include "smart_ptr.h"
+
+using namespace AprilMath;
+using namespace Basics;
+
+namespace ANN {
+  namespace Kernels {
+
+    namespace {
+      const char *ALGORITHM_NAMES[CONV_NUM_ALGORITHMS] = {
+        "auto", "gemm", "direct", "winograd"
+      };
+
+      /// Output rows are computed in blocks of about this number of floats.
+      const int OUTPUT_BLOCK_SIZE = 2048;
+      /// Winograd F(2x2,3x3) tiles are 4x4, every tile gives a 2x2 output.
+      const int WINOGRAD_TILE = 16;
+
+      /// Tasks are computed in parallel when the whole work is large enough.
+      bool useParallelTasks(int num_tasks, size_t task_size) {
+        return OMPUtils::get_num_threads() > 1 && num_tasks > 1 &&
+          static_cast<size_t>(num_tasks)*task_size >=
+          OMPUtils::get_parallel_threshold();
+      }
+
+      const float *getReadPtr(const MatrixFloat *m) {
+        return m->getRawDataAccess()->getPPALForRead() + m->getOffset();
+      }
+
+      float *getWritePtr(MatrixFloat *m) {
+        return m->getRawDataAccess()->getPPALForWrite() + m->getOffset();
+      }
+
+      float *getReadAndWritePtr(MatrixFloat *m) {
+        return m->getRawDataAccess()->getPPALForReadAndWrite() + m->getOffset();
+      }
+
+      void checkMatrices(const MatrixFloat *a, const MatrixFloat *b,
+                         const MatrixFloat *weights,
+                         int kernel_h, int kernel_w) {
+        if (a->getNumDim() != 4 || b->getNumDim() != 4 ||
+            weights->getNumDim() != 2) {
+          ERROR_EXIT(128, "Expected 4-dimensional input/output matrices and "
+                     "2-dimensional weights\n");
+        }
+        if (!a->getIsContiguous() || !b->getIsContiguous() ||
+            !weights->getIsContiguous()) {
+          ERROR_EXIT(128, "Needs contiguous matrices\n");
+        }
+        if (a->getDimSize(0) != b->getDimSize(0) ||
+            weights->getDimSize(0) != a->getDimSize(1) ||
+            weights->getDimSize(1) != b->getDimSize(1)*kernel_h*kernel_w) {
+          ERROR_EXIT(128, "Incorrect matrix sizes\n");
+        }
+#ifdef USE_CUDA
+        if (a->getCudaFlag() || b->getCudaFlag() || weights->getCudaFlag()) {
+          ERROR_EXIT(128, "Not implemented for CUDA matrices\n");
+        }
+#endif
+      }
+
+      /// Direct forward, every task computes one output plane.
+      void directForward(MatrixFloat *output, const MatrixFloat *input,
+                         const MatrixFloat *weights,
+                         int R, int S, int step_h, int step_w) {
+        const int B = input->getDimSize(0), P = input->getDimSize(1);
+        const int H = input->getDimSize(2), W = input->getDimSize(3);
+        const int K = output->getDimSize(1);
+        const int OH = output->getDimSize(2), OW = output->getDimSize(3);
+        const int plane_in = H*W, plane_out = OH*OW, kernel_size = P*R*S;
+        const int rows_block = AprilUtils::max(1, OUTPUT_BLOCK_SIZE / OW);
+        const float *x = getReadPtr(input);
+        const float *w = getReadPtr(weights);
+        float *y = getWritePtr(output);
+#ifndef NO_OMP
+#pragma omp parallel for if(useParallelTasks(B*K, static_cast<size_t>(plane_out)*kernel_size))
+#endif
+        for (int bk=0; bk<B*K; ++bk) {
+          const int b = bk / K, k = bk % K;
+          const float *xb = x + b*P*plane_in;
+          const float *wk = w + k*kernel_size;
+          float *yp = y + bk*plane_out;
+          // a block of output rows is updated with every kernel weight
+          for (int oy0=0; oy0<OH; oy0+=rows_block) {
+            const int oy1 = AprilUtils::min(OH, oy0+rows_block);
+            memset(yp + oy0*OW, 0, sizeof(float)*(oy1-oy0)*OW);
+            for (int p=0; p<P; ++p) {
+              for (int r=0; r<R; ++r) {
+                for (int s=0; s<S; ++s) {
+                  const float wv = wk[(p*R + r)*S + s];
+                  const float *xp = xb + p*plane_in + r*W + s;
+                  for (int oy=oy0; oy<oy1; ++oy) {
+                    float *yrow = yp + oy*OW;
+                    const float *xrow = xp + oy*step_h*W;
+                    if (step_w == 1) {
+                      for (int ox=0; ox<OW; ++ox) yrow[ox] += wv*xrow[ox];
+                    }
+                    else {
+                      for (int ox=0; ox<OW; ++ox) yrow[ox] += wv*xrow[ox*step_w];
+                    }
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+
+      /// Copies every window of one pattern into a column of a
+      /// (PxRxS)x(OHxOW) matrix.
+      void imageToColumns(float *cols, const float *x,
+                          int P, int H, int W, int R, int S,
+                          int step_h, int step_w, int OH, int OW) {
+        const int plane_out = OH*OW;
+#ifndef NO_OMP
+#pragma omp parallel for if(useParallelTasks(P, static_cast<size_t>(plane_out)*R*S))
+#endif
+        for (int p=0; p<P; ++p) {
+          for (int r=0; r<R; ++r) {
+            for (int s=0; s<S; ++s) {
+              float *row = cols + ((p*R + r)*S + s)*plane_out;
+              const float *xp = x + p*H*W + r*W + s;
+              for (int oy=0; oy<OH; ++oy) {
+                const float *xrow = xp + oy*step_h*W;
+                for (int ox=0; ox<OW; ++ox) row[oy*OW + ox] = xrow[ox*step_w];
+              }
+            }
+          }
+        }
+      }
+
+      /// Inverse of imageToColumns(), overlapping windows are added and
+      /// the image is overwritten.
+      void addColumnsToImage(float *x, const float *cols,
+                             int P, int H, int W, int R, int S,
+                             int step_h, int step_w, int OH, int OW) {
+        const int plane_out = OH*OW;
+#ifndef NO_OMP
+#pragma omp parallel for if(useParallelTasks(P, static_cast<size_t>(plane_out)*R*S))
+#endif
+        for (int p=0; p<P; ++p) {
+          float *xp = x + p*H*W;
+          memset(xp, 0, sizeof(float)*H*W);
+          for (int r=0; r<R; ++r) {
+            for (int s=0; s<S; ++s) {
+              const float *row = cols + ((p*R + r)*S + s)*plane_out;
+              for (int oy=0; oy<OH; ++oy) {
+                float *xrow = xp + (oy*step_h + r)*W + s;
+                for (int ox=0; ox<OW; ++ox) xrow[ox*step_w] += row[oy*OW + ox];
+              }
+            }
+          }
+        }
+      }
+
+      /// Transforms every 3x3 kernel g into G g G^T.
+      void winogradKernelTransform(float *U, const float *w, int K, int P) {
+#ifndef NO_OMP
+#pragma omp parallel for if(useParallelTasks(K*P, WINOGRAD_TILE*3))
+#endif
+        for (int kp=0; kp<K*P; ++kp) {
+          const float *g = w + kp*9;
+          float t[4][3];
+          for (int j=0; j<3; ++j) {
+            t[0][j] = g[j];
+            t[1][j] = 0.5f*(g[j] + g[3+j] + g[6+j]);
+            t[2][j] = 0.5f*(g[j] - g[3+j] + g[6+j]);
+            t[3][j] = g[6+j];
+          }
+          for (int i=0; i<4; ++i) {
+            const float u[4] = {
+              t[i][0],
+              0.5f*(t[i][0] + t[i][1] + t[i][2]),
+              0.5f*(t[i][0] - t[i][1] + t[i][2]),
+              t[i][2]
+            };
+            // U is stored as 16 matrices of KxP
+            for (int j=0; j<4; ++j) U[(i*4 + j)*K*P + kp] = u[j];
+          }
+        }
+      }
+
+      /// Transforms every 4x4 input tile d into B^T d B.
+      void winogradInputTransform(float *V, const float *x,
+                                  int P, int H, int W, int TH, int TW) {
+        const int T = TH*TW;
+#ifndef NO_OMP
+#pragma omp parallel for if(useParallelTasks(P, static_cast<size_t>(T)*WINOGRAD_TILE))
+#endif
+        for (int p=0; p<P; ++p) {
+          const float *xp = x + p*H*W;
+          for (int th=0; th<TH; ++th) {
+            for (int tw=0; tw<TW; ++tw) {
+              float d[4][4];
+              for (int i=0; i<4; ++i) {
+                const int y = 2*th + i;
+                for (int j=0; j<4; ++j) {
+                  const int xx = 2*tw + j;
+                  d[i][j] = (y < H && xx < W) ? xp[y*W + xx] : 0.0f;
+                }
+              }
+              float t[4][4];
+              for (int j=0; j<4; ++j) {
+                t[0][j] = d[0][j] - d[2][j];
+                t[1][j] = d[1][j] + d[2][j];
+                t[2][j] = d[2][j] - d[1][j];
+                t[3][j] = d[1][j] - d[3][j];
+              }
+              const int tile = th*TW + tw;
+              for (int i=0; i<4; ++i) {
+                const float v[4] = {
+                  t[i][0] - t[i][2],
+                  t[i][1] + t[i][2],
+                  t[i][2] - t[i][1],
+                  t[i][1] - t[i][3]
+                };
+                // V is stored as 16 matrices of PxT
+                for (int j=0; j<4; ++j) V[((i*4 + j)*P + p)*T + tile] = v[j];
+              }
+            }
+          }
+        }
+      }
+
+      /// Transforms every 4x4 tile m into the 2x2 output A^T m A.
+      void winogradOutputTransform(float *y, const float *M,
+                                   int K, int OH, int OW, int TH, int TW) {
+        const int T = TH*TW;
+#ifndef NO_OMP
+#pragma omp parallel for if(useParallelTasks(K, static_cast<size_t>(T)*WINOGRAD_TILE))
+#endif
+        for (int k=0; k<K; ++k) {
+          float *yk = y + k*OH*OW;
+          for (int th=0; th<TH; ++th) {
+            for (int tw=0; tw<TW; ++tw) {
+              const int tile = th*TW + tw;
+              float m[4][4];
+              for (int i=0; i<WINOGRAD_TILE; ++i) {
+                m[i/4][i%4] = M[(i*K + k)*T + tile];
+              }
+              float t[2][4];
+              for (int j=0; j<4; ++j) {
+                t[0][j] = m[0][j] + m[1][j] + m[2][j];
+                t[1][j] = m[1][j] - m[2][j] - m[3][j];
+              }
+              for (int i=0; i<2; ++i) {
+                const int oy = 2*th + i;
+                if (oy >= OH) break;
+                const float o[2] = {
+                  t[i][0] + t[i][1] + t[i][2],
+                  t[i][1] - t[i][2] - t[i][3]
+                };
+                for (int j=0; j<2 && 2*tw + j < OW; ++j) {
+                  yk[oy*OW + 2*tw + j] = o[j];
+                }
+              }
+            }
+          }
+        }
+      }
+
+      /**
+       * Winograd F(2x2,3x3) forward. The element-wise products of the
+       * transformed tiles are computed as 16 matrix multiplications of
+       * (KxP) x (PxT) for every pattern, where T is the number of tiles.
+       */
+      void winogradForward(MatrixFloat *output, const MatrixFloat *input,
+                           const MatrixFloat *weights) {
+        const int B = input->getDimSize(0), P = input->getDimSize(1);
+        const int H = input->getDimSize(2), W = input->getDimSize(3);
+        const int K = output->getDimSize(1);
+        const int OH = output->getDimSize(2), OW = output->getDimSize(3);
+        const int TH = (OH + 1)/2, TW = (OW + 1)/2, T = TH*TW;
+        int dims[3] = { WINOGRAD_TILE, K, P };
+        AprilUtils::SharedPtr<MatrixFloat> U( new MatrixFloat(3, dims) );
+        dims[1] = P; dims[2] = T;
+        AprilUtils::SharedPtr<MatrixFloat> V( new MatrixFloat(3, dims) );
+        dims[1] = K;
+        AprilUtils::SharedPtr<MatrixFloat> M( new MatrixFloat(3, dims) );
+        winogradKernelTransform(getWritePtr(U.get()), getReadPtr(weights), K, P);
+        const float *x = getReadPtr(input);
+        float *y = getWritePtr(output);
+        for (int b=0; b<B; ++b) {
+          winogradInputTransform(getWritePtr(V.get()), x + b*P*H*W,
+                                 P, H, W, TH, TW);
+          for (int i=0; i<WINOGRAD_TILE; ++i) {
+            doGemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+                   K, T, P,
+                   1.0f, U->getRawDataAccess(), P,
+                   V->getRawDataAccess(), T,
+                   0.0f, M->getRawDataAccess(), T,
+                   i*K*P, i*P*T, i*K*T,
+                   false);
+          }
+          winogradOutputTransform(y + b*K*OH*OW, getReadPtr(M.get()),
+                                  K, OH, OW, TH, TW);
+        }
+      }
+    } // anonymous namespace
+
+    const char *getConvolutionAlgorithmName(ConvolutionAlgorithm algorithm) {
+      april_assert(algorithm >= CONV_AUTO && algorithm < CONV_NUM_ALGORITHMS);
+      return ALGORITHM_NAMES[algorithm];
+    }
+
+    ConvolutionAlgorithm getConvolutionAlgorithmFromString(const char *name) {
+      for (int i=0; i<CONV_NUM_ALGORITHMS; ++i) {
+        if (!strcmp(name, ALGORITHM_NAMES[i])) {
+          return static_cast<ConvolutionAlgorithm>(i);
+        }
+      }
+      return CONV_NUM_ALGORITHMS;
+    }
+
+    bool isConvolutionAlgorithmSupported(ConvolutionAlgorithm algorithm,
+                                         int num_dims,
+                                         const int *kernel,
+                                         const int *step) {
+      switch(algorithm) {
+      case CONV_AUTO:
+      case CONV_GEMM:
+        return true;
+      case CONV_DIRECT:
+        return num_dims == 3;
+      case CONV_WINOGRAD:
+        return num_dims == 3 && kernel[1] == 3 && kernel[2] == 3 &&
+          step[1] == 1 && step[2] == 1;
+      default:
+        return false;
+      }
+    }
+
+    void applyConvolution2D(MatrixFloat *output,
+                            const MatrixFloat *input,
+                            const MatrixFloat *weights,
+                            int kernel_h, int kernel_w,
+                            int step_h, int step_w,
+                            ConvolutionAlgorithm algorithm) {
+      checkMatrices(output, input, weights, kernel_h, kernel_w);
+      switch(algorithm) {
+      case CONV_DIRECT:
+        directForward(output, input, weights,
+                      kernel_h, kernel_w, step_h, step_w);
+        break;
+      case CONV_WINOGRAD:
+        if (kernel_h != 3 || kernel_w != 3 || step_h != 1 || step_w != 1) {
+          ERROR_EXIT(128, "Winograd convolution needs 3x3 kernels and "
+                     "step 1\n");
+        }
+        winogradForward(output, input, weights);
+        break;
+      default:
+        ERROR_EXIT1(128, "Unsupported convolution algorithm %s\n",
+                    getConvolutionAlgorithmName(algorithm));
+      }
+    }
+
+    void applyConvolution2DBackprop(MatrixFloat *error_output,
+                                    const MatrixFloat *error_input,
+                                    const MatrixFloat *weights,
+                                    int R, int S,
+                                    int step_h, int step_w) {
+      checkMatrices(error_input, error_output, weights, R, S);
+      const int B = error_output->getDimSize(0), P = error_output->getDimSize(1);
+      const int H = error_output->getDimSize(2), W = error_output->getDimSize(3);
+      const int K = error_input->getDimSize(1);
+      const int OH = error_input->getDimSize(2), OW = error_input->getDimSize(3);
+      const int plane_out = OH*OW, kernel_size = P*R*S;
+      int dims[2] = { kernel_size, plane_out };
+      AprilUtils::SharedPtr<MatrixFloat> cols( new MatrixFloat(2, dims) );
+      float *d = getWritePtr(error_output);
+      for (int b=0; b<B; ++b) {
+        // cols = W^T * E[b], every column has the error of one window
+        doGemm(CblasRowMajor, CblasTrans, CblasNoTrans,
+               kernel_size, plane_out, K,
+               1.0f, weights->getRawDataAccess(), kernel_size,
+               error_input->getRawDataAccess(), plane_out,
+               0.0f, cols->getRawDataAccess(), plane_out,
+               weights->getOffset(),
+               error_input->getOffset() + b*K*plane_out, 0,
+               false);
+        addColumnsToImage(d + b*P*H*W, getReadPtr(cols.get()),
+                          P, H, W, R, S, step_h, step_w, OH, OW);
+      }
+    }
+
+    void computeConvolution2DGradients(MatrixFloat *grads,
+                                       const MatrixFloat *input,
+                                       const MatrixFloat *error_input,
+                                       int R, int S,
+                                       int step_h, int step_w) {
+      checkMatrices(error_input, input, grads, R, S);
+      const int B = input->getDimSize(0), P = input->getDimSize(1);
+      const int H = input->getDimSize(2), W = input->getDimSize(3);
+      const int K = error_input->getDimSize(1);
+      const int OH = error_input->getDimSize(2), OW = error_input->getDimSize(3);
+      const int plane_out = OH*OW, kernel_size = P*R*S;
+      int dims[2] = { kernel_size, plane_out };
+      AprilUtils::SharedPtr<MatrixFloat> cols( new MatrixFloat(2, dims) );
+      const float *x = getReadPtr(input);
+      for (int b=0; b<B; ++b) {
+        imageToColumns(getWritePtr(cols.get()), x + b*P*H*W,
+                       P, H, W, R, S, step_h, step_w, OH, OW);
+        // grads += E[b] * cols^T
+        doGemm(CblasRowMajor, CblasNoTrans, CblasTrans,
+               K, kernel_size, plane_out,
+               1.0f, error_input->getRawDataAccess(), plane_out,
+               cols->getRawDataAccess(), plane_out,
+               1.0f, grads->getRawDataAccess(), kernel_size,
+               error_input->getOffset() + b*K*plane_out, 0,
+               grads->getOffset(),
+               false);
+      }
+    }
+
+  } // namespace Kernels
+} // namespace ANN
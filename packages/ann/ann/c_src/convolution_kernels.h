@@ -0,0 +1,107 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef CONVOLUTION_KERNELS_H
+#define CONVOLUTION_KERNELS_H
+
+#include "matrixFloat.h"
+
+namespace ANN {
+  namespace Kernels {
+
+    /**
+     * @brief Algorithms available for bi-dimensional convolutions.
+     *
+     * - CONV_GEMM unrolls every input window and multiplies it by the weights,
+     *   it works with any number of dimensions, steps and CUDA.
+     * - CONV_DIRECT computes the convolution planes in place, blocking output
+     *   rows to keep them in cache. It needs CPU and contiguous matrices.
+     * - CONV_WINOGRAD computes forward with Winograd F(2x2,3x3) (2.25 times
+     *   less multiplications), only for 3x3 kernels with step 1.
+     *
+     * With CONV_DIRECT and CONV_WINOGRAD, backprop and gradients unroll the
+     * windows of one pattern at a time, so the temporary memory doesn't grow
+     * with the bunch size.
+     */
+    enum ConvolutionAlgorithm {
+      CONV_AUTO=0, CONV_GEMM, CONV_DIRECT, CONV_WINOGRAD, CONV_NUM_ALGORITHMS
+    };
+
+    /// Returns the name of the given algorithm.
+    const char *getConvolutionAlgorithmName(ConvolutionAlgorithm algorithm);
+    /// Returns the algorithm of the given name, or CONV_NUM_ALGORITHMS.
+    ConvolutionAlgorithm getConvolutionAlgorithmFromString(const char *name);
+
+    /**
+     * @brief Indicates if the given algorithm can compute a convolution
+     * with the given kernel and step.
+     *
+     * @param num_dims - Number of input dims without the bunch (planes included).
+     * @param kernel - Kernel size at every dim (planes included).
+     * @param step - Step at every dim (planes included).
+     */
+    bool isConvolutionAlgorithmSupported(ConvolutionAlgorithm algorithm,
+                                         int num_dims,
+                                         const int *kernel,
+                                         const int *step);
+
+    /**
+     * @brief Computes the output of a bi-dimensional convolution.
+     *
+     * @param output - A BxKxOHxOW contiguous matrix.
+     * @param input - A BxPxHxW contiguous matrix.
+     * @param weights - A Kx(PxRxS) contiguous matrix.
+     * @param algorithm - CONV_DIRECT or CONV_WINOGRAD.
+     */
+    void applyConvolution2D(Basics::MatrixFloat *output,
+                            const Basics::MatrixFloat *input,
+                            const Basics::MatrixFloat *weights,
+                            int kernel_h, int kernel_w,
+                            int step_h, int step_w,
+                            ConvolutionAlgorithm algorithm);
+
+    /**
+     * @brief Computes the error at the input of a bi-dimensional convolution,
+     * @c error_output is overwritten.
+     *
+     * @see applyConvolution2D for the matrix sizes.
+     */
+    void applyConvolution2DBackprop(Basics::MatrixFloat *error_output,
+                                    const Basics::MatrixFloat *error_input,
+                                    const Basics::MatrixFloat *weights,
+                                    int kernel_h, int kernel_w,
+                                    int step_h, int step_w);
+
+    /**
+     * @brief Accumulates the weight gradients of a bi-dimensional
+     * convolution into @c grads.
+     *
+     * @see applyConvolution2D for the matrix sizes.
+     */
+    void computeConvolution2DGradients(Basics::MatrixFloat *grads,
+                                       const Basics::MatrixFloat *input,
+                                       const Basics::MatrixFloat *error_input,
+                                       int kernel_h, int kernel_w,
+                                       int step_h, int step_w);
+
+  } // namespace Kernels
+} // namespace ANN
+
+#endif // CONVOLUTION_KERNELS_H
@@ -0,0 +1,396 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include "data_parallel_component.h"
+#include "error_print.h"
+#include "matrix_ext.h"
+#include "omp_utils.h"
+#include "table_of_token_codes.h"
+
+using namespace AprilMath::MatrixExt::BLAS;
+using namespace AprilMath::MatrixExt::Initializers;
+using namespace AprilUtils;
+using namespace Basics;
+
+namespace ANN {
+
+  DataParallelANNComponent::DataParallelANNComponent(ANNComponent *component,
+                                                     unsigned int num_replicas,
+                                                     const char *name) :
+    ANNComponent(name, 0,
+                 component->getInputSize(), component->getOutputSize()),
+    num_replicas(num_replicas), num_active(0),
+    input(0), output(0), error_input(0), error_output(0) {
+    if (num_replicas == 0) ERROR_EXIT(128, "Needs at least one replica\n");
+    IncRef(component);
+    replicas.push_back(component);
+    for (unsigned int r=1; r<num_replicas; ++r) {
+      replicas.push_back(0);
+      replica_grads.push_back(new LuaTable());
+    }
+  }
+
+  DataParallelANNComponent::~DataParallelANNComponent() {
+    for (unsigned int r=0; r<replicas.size(); ++r) {
+      if (replicas[r] != 0) DecRef(replicas[r]);
+    }
+    for (unsigned int r=0; r<replica_grads.size(); ++r) {
+      delete replica_grads[r];
+    }
+    clearWeights();
+    if (input) DecRef(input);
+    if (output) DecRef(output);
+    if (error_input) DecRef(error_input);
+    if (error_output) DecRef(error_output);
+  }
+
+  void DataParallelANNComponent::clearWeights() {
+    for (unsigned int i=0; i<weights.size(); ++i) DecRef(weights[i]);
+    weights.clear();
+  }
+
+  unsigned int DataParallelANNComponent::computeSubBunches(int bunch_size) {
+    unsigned int n = AprilUtils::min(getNumUsableReplicas(),
+                                     static_cast<unsigned int>(bunch_size));
+    if (n == 0) n = 1;
+    int chunk = (bunch_size + static_cast<int>(n) - 1) / static_cast<int>(n);
+    sub_bunch_begin.clear();
+    for (int b=0; b<bunch_size; b+=chunk) sub_bunch_begin.push_back(b);
+    sub_bunch_begin.push_back(bunch_size);
+    return sub_bunch_begin.size() - 1;
+  }
+
+  void DataParallelANNComponent::splitRows(MatrixFloat *mat,
+                                           vector<Token*> &slices) {
+    vector<int> coords(mat->getNumDim(), 0);
+    vector<int> sizes(mat->getNumDim());
+    for (int i=0; i<mat->getNumDim(); ++i) sizes[i] = mat->getDimSize(i);
+    slices.clear();
+    for (unsigned int r=0; r<num_active; ++r) {
+      coords[0] = sub_bunch_begin[r];
+      sizes[0]  = sub_bunch_begin[r+1] - sub_bunch_begin[r];
+      MatrixFloat *slice = new MatrixFloat(mat, coords.begin(), sizes.begin(),
+                                           false);
+      Token *token = new TokenMatrixFloat(slice);
+      IncRef(token);
+      slices.push_back(token);
+    }
+  }
+
+  MatrixFloat *DataParallelANNComponent::joinRows(Token **slices,
+                                                  MatrixBuffer &buffer) {
+    for (unsigned int r=0; r<num_active; ++r) {
+      if (slices[r] == 0) return 0;
+      if (slices[r]->getTokenCode() != table_of_token_codes::token_matrix) {
+        ERROR_EXIT1(128, "Replicas must produce token matrix [%s]\n",
+                    name.c_str());
+      }
+    }
+    MatrixFloat *first = slices[0]->convertTo<TokenMatrixFloat*>()->getMatrix();
+    vector<int> dims(first->getNumDim());
+    for (int i=0; i<first->getNumDim(); ++i) dims[i] = first->getDimSize(i);
+    dims[0] = sub_bunch_begin[num_active];
+    MatrixFloat *result = buffer.get(dims.size(), dims.begin());
+    vector<int> coords(dims.size(), 0);
+    for (unsigned int r=0; r<num_active; ++r) {
+      MatrixFloat *mat = slices[r]->convertTo<TokenMatrixFloat*>()->getMatrix();
+      coords[0] = sub_bunch_begin[r];
+      dims[0]   = sub_bunch_begin[r+1] - sub_bunch_begin[r];
+      if (mat->getNumDim() != static_cast<int>(dims.size()) ||
+          mat->getDimSize(0) != dims[0]) {
+        ERROR_EXIT1(128, "Incorrect replica output dimensions [%s]\n",
+                    name.c_str());
+      }
+      SharedPtr<MatrixFloat> dest( new MatrixFloat(result, coords.begin(),
+                                                   dims.begin(), false) );
+      matCopy(dest.get(), mat);
+    }
+    return result;
+  }
+
+  void DataParallelANNComponent::checkReplicaErrors(vector<string> &errors,
+                                                    vector<Token*> &slices) {
+    for (unsigned int r=0; r<errors.size(); ++r) {
+      if (!errors[r].empty()) {
+        for (unsigned int i=0; i<slices.size(); ++i) DecRef(slices[i]);
+        ERROR_EXIT3(128, "Replica %u failed: %s [%s]\n",
+                    r+1, errors[r].c_str(), name.c_str());
+      }
+    }
+  }
+
+  Token *DataParallelANNComponent::doForward(Token* _input,
+                                             bool during_training) {
+    AssignRef(input, _input);
+    num_active = 1;
+    if (input->getTokenCode() == table_of_token_codes::token_matrix) {
+      MatrixFloat *input_mat = input->convertTo<TokenMatrixFloat*>()->getMatrix();
+      num_active = computeSubBunches(input_mat->getDimSize(0));
+    }
+    if (num_active == 1) {
+      Token *tk = replicas[0]->doForward(input, during_training);
+      if (num_replicas > 1 &&
+          tk->getTokenCode() == table_of_token_codes::token_matrix) {
+        // the output is declared as overwritable, so the replica output
+        // (needed by its doBackprop) is copied into the join buffer
+        MatrixFloat *mat = tk->convertTo<TokenMatrixFloat*>()->getMatrix();
+        MatrixFloat *output_mat = output_buffer.getLike(mat);
+        matCopy(output_mat, mat);
+        tk = new TokenMatrixFloat(output_mat);
+      }
+      AssignRef(output, tk);
+      return output;
+    }
+    vector<Token*> sub_inputs;
+    splitRows(input->convertTo<TokenMatrixFloat*>()->getMatrix(), sub_inputs);
+    vector<Token*> sub_outputs(num_active, 0);
+    int n = static_cast<int>(num_active);
+    // an exception can't leave the parallel region, the error messages of
+    // the replicas are kept and the first one is thrown after it
+    vector<string> errors(n);
+#ifndef NO_OMP
+    int num_threads = AprilUtils::min(n, OMPUtils::get_num_threads());
+#pragma omp parallel for schedule(static,1) num_threads(num_threads)
+#endif
+    for (int r=0; r<n; ++r) {
+      try {
+        sub_outputs[r] = replicas[r]->doForward(sub_inputs[r],
+                                                during_training);
+      }
+      catch (char *msg) { // thrown by ERROR_EXIT macros
+        errors[r] = msg;
+        delete[] msg;
+      }
+      catch (...) {
+        errors[r] = "unknown error";
+      }
+    }
+    checkReplicaErrors(errors, sub_inputs);
+    MatrixFloat *output_mat = joinRows(sub_outputs.begin(), output_buffer);
+    // sub-inputs are released after the join, replicas can return them
+    for (int r=0; r<n; ++r) DecRef(sub_inputs[r]);
+    if (output_mat == 0) {
+      ERROR_EXIT1(128, "Replicas must produce an output [%s]\n", name.c_str());
+    }
+    AssignRef<Token>(output, new TokenMatrixFloat(output_mat));
+    return output;
+  }
+
+  Token *DataParallelANNComponent::doBackprop(Token *_error_input) {
+    AssignRef(error_input, _error_input);
+    if (num_active == 1) {
+      Token *tk = replicas[0]->doBackprop(error_input);
+      if (tk != 0) AssignRef(error_output, tk);
+      else if (error_output != 0) { DecRef(error_output); error_output = 0; }
+      return error_output;
+    }
+    if (error_input->getTokenCode() != table_of_token_codes::token_matrix) {
+      ERROR_EXIT1(128, "Incorrect token type, expected token matrix [%s]\n",
+                  name.c_str());
+    }
+    MatrixFloat *error_input_mat =
+      error_input->convertTo<TokenMatrixFloat*>()->getMatrix();
+    if (error_input_mat->getDimSize(0) != sub_bunch_begin[num_active]) {
+      ERROR_EXIT1(128, "Incorrect error input bunch size [%s]\n", name.c_str());
+    }
+    vector<Token*> sub_errors;
+    splitRows(error_input_mat, sub_errors);
+    vector<Token*> sub_error_outputs(num_active, 0);
+    int n = static_cast<int>(num_active);
+    vector<string> errors(n);
+#ifndef NO_OMP
+    int num_threads = AprilUtils::min(n, OMPUtils::get_num_threads());
+#pragma omp parallel for schedule(static,1) num_threads(num_threads)
+#endif
+    for (int r=0; r<n; ++r) {
+      try {
+        sub_error_outputs[r] = replicas[r]->doBackprop(sub_errors[r]);
+      }
+      catch (char *msg) { // thrown by ERROR_EXIT macros
+        errors[r] = msg;
+        delete[] msg;
+      }
+      catch (...) {
+        errors[r] = "unknown error";
+      }
+    }
+    checkReplicaErrors(errors, sub_errors);
+    MatrixFloat *error_output_mat = joinRows(sub_error_outputs.begin(),
+                                             error_output_buffer);
+    for (int r=0; r<n; ++r) DecRef(sub_errors[r]);
+    if (error_output_mat != 0) {
+      AssignRef<Token>(error_output, new TokenMatrixFloat(error_output_mat));
+    }
+    else if (error_output != 0) {
+      DecRef(error_output);
+      error_output = 0;
+    }
+    return error_output;
+  }
+
+  void DataParallelANNComponent::reset(unsigned int it) {
+    if (input)        DecRef(input);
+    if (error_input)  DecRef(error_input);
+    if (output)       DecRef(output);
+    if (error_output) DecRef(error_output);
+    input        = 0;
+    error_input  = 0;
+    output       = 0;
+    error_output = 0;
+    for (unsigned int r=0; r<replicas.size(); ++r) {
+      if (replicas[r] != 0) replicas[r]->reset(it);
+    }
+  }
+
+  void DataParallelANNComponent::reduceGradients(MatrixFloat *dest,
+                                                 vector<MatrixFloat*> &grads) {
+    // pairwise sums, every level halves the number of partial gradients
+    int n = static_cast<int>(grads.size());
+    for (int step=1; step<n; step*=2) {
+      int num_pairs = (n - step + 2*step - 1) / (2*step);
+#ifndef NO_OMP
+#pragma omp parallel for if(num_pairs > 1)
+#endif
+      for (int p=0; p<num_pairs; ++p) {
+        int i = p*2*step;
+        matAxpy(grads[i], 1.0f, grads[i+step]);
+      }
+    }
+    matAxpy(dest, 1.0f, grads[0]);
+  }
+
+  void DataParallelANNComponent::computeAllGradients(LuaTable &weight_grads_dict) {
+    if (num_active <= 1) {
+      replicas[0]->computeAllGradients(weight_grads_dict);
+      return;
+    }
+    // every replica increases the shared count of the weights, but only the
+    // increase of the first one is kept
+    replicas[0]->computeAllGradients(weight_grads_dict);
+    vector<unsigned int> counts(weights.size());
+    for (unsigned int i=0; i<weights.size(); ++i) {
+      counts[i] = weights[i]->getSharedCount();
+    }
+    vector<string> names;
+    for (unsigned int r=1; r<num_active; ++r) {
+      LuaTable &grads = *replica_grads[r-1];
+      names.clear();
+      grads.getStringKeys(names);
+      for (unsigned int i=0; i<names.size(); ++i) {
+        matZeros(grads.get<MatrixFloat*>(names[i]));
+      }
+      replicas[r]->computeAllGradients(grads);
+    }
+    for (unsigned int i=0; i<weights.size(); ++i) {
+      weights[i]->resetSharedCount();
+      weights[i]->addToSharedCount(counts[i]);
+    }
+    // names are taken from the first replica, all of them are equal
+    names.clear();
+    replica_grads[0]->getStringKeys(names);
+    vector<MatrixFloat*> grads(num_active - 1);
+    for (unsigned int i=0; i<names.size(); ++i) {
+      for (unsigned int r=1; r<num_active; ++r) {
+        grads[r-1] = replica_grads[r-1]->get<MatrixFloat*>(names[i]);
+      }
+      MatrixFloat *dest = weight_grads_dict.opt<MatrixFloat*>(names[i], 0);
+      if (dest == 0) {
+        dest = grads[0]->cloneOnlyDims();
+        matZeros(dest);
+        weight_grads_dict.put(names[i], dest);
+      }
+      reduceGradients(dest, grads);
+    }
+  }
+
+  ANNComponent *DataParallelANNComponent::clone(LuaTable &copies) {
+    DataParallelANNComponent *obj =
+      new DataParallelANNComponent(replicas[0]->clone(copies), num_replicas,
+                                   name.c_str());
+    obj->input_size  = input_size;
+    obj->output_size = output_size;
+    return obj;
+  }
+
+  void DataParallelANNComponent::setUseCuda(bool v) {
+    if (v && num_replicas > 1) {
+      ERROR_EXIT1(128, "CUDA is not available with several replicas [%s]\n",
+                  name.c_str());
+    }
+    ANNComponent::setUseCuda(v);
+    for (unsigned int r=0; r<replicas.size(); ++r) {
+      if (replicas[r] != 0) replicas[r]->setUseCuda(v);
+    }
+  }
+
+  void DataParallelANNComponent::build(unsigned int _input_size,
+                                       unsigned int _output_size,
+                                       LuaTable &weights_dict,
+                                       LuaTable &components_dict) {
+    ANNComponent::build(_input_size, _output_size,
+                        weights_dict, components_dict);
+    replicas[0]->build(input_size, output_size, weights_dict, components_dict);
+    input_size  = replicas[0]->getInputSize();
+    output_size = replicas[0]->getOutputSize();
+    // replicas are built with the same weights dictionary, so they share the
+    // weight matrices, and with a private components dictionary because they
+    // repeat the names of the wrapped component; replicas run in concurrent
+    // threads, so they are only used when the wrapped component is thread
+    // safe (stochastic components share their random generator)
+    const unsigned int usable = getNumUsableReplicas();
+    for (unsigned int r=1; r<usable; ++r) {
+      if (replicas[r] == 0) {
+        LuaTable copies;
+        replicas[r] = replicas[0]->clone(copies);
+        IncRef(replicas[r]);
+      }
+      if (getUseCuda()) replicas[r]->setUseCuda(true);
+      LuaTable replica_components;
+      replicas[r]->build(input_size, output_size,
+                         weights_dict, replica_components);
+    }
+    // only the weights of the wrapped component, the given dictionary
+    // contains the weights of the whole network
+    clearWeights();
+    LuaTable component_weights;
+    replicas[0]->copyWeights(component_weights);
+    vector<string> names;
+    component_weights.getStringKeys(names);
+    for (unsigned int i=0; i<names.size(); ++i) {
+      MatrixFloat *w = component_weights.get<MatrixFloat*>(names[i]);
+      IncRef(w);
+      weights.push_back(w);
+    }
+  }
+
+  const char *DataParallelANNComponent::luaCtorName() const {
+    return "ann.components.data_parallel";
+  }
+  
+  int DataParallelANNComponent::exportParamsToLua(lua_State *L) {
+    LuaTable t(L);
+    t["name"] = name;
+    t["component"] = replicas[0];
+    t["replicas"] = num_replicas;
+    t.pushTable(L);
+    return 1;
+  }
+
+} // namespace ANN
@@ -0,0 +1,181 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef DATAPARALLELCOMPONENT_H
+#define DATAPARALLELCOMPONENT_H
+
+#include "ann_component.h"
+#include "lua_table.h"
+#include "matrix_buffer.h"
+#include "token_matrix.h"
+#include "vector.h"
+
+namespace ANN {
+
+  /**
+   * @brief Synchronous data-parallel execution of a component.
+   *
+   * The wrapped component is cloned into several replicas which share its
+   * weight matrices. The input bunch is split into contiguous sub-bunches,
+   * one for every replica, and doForward()/doBackprop() of the replicas are
+   * executed in parallel threads. Outputs and error outputs are joined back
+   * in the original order, so the component behaves as the wrapped one.
+   *
+   * Gradients of every replica are computed into private dictionaries and
+   * added together by a tree reduction into the given dictionary, so the
+   * optimizer sees the gradient of the whole bunch. The shared count of the
+   * weight matrices is the same as with only one replica.
+   *
+   * @note Gradients computation writes into AprilUtils::LuaTable
+   * dictionaries, and the Lua state is not thread safe, therefore replicas
+   * compute their gradients one after another (using the threads of the
+   * matrix operations), only the reduction is done in parallel.
+   *
+   * @note Non-matrix inputs are processed by the first replica alone, as
+   * well as every input when the wrapped component is not thread safe
+   * (getIsThreadSafe()), for instance stochastic components. CUDA is not
+   * allowed with more than one replica.
+   */
+  class DataParallelANNComponent : public ANNComponent {
+    APRIL_DISALLOW_COPY_AND_ASSIGN(DataParallelANNComponent);
+    
+    /// The wrapped component is replicas[0], the rest are built clones.
+    AprilUtils::vector<ANNComponent*> replicas;
+    /// Gradient dictionaries of replicas[1..], replicas[0] uses the given one.
+    AprilUtils::vector<AprilUtils::LuaTable*> replica_grads;
+    unsigned int num_replicas;
+    /// Number of replicas used by the last doForward() call.
+    unsigned int num_active;
+    /// First row of every sub-bunch, plus the bunch size.
+    AprilUtils::vector<int> sub_bunch_begin;
+    
+    /// Weight matrices given at build(), used to keep their shared count.
+    AprilUtils::vector<Basics::MatrixFloat*> weights;
+    
+    Basics::Token *input, *output, *error_input, *error_output;
+    MatrixBuffer output_buffer, error_output_buffer;
+    
+    void clearWeights();
+    /// Replicas run in concurrent threads, so only the wrapped component is
+    /// used when it is not thread safe.
+    unsigned int getNumUsableReplicas() const {
+      return replicas[0]->getIsThreadSafe() ? num_replicas : 1u;
+    }
+    /// Throws the error of the first failed replica, after releasing the
+    /// given slices.
+    void checkReplicaErrors(AprilUtils::vector<AprilUtils::string> &errors,
+                            AprilUtils::vector<Basics::Token*> &slices);
+    /// Splits the given bunch size and returns the number of sub-bunches.
+    unsigned int computeSubBunches(int bunch_size);
+    /// Returns a new reference for every row slice of the given matrix.
+    void splitRows(Basics::MatrixFloat *mat,
+                   AprilUtils::vector<Basics::Token*> &slices);
+    /// Joins the row slices returned by replicas into the given buffer.
+    Basics::MatrixFloat *joinRows(Basics::Token **slices, MatrixBuffer &buffer);
+    /// Adds replica gradients of the given weights name into @c dest.
+    void reduceGradients(Basics::MatrixFloat *dest,
+                         AprilUtils::vector<Basics::MatrixFloat*> &grads);
+    
+  public:
+    DataParallelANNComponent(ANNComponent *component,
+                             unsigned int num_replicas,
+                             const char *name=0);
+    virtual ~DataParallelANNComponent();
+    
+    ANNComponent *getWrappedComponent() { return replicas[0]; }
+    unsigned int getNumReplicas() const { return num_replicas; }
+    
+    virtual void precomputeOutputSize(const AprilUtils::vector<unsigned int> &input_size,
+				      AprilUtils::vector<unsigned int> &output_size) {
+      replicas[0]->precomputeOutputSize(input_size, output_size);
+    }
+    
+    virtual Basics::Token *getInput() { return input; }
+    virtual Basics::Token *getOutput() { return output; }
+    virtual Basics::Token *getErrorInput() { return error_input; }
+    virtual Basics::Token *getErrorOutput() { return error_output; }
+    
+    virtual void setInput(Basics::Token *tk) { AssignRef(input, tk); }
+    virtual void setOutput(Basics::Token *tk) { AssignRef(output, tk); }
+    virtual void setErrorInput(Basics::Token *tk) { AssignRef(error_input, tk); }
+    virtual void setErrorOutput(Basics::Token *tk) { AssignRef(error_output, tk); }
+    
+    virtual void copyState(AprilUtils::LuaTable &dict) {
+      ANNComponent::copyState(dict);
+      replicas[0]->copyState(dict);
+    }
+    
+    virtual void setState(AprilUtils::LuaTable &dict) {
+      ANNComponent::setState(dict);
+      replicas[0]->setState(dict);
+    }
+    
+    /// Replicas already use all the OMP threads.
+    virtual bool getIsThreadSafe() const { return false; }
+
+    virtual Basics::Token *doForward(Basics::Token* input, bool during_training);
+    
+    virtual Basics::Token *doBackprop(Basics::Token *input_error);
+    
+    virtual void reset(unsigned int it=0);
+    
+    virtual void computeAllGradients(AprilUtils::LuaTable &weight_grads_dict);
+    
+    virtual ANNComponent *clone(AprilUtils::LuaTable &copies);
+    
+    virtual void setUseCuda(bool v);
+    
+    /// With several replicas the output is a join buffer (or a copy, when
+    /// only one replica is active) which is not used at doBackprop(). With
+    /// one replica the output is the wrapped component output.
+    virtual bool isOutputOverwritable() const { return num_replicas > 1; }
+    
+    virtual void build(unsigned int input_size,
+		       unsigned int output_size,
+		       AprilUtils::LuaTable &weights_dict,
+		       AprilUtils::LuaTable &components_dict);
+    
+    virtual void copyWeights(AprilUtils::LuaTable &weights_dict) {
+      replicas[0]->copyWeights(weights_dict);
+    }
+    
+    virtual void copyComponents(AprilUtils::LuaTable &components_dict) {
+      ANNComponent::copyComponents(components_dict);
+      replicas[0]->copyComponents(components_dict);
+    }
+    
+    virtual ANNComponent *getComponent(AprilUtils::string &name) {
+      ANNComponent *component = ANNComponent::getComponent(name);
+      if (component == 0) component = replicas[0]->getComponent(name);
+      return component;
+    }
+    
+    virtual void debugInfo() {
+      ANNComponent::debugInfo();
+      replicas[0]->debugInfo();
+    }
+    
+    virtual const char *luaCtorName() const;
+    virtual int exportParamsToLua(lua_State *L);
+  };
+  
+} // namespace ANN
+
+#endif // DATAPARALLELCOMPONENT_H
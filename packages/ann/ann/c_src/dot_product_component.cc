@@ -73,7 +73,7 @@ namespace ANN {
     MatrixFloat *output_mat;
     int dims[2] = { static_cast<int>(bunch_size),
                     static_cast<int>(getOutputSize()) };
-    output_mat = new MatrixFloat(2, dims);
+    output_mat = output_buffer.get(2, dims);
 #ifdef USE_CUDA
     output_mat->setUseCuda(use_cuda);
 #endif
@@ -107,7 +107,7 @@ namespace ANN {
     MatrixFloat *output_mat;
     int dims[2] = {static_cast<int>(bunch_size),
                    static_cast<int>(getOutputSize())};
-    output_mat = new MatrixFloat(2, dims);
+    output_mat = output_buffer.get(2, dims);
 #ifdef USE_CUDA
     output_mat->setUseCuda(use_cuda);
 #endif
@@ -127,7 +127,7 @@ namespace ANN {
     MatrixFloat *error_output_mat;
     int dims[2] = { static_cast<int>(bunch_size),
 		    static_cast<int>(getInputSize()) };
-    error_output_mat = new MatrixFloat(2, dims);
+    error_output_mat = error_output_buffer.get(2, dims);
 #ifdef USE_CUDA
     error_output_mat->setUseCuda(use_cuda);
 #endif      
@@ -24,6 +24,7 @@
 
 #include "token_matrix.h"
 #include "cblas_headers.h"
+#include "matrix_buffer.h"
 #include "matrix_input_switch_component.h"
 #include "connection.h"
 
@@ -39,6 +40,9 @@ namespace ANN {
     /// learning parameters
     CBLAS_TRANSPOSE transpose_weights;
     
+    /// reused output and error output matrices
+    MatrixBuffer output_buffer, error_output_buffer;
+    
   protected:
     
     // from MatrixANNComponentHelper
@@ -68,6 +72,8 @@ namespace ANN {
 			   bool transpose_weights   = false,
                            Basics::MatrixFloat *matrix = 0);
     virtual ~DotProductANNComponent();
+    /// The output is not needed at doBackprop() neither at gradients
+    virtual bool isOutputOverwritable() const { return true; }
     virtual ANNComponent *clone(AprilUtils::LuaTable &copies);
     virtual void build(unsigned int input_size,
 		       unsigned int output_size,
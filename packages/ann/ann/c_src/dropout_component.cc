@@ -48,6 +48,24 @@ namespace ANN {
     normalize_after_training(normalize_after_training),
     size(size) {
   }
+
+  DropoutANNComponent::DropoutANNComponent(PhiloxRand *random,
+					   float value,
+					   float prob,
+                                           bool normalize_after_training,
+					   const char *name,
+					   unsigned int size) :
+    StochasticANNComponent(random, name, 0, size, size),
+    input(0),
+    output(0),
+    error_input(0),
+    error_output(0),
+    dropout_mask(0),
+    value(value),
+    prob(prob),
+    normalize_after_training(normalize_after_training),
+    size(size) {
+  }
   
   DropoutANNComponent::~DropoutANNComponent() {
     if (input) DecRef(input);
@@ -81,10 +99,17 @@ namespace ANN {
           dropout_mask = new MatrixFloat(1, input_mat->size());
           IncRef(dropout_mask);
         }
-        for (MatrixFloat::iterator it(dropout_mask->begin());
-             it != dropout_mask->end(); ++it) {
-          if (random->rand() < prob) *it = 0.0f;
-          else *it = 1.0f;
+        if (philox != 0) {
+          // units are kept with probability 1-prob
+          philox->fillBernoulli(dropout_mask->getRawDataAccess()->getPPALForWrite(),
+                                dropout_mask->size(), 1.0 - prob);
+        }
+        else {
+          for (MatrixFloat::iterator it(dropout_mask->begin());
+               it != dropout_mask->end(); ++it) {
+            if (random->rand() < prob) *it = 0.0f;
+            else *it = 1.0f;
+          }
         }
         // apply mask
         Kernels::applyDropoutMask(output_mat, dropout_mask, value);
@@ -146,15 +171,19 @@ namespace ANN {
   }
 
   ANNComponent *DropoutANNComponent::clone(AprilUtils::LuaTable &copies) {
-    MTRand *rng_clone = copies[getRandom()].opt<MTRand*>(0);
-    if (rng_clone == 0) {
-      copies[getRandom()] = rng_clone = new MTRand(*getRandom());
+    DropoutANNComponent *copy_component;
+    if (philox != 0) {
+      copy_component = new DropoutANNComponent(clonePhilox(copies),
+                                               value, prob,
+                                               normalize_after_training,
+                                               name.c_str(), size);
+    }
+    else {
+      copy_component = new DropoutANNComponent(cloneRandom(copies),
+                                               value, prob,
+                                               normalize_after_training,
+                                               name.c_str(), size);
     }
-    DropoutANNComponent *copy_component = new
-      DropoutANNComponent(rng_clone,
-			  value, prob, normalize_after_training,
-			  name.c_str(),
-			  size);
     return copy_component;
   }
 
@@ -181,7 +210,7 @@ namespace ANN {
     AprilUtils::LuaTable t(L);
     t["name"] = name;
     t["size"] = size;
-    t["random"] = random;
+    exportRandomToLua(t);
     t["value"] = value;
     t["prob"] = prob;
     t["norm"] = normalize_after_training;
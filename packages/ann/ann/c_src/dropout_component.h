@@ -48,6 +48,10 @@ namespace ANN {
                         bool normalize_after_training=true,
 			const char *name=0,
 			unsigned int size=0);
+    DropoutANNComponent(Basics::PhiloxRand *random, float value, float prob,
+                        bool normalize_after_training=true,
+			const char *name=0,
+			unsigned int size=0);
     virtual ~DropoutANNComponent();
     
     virtual Basics::Token *getInput() { return input; }
@@ -0,0 +1,257 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include "ensemble_component.h"
+#include "error_print.h"
+#include "matrix_ext.h"
+#include "omp_utils.h"
+#include "table_of_token_codes.h"
+#include "unused_variable.h"
+
+using namespace AprilMath::MatrixExt::BLAS;
+using namespace AprilMath::MatrixExt::Operations;
+using namespace AprilUtils;
+using namespace Basics;
+
+namespace ANN {
+
+  EnsembleANNComponent::EnsembleANNComponent(ANNComponent *component,
+                                             float tolerance,
+                                             unsigned int block_size,
+                                             const char *name) :
+    ANNComponent(name, 0,
+                 component->getInputSize(), component->getOutputSize()),
+    prototype(component), tolerance(tolerance), block_size(block_size),
+    num_used(0), input(0), output(0) {
+    if (block_size == 0) ERROR_EXIT(128, "Needs a positive block size\n");
+    if (tolerance < 0.0f) ERROR_EXIT(128, "Needs a non-negative tolerance\n");
+    IncRef(prototype);
+  }
+
+  EnsembleANNComponent::~EnsembleANNComponent() {
+    for (unsigned int m=0; m<members.size(); ++m) DecRef(members[m]);
+    for (unsigned int m=0; m<member_weights.size(); ++m) {
+      delete member_weights[m];
+    }
+    DecRef(prototype);
+    if (input) DecRef(input);
+    if (output) DecRef(output);
+  }
+
+  void EnsembleANNComponent::addMember(const LuaTable &weights) {
+    member_weights.push_back(new LuaTable(weights));
+  }
+
+  bool EnsembleANNComponent::useParallelMembers() const {
+    if (use_cuda || block_size == 1) return false;
+    for (unsigned int m=0; m<members.size(); ++m) {
+      if (!members[m]->getIsThreadSafe()) return false;
+    }
+    return true;
+  }
+
+  MatrixFloat *EnsembleANNComponent::accumulate(vector<Token*> &outputs,
+                                                unsigned int first,
+                                                unsigned int last,
+                                                MatrixFloat *sum) {
+    for (unsigned int m=first; m<last; ++m) {
+      if (outputs[m] == 0 ||
+          outputs[m]->getTokenCode() != table_of_token_codes::token_matrix) {
+        ERROR_EXIT1(128, "Members must produce token matrix [%s]\n",
+                    name.c_str());
+      }
+      MatrixFloat *mat = outputs[m]->convertTo<TokenMatrixFloat*>()->getMatrix();
+      if (sum == 0) {
+        sum = sum_buffer.getLike(mat);
+#ifdef USE_CUDA
+        sum->setUseCuda(use_cuda);
+#endif
+        matCopy(sum, mat);
+      }
+      else {
+        if (!sum->sameDim(mat)) {
+          ERROR_EXIT1(128, "Members produce outputs with different "
+                      "dimensions [%s]\n", name.c_str());
+        }
+        matAxpy(sum, 1.0f, mat);
+      }
+    }
+    return sum;
+  }
+
+  Token *EnsembleANNComponent::doForward(Token* _input, bool during_training) {
+    AssignRef(input, _input);
+    const unsigned int num_members = members.size();
+    const bool concurrent = useParallelMembers();
+    vector<Token*> outputs(num_members, 0);
+    MatrixFloat *sum = 0, *avg = 0, *previous = 0;
+    num_used = 0;
+    for (unsigned int first=0; first<num_members; first+=block_size) {
+      const unsigned int last = AprilUtils::min(first + block_size,
+                                                num_members);
+      const int n = static_cast<int>(last - first);
+      // an exception can't leave the parallel region, the error messages of
+      // the members are kept and the first one is thrown after it
+      vector<string> errors(n);
+#ifndef NO_OMP
+      int num_threads = AprilUtils::min(n, OMPUtils::get_num_threads());
+#pragma omp parallel for schedule(dynamic,1) num_threads(num_threads) if(concurrent)
+#else
+      UNUSED_VARIABLE(concurrent);
+#endif
+      for (int i=0; i<n; ++i) {
+        try {
+          outputs[first+i] = members[first+i]->doForward(input,
+                                                         during_training);
+        }
+        catch (char *msg) { // thrown by ERROR_EXIT macros
+          errors[i] = msg;
+          delete[] msg;
+        }
+        catch (...) {
+          errors[i] = "unknown error";
+        }
+      }
+      for (int i=0; i<n; ++i) {
+        if (!errors[i].empty()) {
+          ERROR_EXIT3(128, "Member %u failed: %s [%s]\n",
+                      first+i+1, errors[i].c_str(), name.c_str());
+        }
+      }
+      // members outputs are added in order, independently of the threads
+      sum = accumulate(outputs, first, last, sum);
+      num_used = last;
+      if (tolerance > 0.0f) {
+        avg = output_buffer.getLike(sum);
+        matCopy(avg, sum);
+        matScal(avg, 1.0f/num_used);
+        if (previous != 0) {
+          // previous = previous - avg, the change of the running average
+          matAxpy(previous, -1.0f, avg);
+          if (matNorm2(previous) <= tolerance * matNorm2(avg)) break;
+        }
+        previous = previous_buffer.getLike(avg);
+        matCopy(previous, avg);
+      }
+    }
+    if (sum == 0) ERROR_EXIT1(128, "Ensemble without members [%s]\n",
+                              name.c_str());
+    avg = output_buffer.getLike(sum);
+#ifdef USE_CUDA
+    avg->setUseCuda(use_cuda);
+#endif
+    matCopy(avg, sum);
+    matScal(avg, 1.0f/num_used);
+    AssignRef(output, new TokenMatrixFloat(avg));
+    return output;
+  }
+
+  Token *EnsembleANNComponent::doBackprop(Token *_error_input) {
+    UNUSED_VARIABLE(_error_input);
+    ERROR_EXIT1(128, "Ensemble component is not trainable [%s]\n",
+                name.c_str());
+    return 0;
+  }
+
+  void EnsembleANNComponent::reset(unsigned int it) {
+    if (input)  DecRef(input);
+    if (output) DecRef(output);
+    input  = 0;
+    output = 0;
+    for (unsigned int m=0; m<members.size(); ++m) members[m]->reset(it);
+  }
+
+  ANNComponent *EnsembleANNComponent::clone(LuaTable &copies) {
+    EnsembleANNComponent *obj =
+      new EnsembleANNComponent(prototype->clone(copies), tolerance, block_size,
+                               name.c_str());
+    // the clone shares the weight matrices of every member
+    for (unsigned int m=0; m<member_weights.size(); ++m) {
+      obj->addMember(*member_weights[m]);
+    }
+    obj->input_size  = input_size;
+    obj->output_size = output_size;
+    return obj;
+  }
+
+  void EnsembleANNComponent::setUseCuda(bool v) {
+    ANNComponent::setUseCuda(v);
+    for (unsigned int m=0; m<members.size(); ++m) members[m]->setUseCuda(v);
+  }
+
+  void EnsembleANNComponent::build(unsigned int _input_size,
+                                   unsigned int _output_size,
+                                   LuaTable &weights_dict,
+                                   LuaTable &components_dict) {
+    ANNComponent::build(_input_size, _output_size,
+                        weights_dict, components_dict);
+    if (member_weights.size() == 0) {
+      ERROR_EXIT1(128, "Ensemble needs one or more members, use addMember "
+                  "method [%s]\n", name.c_str());
+    }
+    // members are built with their own weights dictionary, and with a private
+    // components dictionary because they repeat the names of the prototype
+    vector<string> names;
+    for (unsigned int m=0; m<member_weights.size(); ++m) {
+      if (m == members.size()) {
+        LuaTable copies;
+        members.push_back(prototype->clone(copies));
+        IncRef(members[m]);
+      }
+      if (getUseCuda()) members[m]->setUseCuda(true);
+      LuaTable &member_dict = *member_weights[m];
+      names.clear();
+      member_dict.getStringKeys(names);
+      const unsigned int num_weights = names.size();
+      LuaTable member_components;
+      members[m]->build(input_size, output_size,
+                        member_dict, member_components);
+      // a missing matrix would be initialized by the member build
+      names.clear();
+      member_dict.getStringKeys(names);
+      if (names.size() != num_weights) {
+        ERROR_EXIT2(128, "Weights of member %u are incomplete [%s]\n",
+                    m+1, name.c_str());
+      }
+      input_size  = members[m]->getInputSize();
+      output_size = members[m]->getOutputSize();
+    }
+  }
+
+  const char *EnsembleANNComponent::luaCtorName() const {
+    return "ann.components.ensemble";
+  }
+
+  int EnsembleANNComponent::exportParamsToLua(lua_State *L) {
+    LuaTable samples(L);
+    for (unsigned int m=0; m<member_weights.size(); ++m) {
+      samples.put(static_cast<int>(m+1), *member_weights[m]);
+    }
+    LuaTable t(L);
+    t["name"] = name;
+    t["component"] = prototype;
+    t["samples"] = samples;
+    t["tolerance"] = tolerance;
+    t["block"] = block_size;
+    t.pushTable(L);
+    return 1;
+  }
+
+} // namespace ANN
@@ -0,0 +1,141 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef ENSEMBLECOMPONENT_H
+#define ENSEMBLECOMPONENT_H
+
+#include "ann_component.h"
+#include "lua_table.h"
+#include "matrix_buffer.h"
+#include "token_matrix.h"
+#include "vector.h"
+
+namespace ANN {
+
+  /**
+   * @brief Inference component which averages the outputs of an ensemble of
+   * models with the same topology and different weights.
+   *
+   * The given component is a prototype which is cloned into one member for
+   * every weights dictionary given by addMember(), so every member is built
+   * with its own weight matrices (for instance, the samples of a Bayesian
+   * posterior). Members are forwarded in blocks, the members of a block are
+   * executed in parallel threads, and their outputs are added in member
+   * order, so the result doesn't depend on the number of threads.
+   *
+   * When a tolerance is given, the forward stops after any block (but the
+   * first one) where the relative change of the running average is below it,
+   * that is <tt>||avg_k - avg_{k-1}||_2 <= tolerance*||avg_k||_2</tt>. The
+   * number of members used by the last forward is given by getNumUsed().
+   *
+   * @note The component is not trainable, doBackprop() is forbidden and
+   * member weights are not exported by copyWeights(). CUDA executes the
+   * members one after another.
+   */
+  class EnsembleANNComponent : public ANNComponent {
+    APRIL_DISALLOW_COPY_AND_ASSIGN(EnsembleANNComponent);
+
+    /// Non-built component which is cloned into the members.
+    ANNComponent *prototype;
+    /// Built clones of the prototype, one for every weights dictionary.
+    AprilUtils::vector<ANNComponent*> members;
+    /// Private weights dictionary of every member.
+    AprilUtils::vector<AprilUtils::LuaTable*> member_weights;
+    /// Relative change of the average which stops the forward, 0 disables it.
+    float tolerance;
+    /// Number of members executed in parallel between convergence checks.
+    unsigned int block_size;
+    /// Number of members used by the last doForward() call.
+    unsigned int num_used;
+
+    Basics::Token *input;
+    Basics::TokenMatrixFloat *output;
+    MatrixBuffer output_buffer, sum_buffer, previous_buffer;
+
+    bool useParallelMembers() const;
+    /// Adds the outputs of members [first,last) into the given sum matrix, a
+    /// NULL sum is taken from sum_buffer.
+    Basics::MatrixFloat *accumulate(AprilUtils::vector<Basics::Token*> &outputs,
+                                    unsigned int first, unsigned int last,
+                                    Basics::MatrixFloat *sum);
+
+  public:
+    EnsembleANNComponent(ANNComponent *component,
+                         float tolerance=0.0f,
+                         unsigned int block_size=1,
+                         const char *name=0);
+    virtual ~EnsembleANNComponent();
+
+    /// Adds a member which will be built with the given weight matrices.
+    void addMember(const AprilUtils::LuaTable &weights);
+
+    ANNComponent *getPrototype() { return prototype; }
+    unsigned int getNumMembers() const { return member_weights.size(); }
+    unsigned int getNumUsed() const { return num_used; }
+    float getTolerance() const { return tolerance; }
+    void setTolerance(float v) { tolerance = v; }
+    unsigned int getBlockSize() const { return block_size; }
+
+    virtual void precomputeOutputSize(const AprilUtils::vector<unsigned int> &input_size,
+				      AprilUtils::vector<unsigned int> &output_size) {
+      prototype->precomputeOutputSize(input_size, output_size);
+    }
+
+    virtual Basics::Token *getInput() { return input; }
+    virtual Basics::Token *getOutput() { return output; }
+
+    virtual void setInput(Basics::Token *tk) { AssignRef(input, tk); }
+    virtual void setOutput(Basics::Token *tk) {
+      AssignRef(output, tk->convertTo<Basics::TokenMatrixFloat*>());
+    }
+
+    /// Members already use all the OMP threads.
+    virtual bool getIsThreadSafe() const { return false; }
+
+    virtual Basics::Token *doForward(Basics::Token* input, bool during_training);
+
+    virtual Basics::Token *doBackprop(Basics::Token *input_error);
+
+    virtual void reset(unsigned int it=0);
+
+    virtual ANNComponent *clone(AprilUtils::LuaTable &copies);
+
+    virtual void setUseCuda(bool v);
+
+    /// The output is the average buffer, members don't use it.
+    virtual bool isOutputOverwritable() const { return true; }
+
+    virtual void build(unsigned int input_size,
+		       unsigned int output_size,
+		       AprilUtils::LuaTable &weights_dict,
+		       AprilUtils::LuaTable &components_dict);
+
+    virtual void debugInfo() {
+      ANNComponent::debugInfo();
+      prototype->debugInfo();
+    }
+
+    virtual const char *luaCtorName() const;
+    virtual int exportParamsToLua(lua_State *L);
+  };
+
+} // namespace ANN
+
+#endif // ENSEMBLECOMPONENT_H
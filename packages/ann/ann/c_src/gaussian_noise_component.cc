@@ -43,6 +43,20 @@ namespace ANN {
     mean(mean),
     variance(variance) {
   }
+
+  GaussianNoiseANNComponent::GaussianNoiseANNComponent(PhiloxRand *random,
+						       float mean,
+						       float variance,
+						       const char *name,
+						       unsigned int size) :
+    StochasticANNComponent(random, name, 0, size, size),
+    input(0),
+    output(0),
+    error_input(0),
+    error_output(0),
+    mean(mean),
+    variance(variance) {
+  }
   
   GaussianNoiseANNComponent::~GaussianNoiseANNComponent() {
     if (input) DecRef(input);
@@ -68,10 +82,7 @@ namespace ANN {
     // get memory blocks for tokens
     MatrixFloat *output_mat = output->getMatrix();
     MatrixFloat *noise_mat  = output_mat->cloneOnlyDims();
-    for (MatrixFloat::iterator it=noise_mat->begin();
-	 it!=noise_mat->end(); ++it) {
-      *it = random->randNorm(mean, variance);
-    }
+    fillRandomNormal(noise_mat, mean, variance);
     matAxpy(output_mat, 1.0f, noise_mat);
     delete noise_mat;
     return output;
@@ -96,15 +107,19 @@ namespace ANN {
   }
 
   ANNComponent *GaussianNoiseANNComponent::clone(AprilUtils::LuaTable &copies) {
-    MTRand *rng_clone = copies[getRandom()].opt<MTRand*>(0);
-    if (rng_clone == 0) {
-      copies[getRandom()] = rng_clone = new MTRand(*getRandom());
+    GaussianNoiseANNComponent *copy_component;
+    if (philox != 0) {
+      copy_component = new GaussianNoiseANNComponent(clonePhilox(copies),
+                                                     mean, variance,
+                                                     name.c_str(),
+                                                     input_size);
+    }
+    else {
+      copy_component = new GaussianNoiseANNComponent(cloneRandom(copies),
+                                                     mean, variance,
+                                                     name.c_str(),
+                                                     input_size);
     }
-    GaussianNoiseANNComponent *copy_component = new
-      GaussianNoiseANNComponent(rng_clone,
-				mean, variance,
-				name.c_str(),
-				input_size);
     return copy_component;
   }
 
@@ -129,7 +144,7 @@ namespace ANN {
     AprilUtils::LuaTable t(L);
     t["name"]   = name;
     t["size"]   = input_size;
-    t["random"] = random;
+    exportRandomToLua(t);
     t["mean"]   = mean;
     t["var"]    = variance;
     t.pushTable(L);
@@ -41,6 +41,10 @@ namespace ANN {
     GaussianNoiseANNComponent(Basics::MTRand *random, float mean, float variance,
 			      const char *name=0,
 			      unsigned int size=0);
+    GaussianNoiseANNComponent(Basics::PhiloxRand *random, float mean,
+                              float variance,
+			      const char *name=0,
+			      unsigned int size=0);
     virtual ~GaussianNoiseANNComponent();
     
     virtual Basics::Token *getInput() { return input; }
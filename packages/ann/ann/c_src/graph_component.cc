@@ -0,0 +1,881 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include "error_print.h"
+#include "graph_component.h"
+#include "maxmin.h"
+#include "matrix_ext.h"
+#include "omp_utils.h"
+#include "table_of_token_codes.h"
+#include "token_matrix.h"
+#include "token_sparse_matrix.h"
+#include "unused_variable.h"
+
+using namespace AprilMath;
+using namespace AprilMath::MatrixExt::BLAS;
+using namespace AprilMath::MatrixExt::Initializers;
+using namespace AprilMath::MatrixExt::Operations;
+using namespace AprilUtils;
+using namespace Basics;
+
+namespace ANN {
+
+  namespace {
+    
+    inline bool isNull(const Token *tk) {
+      return tk == 0 || tk->getTokenCode() == table_of_token_codes::token_null;
+    }
+
+    inline bool isBunch(const Token *tk) {
+      return tk != 0 && tk->getTokenCode() == table_of_token_codes::vector_Tokens;
+    }
+
+    MatrixFloat *getMatrix(Token *tk, const char *name) {
+      if (tk == 0 || tk->getTokenCode() != table_of_token_codes::token_matrix) {
+        ERROR_EXIT1(128, "Needs a token with a matrix [%s]\n", name);
+      }
+      return tk->convertTo<TokenMatrixFloat*>()->getMatrix();
+    }
+
+    /// Size of the first dimension of the first not null token.
+    int getBunchSize(Token *tk) {
+      switch(tk->getTokenCode()) {
+      case table_of_token_codes::token_matrix:
+        return tk->convertTo<TokenMatrixFloat*>()->getMatrix()->getDimSize(0);
+      case table_of_token_codes::token_sparse_matrix:
+        return tk->convertTo<TokenSparseMatrixFloat*>()->getMatrix()->getDimSize(0);
+      case table_of_token_codes::vector_Tokens:
+        {
+          TokenBunchVector *v = tk->convertTo<TokenBunchVector*>();
+          for (unsigned int i=0; i<v->size(); ++i) {
+            if (!isNull((*v)[i].get())) return getBunchSize((*v)[i].get());
+          }
+        }
+      default:
+        ;
+      }
+      ERROR_EXIT(128, "Unable to compute the bunch size of the input token\n");
+      return 0;
+    }
+    
+  } // anonymous namespace
+  
+  GraphANNComponent::GraphANNComponent(const char *name,
+                                       unsigned int backstep) :
+    ANNComponent(name, 0, 0, 0),
+    max_delay(0), backstep(backstep), bptt_step(0), graph_input_size(0),
+    gradients_computed(false) {
+  }
+
+  GraphANNComponent::~GraphANNComponent() {
+    for (unsigned int i=0; i<steps.size(); ++i) delete steps[i];
+  }
+
+  int GraphANNComponent::addComponent(ANNComponent *component) {
+    Node node;
+    node.op          = COMPONENT_OP;
+    node.name        = component->getName();
+    node.component   = component;
+    node.input_size  = component->getInputSize();
+    node.output_size = component->getOutputSize();
+    node.index       = 0;
+    node.num_out_edges = 0;
+    nodes.push_back(node);
+    order.clear();
+    return static_cast<int>(nodes.size()) - 1;
+  }
+
+  int GraphANNComponent::addOperation(NodeOp op, const char *name,
+                                      unsigned int input_size,
+                                      unsigned int output_size,
+                                      unsigned int index) {
+    if (op == COMPONENT_OP) {
+      ERROR_EXIT1(128, "Use addComponent to add components [%s]\n",
+                  this->name.c_str());
+    }
+    Node node;
+    node.op          = op;
+    node.name        = AprilUtils::string(name);
+    node.input_size  = input_size;
+    node.output_size = output_size;
+    node.index       = index;
+    node.num_out_edges = 0;
+    nodes.push_back(node);
+    order.clear();
+    return static_cast<int>(nodes.size()) - 1;
+  }
+
+  void GraphANNComponent::connect(int src, int dst, unsigned int delay) {
+    const int N = static_cast<int>(nodes.size());
+    if (src == OUTPUT_NODE || src < INPUT_NODE || src >= N ||
+        dst == INPUT_NODE || dst < OUTPUT_NODE || dst >= N) {
+      ERROR_EXIT3(128, "Incorrect connection %d -> %d [%s]\n",
+                  src, dst, name.c_str());
+    }
+    if (src >= 0) ++nodes[src].num_out_edges;
+    if (dst == OUTPUT_NODE) output_edges.push_back(Edge(src, delay));
+    else nodes[dst].in_edges.push_back(Edge(src, delay));
+    if (delay > max_delay) max_delay = delay;
+    order.clear();
+  }
+
+  void GraphANNComponent::setBPTTTruncation(unsigned int backstep) {
+    if (backstep < max_delay || backstep == 0) {
+      ERROR_EXIT2(128, "BPTT truncation should be >= %u [%s]\n",
+                  AprilUtils::max(max_delay, 1u), name.c_str());
+    }
+    this->backstep = backstep;
+    reset();
+  }
+
+  // Kahn's algorithm over non delayed edges, nodes without pending inputs
+  // are processed in insertion order. After that, nodes are grouped by their
+  // dependency level keeping the relative order.
+  void GraphANNComponent::computeOrder() {
+    const int N = static_cast<int>(nodes.size());
+    AprilUtils::vector<int> pending(N, 0);
+    AprilUtils::vector< AprilUtils::vector<int> > out_nodes(N);
+    for (int j=0; j<N; ++j) {
+      for (unsigned int k=0; k<nodes[j].in_edges.size(); ++k) {
+        const Edge &e = nodes[j].in_edges[k];
+        if (e.delay == 0 && e.node != INPUT_NODE) {
+          ++pending[j];
+          out_nodes[e.node].push_back(j);
+        }
+      }
+    }
+    order.clear();
+    for (int j=0; j<N; ++j) if (pending[j] == 0) order.push_back(j);
+    for (unsigned int k=0; k<order.size(); ++k) {
+      const AprilUtils::vector<int> &dsts = out_nodes[order[k]];
+      for (unsigned int i=0; i<dsts.size(); ++i) {
+        if (--pending[dsts[i]] == 0) order.push_back(dsts[i]);
+      }
+    }
+    if (static_cast<int>(order.size()) != N) {
+      order.clear();
+      ERROR_EXIT1(128, "Unable to sort ANN with 0-delay recurrent "
+                  "connections [%s]\n", name.c_str());
+    }
+    AprilUtils::vector<unsigned int> level(N, 0u);
+    unsigned int num_levels = 0;
+    for (int k=0; k<N; ++k) {
+      const int j = order[k];
+      for (unsigned int i=0; i<nodes[j].in_edges.size(); ++i) {
+        const Edge &e = nodes[j].in_edges[i];
+        if (e.delay == 0 && e.node != INPUT_NODE) {
+          level[j] = AprilUtils::max(level[j], level[e.node] + 1u);
+        }
+      }
+      num_levels = AprilUtils::max(num_levels, level[j] + 1u);
+    }
+    AprilUtils::vector<int> sorted;
+    levels.clear();
+    for (unsigned int l=0; l<num_levels; ++l) {
+      levels.push_back(sorted.size());
+      for (int k=0; k<N; ++k) if (level[order[k]] == l) sorted.push_back(order[k]);
+    }
+    levels.push_back(sorted.size());
+    order.swap(sorted);
+  }
+
+  bool GraphANNComponent::useInterOpParallelism() const {
+    if (!getInterOpParallelism() || use_cuda) return false;
+    for (unsigned int j=0; j<nodes.size(); ++j) {
+      if (nodes[j].op == COMPONENT_OP && !nodes[j].component->getIsThreadSafe()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void GraphANNComponent::checkNodeErrors(vector<string> &errors, int begin) {
+    for (unsigned int i=0; i<errors.size(); ++i) {
+      if (!errors[i].empty()) {
+        ERROR_EXIT3(128, "Node %s failed: %s [%s]\n",
+                    nodes[order[begin + i]].name.c_str(),
+                    errors[i].c_str(), name.c_str());
+      }
+    }
+  }
+
+  unsigned int GraphANNComponent::getNodeOutputSize(int node) const {
+    if (node == INPUT_NODE) return graph_input_size;
+    return nodes[node].output_size;
+  }
+
+  unsigned int GraphANNComponent::sumInputSizes(const AprilUtils::vector<Edge> &edges) const {
+    unsigned int sz = 0;
+    for (unsigned int k=0; k<edges.size(); ++k) {
+      const unsigned int edge_sz = getNodeOutputSize(edges[k].node);
+      if (edge_sz == 0) return 0;
+      sz += edge_sz;
+    }
+    return sz;
+  }
+
+  void GraphANNComponent::build(unsigned int _input_size,
+                                unsigned int _output_size,
+                                AprilUtils::LuaTable &weights_dict,
+                                AprilUtils::LuaTable &components_dict) {
+    ANNComponent::build(_input_size, _output_size,
+                        weights_dict, components_dict);
+    if (output_edges.size() == 0) {
+      ERROR_EXIT1(128, "Connections to 'output' node are needed [%s]\n",
+                  name.c_str());
+    }
+    if (backstep < max_delay) {
+      ERROR_EXIT1(128, "Impossible to build the network with the given "
+                  "BPTT truncation parameter [%s]\n", name.c_str());
+    }
+    computeOrder();
+    // the input size of the graph is the input size of its input nodes
+    graph_input_size = input_size;
+    if (graph_input_size == 0) {
+      for (unsigned int k=0; k<order.size() && graph_input_size == 0; ++k) {
+        const Node &node = nodes[order[k]];
+        if (node.in_edges.size() == 1 && node.in_edges[0].node == INPUT_NODE) {
+          graph_input_size = node.input_size;
+        }
+      }
+    }
+    // output size required by every node, taken from its destinations
+    AprilUtils::vector<unsigned int> required(nodes.size(), 0u);
+    for (unsigned int j=0; j<=nodes.size(); ++j) {
+      const AprilUtils::vector<Edge> &edges = (j < nodes.size()) ?
+        nodes[j].in_edges : output_edges;
+      unsigned int sz = (j < nodes.size()) ? nodes[j].input_size : output_size;
+      if (edges.size() != 1 || sz == 0) continue;
+      if (edges[0].node != INPUT_NODE) required[edges[0].node] = sz;
+    }
+    for (unsigned int k=0; k<order.size(); ++k) {
+      Node &node = nodes[order[k]];
+      if (node.num_out_edges == 0) {
+        ERROR_EXIT2(128, "Node %s doesn't have output connections [%s]\n",
+                    node.name.c_str(), name.c_str());
+      }
+      unsigned int in  = node.input_size;
+      unsigned int out = node.output_size;
+      if (in == 0) in = sumInputSizes(node.in_edges);
+      if (out == 0) out = required[order[k]];
+      switch(node.op) {
+      case COMPONENT_OP:
+        node.component->build(in, out, weights_dict, components_dict);
+        in  = node.component->getInputSize();
+        out = node.component->getOutputSize();
+        break;
+      case IDENTITY_OP:
+      case BIND_OP:
+        if (out == 0) out = in;
+        if (in == 0) in = out;
+        break;
+      case ADD_OP:
+        if (out == 0 && node.in_edges.size() > 0) out = in / node.in_edges.size();
+        if (in > 0 && out > 0 && (in % out) != 0) {
+          ERROR_EXIT2(128, "Output size should be a multiple of input size "
+                      "[%s at %s]\n", node.name.c_str(), name.c_str());
+        }
+        break;
+      case CMUL_OP:
+        if (out == 0) out = in / 2;
+        if (in == 0) in = out * 2;
+        if (in != 2*out) {
+          ERROR_EXIT2(128, "Input size should be two times the output size "
+                      "[%s at %s]\n", node.name.c_str(), name.c_str());
+        }
+        break;
+      case INDEX_OP:
+        break;
+      }
+      node.input_size  = in;
+      node.output_size = out;
+      node.zero.reset();
+    }
+    if (output_size == 0) output_size = sumInputSizes(output_edges);
+    if (input_size == 0) input_size = graph_input_size;
+    reset();
+  }
+
+  GraphANNComponent::StepState *GraphANNComponent::getStep(unsigned int step) {
+    while (steps.size() < step) steps.push_back(new StepState(nodes.size()));
+    return steps[step - 1];
+  }
+
+  GraphANNComponent::NodeState *GraphANNComponent::getNodeState(int node,
+                                                                unsigned int step,
+                                                                unsigned int delay) {
+    int pos = static_cast<int>(step) - static_cast<int>(delay);
+    if (pos < 1) {
+      // truncated BPTT takes the state of the previous window
+      if (getEffectiveBackstep() == UNTRUNCATED) return 0;
+      pos += static_cast<int>(getEffectiveBackstep());
+      if (pos < 1 || static_cast<unsigned int>(pos) > steps.size()) return 0;
+    }
+    StepState *st = steps[pos - 1];
+    return (node == INPUT_NODE) ? &st->graph_input : &st->nodes[node];
+  }
+
+  Token *GraphANNComponent::getZero(int node, int bunch_size) {
+    if (node == INPUT_NODE) {
+      // zeros with the shape of current input
+      Token *tk = steps[bptt_step - 1]->graph_input.output.get();
+      MatrixFloat *m = getMatrix(tk, name.c_str())->cloneOnlyDims();
+      matZeros(m);
+      return new TokenMatrixFloat(m);
+    }
+    Node &n = nodes[node];
+    MatrixFloat *m = n.zero.empty() ? 0 :
+      n.zero->convertTo<TokenMatrixFloat*>()->getMatrix();
+    if (m == 0 || m->getDimSize(0) != bunch_size) {
+      if (n.output_size == 0) {
+        ERROR_EXIT2(128, "Unable to initialize default activation of "
+                    "component %s [%s]\n", n.name.c_str(), name.c_str());
+      }
+      int dims[2] = { bunch_size, static_cast<int>(n.output_size) };
+      m = new MatrixFloat(2, dims);
+#ifdef USE_CUDA
+      m->setUseCuda(use_cuda);
+#endif
+      matZeros(m);
+      n.zero = new TokenMatrixFloat(m);
+    }
+    return n.zero.get();
+  }
+
+  Token *GraphANNComponent::composeInput(const AprilUtils::vector<Edge> &edges,
+                                         int bunch_size) {
+    TokenBunchVector *bunch = (edges.size() != 1) ?
+      new TokenBunchVector(edges.size()) : 0;
+    Token *tk = 0;
+    for (unsigned int k=0; k<edges.size(); ++k) {
+      NodeState *state = getNodeState(edges[k].node, bptt_step, edges[k].delay);
+      if (state != 0 && !state->output.empty()) {
+        tk = state->output.get();
+      }
+      else if (edges[k].delay > 0) {
+        tk = getZero(edges[k].node, bunch_size);
+      }
+      else {
+        ERROR_EXIT1(128, "Unexpected empty output at 0-delay connection [%s]\n",
+                    name.c_str());
+      }
+      if (bunch != 0) (*bunch)[k] = tk;
+    }
+    return (bunch != 0) ? bunch : tk;
+  }
+
+  Token *GraphANNComponent::forwardOperation(Node &node, Token *tk) {
+    if (node.op == IDENTITY_OP || !isBunch(tk)) return tk;
+    TokenBunchVector *v = tk->convertTo<TokenBunchVector*>();
+    const char *node_name = node.name.c_str();
+    switch(node.op) {
+    case BIND_OP:
+      {
+        int dims[2] = { 0, 0 };
+        for (unsigned int i=0; i<v->size(); ++i) {
+          MatrixFloat *m = getMatrix((*v)[i].get(), node_name);
+          if (m->getNumDim() != 2) {
+            ERROR_EXIT1(128, "Needs flattened input matrices [%s]\n", node_name);
+          }
+          dims[0]  = m->getDimSize(0);
+          dims[1] += m->getDimSize(1);
+        }
+        MatrixFloat *out = new MatrixFloat(2, dims);
+#ifdef USE_CUDA
+        out->setUseCuda(use_cuda);
+#endif
+        int coords[2] = { 0, 0 };
+        for (unsigned int i=0; i<v->size(); ++i) {
+          MatrixFloat *m = getMatrix((*v)[i].get(), node_name);
+          dims[1] = m->getDimSize(1);
+          SharedPtr<MatrixFloat> dest( new MatrixFloat(out, coords, dims, false) );
+          matCopy(dest.get(), m);
+          coords[1] += dims[1];
+        }
+        return new TokenMatrixFloat(out);
+      }
+    case ADD_OP:
+      {
+        MatrixFloat *out = 0;
+        for (unsigned int i=0; i<v->size(); ++i) {
+          if (isNull((*v)[i].get())) continue;
+          MatrixFloat *m = getMatrix((*v)[i].get(), node_name);
+          if (out == 0) out = m->clone();
+          else matAxpy(out, 1.0f, m);
+        }
+        if (out == 0) {
+          ERROR_EXIT1(128, "Needs at least one not null token [%s]\n", node_name);
+        }
+        return new TokenMatrixFloat(out);
+      }
+    case CMUL_OP:
+      {
+        if (v->size() != 2) {
+          ERROR_EXIT1(128, "Needs a tokens.vector.bunch with two components "
+                      "[%s]\n", node_name);
+        }
+        Token *a = (*v)[0].get(), *b = (*v)[1].get();
+        if (isNull(a)) return b;
+        if (isNull(b)) return a;
+        MatrixFloat *a_mat = getMatrix(a, node_name);
+        MatrixFloat *out = a_mat->cloneOnlyDims();
+        matCmul(a_mat, getMatrix(b, node_name), out);
+        return new TokenMatrixFloat(out);
+      }
+    case INDEX_OP:
+      if (node.index >= v->size()) {
+        ERROR_EXIT1(128, "Index out of bounds [%s]\n", node_name);
+      }
+      return (*v)[node.index].get();
+    default:
+      ERROR_EXIT1(128, "Unexpected node operation [%s]\n", node_name);
+    }
+    return 0;
+  }
+
+  Token *GraphANNComponent::backpropOperation(Node &node, NodeState &state,
+                                              Token *tk) {
+    Token *input = state.input.get();
+    if (node.op == IDENTITY_OP || !isBunch(input)) return tk;
+    TokenBunchVector *v = input->convertTo<TokenBunchVector*>();
+    const char *node_name = node.name.c_str();
+    TokenBunchVector *result = new TokenBunchVector(v->size());
+    switch(node.op) {
+    case BIND_OP:
+      {
+        MatrixFloat *e = getMatrix(tk, node_name);
+        int coords[2] = { 0, 0 };
+        int sizes[2]  = { e->getDimSize(0), 0 };
+        for (unsigned int i=0; i<v->size(); ++i) {
+          sizes[1] = getMatrix((*v)[i].get(), node_name)->getDimSize(1);
+          (*result)[i] = new TokenMatrixFloat(new MatrixFloat(e, coords, sizes,
+                                                              false));
+          coords[1] += sizes[1];
+        }
+        break;
+      }
+    case ADD_OP:
+      for (unsigned int i=0; i<v->size(); ++i) (*result)[i] = tk;
+      break;
+    case CMUL_OP:
+      {
+        MatrixFloat *e = getMatrix(tk, node_name);
+        for (unsigned int i=0; i<2; ++i) {
+          // the derivative respect to one input is the other input
+          Token *other = (*v)[1-i].get();
+          if (isNull(other)) {
+            (*result)[i] = tk;
+          }
+          else {
+            MatrixFloat *out = e->cloneOnlyDims();
+            matCmul(getMatrix(other, node_name), e, out);
+            (*result)[i] = new TokenMatrixFloat(out);
+          }
+        }
+        break;
+      }
+    case INDEX_OP:
+      for (unsigned int i=0; i<v->size(); ++i) {
+        (*result)[i] = (i == node.index) ? tk : TokenNull::getInstance();
+      }
+      break;
+    default:
+      ERROR_EXIT1(128, "Unexpected node operation [%s]\n", node_name);
+    }
+    return result;
+  }
+
+  Token *GraphANNComponent::doForward(Token *_input, bool during_training) {
+    if (!getIsBuilt() || order.size() != nodes.size()) {
+      ERROR_EXIT1(128, "Build method should be called before [%s]\n",
+                  name.c_str());
+    }
+    gradients_computed = false;
+    const unsigned int B = getEffectiveBackstep();
+    if (++bptt_step > B) bptt_step = 1;
+    StepState *st = getStep(bptt_step);
+    for (unsigned int j=0; j<st->nodes.size(); ++j) st->nodes[j].clear();
+    st->graph_input.clear();
+    st->graph_output.clear();
+    st->has_components_state = false;
+    //
+    const int bunch_size = getBunchSize(_input);
+    st->graph_input.input  = _input;
+    st->graph_input.output = _input;
+    const bool concurrent = useInterOpParallelism();
+    for (unsigned int l=0; l+1<levels.size(); ++l) {
+      const int begin = static_cast<int>(levels[l]);
+      const int end   = static_cast<int>(levels[l+1]);
+      // inputs are composed before, getZero() modifies the nodes
+      for (int k=begin; k<end; ++k) {
+        const int j = order[k];
+        st->nodes[j].input = composeInput(nodes[j].in_edges, bunch_size);
+      }
+      // an exception can't leave the parallel region, the error messages of
+      // the nodes are kept and the first one is thrown after it
+      vector<string> errors(end - begin);
+#ifndef NO_OMP
+      int num_threads = AprilUtils::min(end - begin, OMPUtils::get_num_threads());
+#pragma omp parallel for schedule(dynamic,1) num_threads(num_threads) if(concurrent && end - begin > 1)
+#else
+      UNUSED_VARIABLE(concurrent);
+#endif
+      for (int k=begin; k<end; ++k) {
+        const int j = order[k];
+        Node &node = nodes[j];
+        NodeState &state = st->nodes[j];
+        try {
+          if (node.op == COMPONENT_OP) {
+            state.output = node.component->doForward(state.input.get(),
+                                                     during_training);
+          }
+          else {
+            state.output = forwardOperation(node, state.input.get());
+          }
+        }
+        catch (char *msg) { // thrown by ERROR_EXIT macros
+          errors[k - begin] = msg;
+          delete[] msg;
+        }
+        catch (...) {
+          errors[k - begin] = "unknown error";
+        }
+      }
+      checkNodeErrors(errors, begin);
+    }
+    if (B > 1) {
+      // components keep only the last state, BPTT needs all of them
+      for (unsigned int j=0; j<nodes.size(); ++j) {
+        if (nodes[j].op == COMPONENT_OP) {
+          nodes[j].component->copyState(st->components);
+        }
+      }
+      st->has_components_state = true;
+    }
+    st->graph_output.input  = composeInput(output_edges, bunch_size);
+    st->graph_output.output = st->graph_output.input;
+    input  = _input;
+    output = st->graph_output.output;
+    return output.get();
+  }
+
+  void GraphANNComponent::accumulateError(NodeState &state, Token *tk) {
+    if (state.error_input.empty() || isNull(state.error_input.get())) {
+      state.error_input = tk;
+      state.error_owned = false;
+      return;
+    }
+    if (!state.error_owned) {
+      state.error_input = state.error_input->clone();
+      state.error_owned = true;
+    }
+    matAxpy(getMatrix(state.error_input.get(), name.c_str()), 1.0f,
+            getMatrix(tk, name.c_str()));
+  }
+
+  void GraphANNComponent::distributeError(const AprilUtils::vector<Edge> &edges,
+                                          Token *tk, unsigned int step) {
+    if (isNull(tk)) return;
+    TokenBunchVector *v = 0;
+    if (edges.size() != 1) {
+      if (!isBunch(tk) || tk->convertTo<TokenBunchVector*>()->size() != edges.size()) {
+        ERROR_EXIT1(128, "Incorrect number of error tokens [%s]\n",
+                    name.c_str());
+      }
+      v = tk->convertTo<TokenBunchVector*>();
+    }
+    for (unsigned int k=0; k<edges.size(); ++k) {
+      Token *e = (v != 0) ? (*v)[k].get() : tk;
+      // errors before the first step are lost by BPTT truncation
+      if (isNull(e) || edges[k].delay >= step) continue;
+      StepState *st = steps[step - edges[k].delay - 1];
+      NodeState &state = (edges[k].node == INPUT_NODE) ?
+        st->graph_input : st->nodes[edges[k].node];
+      accumulateError(state, e);
+    }
+  }
+
+  void GraphANNComponent::computeStepGradients(StepState *st) {
+    for (unsigned int k=0; k<order.size(); ++k) {
+      const int j = order[k];
+      if (nodes[j].op == COMPONENT_OP && !isNull(st->nodes[j].error_input.get())) {
+        nodes[j].component->computeAllGradients(grads);
+      }
+    }
+  }
+
+  void GraphANNComponent::runBPTT() {
+    if (bptt_step == 0) {
+      ERROR_EXIT1(128, "Forward method should be called before [%s]\n",
+                  name.c_str());
+    }
+    const unsigned int last    = bptt_step;
+    const unsigned int stop_at = getIsRecurrent() ? 1u : bptt_step;
+    const bool concurrent = useInterOpParallelism();
+    for (unsigned int i=last; i>=stop_at; --i) {
+      StepState *st = steps[i - 1];
+      distributeError(output_edges, st->graph_output.error_input.get(), i);
+      for (unsigned int l=levels.size()-1; l>0; --l) {
+        const int begin = static_cast<int>(levels[l-1]);
+        const int end   = static_cast<int>(levels[l]);
+        // states are restored before, setState() uses the Lua state
+        if (i != last && st->has_components_state) {
+          for (int k=begin; k<end; ++k) {
+            const int j = order[k];
+            if (nodes[j].op == COMPONENT_OP &&
+                !isNull(st->nodes[j].error_input.get())) {
+              nodes[j].component->setState(st->components);
+            }
+          }
+        }
+        vector<string> errors(end - begin);
+#ifndef NO_OMP
+        int num_threads = AprilUtils::min(end - begin, OMPUtils::get_num_threads());
+#pragma omp parallel for schedule(dynamic,1) num_threads(num_threads) if(concurrent && end - begin > 1)
+#else
+        UNUSED_VARIABLE(concurrent);
+#endif
+        for (int k=begin; k<end; ++k) {
+          const int j = order[k];
+          Node &node = nodes[j];
+          NodeState &state = st->nodes[j];
+          if (isNull(state.error_input.get())) continue;
+          try {
+            if (node.op == COMPONENT_OP) {
+              state.error_output = node.component->doBackprop(state.error_input.get());
+            }
+            else {
+              state.error_output = backpropOperation(node, state,
+                                                     state.error_input.get());
+            }
+          }
+          catch (char *msg) { // thrown by ERROR_EXIT macros
+            errors[k - begin] = msg;
+            delete[] msg;
+          }
+          catch (...) {
+            errors[k - begin] = "unknown error";
+          }
+        }
+        checkNodeErrors(errors, begin);
+        // errors are accumulated in reverse topological order
+        for (int k=end; k>begin; --k) {
+          const int j = order[k-1];
+          NodeState &state = st->nodes[j];
+          if (isNull(state.error_input.get())) continue;
+          distributeError(nodes[j].in_edges, state.error_output.get(), i);
+        }
+      }
+      computeStepGradients(st);
+      if (isNull(st->graph_input.error_input.get())) {
+        st->graph_input.error_output = TokenNull::getInstance();
+      }
+      else {
+        st->graph_input.error_output = st->graph_input.error_input;
+      }
+      if (i == 1) break;
+    }
+    // default zero gradients for components without error at any step
+    for (unsigned int j=0; j<nodes.size(); ++j) {
+      if (nodes[j].op != COMPONENT_OP) continue;
+      AprilUtils::LuaTable weights;
+      AprilUtils::vector<AprilUtils::string> keys;
+      nodes[j].component->copyWeights(weights);
+      weights.getStringKeys(keys);
+      for (unsigned int k=0; k<keys.size(); ++k) {
+        if (grads.checkNil(keys[k])) {
+          MatrixFloat *g = weights.get<MatrixFloat*>(keys[k])->cloneOnlyDims();
+          grads.put(keys[k], matZeros(g));
+        }
+      }
+    }
+    error_input  = steps[last - 1]->graph_output.error_input;
+    error_output = steps[stop_at - 1]->graph_input.error_output;
+    gradients_computed = true;
+  }
+
+  Token *GraphANNComponent::doBackprop(Token *input_error) {
+    if (bptt_step == 0) {
+      ERROR_EXIT1(128, "Forward method should be called before [%s]\n",
+                  name.c_str());
+    }
+    StepState *st = steps[bptt_step - 1];
+    st->graph_output.error_input  = input_error;
+    st->graph_output.error_output = input_error;
+    error_input = input_error;
+    if (!getIsRecurrent() || bptt_step == backstep) {
+      runBPTT();
+      return error_output.get();
+    }
+    return TokenNull::getInstance();
+  }
+
+  void GraphANNComponent::bpttBackprop(AprilUtils::vector< SharedPtr<Token> > &result) {
+    if (!gradients_computed) runBPTT();
+    result.clear();
+    for (unsigned int i=1; i<=bptt_step; ++i) {
+      result.push_back(steps[i - 1]->graph_input.error_output);
+    }
+  }
+
+  void GraphANNComponent::computeAllGradients(AprilUtils::LuaTable &weight_grads_dict) {
+    if (!gradients_computed) runBPTT();
+    AprilUtils::vector<AprilUtils::string> keys;
+    grads.getStringKeys(keys);
+    for (unsigned int k=0; k<keys.size(); ++k) {
+      weight_grads_dict.put(keys[k], grads.get<MatrixFloat*>(keys[k]));
+    }
+  }
+
+  void GraphANNComponent::copyBPTTState(unsigned int step,
+                                        AprilUtils::LuaTable &dict) {
+    if (step < 1 || step > bptt_step) {
+      ERROR_EXIT2(128, "Unable to retrieve the state at time %u [%s]\n",
+                  step, name.c_str());
+    }
+    StepState *st = steps[step - 1];
+    for (unsigned int j=0; j<=nodes.size()+1; ++j) {
+      NodeState *state;
+      AprilUtils::string key;
+      if (j < nodes.size()) {
+        state = &st->nodes[j];
+        key   = nodes[j].name;
+      }
+      else if (j == nodes.size()) {
+        state = &st->graph_input;
+        key   = name;
+        key  += AprilUtils::string("::input");
+      }
+      else {
+        state = &st->graph_output;
+        key   = name;
+        key  += AprilUtils::string("::output");
+      }
+      AprilUtils::LuaTable t;
+      t.put(INPUT_STR, state->input);
+      t.put(OUTPUT_STR, state->output);
+      t.put(ERROR_INPUT_STR, state->error_input);
+      t.put(ERROR_OUTPUT_STR, state->error_output);
+      dict.put(key, t);
+    }
+  }
+
+  void GraphANNComponent::reset(unsigned int it) {
+    for (unsigned int i=0; i<steps.size(); ++i) {
+      StepState *st = steps[i];
+      for (unsigned int j=0; j<st->nodes.size(); ++j) st->nodes[j].clear();
+      st->graph_input.clear();
+      st->graph_output.clear();
+      st->components = AprilUtils::LuaTable();
+      st->has_components_state = false;
+    }
+    bptt_step = 0;
+    gradients_computed = false;
+    grads = AprilUtils::LuaTable();
+    input.reset();
+    output.reset();
+    error_input.reset();
+    error_output.reset();
+    for (unsigned int j=0; j<nodes.size(); ++j) {
+      if (nodes[j].op == COMPONENT_OP) nodes[j].component->reset(it);
+    }
+  }
+
+  void GraphANNComponent::copyState(AprilUtils::LuaTable &dict) {
+    ANNComponent::copyState(dict);
+    for (unsigned int j=0; j<nodes.size(); ++j) {
+      if (nodes[j].op == COMPONENT_OP) nodes[j].component->copyState(dict);
+    }
+  }
+
+  void GraphANNComponent::setState(AprilUtils::LuaTable &dict) {
+    ANNComponent::setState(dict);
+    for (unsigned int j=0; j<nodes.size(); ++j) {
+      if (nodes[j].op == COMPONENT_OP) nodes[j].component->setState(dict);
+    }
+  }
+
+  ANNComponent *GraphANNComponent::clone(AprilUtils::LuaTable &copies) {
+    GraphANNComponent *obj = new GraphANNComponent(name.c_str(), backstep);
+    for (unsigned int j=0; j<nodes.size(); ++j) {
+      Node node = nodes[j];
+      if (node.op == COMPONENT_OP) node.component = node.component->clone(copies);
+      node.zero.reset();
+      obj->nodes.push_back(node);
+    }
+    obj->output_edges = output_edges;
+    obj->max_delay    = max_delay;
+    obj->input_size   = input_size;
+    obj->output_size  = output_size;
+    return obj;
+  }
+
+  void GraphANNComponent::setUseCuda(bool v) {
+    ANNComponent::setUseCuda(v);
+    for (unsigned int j=0; j<nodes.size(); ++j) {
+      nodes[j].zero.reset();
+      if (nodes[j].op == COMPONENT_OP) nodes[j].component->setUseCuda(v);
+    }
+  }
+
+  void GraphANNComponent::copyWeights(AprilUtils::LuaTable &weights_dict) {
+    for (unsigned int j=0; j<nodes.size(); ++j) {
+      if (nodes[j].op == COMPONENT_OP) nodes[j].component->copyWeights(weights_dict);
+    }
+  }
+
+  void GraphANNComponent::copyComponents(AprilUtils::LuaTable &components_dict) {
+    ANNComponent::copyComponents(components_dict);
+    for (unsigned int j=0; j<nodes.size(); ++j) {
+      if (nodes[j].op == COMPONENT_OP) {
+        nodes[j].component->copyComponents(components_dict);
+      }
+    }
+  }
+
+  ANNComponent *GraphANNComponent::getComponent(AprilUtils::string &name) {
+    ANNComponent *component = ANNComponent::getComponent(name);
+    for (unsigned int j=0; j<nodes.size() && component==0; ++j) {
+      if (nodes[j].op == COMPONENT_OP) {
+        component = nodes[j].component->getComponent(name);
+      }
+    }
+    return component;
+  }
+
+  void GraphANNComponent::debugInfo() {
+    ANNComponent::debugInfo();
+    for (unsigned int j=0; j<nodes.size(); ++j) {
+      if (nodes[j].op == COMPONENT_OP) nodes[j].component->debugInfo();
+    }
+  }
+
+  const char *GraphANNComponent::luaCtorName() const {
+    return "ann.components.graph_engine";
+  }
+
+  int GraphANNComponent::exportParamsToLua(lua_State *L) {
+    UNUSED_VARIABLE(L);
+    ERROR_EXIT1(128, "Unable to serialize a graph engine, serialize its "
+                "ann.graph instead [%s]\n", name.c_str());
+    return 0;
+  }
+  
+} // namespace ANN
@@ -0,0 +1,261 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef GRAPHCOMPONENT_H
+#define GRAPHCOMPONENT_H
+
+#include <climits>
+#include "ann_component.h"
+#include "lua_table.h"
+#include "matrixFloat.h"
+#include "smart_ptr.h"
+#include "token_vector.h"
+#include "vector.h"
+
+namespace ANN {
+
+  /**
+   * @brief Native execution engine for graphs of ANN components, the
+   * ann.graph Lua class uses it as back-end.
+   *
+   * Nodes are ANNComponent's or native operations (see NodeOp), and edges
+   * connect the output of one node with the input of another, optionally with
+   * a delay of several time steps. A node with several input edges receives a
+   * Basics::TokenBunchVector with the tokens sorted as the edges were
+   * connected. The graph is compiled at build(), computing the topological
+   * order of non-delayed edges, and forward/backprop run without any Lua
+   * code.
+   *
+   * Recurrent graphs (delayed edges) keep the state of every time step in a
+   * ring buffer of @c backstep positions, and doBackprop() implements
+   * truncated back-propagation through time (BPTT). The states of the
+   * components are retrieved with copyState() and restored with setState()
+   * only when it is needed by BPTT.
+   *
+   * The topological order is split into dependency levels, the nodes of one
+   * level only depend on nodes of previous levels (or on previous time
+   * steps), so they are executed concurrently in OMP threads by forward and
+   * backprop when inter-operator parallelism is enabled (it is opt-in, see
+   * ANNComponent::setInterOpParallelism()) and all the components are thread
+   * safe. Errors are accumulated and gradients are computed following the
+   * same order in both cases, so results don't depend on the parallelism.
+   *
+   * @note Node identifiers are returned by addComponent() and
+   * addOperation(), INPUT_NODE and OUTPUT_NODE identify the graph input and
+   * output at connect().
+   */
+  class GraphANNComponent : public ANNComponent {
+    APRIL_DISALLOW_COPY_AND_ASSIGN(GraphANNComponent);
+  public:
+    /// Operations of the nodes which are not ANNComponent's.
+    enum NodeOp {
+      COMPONENT_OP=0, ///< Executes an ANNComponent.
+      IDENTITY_OP,    ///< By-pass of the input token.
+      BIND_OP,        ///< Joins a bunch of matrices by columns.
+      ADD_OP,         ///< Adds a bunch of matrices.
+      CMUL_OP,        ///< Component-wise product of two matrices.
+      INDEX_OP        ///< Selects one token of a bunch.
+    };
+    /// Node identifier of the graph input.
+    static const int INPUT_NODE  = -1;
+    /// Node identifier of the graph output.
+    static const int OUTPUT_NODE = -2;
+    /// Backstep value for non truncated BPTT.
+    static const unsigned int UNTRUNCATED = UINT_MAX;
+
+    GraphANNComponent(const char *name=0,
+                      unsigned int backstep=UNTRUNCATED);
+    virtual ~GraphANNComponent();
+
+    /// Adds a node which executes the given component, returns its id.
+    int addComponent(ANNComponent *component);
+    /**
+     * @brief Adds a node which executes a native operation, returns its id.
+     *
+     * @param op - The operation, it cannot be COMPONENT_OP.
+     * @param name - The name used for the state of the node.
+     * @param input_size - Input size, it can be 0 if unknown.
+     * @param output_size - Output size, it can be 0 if unknown.
+     * @param index - Position selected by INDEX_OP, starting at 0.
+     */
+    int addOperation(NodeOp op, const char *name,
+                     unsigned int input_size=0, unsigned int output_size=0,
+                     unsigned int index=0);
+    /// Connects output of node @c src with input of node @c dst.
+    void connect(int src, int dst, unsigned int delay=0);
+
+    /// Number of nodes, without INPUT_NODE and OUTPUT_NODE.
+    unsigned int getNumNodes() const { return nodes.size(); }
+    bool getIsRecurrent() const { return max_delay > 0; }
+    unsigned int getMaxDelay() const { return max_delay; }
+    /// Current time step, starting at 1, it is 0 after reset().
+    unsigned int getBPTTStep() const { return bptt_step; }
+    unsigned int getBPTTTruncation() const { return backstep; }
+    void setBPTTTruncation(unsigned int backstep);
+
+    /**
+     * @brief Forces BPTT and gradients computation.
+     *
+     * Puts at @c result the error output of the graph input for every time
+     * step, starting at step 1.
+     */
+    void bpttBackprop(AprilUtils::vector< AprilUtils::SharedPtr<Basics::Token> > &result);
+    
+    /**
+     * @brief Puts at @c dict the state of every node at the given time step.
+     *
+     * It is a table with fields input, output, error_input and error_output,
+     * indexed by node name. The graph input and output are indexed by
+     * @c name::input and @c name::output.
+     */
+    void copyBPTTState(unsigned int step, AprilUtils::LuaTable &dict);
+    
+    virtual Basics::Token *getInput() { return input.get(); }
+    virtual Basics::Token *getOutput() { return output.get(); }
+    virtual Basics::Token *getErrorInput() { return error_input.get(); }
+    virtual Basics::Token *getErrorOutput() { return error_output.get(); }
+    virtual void setInput(Basics::Token *tk) { input = tk; }
+    virtual void setOutput(Basics::Token *tk) { output = tk; }
+    virtual void setErrorInput(Basics::Token *tk) { error_input = tk; }
+    virtual void setErrorOutput(Basics::Token *tk) { error_output = tk; }
+
+    virtual void copyState(AprilUtils::LuaTable &dict);
+    virtual void setState(AprilUtils::LuaTable &dict);
+    
+    /// Backprop writes the gradients into Lua tables.
+    virtual bool getIsThreadSafe() const { return false; }
+    
+    virtual Basics::Token *doForward(Basics::Token* input, bool during_training);
+    /**
+     * @brief Stores the given error at the current time step.
+     *
+     * BPTT is executed for non recurrent graphs and when the current step is
+     * the last one of the truncation window, otherwise a null token is
+     * returned, and BPTT is delayed until computeAllGradients() or
+     * bpttBackprop().
+     */
+    virtual Basics::Token *doBackprop(Basics::Token *input_error);
+    virtual void reset(unsigned int it=0);
+    virtual void computeAllGradients(AprilUtils::LuaTable &weight_grads_dict);
+    virtual ANNComponent *clone(AprilUtils::LuaTable &copies);
+    virtual void setUseCuda(bool v);
+    virtual void build(unsigned int input_size,
+		       unsigned int output_size,
+		       AprilUtils::LuaTable &weights_dict,
+		       AprilUtils::LuaTable &components_dict);
+    virtual void copyWeights(AprilUtils::LuaTable &weights_dict);
+    virtual void copyComponents(AprilUtils::LuaTable &components_dict);
+    virtual ANNComponent *getComponent(AprilUtils::string &name);
+    virtual void debugInfo();
+
+    virtual const char *luaCtorName() const;
+    virtual int exportParamsToLua(lua_State *L);
+
+  private:
+    struct Edge {
+      int node;
+      unsigned int delay;
+      Edge(int node=0, unsigned int delay=0) : node(node), delay(delay) { }
+    };
+
+    struct Node {
+      NodeOp op;
+      AprilUtils::string name;
+      AprilUtils::SharedPtr<ANNComponent> component;
+      unsigned int input_size, output_size, index;
+      AprilUtils::vector<Edge> in_edges;
+      unsigned int num_out_edges;
+      /// Output used for delayed edges before the first time step.
+      AprilUtils::SharedPtr<Basics::Token> zero;
+    };
+
+    /// Tokens of one node (or graph input/output) at one time step.
+    struct NodeState {
+      AprilUtils::SharedPtr<Basics::Token> input, output;
+      AprilUtils::SharedPtr<Basics::Token> error_input, error_output;
+      /// Indicates if error_input is owned by the graph, otherwise it is
+      /// shared with the node which produced it and it is cloned before
+      /// accumulating another error.
+      bool error_owned;
+      NodeState() : error_owned(false) { }
+      void clear() {
+        input.reset(); output.reset();
+        error_input.reset(); error_output.reset();
+        error_owned = false;
+      }
+    };
+
+    /// States of all the nodes at one time step.
+    struct StepState {
+      AprilUtils::vector<NodeState> nodes;
+      NodeState graph_input, graph_output;
+      /// Result of copyState() of all the components.
+      AprilUtils::LuaTable components;
+      bool has_components_state;
+      StepState(unsigned int n) : nodes(n), has_components_state(false) { }
+    };
+
+    AprilUtils::vector<Node> nodes;
+    /// Input edges of OUTPUT_NODE.
+    AprilUtils::vector<Edge> output_edges;
+    /// Topological order of the nodes following non delayed edges, sorted by
+    /// dependency level.
+    AprilUtils::vector<int> order;
+    /// Position at order where every level begins, plus order.size().
+    AprilUtils::vector<unsigned int> levels;
+    /// Ring buffer with the state of every time step.
+    AprilUtils::vector<StepState*> steps;
+    unsigned int max_delay, backstep, bptt_step;
+    /// Size of the input dimension of the first node connected to the input.
+    unsigned int graph_input_size;
+    bool gradients_computed;
+    AprilUtils::LuaTable grads;
+    AprilUtils::SharedPtr<Basics::Token> input, output, error_input, error_output;
+    
+    void computeOrder();
+    bool useInterOpParallelism() const;
+    /// Throws the error of the first failed node of the level which starts
+    /// at the given position of the order.
+    void checkNodeErrors(AprilUtils::vector<AprilUtils::string> &errors,
+                         int begin);
+    unsigned int sumInputSizes(const AprilUtils::vector<Edge> &edges) const;
+    unsigned int getNodeOutputSize(int node) const;
+    unsigned int getEffectiveBackstep() const {
+      return getIsRecurrent() ? backstep : 1u;
+    }
+    StepState *getStep(unsigned int step);
+    /// Returns the state of the given node at the given time step, or NULL.
+    NodeState *getNodeState(int node, unsigned int step, unsigned int delay);
+    Basics::Token *getZero(int node, int bunch_size);
+    Basics::Token *composeInput(const AprilUtils::vector<Edge> &edges,
+                                int bunch_size);
+    Basics::Token *forwardOperation(Node &node, Basics::Token *tk);
+    Basics::Token *backpropOperation(Node &node, NodeState &state,
+                                     Basics::Token *tk);
+    void accumulateError(NodeState &state, Basics::Token *tk);
+    void distributeError(const AprilUtils::vector<Edge> &edges,
+                         Basics::Token *tk, unsigned int step);
+    void computeStepGradients(StepState *st);
+    void runBPTT();
+  };
+
+} // namespace ANN
+
+#endif // GRAPHCOMPONENT_H
@@ -0,0 +1,138 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include <cmath>
+#include "gru_component.h"
+#include "unused_variable.h"
+
+using namespace AprilUtils;
+using namespace Basics;
+
+namespace ANN {
+
+  namespace {
+    /// Minimum number of values in a timestep to run it in parallel.
+    const int MIN_PARALLEL_SIZE = 4096;
+    
+    inline float logistic(float x) { return 1.0f / (1.0f + expf(-x)); }
+  }
+  
+  GRUANNComponent::GRUANNComponent(const char *name,
+                                   const char *weights_name,
+                                   unsigned int input_units,
+                                   unsigned int hidden_units,
+                                   unsigned int bptt_truncation,
+                                   MatrixFloat *w_mat,
+                                   MatrixFloat *u_mat,
+                                   MatrixFloat *b_mat) :
+    SequenceRecurrentANNComponent(name, weights_name, "gru",
+                                  input_units, hidden_units, 3,
+                                  bptt_truncation, w_mat, u_mat, b_mat) {
+  }
+
+  GRUANNComponent::~GRUANNComponent() {
+  }
+
+  void GRUANNComponent::prepareSequence(int seq_len, int bunch_size) {
+    UNUSED_VARIABLE(seq_len);
+    UNUSED_VARIABLE(bunch_size);
+  }
+
+  void GRUANNComponent::forwardStep(int t, int bunch_size,
+                                    float *gx, const float *gh,
+                                    const float *bias,
+                                    const float *h_prev, float *h) {
+    UNUSED_VARIABLE(t);
+    const int H = static_cast<int>(hidden_units);
+#pragma omp parallel for if(bunch_size*H >= MIN_PARALLEL_SIZE)
+    for (int b=0; b<bunch_size; ++b) {
+      float *gx_b = gx + b*3*H;
+      const float *gh_b = gh + b*3*H;
+      for (int j=0; j<H; ++j) {
+        const int k = b*H + j;
+        // gates: reset, update, candidate
+        const float r = logistic(gx_b[j]   + gh_b[j]   + bias[j]);
+        const float z = logistic(gx_b[H+j] + gh_b[H+j] + bias[H+j]);
+        const float n = tanhf(gx_b[2*H+j] + bias[2*H+j] + r*gh_b[2*H+j]);
+        const float hp = (h_prev != 0) ? h_prev[k] : 0.0f;
+        gx_b[j] = r; gx_b[H+j] = z; gx_b[2*H+j] = n;
+        h[k] = (1.0f - z)*n + z*hp;
+      }
+    }
+  }
+
+  void GRUANNComponent::backwardStep(int t, int bunch_size,
+                                     const float *gx, const float *gh,
+                                     const float *h_prev, const float *h,
+                                     float *dh, float *dgx, float *dgh) {
+    UNUSED_VARIABLE(t);
+    UNUSED_VARIABLE(h);
+    const int H = static_cast<int>(hidden_units);
+#pragma omp parallel for if(bunch_size*H >= MIN_PARALLEL_SIZE)
+    for (int b=0; b<bunch_size; ++b) {
+      const float *gx_b = gx + b*3*H;
+      const float *gh_b = gh + b*3*H;
+      float *dgx_b = dgx + b*3*H;
+      float *dgh_b = dgh + b*3*H;
+      for (int j=0; j<H; ++j) {
+        const int k = b*H + j;
+        const float r = gx_b[j], z = gx_b[H+j], n = gx_b[2*H+j];
+        const float hp = (h_prev != 0) ? h_prev[k] : 0.0f;
+        const float dn = dh[k]*(1.0f - z)*(1.0f - n*n);
+        const float dz = dh[k]*(hp - n)*z*(1.0f - z);
+        const float dr = dn*gh_b[2*H+j]*r*(1.0f - r);
+        dgx_b[j] = dgh_b[j] = dr;
+        dgx_b[H+j] = dgh_b[H+j] = dz;
+        dgx_b[2*H+j] = dn;
+        dgh_b[2*H+j] = dn*r;
+        // direct path of the hidden state to t-1
+        dh[k] = dh[k]*z;
+      }
+    }
+  }
+
+  void GRUANNComponent::resetBackwardCarry(int bunch_size) {
+    UNUSED_VARIABLE(bunch_size);
+  }
+  
+  ANNComponent *GRUANNComponent::clone(AprilUtils::LuaTable &copies) {
+    UNUSED_VARIABLE(copies);
+    GRUANNComponent *component = new GRUANNComponent(name.c_str(),
+                                                     weights_name.c_str(),
+                                                     input_units,
+                                                     hidden_units,
+                                                     bptt_truncation);
+    component->input_size  = input_size;
+    component->output_size = output_size;
+    return component;
+  }
+
+  const char *GRUANNComponent::luaCtorName() const {
+    return "ann.components.gru";
+  }
+  
+  int GRUANNComponent::exportParamsToLua(lua_State *L) {
+    AprilUtils::LuaTable t(L);
+    exportCommonParams(t);
+    t.pushTable(L);
+    return 1;
+  }
+  
+} // namespace ANN
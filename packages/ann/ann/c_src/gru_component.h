@@ -0,0 +1,75 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef GRUCOMPONENT_H
+#define GRUCOMPONENT_H
+
+#include "sequence_recurrent_component.h"
+
+namespace ANN {
+
+  /**
+   * @brief A GRU layer which processes whole sequences with fused gate
+   * computations.
+   *
+   * The gates are stacked in the order reset, update and candidate, and the
+   * reset gate is applied after the recurrent projection of the candidate:
+   *
+   * - <tt>r = logistic(W_r x_t + U_r h_{t-1} + b_r)</tt>
+   * - <tt>z = logistic(W_z x_t + U_z h_{t-1} + b_z)</tt>
+   * - <tt>n = tanh(W_n x_t + b_n + r * (U_n h_{t-1}))</tt>
+   * - <tt>h_t = (1 - z) * n + z * h_{t-1}</tt>
+   *
+   * All the gates and the state update of a timestep are computed in one
+   * pass.
+   *
+   * @see SequenceRecurrentANNComponent
+   */
+  class GRUANNComponent : public SequenceRecurrentANNComponent {
+    APRIL_DISALLOW_COPY_AND_ASSIGN(GRUANNComponent);
+    
+  protected:
+    virtual void prepareSequence(int seq_len, int bunch_size);
+    virtual void forwardStep(int t, int bunch_size,
+                             float *gx, const float *gh, const float *bias,
+                             const float *h_prev, float *h);
+    virtual void backwardStep(int t, int bunch_size,
+                              const float *gx, const float *gh,
+                              const float *h_prev, const float *h,
+                              float *dh, float *dgx, float *dgh);
+    virtual void resetBackwardCarry(int bunch_size);
+    
+  public:
+    GRUANNComponent(const char *name, const char *weights_name,
+                    unsigned int input_units, unsigned int hidden_units,
+                    unsigned int bptt_truncation=0,
+                    Basics::MatrixFloat *w_mat=0,
+                    Basics::MatrixFloat *u_mat=0,
+                    Basics::MatrixFloat *b_mat=0);
+    virtual ~GRUANNComponent();
+    
+    virtual ANNComponent *clone(AprilUtils::LuaTable &copies);
+    virtual const char *luaCtorName() const;
+    virtual int exportParamsToLua(lua_State *L);
+  };
+  
+} // namespace ANN
+
+#endif // GRUCOMPONENT_H
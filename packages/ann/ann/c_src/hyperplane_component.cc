@@ -127,6 +127,8 @@ namespace ANN {
     //
     dot_product->build(input_size, output_size, weights_dict, components_dict);
     bias->build(output_size, output_size, weights_dict, components_dict);
+    // the dot product output is only used as bias input
+    bias->setInPlace(getMemoryPlanning());
   }
   
   void HyperplaneANNComponent::copyWeights(AprilUtils::LuaTable &weights_dict) {
@@ -90,6 +90,10 @@ namespace ANN {
     
     virtual void setUseCuda(bool v);
     
+    virtual bool isOutputOverwritable() const {
+      return bias->isOutputOverwritable();
+    }
+
     virtual void build(unsigned int input_size,
 		       unsigned int output_size,
 		       AprilUtils::LuaTable &weights_dict,
@@ -21,6 +21,8 @@
 #include "error_print.h"
 #include "table_of_token_codes.h"
 #include "join_component.h"
+#include "maxmin.h"
+#include "omp_utils.h"
 #include "token_sparse_matrix.h"
 
 using namespace AprilMath;
@@ -245,14 +247,51 @@ namespace ANN {
     return buildMatrixFloatToken(vector_token, is_output);
   }
   
+  bool JoinANNComponent::useInterOpParallelism() const {
+    return getInterOpParallelism() && !use_cuda &&
+      components.size() > 1 && getIsThreadSafe();
+  }
+  
+  void JoinANNComponent::checkComponentErrors(vector<string> &errors) {
+    for (unsigned int i=0; i<errors.size(); ++i) {
+      if (!errors[i].empty()) {
+        ERROR_EXIT3(128, "Component %u failed: %s [%s]\n",
+                    i+1, errors[i].c_str(), name.c_str());
+      }
+    }
+  }
+  
   Token *JoinANNComponent::doForward(Token* _input, bool during_training) {
     AssignRef(input, _input);
     // INFO: will be possible to put this method inside next loop, but seems
     // more simpler a decoupled code
     buildInputBunchVector(input_vector, _input);
-    for (unsigned int i=0; i<components.size(); ++i)
-      (*output_vector)[i] = components[i]->doForward((*input_vector)[i].get(),
-                                                     during_training);
+    // every component writes its own position, the join order is fixed
+    const int n = static_cast<int>(components.size());
+    const bool concurrent = useInterOpParallelism();
+    // an exception can't leave the parallel region, the error messages of
+    // the components are kept and the first one is thrown after it
+    vector<string> errors(n);
+#ifndef NO_OMP
+    int num_threads = AprilUtils::min(n, OMPUtils::get_num_threads());
+#pragma omp parallel for schedule(dynamic,1) num_threads(num_threads) if(concurrent)
+#else
+    UNUSED_VARIABLE(concurrent);
+#endif
+    for (int i=0; i<n; ++i) {
+      try {
+        (*output_vector)[i] =
+          components[i]->doForward((*input_vector)[i].get(), during_training);
+      }
+      catch (char *msg) { // thrown by ERROR_EXIT macros
+        errors[i] = msg;
+        delete[] msg;
+      }
+      catch (...) {
+        errors[i] = "unknown error";
+      }
+    }
+    checkComponentErrors(errors);
     // INFO: will be possible to put this method inside previous loop, but seems
     // more simpler a decoupled code
     AssignRef(output, buildMatrixFloatToken(output_vector, true));
@@ -272,9 +311,29 @@ namespace ANN {
     // INFO: will be possible to put this method inside previous loop, but seems
     // more simpler a decoupled code
     buildErrorInputBunchVector(error_input_vector, _error_input);
-    for (unsigned int i=0; i<components.size(); ++i)
-      (*error_output_vector)[i] =
-        components[i]->doBackprop((*error_input_vector)[i].get());
+    const int n = static_cast<int>(components.size());
+    const bool concurrent = useInterOpParallelism();
+    vector<string> errors(n);
+#ifndef NO_OMP
+    int num_threads = AprilUtils::min(n, OMPUtils::get_num_threads());
+#pragma omp parallel for schedule(dynamic,1) num_threads(num_threads) if(concurrent)
+#else
+    UNUSED_VARIABLE(concurrent);
+#endif
+    for (int i=0; i<n; ++i) {
+      try {
+        (*error_output_vector)[i] =
+          components[i]->doBackprop((*error_input_vector)[i].get());
+      }
+      catch (char *msg) { // thrown by ERROR_EXIT macros
+        errors[i] = msg;
+        delete[] msg;
+      }
+      catch (...) {
+        errors[i] = "unknown error";
+      }
+    }
+    checkComponentErrors(errors);
     // error_output_vector has the gradients of each component stored as
     // array. Depending on the received input, this vector would be returned as
     // it is, or gradients will be stored as a TokenMatrixFloat joining all
@@ -33,6 +33,12 @@ namespace ANN {
   /// components. So, the input is spliced, and the input size must be the sum
   /// of components input sizes. The output is a join of all the components
   /// outputs.
+  ///
+  /// Contained components are independent, so doForward() and doBackprop()
+  /// execute them concurrently in OMP threads when inter-operator parallelism
+  /// is enabled (it is opt-in, see ANNComponent::setInterOpParallelism()) and
+  /// all of them are thread safe. Gradients are computed one component after
+  /// another because they are written into Lua tables.
 
   class JoinANNComponent : public ANNComponent {
     APRIL_DISALLOW_COPY_AND_ASSIGN(JoinANNComponent);
@@ -55,6 +61,8 @@ namespace ANN {
 			       Basics::Token *token);
     void buildErrorInputBunchVector(Basics::TokenBunchVector *&vector_token,
 				    Basics::Token *token);
+    bool useInterOpParallelism() const;
+    void checkComponentErrors(AprilUtils::vector<AprilUtils::string> &errors);
     Basics::TokenMatrixFloat *buildMatrixFloatToken(Basics::TokenBunchVector *token,
                                                     bool is_output);
     Basics::TokenMatrixFloat *buildMatrixFloatToken(Basics::Token *token,
@@ -106,6 +114,13 @@ namespace ANN {
 		 "Impossible to precomputeOutputSize in JoinANNComponent\n");
     }
     
+    virtual bool getIsThreadSafe() const {
+      for (unsigned int i=0; i<components.size(); ++i) {
+        if (!components[i]->getIsThreadSafe()) return false;
+      }
+      return true;
+    }
+
     virtual Basics::Token *doForward(Basics::Token* input, bool during_training);
 
     virtual Basics::Token *doBackprop(Basics::Token *input_error);
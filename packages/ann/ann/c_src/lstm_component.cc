@@ -0,0 +1,158 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include <cmath>
+#include "lstm_component.h"
+#include "matrix_ext.h"
+#include "unused_variable.h"
+
+using namespace AprilMath::MatrixExt::Initializers;
+using namespace AprilUtils;
+using namespace Basics;
+
+namespace ANN {
+
+  namespace {
+    /// Minimum number of values in a timestep to run it in parallel.
+    const int MIN_PARALLEL_SIZE = 4096;
+    
+    inline float logistic(float x) { return 1.0f / (1.0f + expf(-x)); }
+  }
+  
+  LSTMANNComponent::LSTMANNComponent(const char *name,
+                                     const char *weights_name,
+                                     unsigned int input_units,
+                                     unsigned int hidden_units,
+                                     unsigned int bptt_truncation,
+                                     MatrixFloat *w_mat,
+                                     MatrixFloat *u_mat,
+                                     MatrixFloat *b_mat) :
+    SequenceRecurrentANNComponent(name, weights_name, "lstm",
+                                  input_units, hidden_units, 4,
+                                  bptt_truncation, w_mat, u_mat, b_mat) {
+  }
+
+  LSTMANNComponent::~LSTMANNComponent() {
+  }
+
+  void LSTMANNComponent::prepareSequence(int seq_len, int bunch_size) {
+    const int H = static_cast<int>(hidden_units);
+    if (c_mat.empty() || c_mat->getDimSize(0) != seq_len ||
+        c_mat->getDimSize(1) != bunch_size) {
+      int dims[3] = { seq_len, bunch_size, H };
+      c_mat = new MatrixFloat(3, dims);
+    }
+  }
+
+  void LSTMANNComponent::forwardStep(int t, int bunch_size,
+                                     float *gx, const float *gh,
+                                     const float *bias,
+                                     const float *h_prev, float *h) {
+    UNUSED_VARIABLE(h_prev);
+    const int H = static_cast<int>(hidden_units);
+    float *c = getData(c_mat.get()) + t*bunch_size*H;
+    const float *c_prev = (t > 0) ? (c - bunch_size*H) : 0;
+#pragma omp parallel for if(bunch_size*H >= MIN_PARALLEL_SIZE)
+    for (int b=0; b<bunch_size; ++b) {
+      float *gx_b = gx + b*4*H;
+      const float *gh_b = gh + b*4*H;
+      for (int j=0; j<H; ++j) {
+        const int k = b*H + j;
+        // gates: input, forget, output, cell candidate
+        const float i = logistic(gx_b[j]     + gh_b[j]     + bias[j]);
+        const float f = logistic(gx_b[H+j]   + gh_b[H+j]   + bias[H+j]);
+        const float o = logistic(gx_b[2*H+j] + gh_b[2*H+j] + bias[2*H+j]);
+        const float g = tanhf(gx_b[3*H+j] + gh_b[3*H+j] + bias[3*H+j]);
+        const float ct = ((c_prev != 0) ? f*c_prev[k] : 0.0f) + i*g;
+        gx_b[j] = i; gx_b[H+j] = f; gx_b[2*H+j] = o; gx_b[3*H+j] = g;
+        c[k] = ct;
+        h[k] = o * tanhf(ct);
+      }
+    }
+  }
+
+  void LSTMANNComponent::backwardStep(int t, int bunch_size,
+                                      const float *gx, const float *gh,
+                                      const float *h_prev, const float *h,
+                                      float *dh, float *dgx, float *dgh) {
+    UNUSED_VARIABLE(gh);
+    UNUSED_VARIABLE(h_prev);
+    UNUSED_VARIABLE(h);
+    const int H = static_cast<int>(hidden_units);
+    const float *c = getData(c_mat.get()) + t*bunch_size*H;
+    const float *c_prev = (t > 0) ? (c - bunch_size*H) : 0;
+    float *dc = getData(dc_mat.get());
+#pragma omp parallel for if(bunch_size*H >= MIN_PARALLEL_SIZE)
+    for (int b=0; b<bunch_size; ++b) {
+      const float *gx_b = gx + b*4*H;
+      float *dgx_b = dgx + b*4*H;
+      float *dgh_b = dgh + b*4*H;
+      for (int j=0; j<H; ++j) {
+        const int k = b*H + j;
+        const float i = gx_b[j], f = gx_b[H+j], o = gx_b[2*H+j], g = gx_b[3*H+j];
+        const float tc = tanhf(c[k]);
+        const float dct = dc[k] + dh[k]*o*(1.0f - tc*tc);
+        const float di = dct*g*i*(1.0f - i);
+        const float df = ((c_prev != 0) ? dct*c_prev[k] : 0.0f)*f*(1.0f - f);
+        const float d_o = dh[k]*tc*o*(1.0f - o);
+        const float dg = dct*i*(1.0f - g*g);
+        dgx_b[j] = dgh_b[j] = di;
+        dgx_b[H+j] = dgh_b[H+j] = df;
+        dgx_b[2*H+j] = dgh_b[2*H+j] = d_o;
+        dgx_b[3*H+j] = dgh_b[3*H+j] = dg;
+        dc[k] = dct*f;
+        // the hidden state only reaches t-1 through the recurrent projection
+        dh[k] = 0.0f;
+      }
+    }
+  }
+
+  void LSTMANNComponent::resetBackwardCarry(int bunch_size) {
+    int dims[2] = { bunch_size, static_cast<int>(hidden_units) };
+    if (dc_mat.empty() || !dc_mat->sameDim(dims, 2)) {
+      dc_mat = new MatrixFloat(2, dims);
+    }
+    matZeros(dc_mat.get());
+  }
+  
+  ANNComponent *LSTMANNComponent::clone(AprilUtils::LuaTable &copies) {
+    UNUSED_VARIABLE(copies);
+    LSTMANNComponent *component = new LSTMANNComponent(name.c_str(),
+                                                       weights_name.c_str(),
+                                                       input_units,
+                                                       hidden_units,
+                                                       bptt_truncation);
+    component->input_size  = input_size;
+    component->output_size = output_size;
+    return component;
+  }
+
+  const char *LSTMANNComponent::luaCtorName() const {
+    return "ann.components.lstm";
+  }
+  
+  int LSTMANNComponent::exportParamsToLua(lua_State *L) {
+    AprilUtils::LuaTable t(L);
+    exportCommonParams(t);
+    t.pushTable(L);
+    return 1;
+  }
+  
+} // namespace ANN
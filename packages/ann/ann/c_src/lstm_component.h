@@ -0,0 +1,81 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef LSTMCOMPONENT_H
+#define LSTMCOMPONENT_H
+
+#include "sequence_recurrent_component.h"
+
+namespace ANN {
+
+  /**
+   * @brief A LSTM layer which processes whole sequences with fused gate
+   * computations.
+   *
+   * The gates are stacked in the order input, forget, output and cell
+   * candidate:
+   *
+   * - <tt>i = logistic(W_i x_t + U_i h_{t-1} + b_i)</tt>
+   * - <tt>f = logistic(W_f x_t + U_f h_{t-1} + b_f)</tt>
+   * - <tt>o = logistic(W_o x_t + U_o h_{t-1} + b_o)</tt>
+   * - <tt>g = tanh(W_g x_t + U_g h_{t-1} + b_g)</tt>
+   * - <tt>c_t = f * c_{t-1} + i * g</tt>
+   * - <tt>h_t = o * tanh(c_t)</tt>
+   *
+   * All the gates and the cell update of a timestep are computed in one pass.
+   *
+   * @see SequenceRecurrentANNComponent
+   */
+  class LSTMANNComponent : public SequenceRecurrentANNComponent {
+    APRIL_DISALLOW_COPY_AND_ASSIGN(LSTMANNComponent);
+
+    /// Cell states (T x bunch_size x hidden_units).
+    AprilUtils::SharedPtr<Basics::MatrixFloat> c_mat;
+    /// Cell error carried between timesteps (bunch_size x hidden_units).
+    AprilUtils::SharedPtr<Basics::MatrixFloat> dc_mat;
+    
+  protected:
+    virtual void prepareSequence(int seq_len, int bunch_size);
+    virtual void forwardStep(int t, int bunch_size,
+                             float *gx, const float *gh, const float *bias,
+                             const float *h_prev, float *h);
+    virtual void backwardStep(int t, int bunch_size,
+                              const float *gx, const float *gh,
+                              const float *h_prev, const float *h,
+                              float *dh, float *dgx, float *dgh);
+    virtual void resetBackwardCarry(int bunch_size);
+    
+  public:
+    LSTMANNComponent(const char *name, const char *weights_name,
+                     unsigned int input_units, unsigned int hidden_units,
+                     unsigned int bptt_truncation=0,
+                     Basics::MatrixFloat *w_mat=0,
+                     Basics::MatrixFloat *u_mat=0,
+                     Basics::MatrixFloat *b_mat=0);
+    virtual ~LSTMANNComponent();
+    
+    virtual ANNComponent *clone(AprilUtils::LuaTable &copies);
+    virtual const char *luaCtorName() const;
+    virtual int exportParamsToLua(lua_State *L);
+  };
+  
+} // namespace ANN
+
+#endif // LSTMCOMPONENT_H
@@ -0,0 +1,76 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef MATRIXBUFFER_H
+#define MATRIXBUFFER_H
+
+#include "matrixFloat.h"
+#include "smart_ptr.h"
+
+namespace ANN {
+
+  /**
+   * @brief A preallocated matrix which ANN components reuse in every
+   * doForward()/doBackprop() call.
+   *
+   * The buffer is reused when its dimensions match the requested ones and
+   * nobody else references it, neither the matrix nor its memory block (Lua
+   * references, rewraps or slices). Otherwise a new matrix is allocated and
+   * becomes the buffer. Therefore, the returned matrix content is undefined
+   * and it should be overwritten by the caller.
+   *
+   * @note Components keep their buffers after reset(), so training steps with
+   * the same bunch size don't allocate output and error matrices.
+   */
+  class MatrixBuffer {
+    AprilUtils::SharedPtr<Basics::MatrixFloat> buffer;
+
+    bool isReusable(int num_dim, const int *dims) {
+      if (buffer.empty() ||
+          buffer->getRef() != 1 ||
+          buffer->getRawDataAccess()->getRef() != 1 ||
+          buffer->getNumDim() != num_dim) return false;
+      for (int i=0; i<num_dim; ++i) {
+        if (buffer->getDimSize(i) != dims[i]) return false;
+      }
+      return true;
+    }
+
+  public:
+    /// Returns a contiguous matrix with the given dimensions.
+    Basics::MatrixFloat *get(int num_dim, const int *dims) {
+      if (!isReusable(num_dim, dims)) {
+        buffer = new Basics::MatrixFloat(num_dim, dims);
+      }
+      return buffer.get();
+    }
+
+    /// Returns a contiguous matrix with the same dimensions as the given one.
+    Basics::MatrixFloat *getLike(const Basics::MatrixFloat *other) {
+      return get(other->getNumDim(), other->getDimPtr());
+    }
+
+    /// Releases the buffer.
+    void clear() { buffer.reset(); }
+  };
+
+} // namespace ANN
+
+#endif // MATRIXBUFFER_H
@@ -90,7 +90,9 @@ namespace ANN {
     /////////////////////////
     april_assert(output_size == 0 ||
                  output_mat == 0 ||
-                 output_mat->size()/output_mat->getDimSize(0) == static_cast<int>(output_size));
+                 output_mat->size()/output_mat->getDimSize(0) ==
+                 static_cast<int>(during_training ? getTrainingOutputSize() :
+                                  output_size));
     AssignRef(output,new TokenMatrixFloat(output_mat));
     return output;
   }
@@ -109,7 +111,7 @@ namespace ANN {
 #endif
     ASSERT_MATRIX(error_input_mat);
     april_assert(output_size == 0 ||
-                 error_input_mat->size()/error_input_mat->getDimSize(0) == static_cast<int>(output_size));
+                 error_input_mat->size()/error_input_mat->getDimSize(0) == static_cast<int>(getTrainingOutputSize()));
     if (getInputContiguousProperty() && !error_input_mat->getIsContiguous()) {
       error_input_mat = error_input_mat->clone();
       AssignRef(error_input,new TokenMatrixFloat(error_input_mat));
@@ -81,6 +81,13 @@ namespace ANN {
      * @param it - Current iteration of optimization algorithm.
      */
     virtual void privateReset(unsigned int it=0) = 0;
+
+    /**
+     * Number of output columns of a forward during training (and of the
+     * error input at backprop), it is the output size unless overridden by
+     * components which produce a different training output.
+     */
+    virtual unsigned int getTrainingOutputSize() const { return output_size; }
     
     // virtual void computeGradients(AprilUtils::SharedPtr<MatrixFloat> &grad_mat) = 0;
     
@@ -0,0 +1,365 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include <cstring>
+
+#include "april_assert.h"
+#include "cblas_headers.h"
+#include "cmath_overloads.h"
+#include "connection.h"
+#include "nce_component.h"
+#include "simd_kernels.h"
+#include "unused_variable.h"
+
+using namespace AprilMath;
+using namespace AprilMath::MatrixExt::BLAS;
+using namespace AprilMath::MatrixExt::Initializers;
+using namespace AprilUtils;
+using namespace Basics;
+
+namespace ANN {
+
+  NCEANNComponent::NCEANNComponent(unsigned int vocab_size,
+                                   unsigned int num_samples,
+                                   MTRand *random, MatrixFloat *noise,
+                                   const char *name,
+                                   const char *weights_name,
+                                   unsigned int input_size,
+                                   MatrixFloat *matrix) :
+    VirtualMatrixANNComponent(name, weights_name, input_size, 1u),
+    vocab_size(vocab_size), num_samples(num_samples),
+    random(random), noise(noise), weights_matrix(matrix),
+    hidden_mat(0), noise_weights_mat(0) {
+    setInputContiguousProperty(true);
+    if (weights_name == 0) generateDefaultWeightsName("w");
+    if (vocab_size == 0 || num_samples == 0) {
+      ERROR_EXIT1(128, "Needs a vocabulary size and a number of samples "
+                  "greater than zero [%s]\n", this->name.c_str());
+    }
+    april_assert(random != 0 && "Needs a random object\n");
+    initNoiseDistribution();
+  }
+
+  NCEANNComponent::~NCEANNComponent() {
+  }
+
+  void NCEANNComponent::initNoiseDistribution() {
+    noise_cdf.resize(vocab_size);
+    log_noise.resize(vocab_size);
+    if (noise.empty()) {
+      for (unsigned int w=0; w<vocab_size; ++w) noise_cdf[w] = 1.0;
+    }
+    else {
+      if (noise->getNumDim() != 1 ||
+          noise->getDimSize(0) != static_cast<int>(vocab_size)) {
+        ERROR_EXIT2(128, "Needs a one dimensional noise matrix with %u "
+                    "values [%s]\n", vocab_size, name.c_str());
+      }
+      unsigned int w = 0;
+      for (MatrixFloat::const_iterator it(noise->begin());
+           it != noise->end(); ++it, ++w) {
+        if (!(*it > 0.0f)) {
+          ERROR_EXIT1(128, "Noise distribution should be positive for all "
+                      "words, smooth it [%s]\n", name.c_str());
+        }
+        noise_cdf[w] = static_cast<double>(*it);
+      }
+    }
+    double sum = 0.0;
+    for (unsigned int w=0; w<vocab_size; ++w) sum += noise_cdf[w];
+    double acc = 0.0;
+    for (unsigned int w=0; w<vocab_size; ++w) {
+      log_noise[w] = static_cast<float>(m_log(num_samples * noise_cdf[w] / sum));
+      acc += noise_cdf[w];
+      noise_cdf[w] = acc / sum;
+    }
+    noise_cdf[vocab_size - 1] = 1.0;
+  }
+
+  unsigned int NCEANNComponent::sampleNoiseWord() {
+    // binary search of the first cumulative probability greater than r
+    double r = random->randExc();
+    unsigned int lo = 0, hi = vocab_size - 1;
+    while (lo < hi) {
+      unsigned int mid = (lo + hi) / 2;
+      if (noise_cdf[mid] > r) hi = mid;
+      else lo = mid + 1;
+    }
+    return lo;
+  }
+
+  MatrixFloat *NCEANNComponent::computeLogProbabilities(int bunch_size) {
+    int scores_dims[2] = { bunch_size, static_cast<int>(vocab_size) };
+    MatrixFloat *scores = scores_buffer.get(2, scores_dims);
+    matGemm(scores, CblasNoTrans, CblasTrans,
+            1.0f, hidden_mat, weights_matrix.get(), 0.0f);
+    int output_dims[2] = { bunch_size, 1 };
+    MatrixFloat *output = output_buffer.get(2, output_dims);
+    const float *scores_ptr = scores->getRawDataAccess()->getPPALForRead() +
+      scores->getOffset();
+    float *output_ptr = output->getRawDataAccess()->getPPALForWrite() +
+      output->getOffset();
+    for (int b=0; b<bunch_size; ++b) {
+      const float *row = scores_ptr + b*vocab_size;
+      float maximum = row[0], sum = 0.0f;
+      SIMD::vecMaxReduce(vocab_size, row, maximum);
+      SIMD::vecExpSum(vocab_size, row, maximum, 0, sum);
+      output_ptr[b] = row[targets[b]] - (maximum + m_log(sum));
+    }
+    return output;
+  }
+
+  void NCEANNComponent::checkTrainingForward() const {
+    if (samples.empty()) {
+      ERROR_EXIT1(128, "Backprop needs a forward during training [%s]\n",
+                  name.c_str());
+    }
+  }
+
+  MatrixFloat *NCEANNComponent::privateDoForward(MatrixFloat* input,
+                                                 bool during_training) {
+    if (weights_matrix.empty()) ERROR_EXIT1(129, "Not built component %s\n",
+                                            name.c_str());
+    if (input->getNumDim() != 2 ||
+        input->getDimSize(1) != static_cast<int>(input_size)) {
+      ERROR_EXIT2(128, "A bi-dimensional matrix with %u columns is expected "
+                  "[%s]\n", input_size, name.c_str());
+    }
+    const int bunch_size = input->getDimSize(0);
+    const int num_inputs = static_cast<int>(input_size);
+    const int hidden_size = num_inputs - 1;
+    // the target column is replaced by ones, to compute the bias
+    hidden_mat = hidden_buffer.getLike(input);
+    matCopy(hidden_mat, input);
+    float *hidden_ptr = hidden_mat->getRawDataAccess()->getPPALForReadAndWrite() +
+      hidden_mat->getOffset();
+    targets.resize(bunch_size);
+    for (int b=0; b<bunch_size; ++b) {
+      float &t = hidden_ptr[b*num_inputs + hidden_size];
+      int w = static_cast<int>(t) - 1;
+      if (w < 0 || w >= static_cast<int>(vocab_size) ||
+          static_cast<float>(w + 1) != t) {
+        ERROR_EXIT3(128, "Incorrect target word %g at row %d [%s]\n",
+                    t, b+1, name.c_str());
+      }
+      targets[b] = w;
+      t = 1.0f;
+    }
+    if (!during_training) {
+      samples.clear();
+      return computeLogProbabilities(bunch_size);
+    }
+    // noise samples, shared by all the bunch
+    int noise_dims[2] = { static_cast<int>(num_samples), num_inputs };
+    noise_weights_mat = noise_weights_buffer.get(2, noise_dims);
+    const float *w_ptr = weights_matrix->getRawDataAccess()->getPPALForRead() +
+      weights_matrix->getOffset();
+    float *noise_w_ptr = noise_weights_mat->getRawDataAccess()->getPPALForWrite() +
+      noise_weights_mat->getOffset();
+    samples.resize(num_samples);
+    for (unsigned int j=0; j<num_samples; ++j) {
+      samples[j] = sampleNoiseWord();
+      memcpy(noise_w_ptr + j*num_inputs, w_ptr + samples[j]*num_inputs,
+             sizeof(float)*num_inputs);
+    }
+    // noise scores, columns 2 to K+1
+    int output_dims[2] = { bunch_size, static_cast<int>(num_samples + 1u) };
+    MatrixFloat *output = output_buffer.get(2, output_dims);
+    int coords[2] = { 0, 1 };
+    int sizes[2]  = { bunch_size, static_cast<int>(num_samples) };
+    AprilUtils::SharedPtr<MatrixFloat> noise_output(new MatrixFloat(output, coords,
+                                                                    sizes, false));
+    matGemm(noise_output.get(), CblasNoTrans, CblasTrans,
+            1.0f, hidden_mat, noise_weights_mat, 0.0f);
+    // target scores at first column, and noise correction for all of them
+    const int output_stride = output->getStrideSize(0);
+    float *output_ptr = output->getRawDataAccess()->getPPALForReadAndWrite() +
+      output->getOffset();
+    for (int b=0; b<bunch_size; ++b) {
+      float *row = output_ptr + b*output_stride;
+      float score = 0.0f;
+      SIMD::vecDot(num_inputs, w_ptr + targets[b]*num_inputs,
+                   hidden_ptr + b*num_inputs, score);
+      row[0] = score - log_noise[targets[b]];
+      for (unsigned int j=0; j<num_samples; ++j) {
+        row[j+1] -= log_noise[samples[j]];
+      }
+    }
+    return output;
+  }
+
+  MatrixFloat *NCEANNComponent::privateDoBackprop(MatrixFloat *error_input) {
+    checkTrainingForward();
+    const int bunch_size = error_input->getDimSize(0);
+    const int num_inputs = static_cast<int>(input_size);
+    int dims[2] = { bunch_size, num_inputs };
+    MatrixFloat *error_output = error_output_buffer.get(2, dims);
+    // noise words contribution
+    int coords[2] = { 0, 1 };
+    int sizes[2]  = { bunch_size, static_cast<int>(num_samples) };
+    AprilUtils::SharedPtr<MatrixFloat> noise_error(new MatrixFloat(error_input,
+                                                                   coords, sizes,
+                                                                   false));
+    matGemm(error_output, CblasNoTrans, CblasNoTrans,
+            1.0f, noise_error.get(), noise_weights_mat, 0.0f);
+    // target words contribution
+    const int error_stride = error_input->getStrideSize(0);
+    const float *error_ptr = error_input->getRawDataAccess()->getPPALForRead() +
+      error_input->getOffset();
+    for (int b=0; b<bunch_size; ++b) {
+      doAxpy(num_inputs, error_ptr[b*error_stride],
+             weights_matrix->getRawDataAccess(), 1u,
+             weights_matrix->getOffset() + targets[b]*num_inputs,
+             error_output->getRawDataAccess(), 1u,
+             error_output->getOffset() + b*num_inputs,
+             false);
+    }
+    // target column is not differentiable
+    AprilUtils::SharedPtr<MatrixFloat> target_col(error_output->select(1, num_inputs-1));
+    matZeros(target_col.get());
+    return error_output;
+  }
+
+  void NCEANNComponent::privateReset(unsigned int it) {
+    UNUSED_VARIABLE(it);
+    weights_matrix->resetSharedCount();
+  }
+
+  void NCEANNComponent::computeGradients(const char *name,
+                                         AprilUtils::LuaTable &weight_grads_dict) {
+    checkTrainingForward();
+    weights_matrix->addToSharedCount();
+    MatrixFloat *grads_mat = weight_grads_dict.opt<MatrixFloat*>(name, 0);
+    if (grads_mat == 0) {
+      grads_mat = weights_matrix->cloneOnlyDims();
+      matZeros(grads_mat);
+      weight_grads_dict.put(name, grads_mat);
+    }
+    else if (!grads_mat->sameDim(weights_matrix.get()) ||
+             !grads_mat->getIsContiguous()) {
+      ERROR_EXIT(128, "Incorrect weights matrix dimensions\n");
+    }
+    MatrixFloat *error_input = getErrorInputMatrix();
+    const int bunch_size = error_input->getDimSize(0);
+    const int num_inputs = static_cast<int>(input_size);
+    // noise words, repeated samples are accumulated
+    int coords[2] = { 0, 1 };
+    int sizes[2]  = { bunch_size, static_cast<int>(num_samples) };
+    AprilUtils::SharedPtr<MatrixFloat> noise_error(new MatrixFloat(error_input,
+                                                                   coords, sizes,
+                                                                   false));
+    MatrixFloat *noise_grads = noise_grads_buffer.getLike(noise_weights_mat);
+    matGemm(noise_grads, CblasTrans, CblasNoTrans,
+            1.0f, noise_error.get(), hidden_mat, 0.0f);
+    for (unsigned int j=0; j<num_samples; ++j) {
+      doAxpy(num_inputs, 1.0f,
+             noise_grads->getRawDataAccess(), 1u,
+             noise_grads->getOffset() + j*num_inputs,
+             grads_mat->getRawDataAccess(), 1u,
+             grads_mat->getOffset() + samples[j]*num_inputs,
+             false);
+    }
+    // target words
+    const int error_stride = error_input->getStrideSize(0);
+    const float *error_ptr = error_input->getRawDataAccess()->getPPALForRead() +
+      error_input->getOffset();
+    for (int b=0; b<bunch_size; ++b) {
+      doAxpy(num_inputs, error_ptr[b*error_stride],
+             hidden_mat->getRawDataAccess(), 1u,
+             hidden_mat->getOffset() + b*num_inputs,
+             grads_mat->getRawDataAccess(), 1u,
+             grads_mat->getOffset() + targets[b]*num_inputs,
+             false);
+    }
+  }
+
+  ANNComponent *NCEANNComponent::clone(AprilUtils::LuaTable &copies) {
+    MTRand *rng_clone = copies[random.get()].opt<MTRand*>(0);
+    if (rng_clone == 0) {
+      copies[random.get()] = rng_clone = new MTRand(*random);
+    }
+    return new NCEANNComponent(vocab_size, num_samples,
+                               rng_clone, noise.get(),
+                               name.c_str(), weights_name.c_str(),
+                               input_size);
+  }
+
+  void NCEANNComponent::build(unsigned int _input_size,
+                              unsigned int _output_size,
+                              AprilUtils::LuaTable &weights_dict,
+                              AprilUtils::LuaTable &components_dict) {
+    ANNComponent::build(_input_size, _output_size,
+                        weights_dict, components_dict);
+    if (input_size < 2) {
+      ERROR_EXIT1(141, "Impossible to compute input size, it should be the "
+                  "hidden layer size plus one [%s]\n", name.c_str());
+    }
+    MatrixFloat *w = weights_dict.opt<MatrixFloat*>(weights_name, 0);
+    if (w != 0) {
+      weights_matrix = w;
+    }
+    else {
+      if (weights_matrix.empty()) {
+        weights_matrix = Connections::build(input_size, vocab_size);
+      }
+      weights_dict.put(weights_name, weights_matrix.get());
+    }
+    if (!Connections::checkInputOutputSizes(weights_matrix.get(), input_size,
+                                            vocab_size) ||
+        !weights_matrix->getIsContiguous()) {
+      ERROR_EXIT3(256, "Needs a contiguous %ux%u weights matrix [%s]\n",
+                  vocab_size, input_size, name.c_str());
+    }
+  }
+
+  void NCEANNComponent::copyWeights(AprilUtils::LuaTable &weights_dict) {
+    if (weights_matrix.empty())
+      ERROR_EXIT1(100, "Component not built, impossible execute copyWeights [%s]\n",
+		  name.c_str());
+    MatrixFloat *w = weights_dict.opt<MatrixFloat*>(weights_name, 0);
+    if (w != 0 && w != weights_matrix.get())
+      ERROR_EXIT2(101, "Weights dictionary contains %s weights name which is "
+		  "not shared with weights_matrix attribute [%s]\n",
+		  weights_name.c_str(),
+		  name.c_str());
+    else if (w == 0) {
+      weights_dict.put(weights_name, weights_matrix.get());
+    }
+  }
+
+  const char *NCEANNComponent::luaCtorName() const {
+    return "ann.components.nce";
+  }
+
+  int NCEANNComponent::exportParamsToLua(lua_State *L) {
+    AprilUtils::LuaTable t(L);
+    t["name"]    = name;
+    t["weights"] = weights_name;
+    t["input"]   = input_size;
+    t["vocab"]   = vocab_size;
+    t["samples"] = num_samples;
+    t["random"]  = random.get();
+    if (!noise.empty()) t["noise"] = noise.get();
+    t["matrix"]  = weights_matrix.get();
+    t.pushTable(L);
+    return 1;
+  }
+
+} // namespace ANN
@@ -0,0 +1,134 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef NCEANNCOMPONENT_H
+#define NCEANNCOMPONENT_H
+
+#include "matrix_buffer.h"
+#include "matrix_component.h"
+#include "MersenneTwister.h"
+#include "smart_ptr.h"
+#include "token_matrix.h"
+#include "vector.h"
+
+namespace ANN {
+
+  /**
+   * @brief Noise-contrastive estimation (NCE) output layer for large
+   * vocabularies.
+   *
+   * Instead of normalizing over the V words of the vocabulary, the model is
+   * trained to discriminate the target word from K noise words sampled from
+   * a noise distribution q. For every word w the component computes
+   * s(w,h) - log(K q(w)), where s(w,h) is an unnormalized score (dot product
+   * plus bias), so the cost is O(K H) per sample instead of O(V H). The K
+   * noise words are sampled once per bunch and shared by all its samples.
+   *
+   * The input is a bi-dimensional matrix with H+1 columns, the hidden layer
+   * followed by the target word index (starting at 1), as produced by an
+   * ann.components.join or an ann.graph.bind. During training the output is
+   * a bunch_size x (K+1) matrix, first column for target words and next K
+   * columns for noise words, which can be trained with ann.loss.nce.
+   *
+   * Out of training no noise is sampled, the output is a bunch_size x 1
+   * matrix with log P(w|h) of the target words, normalized over the whole
+   * vocabulary at O(V H) cost per sample, as the output of
+   * ann.components.class_softmax. Backprop needs a training forward.
+   *
+   * Weights are a Vx(H+1) matrix with the bias at the last column. Models
+   * trained with NCE are approximately self-normalized, so s(w,h) is an
+   * estimate of log P(w|h).
+   *
+   * @note Only rows of target and noise words receive non-zero gradients,
+   * however, optimizers update the whole weights matrix.
+   */
+  class NCEANNComponent : public VirtualMatrixANNComponent {
+    APRIL_DISALLOW_COPY_AND_ASSIGN(NCEANNComponent);
+
+    unsigned int vocab_size, num_samples;
+    AprilUtils::SharedPtr<Basics::MTRand> random;
+    /// Noise distribution as given by the user (unnormalized), it could be
+    /// empty for an uniform distribution.
+    AprilUtils::SharedPtr<Basics::MatrixFloat> noise;
+    /// Cumulative noise distribution, for sampling.
+    AprilUtils::vector<double> noise_cdf;
+    /// log(K q(w)) for every word.
+    AprilUtils::vector<float> log_noise;
+    AprilUtils::SharedPtr<Basics::MatrixFloat> weights_matrix;
+    /// Target words and noise samples at last doForward(), starting at 0.
+    /// Samples are empty after a forward out of training.
+    AprilUtils::vector<int> targets, samples;
+    /// The hidden layer with a column of ones, bunch_size x (H+1).
+    MatrixBuffer hidden_buffer;
+    /// Weights of noise samples, K x (H+1).
+    MatrixBuffer noise_weights_buffer;
+    /// Gradients of noise samples weights, K x (H+1).
+    MatrixBuffer noise_grads_buffer;
+    MatrixBuffer output_buffer, error_output_buffer;
+    /// Scores of all the vocabulary out of training, bunch_size x V.
+    MatrixBuffer scores_buffer;
+    /// Matrices of the buffers above used at last doForward(), they are owned
+    /// by the buffers.
+    Basics::MatrixFloat *hidden_mat, *noise_weights_mat;
+
+    void initNoiseDistribution();
+    unsigned int sampleNoiseWord();
+    /// Computes log P(w|h) of the target words using all the vocabulary.
+    Basics::MatrixFloat *computeLogProbabilities(int bunch_size);
+    void checkTrainingForward() const;
+
+  protected:
+    virtual unsigned int getTrainingOutputSize() const {
+      return num_samples + 1u;
+    }
+    virtual Basics::MatrixFloat *privateDoForward(Basics::MatrixFloat *input,
+                                                  bool during_training);
+    virtual Basics::MatrixFloat *privateDoBackprop(Basics::MatrixFloat *input_error);
+    virtual void privateReset(unsigned int it=0);
+    virtual void computeGradients(const char *name,
+                                  AprilUtils::LuaTable &weight_grads_dict);
+
+  public:
+    NCEANNComponent(unsigned int vocab_size, unsigned int num_samples,
+                    Basics::MTRand *random, Basics::MatrixFloat *noise=0,
+                    const char *name=0, const char *weights_name=0,
+                    unsigned int input_size=0,
+                    Basics::MatrixFloat *matrix=0);
+    virtual ~NCEANNComponent();
+    virtual ANNComponent *clone(AprilUtils::LuaTable &copies);
+    virtual void build(unsigned int input_size,
+                       unsigned int output_size,
+                       AprilUtils::LuaTable &weights_dict,
+                       AprilUtils::LuaTable &components_dict);
+    virtual void copyWeights(AprilUtils::LuaTable &weights_dict);
+
+    unsigned int getVocabSize() const { return vocab_size; }
+    unsigned int getNumSamples() const { return num_samples; }
+
+    /// The random object could be shared with other components.
+    virtual bool getIsThreadSafe() const { return false; }
+
+    virtual const char *luaCtorName() const;
+    virtual int exportParamsToLua(lua_State *L);
+  };
+
+} // namespace ANN
+
+#endif // NCEANNCOMPONENT_H
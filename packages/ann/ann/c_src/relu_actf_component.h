@@ -38,6 +38,9 @@ namespace ANN {
 				     Basics::MatrixFloat *output_units,
 				     Basics::MatrixFloat *input_errors,
 				     Basics::MatrixFloat *output_errors);
+    // The derivative is computed from input units, but it is the same when
+    // computed from activated values, so in-place execution is allowed.
+    virtual bool supportsInPlace() const { return true; }
   public:
     ReLUActfANNComponent(const char *name);
     virtual ~ReLUActfANNComponent();
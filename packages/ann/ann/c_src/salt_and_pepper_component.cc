@@ -45,6 +45,22 @@ namespace ANN {
     one(one),
     prob(prob) {
   }
+
+  SaltAndPepperANNComponent::SaltAndPepperANNComponent(PhiloxRand *random,
+						       float zero,
+						       float one,
+						       float prob,
+						       const char *name,
+						       unsigned int size) :
+    StochasticANNComponent(random, name, 0, size, size),
+    input(0),
+    output(0),
+    error_input(0),
+    error_output(0),
+    zero(zero),
+    one(one),
+    prob(prob) {
+  }
   
   SaltAndPepperANNComponent::~SaltAndPepperANNComponent() {
     if (input) DecRef(input);
@@ -68,10 +84,13 @@ namespace ANN {
     // new  output to fit the bunch
     AssignRef(output,new TokenMatrixFloat(input->getMatrix()->clone()));
     MatrixFloat *output_mat = output->getMatrix();
+    AprilUtils::SharedPtr<MatrixFloat> noise_mat( output_mat->cloneOnlyDims() );
+    fillRandomUniform(noise_mat.get());
+    MatrixFloat::const_iterator noise_it(noise_mat->begin());
     for (MatrixFloat::iterator it(output_mat->begin());
 	 it != output_mat->end();
-	 ++it) {
-      float p = random->rand();
+	 ++it, ++noise_it) {
+      float p = *noise_it;
       if (p < prob) {
 	if (p < prob * 0.5f) *it = zero;
 	else *it = one;
@@ -102,15 +121,19 @@ namespace ANN {
   }
 
   ANNComponent *SaltAndPepperANNComponent::clone(AprilUtils::LuaTable &copies) {
-    MTRand *rng_clone = copies[getRandom()].opt<MTRand*>(0);
-    if (rng_clone == 0) {
-      copies[getRandom()] = rng_clone = new MTRand(*getRandom());
+    SaltAndPepperANNComponent *copy_component;
+    if (philox != 0) {
+      copy_component = new SaltAndPepperANNComponent(clonePhilox(copies),
+                                                     zero, one, prob,
+                                                     name.c_str(),
+                                                     input_size);
+    }
+    else {
+      copy_component = new SaltAndPepperANNComponent(cloneRandom(copies),
+                                                     zero, one, prob,
+                                                     name.c_str(),
+                                                     input_size);
     }
-    SaltAndPepperANNComponent *copy_component = new
-      SaltAndPepperANNComponent(rng_clone,
-				zero, one, prob,
-				name.c_str(),
-				input_size);
     return copy_component;
   }
 
@@ -134,7 +157,7 @@ namespace ANN {
     AprilUtils::LuaTable t(L);
     t["name"]   = name.c_str();
     t["size"]   = input_size;
-    t["random"] = random;
+    exportRandomToLua(t);
     t["zero"]   = zero;
     t["one"]    = one;
     t["prob"]   = prob;
@@ -44,6 +44,10 @@ namespace ANN {
                               float one, float prob,
 			      const char *name=0,
 			      unsigned int size=0);
+    SaltAndPepperANNComponent(Basics::PhiloxRand *random, float zero,
+                              float one, float prob,
+			      const char *name=0,
+			      unsigned int size=0);
     virtual ~SaltAndPepperANNComponent();
     
     virtual Basics::Token *getInput() { return input; }
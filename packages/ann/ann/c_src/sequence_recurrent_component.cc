@@ -0,0 +1,350 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include <cstring>
+#include "connection.h"
+#include "matrix_ext.h"
+#include "sequence_recurrent_component.h"
+#include "unused_variable.h"
+
+using namespace AprilMath;
+using namespace AprilMath::MatrixExt::BLAS;
+using namespace AprilMath::MatrixExt::Initializers;
+using namespace AprilMath::MatrixExt::Reductions;
+using namespace AprilUtils;
+using namespace Basics;
+
+namespace ANN {
+
+  namespace {
+    AprilUtils::string concatName(const char *prefix, const char *suffix) {
+      const size_t prefix_len = strlen(prefix);
+      char *str = new char[prefix_len + strlen(suffix) + 1];
+      strcpy(str, prefix);
+      strcpy(str + prefix_len, suffix);
+      AprilUtils::string result(str);
+      delete[] str;
+      return result;
+    }
+    
+    /// Returns a time-major matrix with the given sizes, reusing the given
+    /// one when possible. Its content is undefined.
+    MatrixFloat *getSequenceMatrix(SharedPtr<MatrixFloat> &m,
+                                   int d0, int d1, int d2) {
+      int dims[3] = { d0, d1, d2 };
+      if (m.empty() || m->getDimSize(0) != d0 || m->getDimSize(1) != d1 ||
+          m->getDimSize(2) != d2) {
+        m = new MatrixFloat(3, dims);
+      }
+      return m.get();
+    }
+
+    /// Flattens @c n timesteps of a time-major matrix, starting at @c first,
+    /// into a (n*bunch_size x size) matrix.
+    SharedPtr<MatrixFloat> flattenSteps(MatrixFloat *m, int first, int n) {
+      int coords[3] = { first, 0, 0 };
+      int sizes[3]  = { n, m->getDimSize(1), m->getDimSize(2) };
+      SharedPtr<MatrixFloat> sub( new MatrixFloat(m, coords, sizes, false) );
+      int dims[2] = { n * m->getDimSize(1), m->getDimSize(2) };
+      return sub->rewrap(dims, 2);
+    }
+
+    SharedPtr<MatrixFloat> flattenSteps(MatrixFloat *m) {
+      return flattenSteps(m, 0, m->getDimSize(0));
+    }
+
+    /// Copies the given matrix swapping its first and second dimensions.
+    void copyTransposed(MatrixFloat *dest, MatrixFloat *source) {
+      SharedPtr<MatrixFloat> tr( source->transpose(0, 1) );
+      matCopy(dest, tr.get());
+    }
+  }
+  
+  SequenceRecurrentANNComponent::
+  SequenceRecurrentANNComponent(const char *name, const char *weights_name,
+                                const char *default_prefix,
+                                unsigned int input_units,
+                                unsigned int hidden_units,
+                                unsigned int num_gates,
+                                unsigned int bptt_truncation,
+                                MatrixFloat *w_mat,
+                                MatrixFloat *u_mat,
+                                MatrixFloat *b_mat) :
+    VirtualMatrixANNComponent(name, weights_name, 0, 0),
+    input_units(input_units), hidden_units(hidden_units),
+    num_gates(num_gates), bptt_truncation(bptt_truncation),
+    w_mat(w_mat), u_mat(u_mat), b_mat(b_mat) {
+    setInputContiguousProperty(true);
+    if (input_units == 0 || hidden_units == 0) {
+      ERROR_EXIT1(128, "Input and output sizes are mandatory [%s]\n",
+                  this->name.c_str());
+    }
+    if (weights_name == 0) generateDefaultWeightsName(default_prefix);
+    w_name = concatName(this->weights_name.c_str(), "::w");
+    u_name = concatName(this->weights_name.c_str(), "::u");
+    b_name = concatName(this->weights_name.c_str(), "::b");
+  }
+  
+  SequenceRecurrentANNComponent::~SequenceRecurrentANNComponent() {
+  }
+
+  MatrixFloat *SequenceRecurrentANNComponent::
+  privateDoForward(MatrixFloat *input_mat, bool during_training) {
+    UNUSED_VARIABLE(during_training);
+    if (w_mat.empty()) {
+      ERROR_EXIT1(129, "Not built component %s\n", name.c_str());
+    }
+    if (input_mat->getNumDim() != 3 ||
+        input_mat->getDimSize(2) != static_cast<int>(input_units)) {
+      ERROR_EXIT2(128, "Expected a bunch x T x %u input matrix [%s]\n",
+                  input_units, name.c_str());
+    }
+    const int bunch_size = input_mat->getDimSize(0);
+    const int seq_len    = input_mat->getDimSize(1);
+    const int H = static_cast<int>(hidden_units);
+    const int G = static_cast<int>(num_gates * hidden_units);
+    prepareSequence(seq_len, bunch_size);
+    MatrixFloat *x  = getSequenceMatrix(x_mat, seq_len, bunch_size, input_units);
+    MatrixFloat *gx = getSequenceMatrix(gx_mat, seq_len, bunch_size, G);
+    MatrixFloat *gh = getSequenceMatrix(gh_mat, seq_len, bunch_size, G);
+    MatrixFloat *h  = getSequenceMatrix(h_mat, seq_len, bunch_size, H);
+    copyTransposed(x, input_mat);
+    // input projection of all the timesteps in one GEMM
+    matGemm(flattenSteps(gx).get(), CblasNoTrans, CblasTrans,
+            1.0f, flattenSteps(x).get(), w_mat.get(), 0.0f);
+    for (int t=0; t<seq_len; ++t) {
+      SharedPtr<MatrixFloat> gh_t( gh->select(0, t) );
+      if (t == 0) {
+        matZeros(gh_t.get());
+      }
+      else {
+        SharedPtr<MatrixFloat> h_prev( h->select(0, t-1) );
+        matGemm(gh_t.get(), CblasNoTrans, CblasTrans,
+                1.0f, h_prev.get(), u_mat.get(), 0.0f);
+      }
+      float *h_ptr = getData(h);
+      forwardStep(t, bunch_size,
+                  getData(gx) + t*bunch_size*G,
+                  getData(gh) + t*bunch_size*G,
+                  getData(b_mat.get()),
+                  (t > 0) ? (h_ptr + (t-1)*bunch_size*H) : 0,
+                  h_ptr + t*bunch_size*H);
+    }
+    int dims[3] = { bunch_size, seq_len, H };
+    MatrixFloat *output_mat = output_buffer.get(3, dims);
+#ifdef USE_CUDA
+    output_mat->setUseCuda(use_cuda);
+#endif
+    copyTransposed(output_mat, h);
+    return output_mat;
+  }
+
+  MatrixFloat *SequenceRecurrentANNComponent::
+  privateDoBackprop(MatrixFloat *error_input_mat) {
+    const int bunch_size = error_input_mat->getDimSize(0);
+    const int seq_len    = error_input_mat->getDimSize(1);
+    const int H = static_cast<int>(hidden_units);
+    const int G = static_cast<int>(num_gates * hidden_units);
+    MatrixFloat *dh  = getSequenceMatrix(dh_mat, seq_len, bunch_size, H);
+    MatrixFloat *dgx = getSequenceMatrix(dgx_mat, seq_len, bunch_size, G);
+    MatrixFloat *dgh = getSequenceMatrix(dgh_mat, seq_len, bunch_size, G);
+    MatrixFloat *dx  = getSequenceMatrix(dx_mat, seq_len, bunch_size,
+                                         input_units);
+    int carry_dims[2] = { bunch_size, H };
+    if (dh_carry_mat.empty() || !dh_carry_mat->sameDim(carry_dims, 2)) {
+      dh_carry_mat = new MatrixFloat(2, carry_dims);
+    }
+    MatrixFloat *carry = dh_carry_mat.get();
+    copyTransposed(dh, error_input_mat);
+    matZeros(carry);
+    resetBackwardCarry(bunch_size);
+    for (int t=seq_len-1; t>=0; --t) {
+      SharedPtr<MatrixFloat> dh_t( dh->select(0, t) );
+      matAxpy(carry, 1.0f, dh_t.get());
+      float *h_ptr = getData(h_mat.get());
+      backwardStep(t, bunch_size,
+                   getData(gx_mat.get()) + t*bunch_size*G,
+                   getData(gh_mat.get()) + t*bunch_size*G,
+                   (t > 0) ? (h_ptr + (t-1)*bunch_size*H) : 0,
+                   h_ptr + t*bunch_size*H,
+                   getData(carry),
+                   getData(dgx) + t*bunch_size*G,
+                   getData(dgh) + t*bunch_size*G);
+      if (t > 0) {
+        if (bptt_truncation > 0 && (t % bptt_truncation) == 0) {
+          // truncation point, the error is not propagated to t-1
+          matZeros(carry);
+          resetBackwardCarry(bunch_size);
+        }
+        else {
+          SharedPtr<MatrixFloat> dgh_t( dgh->select(0, t) );
+          matGemm(carry, CblasNoTrans, CblasNoTrans,
+                  1.0f, dgh_t.get(), u_mat.get(), 1.0f);
+        }
+      }
+    }
+    // input error of all the timesteps in one GEMM
+    matGemm(flattenSteps(dx).get(), CblasNoTrans, CblasNoTrans,
+            1.0f, flattenSteps(dgx).get(), w_mat.get(), 0.0f);
+    int dims[3] = { bunch_size, seq_len, static_cast<int>(input_units) };
+    MatrixFloat *error_output_mat = error_output_buffer.get(3, dims);
+#ifdef USE_CUDA
+    error_output_mat->setUseCuda(use_cuda);
+#endif
+    copyTransposed(error_output_mat, dx);
+    return error_output_mat;
+  }
+
+  void SequenceRecurrentANNComponent::privateReset(unsigned int it) {
+    UNUSED_VARIABLE(it);
+    if (!w_mat.empty()) {
+      w_mat->resetSharedCount();
+      u_mat->resetSharedCount();
+      b_mat->resetSharedCount();
+    }
+  }
+
+  MatrixFloat *SequenceRecurrentANNComponent::
+  initializeGradients(const AprilUtils::string &wname, MatrixFloat *m,
+                      AprilUtils::LuaTable &weight_grads_dict) {
+    m->addToSharedCount();
+    MatrixFloat *grads_mat = weight_grads_dict.opt<MatrixFloat*>(wname, 0);
+    if (grads_mat == 0) {
+      grads_mat = m->cloneOnlyDims();
+      matZeros(grads_mat);
+      weight_grads_dict.put<MatrixFloat*>(wname, grads_mat);
+    }
+    else if (!grads_mat->sameDim(m)) {
+      ERROR_EXIT1(128, "Incorrect weights matrix dimensions [%s]\n",
+                  name.c_str());
+    }
+#ifdef USE_CUDA
+    grads_mat->setUseCuda(use_cuda);
+#endif
+    return grads_mat;
+  }
+  
+  void SequenceRecurrentANNComponent::
+  computeAllGradients(AprilUtils::LuaTable &weight_grads_dict) {
+    if (w_mat.empty()) {
+      ERROR_EXIT1(129, "Not built component %s\n", name.c_str());
+    }
+    MatrixFloat *gw = initializeGradients(w_name, w_mat.get(), weight_grads_dict);
+    MatrixFloat *gu = initializeGradients(u_name, u_mat.get(), weight_grads_dict);
+    MatrixFloat *gb = initializeGradients(b_name, b_mat.get(), weight_grads_dict);
+    if (getErrorInput() == 0) return;
+    const int seq_len = dgx_mat->getDimSize(0);
+    SharedPtr<MatrixFloat> flat_dgx( flattenSteps(dgx_mat.get()) );
+    matGemm(gw, CblasTrans, CblasNoTrans,
+            1.0f, flat_dgx.get(), flattenSteps(x_mat.get()).get(), 1.0f);
+    if (seq_len > 1) {
+      matGemm(gu, CblasTrans, CblasNoTrans,
+              1.0f, flattenSteps(dgh_mat.get(), 1, seq_len-1).get(),
+              flattenSteps(h_mat.get(), 0, seq_len-1).get(), 1.0f);
+    }
+    int dims[2] = { 1, gb->getDimSize(0) };
+    SharedPtr<MatrixFloat> gb_row( gb->rewrap(dims, 2) );
+    matSum(flat_dgx.get(), 0, gb_row.get(), true);
+  }
+
+  void SequenceRecurrentANNComponent::
+  buildWeightsMatrix(const AprilUtils::string &wname,
+                     SharedPtr<MatrixFloat> &m,
+                     unsigned int num_inputs, unsigned int num_outputs,
+                     AprilUtils::LuaTable &weights_dict) {
+    MatrixFloat *w = weights_dict.opt<MatrixFloat*>(wname, 0);
+    if (w != 0) {
+      m = w;
+      if (!Connections::checkInputOutputSizes(w, num_inputs, num_outputs)) {
+        ERROR_EXIT4(256, "The weights matrix %s input/output sizes are not "
+                    "correct, expected %u inputs and %u outputs. [%s]\n",
+                    wname.c_str(), num_inputs, num_outputs, name.c_str());
+      }
+    }
+    else {
+      if (m.empty()) {
+        m = Connections::build(num_inputs, num_outputs);
+      }
+      weights_dict.put(wname, m.get());
+    }
+  }
+  
+  void SequenceRecurrentANNComponent::build(unsigned int _input_size,
+                                            unsigned int _output_size,
+                                            AprilUtils::LuaTable &weights_dict,
+                                            AprilUtils::LuaTable &components_dict) {
+    ANNComponent::build(_input_size, _output_size,
+                        weights_dict, components_dict);
+    // input/output sizes are sequence length times input/hidden units, and
+    // they are zero when the sequence length is unknown
+    if ( (input_size % input_units) != 0 ||
+         (output_size % hidden_units) != 0 ||
+         (input_size != 0 && output_size != 0 &&
+          input_size/input_units != output_size/hidden_units) ) {
+      ERROR_EXIT1(128, "Incorrect input/output sizes [%s]\n", name.c_str());
+    }
+    if (output_size == 0) output_size = input_size/input_units*hidden_units;
+    if (input_size == 0) input_size = output_size/hidden_units*input_units;
+    const unsigned int G = num_gates * hidden_units;
+    buildWeightsMatrix(w_name, w_mat, input_units, G, weights_dict);
+    buildWeightsMatrix(u_name, u_mat, hidden_units, G, weights_dict);
+    buildWeightsMatrix(b_name, b_mat, 1, G, weights_dict);
+  }
+
+  void SequenceRecurrentANNComponent::
+  copyWeightsMatrix(const AprilUtils::string &wname, MatrixFloat *m,
+                    AprilUtils::LuaTable &weights_dict) {
+    MatrixFloat *w = weights_dict.opt<MatrixFloat*>(wname, 0);
+    if (w != 0 && w != m) {
+      ERROR_EXIT2(101, "Weights dictionary contains %s weights name which is "
+                  "not shared with this component [%s]\n",
+                  wname.c_str(), name.c_str());
+    }
+    else if (w == 0) {
+      weights_dict.put(wname, m);
+    }
+  }
+  
+  void SequenceRecurrentANNComponent::
+  copyWeights(AprilUtils::LuaTable &weights_dict) {
+    if (w_mat.empty()) {
+      ERROR_EXIT1(100, "Component not built, impossible execute copyWeights "
+                  "[%s]\n", name.c_str());
+    }
+    copyWeightsMatrix(w_name, w_mat.get(), weights_dict);
+    copyWeightsMatrix(u_name, u_mat.get(), weights_dict);
+    copyWeightsMatrix(b_name, b_mat.get(), weights_dict);
+  }
+
+  void SequenceRecurrentANNComponent::
+  exportCommonParams(AprilUtils::LuaTable &t) const {
+    t["name"]            = name;
+    t["weights"]         = weights_name;
+    t["input"]           = input_units;
+    t["output"]          = hidden_units;
+    t["bptt_truncation"] = bptt_truncation;
+    if (!w_mat.empty()) {
+      t["input_matrix"]     = w_mat.get();
+      t["recurrent_matrix"] = u_mat.get();
+      t["bias_matrix"]      = b_mat.get();
+    }
+  }
+  
+} // namespace ANN
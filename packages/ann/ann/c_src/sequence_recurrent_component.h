@@ -0,0 +1,186 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef SEQUENCERECURRENTCOMPONENT_H
+#define SEQUENCERECURRENTCOMPONENT_H
+
+#include "matrix_buffer.h"
+#include "matrix_component.h"
+#include "smart_ptr.h"
+#include "token_matrix.h"
+
+namespace ANN {
+
+  /**
+   * @brief Abstract component which runs a recurrent layer over a whole
+   * sequence in one doForward()/doBackprop() call.
+   *
+   * The input is a 3-dimensional matrix with sizes <tt>bunch x T x input</tt>
+   * and the output has sizes <tt>bunch x T x output</tt>, being @c T the
+   * sequence length, which can be different in every call. The recurrent
+   * state starts at zero at the beginning of every sequence.
+   *
+   * Internally the data is stored time-major, so the input projection of all
+   * the timesteps is computed by one GEMM before the recurrence, and the
+   * gradients of input and recurrent weights are computed by one GEMM each
+   * after the backward recurrence. The only per-step work is the recurrent
+   * GEMM and a fused pass over gate activations, which is implemented by
+   * derived classes in forwardStep() and backwardStep().
+   *
+   * The component has three weight matrices named after the given weights
+   * prefix: @c "prefix::w" with the input weights (gates*output x input),
+   * @c "prefix::u" with the recurrent weights (gates*output x output) and
+   * @c "prefix::b" with the biases (gates*output x 1). Every matrix stacks
+   * the gates by rows in the order defined by the derived class.
+   *
+   * Truncated BPTT is implemented internally: when @c bptt_truncation is
+   * greater than zero, the sequence is split in chunks of @c bptt_truncation
+   * steps and the error is not propagated through the recurrent connections
+   * between chunks. The forward state is always propagated.
+   *
+   * @note This component holds the whole sequence, so it is not intended to
+   * be used inside recurrent connections of ann.graph objects.
+   */
+  class SequenceRecurrentANNComponent : public VirtualMatrixANNComponent {
+    APRIL_DISALLOW_COPY_AND_ASSIGN(SequenceRecurrentANNComponent);
+
+    /// Output and error output buffers, they are bunch-major.
+    MatrixBuffer output_buffer, error_output_buffer;
+    /// Time-major matrices of forward: input, input projection (overwritten
+    /// by forwardStep()), recurrent projection and hidden states.
+    AprilUtils::SharedPtr<Basics::MatrixFloat> x_mat, gx_mat, gh_mat, h_mat;
+    /// Time-major matrices of backward: error input, deltas of input and
+    /// recurrent projections, error output.
+    AprilUtils::SharedPtr<Basics::MatrixFloat> dh_mat, dgx_mat, dgh_mat, dx_mat;
+    /// Error carried between timesteps (bunch_size x hidden_units).
+    AprilUtils::SharedPtr<Basics::MatrixFloat> dh_carry_mat;
+
+    void buildWeightsMatrix(const AprilUtils::string &wname,
+                            AprilUtils::SharedPtr<Basics::MatrixFloat> &m,
+                            unsigned int num_inputs, unsigned int num_outputs,
+                            AprilUtils::LuaTable &weights_dict);
+    void copyWeightsMatrix(const AprilUtils::string &wname,
+                           Basics::MatrixFloat *m,
+                           AprilUtils::LuaTable &weights_dict);
+    Basics::MatrixFloat *initializeGradients(const AprilUtils::string &wname,
+                                             Basics::MatrixFloat *m,
+                                             AprilUtils::LuaTable &weight_grads_dict);
+    
+  protected:
+    
+    unsigned int input_units, hidden_units, num_gates;
+    unsigned int bptt_truncation;
+    AprilUtils::string w_name, u_name, b_name;
+    AprilUtils::SharedPtr<Basics::MatrixFloat> w_mat, u_mat, b_mat;
+
+    /// Returns a pointer to the first element of the given contiguous matrix.
+    static float *getData(Basics::MatrixFloat *m) {
+      return m->getRawDataAccess()->getPPALForReadAndWrite() + m->getOffset();
+    }
+    
+    /**
+     * @brief Called at the beginning of every doForward(), derived classes
+     * allocate here their auxiliary per-step storage.
+     */
+    virtual void prepareSequence(int seq_len, int bunch_size) = 0;
+
+    /**
+     * @brief Fused forward computation of timestep @c t.
+     *
+     * @param t - The timestep.
+     * @param bunch_size - Number of sequences.
+     * @param gx - Input projection (bunch_size x num_gates*hidden_units)
+     * without bias, it is overwritten with whatever backwardStep() needs,
+     * usually the gate activations.
+     * @param gh - Recurrent projection (bunch_size x num_gates*hidden_units).
+     * @param bias - The bias vector (num_gates*hidden_units).
+     * @param h_prev - Hidden state at @c t-1, or NULL when @c t=0.
+     * @param h - Output hidden state (bunch_size x hidden_units).
+     */
+    virtual void forwardStep(int t, int bunch_size,
+                             float *gx, const float *gh, const float *bias,
+                             const float *h_prev, float *h) = 0;
+    
+    /**
+     * @brief Fused backward computation of timestep @c t, called in reverse
+     * order.
+     *
+     * @param t - The timestep.
+     * @param bunch_size - Number of sequences.
+     * @param gx - The values stored by forwardStep() at @c gx.
+     * @param gh - Recurrent projection computed at forward.
+     * @param h_prev - Hidden state at @c t-1, or NULL when @c t=0.
+     * @param h - Hidden state at @c t.
+     * @param dh - Input/output argument, at input it contains the error of
+     * the hidden state at @c t, at output it should contain the error which
+     * goes directly to the hidden state at @c t-1 (without taking into account
+     * the recurrent projection).
+     * @param dgx - Error of the input projection (pre-activation).
+     * @param dgh - Error of the recurrent projection.
+     */
+    virtual void backwardStep(int t, int bunch_size,
+                              const float *gx, const float *gh,
+                              const float *h_prev, const float *h,
+                              float *dh, float *dgx, float *dgh) = 0;
+
+    /// Resets any error carried by the derived class between timesteps,
+    /// it is called at the end of the sequence and at truncation points.
+    virtual void resetBackwardCarry(int bunch_size) = 0;
+    
+    virtual Basics::MatrixFloat *privateDoForward(Basics::MatrixFloat *input,
+                                                  bool during_training);
+    virtual Basics::MatrixFloat *privateDoBackprop(Basics::MatrixFloat *input_error);
+    virtual void privateReset(unsigned int it=0);
+
+    /// Exports the common parameters into the given table.
+    void exportCommonParams(AprilUtils::LuaTable &t) const;
+    
+  public:
+    /**
+     * @param weights_name - Prefix of the weight matrices names, if it is
+     * NULL a default one is generated using @c default_prefix.
+     */
+    SequenceRecurrentANNComponent(const char *name, const char *weights_name,
+                                  const char *default_prefix,
+                                  unsigned int input_units,
+                                  unsigned int hidden_units,
+                                  unsigned int num_gates,
+                                  unsigned int bptt_truncation,
+                                  Basics::MatrixFloat *w_mat=0,
+                                  Basics::MatrixFloat *u_mat=0,
+                                  Basics::MatrixFloat *b_mat=0);
+    virtual ~SequenceRecurrentANNComponent();
+
+    unsigned int getBPTTTruncation() const { return bptt_truncation; }
+    void setBPTTTruncation(unsigned int v) { bptt_truncation = v; }
+    unsigned int getInputUnits() const { return input_units; }
+    unsigned int getHiddenUnits() const { return hidden_units; }
+
+    virtual void computeAllGradients(AprilUtils::LuaTable &weight_grads_dict);
+    virtual void build(unsigned int input_size,
+                       unsigned int output_size,
+                       AprilUtils::LuaTable &weights_dict,
+                       AprilUtils::LuaTable &components_dict);
+    virtual void copyWeights(AprilUtils::LuaTable &weights_dict);
+  };
+  
+} // namespace ANN
+
+#endif // SEQUENCERECURRENTCOMPONENT_H
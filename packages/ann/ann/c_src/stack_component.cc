@@ -144,6 +144,7 @@ namespace ANN {
       ERROR_EXIT3(141, "StackANNComponent output size is not correct: "
 		  "%d != %d [%s]\n", output_size,
 		  components.back()->getOutputSize(), name.c_str());
+    planMemory();
     /*
       if (input_size  == 0 || output_size == 0)
       ERROR_PRINT3("# WARNING: Impossible to compute input/output "
@@ -152,6 +153,19 @@ namespace ANN {
     */
   }
   
+  void StackANNComponent::planMemory() {
+    // The output of every component is only consumed by the next one, so it
+    // can be overwritten when its producer doesn't need it anymore. Chains
+    // like dot_product+bias+logistic end sharing one matrix for the three
+    // outputs, and the first component never works in-place because its
+    // input belongs to the caller.
+    components[0]->setInPlace(false);
+    for (unsigned int c=1; c<components.size(); ++c) {
+      components[c]->setInPlace(getMemoryPlanning() &&
+                                components[c-1]->isOutputOverwritable());
+    }
+  }
+  
   void StackANNComponent::copyWeights(AprilUtils::LuaTable &weights_dict) {
     for (unsigned int c=0; c<components.size(); ++c)
       components[c]->copyWeights(weights_dict);
@@ -37,6 +37,9 @@ namespace ANN {
     /// Vector with the stack
     AprilUtils::vector<ANNComponent*> components;
 
+    /// Decides which components compute their output in-place.
+    void planMemory();
+
   public:
     StackANNComponent(const char *name=0, unsigned int input=0,
                       unsigned int output=0);
@@ -108,6 +111,17 @@ namespace ANN {
     
     virtual void setUseCuda(bool v);
     
+    virtual bool isOutputOverwritable() const {
+      return components.back()->isOutputOverwritable();
+    }
+
+    virtual bool getIsThreadSafe() const {
+      for (unsigned int i=0; i<components.size(); ++i) {
+        if (!components[i]->getIsThreadSafe()) return false;
+      }
+      return true;
+    }
+
     virtual void build(unsigned int input_size,
 		       unsigned int output_size,
 		       AprilUtils::LuaTable &weights_dict,
@@ -24,6 +24,8 @@
 #include "april_assert.h"
 #include "ann_component.h"
 #include "MersenneTwister.h"
+#include "matrixFloat.h"
+#include "philox.h"
 #include "vector.h"
 
 namespace ANN {
@@ -34,6 +36,10 @@ namespace ANN {
   /// this purpose, the reset method receives an iteration number. So, in the
   /// first iteration (number 0), the object stores the sequence of random
   /// objects. In the following iterations, this sequence is repeated.
+  ///
+  /// Instead of MTRand, a counter-based PhiloxRand object can be given. In this
+  /// case random matrices are filled in parallel, and the generated sequence
+  /// doesn't depend on the number of OMP threads.
   class StochasticANNComponent : public ANNComponent {
     APRIL_DISALLOW_COPY_AND_ASSIGN(StochasticANNComponent);
     
@@ -45,8 +51,57 @@ namespace ANN {
     StochasticState stochastic_state;
     unsigned int last_reset_it;
     uint32_t *random_frozen_state;
+    uint64_t philox_frozen_position;
   protected:
-    Basics::MTRand   *random;
+    /// Only one of both is not NULL
+    Basics::MTRand     *random;
+    Basics::PhiloxRand *philox;
+
+    /// Fills a contiguous matrix with uniform numbers in range [0,1]
+    void fillRandomUniform(Basics::MatrixFloat *m) {
+      april_assert(m->getIsContiguous());
+      float *ptr = m->getRawDataAccess()->getPPALForWrite() + m->getOffset();
+      if (philox != 0) philox->fillUniform(ptr, m->size(), 0.0, 1.0);
+      else {
+        for (int i=0; i<m->size(); ++i) ptr[i] = random->rand();
+      }
+    }
+
+    /// Fills a contiguous matrix with gaussian numbers (the second parameter
+    /// is used as standard deviation, as MTRand::randNorm does)
+    void fillRandomNormal(Basics::MatrixFloat *m, float mean, float variance) {
+      april_assert(m->getIsContiguous());
+      float *ptr = m->getRawDataAccess()->getPPALForWrite() + m->getOffset();
+      if (philox != 0) philox->fillNormal(ptr, m->size(), mean, variance);
+      else {
+        for (int i=0; i<m->size(); ++i) ptr[i] = random->randNorm(mean, variance);
+      }
+    }
+
+    /// Returns the MTRand copy stored at copies, allocating it if needed
+    Basics::MTRand *cloneRandom(AprilUtils::LuaTable &copies) {
+      Basics::MTRand *rng_clone = copies[random].opt<Basics::MTRand*>(0);
+      if (rng_clone == 0) {
+        copies[random] = rng_clone = new Basics::MTRand(*random);
+      }
+      return rng_clone;
+    }
+
+    /// Returns the PhiloxRand copy stored at copies, allocating it if needed
+    Basics::PhiloxRand *clonePhilox(AprilUtils::LuaTable &copies) {
+      Basics::PhiloxRand *rng_clone = copies[philox].opt<Basics::PhiloxRand*>(0);
+      if (rng_clone == 0) {
+        copies[philox] = rng_clone = new Basics::PhiloxRand(*philox);
+      }
+      return rng_clone;
+    }
+
+    /// Puts the random object in use at the given table
+    void exportRandomToLua(AprilUtils::LuaTable &t) {
+      if (philox != 0) t["random"] = philox;
+      else t["random"] = random;
+    }
+
   public:
     StochasticANNComponent(Basics::MTRand *random,
 			   const char *name=0,
@@ -56,13 +111,31 @@ namespace ANN {
       ANNComponent(name, weights, input_size, output_size),
       stochastic_state(NORMAL),
       last_reset_it(0),
-      random(random) {
+      philox_frozen_position(0),
+      random(random),
+      philox(0) {
       april_assert(random != 0 && "Needs a random object\n");
       IncRef(random);
       random_frozen_state = new uint32_t[Basics::MTRand::SAVE];
     }
+    StochasticANNComponent(Basics::PhiloxRand *philox,
+			   const char *name=0,
+			   const char *weights=0,
+			   unsigned int input_size=0,
+			   unsigned int output_size=0) :
+      ANNComponent(name, weights, input_size, output_size),
+      stochastic_state(NORMAL),
+      last_reset_it(0),
+      philox_frozen_position(0),
+      random(0),
+      philox(philox) {
+      april_assert(philox != 0 && "Needs a random object\n");
+      IncRef(philox);
+      random_frozen_state = new uint32_t[Basics::MTRand::SAVE];
+    }
     virtual ~StochasticANNComponent() {
-      DecRef(random);
+      if (random) DecRef(random);
+      if (philox) DecRef(philox);
       delete[] random_frozen_state;
     }
 
@@ -79,7 +152,8 @@ namespace ANN {
 	case FROZEN:
 	case NORMAL:
 	  stochastic_state = KEEP;
-	  random->save(random_frozen_state);
+	  if (philox) philox_frozen_position = philox->getPosition();
+	  else random->save(random_frozen_state);
 	  break;
 	default:
 	  ;
@@ -89,25 +163,47 @@ namespace ANN {
 	// iteration change, reinitialize the store sequence position pointer
 	// and goes to FROZEN state
 	stochastic_state = FROZEN;
-	random->load(random_frozen_state);
+	if (philox) philox->setPosition(philox_frozen_position);
+	else random->load(random_frozen_state);
       }
       last_reset_it = it;
     }
+
+    /// The random object could be shared with other components.
+    virtual bool getIsThreadSafe() const { return false; }
     
     /// Method to restore previously serialized random object
     virtual void setRandom(Basics::MTRand *random) {
-      DecRef(this->random);
+      IncRef(random);
+      if (this->random) DecRef(this->random);
+      if (this->philox) DecRef(this->philox);
       this->random = random;
-      IncRef(this->random);
+      this->philox = 0;
+      last_reset_it = 0;
+    }
+
+    /// Method to restore previously serialized PhiloxRand object
+    virtual void setPhilox(Basics::PhiloxRand *philox) {
+      IncRef(philox);
+      if (this->random) DecRef(this->random);
+      if (this->philox) DecRef(this->philox);
+      this->random = 0;
+      this->philox = philox;
       last_reset_it = 0;
     }
     
-    /// Method to serialize the underlying random object
+    /// Method to serialize the underlying random object, NULL when using
+    /// PhiloxRand
     virtual Basics::MTRand *getRandom() { return random; }
     
-    /// Method to serialize the underlying random object
+    /// Method to serialize the underlying random object, NULL when using
+    /// PhiloxRand
     virtual const Basics::MTRand *getRandom() const { return random; }
 
+    /// Method to serialize the underlying PhiloxRand object, NULL when using
+    /// MTRand
+    virtual Basics::PhiloxRand *getPhilox() { return philox; }
+
     /*
       virtual void copyState(AprilUtils::LuaTable &dict) {
       }
@@ -39,6 +39,7 @@ namespace ANN {
 				     Basics::MatrixFloat *output_units,
 				     Basics::MatrixFloat *input_errors,
 				     Basics::MatrixFloat *output_errors);
+    virtual bool supportsInPlace() const { return true; }
   public:
     TanhActfANNComponent(const char *name);
     virtual ~TanhActfANNComponent();
@@ -1286,6 +1286,114 @@ april_set_doc(ann.components.hyperplane,
 
 ----------------------------------------------------------------------
 
+april_set_doc(ann.components.lstm, {
+		class="class",
+		summary="A LSTM layer which processes whole sequences",
+		description = {
+		  "The input is a bunch x T x input matrix and the output a",
+		  "bunch x T x output matrix. The input projection of all the",
+		  "timesteps is computed by one matrix product, and gates are",
+		  "fused in one pass per timestep. The weights are stored in three",
+		  "matrices, prefix::w (input), prefix::u (recurrent) and",
+		  "prefix::b (bias), which stack the gates by rows in the order:",
+		  "input, forget, output and cell candidate.",
+		}, })
+
+----------------------------------------------------------------------
+
+april_set_doc(ann.components.lstm,
+	      {
+		class="method",
+		summary="Constructor of the component",
+		params={
+		  ["name"] = "A string with the given name [optional]",
+		  ["weights"] = "A string with the weights prefix [optional]",
+		  ["input"] = "Number of input units",
+		  ["output"] = "Number of output units",
+		  ["bptt_truncation"] = {
+		    "Length of the chunks used by truncated BPTT [optional].",
+		    "By default is 0, which means full BPTT", },
+		  ["input_matrix"] = "Input weights matrix [optional]",
+		  ["recurrent_matrix"] = "Recurrent weights matrix [optional]",
+		  ["bias_matrix"] = "Bias matrix [optional]",
+		},
+		outputs= { "An instance of ann.components.lstm" }
+	      })
+
+----------------------------------------------------------------------
+
+april_set_doc(ann.components.gru, {
+		class="class",
+		summary="A GRU layer which processes whole sequences",
+		description = {
+		  "The input is a bunch x T x input matrix and the output a",
+		  "bunch x T x output matrix. The input projection of all the",
+		  "timesteps is computed by one matrix product, and gates are",
+		  "fused in one pass per timestep. The weights are stored in three",
+		  "matrices, prefix::w (input), prefix::u (recurrent) and",
+		  "prefix::b (bias), which stack the gates by rows in the order:",
+		  "reset, update and candidate.",
+		}, })
+
+----------------------------------------------------------------------
+
+april_set_doc(ann.components.gru,
+	      {
+		class="method",
+		summary="Constructor of the component",
+		params={
+		  ["name"] = "A string with the given name [optional]",
+		  ["weights"] = "A string with the weights prefix [optional]",
+		  ["input"] = "Number of input units",
+		  ["output"] = "Number of output units",
+		  ["bptt_truncation"] = {
+		    "Length of the chunks used by truncated BPTT [optional].",
+		    "By default is 0, which means full BPTT", },
+		  ["input_matrix"] = "Input weights matrix [optional]",
+		  ["recurrent_matrix"] = "Recurrent weights matrix [optional]",
+		  ["bias_matrix"] = "Bias matrix [optional]",
+		},
+		outputs= { "An instance of ann.components.gru" }
+	      })
+
+----------------------------------------------------------------------
+
+april_set_doc(ann.components.ensemble, {
+		class="class",
+		summary="Averages the output of a component with several weight sets",
+		description = {
+		  "The given component is cloned into one member for every",
+		  "weights dictionary at samples field (for instance, samples",
+		  "of a Bayesian posterior). Members are forwarded in blocks,",
+		  "the members of a block in parallel threads, and the output is",
+		  "the average of their outputs. It is an inference component,",
+		  "backprop is forbidden.",
+		}, })
+
+----------------------------------------------------------------------
+
+april_set_doc(ann.components.ensemble,
+	      {
+		class="method",
+		summary="Constructor of the component",
+		params={
+		  ["name"] = "A string with the given name [optional]",
+		  ["component"] = "The component cloned into every member",
+		  ["samples"] = "A table with one weights dictionary per member",
+		  ["tolerance"] = {
+		    "Relative change of the average which stops the forward",
+		    "after any block but the first [optional]. By default is 0,",
+		    "which means all the members are always forwarded", },
+		  ["block"] = {
+		    "Number of members forwarded in parallel between",
+		    "convergence checks [optional]. By default is the number",
+		    "of OMP threads", },
+		},
+		outputs= { "An instance of ann.components.ensemble" }
+	      })
+
+----------------------------------------------------------------------
+
 april_set_doc(ann.components.stack, {
 		class="class",
 		summary="A container component for stack multiple components",
@@ -268,6 +268,107 @@ T("REWRAP + CONVOLUTION + LOGISTIC + MAXPOOLING TEST + FLATTEN TEST",
     end)
 end)
 
+T("CONVOLUTION ALGORITHMS TEST",
+  function()
+    check(function()
+        for _,alg in ipairs{ "gemm", "direct", "winograd" } do
+          for n=1,3 do
+            for b=1,3 do
+              check_component(function()
+                  return ann.components.stack():
+                    push( ann.components.rewrap{ size={2, 5, 8} } ):
+                    push( ann.components.convolution{ kernel={2, 3, 3}, n=n,
+                                                      algorithm=alg } ):
+                    push( ann.components.flatten() )
+                              end,
+                "mse", 80, n*3*6, b, "CONVOLUTION "..alg)
+            end
+          end
+        end
+        return true
+    end)
+    -- all the algorithms compute the same output
+    local rnd = random(1234)
+    local x = matrix(4, 3, 9, 10):uniformf(-1, 1, rnd)
+    local w = matrix(5, 3*3*3):uniformf(-1, 1, rnd)
+    local outputs = {}
+    for _,alg in ipairs{ "gemm", "direct", "winograd", "auto" } do
+      local c = ann.components.convolution{ kernel={3, 3, 3}, n=5,
+                                            weights="w", algorithm=alg }
+      c:build{ weights={ w=w } }
+      outputs[alg] = c:forward(x):clone()
+      if alg == "auto" then check.eq(c:get_algorithm(), "winograd") end
+    end
+    check.eq(outputs.direct, outputs.gemm)
+    check.eq(outputs.winograd, outputs.gemm)
+    check.errored(function()
+        return ann.components.convolution{ kernel={1, 5, 5}, n=2,
+                                           algorithm="winograd" }
+    end)
+    -- gemm is the default, auto is opt-in
+    local c = ann.components.convolution{ kernel={3, 3, 3}, n=5, weights="w" }
+    c:build{ weights={ w=w } }
+    check.eq(c:get_algorithm(), "gemm")
+    -- benchmark mode keeps the measured algorithm
+    ann.components.convolution.set_benchmark_mode(true)
+    local c = ann.components.convolution{ kernel={3, 3, 3}, n=5, weights="w",
+                                          algorithm="auto" }
+    c:build{ weights={ w=w } }
+    check.eq(c:forward(x), outputs.gemm)
+    ann.components.convolution.set_benchmark_mode(false)
+    check.TRUE(c:get_algorithm() ~= "auto")
+end)
+
+---------------
+-- LSTM, GRU --
+---------------
+
+for _,rnn in ipairs{ "lstm", "gru" } do
+  T("REWRAP + %s + FLATTEN TEST"%{ rnn:upper() },
+    function()
+      check(function()
+          for t=1,3 do
+            for h=2,3 do
+              for b=1,3 do
+                check_component(function()
+                    return ann.components.stack():
+                      push( ann.components.rewrap{ size={t, 4} } ):
+                      push( ann.components[rnn]{ input=4, output=h } ):
+                      push( ann.components.flatten() )
+                                end,
+                  "mse", t*4, t*h, b, rnn:upper().." "..t)
+              end
+            end
+          end
+          return true
+      end)
+  end)
+end
+
+T("LSTM BPTT TRUNCATION TEST",
+  function()
+    local x = matrix(3, 5, 4):uniformf(-1, 1, rnd)
+    local e = matrix(3, 5, 2):uniformf(-1, 1, rnd)
+    local function run(bptt_truncation, w)
+      local c = ann.components.lstm{ input=4, output=2, weights="lstm",
+                                     bptt_truncation=bptt_truncation }
+      local _,w = c:build{ weights=w }
+      return c:forward(x, true):clone(), c:backprop(e):clone(), w
+    end
+    local _,_,w = run(0)
+    for _,m in pairs(w) do m:uniformf(-0.5, 0.5, rnd) end
+    local out, dx = run(0, w)
+    -- a truncation longer than the sequence is equivalent to full BPTT
+    local out5, dx5 = run(5, w)
+    check.eq(out5, out)
+    check.eq(dx5, dx)
+    -- truncation changes backprop but not forward, last step is the same
+    local out1, dx1 = run(1, w)
+    check.eq(out1, out)
+    check.TRUE(not dx1:equals(dx))
+    check.eq(dx1:select(2, 5), dx:select(2, 5))
+end)
+
 -------------------------------
 -- COPY + JOIN + DOT PRODUCT --
 -------------------------------
@@ -908,3 +1009,250 @@ T("PROBMAT TEST 3",
     )
 end
 )
+
+---------------------------------
+-- CLASS SOFTMAX, NCE (TARGETS) --
+---------------------------------
+
+-- finite differences check of output components which receive the target
+-- word at the last input column, so check_component can't be used; reseed is
+-- called before every forward, to repeat the same noise samples
+local function check_target_component(c, H, V, b, loss, desc, reseed)
+  local reseed  = reseed or function() end
+  local epsilon = 1e-03
+  ann.components.reset_id_counters()
+  local _,weights = c:build()
+  for _,w in pairs(weights) do w:uniformf(-1,1,rnd) end
+  local x = matrix(b, H+1):uniformf(-1,1,rnd)
+  for i=1,b do x:set(i, H+1, rnd:randInt(1,V)) end
+  local t = matrix(b, 1):uniformf(0.5,1.5,rnd)
+  local function compute_loss()
+    reseed() c:reset()
+    return (loss:compute_loss(c:forward(x, true), t))
+  end
+  reseed() c:reset()
+  local y  = c:forward(x, true)
+  local dx = c:backprop(loss:gradient(y, t)):clone()
+  local grads = iterator(pairs(c:compute_gradients())):
+  map(function(k,v) return k,v:clone() end):table()
+  local errors = {}
+  local function check_fd(m, ann_g, i, what)
+    local orig = m:raw_get(m:offset() + i-1)
+    m:raw_set(m:offset() + i-1, orig - epsilon)
+    local loss_a = compute_loss()
+    m:raw_set(m:offset() + i-1, orig + epsilon)
+    local loss_b = compute_loss()
+    m:raw_set(m:offset() + i-1, orig)
+    local g = (loss_b - loss_a) / (2*epsilon)
+    if math.abs(ann_g - g) > 1e-02 * math.max(1.0, math.abs(g)) then
+      errors[#errors+1] = "%s[%d], found %g, expected %g"%{ what, i, ann_g, g }
+    end
+  end
+  -- loss is averaged over the bunch, gradients are added
+  for name,w in pairs(weights) do
+    for i=1,w:size() do check_fd(w, grads[name]:raw_get(i-1)/b, i, name) end
+  end
+  for i=1,b do
+    for j=1,H do check_fd(x, dx:get(i,j)/b, (i-1)*(H+1) + j, "input") end
+  end
+  check.eq(#errors, 0, function()
+             return "%s (%d,%d): %s"%{ desc, V, b, table.concat(errors, ", ") }
+  end)
+  check.eq(dx(':',H+1):sum(), 0.0)
+end
+
+T("CLASS SOFTMAX GRADIENTS TEST",
+  function()
+    for _,V in ipairs{ 7, 9 } do
+      for b=1,3 do
+        local c = ann.components.class_softmax{ input=5, vocab=V, classes=3 }
+        check_target_component(c, 4, V, b, ann.loss.neg_log_likelihood(1),
+                               "CLASS_SOFTMAX")
+      end
+    end
+end)
+
+T("NCE GRADIENTS TEST",
+  function()
+    local noise = matrix(10):linspace()
+    for _,K in ipairs{ 1, 3 } do
+      for b=1,3 do
+        local r = random(4321)
+        local c = ann.components.nce{ input=5, vocab=10, samples=K,
+                                      noise=noise, random=r }
+        check_target_component(c, 4, 10, b, ann.loss.nce(K+1), "NCE",
+                               function() r:seed(4321) end)
+      end
+    end
+end)
+
+-- DATA PARALLEL
+
+T("DATA PARALLEL + DOTPRODUCT + BIAS + LOGISTIC TEST",
+  function()
+    check(function()
+        for r=1,3 do
+          for b=1,5 do
+            check_component(function()
+                local s = ann.components.stack():
+                  push( ann.components.dot_product{ input=3, output=4 } ):
+                  push( ann.components.bias{ size=4 } ):
+                  push( ann.components.actf.logistic() )
+                return ann.components.data_parallel{ component=s,
+                                                     replicas=r }
+                            end,
+              "mse", 3, 4, b, "DATA PARALLEL")
+          end
+        end
+        return true
+    end)
+    -- outputs and gradients equal to the wrapped component
+    local function build(replicas)
+      ann.components.reset_id_counters()
+      local s = ann.components.stack():
+        push( ann.components.hyperplane{ input=5, output=3 } ):
+        push( ann.components.actf.softmax() )
+      if replicas then
+        s = ann.components.data_parallel{ component=s, replicas=replicas }
+      end
+      local trainer = trainable.supervised_trainer(s,
+                                                   ann.loss.multi_class_cross_entropy(),
+                                                   7)
+      trainer:build()
+      trainer:randomize_weights{ inf=-1, sup=1, random=random(1234) }
+      return trainer
+    end
+    local input  = matrix(7, 5):uniformf(-1, 1, random(4321))
+    local target = matrix(7, 3):zeros()
+    for i=1,7 do target:set(i, (i%3)+1, 1) end
+    local t1 = build()
+    local t2 = build(3)
+    check.eq(t2:get_component():get_num_replicas(), 3)
+    local g1,l1 = t1:compute_gradients_step(input, target)
+    local g2,l2 = t2:compute_gradients_step(input, target)
+    check.number_eq(l1, l2)
+    check.eq(t1:get_component():get_output(), t2:get_component():get_output())
+    for name,g in pairs(g1) do check.eq(g, g2[name]) end
+    -- with one active replica the output of the wrapped component is not
+    -- overwritten by a following in-place activation
+    local function build_actf(replicas)
+      ann.components.reset_id_counters()
+      local s = ann.components.stack():
+        push( ann.components.hyperplane{ input=5, output=3 } ):
+        push( ann.components.actf.logistic() )
+      if replicas then
+        s = ann.components.data_parallel{ component=s, replicas=replicas }
+      end
+      s = ann.components.stack():push(s):push( ann.components.actf.logistic() )
+      local trainer = trainable.supervised_trainer(s, ann.loss.mse(), 1)
+      trainer:build()
+      trainer:randomize_weights{ inf=-1, sup=1, random=random(1234) }
+      return trainer
+    end
+    local input1  = input[{ {1,1}, ':' }]:clone()
+    local target1 = matrix(1, 3):uniformf(0, 1, random(5678))
+    local g1,l1 = build_actf():compute_gradients_step(input1, target1)
+    for _,replicas in ipairs{ 1, 2 } do
+      local g2,l2 = build_actf(replicas):compute_gradients_step(input1, target1)
+      check.number_eq(l1, l2)
+      for name,g in pairs(g1) do check.eq(g, g2[name]) end
+    end
+    -- stochastic components are not thread safe, only the wrapped component
+    -- is used, so the output is the same as without replicas
+    local d = ann.components.data_parallel{
+      component=ann.components.dropout{ prob=0.5, random=random(1234) },
+      replicas=2,
+    }
+    d:build{ input=200, output=200 }
+    local dropout = ann.components.dropout{ prob=0.5, random=random(1234) }
+    dropout:build{ input=200, output=200 }
+    local out = d:forward(matrix(2, 200):ones(), true)
+    check.eq(out, dropout:forward(matrix(2, 200):ones(), true))
+    check.FALSE(out:select(1,1):equals(out:select(1,2)))
+    -- only the weights of the wrapped component are shared by the replicas,
+    -- so the gradients of the following layers are not altered
+    local function build_net(replicas)
+      ann.components.reset_id_counters()
+      local h1 = ann.components.hyperplane{ input=5, output=4,
+                                            dot_product_weights="w1",
+                                            bias_weights="b1" }
+      if replicas then
+        h1 = ann.components.data_parallel{ component=h1, replicas=replicas }
+      end
+      local net = ann.components.stack():push(h1):
+        push( ann.components.hyperplane{ input=4, output=3,
+                                         dot_product_weights="w2",
+                                         bias_weights="b2" } )
+      local trainer = trainable.supervised_trainer(net, ann.loss.mse(), 4)
+      trainer:build()
+      trainer:randomize_weights{ inf=-1, sup=1, random=random(1234) }
+      return trainer
+    end
+    local input4  = matrix(4, 5):uniformf(-1, 1, random(7))
+    local target4 = matrix(4, 3):zeros()
+    local g1,l1 = build_net():compute_gradients_step(input4, target4)
+    local g2,l2 = build_net(2):compute_gradients_step(input4, target4)
+    check.number_eq(l1, l2)
+    for _,name in ipairs{ "w1", "b1", "w2", "b2" } do
+      check.eq(g1[name], g2[name])
+    end
+    -- replicas errors are raised after the parallel region
+    local dp = ann.components.data_parallel{
+      component=ann.components.hyperplane{ input=5, output=4 },
+      replicas=2,
+    }
+    dp:build()
+    check.errored(function() dp:forward(matrix(4, 6):zeros()) end)
+    check.eq(dp:forward(matrix(4, 5):zeros()):dim(1), 4)
+end)
+
+-- ENSEMBLE
+
+T("ENSEMBLE TEST",
+  function()
+    local function build_net()
+      ann.components.reset_id_counters()
+      return ann.components.stack():
+        push( ann.components.hyperplane{ input=5, output=4 } ):
+        push( ann.components.actf.logistic() ):
+        push( ann.components.hyperplane{ input=4, output=3 } )
+    end
+    local input = matrix(7, 5):uniformf(-1, 1, random(4321))
+    local samples = {}
+    local expected = matrix(7, 3):zeros()
+    for i=1,5 do
+      local trainer = trainable.supervised_trainer(build_net())
+      trainer:build()
+      trainer:randomize_weights{ inf=-1, sup=1, random=random(i) }
+      samples[i] = trainer:get_weights_table()
+      expected:axpy(1/5, trainer:calculate(input))
+    end
+    -- the output doesn't depend on the block size
+    for block=1,5 do
+      local e = ann.components.ensemble{ component=build_net(),
+                                         samples=samples,
+                                         block=block }
+      e:build()
+      check.eq(e:get_num_members(), 5)
+      check.eq(e:get_input_size(), 5)
+      check.eq(e:get_output_size(), 3)
+      check.eq(e:forward(input), expected)
+      check.eq(e:get_num_used(), 5)
+      -- errors of the members are raised after the parallel region
+      check.errored(function() e:forward(matrix(7, 6):zeros()) end)
+      check.eq(e:forward(input), expected)
+      -- early exit after the second block at least
+      e:set_tolerance(1e6)
+      e:forward(input)
+      check.eq(e:get_num_used(), math.min(2*block, 5))
+      check.errored(function() e:backprop(matrix(7, 3):zeros()) end)
+    end
+    -- serialization keeps the samples
+    local e = ann.components.ensemble{ component=build_net(),
+                                       samples=samples, block=2 }
+    e:build()
+    local e2 = util.deserialize(util.serialize(e))
+    e2:build()
+    check.eq(e2:get_num_members(), 5)
+    check.eq(e2:forward(input), expected)
+end)
@@ -11,3 +11,214 @@ T("AllAllGenerate", function()
     local net = generate("10 inputs 4 sparse_logistic{sparsity=0.1,penalty=3} 3 softmax")
     check.TRUE(net)
 end)
+
+T("MemoryPlanningTest", function()
+    local function train(planning)
+      ann.set_memory_planning(planning)
+      local rnd  = random(4231)
+      local net  = ann.mlp.all_all.generate("10 inputs 8 logistic 6 tanh 4 relu 3 softmax")
+      local trainer = trainable.supervised_trainer(net,
+                                                   ann.loss.mse(), 16,
+                                                   ann.optimizer.sgd())
+      trainer:build()
+      trainer:randomize_weights{ random=random(1234), inf=-0.1, sup=0.1 }
+      local input  = matrix(16,10):uniformf(-1,1,rnd)
+      local target = matrix(16,3):uniformf(0,1,rnd)
+      local losses = {}
+      for i=1,4 do losses[i] = trainer:train_step(input, target) end
+      return trainer, losses, trainer:calculate(input)
+    end
+    local planning = ann.get_memory_planning()
+    local t1, l1, o1 = train(false)
+    local t2, l2, o2 = train(true)
+    ann.set_memory_planning(planning)
+    for i=1,#l1 do check.number_eq(l1[i], l2[i]) end
+    check.eq(o1, o2)
+    for _,c in t1:iterate_components() do check.FALSE(c:get_in_place()) end
+    local in_place = {}
+    for name,c in t2:iterate_components() do
+      in_place[c:get_name()] = c:get_in_place()
+    end
+    -- hidden activations and biases work in-place, softmax doesn't
+    check.TRUE(in_place["actf1"])
+    check.TRUE(in_place["actf2"])
+    check.TRUE(in_place["actf3"])
+    check.FALSE(in_place["actf4"])
+    check.TRUE(in_place["b1"])
+end)
+
+T("InterOpParallelismTest", function()
+    -- it is opt-in
+    check.FALSE(ann.get_inter_op_parallelism())
+    local function train(parallelism)
+      ann.set_inter_op_parallelism(parallelism)
+      ann.components.reset_id_counters()
+      local rnd  = random(2846)
+      local join = ann.components.join()
+      for i=1,4 do
+        join:add( ann.components.stack():
+                    push( ann.components.hyperplane{ input=6, output=5 } ):
+                    push( ann.components.actf.tanh() ) )
+      end
+      local net = ann.components.stack():
+        push( join ):
+        push( ann.components.hyperplane{ input=20, output=3 } ):
+        push( ann.components.actf.softmax() )
+      local trainer = trainable.supervised_trainer(net,
+                                                   ann.loss.mse(), 16,
+                                                   ann.optimizer.sgd())
+      trainer:build()
+      trainer:randomize_weights{ random=random(1234), inf=-0.1, sup=0.1 }
+      local input  = matrix(16,24):uniformf(-1,1,rnd)
+      local target = matrix(16,3):uniformf(0,1,rnd)
+      local losses = {}
+      for i=1,4 do losses[i] = trainer:train_step(input, target) end
+      return losses, trainer:calculate(input)
+    end
+    local parallelism = ann.get_inter_op_parallelism()
+    local l1, o1 = train(false)
+    local l2, o2 = train(true)
+    ann.set_inter_op_parallelism(parallelism)
+    for i=1,#l1 do check.number_eq(l1[i], l2[i]) end
+    check.eq(o1, o2)
+end)
+
+T("SoftmaxKernelsTest", function()
+    local rnd = random(5382)
+    -- wide rows span several blocks of the online max/sum computation
+    local x = matrix(5,2500):uniformf(-30,30,rnd)
+    x(3,'2000:2500'):scalar_add(40)
+    local e = matrix(5,2500):uniformf(-0.5,0.5,rnd)
+    local expected = x:clone()
+    for i=1,x:dim(1) do
+      local row = expected(i,':')
+      row:scalar_add(-row:max()):exp():scal(1/row:sum())
+    end
+    local function compute(actf)
+      local c = actf()
+      c:build{ input=2500, output=2500 }
+      local y = c:forward(x):clone()
+      return y, c:backprop(e):clone()
+    end
+    local best = mathcore.get_simd_level()
+    local results = {}
+    for _,level in ipairs{ "none", best } do
+      mathcore.set_simd_level(level)
+      local y,dy = compute(ann.components.actf.softmax)
+      local ly = compute(ann.components.actf.log_softmax)
+      results[#results+1] = { y, dy, ly }
+    end
+    mathcore.set_simd_level(best)
+    local y, dy, ly = table.unpack(results[1])
+    check.eq(y, expected)
+    check.eq(ly:clone():exp(), expected)
+    for i=1,x:dim(1) do check.number_eq(y(i,':'):sum(), 1.0) end
+    -- derivative is (e - dot(y,e)) * y
+    local dot = y:clone():cmul(e):sum(2)
+    local dy_expected = e:clone()
+    for i=1,x:dim(1) do dy_expected(i,':'):scalar_add(-dot:get(i,1)) end
+    check.eq(dy, dy_expected:cmul(y))
+    for i=1,3 do check.eq(results[2][i], results[1][i]) end
+end)
+
+T("ClassSoftmaxTest", function()
+    local rnd = random(8234)
+    local H,V,C = 6,10,3
+    local c = ann.components.class_softmax{ input=H+1, vocab=V, classes=C }
+    local _,weights = c:build()
+    for _,w in pairs(weights) do w:uniformf(-0.5,0.5,rnd) end
+    check.eq(c:get_word_class(1), 1)
+    check.eq(c:get_word_class(V), C)
+    -- the same hidden state with every word as target, the output is a
+    -- log-probability distribution over the vocabulary
+    local h = matrix(1,H):uniformf(-1,1,rnd)
+    local x = matrix(V,H+1)
+    for w=1,V do
+      x(w,'1:'..H):copy(h)
+      x:set(w,H+1,w)
+    end
+    local y = c:forward(x)
+    check.eq(y:dim(1), V)
+    check.eq(y:dim(2), 1)
+    check.number_eq(y:clone():exp():sum(), 1.0)
+    -- gradient w.r.t. target indices is always zero
+    local dx = c:backprop(matrix(V,1):fill(1.0))
+    check.eq(dx:dim(1), V)
+    check.eq(dx:dim(2), H+1)
+    check.number_eq(dx(':',H+1):sum(), 0.0)
+    local loss = ann.loss.neg_log_likelihood(1)
+    local l = loss:compute_loss(y, matrix(V,1):fill(1.0))
+    check.number_eq(l, -y:sum()/V)
+    check.errored(function() c:forward(matrix(1,H+1):fill(V+1)) end)
+end)
+
+T("NCETest", function()
+    local rnd = random(2943)
+    local H,V,K,B = 5,20,4,8
+    local c = ann.components.nce{ input=H+1, vocab=V, samples=K,
+                                  weights="w", random=random(1234) }
+    local _,weights = c:build()
+    for _,w in pairs(weights) do w:uniformf(-0.5,0.5,rnd) end
+    local x = matrix(B,H+1):uniformf(-1,1,rnd)
+    for b=1,B do x:set(b,H+1,b) end
+    local y = c:forward(x, true)
+    check.eq(y:dim(1), B)
+    check.eq(y:dim(2), K+1)
+    local loss = ann.loss.nce(K+1)
+    local t = matrix(B,1):fill(1.0)
+    local l = loss:compute_loss(y, t)
+    check.TRUE(l > 0.0)
+    local g = loss:gradient(y, t)
+    check.eq(g:dim(1), B)
+    check.eq(g:dim(2), K+1)
+    -- target scores are pushed up and noise scores pushed down
+    check.TRUE(g(':',1):max() < 0.0)
+    check.TRUE(g(':','2:'):min() > 0.0)
+    local dx = c:backprop(g)
+    check.eq(dx:dim(1), B)
+    check.eq(dx:dim(2), H+1)
+    check.number_eq(dx(':',H+1):sum(), 0.0)
+    -- out of training no noise is sampled and the output is log P(w|h)
+    -- normalized over all the vocabulary
+    local r = random(5678)
+    local c = ann.components.nce{ input=H+1, vocab=V, samples=K,
+                                  weights="w", random=r }
+    c:build{ weights=weights }
+    local y = c:forward(x)
+    check.eq(y:dim(1), B)
+    check.eq(y:dim(2), 1)
+    check.eq(r:rand(), random(5678):rand())
+    local h = x:clone()
+    h(':',H+1):fill(1.0)
+    local scores = h * weights.w:t()
+    for b=1,B do
+      local row = scores(b,':')
+      local lse = row:max() + math.log(row:clone():scalar_add(-row:max()):exp():sum())
+      check.number_eq(y:get(b,1), scores:get(b,b) - lse, 1e-4)
+    end
+    check.errored(function() c:backprop(matrix(B,1):fill(1.0)) end)
+end)
+
+T("SoftmaxUnderflowTest", function()
+    -- exp(-200) underflows to zero, exp(-95) is a denormal number
+    local x = matrix(2,64):fill(-200)
+    x:set(1,1,0)
+    x:set(2,64,0)
+    x(1,'17:32'):fill(-95)
+    local best = mathcore.get_simd_level()
+    for _,level in ipairs{ "none", best } do
+      mathcore.set_simd_level(level)
+      local c = ann.components.actf.softmax()
+      c:build{ input=64, output=64 }
+      local y = c:forward(x)
+      check.eq(y:get(1,1), 1.0)
+      check.eq(y:get(2,64), 1.0)
+      for j=33,64 do check.eq(y:get(1,j), 0.0) end
+      for j=1,63 do check.eq(y:get(2,j), 0.0) end
+      for j=17,32 do
+        check.gt(y:get(1,j), 0.0)
+        check.number_eq(y:get(1,j), math.exp(-95), 1e-03)
+      end
+    end
+    mathcore.set_simd_level(best)
+end)
@@ -202,6 +202,65 @@ local function ann_graph_topsort(self)
   end
 end
 
+-- Compiles the given ANN graph into an ann.components.graph_engine instance,
+-- flattening nested ann.graph objects (their input and output nodes become
+-- identity operations). Returns nil when the graph contains Lua components
+-- which are not supported by the engine.
+local function compile_native_engine(self)
+  local engine = ann.components.graph_engine{ name = self.name,
+                                              backstep = self.backstep }
+  local ids = {}
+  local op_names = {
+    [ann.graph.bind] = "bind", [ann.graph.add] = "add",
+    [ann.graph.cmul] = "cmul", [ann.graph.index] = "index",
+  }
+  local function add_nodes(g)
+    for _,obj in ipairs(g.order) do
+      if class.is_a(obj, ann.graph) then
+        ids[obj.input_name] = engine:add_operation{ op="identity",
+                                                    name=obj.input_name }
+        if not add_nodes(obj) then return false end
+        ids[obj.output_name] = engine:add_operation{ op="identity",
+                                                     name=obj.output_name }
+      elseif class.is_a(obj, ann.components.lua) then
+        local op = op_names[class.of(obj)]
+        if not op then return false end
+        ids[obj] = engine:add_operation{ op     = op,
+                                         name   = obj:get_name(),
+                                         input  = obj:get_input_size(),
+                                         output = obj:get_output_size(),
+                                         index  = rawget(obj,"n") }
+      else
+        ids[obj] = engine:add_component(obj)
+      end
+    end
+    return true
+  end
+  local function add_edges(g, is_top)
+    local function src_id(obj)
+      if obj == g.input_name then return is_top and "input" or ids[obj] end
+      if class.is_a(obj, ann.graph) then return ids[obj.output_name] end
+      return ids[obj]
+    end
+    local function dst_id(obj)
+      if obj == g.output_name then return is_top and "output" or ids[obj] end
+      if class.is_a(obj, ann.graph) then return ids[obj.input_name] end
+      return ids[obj]
+    end
+    local dsts = iterator(g.order):table()
+    dsts[#dsts+1] = g.output_name
+    for _,dst in ipairs(dsts) do
+      for _,src,delay in node_all_in_edges_it(g.nodes[dst]) do
+        engine:connect(src_id(src), dst_id(dst), delay)
+      end
+      if class.is_a(dst, ann.graph) then add_edges(dst, false) end
+    end
+  end
+  if not add_nodes(self) then return nil end
+  add_edges(self, true)
+  return engine
+end
+
 ------------------------------------------------------------------------------
 
 ann = ann or {}
@@ -213,6 +272,13 @@ april_set_doc(ann.graph, {
                 class = "class",
                 summary = "An ANN component based in graphs of other components", })
 
+-- When true, build method compiles the graph into a native engine
+-- (ann.components.graph_engine) which executes forward, backprop and BPTT
+-- without Lua code. Graphs with Lua components different of ann.graph,
+-- ann.graph.bind, ann.graph.add, ann.graph.cmul and ann.graph.index are always
+-- executed by Lua code.
+ann.graph.use_native_engine = true
+
 ann.graph.constructor =
   april_doc{
     class = "method",
@@ -444,6 +510,8 @@ ann_graph_methods.dot_graph = april_doc{
   end
 
 ann_graph_methods.build = function(self, tbl, bptt_data)
+  -- bptt_data is given by parent graphs
+  local is_a_child = (bptt_data ~= nil)
   assert(self.backstep >= self.max_delay,
          "Impossible to build the network with the given BPTT truncation parameter")
   local tbl = tbl or {}
@@ -528,6 +596,17 @@ ann_graph_methods.build = function(self, tbl, bptt_data)
                                 { weights = weights,
                                   input = input_sizes[nodes[input_name].out_edges[1]],
                                   output = sum_sizes(nodes[output_name].in_edges, output_sizes) })
+  -- the engine is used only by the top graph, nested graphs are flattened
+  self.engine = nil
+  if not is_a_child and ann.graph.use_native_engine then
+    local engine = compile_native_engine(self)
+    if engine then
+      engine:build{ input = self:get_input_size(),
+                    output = self:get_output_size(),
+                    weights = weights }
+      self.engine = engine
+    end
+  end
   return self,weights,components
 end
 
@@ -542,6 +621,12 @@ ann_graph_methods.forward = function(self, input, during_training,
                                      parent_results)
   self.gradients_computed = false
   forward_asserts(self)
+  local engine = rawget(self,"engine")
+  if engine and not parent_results then
+    local output = engine:forward(input, during_training)
+    forward_finish(self, input, output)
+    return output
+  end
   local bunch_size = get_bunch_size(input)
   ------------------
   -- BPTT section --
@@ -733,6 +818,15 @@ end
 -- component error outputs, and storing the error output of every component at
 -- the table error_outputs_table
 ann_graph_methods.backprop = function(self, input, time, is_a_child)
+  local engine = rawget(self,"engine")
+  if engine and not is_a_child then
+    april_assert(not time or time == engine:get_bptt_step(), "%s %s",
+                 "Backprop for a given time different of last time step",
+                 "is not available with the native engine")
+    local output = engine:backprop(input) or null_token
+    backprop_finish(self, input, output)
+    return output
+  end
   local bptt_data   = self.bptt_data
   local bptt_step   = self.bptt_step
   local time        = time or bptt_step
@@ -759,6 +853,8 @@ end
 -- steps). This method is needed to obtain error deltas at inputs of the graph,
 -- and to use this deltas to train other ANNs.
 ann_graph_methods.bptt_backprop = function(self, is_a_child)
+  local engine = rawget(self,"engine")
+  if engine and not is_a_child then return engine:bptt_backprop() end
   local bptt_data  = self.bptt_data
   local bptt_step  = self.bptt_step
   local input_name = self.input_name
@@ -775,6 +871,10 @@ end
 
 -- Computes the gradients, forcing to execute backprop in case it is needed.
 ann_graph_methods.compute_gradients = function(self, weight_grads, is_a_child)
+  local engine = rawget(self,"engine")
+  if engine and not is_a_child then
+    return engine:compute_gradients(weight_grads or {})
+  end
   if not rawget(self,"gradients_computed") then
     -- ann_graph_backprop implements gradient computation
     ann_graph_backprop(self, nil, is_a_child)
@@ -786,6 +886,12 @@ ann_graph_methods.compute_gradients = function(self, weight_grads, is_a_child)
 end
 
 ann_graph_methods.get_bptt_state = function(self, time)
+  local engine = rawget(self,"engine")
+  if engine then
+    if time then return engine:get_bptt_state(time) end
+    return iterator.range(engine:get_bptt_step()):
+    map(function(k) return k,engine:get_bptt_state(k) end):table()
+  end
   if not time then return self.bptt_data end
   assert(self.bptt_data[time], "Unable to retrieve the state at the given time")
   return self.bptt_data[time]
@@ -819,6 +925,8 @@ ann_graph_methods.reset = function(self, n, bptt_data)
   self.bptt_data = bptt_data or {}
   self.bptt_step = 0
   self.grads     = {}
+  local engine = rawget(self,"engine")
+  if engine then engine:reset(n) end
   local bptt_data = self.bptt_data
   for _,obj in ipairs(self.order) do
     if class.is_a(obj, ann.graph) then
@@ -890,6 +998,8 @@ ann_graph_methods.set_use_cuda = function(self, v)
       v:set_use_cuda(v)
     end
   end
+  local engine = rawget(self,"engine")
+  if engine then engine:set_use_cuda(v) end
   (ann.components.lua.."set_use_cuda")(self, v)
 end
 
@@ -928,6 +1038,8 @@ ann_graph_methods.set_bptt_truncation = function(self, backstep)
       obj:set_bptt_truncation(backstep)
     end
   end
+  local engine = rawget(self,"engine")
+  if engine then engine:set_bptt_truncation(backstep) end
 end
 
 ---------------------------------------------------------------------------
@@ -248,3 +248,78 @@ T("StackTest",
     check.eq(out:dim(2), 10)
     check.eq(out:dim(1), 10)
 end)
+
+T("NativeEngineTest",
+  function()
+    local top  = ann.graph("top")
+    local lstm = ann.graph.blocks.lstm{ input=4, output=3, name="lstm" }
+    local out  = ann.components.hyperplane{ input=3, output=2, name="out",
+                                            bias_weights="out::b",
+                                            dot_product_weights="out::w" }
+    top:connect('input', lstm, out, 'output')
+    local rnd = random(1234)
+    local _,weights = top:build{ input=4 }
+    local order = iterator(table.keys(weights)):table() table.sort(order)
+    iterator(order):apply(function(name) weights[name]:uniformf(-0.1,0.1,rnd) end)
+    local inputs = iterator.range(5):
+    map(function() return matrix(2,4):uniformf(-1,1,rnd) end):table()
+    local errors = iterator.range(5):
+    map(function() return matrix(2,2):uniformf(-1,1,rnd) end):table()
+    -- runs a sequence with the native engine or with Lua code, the native
+    -- engine can execute the independent nodes of the LSTM concurrently
+    local function run(use_native_engine, parallelism)
+      ann.graph.use_native_engine = use_native_engine
+      ann.set_inter_op_parallelism(parallelism)
+      top:build{ input=4 }
+      check.eq(rawget(top,"engine") ~= nil, use_native_engine)
+      top:reset()
+      local outputs = {}
+      for i=1,#inputs do
+        outputs[i] = top:forward(inputs[i], true):clone()
+        top:backprop(errors[i])
+      end
+      local deltas = iterator(ipairs(top:bptt_backprop())):
+      map(function(k,v) return k,v:clone() end):table()
+      local grads = iterator(pairs(top:compute_gradients())):
+      map(function(k,v) return k,v:clone() end):table()
+      return outputs, deltas, grads
+    end
+    local parallelism = ann.get_inter_op_parallelism()
+    local o1,d1,g1 = run(true, false)
+    for _,args in ipairs{ {false, false}, {true, true} } do
+      local o2,d2,g2 = run(table.unpack(args))
+      check.eq(#o1, #o2)
+      check.eq(#d1, #d2)
+      for i=1,#o1 do check.eq(o1[i], o2[i]) end
+      for i=1,#d1 do check.eq(d1[i], d2[i]) end
+      for _,name in ipairs(order) do check.eq(g1[name], g2[name]) end
+    end
+    ann.graph.use_native_engine = true
+    ann.set_inter_op_parallelism(parallelism)
+end)
+
+T("ParallelBranchErrorTest",
+  function()
+    local net = ann.graph("net")
+    local h1  = ann.components.hyperplane{ input=5, output=3, name="h1",
+                                           bias_weights="h1::b",
+                                           dot_product_weights="h1::w" }
+    local h2  = ann.components.hyperplane{ input=5, output=3, name="h2",
+                                           bias_weights="h2::b",
+                                           dot_product_weights="h2::w" }
+    net:connect('input', h1)
+    net:connect('input', h2)
+    net:connect({h1,h2}, 'output')
+    local use_native_engine = ann.graph.use_native_engine
+    local parallelism = ann.get_inter_op_parallelism()
+    ann.graph.use_native_engine = true
+    ann.set_inter_op_parallelism(true)
+    net:build{ input=5 }
+    check.TRUE(rawget(net,"engine") ~= nil)
+    -- the errors of the branches are raised after the parallel region
+    check.errored(function() net:forward(matrix(2,6):zeros()) end)
+    net:reset()
+    check.eq(net:forward(matrix(2,5):zeros()):dim(2), 6)
+    ann.graph.use_native_engine = use_native_engine
+    ann.set_inter_op_parallelism(parallelism)
+end)
@@ -35,6 +35,8 @@ using namespace Basics;
 #include "mae_loss_function.h"
 #include "cross_entropy_loss_function.h"
 #include "multiclass_cross_entropy_loss_function.h"
+#include "nce_loss_function.h"
+#include "neg_log_likelihood_loss_function.h"
 #include "batch_fmeasure_micro_avg_loss_function.h"
 #include "batch_fmeasure_macro_avg_loss_function.h"
 #include "zero_one_loss_function.h"
@@ -274,6 +276,54 @@ using namespace ANN;
 }
 //BIND_END
 
+/////////////////////////////////////////////////////
+//              NEGATIVE LOG-LIKELIHOOD            //
+/////////////////////////////////////////////////////
+
+//BIND_LUACLASSNAME NegLogLikelihoodLossFunction ann.loss.neg_log_likelihood
+//BIND_CPP_CLASS    NegLogLikelihoodLossFunction
+//BIND_SUBCLASS_OF  NegLogLikelihoodLossFunction LossFunction
+
+//BIND_CONSTRUCTOR NegLogLikelihoodLossFunction
+{
+  unsigned int size;
+  LUABIND_GET_OPTIONAL_PARAMETER(1, uint, size, 0);
+  obj=new NegLogLikelihoodLossFunction(size);
+  LUABIND_RETURN(NegLogLikelihoodLossFunction, obj);
+}
+//BIND_END
+
+//BIND_METHOD NegLogLikelihoodLossFunction clone
+{
+  LUABIND_RETURN(NegLogLikelihoodLossFunction,
+		 dynamic_cast<NegLogLikelihoodLossFunction*>(obj->clone()));
+}
+//BIND_END
+
+/////////////////////////////////////////////////////
+//           NOISE-CONTRASTIVE ESTIMATION          //
+/////////////////////////////////////////////////////
+
+//BIND_LUACLASSNAME NCELossFunction ann.loss.nce
+//BIND_CPP_CLASS    NCELossFunction
+//BIND_SUBCLASS_OF  NCELossFunction LossFunction
+
+//BIND_CONSTRUCTOR NCELossFunction
+{
+  unsigned int size;
+  LUABIND_GET_OPTIONAL_PARAMETER(1, uint, size, 0);
+  obj=new NCELossFunction(size);
+  LUABIND_RETURN(NCELossFunction, obj);
+}
+//BIND_END
+
+//BIND_METHOD NCELossFunction clone
+{
+  LUABIND_RETURN(NCELossFunction,
+		 dynamic_cast<NCELossFunction*>(obj->clone()));
+}
+//BIND_END
+
 /////////////////////////////////////////////////////
 //                BATCH FMEASURE                   //
 /////////////////////////////////////////////////////
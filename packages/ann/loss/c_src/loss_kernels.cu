@@ -25,6 +25,7 @@
 #include "reduce_matrix.h"
 #include "smart_ptr.h"
 
+using namespace AprilMath::MatrixExt::BLAS;
 using namespace AprilMath::MatrixExt::Initializers;
 using namespace AprilMath::MatrixExt::Operations;
 using namespace AprilMath::MatrixExt::Reductions;
@@ -184,6 +185,15 @@ namespace AprilMath {
         };
         
         /////////////////////////////////////////////////////////////////////////
+
+        struct NegLogLikelihood {
+          APRIL_CUDA_EXPORT float operator()(const float &input,
+                                             const float &target) const {
+            return -target * input;
+          }
+        };
+        
+        /////////////////////////////////////////////////////////////////////////
         
       } // namespace Kernels
 
@@ -261,6 +271,53 @@ namespace AprilMath {
                                       input->cloneOnlyDims()));
         matSum(map_output.get(), 1, output);
       }
+
+      void matMultiClassCrossEntropyGradient(Basics::MatrixFloat *output,
+                                             const Basics::MatrixFloat *input,
+                                             const Basics::MatrixFloat *target,
+                                             float near_zero) {
+        // same gradient as cross entropy with log-scaled inputs
+        Kernels::CrossEntropyGradient cross_entropy_gradient(near_zero);
+        MatrixScalarMap2(input, target, cross_entropy_gradient, output);
+      }
+
+      void matNegLogLikelihood(Basics::MatrixFloat *output,
+                               const Basics::MatrixFloat *input,
+                               const Basics::MatrixFloat *target) {
+        AprilUtils::SharedPtr<Basics::MatrixFloat>
+          map_output(MatrixScalarMap2(input, target, Kernels::NegLogLikelihood(),
+                                      input->cloneOnlyDims()));
+        matSum(map_output.get(), 1, output);
+      }
+
+      void matNCE(Basics::MatrixFloat *output,
+                  const Basics::MatrixFloat *input,
+                  const Basics::MatrixFloat *target) {
+        // softplus(x) for noise samples and softplus(-x) = softplus(x) - x
+        // for data samples
+        AprilUtils::SharedPtr<Basics::MatrixFloat>
+          map_output(MatrixScalarMap1(input, Functors::m_softplus<float>(),
+                                      input->cloneOnlyDims()));
+        matSum(map_output.get(), 1, output);
+        AprilUtils::SharedPtr<Basics::MatrixFloat> data_col(input->select(1, 0));
+        matAxpy(output, -1.0f, data_col.get());
+        AprilUtils::SharedPtr<Basics::MatrixFloat> weights(target->select(1, 0));
+        matCmul(output, weights.get());
+      }
+
+      void matNCEGradient(Basics::MatrixFloat *output,
+                          const Basics::MatrixFloat *input,
+                          const Basics::MatrixFloat *target) {
+        // sigmoid(x) - label
+        MatrixScalarMap1(input, Functors::m_logistic<float>(), output);
+        AprilUtils::SharedPtr<Basics::MatrixFloat> col(output->select(1, 0));
+        matScalarAdd(col.get(), -1.0f);
+        AprilUtils::SharedPtr<Basics::MatrixFloat> weights(target->select(1, 0));
+        for (int j=0; j<output->getDimSize(1); ++j) {
+          col = output->select(1, j, col.get());
+          matCmul(col.get(), weights.get());
+        }
+      }
       
       /////////////////////////////////////////////////////////////////////////
       /////////////////////////////////////////////////////////////////////////
@@ -65,6 +65,28 @@ namespace AprilMath {
                                      const Basics::MatrixFloat *input,
                                      const Basics::MatrixFloat *target,
                                      float near_zero);
+
+      /// Fused exp(clamp(log_softmax)) - target in one pass, the probability
+      /// matrix is never materialized.
+      void matMultiClassCrossEntropyGradient(Basics::MatrixFloat *output,
+                                             const Basics::MatrixFloat *input,
+                                             const Basics::MatrixFloat *target,
+                                             float near_zero);
+
+      void matNegLogLikelihood(Basics::MatrixFloat *output,
+                               const Basics::MatrixFloat *input,
+                               const Basics::MatrixFloat *target);
+
+      /// Binary logistic loss over NCE scores, first column for data samples
+      /// and the rest for noise samples, weighted by the target column.
+      void matNCE(Basics::MatrixFloat *output,
+                  const Basics::MatrixFloat *input,
+                  const Basics::MatrixFloat *target);
+
+      void matNCEGradient(Basics::MatrixFloat *output,
+                          const Basics::MatrixFloat *input,
+                          const Basics::MatrixFloat *target);
+
       
     }
   }
@@ -61,12 +61,11 @@ namespace ANN {
   Token *MultiClassCrossEntropyLossFunction::computeGradient(Token *input, Token *target) {
     MatrixFloat *input_mat, *target_mat;
     throwErrorAndGetMatrixFromTokens(input, target, input_mat, target_mat);
-    MatrixFloat *error_mat = input_mat->clone();
+    MatrixFloat *error_mat = input_mat->cloneOnlyDims();
     TokenMatrixFloat *error_mat_token = new TokenMatrixFloat(error_mat);
     AssignRef<Token>(error_output, error_mat_token);
-    matClamp(error_mat, m_log(NEAR_ZERO), m_log(1.0f - NEAR_ZERO));
-    matExp(error_mat);
-    matAxpy(error_mat, -1.0f, target_mat);
+    matMultiClassCrossEntropyGradient(error_mat, input_mat, target_mat,
+                                      NEAR_ZERO);
     return error_output;
   }
 
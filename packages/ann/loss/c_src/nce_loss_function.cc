@@ -0,0 +1,78 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include "nce_loss_function.h"
+#include "loss_kernels.h"
+#include "token_matrix.h"
+
+using namespace AprilMath::MatrixExt::LossOperations;
+using namespace AprilUtils;
+using namespace Basics;
+
+namespace ANN {
+
+  namespace {
+    void checkTargetMatrix(const MatrixFloat *input_mat,
+                           const MatrixFloat *target_mat) {
+      if (target_mat->getNumDim() != 2 || target_mat->getDimSize(1) != 1 ||
+          target_mat->getDimSize(0) != input_mat->getDimSize(0)) {
+        ERROR_EXIT1(128, "Needs a %dx1 target matrix with sample weights\n",
+                    input_mat->getDimSize(0));
+      }
+      if (input_mat->getDimSize(1) < 2) {
+        ERROR_EXIT(128, "Needs at least one data and one noise sample\n");
+      }
+    }
+  }
+
+  NCELossFunction::NCELossFunction(unsigned int size) :
+    LossFunction(size) {
+  }
+
+  NCELossFunction::~NCELossFunction() {
+  }
+
+  MatrixFloat *NCELossFunction::computeLossBunch(Token *input, Token *target) {
+    MatrixFloat *input_mat, *target_mat;
+    throwErrorAndGetMatrixFromTokens(input, target, input_mat, target_mat,
+                                     false);
+    checkTargetMatrix(input_mat, target_mat);
+    int dim = input_mat->getDimSize(0);
+    MatrixFloat *loss_output = new MatrixFloat(1, &dim);
+#ifdef USE_CUDA
+    loss_output->setUseCuda(input_mat->getCudaFlag());
+#endif
+    matNCE(loss_output, input_mat, target_mat);
+    return loss_output;
+  }
+
+  Token *NCELossFunction::computeGradient(Token *input, Token *target) {
+    MatrixFloat *input_mat, *target_mat;
+    throwErrorAndGetMatrixFromTokens(input, target, input_mat, target_mat,
+                                     false);
+    checkTargetMatrix(input_mat, target_mat);
+    MatrixFloat *error_mat = input_mat->cloneOnlyDims();
+    TokenMatrixFloat *error_mat_token = new TokenMatrixFloat(error_mat);
+    AssignRef<Token>(error_output, error_mat_token);
+    matNCEGradient(error_mat, input_mat, target_mat);
+    return error_output;
+  }
+
+}
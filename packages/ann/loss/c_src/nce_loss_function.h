@@ -0,0 +1,54 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef NCELOSSFUNCTION_H
+#define NCELOSSFUNCTION_H
+
+#include "referenced.h"
+#include "token_base.h"
+#include "loss_function.h"
+
+namespace ANN {
+  /**
+   * Noise-contrastive estimation loss over the output of ann.components.nce:
+   * binary logistic loss of first column (data sample) against the rest of
+   * columns (noise samples). Targets are a bunch_size x 1 matrix with the
+   * weight of every sample, usually ones.
+   */
+  class NCELossFunction : public LossFunction {
+    NCELossFunction(NCELossFunction *other) : LossFunction(other) { }
+  protected:
+    virtual Basics::MatrixFloat *computeLossBunch(Basics::Token *input,
+                                                  Basics::Token *target);
+  public:
+    NCELossFunction(unsigned int size);
+    virtual ~NCELossFunction();
+    virtual Basics::Token *computeGradient(Basics::Token *input,
+                                           Basics::Token *target);
+    virtual LossFunction *clone() {
+      return new NCELossFunction(this);
+    }
+    virtual const char *luaCtorName() const {
+      return "ann.loss.nce";
+    }
+  };
+}
+
+#endif // NCELOSSFUNCTION_H
@@ -0,0 +1,53 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef NEGLOGLIKELIHOODLOSSFUNCTION_H
+#define NEGLOGLIKELIHOODLOSSFUNCTION_H
+
+#include "referenced.h"
+#include "token_base.h"
+#include "loss_function.h"
+
+namespace ANN {
+  /**
+   * Negative log-likelihood of log-scaled inputs, as the output of
+   * ann.components.class_softmax. Targets are weights of every input, usually
+   * ones.
+   */
+  class NegLogLikelihoodLossFunction : public LossFunction {
+    NegLogLikelihoodLossFunction(NegLogLikelihoodLossFunction *other) : LossFunction(other) { }
+  protected:
+    virtual Basics::MatrixFloat *computeLossBunch(Basics::Token *input,
+                                                  Basics::Token *target);
+  public:
+    NegLogLikelihoodLossFunction(unsigned int size);
+    virtual ~NegLogLikelihoodLossFunction();
+    virtual Basics::Token *computeGradient(Basics::Token *input,
+                                           Basics::Token *target);
+    virtual LossFunction *clone() {
+      return new NegLogLikelihoodLossFunction(this);
+    }
+    virtual const char *luaCtorName() const {
+      return "ann.loss.neg_log_likelihood";
+    }
+  };
+}
+
+#endif // NEGLOGLIKELIHOODLOSSFUNCTION_H
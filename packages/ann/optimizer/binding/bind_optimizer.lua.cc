@@ -20,9 +20,51 @@
  */
 //BIND_HEADER_C
 #include "bind_matrix.h"
+
+namespace {
+  /// Reads a Lua array of matrices, false values are taken as NULL when
+  /// optional is true.
+  void getMatrixList(lua_State *L, int n, UtilFused::MatrixList &list,
+                     bool optional=false) {
+    if (!lua_istable(L, n)) {
+      LUABIND_FERROR1("Expected a table of matrices at argument %d", n);
+    }
+    int len = luaL_len(L, n);
+    list.resize(len);
+    for (int i=1; i<=len; ++i) {
+      lua_rawgeti(L, n, i);
+      if (optional && lua_isboolean(L, -1) && !lua_toboolean(L, -1)) {
+        list[i-1] = 0;
+      }
+      else if (lua_isMatrixFloat(L, -1)) {
+        list[i-1] = lua_toMatrixFloat(L, -1);
+      }
+      else {
+        LUABIND_FERROR2("Expected a matrix at position %d of argument %d",
+                        i, n);
+      }
+      lua_pop(L, 1);
+    }
+  }
+
+  /// Reads a Lua array of numbers.
+  void getFloatList(lua_State *L, int n, UtilFused::FloatList &list) {
+    if (!lua_istable(L, n)) {
+      LUABIND_FERROR1("Expected a table of numbers at argument %d", n);
+    }
+    int len = luaL_len(L, n);
+    list.resize(len);
+    for (int i=1; i<=len; ++i) {
+      lua_rawgeti(L, n, i);
+      list[i-1] = static_cast<float>(luaL_checknumber(L, -1));
+      lua_pop(L, 1);
+    }
+  }
+}
 //BIND_END
 
 //BIND_HEADER_H
+#include "util_fused.h"
 #include "util_rprop.h"
 #include "util_regularization.h"
 using namespace ANN::Optimizer;
@@ -74,3 +116,97 @@ using namespace ANN::Optimizer;
   UtilRegularization::L1NormMap(w, value);
 }
 //BIND_END
+
+//////////////////////////////////////////////////////////////////////////////
+
+//BIND_LUACLASSNAME UtilFused ann.optimizer.utils.fused
+//BIND_CPP_CLASS    UtilFused
+
+//BIND_CONSTRUCTOR UtilFused
+{
+  LUABIND_ERROR("Static class, not instantiable");
+}
+//BIND_END
+
+//BIND_CLASS_METHOD UtilFused sgd
+{
+  LUABIND_CHECK_ARGN(==,6);
+  UtilFused::MatrixList w, grads, updates;
+  UtilFused::FloatList lr, mt, l2;
+  getMatrixList(L, 1, w);
+  getMatrixList(L, 2, grads);
+  getMatrixList(L, 3, updates);
+  getFloatList(L, 4, lr);
+  getFloatList(L, 5, mt);
+  getFloatList(L, 6, l2);
+  UtilFused::sgdStep(w, grads, updates, lr, mt, l2);
+}
+//BIND_END
+
+//BIND_CLASS_METHOD UtilFused adagrad
+{
+  LUABIND_CHECK_ARGN(==,7);
+  UtilFused::MatrixList w, grads, Egradients;
+  UtilFused::FloatList lr, decay, eps, l2;
+  getMatrixList(L, 1, w);
+  getMatrixList(L, 2, grads);
+  getMatrixList(L, 3, Egradients);
+  getFloatList(L, 4, lr);
+  getFloatList(L, 5, decay);
+  getFloatList(L, 6, eps);
+  getFloatList(L, 7, l2);
+  UtilFused::adagradStep(w, grads, Egradients, lr, decay, eps, l2);
+}
+//BIND_END
+
+//BIND_CLASS_METHOD UtilFused rmsprop
+{
+  LUABIND_CHECK_ARGN(==,9);
+  UtilFused::MatrixList w, grads, Erms, Eupdates;
+  UtilFused::FloatList lr, mt, decay, eps, l2;
+  getMatrixList(L, 1, w);
+  getMatrixList(L, 2, grads);
+  getMatrixList(L, 3, Erms);
+  getMatrixList(L, 4, Eupdates, true);
+  getFloatList(L, 5, lr);
+  getFloatList(L, 6, mt);
+  getFloatList(L, 7, decay);
+  getFloatList(L, 8, eps);
+  getFloatList(L, 9, l2);
+  UtilFused::rmspropStep(w, grads, Erms, Eupdates, lr, mt, decay, eps, l2);
+}
+//BIND_END
+
+//BIND_CLASS_METHOD UtilFused adadelta
+{
+  LUABIND_CHECK_ARGN(==,9);
+  UtilFused::MatrixList w, grads, Egradients, Eupdates, updates;
+  UtilFused::FloatList lr, decay, eps, l2;
+  getMatrixList(L, 1, w);
+  getMatrixList(L, 2, grads);
+  getMatrixList(L, 3, Egradients);
+  getMatrixList(L, 4, Eupdates);
+  getMatrixList(L, 5, updates);
+  getFloatList(L, 6, lr);
+  getFloatList(L, 7, decay);
+  getFloatList(L, 8, eps);
+  getFloatList(L, 9, l2);
+  UtilFused::adadeltaStep(w, grads, Egradients, Eupdates, updates,
+                          lr, decay, eps, l2);
+}
+//BIND_END
+
+//BIND_CLASS_METHOD UtilFused asgd
+{
+  LUABIND_CHECK_ARGN(==,6);
+  UtilFused::MatrixList w, grads, aw;
+  UtilFused::FloatList lr, mu, l2;
+  getMatrixList(L, 1, w);
+  getMatrixList(L, 2, grads);
+  getMatrixList(L, 3, aw);
+  getFloatList(L, 4, lr);
+  getFloatList(L, 5, mu);
+  getFloatList(L, 6, l2);
+  UtilFused::asgdStep(w, grads, aw, lr, mu, l2);
+}
+//BIND_END
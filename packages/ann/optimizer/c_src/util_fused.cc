@@ -0,0 +1,304 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include "cmath_overloads.h"
+#include "error_print.h"
+#include "util_fused.h"
+
+using AprilMath::m_sqrt;
+using AprilUtils::vector;
+using Basics::MatrixFloat;
+
+namespace ANN {
+  namespace Optimizer {
+
+    namespace {
+      /// Number of elements processed by every iteration of the OMP loop.
+      const int CHUNK_SIZE = 16384;
+
+      /// A piece of one of the matrices in the list.
+      struct Chunk {
+        int idx, begin, end;
+      };
+
+      /// Splits all the given matrices in chunks of CHUNK_SIZE elements.
+      void computeChunks(const UtilFused::MatrixList &w,
+                         vector<Chunk> &chunks) {
+        chunks.clear();
+        for (unsigned int i=0; i<w.size(); ++i) {
+          for (int b=0; b<w[i]->size(); b+=CHUNK_SIZE) {
+            Chunk c = { static_cast<int>(i), b,
+                        AprilUtils::min(b+CHUNK_SIZE, w[i]->size()) };
+            chunks.push_back(c);
+          }
+        }
+      }
+
+      /**
+       * Returns the raw memory pointers of the given matrices, which are
+       * checked to be contiguous and with the same size as the weights. NULL
+       * matrices are only allowed when the list is optional.
+       */
+      void getPointers(const UtilFused::MatrixList &w,
+                       const UtilFused::MatrixList &m,
+                       vector<float*> &ptrs,
+                       bool optional=false) {
+        if (m.size() != w.size()) {
+          ERROR_EXIT2(128, "Incorrect list size, found %u, expected %u\n",
+                      static_cast<unsigned int>(m.size()),
+                      static_cast<unsigned int>(w.size()));
+        }
+        ptrs.resize(m.size());
+        for (unsigned int i=0; i<m.size(); ++i) {
+          if (m[i] == 0) {
+            if (!optional) ERROR_EXIT1(128, "Found NULL matrix at %u\n", i+1);
+            ptrs[i] = 0;
+            continue;
+          }
+          if (!m[i]->getIsContiguous()) {
+            ERROR_EXIT1(128, "Fused kernels need contiguous matrices, "
+                        "found a non-contiguous one at %u\n", i+1);
+          }
+          if (m[i]->size() != w[i]->size()) {
+            ERROR_EXIT3(128, "Incorrect matrix size at %u, found %d, "
+                        "expected %d\n", i+1, m[i]->size(), w[i]->size());
+          }
+          // memory is synchronized here, out of the parallel loop
+          ptrs[i] = m[i]->getRawDataAccess()->getPPALForReadAndWrite() +
+            m[i]->getOffset();
+        }
+      }
+
+      void checkSize(const UtilFused::MatrixList &w,
+                     const UtilFused::FloatList &v) {
+        if (v.size() != w.size()) {
+          ERROR_EXIT2(128, "Incorrect hyper-parameters list size, found %u, "
+                      "expected %u\n", static_cast<unsigned int>(v.size()),
+                      static_cast<unsigned int>(w.size()));
+        }
+      }
+
+      /// Runs the given kernel over all the chunks in parallel.
+      template<typename K>
+      void applyKernel(const UtilFused::MatrixList &w, const K &kernel) {
+        vector<Chunk> chunks;
+        computeChunks(w, chunks);
+        const int N = static_cast<int>(chunks.size());
+#ifndef NO_OMP
+#pragma omp parallel for schedule(dynamic) if(N > 1)
+#endif
+        for (int i=0; i<N; ++i) {
+          kernel(chunks[i].idx, chunks[i].begin, chunks[i].end);
+        }
+      }
+
+      /// Returns g + l2*w, and stores it into the gradient when l2 != 0.
+      inline float regularize(float *g, const float *w, float l2, int k) {
+        if (l2 == 0.0f) return g[k];
+        return (g[k] += l2*w[k]);
+      }
+
+      struct SGDKernel {
+        vector<float*> w, g, u;
+        const UtilFused::FloatList &lr, &mt, &l2;
+        SGDKernel(const UtilFused::FloatList &lr,
+                  const UtilFused::FloatList &mt,
+                  const UtilFused::FloatList &l2) : lr(lr), mt(mt), l2(l2) { }
+        void operator()(int i, int begin, int end) const {
+          float *w = this->w[i], *g = this->g[i], *u = this->u[i];
+          const float lr = this->lr[i], mt = this->mt[i], l2 = this->l2[i];
+          for (int k=begin; k<end; ++k) {
+            u[k] = mt*u[k] + lr*regularize(g, w, l2, k);
+            w[k] = w[k] - u[k];
+          }
+        }
+      };
+
+      struct AdaGradKernel {
+        vector<float*> w, g, E;
+        const UtilFused::FloatList &lr, &decay, &eps, &l2;
+        AdaGradKernel(const UtilFused::FloatList &lr,
+                      const UtilFused::FloatList &decay,
+                      const UtilFused::FloatList &eps,
+                      const UtilFused::FloatList &l2) :
+          lr(lr), decay(decay), eps(eps), l2(l2) { }
+        void operator()(int i, int begin, int end) const {
+          float *w = this->w[i], *g = this->g[i], *E = this->E[i];
+          const float lr = this->lr[i], decay = this->decay[i];
+          const float eps = this->eps[i], l2 = this->l2[i];
+          for (int k=begin; k<end; ++k) {
+            const float gk = regularize(g, w, l2, k);
+            E[k] = decay*E[k] + (1.0f - decay)*gk*gk;
+            w[k] = w[k] - lr * gk / (eps + m_sqrt(E[k]));
+          }
+        }
+      };
+
+      struct RMSPropKernel {
+        vector<float*> w, g, E, u;
+        const UtilFused::FloatList &lr, &mt, &decay, &eps, &l2;
+        RMSPropKernel(const UtilFused::FloatList &lr,
+                      const UtilFused::FloatList &mt,
+                      const UtilFused::FloatList &decay,
+                      const UtilFused::FloatList &eps,
+                      const UtilFused::FloatList &l2) :
+          lr(lr), mt(mt), decay(decay), eps(eps), l2(l2) { }
+        void operator()(int i, int begin, int end) const {
+          float *w = this->w[i], *g = this->g[i], *E = this->E[i];
+          float *u = this->u[i];
+          const float lr = this->lr[i], mt = this->mt[i];
+          const float decay = this->decay[i], eps = this->eps[i];
+          const float l2 = this->l2[i];
+          for (int k=begin; k<end; ++k) {
+            const float gk = regularize(g, w, l2, k);
+            E[k] = decay*E[k] + (1.0f - decay)*gk*gk;
+            float step = lr * gk / m_sqrt(E[k] + eps);
+            if (u != 0) step = u[k] = mt*u[k] + step;
+            w[k] = w[k] - step;
+          }
+        }
+      };
+
+      struct AdaDeltaKernel {
+        vector<float*> w, g, Eg, Eu, u;
+        const UtilFused::FloatList &lr, &decay, &eps, &l2;
+        AdaDeltaKernel(const UtilFused::FloatList &lr,
+                       const UtilFused::FloatList &decay,
+                       const UtilFused::FloatList &eps,
+                       const UtilFused::FloatList &l2) :
+          lr(lr), decay(decay), eps(eps), l2(l2) { }
+        void operator()(int i, int begin, int end) const {
+          float *w = this->w[i], *g = this->g[i];
+          float *Eg = this->Eg[i], *Eu = this->Eu[i], *u = this->u[i];
+          const float lr = this->lr[i], decay = this->decay[i];
+          const float eps = this->eps[i], l2 = this->l2[i];
+          for (int k=begin; k<end; ++k) {
+            const float gk = regularize(g, w, l2, k);
+            Eg[k] = decay*Eg[k] + (1.0f - decay)*gk*gk;
+            const float uk = -gk * m_sqrt(Eu[k] + eps) / m_sqrt(Eg[k] + eps);
+            Eu[k] = decay*Eu[k] + (1.0f - decay)*uk*uk;
+            u[k] = lr*uk;
+            w[k] = w[k] + u[k];
+          }
+        }
+      };
+
+      struct ASGDKernel {
+        vector<float*> w, g, aw;
+        const UtilFused::FloatList &lr, &mu, &l2;
+        ASGDKernel(const UtilFused::FloatList &lr,
+                   const UtilFused::FloatList &mu,
+                   const UtilFused::FloatList &l2) : lr(lr), mu(mu), l2(l2) { }
+        void operator()(int i, int begin, int end) const {
+          float *w = this->w[i], *g = this->g[i], *aw = this->aw[i];
+          const float lr = this->lr[i], mu = this->mu[i], l2 = this->l2[i];
+          for (int k=begin; k<end; ++k) {
+            w[k] = w[k] - lr*regularize(g, w, l2, k);
+            if (mu != 1.0f) aw[k] = aw[k] + mu*(w[k] - aw[k]);
+            else aw[k] = w[k];
+          }
+        }
+      };
+    } // anonymous namespace
+
+    void UtilFused::sgdStep(const MatrixList &w,
+                            const MatrixList &grads,
+                            const MatrixList &updates,
+                            const FloatList &lr,
+                            const FloatList &mt,
+                            const FloatList &l2) {
+      checkSize(w, lr); checkSize(w, mt); checkSize(w, l2);
+      SGDKernel kernel(lr, mt, l2);
+      getPointers(w, w, kernel.w);
+      getPointers(w, grads, kernel.g);
+      getPointers(w, updates, kernel.u);
+      applyKernel(w, kernel);
+    }
+
+    void UtilFused::adagradStep(const MatrixList &w,
+                                const MatrixList &grads,
+                                const MatrixList &Egradients,
+                                const FloatList &lr,
+                                const FloatList &decay,
+                                const FloatList &eps,
+                                const FloatList &l2) {
+      checkSize(w, lr); checkSize(w, decay); checkSize(w, eps);
+      checkSize(w, l2);
+      AdaGradKernel kernel(lr, decay, eps, l2);
+      getPointers(w, w, kernel.w);
+      getPointers(w, grads, kernel.g);
+      getPointers(w, Egradients, kernel.E);
+      applyKernel(w, kernel);
+    }
+
+    void UtilFused::rmspropStep(const MatrixList &w,
+                                const MatrixList &grads,
+                                const MatrixList &Erms,
+                                const MatrixList &Eupdates,
+                                const FloatList &lr,
+                                const FloatList &mt,
+                                const FloatList &decay,
+                                const FloatList &eps,
+                                const FloatList &l2) {
+      checkSize(w, lr); checkSize(w, mt); checkSize(w, decay);
+      checkSize(w, eps); checkSize(w, l2);
+      RMSPropKernel kernel(lr, mt, decay, eps, l2);
+      getPointers(w, w, kernel.w);
+      getPointers(w, grads, kernel.g);
+      getPointers(w, Erms, kernel.E);
+      getPointers(w, Eupdates, kernel.u, true);
+      applyKernel(w, kernel);
+    }
+
+    void UtilFused::adadeltaStep(const MatrixList &w,
+                                 const MatrixList &grads,
+                                 const MatrixList &Egradients,
+                                 const MatrixList &Eupdates,
+                                 const MatrixList &updates,
+                                 const FloatList &lr,
+                                 const FloatList &decay,
+                                 const FloatList &eps,
+                                 const FloatList &l2) {
+      checkSize(w, lr); checkSize(w, decay); checkSize(w, eps);
+      checkSize(w, l2);
+      AdaDeltaKernel kernel(lr, decay, eps, l2);
+      getPointers(w, w, kernel.w);
+      getPointers(w, grads, kernel.g);
+      getPointers(w, Egradients, kernel.Eg);
+      getPointers(w, Eupdates, kernel.Eu);
+      getPointers(w, updates, kernel.u);
+      applyKernel(w, kernel);
+    }
+
+    void UtilFused::asgdStep(const MatrixList &w,
+                             const MatrixList &grads,
+                             const MatrixList &aw,
+                             const FloatList &lr,
+                             const FloatList &mu,
+                             const FloatList &l2) {
+      checkSize(w, lr); checkSize(w, mu); checkSize(w, l2);
+      ASGDKernel kernel(lr, mu, l2);
+      getPointers(w, w, kernel.w);
+      getPointers(w, grads, kernel.g);
+      getPointers(w, aw, kernel.aw);
+      applyKernel(w, kernel);
+    }
+  }
+}
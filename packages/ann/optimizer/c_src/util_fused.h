@@ -0,0 +1,107 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef UTIL_FUSED_H
+#define UTIL_FUSED_H
+
+#include "matrixFloat.h"
+#include "vector.h"
+
+namespace ANN {
+  namespace Optimizer {
+    /**
+     * @brief Fused update rules of the optimizers.
+     *
+     * Every method updates a list of weight matrices, their gradients and the
+     * optimizer state in only one memory pass, with one OpenMP loop over
+     * chunks of all the given matrices, so small layers don't pay the cost
+     * of several calls. Hyper-parameters are given for every matrix, and L2
+     * regularization is added into the gradient matrix as in the Lua
+     * implementation.
+     *
+     * All the matrices should be contiguous, and the matrices at the same
+     * position of the lists should have the same size. Optional state lists
+     * can contain NULL pointers. The kernels run on host memory, so Lua
+     * optimizers keep their per-matrix update for CUDA or non-contiguous
+     * matrices, see ann.optimizer.utils.fused_accepts().
+     */
+    class UtilFused : public Referenced {
+    public:
+      typedef AprilUtils::vector<Basics::MatrixFloat*> MatrixList;
+      typedef AprilUtils::vector<float> FloatList;
+      
+      /// <tt>u = mt*u + lr*(g + l2*w) ; w = w - u</tt>
+      static void sgdStep(const MatrixList &w,
+                          const MatrixList &grads,
+                          const MatrixList &updates,
+                          const FloatList &lr,
+                          const FloatList &mt,
+                          const FloatList &l2);
+      
+      /// <tt>E = decay*E + (1-decay)*g^2 ; w = w - lr*g/(eps + sqrt(E))</tt>
+      static void adagradStep(const MatrixList &w,
+                              const MatrixList &grads,
+                              const MatrixList &Egradients,
+                              const FloatList &lr,
+                              const FloatList &decay,
+                              const FloatList &eps,
+                              const FloatList &l2);
+
+      /**
+       * <tt>E = decay*E + (1-decay)*g^2 ; u = mt*u + lr*g/sqrt(E+eps) ;
+       * w = w - u</tt>, updates can be NULL when momentum is zero.
+       */
+      static void rmspropStep(const MatrixList &w,
+                              const MatrixList &grads,
+                              const MatrixList &Erms,
+                              const MatrixList &Eupdates,
+                              const FloatList &lr,
+                              const FloatList &mt,
+                              const FloatList &decay,
+                              const FloatList &eps,
+                              const FloatList &l2);
+
+      /**
+       * <tt>Eg = decay*Eg + (1-decay)*g^2 ;
+       * u = -g*sqrt(Eu+eps)/sqrt(Eg+eps) ; Eu = decay*Eu + (1-decay)*u^2 ;
+       * w = w + lr*u</tt>, the updates list receives <tt>lr*u</tt>.
+       */
+      static void adadeltaStep(const MatrixList &w,
+                               const MatrixList &grads,
+                               const MatrixList &Egradients,
+                               const MatrixList &Eupdates,
+                               const MatrixList &updates,
+                               const FloatList &lr,
+                               const FloatList &decay,
+                               const FloatList &eps,
+                               const FloatList &l2);
+
+      /// <tt>w = w - lr*(g + l2*w) ; aw = aw + mu*(w - aw)</tt>
+      static void asgdStep(const MatrixList &w,
+                           const MatrixList &grads,
+                           const MatrixList &aw,
+                           const FloatList &lr,
+                           const FloatList &mu,
+                           const FloatList &l2);
+    };
+  }
+}
+
+#endif // UTIL_FUSED_H
@@ -40,6 +40,19 @@ function ann_optimizer_utils.l1_truncate_gradient(w, l1, update)
   w:cmul(z)
 end
 
+-- receives several lists of matrices (false values are ignored) and returns
+-- true when the fused kernels can update them, that is, when all of them are
+-- host contiguous matrices; otherwise optimizers update every matrix by
+-- itself
+function ann_optimizer_utils.fused_accepts(...)
+  for _,list in ipairs({...}) do
+    for _,m in ipairs(list) do
+      if m and (m:get_use_cuda() or not m:is_contiguous()) then return false end
+    end
+  end
+  return true
+end
+
 -- receives a weights matrix and a max norm penalty value
 function ann_optimizer_utils.max_norm_penalty(w, mnp)
   for _,row in matrix.ext.iterate(w,1) do
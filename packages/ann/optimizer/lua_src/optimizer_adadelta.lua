@@ -75,38 +75,55 @@ function adadelta_methods:execute(eval, weights)
   if not gradients then return nil end
   --
   local count = self:get_count()
-  for wname,w in pairs(weights) do
-    local Eupdate     = self.Eupdates[wname] or matrix.as(w):zeros()
-    local Egradient   = self.Egradients[wname] or matrix.as(w):zeros()
-    local grad        = gradients[wname]
-    local update      = self.update[wname] or matrix.as(w):zeros()
-    -- learning options
-    local lr          = self:get_option_of(wname, "learning_rate")
-    local mt          = self:get_option_of(wname, "momentum")
-    local decay       = self:get_option_of(wname, "decay")
-    local eps         = self:get_option_of(wname, "epsilon")
-    local l2          = self:get_option_of(wname, "weight_decay")
-    local mnp         = self:get_option_of(wname, "max_norm_penalty")
-    -- L2 regularization
-    if l2 > 0.0 then grad:axpy(l2, w) end
-    -- accumulate gradients
-    Egradient[{}] = decay*Egradient + (1-decay)*grad^2
-    -- compute update on grad matrix
-    update:copy(grad):cmul( mop.sqrt(Eupdate + eps) / mop.sqrt(Egradient + eps) ):scal(-1.0)
-    -- accumulate updates
-    Eupdate[{}] = decay*Eupdate + (1-decay)*update^2
-    -- apply update matrix to the weights
-    w:axpy(lr, update)
+  -- fused update of all the weights, L2 regularization, accumulated gradients
+  -- and updates, and weights are computed by one kernel
+  local wnames = iterator(pairs(weights)):select(1):table()
+  local ws,grads,Egradients,Eupdates,updates = {},{},{},{},{}
+  local lrs,decays,epss,l2s = {},{},{},{}
+  for i,wname in ipairs(wnames) do
+    local w = weights[wname]
+    self.Eupdates[wname]   = self.Eupdates[wname] or matrix.as(w):zeros()
+    self.Egradients[wname] = self.Egradients[wname] or matrix.as(w):zeros()
+    self.update[wname]     = self.update[wname] or matrix.as(w):zeros()
+    ws[i], grads[i] = w, gradients[wname]
+    Egradients[i]   = self.Egradients[wname]
+    Eupdates[i]     = self.Eupdates[wname]
+    updates[i]      = self.update[wname]
+    lrs[i]    = self:get_option_of(wname, "learning_rate")
+    decays[i] = self:get_option_of(wname, "decay")
+    epss[i]   = self:get_option_of(wname, "epsilon")
+    l2s[i]    = self:get_option_of(wname, "weight_decay")
+  end
+  if ann.optimizer.utils.fused_accepts(ws, grads, Egradients, Eupdates,
+                                      updates) then
+    ann.optimizer.utils.fused.adadelta(ws, grads, Egradients, Eupdates, updates,
+                                       lrs, decays, epss, l2s)
+  else
+    for i,w in ipairs(ws) do
+      local grad,Egradient,Eupdate,update = grads[i],Egradients[i],Eupdates[i],updates[i]
+      local decay,eps = decays[i],epss[i]
+      -- L2 regularization
+      if l2s[i] > 0.0 then grad:axpy(l2s[i], w) end
+      -- accumulate gradients
+      Egradient[{}] = decay*Egradient + (1-decay)*grad^2
+      -- compute update on grad matrix
+      update:copy(grad):cmul( mop.sqrt(Eupdate + eps) / mop.sqrt(Egradient + eps) ):scal(-1.0)
+      -- accumulate updates
+      Eupdate[{}] = decay*Eupdate + (1-decay)*update^2
+      -- apply update matrix to the weights
+      w:axpy(lrs[i], update)
+      update:scal(lrs[i])
+    end
+  end
+  for i,wname in ipairs(wnames) do
+    local w   = ws[i]
+    local mnp = self:get_option_of(wname, "max_norm_penalty")
     -- constraints
     if mnp > 0.0 then ann.optimizer.utils.max_norm_penalty(w, mnp) end
     -- weights normality check
     if count % MAX_UPDATES_WITHOUT_PRUNE == 0 then
       w:prune_subnormal_and_check_normal()
     end
-    --
-    self.Eupdates[wname] = Eupdate
-    self.Egradients[wname] = Egradient
-    self.update[wname] = update:scal(lr)
   end
   -- count one more update iteration
   self:count_one()
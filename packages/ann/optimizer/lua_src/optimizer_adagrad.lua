@@ -59,35 +59,45 @@ function adagrad_methods:execute(eval, weights)
   if not gradients then return nil end
   --
   local count = self:get_count()
-  for wname,w in pairs(weights) do
-    local Egradient   = self.Egradients[wname] or matrix.as(w):zeros()
-    local grad        = gradients[wname]
-    -- learning options
-    local lr          = self:get_option_of(wname, "learning_rate")
-    local decay       = self:get_option_of(wname, "decay")
-    local eps         = self:get_option_of(wname, "epsilon")
-    local l2          = self:get_option_of(wname, "weight_decay")
-    local mnp         = self:get_option_of(wname, "max_norm_penalty")
-    -- L2 regularization
-    if l2 > 0.0 then grad:axpy(l2, w) end
-    -- accumulate gradients
-    if count == 0 then
-      Egradient[{}] = grad^2
-    else
-      Egradient[{}] = decay*Egradient + (1-decay)*grad^2
+  -- fused update of all the weights, L2 regularization, accumulated gradients
+  -- and weights are computed by one kernel
+  local wnames = iterator(pairs(weights)):select(1):table()
+  local ws,grads,Egradients,lrs,decays,epss,l2s = {},{},{},{},{},{},{}
+  for i,wname in ipairs(wnames) do
+    local w = weights[wname]
+    self.Egradients[wname] = self.Egradients[wname] or matrix.as(w):zeros()
+    ws[i], grads[i], Egradients[i] = w, gradients[wname], self.Egradients[wname]
+    lrs[i]    = self:get_option_of(wname, "learning_rate")
+    -- the first iteration takes the squared gradient as it is
+    decays[i] = (count == 0) and 0.0 or self:get_option_of(wname, "decay")
+    epss[i]   = self:get_option_of(wname, "epsilon")
+    l2s[i]    = self:get_option_of(wname, "weight_decay")
+  end
+  if ann.optimizer.utils.fused_accepts(ws, grads, Egradients) then
+    ann.optimizer.utils.fused.adagrad(ws, grads, Egradients,
+                                      lrs, decays, epss, l2s)
+  else
+    for i,w in ipairs(ws) do
+      local grad,Egradient = grads[i],Egradients[i]
+      -- L2 regularization
+      if l2s[i] > 0.0 then grad:axpy(l2s[i], w) end
+      -- accumulate gradients
+      Egradient[{}] = decays[i]*Egradient + (1-decays[i])*grad^2
+      -- compute update on grad matrix
+      local update = mop.cmul(grad, 1 / (epss[i] + mop.sqrt(Egradient)))
+      -- apply update matrix to the weights
+      w:axpy(-lrs[i], update)
     end
-    -- compute update on grad matrix
-    local update = mop.cmul(grad, 1 / (eps + mop.sqrt(Egradient)))
-    -- apply update matrix to the weights
-    w:axpy(-lr, update)
+  end
+  for i,wname in ipairs(wnames) do
+    local w   = ws[i]
+    local mnp = self:get_option_of(wname, "max_norm_penalty")
     -- constraints
     if mnp > 0.0 then ann.optimizer.utils.max_norm_penalty(w, mnp) end
     -- weights normality check
     if count % MAX_UPDATES_WITHOUT_PRUNE == 0 then
       w:prune_subnormal_and_check_normal()
     end
-    --
-    self.Egradients[wname] = Egradient
   end
   -- count one more update iteration
   self:count_one()
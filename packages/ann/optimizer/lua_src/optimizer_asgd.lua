@@ -55,34 +55,45 @@ function asgd_methods:execute(eval, weights)
   -- this into account
   if not gradients then return nil end
   local t = self:get_count()
-  for wname,w in pairs(weights) do
-    local aw          = self.aw[wname] or w:clone():zeros()
-    local grad        = gradients[wname]
+  -- fused update of all the weights, L2 regularization, weights and averaged
+  -- weights are computed by one kernel
+  local wnames = iterator(pairs(weights)):select(1):table()
+  local ws,grads,aws,lrs,mus,l2s = {},{},{},{},{},{}
+  for i,wname in ipairs(wnames) do
+    local w = weights[wname]
+    self.aw[wname] = self.aw[wname] or w:clone():zeros()
+    ws[i], grads[i], aws[i] = w, gradients[wname], self.aw[wname]
     -- learning options
-    local lr          = self:get_option_of(wname, "learning_rate")
-    local lr_decay    = self:get_option_of(wname, "lr_decay")
-    local t0          = self:get_option_of(wname, "t0")
-    local l2          = self:get_option_of(wname, "weight_decay")
+    local lr       = self:get_option_of(wname, "learning_rate")
+    local lr_decay = self:get_option_of(wname, "lr_decay")
+    local t0       = self:get_option_of(wname, "t0")
+    local l2       = self:get_option_of(wname, "weight_decay")
     -- effective values at time t
-    local lr_t        = lr / ((1.0 + l2 * lr * t)^(lr_decay)) -- learning rate factor
-    local mu_t        = 1.0 / math.max(1, t - t0)             -- average factor
-    -- L2 regularization
-    if l2 > 0.0 then grad:axpy(l2, w) end
-    -- apply back-propagation learning rule
-    w:axpy(-lr_t, grad)
-    if mu_t ~= 1 then
-      -- compute averaged weights
-      aw:axpy(mu_t, w - aw)
-    else
-      -- just copy last weight values
-      aw:copy(w)
-    end
-    -- weights normality check
-    if self:get_count() % MAX_UPDATES_WITHOUT_PRUNE == 0 then
-      w:prune_subnormal_and_check_normal()
+    lrs[i] = lr / ((1.0 + l2 * lr * t)^(lr_decay)) -- learning rate factor
+    mus[i] = 1.0 / math.max(1, t - t0)             -- average factor
+    l2s[i] = l2
+  end
+  if ann.optimizer.utils.fused_accepts(ws, grads, aws) then
+    ann.optimizer.utils.fused.asgd(ws, grads, aws, lrs, mus, l2s)
+  else
+    for i,w in ipairs(ws) do
+      local grad,aw = grads[i],aws[i]
+      -- L2 regularization
+      if l2s[i] > 0.0 then grad:axpy(l2s[i], w) end
+      -- apply back-propagation learning rule
+      w:axpy(-lrs[i], grad)
+      if mus[i] ~= 1 then
+        -- compute averaged weights
+        aw:axpy(mus[i], w - aw)
+      else
+        -- just copy last weight values
+        aw:copy(w)
+      end
     end
-    --
-    self.aw[wname] = aw
+  end
+  -- weights normality check
+  if self:get_count() % MAX_UPDATES_WITHOUT_PRUNE == 0 then
+    for _,w in ipairs(ws) do w:prune_subnormal_and_check_normal() end
   end
   -- count one more update iteration
   self:count_one()
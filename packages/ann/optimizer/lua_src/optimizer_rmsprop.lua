@@ -77,40 +77,54 @@ function rmsprop_methods:execute(eval, weights)
   if not gradients then return nil end
   --
   local count = self:get_count()
-  for wname,w in pairs(weights) do
-    local Eupdate     = self.Eupdates[wname] or matrix.as(w):zeros()
-    local Erms        = self.Erms[wname] or matrix.as(w):zeros()
-    local grad        = april_assert(gradients[wname],
-                                     "Not found gradients of %s", wname)
-    -- learning options
-    local lr          = self:get_option_of(wname, "learning_rate")
-    local mt          = self:get_option_of(wname, "momentum")
-    local decay       = self:get_option_of(wname, "decay")
-    local eps         = self:get_option_of(wname, "epsilon")
-    local l2          = self:get_option_of(wname, "weight_decay")
-    local mnp         = self:get_option_of(wname, "max_norm_penalty")
-    
-    -- L2 regularization
-    if l2 > 0.0 then grad:axpy(l2, w) end
-    -- apply RMSProp with Nesterov momentum rules    
-    Erms:scal(decay):axpy(1 - decay, mop.cmul(grad, grad))
-    if mt > 0.0 then
-      local tmp = (Erms + eps):sqrt():div(lr):cmul(grad)
-      Eupdate:scal(mt):axpy(1.0, tmp)
-    else
-      Eupdate:copy(Erms):scalar_add(eps):sqrt():div(lr):cmul(grad)
+  -- fused update of all the weights, L2 regularization, RMS, Nesterov
+  -- momentum and weights are computed by one kernel
+  local wnames = iterator(pairs(weights)):select(1):table()
+  local ws,grads,Erms,Eupdates = {},{},{},{}
+  local lrs,mts,decays,epss,l2s = {},{},{},{},{}
+  for i,wname in ipairs(wnames) do
+    local w = weights[wname]
+    self.Erms[wname] = self.Erms[wname] or matrix.as(w):zeros()
+    ws[i]     = w
+    grads[i]  = april_assert(gradients[wname],
+                             "Not found gradients of %s", wname)
+    Erms[i]   = self.Erms[wname]
+    lrs[i]    = self:get_option_of(wname, "learning_rate")
+    mts[i]    = self:get_option_of(wname, "momentum")
+    decays[i] = self:get_option_of(wname, "decay")
+    epss[i]   = self:get_option_of(wname, "epsilon")
+    l2s[i]    = self:get_option_of(wname, "weight_decay")
+    -- false when momentum is not used
+    Eupdates[i] = (mts[i] > 0.0) and self.Eupdates[wname] or false
+  end
+  if ann.optimizer.utils.fused_accepts(ws, grads, Erms, Eupdates) then
+    ann.optimizer.utils.fused.rmsprop(ws, grads, Erms, Eupdates,
+                                      lrs, mts, decays, epss, l2s)
+  else
+    for i,w in ipairs(ws) do
+      local grad,E,Eupdate = grads[i],Erms[i],Eupdates[i]
+      -- L2 regularization
+      if l2s[i] > 0.0 then grad:axpy(l2s[i], w) end
+      -- apply RMSProp with Nesterov momentum rules
+      E:scal(decays[i]):axpy(1 - decays[i], mop.cmul(grad, grad))
+      local tmp = (E + epss[i]):sqrt():div(lrs[i]):cmul(grad)
+      if Eupdate then
+        Eupdate:scal(mts[i]):axpy(1.0, tmp)
+        tmp = Eupdate
+      end
+      -- apply update step
+      w:axpy(-1.0, tmp)
     end
-    -- apply update step
-    w:axpy(-1.0, Eupdate)
+  end
+  for i,wname in ipairs(wnames) do
+    local w   = ws[i]
+    local mnp = self:get_option_of(wname, "max_norm_penalty")
     -- constraints
     if mnp > 0.0 then ann.optimizer.utils.max_norm_penalty(w, mnp) end
     -- weights normality check
     if count % MAX_UPDATES_WITHOUT_PRUNE == 0 then
       w:prune_subnormal_and_check_normal()
     end
-    --
-    self.Erms[wname] = Erms
-    if mt > 0.0 then self.Eupdates[wname] = Eupdate end
   end
   -- count one more update iteration
   self:count_one()
@@ -61,37 +61,48 @@ function sgd_methods:execute(eval, weights)
   local d0 = self:get_option("decay")
   local decay = 1.0 / (1.0 + d0 * self:get_count())
   --
-  for wname,w in pairs(weights) do
-    local update      = self.update[wname] or matrix.as(w):zeros()
-    local grad        = gradients[wname]
-    -- learning options
-    local lr          = self:get_option_of(wname, "learning_rate")
-    local lrd         = lr * decay
-    local mt          = self:get_option_of(wname, "momentum")
-    local l1          = self:get_option_of(wname, "L1_norm")
-    local l2          = self:get_option_of(wname, "weight_decay")
-    local mnp         = self:get_option_of(wname, "max_norm_penalty")
+  -- fused update of all the weights, L2 regularization, momentum, update
+  -- matrix and weights are computed by one kernel
+  local wnames = iterator(pairs(weights)):select(1):table()
+  local ws,grads,updates,lrds,mts,l2s = {},{},{},{},{},{}
+  for i,wname in ipairs(wnames) do
+    local w = weights[wname]
+    self.update[wname] = self.update[wname] or matrix.as(w):zeros()
     assert(self:get_option_of(wname, "decay") == d0,
            "decay option cannot be defined layerwise, only globally")
-    -- L2 regularization
-    if l2 > 0.0 then grad:axpy(l2, w) end
-    -- momentum
-    if mt > 0.0 then update:scal(mt) else update:zeros() end
-    -- apply back-propagation learning rule to update matrix
-    update:axpy(lrd, grad)
-    -- apply update matrix to the weights
-    w:axpy(-1.0, update)
+    ws[i], grads[i], updates[i] = w, gradients[wname], self.update[wname]
+    lrds[i] = self:get_option_of(wname, "learning_rate") * decay
+    mts[i]  = self:get_option_of(wname, "momentum")
+    l2s[i]  = self:get_option_of(wname, "weight_decay")
+  end
+  if ann.optimizer.utils.fused_accepts(ws, grads, updates) then
+    ann.optimizer.utils.fused.sgd(ws, grads, updates, lrds, mts, l2s)
+  else
+    for i,w in ipairs(ws) do
+      local grad,update = grads[i],updates[i]
+      -- L2 regularization
+      if l2s[i] > 0.0 then grad:axpy(l2s[i], w) end
+      -- momentum
+      if mts[i] > 0.0 then update:scal(mts[i]) else update:zeros() end
+      -- apply back-propagation learning rule to update matrix
+      update:axpy(lrds[i], grad)
+      -- apply update matrix to the weights
+      w:axpy(-1.0, update)
+    end
+  end
+  for i,wname in ipairs(wnames) do
+    local w   = ws[i]
+    local l1  = self:get_option_of(wname, "L1_norm")
+    local mnp = self:get_option_of(wname, "max_norm_penalty")
     -- L1 regularization, truncated gradient implementation
-    if l1 > 0.0 then ann.optimizer.utils.l1_truncate_gradient(w, lrd*l1,
-                                                              update) end
+    if l1 > 0.0 then ann.optimizer.utils.l1_truncate_gradient(w, lrds[i]*l1,
+                                                              updates[i]) end
     -- constraints
     if mnp > 0.0 then ann.optimizer.utils.max_norm_penalty(w, mnp) end
     -- weights normality check
     if self:get_count() % MAX_UPDATES_WITHOUT_PRUNE == 0 then
       w:prune_subnormal_and_check_normal()
     end
-    --
-    self.update[wname] = update
   end
   -- count one more update iteration
   self:count_one()
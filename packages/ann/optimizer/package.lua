@@ -27,6 +27,7 @@
 	 "test/test-digits-adadelta.lua",
 	 "test/test-digits-rmsprop.lua",
 	 "test/test-beales-function.lua",
+	 "test/test-fused.lua",
        },
      },
    },
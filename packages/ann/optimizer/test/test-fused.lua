@@ -0,0 +1,164 @@
+-- Fused optimizer kernels test, compares them with equivalent matrix
+-- operations
+local check = utest.check
+local T = utest.test
+local mop = matrix.op
+local fused = ann.optimizer.utils.fused
+
+local rnd = random(1234)
+
+-- several matrices, one of them larger than the kernel chunk size
+local DIMS = { {3,4}, {1,7}, {200,100} }
+
+local function gen()
+  local t = {}
+  for i,dims in ipairs(DIMS) do
+    t[i] = matrix(table.unpack(dims)):uniformf(-1,1,rnd)
+  end
+  return t
+end
+
+local function clone(t)
+  local r = {}
+  for i,m in ipairs(t) do r[i] = m:clone() end
+  return r
+end
+
+local function check_all(a, b)
+  for i=1,#a do check.eq(a[i], b[i]) end
+end
+
+T("FusedSGDTest",
+  function()
+    local ws, grads, updates = gen(), gen(), gen()
+    local lr, mt, l2 = { 0.1, 0.2, 0.01 }, { 0.0, 0.9, 0.5 }, { 0.0, 0.1, 0.01 }
+    local ws2, grads2, updates2 = clone(ws), clone(grads), clone(updates)
+    fused.sgd(ws, grads, updates, lr, mt, l2)
+    for i=1,#ws2 do
+      grads2[i]:axpy(l2[i], ws2[i])
+      updates2[i]:scal(mt[i]):axpy(lr[i], grads2[i])
+      ws2[i]:axpy(-1.0, updates2[i])
+    end
+    check_all(ws, ws2)
+    check_all(grads, grads2)
+    check_all(updates, updates2)
+end)
+
+T("FusedAdaGradTest",
+  function()
+    local ws, grads, Eg = gen(), gen(), gen()
+    for i=1,#Eg do Eg[i]:abs() end
+    local lr, decay = { 0.1, 0.2, 0.01 }, { 0.0, 0.9, 0.5 }
+    local eps, l2 = { 1e-6, 1e-3, 1e-6 }, { 0.0, 0.1, 0.01 }
+    local ws2, grads2, Eg2 = clone(ws), clone(grads), clone(Eg)
+    fused.adagrad(ws, grads, Eg, lr, decay, eps, l2)
+    for i=1,#ws2 do
+      grads2[i]:axpy(l2[i], ws2[i])
+      Eg2[i]:scal(decay[i]):axpy(1 - decay[i], mop.cmul(grads2[i], grads2[i]))
+      ws2[i]:axpy(-lr[i], mop.cmul(grads2[i], 1 / (eps[i] + mop.sqrt(Eg2[i]))))
+    end
+    check_all(ws, ws2)
+    check_all(Eg, Eg2)
+end)
+
+T("FusedRMSPropTest",
+  function()
+    local ws, grads, Erms, Eu = gen(), gen(), gen(), gen()
+    for i=1,#Erms do Erms[i]:abs() end
+    Eu[1] = false
+    local lr, mt = { 0.1, 0.2, 0.01 }, { 0.0, 0.9, 0.5 }
+    local decay, eps = { 0.9, 0.9, 0.5 }, { 1e-6, 1e-3, 1e-6 }
+    local l2 = { 0.0, 0.1, 0.01 }
+    local ws2, grads2, Erms2 = clone(ws), clone(grads), clone(Erms)
+    local Eu2 = { false, Eu[2]:clone(), Eu[3]:clone() }
+    fused.rmsprop(ws, grads, Erms, Eu, lr, mt, decay, eps, l2)
+    for i=1,#ws2 do
+      grads2[i]:axpy(l2[i], ws2[i])
+      Erms2[i]:scal(decay[i]):axpy(1 - decay[i], mop.cmul(grads2[i], grads2[i]))
+      local step = (Erms2[i] + eps[i]):sqrt():div(lr[i]):cmul(grads2[i])
+      if Eu2[i] then step = Eu2[i]:scal(mt[i]):axpy(1.0, step) end
+      ws2[i]:axpy(-1.0, step)
+    end
+    check_all(ws, ws2)
+    check_all(Erms, Erms2)
+    check.eq(Eu[2], Eu2[2])
+    check.eq(Eu[3], Eu2[3])
+end)
+
+T("FusedAdaDeltaTest",
+  function()
+    local ws, grads, Eg, Eu, u = gen(), gen(), gen(), gen(), gen()
+    for i=1,#Eg do Eg[i]:abs() Eu[i]:abs() end
+    local lr, decay = { 1.0, 0.2, 0.5 }, { 0.95, 0.9, 0.5 }
+    local eps, l2 = { 1e-6, 1e-3, 1e-6 }, { 0.0, 0.1, 0.01 }
+    local ws2, grads2, Eg2, Eu2 = clone(ws), clone(grads), clone(Eg), clone(Eu)
+    local u2 = {}
+    fused.adadelta(ws, grads, Eg, Eu, u, lr, decay, eps, l2)
+    for i=1,#ws2 do
+      grads2[i]:axpy(l2[i], ws2[i])
+      Eg2[i]:scal(decay[i]):axpy(1 - decay[i], mop.cmul(grads2[i], grads2[i]))
+      u2[i] = grads2[i]:clone():
+        cmul( mop.sqrt(Eu2[i] + eps[i]) / mop.sqrt(Eg2[i] + eps[i]) ):scal(-1.0)
+      Eu2[i]:scal(decay[i]):axpy(1 - decay[i], mop.cmul(u2[i], u2[i]))
+      ws2[i]:axpy(lr[i], u2[i])
+      u2[i]:scal(lr[i])
+    end
+    check_all(ws, ws2)
+    check_all(Eg, Eg2)
+    check_all(Eu, Eu2)
+    check_all(u, u2)
+end)
+
+T("FusedASGDTest",
+  function()
+    local ws, grads, aws = gen(), gen(), gen()
+    local lr, mu, l2 = { 0.1, 0.2, 0.01 }, { 1.0, 0.5, 0.1 }, { 0.0, 0.1, 0.01 }
+    local ws2, grads2, aws2 = clone(ws), clone(grads), clone(aws)
+    fused.asgd(ws, grads, aws, lr, mu, l2)
+    for i=1,#ws2 do
+      grads2[i]:axpy(l2[i], ws2[i])
+      ws2[i]:axpy(-lr[i], grads2[i])
+      if mu[i] ~= 1 then aws2[i]:axpy(mu[i], ws2[i] - aws2[i])
+      else aws2[i]:copy(ws2[i]) end
+    end
+    check_all(ws, ws2)
+    check_all(aws, aws2)
+end)
+
+T("FusedFallbackTest",
+  function()
+    -- non-contiguous weights are updated matrix by matrix, which should give
+    -- the same result as the fused kernels
+    local g = matrix(5,3):uniformf(-1,1,rnd)
+    for _,name in ipairs{ "sgd", "adagrad", "rmsprop", "adadelta", "asgd" } do
+      local big = matrix(20,10):uniformf(-1,1,rnd)
+      local w1  = { w = big[{ {1,5}, {2,4} }] }
+      local w2  = { w = w1.w:clone() }
+      check.FALSE(w1.w:is_contiguous())
+      check.TRUE(w2.w:is_contiguous())
+      local opt1, opt2 = ann.optimizer[name](), ann.optimizer[name]()
+      opt1:set_option("weight_decay", 0.01)
+      opt2:set_option("weight_decay", 0.01)
+      local eval = function() return 0, { w = g:clone() } end
+      for i=1,2 do
+        opt1:execute(eval, w1)
+        opt2:execute(eval, w2)
+      end
+      check.eq(w1.w, w2.w)
+    end
+end)
+
+T("FusedErrorsTest",
+  function()
+    local ws, grads, updates = gen(), gen(), gen()
+    check.errored(function()
+        fused.sgd(ws, grads, { updates[1] }, {1,1,1}, {0,0,0}, {0,0,0})
+    end)
+    check.errored(function()
+        fused.sgd(ws, grads, updates, {1,1}, {0,0,0}, {0,0,0})
+    end)
+    check.errored(function()
+        fused.sgd(ws, grads, { updates[2], updates[1], updates[3] },
+                  {1,1,1}, {0,0,0}, {0,0,0})
+    end)
+end)
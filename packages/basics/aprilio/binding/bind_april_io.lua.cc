@@ -275,7 +275,8 @@ namespace AprilIO {
 //BIND_METHOD StreamInterface seek
 {
   const char *whence = luaL_optstring(L, 1, "cur");
-  int offset = luaL_optint(L, 2, 0);
+  // a double allows offsets larger than 2GB
+  long offset = static_cast<long>(luaL_optnumber(L, 2, 0));
   int int_whence;
   if (strcmp(whence, "cur") == 0) {
     int_whence = SEEK_CUR;
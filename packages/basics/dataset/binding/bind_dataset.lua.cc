@@ -147,6 +147,7 @@ DataSetToken *lua_toAuxDataSetToken(lua_State *L, int n) {
 #include "bind_mtrand.h"
 #include "MersenneTwister.h"
 #include "datasetToken.h"
+#include "datasetPrefetcher.h"
 
 using namespace Basics;
 //BIND_END
@@ -1413,3 +1414,93 @@ LUABIND_ERROR("use constructor methods: matrix, etc.");
 }
 //BIND_END
 
+
+//////////////////////////////////////////
+
+//BIND_LUACLASSNAME DataSetTokenPrefetcher dataset.prefetcher
+//BIND_CPP_CLASS    DataSetTokenPrefetcher
+
+//BIND_CONSTRUCTOR DataSetTokenPrefetcher
+{
+  LUABIND_CHECK_ARGN(==,1);
+  LUABIND_CHECK_PARAMETER(1, table);
+  check_table_fields(L, 1, "datasets", "bunch_size", "shuffle",
+                     "replacement", "size", (const char *)0);
+  int bunch_size, replacement, max_queued;
+  MTRand *rng;
+  LUABIND_GET_TABLE_PARAMETER(1, bunch_size, int, bunch_size);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, shuffle, MTRand, rng, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, replacement, int, replacement, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, size, int, max_queued, 2);
+  if (bunch_size < 1) LUABIND_ERROR("bunch_size must be > 0");
+  if (max_queued < 1) LUABIND_ERROR("size must be > 0");
+  if (replacement < 0) LUABIND_ERROR("replacement must be >= 0");
+  if (replacement > 0 && rng == 0) {
+    LUABIND_ERROR("shuffle is mandatory with replacement");
+  }
+  lua_getfield(L, 1, "datasets");
+  if (!lua_istable(L, -1)) LUABIND_ERROR("datasets table is mandatory");
+  int tbl = lua_gettop(L);
+  unsigned int size;
+  LUABIND_TABLE_GETN(tbl, size);
+  if (size < 1) LUABIND_ERROR("datasets table needs at least one dataset");
+  DataSetToken **ds_array = new DataSetToken*[size];
+  for (unsigned int i=0; i<size; ++i) {
+    lua_rawgeti(L, tbl, i+1);
+    if (!lua_isAuxDataSetToken(L, -1)) {
+      delete[] ds_array;
+      LUABIND_FERROR1("Incorrect dataset at position %d, only C++ datasets "
+                      "are allowed", i+1);
+    }
+    ds_array[i] = lua_toAuxDataSetToken(L, -1);
+    if (i > 0 && ds_array[i]->numPatterns() != ds_array[0]->numPatterns()) {
+      int nump = ds_array[i]->numPatterns();
+      delete[] ds_array;
+      LUABIND_FERROR2("Incorrect number of patterns, expected %d, found %d",
+                      ds_array[0]->numPatterns(), nump);
+    }
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+  obj = new DataSetTokenPrefetcher(ds_array, static_cast<int>(size),
+                                   bunch_size, rng, rng != 0, replacement,
+                                   max_queued);
+  delete[] ds_array;
+  LUABIND_RETURN(DataSetTokenPrefetcher, obj);
+}
+//BIND_END
+
+//BIND_METHOD DataSetTokenPrefetcher next
+// returns one token for every dataset followed by a table with the bunch
+// indexes, or nothing when the epoch is finished
+{
+  LUABIND_CHECK_ARGN(==,0);
+  DataSetTokenPrefetcher::Bunch *bunch = obj->next();
+  if (bunch != 0) {
+    for (unsigned int i=0; i<bunch->tokens.size(); ++i) {
+      AprilUtils::SharedPtr<Token> token( bunch->tokens[i] );
+      LUABIND_RETURN(AuxToken, token);
+    }
+    lua_createtable(L, static_cast<int>(bunch->indexes.size()), 0);
+    for (unsigned int i=0; i<bunch->indexes.size(); ++i) {
+      lua_pushinteger(L, bunch->indexes[i] + 1);
+      lua_rawseti(L, -2, i+1);
+    }
+    LUABIND_INCREASE_NUM_RETURNS(1);
+    delete bunch;
+  }
+}
+//BIND_END
+
+//BIND_METHOD DataSetTokenPrefetcher stop
+{
+  LUABIND_CHECK_ARGN(==,0);
+  obj->stop();
+}
+//BIND_END
+
+//BIND_METHOD DataSetTokenPrefetcher size
+{
+  LUABIND_RETURN(int, obj->getMaxQueued());
+}
+//BIND_END
@@ -31,9 +31,19 @@
 #include "error_print.h"
 #include "maxmin.h"
 #include "april_assert.h"
+#include "omp_utils.h"
+#include "smart_ptr.h"
 
 namespace Basics {
 
+  namespace DataSetUtils {
+    /// Bunches are gathered in parallel when they are large enough.
+    inline bool useParallelBunch(int n, int pattern_size) {
+      return OMPUtils::get_num_threads() > 1 && n > 1 &&
+        static_cast<size_t>(n)*pattern_size >= OMPUtils::get_parallel_threshold();
+    }
+  }
+
   // ---------------------------------------------------------------------
 
   template <typename T>
@@ -171,6 +181,41 @@ namespace Basics {
     return patternSize();
   }
 
+  template <typename T>
+  bool MatrixDataSet<T>::arePatternsRows() const {
+    const int d = matrix->getNumDim();
+    if (offset[0] != 0 || step[0] != 1 || subMatrixSize[0] != 1 ||
+        numSteps[0] != matrix->getDimSize(0)) return false;
+    for (int i=1; i<d; ++i) {
+      if (offset[i] != 0 || subMatrixSize[i] != matrix->getDimSize(i) ||
+          numSteps[i] != 1) return false;
+    }
+    return true;
+  }
+
+  template <typename T>
+  int MatrixDataSet<T>::getPatternBunch(const int *indexes, int n,
+                                        T *dest, int row_stride) {
+    // general sliding windows use getPattern(), which is not reentrant
+    if (!arePatternsRows()) {
+      return DataSet<T>::getPatternBunch(indexes, n, dest, row_stride);
+    }
+    const T *data = matrix->getRawDataAccess()->getPPALForRead() +
+      matrix->getOffset();
+    const int pattern_size = patternSizev;
+#ifndef NO_OMP
+#pragma omp parallel for if(DataSetUtils::useParallelBunch(n, pattern_size))
+#endif
+    for (int i=0; i<n; ++i) {
+      april_assert("Incorrect index" &&
+                   0 <= indexes[i] && indexes[i] < numPatternsv);
+      const T *src = data + static_cast<size_t>(indexes[i])*pattern_size;
+      T *pat = dest + static_cast<size_t>(i)*row_stride;
+      for (int j=0; j<pattern_size; ++j) pat[j] = src[j];
+    }
+    return pattern_size;
+  }
+
   template <typename T>
   void MatrixDataSet<T>::auxPutPattern(int offsetmatrix, int d) {
     int i,c,t;
@@ -260,6 +305,22 @@ namespace Basics {
     return patternsz;
   }
 
+  template <typename T>
+  int IdentityDataSet<T>::getPatternBunch(const int *indexes, int n,
+                                          T *dest, int row_stride) {
+#ifndef NO_OMP
+#pragma omp parallel for if(DataSetUtils::useParallelBunch(n, patternsz))
+#endif
+    for (int i=0; i<n; ++i) {
+      april_assert("Incorrect index" &&
+                   indexes[i] >= 0 && indexes[i] < numPatterns());
+      T *pat = dest + static_cast<size_t>(i)*row_stride;
+      for (int j=0; j<patternsz; j++) pat[j] = zerovalue;
+      pat[indexes[i]] = onevalue;
+    }
+    return patternsz;
+  }
+
   template <typename T>
   int IdentityDataSet<T>::putPattern(int index, const T *pat) {
     UNUSED_VARIABLE(index);
@@ -354,6 +415,14 @@ namespace Basics {
     return ds->getPattern(ini + index,pat);
   }
 
+  template <typename T>
+  int SubDataSet<T>::getPatternBunch(const int *indexes, int n,
+                                     T *dest, int row_stride) {
+    AprilUtils::UniquePtr<int []> ds_indexes(new int[n]);
+    for (int i=0; i<n; ++i) ds_indexes[i] = ini + indexes[i];
+    return ds->getPatternBunch(ds_indexes.get(), n, dest, row_stride);
+  }
+
   template <typename T>
   int SubDataSet<T>::putPattern(int index, const T *pat) {
     // TODO: falta comprobar que el indice esta en el rango correcto
@@ -424,6 +493,14 @@ namespace Basics {
     return patternSize();
   }
 
+  template <typename T>
+  int JoinDataSet<T>::getPatternBunch(const int *indexes, int n,
+                                      T *dest, int row_stride) {
+    for (int i=0; i < num; i++)
+      vds[i]->getPatternBunch(indexes, n, dest+d[i], row_stride);
+    return patternSize();
+  }
+
   template <typename T>
   int JoinDataSet<T>::putPattern(int index, const T *pat) {
     for (int i=0; i < num; i++) 
@@ -475,6 +552,27 @@ namespace Basics {
     return patternSize();
   }
 
+  template <typename T>
+  int IndexDataSet<T>::getPatternBunch(const int *indexes, int n,
+                                       T *dest, int row_stride) {
+    // all the indices at once, and one bunch for every dictionary
+    AprilUtils::UniquePtr<T []> bunch_indices(new T[n*numdiccionarios]);
+    AprilUtils::UniquePtr<int []> dict_indexes(new int[n]);
+    indices->getPatternBunch(indexes, n, bunch_indices.get(), numdiccionarios);
+    int pos = 0;
+    for (int i=0; i < numdiccionarios; i++) {
+      for (int j=0; j < n; j++) {
+        int idx = static_cast<int>(bunch_indices[j*numdiccionarios + i]) -
+          firstindex;
+        april_assert("Incorrect index at IndexDataSet" && idx >= 0);
+        dict_indexes[j] = idx;
+      }
+      pos += diccionarios[i]->getPatternBunch(dict_indexes.get(), n,
+                                              dest+pos, row_stride);
+    }
+    return patternSize();
+  }
+
   template <typename T>
   int IndexDataSet<T>::putPattern(int index, const T *pat) {
     int pos = 0;
@@ -556,6 +654,24 @@ namespace Basics {
     return patternsize;
   }
 
+  template <typename T>
+  int ContextualizerDataSet<T>::getPatternBunch(const int *indexes, int n,
+                                                T *dest, int row_stride) {
+    // one bunch for every context position, out of range positions are
+    // replaced by the first or the last pattern
+    const int ps = ds->patternSize(), width = ctxtizq + ctxtder + 1;
+    AprilUtils::UniquePtr<int []> ds_indexes(new int[n]);
+    for (int c=0; c<width; ++c) {
+      for (int i=0; i<n; ++i) {
+        ds_indexes[i] = AprilUtils::clamp(indexes[i] - ctxtizq + c,
+                                          0, numpatterns-1);
+      }
+      const int slot = (reverse) ? (width - 1 - c) : c;
+      ds->getPatternBunch(ds_indexes.get(), n, dest + slot*ps, row_stride);
+    }
+    return patternsize;
+  }
+
   template <typename T>
   int ContextualizerDataSet<T>::putPattern(int index, const T *pat) {
     const T *vec = pat;
@@ -58,6 +58,19 @@ namespace Basics {
     /// Put the given vector pat at pattern index. The function returns the
     /// patternSize().
     virtual int putPattern(int index, const T *pat)=0;
+    /**
+     * @brief Gets the patterns at the given indexes, the pattern of
+     * indexes[i] is written at <tt>dest + i*row_stride</tt>. The function
+     * returns the patternSize().
+     *
+     * The default implementation calls getPattern() for every index. Derived
+     * classes gather the whole bunch at once when possible.
+     */
+    virtual int getPatternBunch(const int *indexes, int n,
+                                T *dest, int row_stride) {
+      for (int i=0; i<n; ++i) getPattern(indexes[i], dest + i*row_stride);
+      return patternSize();
+    }
   };
 
   /// DataSet specialization to put or get patterns from a Matrix object.
@@ -96,6 +109,8 @@ namespace Basics {
     void index2coordinate(int index);
     void auxGetPattern(int offsetmatrix, int d);
     void auxPutPattern(int offsetmatrix, int d);
+    /// True when every pattern is a contiguous row of the matrix.
+    bool arePatternsRows() const;
   public:
     MatrixDataSet(Matrix<T> *m);
     virtual ~MatrixDataSet();
@@ -117,6 +132,7 @@ namespace Basics {
     int numPatterns() { return numPatternsv; }
     int patternSize() { return patternSizev; }
     int getPattern(int index, T *pat);
+    int getPatternBunch(const int *indexes, int n, T *dest, int row_stride);
     int putPattern(int index, const T *pat);
   };
 
@@ -166,6 +182,7 @@ namespace Basics {
     int numPatterns() { return patternsz; }
     int patternSize() { return patternsz; }
     int getPattern(int index, T *pat);
+    int getPatternBunch(const int *indexes, int n, T *dest, int row_stride);
     int putPattern(int index, const T *pat);
   };
 
@@ -193,6 +210,7 @@ namespace Basics {
     int numPatterns() { return size; }
     int patternSize() { return ds->patternSize(); }
     int getPattern(int index, T *pat);
+    int getPatternBunch(const int *indexes, int n, T *dest, int row_stride);
     int putPattern(int index, const T *pat);
   };
 
@@ -251,6 +269,7 @@ namespace Basics {
     int numPatterns() { return vds[0]->numPatterns(); }
     int patternSize() { return d[num]; }
     int getPattern(int index, T *pat);
+    int getPatternBunch(const int *indexes, int n, T *dest, int row_stride);
     int putPattern(int index, const T *pat);
   };
 
@@ -283,6 +302,7 @@ namespace Basics {
     int numPatterns() { return indices->numPatterns(); }
     int patternSize() { return patternsize; }
     int getPattern(int index, T *pat);
+    int getPatternBunch(const int *indexes, int n, T *dest, int row_stride);
     int putPattern(int index, const T *pat);
   };
 
@@ -371,6 +391,7 @@ namespace Basics {
     int numPatterns() { return numpatterns; }
     int patternSize() { return patternsize; }
     int getPattern(int index, T *pat);
+    int getPatternBunch(const int *indexes, int n, T *dest, int row_stride);
     int putPattern(int index, const T *pat);
   };
 
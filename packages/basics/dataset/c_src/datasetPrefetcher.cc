@@ -0,0 +1,157 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include "datasetPrefetcher.h"
+#include "error_print.h"
+
+namespace Basics {
+
+  DataSetTokenPrefetcher::DataSetTokenPrefetcher(DataSetToken **datasets,
+                                                 int num_datasets,
+                                                 int bunch_size,
+                                                 MTRand *rng,
+                                                 bool shuffle,
+                                                 int replacement,
+                                                 int max_queued) :
+    Threadable("dataset prefetcher"),
+    rng(rng), num_patterns(0), bunch_size(bunch_size),
+    replacement(replacement), max_queued(max_queued), shuffle(shuffle),
+    order(0), num_produced(0), free_slots(max_queued), finished(false) {
+    if (num_datasets < 1) ERROR_EXIT(128, "At least one dataset is needed\n");
+    if (bunch_size < 1) ERROR_EXIT(128, "Bunch size must be > 0\n");
+    if (max_queued < 1) ERROR_EXIT(128, "Prefetch size must be > 0\n");
+    if ((shuffle || replacement > 0) && rng == 0) {
+      ERROR_EXIT(128, "A random object is needed for shuffle or replacement\n");
+    }
+    if (replacement > 0 && !shuffle) {
+      ERROR_EXIT(128, "Shuffle is mandatory with replacement\n");
+    }
+    num_patterns = datasets[0]->numPatterns();
+    for (int i=0; i<num_datasets; ++i) {
+      if (datasets[i]->numPatterns() != num_patterns) {
+        ERROR_EXIT2(128, "Incorrect number of patterns, expected %d, found %d\n",
+                    num_patterns, datasets[i]->numPatterns());
+      }
+      this->datasets.push_back(datasets[i]);
+      IncRef(datasets[i]);
+    }
+    if (rng != 0) IncRef(rng);
+    pthread_mutex_init(&slots_mutex, NULL);
+    pthread_cond_init(&slots_cond, NULL);
+    setVerbose(false);
+    startThread();
+  }
+
+  DataSetTokenPrefetcher::~DataSetTokenPrefetcher() {
+    // needs to be done here, executeBeforeStop() is not available at
+    // ~Threadable()
+    stop();
+    pthread_mutex_destroy(&slots_mutex);
+    pthread_cond_destroy(&slots_cond);
+    delete[] order;
+    for (unsigned int i=0; i<datasets.size(); ++i) DecRef(datasets[i]);
+    if (rng != 0) DecRef(rng);
+  }
+
+  int DataSetTokenPrefetcher::nextIndex() {
+    if (replacement > 0) {
+      if (num_produced >= replacement) return -1;
+      ++num_produced;
+      // same as randInt(1,num_patterns) at Lua side
+      return static_cast<int>(rng->randInt(num_patterns - 1));
+    }
+    if (num_produced >= num_patterns) return -1;
+    if (shuffle) {
+      if (order == 0) {
+        order = new int[num_patterns];
+        rng->shuffle(num_patterns, order);
+      }
+      return order[num_produced++];
+    }
+    return num_produced++;
+  }
+
+  DataSetTokenPrefetcher::Bunch *DataSetTokenPrefetcher::produceBunch() {
+    Bunch *bunch = new Bunch();
+    int idx;
+    while (static_cast<int>(bunch->indexes.size()) < bunch_size &&
+           (idx = nextIndex()) >= 0) {
+      bunch->indexes.push_back(idx);
+    }
+    if (!bunch->empty()) {
+      for (unsigned int i=0; i<datasets.size(); ++i) {
+        Token *token = datasets[i]->getPatternBunch(bunch->indexes.begin(),
+                                                    bunch->indexes.size());
+        IncRef(token);
+        bunch->tokens.push_back(token);
+      }
+    }
+    return bunch;
+  }
+
+  bool DataSetTokenPrefetcher::threadProcedure() {
+    pthread_mutex_lock(&slots_mutex);
+    while (free_slots == 0 && isRunning()) {
+      pthread_cond_wait(&slots_cond, &slots_mutex);
+    }
+    bool running = isRunning();
+    if (running) --free_slots;
+    pthread_mutex_unlock(&slots_mutex);
+    if (!running) return false;
+    Bunch *bunch = produceBunch();
+    bool last = bunch->empty();
+    ready.put(bunch);
+    return !last;
+  }
+
+  void DataSetTokenPrefetcher::executeBeforeStop() {
+    pthread_mutex_lock(&slots_mutex);
+    pthread_cond_broadcast(&slots_cond);
+    pthread_mutex_unlock(&slots_mutex);
+  }
+
+  void DataSetTokenPrefetcher::releaseSlot() {
+    pthread_mutex_lock(&slots_mutex);
+    ++free_slots;
+    pthread_cond_signal(&slots_cond);
+    pthread_mutex_unlock(&slots_mutex);
+  }
+
+  DataSetTokenPrefetcher::Bunch *DataSetTokenPrefetcher::next() {
+    if (finished) return 0;
+    Bunch *bunch = ready.get();
+    releaseSlot();
+    if (bunch->empty()) {
+      delete bunch;
+      finished = true;
+      waitThread();
+      return 0;
+    }
+    return bunch;
+  }
+
+  void DataSetTokenPrefetcher::stop() {
+    stopThread();
+    waitThread();
+    while (!ready.empty()) delete ready.get();
+    finished = true;
+  }
+
+} // namespace Basics
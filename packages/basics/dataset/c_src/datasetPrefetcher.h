@@ -0,0 +1,129 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef DATASETPREFETCHER_H
+#define DATASETPREFETCHER_H
+
+#include <pthread.h>
+#include "datasetToken.h"
+#include "MersenneTwister.h"
+#include "mutexed_fifo.h"
+#include "threadable.h"
+#include "token_base.h"
+#include "vector.h"
+
+namespace Basics {
+
+  /**
+   * @brief Assembles pattern bunches of several DataSetToken objects in a
+   * background thread, so they are ready when the trainer asks for them.
+   *
+   * The traversal is the same as trainable.dataset_multiple_iterator:
+   * sequential, shuffled or shuffled with replacement. Indexes are generated
+   * in the worker thread with the same MTRand calls done by the Lua iterator,
+   * so both produce exactly the same bunches.
+   *
+   * At most @c max_queued bunches are kept ready, the worker sleeps until the
+   * consumer releases one of them.
+   *
+   * @note The datasets and the MTRand object are used from the worker thread
+   * while the prefetcher is running, so they shouldn't be used (neither
+   * modified) by anyone else until next() returns NULL or stop() is called.
+   * Datasets implemented in Lua are not allowed.
+   */
+  class DataSetTokenPrefetcher : public Threadable {
+  public:
+    /// A bunch of patterns, one token for every dataset.
+    struct Bunch {
+      AprilUtils::vector<Token*> tokens;
+      /// Indexes of the patterns, starting at 0.
+      AprilUtils::vector<int> indexes;
+      ~Bunch() {
+        for (unsigned int i=0; i<tokens.size(); ++i) DecRef(tokens[i]);
+      }
+      /// An empty bunch marks the end of the epoch.
+      bool empty() const { return indexes.empty(); }
+    };
+    
+  private:
+    AprilUtils::vector<DataSetToken*> datasets;
+    MTRand *rng;
+    int num_patterns, bunch_size, replacement, max_queued;
+    bool shuffle;
+    
+    // worker side state
+    int *order; ///< Permutation of patterns when shuffle without replacement.
+    int num_produced;
+    
+    // bunches ready to be consumed, and free slots to produce more
+    AprilThreadUtils::MutexedFIFO<Bunch*> ready;
+    pthread_mutex_t slots_mutex;
+    pthread_cond_t  slots_cond;
+    int free_slots;
+    
+    // consumer side state
+    bool finished;
+    
+    /// Returns the next index or -1 when the epoch is finished.
+    int nextIndex();
+    Bunch *produceBunch();
+    void releaseSlot();
+    
+  protected:
+    virtual void executeBeforeStop();
+    virtual bool threadProcedure();
+    
+  public:
+    /**
+     * @param datasets - Array of datasets, all with the same number of
+     * patterns.
+     * @param num_datasets - Size of @c datasets array.
+     * @param bunch_size - Number of patterns of every bunch, the last one
+     * can be smaller.
+     * @param rng - Random object for shuffle and replacement, it can be NULL
+     * for a sequential traversal.
+     * @param shuffle - Indicates if patterns are traversed in random order.
+     * @param replacement - If > 0, number of patterns sampled with
+     * replacement (it needs @c shuffle=true).
+     * @param max_queued - Maximum number of bunches ready to be consumed.
+     */
+    DataSetTokenPrefetcher(DataSetToken **datasets, int num_datasets,
+                           int bunch_size, MTRand *rng,
+                           bool shuffle, int replacement, int max_queued);
+    virtual ~DataSetTokenPrefetcher();
+    
+    /**
+     * @brief Returns the next bunch, waiting for it if it isn't ready.
+     *
+     * @return A Bunch which should be deleted by the caller, or NULL when the
+     * epoch is finished.
+     */
+    Bunch *next();
+    
+    /// Stops the worker thread and discards the bunches not consumed.
+    void stop();
+    
+    int getNumDataSets() const { return static_cast<int>(datasets.size()); }
+    int getMaxQueued() const { return max_queued; }
+  };
+  
+} // namespace Basics
+
+#endif // DATASETPREFETCHER_H
@@ -180,7 +180,7 @@ namespace Basics {
       return token;
     }
     Token *getPatternBunch(const int *indexes, unsigned int bunch_size) {
-      int dims[2], major_dim=0;
+      int dims[2];
       dims[0] = static_cast<int>(bunch_size); dims[1] = patternSize();
       MatrixFloat *mat = new MatrixFloat(2, dims);
 #ifdef USE_CUDA
@@ -189,19 +189,15 @@ namespace Basics {
 #endif
       // The TokenMatrixFloat takes increases reference counter of Matrix.
       TokenMatrixFloat *token = new TokenMatrixFloat(mat);
-      // The memory block given to ds->getPattern(...).
-      AprilMath::FloatGPUMirroredMemoryBlock *aux_mem_block = aux_mat->getRawDataAccess();
-      float *aux_mem = aux_mem_block->getPPALForWrite();
-      // int pattern_size = patternSize();
+#ifndef NDEBUG
       int num_patterns = numPatterns();
-      dims[major_dim] = 1;
-      AprilUtils::SharedPtr<MatrixFloat> submat;
       for (unsigned int i=0; i<bunch_size; ++i) {
         april_assert(0 <= indexes[i] && indexes[i] < num_patterns);
-        ds->getPattern(indexes[i], aux_mem);
-        submat = mat->select(0, i, submat.get());
-        AprilMath::MatrixExt::BLAS::matCopy(submat.get(),aux_mat.get());
       }
+#endif
+      // patterns are gathered directly into the matrix memory
+      float *mem = mat->getRawDataAccess()->getPPALForWrite() + mat->getOffset();
+      ds->getPatternBunch(indexes, static_cast<int>(bunch_size), mem, dims[1]);
 #ifdef USE_CUDA
       mat->setUseCuda(old_use_cuda);
 #endif
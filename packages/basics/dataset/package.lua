@@ -1,6 +1,7 @@
  package{ name = "dataset",
    version = "1.0",
-   depends = { "util", "matrix", "random", "tokens", "functions" },
+   depends = { "util", "matrix", "random", "tokens", "functions",
+               "thread_utils" },
    keywords = { "dataset" },
    description = "no description available",
    -- targets como en ant
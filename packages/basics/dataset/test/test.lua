@@ -39,3 +39,74 @@ T("DatasetIterators",
     for i,tbl in ds:bunches(4) do print(i) end
 end)
 
+
+T("DataSetPatternBunch",
+  function()
+    local m = matrix(20,6):linspace()
+    local base = dataset.matrix(m)
+    local idx = dataset.matrix(matrix(20,2):linspace():scalar_add(-1):
+                                 clamp(0,9):scalar_add(1))
+    local ctx = dataset.contextualizer(dataset.indexed(idx, {
+                                                         dataset.identity(10),
+                                                         dataset.slice(base, 1, 10),
+                                       }), 2, 1)
+    local rctx = dataset.contextualizer(base, 1, 2, true)
+    local ds = dataset.join{ dataset.slice(ctx, 3, 17),
+                             dataset.slice(rctx, 4, 18) }
+    for _,ds in ipairs{ base, ctx, rctx, ds } do
+      local indexes = { 1, ds:numPatterns(), 5, 2, 5, 3 }
+      local expected = matrix(#indexes, ds:patternSize())
+      for i,j in ipairs(indexes) do
+        expected(i,':'):copy(matrix(1, ds:patternSize(), ds:getPattern(j)))
+      end
+      local bunch = dataset.token.wrapper(ds):getPatternBunch(indexes)
+      check.eq(bunch, expected)
+    end
+end)
+
+T("DataSetPrefetcher",
+  function()
+    local m = matrix(23,4):linspace()
+    local ds1 = dataset.matrix(m)
+    local ds2 = dataset.token.wrapper(dataset.matrix(m:clone():scal(2)))
+    local traversals = {
+      { },
+      { shuffle=random(1234) },
+      { shuffle=random(1234), replacement=31 },
+    }
+    for _,params in ipairs(traversals) do
+      local ref_rnd = params.shuffle and params.shuffle:clone()
+      local order
+      if params.replacement then
+        order = iterator(range(1,params.replacement)):
+          map(function() return ref_rnd:randInt(1,23) end):table()
+      elseif params.shuffle then order = ref_rnd:shuffle(23)
+      else order = iterator(range(1,23)):table()
+      end
+      local pf = dataset.prefetcher{ datasets = { ds1, ds2 }, bunch_size = 5,
+                                     shuffle = params.shuffle,
+                                     replacement = params.replacement,
+                                     size = 2 }
+      local n = 0
+      for b1,b2,indexes in function() return pf:next() end do
+        check.eq(#indexes, math.min(5, #order - n))
+        for i,j in ipairs(indexes) do
+          check.eq(j, order[n+i])
+          check.eq(b1(i,':'), m(j,':'))
+        end
+        check.eq(b2, b1 * 2)
+        n = n + #indexes
+      end
+      check.eq(n, #order)
+      check.TRUE(pf:next() == nil)
+      if ref_rnd then check.eq(params.shuffle:randInt(), ref_rnd:randInt()) end
+    end
+    -- stopping before the end of the epoch
+    local pf = dataset.prefetcher{ datasets = { ds1 }, bunch_size = 2 }
+    check.TRUE(pf:next() ~= nil)
+    pf:stop()
+    check.TRUE(pf:next() == nil)
+    check.errored(function() dataset.prefetcher{ datasets = { ds1 },
+                                                 bunch_size = 2,
+                                                 replacement = 10 } end)
+end)
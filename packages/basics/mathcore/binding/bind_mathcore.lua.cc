@@ -33,6 +33,11 @@ using namespace AprilMath;
 #include "luabindutil.h"
 #include "luabindmacros.h"
 #include "maxmin.h"
+#ifndef NO_POOL
+#include "memory_arena.h"
+#endif
+#include "omp_utils.h"
+#include "simd_kernels.h"
 
 using namespace AprilMath;
 
@@ -154,6 +159,124 @@ namespace AprilMath {
 }
 //BIND_END
 
+//BIND_FUNCTION mathcore.get_max_pool_size
+{
+#ifndef NO_POOL
+  LUABIND_RETURN(double,
+                 static_cast<double>(MemoryArena::getMaxHeldSize()));
+#else
+  LUABIND_RETURN(double, 0.0);
+#endif
+}
+//BIND_END
+
+//BIND_FUNCTION mathcore.get_pool_stats
+{
+  lua_newtable(L);
+#ifndef NO_POOL
+  MemoryArena::Stats stats = MemoryArena::getStats();
+  lua_pushnumber(L, static_cast<double>(stats.hits));
+  lua_setfield(L, -2, "hits");
+  lua_pushnumber(L, static_cast<double>(stats.misses));
+  lua_setfield(L, -2, "misses");
+  lua_pushnumber(L, static_cast<double>(stats.releases));
+  lua_setfield(L, -2, "releases");
+  lua_pushnumber(L, static_cast<double>(stats.bytes_held));
+  lua_setfield(L, -2, "bytes_held");
+  lua_pushnumber(L, static_cast<double>(stats.threads));
+  lua_setfield(L, -2, "threads");
+#endif
+  LUABIND_INCREASE_NUM_RETURNS(1);
+}
+//BIND_END
+
+//BIND_FUNCTION mathcore.reset_pool_stats
+{
+#ifndef NO_POOL
+  MemoryArena::resetStats();
+#endif
+}
+//BIND_END
+
+//BIND_FUNCTION mathcore.clear_pool
+{
+#ifndef NO_POOL
+  MemoryArena::clear();
+#endif
+}
+//BIND_END
+
+//BIND_FUNCTION mathcore.get_pool_size_class
+{
+  unsigned int sz;
+  LUABIND_CHECK_ARGN(==,1);
+  LUABIND_GET_PARAMETER(1, uint, sz);
+#ifndef NO_POOL
+  LUABIND_RETURN(uint, static_cast<unsigned int>(MemoryArena::getSizeClass(sz)));
+#else
+  LUABIND_RETURN(uint, sz);
+#endif
+}
+//BIND_END
+
+//BIND_FUNCTION mathcore.get_simd_level
+{
+  LUABIND_RETURN(string, SIMD::getLevelName(SIMD::getLevel()));
+}
+//BIND_END
+
+//BIND_FUNCTION mathcore.get_max_simd_level
+{
+  LUABIND_RETURN(string, SIMD::getLevelName(SIMD::getMaxLevel()));
+}
+//BIND_END
+
+//BIND_FUNCTION mathcore.set_simd_level
+{
+  const char *name;
+  LUABIND_CHECK_ARGN(==,1);
+  LUABIND_GET_PARAMETER(1, string, name);
+  SIMD::Level level = SIMD::getLevelFromString(name);
+  if (level == SIMD::NUM_LEVELS) {
+    LUABIND_FERROR1("Unknown SIMD level %s", name);
+  }
+  if (!SIMD::setLevel(level)) {
+    LUABIND_FERROR1("SIMD level %s is not supported", name);
+  }
+}
+//BIND_END
+
+//BIND_FUNCTION mathcore.get_omp_grain_size
+{
+  LUABIND_RETURN(uint, OMPUtils::get_grain_size());
+}
+//BIND_END
+
+//BIND_FUNCTION mathcore.set_omp_grain_size
+{
+  unsigned int n;
+  LUABIND_CHECK_ARGN(==,1);
+  LUABIND_GET_PARAMETER(1, uint, n);
+  if (n == 0u) LUABIND_ERROR("Grain size must be > 0");
+  OMPUtils::set_grain_size(n);
+}
+//BIND_END
+
+//BIND_FUNCTION mathcore.get_omp_parallel_threshold
+{
+  LUABIND_RETURN(uint, OMPUtils::get_parallel_threshold());
+}
+//BIND_END
+
+//BIND_FUNCTION mathcore.set_omp_parallel_threshold
+{
+  unsigned int n;
+  LUABIND_CHECK_ARGN(==,1);
+  LUABIND_GET_PARAMETER(1, uint, n);
+  OMPUtils::set_parallel_threshold(n);
+}
+//BIND_END
+
 //BIND_FUNCTION mathcore.set_use_cuda_default
 {
   bool v;
@@ -0,0 +1,315 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include <cstring>
+#include "cmath_overloads.h"
+#include "error_print.h"
+#include "fused_program.h"
+#include "maxmin.h"
+#include "unique_ptr.h"
+
+namespace AprilMath {
+
+  namespace {
+    /// Names of the opcodes, in the same order as FusedProgram::OpCode.
+    const char *OPCODE_NAMES[FusedProgram::OP_NUM_OPCODES] = {
+      "input", "const",
+      "neg", "exp", "expm1", "log", "log1p", "sqrt", "square",
+      "abs", "sign", "inv", "complement", "tanh", "logistic",
+      "log_logistic", "softplus", "relu", "sin", "cos",
+      "floor", "ceil", "round",
+      "add", "sub", "mul", "div", "pow", "max", "min", "lt", "gt",
+      "eq",
+      "clamp", "select",
+    };
+
+    /// Names of the reduce codes, in the same order as FusedProgram::ReduceCode.
+    const char *REDUCE_NAMES[] = { "none", "sum", "prod", "max", "min", 0 };
+
+    template<typename F>
+    inline void applyUnary(const F &f, float *x, unsigned int n) {
+      for (unsigned int i=0; i<n; ++i) x[i] = f(x[i]);
+    }
+
+    template<typename F>
+    inline void applyBinary(const F &f, float *x, const float *y,
+                            unsigned int n) {
+      for (unsigned int i=0; i<n; ++i) x[i] = f(x[i], y[i]);
+    }
+
+    inline void loadBlock(float *dest, const float *src, unsigned int stride,
+                          unsigned int n) {
+      if (stride == 1u) {
+        memcpy(dest, src, n*sizeof(float));
+      }
+      else {
+        for (unsigned int i=0; i<n; ++i, src+=stride) dest[i] = *src;
+      }
+    }
+
+    inline void storeBlock(float *dest, unsigned int stride, const float *src,
+                           unsigned int n) {
+      if (stride == 1u) {
+        memmove(dest, src, n*sizeof(float));
+      }
+      else {
+        for (unsigned int i=0; i<n; ++i, dest+=stride) *dest = src[i];
+      }
+    }
+
+    struct f_neg { float operator()(float a) const { return -a; } };
+    struct f_square { float operator()(float a) const { return a*a; } };
+    struct f_inv { float operator()(float a) const { return 1.0f/a; } };
+    struct f_sub { float operator()(float a, float b) const { return a-b; } };
+    struct f_pow {
+      float operator()(float a, float b) const { return AprilMath::m_pow(a,b); }
+    };
+    struct f_lt {
+      float operator()(float a, float b) const { return (a<b) ? 1.0f : 0.0f; }
+    };
+    struct f_gt {
+      float operator()(float a, float b) const { return (a>b) ? 1.0f : 0.0f; }
+    };
+    struct f_eq {
+      float operator()(float a, float b) const {
+        return AprilMath::m_eq(a,b) ? 1.0f : 0.0f;
+      }
+    };
+  } // anonymous namespace
+
+  FusedProgram::FusedProgram(int num_inputs) :
+    Referenced(), num_inputs(num_inputs), reduction(REDUCE_NONE),
+    depth(0), max_depth(0) {
+    if (num_inputs < 0) ERROR_EXIT(128, "Expected a non-negative number of inputs\n");
+  }
+
+  FusedProgram::~FusedProgram() {
+  }
+
+  int FusedProgram::getArity(OpCode op) {
+    if (op <= OP_CONST) return 0;
+    if (op < OP_ADD) return 1;
+    if (op < OP_CLAMP) return 2;
+    if (op < OP_NUM_OPCODES) return 3;
+    return -1;
+  }
+
+  FusedProgram::OpCode FusedProgram::getOpCodeFromString(const char *name) {
+    for (int i=0; i<OP_NUM_OPCODES; ++i) {
+      if (!strcmp(name, OPCODE_NAMES[i])) return static_cast<OpCode>(i);
+    }
+    return OP_NUM_OPCODES;
+  }
+
+  int FusedProgram::getReduceCodeFromString(const char *name) {
+    for (int i=0; REDUCE_NAMES[i] != 0; ++i) {
+      if (!strcmp(name, REDUCE_NAMES[i])) return i;
+    }
+    return -1;
+  }
+
+  float FusedProgram::getReduceZero(ReduceCode red) {
+    switch(red) {
+    case REDUCE_PROD: return 1.0f;
+    case REDUCE_MAX:  return Limits<float>::lowest();
+    case REDUCE_MIN:  return Limits<float>::max();
+    default:          return 0.0f;
+    }
+  }
+
+  void FusedProgram::pushInstruction(const Instruction &inst) {
+    int arity = getArity(inst.op);
+    if (arity < 0) ERROR_EXIT1(128, "Unknown fused opcode %d\n", inst.op);
+    if (depth < arity) {
+      ERROR_EXIT1(128, "Stack underflow in fused program for opcode %s\n",
+                  OPCODE_NAMES[inst.op]);
+    }
+    depth = depth - arity + 1;
+    if (depth > FUSED_MAX_STACK_DEPTH) {
+      ERROR_EXIT1(128, "Fused program exceeds maximum stack depth %d\n",
+                  FUSED_MAX_STACK_DEPTH);
+    }
+    if (depth > max_depth) max_depth = depth;
+    code.push_back(inst);
+  }
+
+  void FusedProgram::pushInput(int idx) {
+    if (idx < 0 || idx >= num_inputs) {
+      ERROR_EXIT2(128, "Input index out-of-bounds, found %d, expected in [0,%d)\n",
+                  idx, num_inputs);
+    }
+    Instruction inst = { OP_INPUT, idx, 0.0f };
+    pushInstruction(inst);
+  }
+
+  void FusedProgram::pushConstant(float value) {
+    Instruction inst = { OP_CONST, -1, value };
+    pushInstruction(inst);
+  }
+
+  void FusedProgram::pushOp(OpCode op) {
+    if (getArity(op) < 1) {
+      ERROR_EXIT(128, "Use pushInput or pushConstant for leaf instructions\n");
+    }
+    Instruction inst = { op, -1, 0.0f };
+    pushInstruction(inst);
+  }
+
+  float *FusedProgram::evalBlock(unsigned int n,
+                                 const float * const *inputs,
+                                 const unsigned int *strides,
+                                 float (*stack)[FUSED_BLOCK_SIZE]) const {
+    april_assert(n <= FUSED_BLOCK_SIZE);
+    int top = -1;
+    for (unsigned int k=0; k<code.size(); ++k) {
+      const Instruction &inst = code[k];
+      switch(inst.op) {
+        // leaf instructions
+      case OP_INPUT:
+        ++top;
+        loadBlock(stack[top], inputs[inst.input], strides[inst.input], n);
+        break;
+      case OP_CONST:
+        ++top;
+        for (unsigned int i=0; i<n; ++i) stack[top][i] = inst.value;
+        break;
+        // unary instructions
+      case OP_NEG: applyUnary(f_neg(), stack[top], n); break;
+      case OP_EXP: applyUnary(Functors::m_exp<float>(), stack[top], n); break;
+      case OP_EXPM1: applyUnary(Functors::m_expm1<float>(), stack[top], n); break;
+      case OP_LOG: applyUnary(Functors::m_log<float>(), stack[top], n); break;
+      case OP_LOG1P: applyUnary(Functors::m_log1p<float>(), stack[top], n); break;
+      case OP_SQRT: applyUnary(Functors::m_sqrt<float>(), stack[top], n); break;
+      case OP_SQUARE: applyUnary(f_square(), stack[top], n); break;
+      case OP_ABS: applyUnary(Functors::m_abs<float>(), stack[top], n); break;
+      case OP_SIGN: applyUnary(Functors::m_sign<float>(), stack[top], n); break;
+      case OP_INV: applyUnary(f_inv(), stack[top], n); break;
+      case OP_COMPLEMENT: applyUnary(Functors::m_complement<float>(), stack[top], n); break;
+      case OP_TANH: applyUnary(Functors::m_tanh<float>(), stack[top], n); break;
+      case OP_LOGISTIC: applyUnary(Functors::m_logistic<float>(), stack[top], n); break;
+      case OP_LOG_LOGISTIC: applyUnary(Functors::m_log_logistic<float>(), stack[top], n); break;
+      case OP_SOFTPLUS: applyUnary(Functors::m_softplus<float>(), stack[top], n); break;
+      case OP_RELU: applyUnary(Functors::m_relu<float>(), stack[top], n); break;
+      case OP_SIN: applyUnary(Functors::m_sin<float>(), stack[top], n); break;
+      case OP_COS: applyUnary(Functors::m_cos<float>(), stack[top], n); break;
+      case OP_FLOOR: applyUnary(Functors::m_floor<float>(), stack[top], n); break;
+      case OP_CEIL: applyUnary(Functors::m_ceil<float>(), stack[top], n); break;
+      case OP_ROUND: applyUnary(Functors::m_round<float>(), stack[top], n); break;
+        // binary instructions
+      case OP_ADD: applyBinary(Functors::m_add<float>(), stack[top-1], stack[top], n); --top; break;
+      case OP_SUB: applyBinary(f_sub(), stack[top-1], stack[top], n); --top; break;
+      case OP_MUL: applyBinary(Functors::m_mul<float>(), stack[top-1], stack[top], n); --top; break;
+      case OP_DIV: applyBinary(Functors::m_div<float>(), stack[top-1], stack[top], n); --top; break;
+      case OP_POW: applyBinary(f_pow(), stack[top-1], stack[top], n); --top; break;
+      case OP_MAX: applyBinary(Functors::m_max<float>(), stack[top-1], stack[top], n); --top; break;
+      case OP_MIN: applyBinary(Functors::m_min<float>(), stack[top-1], stack[top], n); --top; break;
+      case OP_LT: applyBinary(f_lt(), stack[top-1], stack[top], n); --top; break;
+      case OP_GT: applyBinary(f_gt(), stack[top-1], stack[top], n); --top; break;
+      case OP_EQ: applyBinary(f_eq(), stack[top-1], stack[top], n); --top; break;
+        // ternary instructions
+      case OP_CLAMP:
+        {
+          float *x = stack[top-2];
+          const float *lo = stack[top-1], *hi = stack[top];
+          for (unsigned int i=0; i<n; ++i) {
+            x[i] = AprilMath::m_clamp(x[i], lo[i], hi[i]);
+          }
+          top -= 2;
+        }
+        break;
+      case OP_SELECT:
+        {
+          float *cond = stack[top-2];
+          const float *a = stack[top-1], *b = stack[top];
+          for (unsigned int i=0; i<n; ++i) {
+            cond[i] = (cond[i] != 0.0f) ? a[i] : b[i];
+          }
+          top -= 2;
+        }
+        break;
+      default:
+        ERROR_EXIT1(128, "Unknown fused opcode %d\n", inst.op);
+      }
+    }
+    april_assert(top == 0);
+    return stack[0];
+  }
+
+  void FusedProgram::evalSpan(unsigned int N,
+                              const float * const *inputs,
+                              const unsigned int *strides,
+                              float *dest, unsigned int dest_stride) const {
+    if (!isValid()) ERROR_EXIT(128, "Incomplete fused program\n");
+    float stack[FUSED_MAX_STACK_DEPTH][FUSED_BLOCK_SIZE];
+    AprilUtils::UniquePtr<const float *[]> ptrs(new const float*[num_inputs+1]);
+    for (int j=0; j<num_inputs; ++j) ptrs[j] = inputs[j];
+    for (unsigned int i=0; i<N; i+=FUSED_BLOCK_SIZE) {
+      unsigned int n = AprilUtils::min(N - i, static_cast<unsigned int>(FUSED_BLOCK_SIZE));
+      const float *result = evalBlock(n, ptrs.get(), strides, stack);
+      storeBlock(dest, dest_stride, result, n);
+      dest += n*dest_stride;
+      for (int j=0; j<num_inputs; ++j) ptrs[j] += n*strides[j];
+    }
+  }
+
+  void FusedProgram::reduceSpan(unsigned int N,
+                                const float * const *inputs,
+                                const unsigned int *strides,
+                                float &acc) const {
+    if (!isValid()) ERROR_EXIT(128, "Incomplete fused program\n");
+    if (!isReduction()) ERROR_EXIT(128, "Fused program without reduction\n");
+    float stack[FUSED_MAX_STACK_DEPTH][FUSED_BLOCK_SIZE];
+    AprilUtils::UniquePtr<const float *[]> ptrs(new const float*[num_inputs+1]);
+    for (int j=0; j<num_inputs; ++j) ptrs[j] = inputs[j];
+    for (unsigned int i=0; i<N; i+=FUSED_BLOCK_SIZE) {
+      unsigned int n = AprilUtils::min(N - i, static_cast<unsigned int>(FUSED_BLOCK_SIZE));
+      const float *result = evalBlock(n, ptrs.get(), strides, stack);
+      switch(reduction) {
+      case REDUCE_SUM:
+        for (unsigned int k=0; k<n; ++k) r_add(acc, result[k]);
+        break;
+      case REDUCE_PROD:
+        for (unsigned int k=0; k<n; ++k) r_mul(acc, result[k]);
+        break;
+      case REDUCE_MAX:
+        for (unsigned int k=0; k<n; ++k) r_max(acc, result[k]);
+        break;
+      case REDUCE_MIN:
+        for (unsigned int k=0; k<n; ++k) r_min(acc, result[k]);
+        break;
+      default:
+        ;
+      }
+      for (int j=0; j<num_inputs; ++j) ptrs[j] += n*strides[j];
+    }
+  }
+
+  void FusedProgram::reducePartials(float &acc, const float other) const {
+    switch(reduction) {
+    case REDUCE_SUM:  r_add(acc, other); break;
+    case REDUCE_PROD: r_mul(acc, other); break;
+    case REDUCE_MAX:  r_max(acc, other); break;
+    case REDUCE_MIN:  r_min(acc, other); break;
+    default:
+      ;
+    }
+  }
+
+} // namespace AprilMath
@@ -0,0 +1,180 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef FUSED_PROGRAM_H
+#define FUSED_PROGRAM_H
+
+#include "disallow_class_methods.h"
+#include "gpu_mirrored_memory_block.h"
+#include "referenced.h"
+#include "vector.h"
+
+/// Number of elements evaluated together by FusedProgram instructions.
+#define FUSED_BLOCK_SIZE 256
+/// Maximum depth of the evaluation stack of a FusedProgram.
+#define FUSED_MAX_STACK_DEPTH 16
+
+namespace AprilMath {
+
+  /**
+   * @brief A lazy element-wise expression compiled into a small stack machine.
+   *
+   * A FusedProgram represents a chain of map operations (and optionally a
+   * trailing reduction) over a fixed number of inputs. Instead of traversing
+   * the memory once per operation, as happens when chaining genericMap1Call,
+   * genericMap2Call, ..., the program is evaluated over blocks of
+   * FUSED_BLOCK_SIZE elements which fit in L1 cache, so the whole chain costs
+   * only one memory pass over inputs and output.
+   *
+   * The program is written in postfix notation:
+   *
+   * @code
+   * // computes (a - 0.1*b)^2 and sums all the values
+   * AprilUtils::SharedPtr<FusedProgram> prog = new FusedProgram(2);
+   * prog->pushInput(0);
+   * prog->pushConstant(0.1f);
+   * prog->pushInput(1);
+   * prog->pushOp(FusedProgram::OP_MUL);
+   * prog->pushOp(FusedProgram::OP_SUB);
+   * prog->pushOp(FusedProgram::OP_SQUARE);
+   * prog->setReduction(FusedProgram::REDUCE_SUM);
+   * @endcode
+   *
+   * @note Only float data is supported, and evaluation is always done in
+   * host memory (CUDA memory blocks are synchronized before the evaluation).
+   *
+   * @see AprilMath::MatrixExt::Fused for matrix-level traversal functions.
+   */
+  class FusedProgram : public Referenced {
+    APRIL_DISALLOW_COPY_AND_ASSIGN(FusedProgram);
+  public:
+    /// Instruction codes, classified by their arity.
+    enum OpCode {
+      // leaf instructions
+      OP_INPUT=0, OP_CONST,
+      // unary instructions
+      OP_NEG, OP_EXP, OP_EXPM1, OP_LOG, OP_LOG1P, OP_SQRT, OP_SQUARE,
+      OP_ABS, OP_SIGN, OP_INV, OP_COMPLEMENT, OP_TANH, OP_LOGISTIC,
+      OP_LOG_LOGISTIC, OP_SOFTPLUS, OP_RELU, OP_SIN, OP_COS,
+      OP_FLOOR, OP_CEIL, OP_ROUND,
+      // binary instructions
+      OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW, OP_MAX, OP_MIN, OP_LT, OP_GT,
+      OP_EQ,
+      // ternary instructions
+      OP_CLAMP, OP_SELECT,
+      // sentinel
+      OP_NUM_OPCODES
+    };
+
+    /// Trailing reduction codes.
+    enum ReduceCode {
+      REDUCE_NONE=0, REDUCE_SUM, REDUCE_PROD, REDUCE_MAX, REDUCE_MIN
+    };
+
+    /// An instruction of the stack machine.
+    struct Instruction {
+      OpCode op;    ///< The operation code.
+      int    input; ///< Index of the input for OP_INPUT instructions.
+      float  value; ///< Constant value for OP_CONST instructions.
+    };
+
+    /// Builds an empty program which receives the given number of inputs.
+    FusedProgram(int num_inputs);
+    virtual ~FusedProgram();
+
+    /// Pushes the value of the given input (0-indexed) into the stack.
+    void pushInput(int idx);
+    /// Pushes a constant value into the stack.
+    void pushConstant(float value);
+    /// Pushes an unary, binary or ternary operation.
+    void pushOp(OpCode op);
+    /// Sets the trailing reduction of the program, REDUCE_NONE by default.
+    void setReduction(ReduceCode red) { reduction = red; }
+
+    /// Returns the arity of the given opcode, 0 for leaf instructions.
+    static int getArity(OpCode op);
+    /// Returns the opcode of the given name, or OP_NUM_OPCODES if not found.
+    static OpCode getOpCodeFromString(const char *name);
+    /// Returns the reduce code of the given name, or -1 if not found.
+    static int getReduceCodeFromString(const char *name);
+    /// Returns the neutral value of the given reduce code.
+    static float getReduceZero(ReduceCode red);
+
+    int getNumInputs() const { return num_inputs; }
+    int getNumInstructions() const { return static_cast<int>(code.size()); }
+    ReduceCode getReduction() const { return reduction; }
+    bool isReduction() const { return reduction != REDUCE_NONE; }
+    /// Indicates if the program is complete (it leaves only one value).
+    bool isValid() const { return depth == 1; }
+
+    /**
+     * @brief Evaluates the program over strided input spans and writes the
+     * result into a strided output span.
+     *
+     * @param N - Number of elements of every span.
+     * @param inputs - An array with getNumInputs() pointers, the first
+     * element of every span.
+     * @param strides - An array with getNumInputs() strides.
+     * @param dest - Pointer to the first element of the output span.
+     * @param dest_stride - The stride of the output span.
+     *
+     * @note @c dest can be equal to any of the inputs.
+     */
+    void evalSpan(unsigned int N,
+                  const float * const *inputs,
+                  const unsigned int *strides,
+                  float *dest, unsigned int dest_stride) const;
+
+    /**
+     * @brief Evaluates the program over strided input spans and reduces the
+     * result using the program trailing reduction.
+     *
+     * @param N - Number of elements of every span.
+     * @param inputs - An array with getNumInputs() pointers, the first
+     * element of every span.
+     * @param strides - An array with getNumInputs() strides.
+     * @param[in,out] acc - The accumulator where values are reduced.
+     */
+    void reduceSpan(unsigned int N,
+                    const float * const *inputs,
+                    const unsigned int *strides,
+                    float &acc) const;
+
+    /// Reduces two partial results using the trailing reduction.
+    void reducePartials(float &acc, const float other) const;
+
+  private:
+    const int num_inputs;
+    AprilUtils::vector<Instruction> code;
+    ReduceCode reduction;
+    int depth;     ///< Depth of the stack after the last instruction.
+    int max_depth; ///< Maximum stack depth needed by the program.
+
+    void pushInstruction(const Instruction &inst);
+    /// Evaluates the program over a block of at most FUSED_BLOCK_SIZE elements.
+    float *evalBlock(unsigned int n,
+                     const float * const *inputs,
+                     const unsigned int *strides,
+                     float (*stack)[FUSED_BLOCK_SIZE]) const;
+  }; // class FusedProgram
+
+} // namespace AprilMath
+
+#endif // FUSED_PROGRAM_H
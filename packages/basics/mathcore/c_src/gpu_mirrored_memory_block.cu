@@ -26,15 +26,6 @@ namespace AprilMath {
   bool   GPUMirroredMemoryBlockBase::use_mmap_allocation = false;
   bool   GPUMirroredMemoryBlockBase::USE_CUDA_DEFAULT = false;
 
-#ifndef NO_POOL
-  size_t GPUMirroredMemoryBlockBase::MAX_POOL_LIST_SIZE = 200*1024*1024; // 200 Megabytes
-  size_t GPUMirroredMemoryBlockBase::MIN_MEMORY_TH_IN_POOL = 20; // 20 bytes
-  GPUMirroredMemoryBlockBase::PoolFreeBeforeExit GPUMirroredMemoryBlockBase::pool_free_before_exit;
-  size_t GPUMirroredMemoryBlockBase::pool_size = 0;
-  GPUMirroredMemoryBlockBase::PoolType *GPUMirroredMemoryBlockBase::pool_lists =
-    new GPUMirroredMemoryBlockBase::PoolType(1024);
-#endif
-
   template<>
   const char *GPUMirroredMemoryBlock<char>::luaCtorName() const {
     return "mathcore.block.char.read";
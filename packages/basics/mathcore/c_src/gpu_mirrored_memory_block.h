@@ -22,12 +22,9 @@
 #ifndef GPU_MIRRORED_MEMORY_BLOCK_H
 #define GPU_MIRRORED_MEMORY_BLOCK_H
 
-// Define NO_POOL to avoid the use of a pool of pointers
+// Define NO_POOL to avoid the use of the thread-local memory arena
 // #define NO_POOL
 
-// Define POOL_DEBUG for verbose debug printf's
-// #define POOL_DEBUG
-
 #include <cstring>
 #include <cstdio>
 extern "C" {
@@ -53,9 +50,7 @@ extern "C" {
 #include "smart_ptr.h"
 
 #ifndef NO_POOL
-#include "hash_table.h"
-#include "aux_hash_table.h"
-#include "list.h"
+#include "memory_arena.h"
 #endif
 
 #define PPAL_MASK  0x01 // bit 0 = 1
@@ -70,7 +65,7 @@ namespace AprilMath {
    * @brief Class base for memory blocks mirrored between host (mem ppal) and
    * device (GPU).
    *
-   * This base defines a generic which keeps a pool of memory pointers, stores the
+   * This base defines a generic which reuses memory through MemoryArena, stores the
    * mem ppal pointer and the device pointer, and updates the status of this
    * pointers. This class does not know pointers type, it works with generic void*
    * or char* pointers. Therefore, the size property stores the number of
@@ -80,38 +75,12 @@ namespace AprilMath {
    */
   class GPUMirroredMemoryBlockBase : public Referenced {
   public:
-#ifndef NO_POOL
-    typedef AprilUtils::list<char*>                PoolListType;
-    typedef AprilUtils::hash<size_t, PoolListType> PoolType;
-#endif
     static bool USE_CUDA_DEFAULT;
     
   private:
     static bool use_mmap_allocation;
     
   protected:
-#ifndef NO_POOL
-    static size_t MAX_POOL_LIST_SIZE;
-    static size_t MIN_MEMORY_TH_IN_POOL;
-    static size_t pool_size;
-    static PoolType *pool_lists;
-    /// Auxiliary class for free of memory pool
-    class PoolFreeBeforeExit {
-    public:
-      PoolFreeBeforeExit() { }
-      ~PoolFreeBeforeExit() {
-        for (PoolType::iterator it = pool_lists->begin();
-             it != pool_lists->end(); ++it) {
-          for (PoolListType::iterator lit = it->second.begin();
-               lit != it->second.end(); ++lit) {
-            AprilUtils::aligned_free(*lit);
-          }
-        }
-        delete pool_lists;
-      }
-    };
-    static PoolFreeBeforeExit pool_free_before_exit;
-#endif
     const size_t size;
     union {
       char *char_mem;
@@ -357,6 +326,25 @@ namespace AprilMath {
 #endif
     }
 
+    /// Wraps sz bytes from the current position of a raw mmapped file.
+    GPUMirroredMemoryBlockBase(AprilUtils::MMappedDataReader *mmapped_data,
+                               size_t sz) :
+      Referenced(),
+      size(sz),
+      mmapped_data(mmapped_data) {
+      this->char_mem = mmapped_data->get<char>(this->size);
+      this->status = 0;
+      this->setMMapped();
+      // read-only mappings would crash at first write
+      if (!mmapped_data->isWritable()) this->setConst();
+#ifdef USE_CUDA
+      this->unsetUpdatedGPU();
+      this->setUpdatedPPAL();
+      this->mem_gpu = 0;
+      this->pinned  = false;
+#endif
+    }
+
     GPUMirroredMemoryBlockBase(size_t sz,
                                void *mem) : Referenced(), size(sz),
                                             mem_ppal(mem) {
@@ -393,36 +381,12 @@ namespace AprilMath {
       mem_gpu  = 0;
       pinned   = false;
 #endif
+      if (!use_mmap_allocation) {
 #ifndef NO_POOL
-      PoolListType &l = (*pool_lists)[size];
-      if (l.empty() || use_mmap_allocation) {
-        if (!use_mmap_allocation) {
-          char_mem = AprilUtils::aligned_malloc<char>(size);
-#ifdef POOL_DEBUG
-          printf("ALLOC %lu :: %p\n", size, char_mem);
-#endif
-        }
-        else {
-          setMMapped();
-          mem_ppal = (void*)mmap(NULL, sz,
-                                 PROT_READ | PROT_WRITE, MAP_ANON | MAP_SHARED,
-                                 -1, 0);
-          if (mem_ppal == MAP_FAILED)
-            ERROR_EXIT1(128, "Impossible to open required mmap memory: %s\n",
-                        strerror(errno));
-        }
-      }
-      else {
-        mem_ppal = *(l.begin());
-        l.pop_front();
-        pool_size -= size;
-#ifdef POOL_DEBUG
-        printf("POP %lu :: %p\n", size, mem_ppal);
-#endif
-      }
+        char_mem = MemoryArena::allocate(size);
 #else
-      if (!use_mmap_allocation) {
         char_mem = AprilUtils::aligned_malloc<char>(size);
+#endif
       }
       else {
         setMMapped();
@@ -433,7 +397,6 @@ namespace AprilMath {
           ERROR_EXIT1(128, "Impossible to open required mmap memory: %s\n",
                       strerror(errno));
       }
-#endif
     }
   
     virtual ~GPUMirroredMemoryBlockBase() {
@@ -448,20 +411,7 @@ namespace AprilMath {
         if (isAllocated()) {
           if (!isMMapped()) {
 #ifndef NO_POOL
-            PoolListType &l = (*pool_lists)[size];
-            if (pool_size + size <= MAX_POOL_LIST_SIZE && size >= MIN_MEMORY_TH_IN_POOL) {
-              pool_size += size;
-              l.push_front(char_mem);
-#ifdef POOL_DEBUG
-              printf("PUSH %lu :: %p\n", size, char_mem);
-#endif
-            }
-            else {
-#ifdef POOL_DEBUG
-              printf("FREE %lu :: %p\n", size, char_mem);
-#endif
-              AprilUtils::aligned_free(char_mem);
-            }
+            MemoryArena::release(char_mem, size);
 #else
             AprilUtils::aligned_free(char_mem);
 #endif
@@ -481,20 +431,7 @@ namespace AprilMath {
       if (isAllocated()) {
         if (!isMMapped()) {
 #ifndef NO_POOL
-          PoolListType &l = (*pool_lists)[size];
-          if (pool_size+size <= MAX_POOL_LIST_SIZE && size >= MIN_MEMORY_TH_IN_POOL) {
-            pool_size += size;
-            l.push_front(char_mem);
-#ifdef POOL_DEBUG
-            printf("PUSH %lu :: %p\n", size, char_mem);
-#endif
-          }
-          else {
-#ifdef POOL_DEBUG
-            printf("FREE %lu :: %p\n", size, char_mem);
-#endif
-            AprilUtils::aligned_free(char_mem);
-          }
+          MemoryArena::release(char_mem, size);
 #else
           AprilUtils::aligned_free(char_mem);
 #endif
@@ -568,8 +505,7 @@ namespace AprilMath {
 
 #ifndef NO_POOL
     static void changeMaxPoolSize(size_t max_pool_size) {
-      MAX_POOL_LIST_SIZE = max_pool_size;
-      // TODO: free pool memory if necessary
+      MemoryArena::setMaxHeldSize(max_pool_size);
     }
 #endif
   };
@@ -587,6 +523,10 @@ namespace AprilMath {
     
     GPUMirroredMemoryBlock(AprilUtils::MMappedDataReader *mmapped_data) :
       GPUMirroredMemoryBlockBase(mmapped_data) { }
+
+    GPUMirroredMemoryBlock(AprilUtils::MMappedDataReader *mmapped_data,
+                           unsigned int sz) :
+      GPUMirroredMemoryBlockBase(mmapped_data, sz*sizeof(T)) { }
   
     T *getPointer() {
       union {
@@ -619,6 +559,13 @@ namespace AprilMath {
     fromMMappedDataReader(AprilUtils::MMappedDataReader *mmapped_data) {
       return new GPUMirroredMemoryBlock<T>(mmapped_data);
     }
+
+    /// Wraps sz elements stored as raw data at the current reader position.
+    static GPUMirroredMemoryBlock<T> *
+    fromMMappedDataReader(AprilUtils::MMappedDataReader *mmapped_data,
+                          unsigned int sz) {
+      return new GPUMirroredMemoryBlock<T>(mmapped_data, sz);
+    }
     
     /// Constructor from non-allocated memory, does not free mem pointer.
     GPUMirroredMemoryBlock(unsigned int sz, T *mem) :
@@ -25,6 +25,7 @@
 #include "cuda_kernel_templates.h"
 #include "cuda_utils.h"
 #include "gpu_mirrored_memory_block.h"
+#include "simd_kernels.h"
 
 namespace AprilMath {
     
@@ -52,9 +53,13 @@ namespace AprilMath {
 #endif
       const T *input_mem = input->getPPALForRead() + input_shift;
       O *output_mem = output->getPPALForWrite() + output_shift;
-      for (unsigned int i=0; i<N; ++i,
-             input_mem+=input_stride, output_mem+=output_stride) {
-        *output_mem = map_op(*input_mem);
+      // contiguous vectors use explicit SIMD kernels when available
+      if (input_stride != 1u || output_stride != 1u ||
+          !SIMD::Map1Kernel<T,O,F>::apply(N, input_mem, output_mem)) {
+        for (unsigned int i=0; i<N; ++i,
+               input_mem+=input_stride, output_mem+=output_stride) {
+          *output_mem = map_op(*input_mem);
+        }
       }
 #ifdef USE_CUDA
     }
@@ -90,11 +95,16 @@ namespace AprilMath {
       const T1 *input1_mem = input1->getPPALForRead() + input1_shift;
       const T2 *input2_mem = input2->getPPALForRead() + input2_shift;
       O *output_mem = output->getPPALForWrite() + output_shift;
-      for (unsigned int i=0; i<N; ++i,
-             output_mem+=output_stride,
-             input1_mem+=input1_stride,
-             input2_mem+=input2_stride) {
-        *output_mem = map_op(*input1_mem, *input2_mem);
+      // contiguous vectors use explicit SIMD kernels when available
+      if (input1_stride != 1u || input2_stride != 1u || output_stride != 1u ||
+          !SIMD::Map2Kernel<T1,T2,O,F>::apply(N, input1_mem, input2_mem,
+                                              output_mem)) {
+        for (unsigned int i=0; i<N; ++i,
+               output_mem+=output_stride,
+               input1_mem+=input1_stride,
+               input2_mem+=input2_stride) {
+          *output_mem = map_op(*input1_mem, *input2_mem);
+        }
       }
 #ifdef USE_CUDA
     }
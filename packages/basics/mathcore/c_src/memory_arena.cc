@@ -0,0 +1,250 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+extern "C" {
+#include <pthread.h>
+}
+#include <cstring>
+
+#include "aligned_memory.h"
+#include "error_print.h"
+#include "memory_arena.h"
+
+namespace AprilMath {
+
+  namespace MemoryArena {
+
+    namespace {
+      /// Smallest size class, it is enough to store the free list pointer.
+      const size_t MIN_CLASS_SIZE = 64u;
+      const unsigned int MIN_CLASS_BITS = 6u;
+      /// Buffers larger than 2^MAX_CLASS_BITS bytes are not kept.
+      const unsigned int MAX_CLASS_BITS = 30u;
+      /// Four classes for every power of two, plus the smallest one.
+      const size_t NUM_CLASSES = (MAX_CLASS_BITS - MIN_CLASS_BITS)*4u + 1u;
+      const size_t DEFAULT_MAX_HELD_SIZE = 200u*1024u*1024u; // 200 Megabytes
+
+      /// Free lists and counters of one thread.
+      struct ThreadArena {
+        /// The first bytes of every free buffer point to the next one.
+        char *free_lists[NUM_CLASSES];
+        size_t bytes_held, hits, misses, releases;
+        ThreadArena *prev, *next;
+      };
+
+      // The registry of arenas is only used to aggregate stats, allocation
+      // and release only touch the arena of the calling thread.
+      pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+      ThreadArena *registry = 0;
+      pthread_key_t arena_key;
+      pthread_once_t arena_key_once = PTHREAD_ONCE_INIT;
+      size_t max_held_size = DEFAULT_MAX_HELD_SIZE;
+      /// After process exit buffers go directly to the system allocator.
+      bool finished = false;
+
+      // Counters are written only by their owner thread, but they are read
+      // by getStats() from any thread.
+      inline size_t loadCounter(const size_t &c) {
+        return __atomic_load_n(&c, __ATOMIC_RELAXED);
+      }
+
+      inline void storeCounter(size_t &c, size_t v) {
+        __atomic_store_n(&c, v, __ATOMIC_RELAXED);
+      }
+
+      inline unsigned int highestBit(size_t v) {
+        unsigned int p = 0u;
+        while (v >>= 1) ++p;
+        return p;
+      }
+
+      /// Returns false for sizes which are not kept in free lists.
+      bool computeSizeClass(size_t sz, size_t &idx, size_t &class_size) {
+        if (sz <= MIN_CLASS_SIZE) {
+          idx = 0u;
+          class_size = MIN_CLASS_SIZE;
+          return true;
+        }
+        if (sz > (static_cast<size_t>(1u) << MAX_CLASS_BITS)) {
+          idx = NUM_CLASSES;
+          class_size = sz;
+          return false;
+        }
+        // four steps between 2^p and 2^(p+1)
+        unsigned int p = highestBit(sz - 1u);
+        unsigned int shift = p - 2u;
+        size_t k = (sz + (static_cast<size_t>(1u) << shift) - 1u) >> shift;
+        idx = (p - MIN_CLASS_BITS)*4u + (k - 4u);
+        class_size = k << shift;
+        return true;
+      }
+
+      void freeLists(ThreadArena *arena) {
+        for (size_t i=0; i<NUM_CLASSES; ++i) {
+          char *ptr = arena->free_lists[i];
+          while (ptr != 0) {
+            char *next = *reinterpret_cast<char**>(ptr);
+            AprilUtils::aligned_free(ptr);
+            ptr = next;
+          }
+          arena->free_lists[i] = 0;
+        }
+        storeCounter(arena->bytes_held, 0u);
+      }
+
+      void destroyArena(void *ptr) {
+        ThreadArena *arena = static_cast<ThreadArena*>(ptr);
+        freeLists(arena);
+        pthread_mutex_lock(&registry_mutex);
+        if (arena->prev != 0) arena->prev->next = arena->next;
+        else registry = arena->next;
+        if (arena->next != 0) arena->next->prev = arena->prev;
+        pthread_mutex_unlock(&registry_mutex);
+        delete arena;
+      }
+
+      void createArenaKey() {
+        if (pthread_key_create(&arena_key, destroyArena) != 0) {
+          ERROR_EXIT(128, "Unable to create thread-local memory arena\n");
+        }
+      }
+
+      ThreadArena *getArena() {
+        pthread_once(&arena_key_once, createArenaKey);
+        ThreadArena *arena =
+          static_cast<ThreadArena*>(pthread_getspecific(arena_key));
+        if (arena == 0) {
+          arena = new ThreadArena(); // value-initialized, all zeros
+          pthread_setspecific(arena_key, arena);
+          pthread_mutex_lock(&registry_mutex);
+          arena->next = registry;
+          if (registry != 0) registry->prev = arena;
+          registry = arena;
+          pthread_mutex_unlock(&registry_mutex);
+        }
+        return arena;
+      }
+
+      char *systemAllocate(size_t sz) {
+        char *ptr = AprilUtils::aligned_malloc<char>(sz);
+        if (ptr == 0) {
+          ERROR_EXIT1(128, "Unable to allocate %lu bytes\n",
+                      static_cast<unsigned long>(sz));
+        }
+        return ptr;
+      }
+
+      /// Releases held memory before exit.
+      class ArenaFinalizer {
+      public:
+        ~ArenaFinalizer() {
+          pthread_mutex_lock(&registry_mutex);
+          for (ThreadArena *arena = registry; arena != 0; arena = arena->next) {
+            freeLists(arena);
+          }
+          finished = true;
+          pthread_mutex_unlock(&registry_mutex);
+        }
+      };
+      ArenaFinalizer arena_finalizer;
+    } // anonymous namespace
+
+    char *allocate(size_t sz) {
+      size_t idx, class_size;
+      if (!computeSizeClass(sz, idx, class_size) || finished) {
+        return systemAllocate(class_size);
+      }
+      ThreadArena *arena = getArena();
+      char *ptr = arena->free_lists[idx];
+      if (ptr != 0) {
+        arena->free_lists[idx] = *reinterpret_cast<char**>(ptr);
+        storeCounter(arena->bytes_held,
+                     loadCounter(arena->bytes_held) - class_size);
+        storeCounter(arena->hits, loadCounter(arena->hits) + 1u);
+        return ptr;
+      }
+      storeCounter(arena->misses, loadCounter(arena->misses) + 1u);
+      return systemAllocate(class_size);
+    }
+
+    void release(char *ptr, size_t sz) {
+      size_t idx, class_size;
+      if (!computeSizeClass(sz, idx, class_size) || finished) {
+        AprilUtils::aligned_free(ptr);
+        return;
+      }
+      ThreadArena *arena = getArena();
+      storeCounter(arena->releases, loadCounter(arena->releases) + 1u);
+      size_t bytes_held = loadCounter(arena->bytes_held) + class_size;
+      if (bytes_held > getMaxHeldSize()) {
+        AprilUtils::aligned_free(ptr);
+        return;
+      }
+      *reinterpret_cast<char**>(ptr) = arena->free_lists[idx];
+      arena->free_lists[idx] = ptr;
+      storeCounter(arena->bytes_held, bytes_held);
+    }
+
+    size_t getSizeClass(size_t sz) {
+      size_t idx, class_size;
+      computeSizeClass(sz, idx, class_size);
+      return class_size;
+    }
+
+    size_t getMaxHeldSize() {
+      return loadCounter(max_held_size);
+    }
+
+    void setMaxHeldSize(size_t value) {
+      storeCounter(max_held_size, value);
+    }
+
+    Stats getStats() {
+      Stats stats;
+      memset(&stats, 0, sizeof(Stats));
+      pthread_mutex_lock(&registry_mutex);
+      for (ThreadArena *arena = registry; arena != 0; arena = arena->next) {
+        stats.hits       += loadCounter(arena->hits);
+        stats.misses     += loadCounter(arena->misses);
+        stats.releases   += loadCounter(arena->releases);
+        stats.bytes_held += loadCounter(arena->bytes_held);
+        ++stats.threads;
+      }
+      pthread_mutex_unlock(&registry_mutex);
+      return stats;
+    }
+
+    void resetStats() {
+      pthread_mutex_lock(&registry_mutex);
+      for (ThreadArena *arena = registry; arena != 0; arena = arena->next) {
+        storeCounter(arena->hits, 0u);
+        storeCounter(arena->misses, 0u);
+        storeCounter(arena->releases, 0u);
+      }
+      pthread_mutex_unlock(&registry_mutex);
+    }
+
+    void clear() {
+      if (!finished) freeLists(getArena());
+    }
+
+  } // namespace MemoryArena
+
+} // namespace AprilMath
@@ -0,0 +1,80 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef MEMORY_ARENA_H
+#define MEMORY_ARENA_H
+
+#include <cstddef>
+
+namespace AprilMath {
+
+  /**
+   * @brief Thread-local size-class arena for host memory of memory blocks.
+   *
+   * Requested sizes are rounded up to size classes with four steps between
+   * consecutive powers of two (as jemalloc does), so at most 25% of memory is
+   * wasted and buffers of similar sizes are reused. Released buffers are kept
+   * in free lists of the calling thread, so allocation and release don't need
+   * any lock. Every thread holds at most getMaxHeldSize() bytes, the rest is
+   * returned to the system.
+   *
+   * @note Buffers can be released from a thread different than the one which
+   * allocated them, they go to the free lists of the releasing thread.
+   */
+  namespace MemoryArena {
+
+    /// Counters of the arena, aggregated for all threads.
+    struct Stats {
+      size_t hits;       ///< Allocations served from free lists.
+      size_t misses;     ///< Allocations which needed the system allocator.
+      size_t releases;   ///< Buffers given back to the arena.
+      size_t bytes_held; ///< Bytes kept in free lists.
+      size_t threads;    ///< Number of threads with an arena.
+    };
+
+    /// Returns a buffer of at least sz bytes, aligned as aligned_malloc does.
+    char *allocate(size_t sz);
+
+    /// Returns to the arena a buffer obtained by allocate(sz).
+    void release(char *ptr, size_t sz);
+
+    /// Returns the number of bytes really reserved for a request of sz bytes.
+    size_t getSizeClass(size_t sz);
+
+    /// Maximum number of bytes held by each thread free lists.
+    size_t getMaxHeldSize();
+
+    /// Changes the maximum number of bytes held by each thread free lists.
+    void setMaxHeldSize(size_t max_held_size);
+
+    /// Aggregates the counters of all threads.
+    Stats getStats();
+
+    /// Sets to zero hits, misses and releases counters of all threads.
+    void resetStats();
+
+    /// Frees all the buffers held by the calling thread.
+    void clear();
+
+  } // namespace MemoryArena
+
+} // namespace AprilMath
+
+#endif // MEMORY_ARENA_H
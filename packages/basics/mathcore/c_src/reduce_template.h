@@ -26,6 +26,7 @@
 #include "cuda_kernel_templates.h"
 #include "cuda_utils.h"
 #include "gpu_mirrored_memory_block.h"
+#include "simd_kernels.h"
 
 namespace AprilMath {
 
@@ -97,8 +98,12 @@ namespace AprilMath {
       else {
         dest_ptr = dest->getPPALForReadAndWrite() + dest_shift;
       }
-      for (unsigned int i=0; i<N; ++i, v_mem+=input_stride) {
-        reduce_op(*dest_ptr, *v_mem);
+      // contiguous vectors use explicit SIMD kernels when available
+      if (input_stride != 1u ||
+          !SIMD::Reduce1Kernel<T,O,F>::apply(N, v_mem, *dest_ptr)) {
+        for (unsigned int i=0; i<N; ++i, v_mem+=input_stride) {
+          reduce_op(*dest_ptr, *v_mem);
+        }
       }
 #ifdef USE_CUDA
     }
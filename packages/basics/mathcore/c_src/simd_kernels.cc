@@ -0,0 +1,442 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include <cfloat>
+#include <cstring>
+
+#include "cmath_overloads.h"
+#include "simd_kernels.h"
+
+#if !defined(NO_SIMD) && defined(__GNUC__) && \
+  (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+#if !defined(NO_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#define SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace AprilMath {
+
+  namespace SIMD {
+
+    namespace {
+
+      /// Function pointers to the kernels of one instruction set.
+      struct KernelTable {
+        void (*exp)(unsigned int, const float *, float *);
+        void (*log)(unsigned int, const float *, float *);
+        void (*logistic)(unsigned int, const float *, float *);
+        void (*tanh)(unsigned int, const float *, float *);
+        void (*add)(unsigned int, const float *, const float *, float *);
+        void (*mul)(unsigned int, const float *, const float *, float *);
+        void (*max)(unsigned int, const float *, const float *, float *);
+        void (*sum)(unsigned int, const float *, float &);
+        void (*max_reduce)(unsigned int, const float *, float &);
+        void (*affine)(unsigned int, const float *, float, float, float *);
+        void (*dot)(unsigned int, const float *, const float *, float &);
+        void (*exp_sum)(unsigned int, const float *, float, float *, float &);
+        void (*sq_distances)(unsigned int, unsigned int, const float *,
+                             unsigned int, const float *, float *);
+      };
+
+      //////////////////////////////////////////////////////////////////////
+
+      /// Scalar kernels, used when no instruction set is available.
+      namespace KernelsScalar {
+
+        void kernelExp(unsigned int N, const float *x, float *y) {
+          for (unsigned int i=0; i<N; ++i) y[i] = AprilMath::m_exp(x[i]);
+        }
+
+        void kernelLog(unsigned int N, const float *x, float *y) {
+          for (unsigned int i=0; i<N; ++i) y[i] = AprilMath::m_log(x[i]);
+        }
+
+        void kernelLogistic(unsigned int N, const float *x, float *y) {
+          for (unsigned int i=0; i<N; ++i) y[i] = AprilMath::m_logistic(x[i]);
+        }
+
+        void kernelTanh(unsigned int N, const float *x, float *y) {
+          for (unsigned int i=0; i<N; ++i) y[i] = AprilMath::m_tanh(x[i]);
+        }
+
+        void kernelAdd(unsigned int N, const float *a, const float *b,
+                       float *y) {
+          for (unsigned int i=0; i<N; ++i) y[i] = a[i] + b[i];
+        }
+
+        void kernelMul(unsigned int N, const float *a, const float *b,
+                       float *y) {
+          for (unsigned int i=0; i<N; ++i) y[i] = a[i] * b[i];
+        }
+
+        void kernelMax(unsigned int N, const float *a, const float *b,
+                       float *y) {
+          for (unsigned int i=0; i<N; ++i) y[i] = AprilMath::m_max(a[i], b[i]);
+        }
+
+        void kernelSum(unsigned int N, const float *x, float &acc) {
+          for (unsigned int i=0; i<N; ++i) acc += x[i];
+        }
+
+        void kernelMaxReduce(unsigned int N, const float *x, float &acc) {
+          for (unsigned int i=0; i<N; ++i) if (acc < x[i]) acc = x[i];
+        }
+
+        void kernelAffine(unsigned int N, const float *x, float a, float b,
+                          float *y) {
+          for (unsigned int i=0; i<N; ++i) y[i] = a*x[i] + b;
+        }
+
+        void kernelDot(unsigned int N, const float *a, const float *b,
+                       float &acc) {
+          for (unsigned int i=0; i<N; ++i) acc += a[i] * b[i];
+        }
+
+        void kernelExpSum(unsigned int N, const float *x, float shift,
+                          float *y, float &acc) {
+          for (unsigned int i=0; i<N; ++i) {
+            float e = AprilMath::m_exp(x[i] - shift);
+            if (y != 0) y[i] = e;
+            acc += e;
+          }
+        }
+
+        void kernelSqDistances(unsigned int N, unsigned int D,
+                               const float *x, unsigned int ld,
+                               const float *q, float *y) {
+          for (unsigned int j=0; j<N; ++j) {
+            float acc = 0.0f;
+            for (unsigned int d=0; d<D; ++d) {
+              float diff = x[d*ld + j] - q[d];
+              acc += diff * diff;
+            }
+            y[j] = acc;
+          }
+        }
+
+        const KernelTable KERNELS = {
+          kernelExp, kernelLog, kernelLogistic, kernelTanh,
+          kernelAdd, kernelMul, kernelMax,
+          kernelSum, kernelMaxReduce,
+          kernelAffine, kernelDot, kernelExpSum,
+          kernelSqDistances,
+        };
+
+      } // namespace KernelsScalar
+
+      //////////////////////////////////////////////////////////////////////
+
+#ifdef SIMD_X86
+      /// AVX2+FMA kernels, 8 floats per vector.
+      namespace KernelsAVX2 {
+#define SIMD_TARGET __attribute__((target("avx2,fma")))
+#define SIMD_WIDTH 8u
+        typedef __m256  vfloat;
+        typedef __m256i vint;
+        typedef __m256  vmask;
+        SIMD_TARGET static inline vfloat vload(const float *p) { return _mm256_loadu_ps(p); }
+        SIMD_TARGET static inline void vstore(float *p, vfloat v) { _mm256_storeu_ps(p, v); }
+        SIMD_TARGET static inline vfloat vset1(float v) { return _mm256_set1_ps(v); }
+        SIMD_TARGET static inline vint viset1(int v) { return _mm256_set1_epi32(v); }
+        SIMD_TARGET static inline vfloat vadd(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+        SIMD_TARGET static inline vfloat vsub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+        SIMD_TARGET static inline vfloat vmul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+        SIMD_TARGET static inline vfloat vdiv(vfloat a, vfloat b) { return _mm256_div_ps(a, b); }
+        /// a*b + c
+        SIMD_TARGET static inline vfloat vfma(vfloat a, vfloat b, vfloat c) { return _mm256_fmadd_ps(a, b, c); }
+        /// (a<b) ? b : a, as AprilMath::m_max
+        SIMD_TARGET static inline vfloat vmax(vfloat a, vfloat b) { return _mm256_max_ps(b, a); }
+        SIMD_TARGET static inline vfloat vmin(vfloat a, vfloat b) { return _mm256_min_ps(a, b); }
+        SIMD_TARGET static inline vfloat vround(vfloat a) {
+          return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        }
+        SIMD_TARGET static inline vint vcvti(vfloat a) { return _mm256_cvtps_epi32(a); }
+        SIMD_TARGET static inline vfloat vcvtf(vint a) { return _mm256_cvtepi32_ps(a); }
+        SIMD_TARGET static inline vint vcasti(vfloat a) { return _mm256_castps_si256(a); }
+        SIMD_TARGET static inline vfloat vcastf(vint a) { return _mm256_castsi256_ps(a); }
+        SIMD_TARGET static inline vint viadd(vint a, vint b) { return _mm256_add_epi32(a, b); }
+        SIMD_TARGET static inline vint viand(vint a, vint b) { return _mm256_and_si256(a, b); }
+        SIMD_TARGET static inline vint viandnot(vint a, vint b) { return _mm256_andnot_si256(a, b); }
+        SIMD_TARGET static inline vint vior(vint a, vint b) { return _mm256_or_si256(a, b); }
+        SIMD_TARGET static inline vint vsll23(vint a) { return _mm256_slli_epi32(a, 23); }
+        SIMD_TARGET static inline vint vsrl23(vint a) { return _mm256_srli_epi32(a, 23); }
+        SIMD_TARGET static inline vmask vlt(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        /// mask ? a : b
+        SIMD_TARGET static inline vfloat vselect(vmask m, vfloat a, vfloat b) { return _mm256_blendv_ps(b, a, m); }
+        /// true if all values are in [lo,hi], false if any of them is NaN
+        SIMD_TARGET static inline bool vallinrange(vfloat x, vfloat lo, vfloat hi) {
+          vmask m = _mm256_and_ps(_mm256_cmp_ps(x, lo, _CMP_GE_OQ),
+                                  _mm256_cmp_ps(x, hi, _CMP_LE_OQ));
+          return _mm256_movemask_ps(m) == 0xff;
+        }
+#include "simd_kernels.impl.h"
+#undef SIMD_TARGET
+#undef SIMD_WIDTH
+      } // namespace KernelsAVX2
+
+      /// AVX-512 kernels, 16 floats per vector, only AVX512F is needed.
+      namespace KernelsAVX512 {
+#define SIMD_TARGET __attribute__((target("avx512f")))
+#define SIMD_WIDTH 16u
+        typedef __m512    vfloat;
+        typedef __m512i   vint;
+        typedef __mmask16 vmask;
+        SIMD_TARGET static inline vfloat vload(const float *p) { return _mm512_loadu_ps(p); }
+        SIMD_TARGET static inline void vstore(float *p, vfloat v) { _mm512_storeu_ps(p, v); }
+        SIMD_TARGET static inline vfloat vset1(float v) { return _mm512_set1_ps(v); }
+        SIMD_TARGET static inline vint viset1(int v) { return _mm512_set1_epi32(v); }
+        SIMD_TARGET static inline vfloat vadd(vfloat a, vfloat b) { return _mm512_add_ps(a, b); }
+        SIMD_TARGET static inline vfloat vsub(vfloat a, vfloat b) { return _mm512_sub_ps(a, b); }
+        SIMD_TARGET static inline vfloat vmul(vfloat a, vfloat b) { return _mm512_mul_ps(a, b); }
+        SIMD_TARGET static inline vfloat vdiv(vfloat a, vfloat b) { return _mm512_div_ps(a, b); }
+        /// a*b + c
+        SIMD_TARGET static inline vfloat vfma(vfloat a, vfloat b, vfloat c) { return _mm512_fmadd_ps(a, b, c); }
+        SIMD_TARGET static inline vmask vlt(vfloat a, vfloat b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        /// mask ? a : b
+        SIMD_TARGET static inline vfloat vselect(vmask m, vfloat a, vfloat b) { return _mm512_mask_blend_ps(m, b, a); }
+        /// (a<b) ? b : a, as AprilMath::m_max
+        SIMD_TARGET static inline vfloat vmax(vfloat a, vfloat b) { return vselect(vlt(a, b), b, a); }
+        SIMD_TARGET static inline vfloat vmin(vfloat a, vfloat b) { return _mm512_min_ps(a, b); }
+        SIMD_TARGET static inline vfloat vround(vfloat a) {
+          return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        }
+        SIMD_TARGET static inline vint vcvti(vfloat a) { return _mm512_cvtps_epi32(a); }
+        SIMD_TARGET static inline vfloat vcvtf(vint a) { return _mm512_cvtepi32_ps(a); }
+        SIMD_TARGET static inline vint vcasti(vfloat a) { return _mm512_castps_si512(a); }
+        SIMD_TARGET static inline vfloat vcastf(vint a) { return _mm512_castsi512_ps(a); }
+        SIMD_TARGET static inline vint viadd(vint a, vint b) { return _mm512_add_epi32(a, b); }
+        SIMD_TARGET static inline vint viand(vint a, vint b) { return _mm512_and_si512(a, b); }
+        SIMD_TARGET static inline vint viandnot(vint a, vint b) { return _mm512_andnot_si512(a, b); }
+        SIMD_TARGET static inline vint vior(vint a, vint b) { return _mm512_or_si512(a, b); }
+        SIMD_TARGET static inline vint vsll23(vint a) { return _mm512_slli_epi32(a, 23); }
+        SIMD_TARGET static inline vint vsrl23(vint a) { return _mm512_srli_epi32(a, 23); }
+        /// true if all values are in [lo,hi], false if any of them is NaN
+        SIMD_TARGET static inline bool vallinrange(vfloat x, vfloat lo, vfloat hi) {
+          vmask m = _mm512_cmp_ps_mask(x, lo, _CMP_GE_OQ) &
+            _mm512_cmp_ps_mask(x, hi, _CMP_LE_OQ);
+          return m == 0xffff;
+        }
+#include "simd_kernels.impl.h"
+#undef SIMD_TARGET
+#undef SIMD_WIDTH
+      } // namespace KernelsAVX512
+#endif // SIMD_X86
+
+#ifdef SIMD_NEON
+      /// NEON kernels, 4 floats per vector, AArch64 only.
+      namespace KernelsNEON {
+#define SIMD_TARGET
+#define SIMD_WIDTH 4u
+        typedef float32x4_t vfloat;
+        typedef int32x4_t   vint;
+        typedef uint32x4_t  vmask;
+        static inline vfloat vload(const float *p) { return vld1q_f32(p); }
+        static inline void vstore(float *p, vfloat v) { vst1q_f32(p, v); }
+        static inline vfloat vset1(float v) { return vdupq_n_f32(v); }
+        static inline vint viset1(int v) { return vdupq_n_s32(v); }
+        static inline vfloat vadd(vfloat a, vfloat b) { return vaddq_f32(a, b); }
+        static inline vfloat vsub(vfloat a, vfloat b) { return vsubq_f32(a, b); }
+        static inline vfloat vmul(vfloat a, vfloat b) { return vmulq_f32(a, b); }
+        static inline vfloat vdiv(vfloat a, vfloat b) { return vdivq_f32(a, b); }
+        /// a*b + c
+        static inline vfloat vfma(vfloat a, vfloat b, vfloat c) { return vfmaq_f32(c, a, b); }
+        static inline vmask vlt(vfloat a, vfloat b) { return vcltq_f32(a, b); }
+        /// mask ? a : b
+        static inline vfloat vselect(vmask m, vfloat a, vfloat b) { return vbslq_f32(m, a, b); }
+        /// (a<b) ? b : a, as AprilMath::m_max
+        static inline vfloat vmax(vfloat a, vfloat b) { return vselect(vlt(a, b), b, a); }
+        static inline vfloat vmin(vfloat a, vfloat b) { return vminq_f32(a, b); }
+        static inline vfloat vround(vfloat a) { return vrndnq_f32(a); }
+        static inline vint vcvti(vfloat a) { return vcvtnq_s32_f32(a); }
+        static inline vfloat vcvtf(vint a) { return vcvtq_f32_s32(a); }
+        static inline vint vcasti(vfloat a) { return vreinterpretq_s32_f32(a); }
+        static inline vfloat vcastf(vint a) { return vreinterpretq_f32_s32(a); }
+        static inline vint viadd(vint a, vint b) { return vaddq_s32(a, b); }
+        static inline vint viand(vint a, vint b) { return vandq_s32(a, b); }
+        /// (~a) & b
+        static inline vint viandnot(vint a, vint b) { return vbicq_s32(b, a); }
+        static inline vint vior(vint a, vint b) { return vorrq_s32(a, b); }
+        static inline vint vsll23(vint a) { return vshlq_n_s32(a, 23); }
+        static inline vint vsrl23(vint a) {
+          return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a), 23));
+        }
+        /// true if all values are in [lo,hi], false if any of them is NaN
+        static inline bool vallinrange(vfloat x, vfloat lo, vfloat hi) {
+          return vminvq_u32(vandq_u32(vcgeq_f32(x, lo), vcleq_f32(x, hi))) != 0u;
+        }
+#include "simd_kernels.impl.h"
+#undef SIMD_TARGET
+#undef SIMD_WIDTH
+      } // namespace KernelsNEON
+#endif // SIMD_NEON
+
+      //////////////////////////////////////////////////////////////////////
+
+      const char *LEVEL_NAMES[NUM_LEVELS] = { "none", "neon", "avx2", "avx512" };
+
+      const KernelTable *getLevelTable(Level level) {
+        switch(level) {
+#ifdef SIMD_X86
+        case AVX2: return &KernelsAVX2::KERNELS;
+        case AVX512: return &KernelsAVX512::KERNELS;
+#endif
+#ifdef SIMD_NEON
+        case NEON: return &KernelsNEON::KERNELS;
+#endif
+        case NONE: return &KernelsScalar::KERNELS;
+        default: return 0;
+        }
+      }
+
+      bool isLevelSupported(Level level) {
+        switch(level) {
+#ifdef SIMD_X86
+        case AVX2:
+          return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case AVX512:
+          return __builtin_cpu_supports("avx512f");
+#endif
+#ifdef SIMD_NEON
+        case NEON: return true;
+#endif
+        case NONE: return true;
+        default: return false;
+        }
+      }
+
+      Level detectMaxLevel() {
+#ifdef SIMD_X86
+        __builtin_cpu_init();
+#endif
+        for (int i=NUM_LEVELS-1; i>NONE; --i) {
+          Level level = static_cast<Level>(i);
+          if (isLevelSupported(level)) return level;
+        }
+        return NONE;
+      }
+
+      Level current_level = NUM_LEVELS;
+      const KernelTable *current_table = 0;
+
+      /// Lazy initialization, it is idempotent so concurrent calls are fine.
+      inline const KernelTable *getTable() {
+        if (current_table == 0) {
+          Level level = getMaxLevel();
+          current_table = getLevelTable(level);
+          current_level = level;
+        }
+        return current_table;
+      }
+
+    } // anonymous namespace
+
+    Level getMaxLevel() {
+      static const Level max_level = detectMaxLevel();
+      return max_level;
+    }
+
+    Level getLevel() {
+      getTable();
+      return current_level;
+    }
+
+    bool setLevel(Level level) {
+      if (level < NONE || level >= NUM_LEVELS || !isLevelSupported(level) ||
+          getLevelTable(level) == 0) {
+        return false;
+      }
+      current_level = level;
+      current_table = getLevelTable(level);
+      return true;
+    }
+
+    const char *getLevelName(Level level) {
+      if (level < NONE || level >= NUM_LEVELS) return "unknown";
+      return LEVEL_NAMES[level];
+    }
+
+    Level getLevelFromString(const char *name) {
+      for (int i=0; i<NUM_LEVELS; ++i) {
+        if (!strcmp(name, LEVEL_NAMES[i])) return static_cast<Level>(i);
+      }
+      return NUM_LEVELS;
+    }
+
+    void vecExp(unsigned int N, const float *x, float *y) {
+      getTable()->exp(N, x, y);
+    }
+
+    void vecLog(unsigned int N, const float *x, float *y) {
+      getTable()->log(N, x, y);
+    }
+
+    void vecLogistic(unsigned int N, const float *x, float *y) {
+      getTable()->logistic(N, x, y);
+    }
+
+    void vecTanh(unsigned int N, const float *x, float *y) {
+      getTable()->tanh(N, x, y);
+    }
+
+    void vecAdd(unsigned int N, const float *a, const float *b, float *y) {
+      getTable()->add(N, a, b, y);
+    }
+
+    void vecMul(unsigned int N, const float *a, const float *b, float *y) {
+      getTable()->mul(N, a, b, y);
+    }
+
+    void vecMax(unsigned int N, const float *a, const float *b, float *y) {
+      getTable()->max(N, a, b, y);
+    }
+
+    void vecSum(unsigned int N, const float *x, float &acc) {
+      getTable()->sum(N, x, acc);
+    }
+
+    void vecMaxReduce(unsigned int N, const float *x, float &acc) {
+      getTable()->max_reduce(N, x, acc);
+    }
+
+    void vecAffine(unsigned int N, const float *x, float a, float b, float *y) {
+      getTable()->affine(N, x, a, b, y);
+    }
+
+    void vecDot(unsigned int N, const float *a, const float *b, float &acc) {
+      getTable()->dot(N, a, b, acc);
+    }
+
+    void vecExpSum(unsigned int N, const float *x, float shift, float *y,
+                   float &acc) {
+      getTable()->exp_sum(N, x, shift, y, acc);
+    }
+
+    void vecSqDistances(unsigned int N, unsigned int D, const float *x,
+                        unsigned int ld, const float *q, float *y) {
+      getTable()->sq_distances(N, D, x, ld, q, y);
+    }
+
+  } // namespace SIMD
+
+} // namespace AprilMath
@@ -0,0 +1,183 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include "cmath_overloads.h"
+#include "unused_variable.h"
+
+namespace AprilMath {
+
+  /**
+   * @brief Explicit SIMD kernels for contiguous float vectors.
+   *
+   * The instruction set is selected at runtime: AVX-512 or AVX2+FMA in x86
+   * processors (using CPUID), NEON in AArch64 processors. When none of them is
+   * available (or when compiled with NO_SIMD) plain scalar loops are used.
+   *
+   * These kernels are used by genericMap1Call, genericMap2Call and
+   * genericReduce1Call when all the involved strides are 1, through the
+   * Map1Kernel, Map2Kernel and Reduce1Kernel traits declared below.
+   *
+   * @note Transcendental functions are computed with Cephes polynomial
+   * approximations, their error is a few ULPs. Non-finite values and values
+   * out of the approximation range are computed by the scalar functor.
+   */
+  namespace SIMD {
+
+    /// Instruction set levels, sorted by preference.
+    enum Level { NONE=0, NEON, AVX2, AVX512, NUM_LEVELS };
+
+    /// Returns the best level supported by the CPU and the compiled code.
+    Level getMaxLevel();
+    /// Returns the level currently in use.
+    Level getLevel();
+    /**
+     * @brief Changes the level in use, useful for benchmarking and debugging.
+     * @return False if the given level is not supported, true otherwise.
+     */
+    bool setLevel(Level level);
+    /// Returns the name of the given level.
+    const char *getLevelName(Level level);
+    /// Returns the level of the given name, or NUM_LEVELS if not found.
+    Level getLevelFromString(const char *name);
+
+    /// @name Map kernels, @c y can be equal to any of the inputs
+    /// @{
+    void vecExp(unsigned int N, const float *x, float *y);
+    void vecLog(unsigned int N, const float *x, float *y);
+    void vecLogistic(unsigned int N, const float *x, float *y);
+    void vecTanh(unsigned int N, const float *x, float *y);
+    void vecAdd(unsigned int N, const float *a, const float *b, float *y);
+    void vecMul(unsigned int N, const float *a, const float *b, float *y);
+    void vecMax(unsigned int N, const float *a, const float *b, float *y);
+    /// Computes <tt>y = a*x + b</tt>.
+    void vecAffine(unsigned int N, const float *x, float a, float b, float *y);
+    /// @}
+
+    /// @name Reduce kernels, they accumulate into @c acc
+    /// @{
+    void vecSum(unsigned int N, const float *x, float &acc);
+    void vecMaxReduce(unsigned int N, const float *x, float &acc);
+    /// Accumulates the dot product of @c a and @c b.
+    void vecDot(unsigned int N, const float *a, const float *b, float &acc);
+    /**
+     * @brief Accumulates <tt>exp(x - shift)</tt>, and stores every
+     * exponential at @c y when it is not NULL.
+     *
+     * @note The given @c shift should be the maximum of @c x (as in softmax
+     * computations), arguments below -87 give exp(-87) instead of 0.
+     */
+    void vecExpSum(unsigned int N, const float *x, float shift, float *y,
+                   float &acc);
+    /// @}
+
+    /**
+     * @brief Squared euclidean distances between @c q and @c N points stored
+     * by columns, that is, the component @c d of point @c j is at
+     * <tt>x[d*ld + j]</tt>. The result is written at <tt>y[j]</tt>.
+     */
+    void vecSqDistances(unsigned int N, unsigned int D, const float *x,
+                        unsigned int ld, const float *q, float *y);
+
+    /**
+     * @brief Trait which applies a SIMD kernel equivalent to an unary map
+     * functor over contiguous vectors.
+     *
+     * @return False if there is not any kernel for the given types, in which
+     * case nothing is done.
+     */
+    template<typename T, typename O, typename F>
+    struct Map1Kernel {
+      static bool apply(unsigned int N, const T *x, O *y) {
+        UNUSED_VARIABLE(N); UNUSED_VARIABLE(x); UNUSED_VARIABLE(y);
+        return false;
+      }
+    };
+
+    /// @see Map1Kernel
+    template<typename T1, typename T2, typename O, typename F>
+    struct Map2Kernel {
+      static bool apply(unsigned int N, const T1 *a, const T2 *b, O *y) {
+        UNUSED_VARIABLE(N); UNUSED_VARIABLE(a); UNUSED_VARIABLE(b);
+        UNUSED_VARIABLE(y);
+        return false;
+      }
+    };
+
+    /// @see Map1Kernel
+    template<typename T, typename O, typename F>
+    struct Reduce1Kernel {
+      static bool apply(unsigned int N, const T *x, O &acc) {
+        UNUSED_VARIABLE(N); UNUSED_VARIABLE(x); UNUSED_VARIABLE(acc);
+        return false;
+      }
+    };
+
+#ifndef NO_SIMD
+
+#define SIMD_MAP1_KERNEL(FUNCTOR, KERNEL)                               \
+    template<> struct Map1Kernel<float, float, FUNCTOR > {              \
+      static bool apply(unsigned int N, const float *x, float *y) {     \
+        KERNEL(N, x, y);                                                \
+        return true;                                                    \
+      }                                                                 \
+    }
+
+#define SIMD_MAP2_KERNEL(FUNCTOR, KERNEL)                               \
+    template<> struct Map2Kernel<float, float, float, FUNCTOR > {       \
+      static bool apply(unsigned int N, const float *a, const float *b, \
+                        float *y) {                                     \
+        KERNEL(N, a, b, y);                                             \
+        return true;                                                    \
+      }                                                                 \
+    }
+
+#define SIMD_REDUCE1_KERNEL(FUNCTOR, KERNEL)                            \
+    template<> struct Reduce1Kernel<float, float, FUNCTOR > {           \
+      static bool apply(unsigned int N, const float *x, float &acc) {   \
+        KERNEL(N, x, acc);                                              \
+        return true;                                                    \
+      }                                                                 \
+    }
+
+    SIMD_MAP1_KERNEL(Functors::m_exp<float>, vecExp);
+    SIMD_MAP1_KERNEL(Functors::m_log<float>, vecLog);
+    SIMD_MAP1_KERNEL(Functors::m_logistic<float>, vecLogistic);
+    SIMD_MAP1_KERNEL(Functors::m_tanh<float>, vecTanh);
+    SIMD_MAP2_KERNEL(Functors::m_add<float>, vecAdd);
+    SIMD_MAP2_KERNEL(Functors::m_mul<float>, vecMul);
+    SIMD_MAP2_KERNEL(Functors::m_max<float>, vecMax);
+    typedef Functors::r_add<float,float> r_add_float;
+    SIMD_REDUCE1_KERNEL(r_add_float, vecSum);
+    SIMD_REDUCE1_KERNEL(Functors::r_max<float>, vecMaxReduce);
+
+#undef SIMD_MAP1_KERNEL
+#undef SIMD_MAP2_KERNEL
+#undef SIMD_REDUCE1_KERNEL
+
+#endif // NO_SIMD
+
+  } // namespace SIMD
+
+} // namespace AprilMath
+
+#endif // SIMD_KERNELS_H
@@ -0,0 +1,311 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+// This file is included by simd_kernels.cc once per instruction set, inside
+// a namespace which defines SIMD_TARGET, SIMD_WIDTH, the types vfloat, vint
+// and vmask, and the primitives used below. It doesn't have include guards on
+// purpose.
+
+#define SIMD_INLINE static inline SIMD_TARGET
+
+// Cephes constants.
+#define SIMD_EXP_HI        88.0f
+#define SIMD_EXP_LO       -87.0f
+// exp(x) of floats is exactly zero below this value
+#define SIMD_EXP_ZERO    -104.0f
+#define SIMD_LOG2EF         1.44269504088896341f
+#define SIMD_EXP_C1         0.693359375f
+#define SIMD_EXP_C2        -2.12194440e-4f
+#define SIMD_SQRTHF         0.707106781186547524f
+#define SIMD_TANH_SMALL     0.625f
+#define SIMD_TANH_BIG       9.0f
+
+/// Computes exp(x) for x in [SIMD_EXP_LO, SIMD_EXP_HI].
+SIMD_INLINE vfloat vexp(vfloat x) {
+  vfloat fx = vround(vmul(x, vset1(SIMD_LOG2EF)));
+  x = vfma(fx, vset1(-SIMD_EXP_C1), x);
+  x = vfma(fx, vset1(-SIMD_EXP_C2), x);
+  vfloat z = vmul(x, x);
+  vfloat p = vset1(1.9875691500E-4f);
+  p = vfma(p, x, vset1(1.3981999507E-3f));
+  p = vfma(p, x, vset1(8.3334519073E-3f));
+  p = vfma(p, x, vset1(4.1665795894E-2f));
+  p = vfma(p, x, vset1(1.6666665459E-1f));
+  p = vfma(p, x, vset1(5.0000001201E-1f));
+  vfloat y = vadd(vfma(p, z, x), vset1(1.0f));
+  // 2^fx built directly into the exponent bits
+  vint n = viadd(vcvti(fx), viset1(127));
+  return vmul(y, vcastf(vsll23(n)));
+}
+
+/// Computes log(x) for normal positive finite values of x.
+SIMD_INLINE vfloat vlog(vfloat x) {
+  vint bits = vcasti(x);
+  vfloat e = vcvtf(viadd(vsrl23(bits), viset1(-126)));
+  // mantissa in [0.5,1)
+  vfloat m = vcastf(vior(viand(bits, viset1(0x007fffff)),
+                         viset1(0x3f000000)));
+  vmask small = vlt(m, vset1(SIMD_SQRTHF));
+  e = vsub(e, vselect(small, vset1(1.0f), vset1(0.0f)));
+  m = vadd(vsub(m, vset1(1.0f)), vselect(small, m, vset1(0.0f)));
+  vfloat z = vmul(m, m);
+  vfloat p = vset1(7.0376836292E-2f);
+  p = vfma(p, m, vset1(-1.1514610310E-1f));
+  p = vfma(p, m, vset1(1.1676998740E-1f));
+  p = vfma(p, m, vset1(-1.2420140846E-1f));
+  p = vfma(p, m, vset1(1.4249322787E-1f));
+  p = vfma(p, m, vset1(-1.6668057665E-1f));
+  p = vfma(p, m, vset1(2.0000714765E-1f));
+  p = vfma(p, m, vset1(-2.4999993993E-1f));
+  p = vfma(p, m, vset1(3.3333331174E-1f));
+  vfloat y = vmul(vmul(p, m), z);
+  y = vfma(e, vset1(SIMD_EXP_C2), y);
+  y = vfma(z, vset1(-0.5f), y);
+  return vfma(e, vset1(SIMD_EXP_C1), vadd(m, y));
+}
+
+/// Computes 1/(1+exp(-x)) for -x in [SIMD_EXP_LO, SIMD_EXP_HI].
+SIMD_INLINE vfloat vlogistic(vfloat x) {
+  vfloat one = vset1(1.0f);
+  return vdiv(one, vadd(one, vexp(vsub(vset1(0.0f), x))));
+}
+
+/// Computes tanh(x) for finite values of x.
+SIMD_INLINE vfloat vtanh(vfloat x) {
+  vint sign_mask = viset1(static_cast<int>(0x80000000u));
+  vfloat ax = vcastf(viandnot(sign_mask, vcasti(x)));
+  // small values, odd polynomial
+  vfloat z = vmul(x, x);
+  vfloat p = vset1(-5.70498872745E-3f);
+  p = vfma(p, z, vset1(2.06390887954E-2f));
+  p = vfma(p, z, vset1(-5.37397155531E-2f));
+  p = vfma(p, z, vset1(1.33314422036E-1f));
+  p = vfma(p, z, vset1(-3.33332819422E-1f));
+  vfloat ys = vfma(vmul(p, z), x, x);
+  // large values, 1 - 2/(exp(2|x|)+1) with the sign of x
+  vfloat one = vset1(1.0f);
+  vfloat s = vexp(vmul(vmin(ax, vset1(SIMD_TANH_BIG)), vset1(2.0f)));
+  vfloat yb = vsub(one, vdiv(vset1(2.0f), vadd(s, one)));
+  yb = vcastf(vior(vcasti(yb), viand(vcasti(x), sign_mask)));
+  return vselect(vlt(ax, vset1(SIMD_TANH_SMALL)), ys, yb);
+}
+
+/**
+ * Applies a vector functor over contiguous data. Vectors with any value out of
+ * [lo,hi] (or NaN) and the tail are computed with the scalar functor.
+ */
+#define SIMD_MAP1_LOOP(VFUNC, SFUNC, LO, HI) do {                       \
+    unsigned int i = 0;                                                 \
+    for (; i + SIMD_WIDTH <= N; i += SIMD_WIDTH) {                      \
+      vfloat v = vload(x + i);                                          \
+      if (vallinrange(v, vset1(LO), vset1(HI))) {                       \
+        vstore(y + i, VFUNC(v));                                        \
+      }                                                                 \
+      else {                                                            \
+        float tmp[SIMD_WIDTH];                                          \
+        vstore(tmp, v);                                                 \
+        for (unsigned int k=0; k<SIMD_WIDTH; ++k) y[i+k] = SFUNC(tmp[k]); \
+      }                                                                 \
+    }                                                                   \
+    for (; i < N; ++i) y[i] = SFUNC(x[i]);                              \
+  } while(0)
+
+SIMD_TARGET void kernelExp(unsigned int N, const float *x, float *y) {
+  SIMD_MAP1_LOOP(vexp, AprilMath::m_exp, SIMD_EXP_LO, SIMD_EXP_HI);
+}
+
+SIMD_TARGET void kernelLog(unsigned int N, const float *x, float *y) {
+  SIMD_MAP1_LOOP(vlog, AprilMath::m_log, FLT_MIN, FLT_MAX);
+}
+
+SIMD_TARGET void kernelLogistic(unsigned int N, const float *x, float *y) {
+  SIMD_MAP1_LOOP(vlogistic, AprilMath::m_logistic, -SIMD_EXP_HI, -SIMD_EXP_LO);
+}
+
+SIMD_TARGET void kernelTanh(unsigned int N, const float *x, float *y) {
+  SIMD_MAP1_LOOP(vtanh, AprilMath::m_tanh, -FLT_MAX, FLT_MAX);
+}
+
+#define SIMD_MAP2_LOOP(VFUNC, SFUNC) do {                       \
+    unsigned int i = 0;                                         \
+    for (; i + SIMD_WIDTH <= N; i += SIMD_WIDTH) {              \
+      vstore(y + i, VFUNC(vload(a + i), vload(b + i)));         \
+    }                                                           \
+    for (; i < N; ++i) y[i] = SFUNC(a[i], b[i]);                \
+  } while(0)
+
+SIMD_TARGET void kernelAdd(unsigned int N, const float *a, const float *b,
+                           float *y) {
+  SIMD_MAP2_LOOP(vadd, AprilMath::m_add);
+}
+
+SIMD_TARGET void kernelMul(unsigned int N, const float *a, const float *b,
+                           float *y) {
+  SIMD_MAP2_LOOP(vmul, AprilMath::m_mul);
+}
+
+SIMD_TARGET void kernelMax(unsigned int N, const float *a, const float *b,
+                           float *y) {
+  SIMD_MAP2_LOOP(vmax, AprilMath::m_max);
+}
+
+SIMD_TARGET void kernelSum(unsigned int N, const float *x, float &acc) {
+  // two accumulators to hide the latency of additions
+  vfloat acc0 = vset1(0.0f), acc1 = vset1(0.0f);
+  unsigned int i = 0;
+  for (; i + 2*SIMD_WIDTH <= N; i += 2*SIMD_WIDTH) {
+    acc0 = vadd(acc0, vload(x + i));
+    acc1 = vadd(acc1, vload(x + i + SIMD_WIDTH));
+  }
+  for (; i + SIMD_WIDTH <= N; i += SIMD_WIDTH) {
+    acc0 = vadd(acc0, vload(x + i));
+  }
+  float tmp[SIMD_WIDTH];
+  vstore(tmp, vadd(acc0, acc1));
+  float result = 0.0f;
+  for (unsigned int k=0; k<SIMD_WIDTH; ++k) result += tmp[k];
+  for (; i < N; ++i) result += x[i];
+  acc += result;
+}
+
+SIMD_TARGET void kernelMaxReduce(unsigned int N, const float *x, float &acc) {
+  unsigned int i = 0;
+  if (N >= SIMD_WIDTH) {
+    vfloat vacc = vset1(acc);
+    for (; i + SIMD_WIDTH <= N; i += SIMD_WIDTH) {
+      vacc = vmax(vacc, vload(x + i));
+    }
+    float tmp[SIMD_WIDTH];
+    vstore(tmp, vacc);
+    for (unsigned int k=0; k<SIMD_WIDTH; ++k) if (acc < tmp[k]) acc = tmp[k];
+  }
+  for (; i < N; ++i) if (acc < x[i]) acc = x[i];
+}
+
+SIMD_TARGET void kernelAffine(unsigned int N, const float *x, float a,
+                              float b, float *y) {
+  vfloat va = vset1(a), vb = vset1(b);
+  unsigned int i = 0;
+  for (; i + SIMD_WIDTH <= N; i += SIMD_WIDTH) {
+    vstore(y + i, vfma(vload(x + i), va, vb));
+  }
+  for (; i < N; ++i) y[i] = a*x[i] + b;
+}
+
+SIMD_TARGET void kernelDot(unsigned int N, const float *a, const float *b,
+                           float &acc) {
+  vfloat acc0 = vset1(0.0f), acc1 = vset1(0.0f);
+  unsigned int i = 0;
+  for (; i + 2*SIMD_WIDTH <= N; i += 2*SIMD_WIDTH) {
+    acc0 = vfma(vload(a + i), vload(b + i), acc0);
+    acc1 = vfma(vload(a + i + SIMD_WIDTH), vload(b + i + SIMD_WIDTH), acc1);
+  }
+  for (; i + SIMD_WIDTH <= N; i += SIMD_WIDTH) {
+    acc0 = vfma(vload(a + i), vload(b + i), acc0);
+  }
+  float tmp[SIMD_WIDTH];
+  vstore(tmp, vadd(acc0, acc1));
+  float result = 0.0f;
+  for (unsigned int k=0; k<SIMD_WIDTH; ++k) result += tmp[k];
+  for (; i < N; ++i) result += a[i] * b[i];
+  acc += result;
+}
+
+SIMD_TARGET void kernelExpSum(unsigned int N, const float *x, float shift,
+                              float *y, float &acc) {
+  vfloat vshift = vset1(shift), vacc = vset1(0.0f);
+  vfloat lo = vset1(SIMD_EXP_LO), hi = vset1(SIMD_EXP_HI);
+  vfloat zero_lo = vset1(-FLT_MAX), zero_hi = vset1(SIMD_EXP_ZERO);
+  float result = 0.0f;
+  unsigned int i = 0;
+  for (; i + SIMD_WIDTH <= N; i += SIMD_WIDTH) {
+    vfloat d = vsub(vload(x + i), vshift);
+    if (vallinrange(d, lo, hi)) {
+      vfloat e = vexp(d);
+      vacc = vadd(vacc, e);
+      if (y != 0) vstore(y + i, e);
+    }
+    else if (vallinrange(d, zero_lo, zero_hi)) {
+      // all of them underflow to zero, as with AprilMath::m_exp
+      if (y != 0) vstore(y + i, vset1(0.0f));
+    }
+    else { // underflows (denormals), infinite or NaN values
+      float tmp[SIMD_WIDTH];
+      vstore(tmp, d);
+      for (unsigned int k=0; k<SIMD_WIDTH; ++k) {
+        float e = AprilMath::m_exp(tmp[k]);
+        if (y != 0) y[i+k] = e;
+        result += e;
+      }
+    }
+  }
+  float tmp[SIMD_WIDTH];
+  vstore(tmp, vacc);
+  for (unsigned int k=0; k<SIMD_WIDTH; ++k) result += tmp[k];
+  for (; i < N; ++i) {
+    float e = AprilMath::m_exp(x[i] - shift);
+    if (y != 0) y[i] = e;
+    result += e;
+  }
+  acc += result;
+}
+
+SIMD_TARGET void kernelSqDistances(unsigned int N, unsigned int D,
+                                   const float *x, unsigned int ld,
+                                   const float *q, float *y) {
+  unsigned int j = 0;
+  for (; j + SIMD_WIDTH <= N; j += SIMD_WIDTH) {
+    vfloat acc = vset1(0.0f);
+    for (unsigned int d=0; d<D; ++d) {
+      vfloat diff = vsub(vload(x + d*ld + j), vset1(q[d]));
+      acc = vfma(diff, diff, acc);
+    }
+    vstore(y + j, acc);
+  }
+  for (; j < N; ++j) {
+    float acc = 0.0f;
+    for (unsigned int d=0; d<D; ++d) {
+      float diff = x[d*ld + j] - q[d];
+      acc += diff * diff;
+    }
+    y[j] = acc;
+  }
+}
+
+static const KernelTable KERNELS = {
+  kernelExp, kernelLog, kernelLogistic, kernelTanh,
+  kernelAdd, kernelMul, kernelMax,
+  kernelSum, kernelMaxReduce,
+  kernelAffine, kernelDot, kernelExpSum,
+  kernelSqDistances,
+};
+
+#undef SIMD_MAP1_LOOP
+#undef SIMD_MAP2_LOOP
+#undef SIMD_INLINE
+#undef SIMD_EXP_HI
+#undef SIMD_EXP_LO
+#undef SIMD_LOG2EF
+#undef SIMD_EXP_C1
+#undef SIMD_EXP_C2
+#undef SIMD_SQRTHF
+#undef SIMD_TANH_SMALL
+#undef SIMD_TANH_BIG
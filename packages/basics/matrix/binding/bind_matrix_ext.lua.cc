@@ -40,6 +40,9 @@ extern "C" {
 #include "bind_matrix_complex_float.h"
 #include "bind_matrix_double.h"
 #include "bind_matrix_int32.h"
+#include "matrix_ext_fused.h"
+
+using AprilMath::FusedProgram;
 //BIND_END
 
 //BIND_LUACLASSNAME MatrixFloat matrix
@@ -47,6 +50,8 @@ extern "C" {
 //BIND_LUACLASSNAME MatrixInt32 matrixInt32
 //BIND_LUACLASSNAME MatrixComplexF matrixComplex
 //BIND_LUACLASSNAME MatrixChar matrixChar
+//BIND_LUACLASSNAME FusedProgram matrix.__fused_program__
+//BIND_CPP_CLASS FusedProgram
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -280,3 +285,125 @@ extern "C" {
   LUABIND_RETURN(MatrixFloat, angleFromMatrixComplexFToMatrixFloat(obj));
 }
 //BIND_END
+
+//////////////////////////////////////////////////////////////////////////////
+
+//BIND_CONSTRUCTOR FusedProgram
+//DOC_BEGIN
+// __fused_program__(num_inputs, code, reduction)
+/// Low-level constructor, use matrix.fuse() instead.
+/// @param num_inputs - Number of input matrices.
+/// @param code - A table in postfix order, every instruction is a table
+/// { opname, arg }, being arg the input index (1-based) for "input"
+/// instructions or the constant value for "const" instructions.
+/// @param reduction - An optional string: "sum", "prod", "max", "min".
+//DOC_END
+{
+  LUABIND_CHECK_ARGN(>=, 2);
+  LUABIND_CHECK_ARGN(<=, 3);
+  int num_inputs, len;
+  const char *reduction;
+  LUABIND_GET_PARAMETER(1, int, num_inputs);
+  LUABIND_CHECK_PARAMETER(2, table);
+  LUABIND_GET_OPTIONAL_PARAMETER(3, string, reduction, "none");
+  if (num_inputs < 0) LUABIND_ERROR("Expected a non-negative number of inputs");
+  int red = FusedProgram::getReduceCodeFromString(reduction);
+  if (red < 0) LUABIND_FERROR1("Unknown reduction %s", reduction);
+  obj = new FusedProgram(num_inputs);
+  obj->setReduction(static_cast<FusedProgram::ReduceCode>(red));
+  LUABIND_TABLE_GETN(2, len);
+  for (int i=1; i<=len; ++i) {
+    const char *opname;
+    lua_rawgeti(L, 2, i);
+    if (!lua_istable(L, -1)) {
+      delete obj;
+      LUABIND_FERROR1("Expected a table at instruction %d", i);
+    }
+    lua_rawgeti(L, -1, 1);
+    LUABIND_GET_PARAMETER(-1, string, opname);
+    lua_pop(L, 1);
+    FusedProgram::OpCode op = FusedProgram::getOpCodeFromString(opname);
+    switch(op) {
+    case FusedProgram::OP_NUM_OPCODES:
+      delete obj;
+      LUABIND_FERROR1("Unknown fused operation %s", opname);
+      break;
+    case FusedProgram::OP_INPUT:
+      {
+        int idx;
+        lua_rawgeti(L, -1, 2);
+        LUABIND_GET_PARAMETER(-1, int, idx);
+        lua_pop(L, 1);
+        obj->pushInput(idx - 1);
+      }
+      break;
+    case FusedProgram::OP_CONST:
+      {
+        float value;
+        lua_rawgeti(L, -1, 2);
+        LUABIND_GET_PARAMETER(-1, float, value);
+        lua_pop(L, 1);
+        obj->pushConstant(value);
+      }
+      break;
+    default:
+      obj->pushOp(op);
+    }
+    lua_pop(L, 1);
+  }
+  if (!obj->isValid()) {
+    delete obj;
+    LUABIND_ERROR("Incomplete fused program, it should leave one value");
+  }
+  LUABIND_RETURN(FusedProgram, obj);
+}
+//BIND_END
+
+//BIND_METHOD FusedProgram num_inputs
+{
+  LUABIND_RETURN(int, obj->getNumInputs());
+}
+//BIND_END
+
+//BIND_METHOD FusedProgram is_reduction
+{
+  LUABIND_RETURN(bool, obj->isReduction());
+}
+//BIND_END
+
+//BIND_METHOD FusedProgram eval
+//DOC_BEGIN
+// eval(m1, m2, ..., mN [, dest])
+/// Evaluates the program over the given N matrices. For programs with a
+/// trailing reduction it returns a number, otherwise it returns the
+/// destination matrix, which is allocated when not given.
+//DOC_END
+{
+  const int n = obj->getNumInputs();
+  int argn = lua_gettop(L);
+  if (argn != n && (obj->isReduction() || argn != n+1)) {
+    LUABIND_FERROR2("Incorrect number of arguments, expected %d, found %d",
+                    n, argn);
+  }
+  AprilUtils::UniquePtr<const MatrixFloat *[]> inputs(new const MatrixFloat*[n]);
+  for (int i=0; i<n; ++i) {
+    MatrixFloat *m;
+    LUABIND_GET_PARAMETER(i+1, MatrixFloat, m);
+    inputs[i] = m;
+  }
+  if (obj->isReduction()) {
+    LUABIND_RETURN(float, AprilMath::MatrixExt::Fused::
+                   matFusedReduce(obj, inputs.get()));
+  }
+  else {
+    MatrixFloat *dest;
+    LUABIND_GET_OPTIONAL_PARAMETER(n+1, MatrixFloat, dest, 0);
+    if (dest == 0) {
+      if (n == 0) LUABIND_ERROR("A destination matrix is needed without inputs");
+      dest = inputs[0]->cloneOnlyDims();
+    }
+    LUABIND_RETURN(MatrixFloat, AprilMath::MatrixExt::Fused::
+                   matFusedMap(obj, inputs.get(), dest));
+  }
+}
+//BIND_END
@@ -24,6 +24,7 @@
 
 //BIND_STRING_CONSTANT matrix.options.tab Basics::MatrixIO::TAB_OPTION
 //BIND_STRING_CONSTANT matrix.options.ascii Basics::MatrixIO::ASCII_OPTION
+//BIND_STRING_CONSTANT matrix.options.raw Basics::MatrixIO::RAW_OPTION
 //BIND_STRING_CONSTANT matrix.options.delim Basics::MatrixIO::DELIM_OPTION
 //BIND_STRING_CONSTANT matrix.options.empty Basics::MatrixIO::EMPTY_OPTION
 //BIND_STRING_CONSTANT matrix.options.default Basics::MatrixIO::DEFAULT_OPTION
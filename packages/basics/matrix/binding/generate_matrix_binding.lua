@@ -23,7 +23,8 @@ local matrix_methods = {
     "set_use_cuda", "dim", "num_dim", "stride", "slice", "select", "clone",
     "transpose", "isfinite", "toTable", "contiguous", "map", "diagonalize",
     "get_shared_count", "reset_shared_count", "add_to_shared_count", "sync",
-    "padding_all", "padding", "uniform", "uniformf", "linspace", "logspace",
+    "padding_all", "padding", "uniform", "uniformf", "normal", "bernoulli",
+    "linspace", "logspace",
     "linear", "sliding_window", "is_contiguous",
     "prune_subnormal_and_check_normal", "adjust_range", "diag", "fill",
     "zeros", "ones", "min", "max", "equals", "clamp", "add", "scalar_add",
@@ -45,7 +46,8 @@ local matrix_methods = {
     "set_use_cuda", "dim", "num_dim", "stride", "slice", "select", "clone",
     "transpose", "isfinite", "toTable", "contiguous", "map", "diagonalize",
     "get_shared_count", "reset_shared_count", "add_to_shared_count", "sync",
-    "padding_all", "padding", "uniform", "uniformf", "linspace", "logspace",
+    "padding_all", "padding", "uniform", "uniformf", "normal", "bernoulli",
+    "linspace", "logspace",
     "linear", "sliding_window", "is_contiguous",
     "prune_subnormal_and_check_normal", "adjust_range", "diag", "fill",
     "zeros", "ones", "min", "max", "equals", "clamp", "add", "scalar_add",
@@ -141,27 +143,27 @@ local matrix_methods = {
 
 local matrix_class_methods = {
   float = {
-    "as", "deserialize", "read", "fromMMap", "__broadcast__",
+    "as", "deserialize", "read", "fromMMap", "fromRawMMap", "__broadcast__",
     "__call_function__", "__newindex_function__", "__index_function__",
   },
   double = {
-    "as", "deserialize", "read", "fromMMap", "__broadcast__",
+    "as", "deserialize", "read", "fromMMap", "fromRawMMap", "__broadcast__",
     "__call_function__", "__newindex_function__", "__index_function__",
   },
   char = {
-    "as", "deserialize", "read", "fromMMap", "__broadcast__",
+    "as", "deserialize", "read", "fromMMap", "fromRawMMap", "__broadcast__",
     "__call_function__", "__newindex_function__", "__index_function__",
   },
   int32_t = {
-    "as", "deserialize", "read", "fromMMap", "__broadcast__",
+    "as", "deserialize", "read", "fromMMap", "fromRawMMap", "__broadcast__",
     "__call_function__", "__newindex_function__", "__index_function__",
   },
   ComplexF = {
-    "as", "deserialize", "read", "fromMMap", "__broadcast__",
+    "as", "deserialize", "read", "fromMMap", "fromRawMMap", "__broadcast__",
     "__call_function__", "__newindex_function__", "__index_function__",
   },
   bool = {
-    "as", "deserialize", "read", "fromMMap", "__broadcast__",
+    "as", "deserialize", "read", "fromMMap", "fromRawMMap", "__broadcast__",
     "__call_function__", "__newindex_function__", "__index_function__",
   },
   
@@ -29,6 +29,7 @@ extern "C" {
 #include "complex_number.h"
 #include "bind_april_io.h"
 #include "bind_mtrand.h"
+#include "bind_util.h"
 #include "gpu_mirrored_memory_block.h"
 #include "matrixFloat.h"
 #include "mystring.h"
@@ -842,6 +843,31 @@ namespace Basics {
       return 1;
     }
 
+    BEGIN_CLASS_METHOD(fromRawMMap)
+    {
+      LUABIND_CHECK_ARGN(>=, 1);
+      LUABIND_CHECK_ARGN(<=, 3);
+      AprilUtils::SharedPtr<AprilUtils::MMappedDataReader> mmapped_data;
+      if (lua_isMMappedDataReader(L, 1)) {
+        // a matrix stored at the current position of a mapped file
+        LUABIND_CHECK_ARGN(==, 1);
+        mmapped_data = lua_toMMappedDataReader(L, 1);
+      }
+      else {
+        LUABIND_CHECK_PARAMETER(1, string);
+        const char *filename;
+        bool write, shared;
+        LUABIND_GET_PARAMETER(1,string,filename);
+        LUABIND_GET_OPTIONAL_PARAMETER(2,bool,write,false);
+        LUABIND_GET_OPTIONAL_PARAMETER(3,bool,shared,true);
+        mmapped_data = new AprilUtils::MMappedDataReader(filename,write,shared,
+                                                         false);
+      }
+      Matrix<T> *obj = Matrix<T>::fromRawMMappedDataReader(mmapped_data.get());
+      lua_push<Matrix<T>*>(L, obj);
+      return 1;
+    }
+
     BEGIN_METHOD(toMMap)
     {
       LUABIND_CHECK_ARGN(==, 1);
@@ -976,6 +1002,29 @@ namespace Basics {
       return 1;
     }
 
+    enum PhiloxDistribution { PHILOX_UNIFORM, PHILOX_NORMAL, PHILOX_BERNOULLI };
+
+    /// Fills the matrix with the parallel bulk methods of PhiloxRand,
+    /// non-contiguous matrices are filled through a contiguous copy.
+    static void philoxFill(Basics::PhiloxRand *random, Matrix<T> *obj,
+                           PhiloxDistribution dist, double a, double b) {
+      AprilUtils::SharedPtr< Matrix<T> > dest(obj);
+      if (!obj->getIsContiguous()) dest = obj->clone();
+      T *ptr = dest->getRawDataAccess()->getPPALForWrite() + dest->getOffset();
+      switch(dist) {
+      case PHILOX_UNIFORM:   random->fillUniform(ptr, dest->size(), a, b); break;
+      case PHILOX_NORMAL:    random->fillNormal(ptr, dest->size(), a, b); break;
+      case PHILOX_BERNOULLI: random->fillBernoulli(ptr, dest->size(), a); break;
+      }
+      if (dest.get() != obj) {
+        typename Matrix<T>::const_iterator src_it(dest->begin());
+        for (typename Matrix<T>::iterator it(obj->begin()); it != obj->end();
+             ++it, ++src_it) {
+          *it = *src_it;
+        }
+      }
+    }
+
     BEGIN_METHOD(uniform)
     {
       int lower, upper;
@@ -1001,10 +1050,15 @@ namespace Basics {
 
       LUABIND_GET_OPTIONAL_PARAMETER(1, float, lower, 0.0f);
       LUABIND_GET_OPTIONAL_PARAMETER(2, float, upper, 1.0f);
-      LUABIND_GET_OPTIONAL_PARAMETER(3, MTRand, random, 0);
       if (lower > upper) {
         LUABIND_ERROR("First argument must be <= second argument");
       }
+      if (lua_isPhiloxRand(L, 3)) {
+        philoxFill(lua_toPhiloxRand(L, 3), obj, PHILOX_UNIFORM, lower, upper);
+        lua_push(L, obj);
+        return 1;
+      }
+      LUABIND_GET_OPTIONAL_PARAMETER(3, MTRand, random, 0);
       if (!random) random = new Basics::MTRand();
       for (typename Matrix<T>::iterator it(obj->begin()); it != obj->end(); ++it) {
         *it = T(random->rand(upper - lower) + lower);
@@ -1013,6 +1067,51 @@ namespace Basics {
       return 1;
     }
 
+    BEGIN_METHOD(normal)
+    {
+      double mean, stddev;
+      AprilUtils::SharedPtr<Basics::MTRand> random;
+      LUABIND_GET_OPTIONAL_PARAMETER(1, double, mean, 0.0);
+      LUABIND_GET_OPTIONAL_PARAMETER(2, double, stddev, 1.0);
+      if (stddev < 0.0) {
+        LUABIND_ERROR("Standard deviation must be >= 0");
+      }
+      if (lua_isPhiloxRand(L, 3)) {
+        philoxFill(lua_toPhiloxRand(L, 3), obj, PHILOX_NORMAL, mean, stddev);
+        lua_push(L, obj);
+        return 1;
+      }
+      LUABIND_GET_OPTIONAL_PARAMETER(3, MTRand, random, 0);
+      if (!random) random = new Basics::MTRand();
+      for (typename Matrix<T>::iterator it(obj->begin()); it != obj->end(); ++it) {
+        *it = T(random->randNorm(mean, stddev));
+      }
+      lua_push(L, obj);
+      return 1;
+    }
+
+    BEGIN_METHOD(bernoulli)
+    {
+      double p;
+      AprilUtils::SharedPtr<Basics::MTRand> random;
+      LUABIND_GET_OPTIONAL_PARAMETER(1, double, p, 0.5);
+      if (p < 0.0 || p > 1.0) {
+        LUABIND_ERROR("Probability must be in range [0,1]");
+      }
+      if (lua_isPhiloxRand(L, 2)) {
+        philoxFill(lua_toPhiloxRand(L, 2), obj, PHILOX_BERNOULLI, p, 0.0);
+        lua_push(L, obj);
+        return 1;
+      }
+      LUABIND_GET_OPTIONAL_PARAMETER(2, MTRand, random, 0);
+      if (!random) random = new Basics::MTRand();
+      for (typename Matrix<T>::iterator it(obj->begin()); it != obj->end(); ++it) {
+        *it = (random->randExc() < p) ? T(1.0) : T(0.0);
+      }
+      lua_push(L, obj);
+      return 1;
+    }
+
     BEGIN_METHOD(linspace)
     {
       int size_1 = obj->size()-1;
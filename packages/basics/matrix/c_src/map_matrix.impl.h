@@ -27,6 +27,7 @@
 #include "map_matrix.h"
 #include "map_template.h"
 #include "omp_utils.h"
+#include "span_scheduler.h"
 
 namespace AprilMath {
 
@@ -124,10 +125,6 @@ namespace AprilMath {
       if (input->size() != dest->size()) {
         ERROR_EXIT(128, "Incompatible matrix sizes or dimensions\n");
       }
-#ifdef NO_OMP
-      UNUSED_VARIABLE(N_th);
-      UNUSED_VARIABLE(SIZE_th);
-#endif
       bool cuda_flag = input->getCudaFlag() || dest->getCudaFlag();
       // Contiguous memory block or one dimension.
       if ( (input->getIsContiguous() || input->getNumDim() == 1) &&
@@ -139,10 +136,33 @@ namespace AprilMath {
         else input_stride = input->getStrideSize(0);
         if (dest->getIsContiguous()) dest_stride = 1u;
         else dest_stride = dest->getStrideSize(0);
-        functor(size,
-                input->getRawDataAccess(), input_stride, input_offset,
-                dest->getRawDataAccess(), dest_stride, dest_offset,
-                cuda_flag);
+        SpanScheduler sched(1, size, cuda_flag, N_th, SIZE_th);
+        if (sched.isParallel()) {
+#ifdef USE_CUDA
+          // Forces execution of memory copy from GPU to PPAL or viceversa (if
+          // needed), avoiding race conditions on the following.
+          input->getRawDataAccess()->forceSync(cuda_flag);
+#endif
+          const int M = sched.getNumItems();
+#ifndef NO_OMP
+#pragma omp parallel for
+#endif
+          for (int k=0; k<M; ++k) {
+            const unsigned int first = sched.getFirst(k);
+            functor(sched.getSize(k),
+                    input->getRawDataAccess(), input_stride,
+                    input_offset + first*input_stride,
+                    dest->getRawDataAccess(), dest_stride,
+                    dest_offset + first*dest_stride,
+                    cuda_flag);
+          } // for every chunk
+        } // if parallel computation
+        else {
+          functor(size,
+                  input->getRawDataAccess(), input_stride, input_offset,
+                  dest->getRawDataAccess(), dest_stride, dest_offset,
+                  cuda_flag);
+        }
       }
       // General case.
       else {
@@ -163,27 +183,33 @@ namespace AprilMath {
         // needed), avoiding race conditions on the following.
         input->getRawDataAccess()->forceSync(cuda_flag);
 #endif
+        // The scheduler uses OMP only when the number of threads is more than
+        // 1 and the computation is large enough, splitting long spans.
+        SpanScheduler sched(N, size, cuda_flag, N_th, SIZE_th);
+        if (sched.isParallel()) {
+          const int M = sched.getNumItems();
 #ifndef NO_OMP
-        // This if controls the execution using OMP only when the number of threads
-        // is more than 1 and the iterator size is large enough.
-        if (OMPUtils::get_num_threads() > 1 && N > N_th && size > SIZE_th) {
 #pragma omp parallel for firstprivate(input_span_it) firstprivate(dest_span_it)
-          for (int i=0; i<N; ++i) {
+#endif
+          for (int k=0; k<M; ++k) {
+            const int i = sched.getSpan(k);
+            const unsigned int first = sched.getFirst(k);
             input_span_it.setAtIteration(i);
             dest_span_it.setAtIteration(i);
             //
-            functor(size,
+            functor(sched.getSize(k),
                     input->getRawDataAccess(),
                     input_stride,
-                    static_cast<unsigned int>(input_span_it.getOffset()),
+                    static_cast<unsigned int>(input_span_it.getOffset()) +
+                    first*input_stride,
                     dest->getRawDataAccess(),
                     dest_stride,
-                    static_cast<unsigned int>(dest_span_it.getOffset()),
+                    static_cast<unsigned int>(dest_span_it.getOffset()) +
+                    first*dest_stride,
                     cuda_flag);
-          } // for every possible span
-        } // if num_threads>1 and large enough computation
+          } // for every work item
+        } // if parallel computation
         else {
-#endif
           // sequential code, with less overhead when updating iterator
           for (int i=0; i<N; ++i) {
             april_assert(input_span_it != input->end_span_iterator());
@@ -202,9 +228,7 @@ namespace AprilMath {
           } // for every possible span
           april_assert(input_span_it == input->end_span_iterator());
           april_assert(dest_span_it == dest->end_span_iterator());
-#ifndef NO_OMP
-        } // else (num_threads==1 or not large enough computation)
-#endif
+        } // else (sequential computation)
       } // General case.
       return dest;
     } // MatrixMap1 function
@@ -220,10 +244,6 @@ namespace AprilMath {
       if (input1->size() != dest->size() || input2->size() != dest->size()) {
         ERROR_EXIT(128, "Incompatible matrix sizes or dimensions\n");
       }
-#ifdef NO_OMP
-      UNUSED_VARIABLE(N_th);
-      UNUSED_VARIABLE(SIZE_th);
-#endif
       bool cuda_flag = input1->getCudaFlag() || input2->getCudaFlag() ||
         dest->getCudaFlag();
       // Contiguous memory block or one dimension.
@@ -240,11 +260,37 @@ namespace AprilMath {
         else input2_stride = input2->getStrideSize(0);
         if (dest->getIsContiguous()) dest_stride = 1u;
         else dest_stride = dest->getStrideSize(0);
-        functor(size,
-                input1->getRawDataAccess(), input1_stride, input1_offset,
-                input2->getRawDataAccess(), input2_stride, input2_offset,
-                dest->getRawDataAccess(), dest_stride, dest_offset,
-                cuda_flag);
+        SpanScheduler sched(1, size, cuda_flag, N_th, SIZE_th);
+        if (sched.isParallel()) {
+#ifdef USE_CUDA
+          // Forces execution of memory copy from GPU to PPAL or viceversa (if
+          // needed), avoiding race conditions on the following.
+          input1->getRawDataAccess()->forceSync(cuda_flag);
+          input2->getRawDataAccess()->forceSync(cuda_flag);
+#endif
+          const int M = sched.getNumItems();
+#ifndef NO_OMP
+#pragma omp parallel for
+#endif
+          for (int k=0; k<M; ++k) {
+            const unsigned int first = sched.getFirst(k);
+            functor(sched.getSize(k),
+                    input1->getRawDataAccess(), input1_stride,
+                    input1_offset + first*input1_stride,
+                    input2->getRawDataAccess(), input2_stride,
+                    input2_offset + first*input2_stride,
+                    dest->getRawDataAccess(), dest_stride,
+                    dest_offset + first*dest_stride,
+                    cuda_flag);
+          } // for every chunk
+        } // if parallel computation
+        else {
+          functor(size,
+                  input1->getRawDataAccess(), input1_stride, input1_offset,
+                  input2->getRawDataAccess(), input2_stride, input2_offset,
+                  dest->getRawDataAccess(), dest_stride, dest_offset,
+                  cuda_flag);
+        }
       }
       // General case.
       else {
@@ -270,31 +316,38 @@ namespace AprilMath {
         input1->getRawDataAccess()->forceSync(cuda_flag);
         input2->getRawDataAccess()->forceSync(cuda_flag);
 #endif
+        // The scheduler uses OMP only when the number of threads is more than
+        // 1 and the computation is large enough, splitting long spans.
+        SpanScheduler sched(N, size, cuda_flag, N_th, SIZE_th);
+        if (sched.isParallel()) {
+          const int M = sched.getNumItems();
 #ifndef NO_OMP
-        // This if controls the execution using OMP only when the number of threads
-        // is more than 1 and the iterator size is large enough.
-        if (OMPUtils::get_num_threads() > 1 && N > N_th && size > SIZE_th) {
 #pragma omp parallel for firstprivate(input1_span_it) firstprivate(input2_span_it) firstprivate(dest_span_it)
-          for (int i=0; i<N; ++i) {
+#endif
+          for (int k=0; k<M; ++k) {
+            const int i = sched.getSpan(k);
+            const unsigned int first = sched.getFirst(k);
             input1_span_it.setAtIteration(i);
             input2_span_it.setAtIteration(i);
             dest_span_it.setAtIteration(i);
             //
-            functor(size,
+            functor(sched.getSize(k),
                     input1->getRawDataAccess(),
                     input1_stride,
-                    static_cast<unsigned int>(input1_span_it.getOffset()),
+                    static_cast<unsigned int>(input1_span_it.getOffset()) +
+                    first*input1_stride,
                     input2->getRawDataAccess(),
                     input2_stride,
-                    static_cast<unsigned int>(input2_span_it.getOffset()),
+                    static_cast<unsigned int>(input2_span_it.getOffset()) +
+                    first*input2_stride,
                     dest->getRawDataAccess(),
                     dest_stride,
-                    static_cast<unsigned int>(dest_span_it.getOffset()),
+                    static_cast<unsigned int>(dest_span_it.getOffset()) +
+                    first*dest_stride,
                     cuda_flag);
-          } // for every possible span
-        } // if num_threads>1 and large enough computation
+          } // for every work item
+        } // if parallel computation
         else {
-#endif
           // sequential code, with less overhead when updating iterator
           for (int i=0; i<N; ++i) {
             april_assert(input1_span_it != input1->end_span_iterator());
@@ -319,9 +372,7 @@ namespace AprilMath {
           april_assert(input1_span_it == input1->end_span_iterator());
           april_assert(input2_span_it == input2->end_span_iterator());
           april_assert(dest_span_it == dest->end_span_iterator());
-#ifndef NO_OMP
-        } // else (num_threads==1 or not large enough computation)
-#endif
+        } // else (sequential computation)
       } // General case.
       return dest;
     } // MatrixMap2 function
@@ -339,10 +390,6 @@ namespace AprilMath {
           input3->size() != dest->size()) {
         ERROR_EXIT(128, "Incompatible matrix sizes or dimensions\n");
       }
-#ifdef NO_OMP
-      UNUSED_VARIABLE(N_th);
-      UNUSED_VARIABLE(SIZE_th);
-#endif
       bool cuda_flag = input1->getCudaFlag() || input2->getCudaFlag() ||
         input3->getCudaFlag() || dest->getCudaFlag();
       // Contiguous memory block or one dimension.
@@ -363,12 +410,41 @@ namespace AprilMath {
         else input3_stride = input3->getStrideSize(0);
         if (dest->getIsContiguous()) dest_stride = 1u;
         else dest_stride = dest->getStrideSize(0);
-        functor(size,
-                input1->getRawDataAccess(), input1_stride, input1_offset,
-                input2->getRawDataAccess(), input2_stride, input2_offset,
-                input3->getRawDataAccess(), input3_stride, input3_offset,
-                dest->getRawDataAccess(), dest_stride, dest_offset,
-                cuda_flag);
+        SpanScheduler sched(1, size, cuda_flag, N_th, SIZE_th);
+        if (sched.isParallel()) {
+#ifdef USE_CUDA
+          // Forces execution of memory copy from GPU to PPAL or viceversa (if
+          // needed), avoiding race conditions on the following.
+          input1->getRawDataAccess()->forceSync(cuda_flag);
+          input2->getRawDataAccess()->forceSync(cuda_flag);
+          input3->getRawDataAccess()->forceSync(cuda_flag);
+#endif
+          const int M = sched.getNumItems();
+#ifndef NO_OMP
+#pragma omp parallel for
+#endif
+          for (int k=0; k<M; ++k) {
+            const unsigned int first = sched.getFirst(k);
+            functor(sched.getSize(k),
+                    input1->getRawDataAccess(), input1_stride,
+                    input1_offset + first*input1_stride,
+                    input2->getRawDataAccess(), input2_stride,
+                    input2_offset + first*input2_stride,
+                    input3->getRawDataAccess(), input3_stride,
+                    input3_offset + first*input3_stride,
+                    dest->getRawDataAccess(), dest_stride,
+                    dest_offset + first*dest_stride,
+                    cuda_flag);
+          } // for every chunk
+        } // if parallel computation
+        else {
+          functor(size,
+                  input1->getRawDataAccess(), input1_stride, input1_offset,
+                  input2->getRawDataAccess(), input2_stride, input2_offset,
+                  input3->getRawDataAccess(), input3_stride, input3_offset,
+                  dest->getRawDataAccess(), dest_stride, dest_offset,
+                  cuda_flag);
+        }
       }
       // General case.
       else {
@@ -400,35 +476,43 @@ namespace AprilMath {
         input2->getRawDataAccess()->forceSync(cuda_flag);
         input3->getRawDataAccess()->forceSync(cuda_flag);
 #endif
+        // The scheduler uses OMP only when the number of threads is more than
+        // 1 and the computation is large enough, splitting long spans.
+        SpanScheduler sched(N, size, cuda_flag, N_th, SIZE_th);
+        if (sched.isParallel()) {
+          const int M = sched.getNumItems();
 #ifndef NO_OMP
-        // This if controls the execution using OMP only when the number of threads
-        // is more than 1 and the iterator size is large enough.
-        if (OMPUtils::get_num_threads() > 1 && N > N_th && size > SIZE_th) {
 #pragma omp parallel for firstprivate(input1_span_it) firstprivate(input2_span_it) firstprivate(input3_span_it) firstprivate(dest_span_it)
-          for (int i=0; i<N; ++i) {
+#endif
+          for (int k=0; k<M; ++k) {
+            const int i = sched.getSpan(k);
+            const unsigned int first = sched.getFirst(k);
             input1_span_it.setAtIteration(i);
             input2_span_it.setAtIteration(i);
             input3_span_it.setAtIteration(i);
             dest_span_it.setAtIteration(i);
             //
-            functor(size,
+            functor(sched.getSize(k),
                     input1->getRawDataAccess(),
                     input1_stride,
-                    static_cast<unsigned int>(input1_span_it.getOffset()),
+                    static_cast<unsigned int>(input1_span_it.getOffset()) +
+                    first*input1_stride,
                     input2->getRawDataAccess(),
                     input2_stride,
-                    static_cast<unsigned int>(input2_span_it.getOffset()),
+                    static_cast<unsigned int>(input2_span_it.getOffset()) +
+                    first*input2_stride,
                     input3->getRawDataAccess(),
                     input3_stride,
-                    static_cast<unsigned int>(input3_span_it.getOffset()),
+                    static_cast<unsigned int>(input3_span_it.getOffset()) +
+                    first*input3_stride,
                     dest->getRawDataAccess(),
                     dest_stride,
-                    static_cast<unsigned int>(dest_span_it.getOffset()),
+                    static_cast<unsigned int>(dest_span_it.getOffset()) +
+                    first*dest_stride,
                     cuda_flag);
-          } // for every possible span
-        } // if num_threads>1 and large enough computation
+          } // for every work item
+        } // if parallel computation
         else {
-#endif
           // sequential code, with less overhead when updating iterator
           for (int i=0; i<N; ++i) {
             april_assert(input1_span_it != input1->end_span_iterator());
@@ -459,9 +543,7 @@ namespace AprilMath {
           april_assert(input2_span_it == input2->end_span_iterator());
           april_assert(input3_span_it == input3->end_span_iterator());
           april_assert(dest_span_it == dest->end_span_iterator());
-#ifndef NO_OMP
-        } // else (num_threads==1 or not large enough computation)
-#endif
+        } // else (sequential computation)
       } // General case.
       return dest;
     } // MatrixMap2 function
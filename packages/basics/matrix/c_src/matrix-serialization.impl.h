@@ -112,6 +112,17 @@ namespace Basics {
             ++data_it;
           }
         }
+      } else if (format == MatrixIO::RAW_OPTION) {
+        if (!MatrixIO::checkRawFormat<T>(line)) return 0;
+        // the whole data is read at once, it is contiguous in memory
+        size_t bytes = static_cast<size_t>(mat->size())*sizeof(T);
+        char *dest = reinterpret_cast<char*>(mat->getRawDataAccess()->
+                                             getPPALForWrite());
+        if (stream->get(dest, bytes) != bytes) {
+          ERROR_PRINT("Impossible to fill all the matrix components\n");
+          return 0;
+        }
+        return mat.weakRelease();
       } else { // binary
         while (data_it!=mat->end() && (line=readULine(stream, c_str.get()))) {
           while (data_it!=mat->end() && bin_extractor(line, *data_it)) {
@@ -125,6 +136,10 @@ namespace Basics {
         return 0;
       }
     } else { // version with comodin
+      if (format == MatrixIO::RAW_OPTION) {
+        ERROR_PRINT("Raw format needs all matrix dimensions\n");
+        return 0;
+      }
       int size=0,maxsize=4096;
       AprilUtils::UniquePtr<T []> data = new T[maxsize];
       if (format == "ascii") {
@@ -192,6 +207,11 @@ namespace Basics {
   void Matrix<T>::writeNormal(AprilIO::StreamInterface *stream,
                               const AprilUtils::LuaTable &options) {
     bool is_ascii = options.opt(MatrixIO::ASCII_OPTION, false);
+    bool is_raw   = options.opt(MatrixIO::RAW_OPTION, false);
+    if (is_raw) {
+      writeRaw(stream);
+      return;
+    }
     //
     MatrixIO::AsciiCoder<T> ascii_coder;
     MatrixIO::BinaryCoder<T> bin_coder;
@@ -265,6 +285,100 @@ namespace Basics {
     }
   }
 
+  template <typename T>
+  void Matrix<T>::writeRaw(AprilIO::StreamInterface *stream) const {
+#if APRIL_ENDIANNESS != APRIL_LITTLE_ENDIAN
+    UNUSED_VARIABLE(stream);
+    ERROR_EXIT(256, "Raw matrix format is only available in little-endian\n");
+#else
+    if (!stream->isOpened()) {
+      ERROR_EXIT(256, "The stream is not prepared\n");
+    }
+    AprilIO::CStringStream header;
+    for (int i=0;i<this->getNumDim()-1;i++) {
+      header.printf("%d ",this->getDimSize(i));
+    }
+    header.printf("%d\n",this->getDimSize(this->getNumDim()-1));
+    header.printf("raw %u le", static_cast<unsigned int>(sizeof(T)));
+    // the format line is padded with spaces to align data when the file is
+    // mmapped, the +1 accounts for the final '\n'
+    size_t len = header.size() + 1u;
+    size_t padding = (MatrixIO::RAW_ALIGNMENT -
+                      len % MatrixIO::RAW_ALIGNMENT) % MatrixIO::RAW_ALIGNMENT;
+    for (size_t i=0; i<padding; ++i) header.put(" ", 1u);
+    header.put("\n", 1u);
+    stream->put(header.getConstString(), header.size());
+    // data is written as it is in memory, which needs a contiguous matrix
+    const Matrix<T> *source = this;
+    AprilUtils::SharedPtr< Matrix<T> > aux;
+    if (!this->getIsContiguous()) {
+      aux = this->clone();
+      source = aux.get();
+    }
+    const T *ptr = source->getRawDataAccess()->getPPALForRead() +
+      source->getOffset();
+    size_t bytes = static_cast<size_t>(source->size())*sizeof(T);
+    if (stream->put(reinterpret_cast<const char*>(ptr), bytes) != bytes) {
+      ERROR_EXIT(256, "Impossible to write all the matrix components\n");
+    }
+#endif
+  }
+
+  template <typename T>
+  Matrix<T> *Matrix<T>::fromRawMMappedDataReader(AprilUtils::MMappedDataReader
+                                                 *mmapped_data) {
+    // the matrix starts at the current position, which is not the beginning
+    // of the file when several objects are stored together, so all the
+    // bounds are relative to the bytes available from there (size() is
+    // computed from the current position)
+    const size_t available = mmapped_data->size();
+    if (available == 0u) {
+      ERROR_EXIT(128, "Empty raw matrix file\n");
+    }
+    // the header is parsed directly from the mapped memory
+    const char *header = mmapped_data->get<char>(0u);
+    AprilUtils::constString buffer(header, available);
+    AprilUtils::constString line, token;
+    static const int maxdim=100;
+    int dims[maxdim];
+    int n=0;
+    line = buffer.extract_line();
+    while (n<maxdim && (token = line.extract_token())) {
+      if (!token.extract_int(&dims[n])) {
+        ERROR_EXIT1(128, "incorrect dimension %d type, expected a integer\n",
+                    n);
+      }
+      n++;
+    }
+    if (n==0 || n==maxdim) {
+      ERROR_EXIT(128, "Incorrect number of dimensions\n");
+    }
+    line = buffer.extract_line();
+    const char *line_end = static_cast<const char*>(line) + line.len();
+    if (line.extract_token() != MatrixIO::RAW_OPTION ||
+        !MatrixIO::checkRawFormat<T>(line)) {
+      ERROR_EXIT(128, "Expected a raw matrix file\n");
+    }
+    // skip the header and its final '\n'
+    size_t header_len = static_cast<size_t>(line_end - header) + 1u;
+    if (header_len >= available) {
+      ERROR_EXIT(128, "Empty raw matrix data\n");
+    }
+    mmapped_data->get<char>(header_len);
+    if ((mmapped_data->tell() % MatrixIO::RAW_ALIGNMENT) != 0u) {
+      ERROR_PRINT("Unaligned raw matrix data\n");
+    }
+    unsigned int size = 1u;
+    for (int i=0; i<n; ++i) size *= static_cast<unsigned int>(dims[i]);
+    if (available - header_len < static_cast<size_t>(size)*sizeof(T)) {
+      ERROR_EXIT(128, "Incomplete raw matrix data\n");
+    }
+    AprilMath::GPUMirroredMemoryBlock<T> *data =
+      AprilMath::GPUMirroredMemoryBlock<T>::fromMMappedDataReader(mmapped_data,
+                                                                  size);
+    return new Matrix<T>(n, dims, data);
+  }
+
   /****************************************************************/
 
   template <typename T>
@@ -50,6 +50,10 @@ namespace Basics {
     const char * const TAB_OPTION   = "tab";
     /// Boolean option key for read/write using ascii format.
     const char * const ASCII_OPTION = "ascii";
+    /// Boolean option key for read/write using raw mmap-able binary format.
+    const char * const RAW_OPTION   = "raw";
+    /// Alignment in bytes of raw format data.
+    const size_t RAW_ALIGNMENT      = 64u;
     /// String option key with a delimitiers list.
     const char * const DELIM_OPTION = "delim";
     /// Boolean option key indicating if empty fields are allowed during read.
@@ -525,6 +529,15 @@ namespace Basics {
                                             *mmapped_data);
     /// Writes to a file
     void toMMappedDataWriter(AprilUtils::MMappedDataWriter *mmapped_data) const;
+    /**
+     * @brief Constructor from a file written using MatrixIO::RAW_OPTION.
+     *
+     * The MMappedDataReader has to be built with @c has_header=false, and the
+     * Matrix data will point directly to the mapped memory, so no copy or
+     * parsing is performed.
+     */
+    static Matrix<T> *fromRawMMappedDataReader(AprilUtils::MMappedDataReader
+                                               *mmapped_data);
   
     /// For DEBUG purposes
     void print() const;
@@ -753,6 +766,12 @@ namespace Basics {
      *   value indicating if the data has to be binary or not. It uses
      *   AprilUtils::binarizer for binarization purposes. By default it is
      *   true.
+     *
+     * - MatrixIO::RAW_OPTION if @c TAB_OPTION=false this key contains a bool
+     *   value indicating if the data has to be written as raw little-endian
+     *   bytes. The header is padded to MatrixIO::RAW_ALIGNMENT bytes, so a
+     *   file containing only this matrix can be loaded using
+     *   fromRawMMappedDataReader(). By default it is false.
      */
     virtual void write(AprilIO::StreamInterface *stream,
                        const AprilUtils::LuaTable &options);
@@ -818,6 +837,8 @@ namespace Basics {
 
     void writeNormal(AprilIO::StreamInterface *stream,
                      const AprilUtils::LuaTable &options);
+
+    void writeRaw(AprilIO::StreamInterface *stream) const;
     
     void writeTab(AprilIO::StreamInterface *stream,
                   const AprilUtils::LuaTable &options);
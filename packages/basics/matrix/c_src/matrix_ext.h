@@ -27,6 +27,7 @@
 #define MATRIX_EXT_H
 #include "matrix_ext_blas.h"
 #include "matrix_ext_boolean.h"
+#include "matrix_ext_fused.h"
 #include "matrix_ext_initializers.h"
 #include "matrix_ext_lapack.h"
 #include "matrix_ext_misc.h"
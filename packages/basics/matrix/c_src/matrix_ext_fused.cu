@@ -0,0 +1,208 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include "matrix.h"
+#include "omp_utils.h"
+#include "smart_ptr.h"
+#include "vector.h"
+
+// Must be defined in this order.
+#include "matrix_ext_fused.h"
+
+#define FUSED_N_TH 100
+#define FUSED_SIZE_TH 100u
+
+using Basics::Matrix;
+
+namespace AprilMath {
+  namespace MatrixExt {
+
+    namespace Fused {
+
+      namespace {
+
+        /**
+         * Offsets of every span of a list of matrices traversed in the same
+         * order. The last matrix of the list is the reference one (the
+         * destination matrix for map operations).
+         */
+        struct FusedSpans {
+          int num_matrices;
+          int num_spans;
+          unsigned int size;
+          AprilUtils::vector<unsigned int> strides;
+          AprilUtils::vector<unsigned int> offsets; // num_spans x num_matrices
+
+          FusedSpans(const Matrix<float> * const *mats, int n) :
+            num_matrices(n), num_spans(0), size(0u), strides(n) {
+            april_assert(n > 0);
+            const Matrix<float> *ref = mats[n-1];
+            bool single_span = true;
+            for (int j=0; j<n; ++j) {
+              if (mats[j]->size() != ref->size()) {
+                ERROR_EXIT(128, "Incompatible matrix sizes or dimensions\n");
+              }
+              single_span = single_span &&
+                (mats[j]->getIsContiguous() || mats[j]->getNumDim() == 1);
+            }
+            // Contiguous memory block or one dimension.
+            if (single_span) {
+              num_spans = 1;
+              size = static_cast<unsigned int>(ref->size());
+              offsets.resize(n);
+              for (int j=0; j<n; ++j) {
+                strides[j] = (mats[j]->getIsContiguous()) ? 1u :
+                  static_cast<unsigned int>(mats[j]->getStrideSize(0));
+                offsets[j] = static_cast<unsigned int>(mats[j]->getOffset());
+              }
+            }
+            // General case.
+            else {
+              for (int j=0; j<n; ++j) {
+                if (!mats[j]->sameDim(ref)) {
+                  ERROR_EXIT(128, "Incompatible matrix sizes or dimensions\n");
+                }
+              }
+              Matrix<float>::span_iterator ref_it(ref);
+              AprilUtils::vector<Matrix<float>::span_iterator> its;
+              for (int j=0; j<n-1; ++j) {
+                its.push_back(Matrix<float>::span_iterator(mats[j],
+                                                           ref_it.getDimOrder()));
+              }
+              its.push_back(ref_it);
+              num_spans = ref_it.numberOfIterations();
+              size = static_cast<unsigned int>(ref_it.getSize());
+              for (int j=0; j<n; ++j) {
+                strides[j] = static_cast<unsigned int>(its[j].getStride());
+              }
+              offsets.resize(num_spans * n);
+              for (int i=0; i<num_spans; ++i) {
+                for (int j=0; j<n; ++j) {
+                  offsets[i*n + j] = static_cast<unsigned int>(its[j].getOffset());
+                  ++its[j];
+                }
+              }
+            }
+          }
+
+          const unsigned int *getOffsets(int span) const {
+            return &offsets[span * num_matrices];
+          }
+
+          bool useOMP() const {
+#ifndef NO_OMP
+            return OMPUtils::get_num_threads() > 1 &&
+              num_spans > FUSED_N_TH && size > FUSED_SIZE_TH;
+#else
+            return false;
+#endif
+          }
+        }; // struct FusedSpans
+
+        void checkProgram(const FusedProgram *prog) {
+          if (prog == 0) ERROR_EXIT(128, "Given a NULL fused program\n");
+          if (!prog->isValid()) ERROR_EXIT(128, "Incomplete fused program\n");
+        }
+
+      } // anonymous namespace
+
+      Matrix<float> *matFusedMap(const FusedProgram *prog,
+                                 const Matrix<float> * const *inputs,
+                                 Matrix<float> *dest) {
+        checkProgram(prog);
+        if (prog->isReduction()) {
+          ERROR_EXIT(128, "Unable to map a fused program with reduction\n");
+        }
+        if (dest == 0) ERROR_EXIT(128, "Given a NULL destination matrix\n");
+        const int n = prog->getNumInputs();
+        AprilUtils::vector<const Matrix<float>*> mats(n+1);
+        bool dest_is_input = false;
+        for (int j=0; j<n; ++j) {
+          mats[j] = inputs[j];
+          if (inputs[j] == 0) ERROR_EXIT(128, "Given a NULL input matrix\n");
+          dest_is_input = dest_is_input ||
+            (inputs[j]->getRawDataAccess() == dest->getRawDataAccess());
+        }
+        mats[n] = dest;
+        FusedSpans spans(mats.begin(), n+1);
+        // Host memory pointers, it forces the synchronization of CUDA memory.
+        AprilUtils::vector<const float*> ptrs(n);
+        for (int j=0; j<n; ++j) {
+          ptrs[j] = inputs[j]->getRawDataAccess()->getPPALForRead();
+        }
+        float *dest_ptr = (dest_is_input) ?
+          dest->getRawDataAccess()->getPPALForReadAndWrite() :
+          dest->getRawDataAccess()->getPPALForWrite();
+        const unsigned int *strides = spans.strides.begin();
+#ifndef NO_OMP
+#pragma omp parallel for if(spans.useOMP())
+#endif
+        for (int i=0; i<spans.num_spans; ++i) {
+          const unsigned int *offsets = spans.getOffsets(i);
+          AprilUtils::UniquePtr<const float *[]> span_ptrs(new const float*[n+1]);
+          for (int j=0; j<n; ++j) span_ptrs[j] = ptrs[j] + offsets[j];
+          prog->evalSpan(spans.size, span_ptrs.get(), strides,
+                         dest_ptr + offsets[n], strides[n]);
+        }
+        return dest;
+      }
+
+      float matFusedReduce(const FusedProgram *prog,
+                           const Matrix<float> * const *inputs) {
+        checkProgram(prog);
+        if (!prog->isReduction()) {
+          ERROR_EXIT(128, "Unable to reduce a fused program without reduction\n");
+        }
+        const int n = prog->getNumInputs();
+        if (n < 1) ERROR_EXIT(128, "Needs at least one input to reduce\n");
+        for (int j=0; j<n; ++j) {
+          if (inputs[j] == 0) ERROR_EXIT(128, "Given a NULL input matrix\n");
+        }
+        FusedSpans spans(inputs, n);
+        AprilUtils::vector<const float*> ptrs(n);
+        for (int j=0; j<n; ++j) {
+          ptrs[j] = inputs[j]->getRawDataAccess()->getPPALForRead();
+        }
+        const float zero = FusedProgram::getReduceZero(prog->getReduction());
+        AprilUtils::vector<float> partials(spans.num_spans, zero);
+        const unsigned int *strides = spans.strides.begin();
+#ifndef NO_OMP
+#pragma omp parallel for if(spans.useOMP())
+#endif
+        for (int i=0; i<spans.num_spans; ++i) {
+          const unsigned int *offsets = spans.getOffsets(i);
+          AprilUtils::UniquePtr<const float *[]> span_ptrs(new const float*[n]);
+          for (int j=0; j<n; ++j) span_ptrs[j] = ptrs[j] + offsets[j];
+          prog->reduceSpan(spans.size, span_ptrs.get(), strides, partials[i]);
+        }
+        float result = zero;
+        for (int i=0; i<spans.num_spans; ++i) {
+          prog->reducePartials(result, partials[i]);
+        }
+        return result;
+      }
+
+    } // namespace Fused
+
+  } // namespace MatrixExt
+} // namespace AprilMath
+
+#undef FUSED_N_TH
+#undef FUSED_SIZE_TH
@@ -0,0 +1,78 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include "matrix_ext.h"
+#ifndef MATRIX_EXT_FUSED_H
+#define MATRIX_EXT_FUSED_H
+
+#include "fused_program.h"
+
+namespace AprilMath {
+
+  namespace MatrixExt {
+
+    /**
+     * @brief Fused element-wise operations over Matrix instances.
+     *
+     * These functions traverse a list of matrices with the same shape and
+     * evaluate an AprilMath::FusedProgram over them, so a chain of map
+     * operations (optionally followed by a reduction) costs only one memory
+     * pass instead of one pass per operation.
+     *
+     * @see AprilMath::FusedProgram
+     */
+    namespace Fused {
+
+      /**
+       * @brief Evaluates a map FusedProgram and writes its result into dest.
+       *
+       * @param prog - The program, it must not have a trailing reduction.
+       * @param inputs - An array with @c prog->getNumInputs() matrices, all of
+       * them with the same shape as @c dest.
+       * @param dest - The destination matrix, it can be one of the inputs.
+       *
+       * @return The given @c dest matrix.
+       */
+      Basics::Matrix<float> *matFusedMap(const FusedProgram *prog,
+                                         const Basics::Matrix<float> * const *inputs,
+                                         Basics::Matrix<float> *dest);
+
+      /**
+       * @brief Evaluates a FusedProgram with a trailing reduction.
+       *
+       * @param prog - The program, it must have a trailing reduction.
+       * @param inputs - An array with @c prog->getNumInputs() matrices, all of
+       * them with the same shape, at least one input is needed.
+       *
+       * @return The reduced value.
+       *
+       * @note The result is independent of the number of OMP threads because
+       * partial results are computed per span and combined in order.
+       */
+      float matFusedReduce(const FusedProgram *prog,
+                           const Basics::Matrix<float> * const *inputs);
+
+    } // namespace Fused
+
+  } // namespace MatrixExt
+
+} // namespace AprilMath
+
+#endif // MATRIX_EXT_FUSED_H
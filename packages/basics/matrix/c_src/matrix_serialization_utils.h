@@ -21,6 +21,7 @@
  */
 #ifndef MATRIX_SERIALIZATION_UTILS_H
 #define MATRIX_SERIALIZATION_UTILS_H
+#include "april_endian.h"
 #include "constString.h"
 #include "error_print.h"
 #include "stream.h"
@@ -150,6 +151,31 @@ namespace Basics {
         return -1;
       }
     };
+
+    /**
+     * Checks the tokens which follow "raw" at the format line of raw matrix
+     * files, the size in bytes of T and the endianness of the data. Returns
+     * true if the data can be used as is in this host.
+     */
+    template <typename T>
+    bool checkRawFormat(AprilUtils::constString &line) {
+      unsigned int elem_size;
+      if (!line.extract_unsigned_int(&elem_size) || elem_size != sizeof(T)) {
+        ERROR_PRINT1("Incorrect raw element size, expected %u bytes\n",
+                     static_cast<unsigned int>(sizeof(T)));
+        return false;
+      }
+      AprilUtils::constString endianness = line.extract_token();
+#if APRIL_ENDIANNESS == APRIL_LITTLE_ENDIAN
+      if (endianness != "le") {
+#else
+      {
+#endif
+        ERROR_PRINT("Raw matrix data is only supported in little-endian\n");
+        return false;
+      }
+      return true;
+    }
   } // namespace MatrixIO
 } // namespace Basics
 
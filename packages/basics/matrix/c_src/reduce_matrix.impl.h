@@ -29,6 +29,8 @@
 #include "reduce_matrix.h"
 #include "reduce_template.h"
 #include "smart_ptr.h"
+#include "span_scheduler.h"
+#include "vector.h"
 
 namespace AprilMath {
 
@@ -288,6 +290,128 @@ namespace AprilMath {
       return result.weakRelease();
     }
     
+    /**
+     * @brief Computes the offsets of all the spans of the given matrix.
+     *
+     * @return The stride of the spans.
+     */
+    template<typename T>
+    unsigned int computeSpanOffsets(const Basics::Matrix<T> *input,
+                                    AprilUtils::vector<unsigned int> &offsets) {
+      typename Basics::Matrix<T>::span_iterator span_it(input);
+      const int N = span_it.numberOfIterations();
+      offsets.resize(N);
+      for (int i=0; i<N; ++i) {
+        april_assert(span_it != input->end_span_iterator());
+        offsets[i] = static_cast<unsigned int>(span_it.getOffset());
+        ++span_it;
+      }
+      return static_cast<unsigned int>(span_it.getStride());
+    }
+
+    /**
+     * @brief Computes a span-based reduction split into the work items given
+     * by a SpanScheduler.
+     *
+     * The partial result of every item is computed independently (in
+     * parallel if the scheduler says so), and partials are reduced in order
+     * using @c intra_span_red_functor, so the result doesn't depend on the
+     * number of threads.
+     *
+     * @note Only for CPU computation.
+     */
+    template<typename T, typename O, typename OP1, typename OP2>
+    void MatrixSpanReduce1Scheduled(const Basics::Matrix<T> *input,
+                                    const SpanScheduler &sched,
+                                    const unsigned int *offsets,
+                                    unsigned int stride,
+                                    const OP1 &inter_span_red_functor,
+                                    const OP2 &intra_span_red_functor,
+                                    const O &zero,
+                                    AprilMath::GPUMirroredMemoryBlock<O> *dest,
+                                    unsigned int dest_raw_pos,
+                                    bool set_dest_to_zero) {
+      const int M = sched.getNumItems();
+      april_assert(M > 0);
+      AprilMath::GPUMirroredMemoryBlock<O> partials(static_cast<unsigned int>(M));
+#ifdef USE_CUDA
+      // Forces execution of memory copy from GPU to PPAL or viceversa (if
+      // needed), avoiding race conditions on the following.
+      input->getRawDataAccess()->forceSync(false);
+      partials.getPPALForWrite();
+#endif
+#ifndef NO_OMP
+#pragma omp parallel for if(sched.isParallel())
+#endif
+      for (int k=0; k<M; ++k) {
+        inter_span_red_functor(sched.getSize(k),
+                               input->getRawDataAccess(),
+                               stride,
+                               offsets[sched.getSpan(k)] + sched.getFirst(k)*stride,
+                               false,
+                               zero, intra_span_red_functor,
+                               &partials, static_cast<unsigned int>(k),
+                               true);
+      }
+      const O *partials_ptr = partials.getPPALForRead();
+      O result;
+      int k = 0;
+      if (set_dest_to_zero) result = partials_ptr[k++];
+      else dest->getValue(dest_raw_pos, result);
+      for (; k<M; ++k) intra_span_red_functor(result, partials_ptr[k]);
+      dest->putValue(dest_raw_pos, result);
+    }
+
+    /// @see MatrixSpanReduce1Scheduled
+    template<typename T1, typename T2, typename O, typename OP1, typename OP2>
+    void MatrixSpanReduce2Scheduled(const Basics::Matrix<T1> *input1,
+                                    const Basics::Matrix<T2> *input2,
+                                    const SpanScheduler &sched,
+                                    const unsigned int *offsets1,
+                                    unsigned int stride1,
+                                    const unsigned int *offsets2,
+                                    unsigned int stride2,
+                                    const OP1 &inter_span_red_functor,
+                                    const OP2 &intra_span_red_functor,
+                                    const O &zero,
+                                    AprilMath::GPUMirroredMemoryBlock<O> *dest,
+                                    unsigned int dest_raw_pos,
+                                    bool set_dest_to_zero) {
+      const int M = sched.getNumItems();
+      april_assert(M > 0);
+      AprilMath::GPUMirroredMemoryBlock<O> partials(static_cast<unsigned int>(M));
+#ifdef USE_CUDA
+      // Forces execution of memory copy from GPU to PPAL or viceversa (if
+      // needed), avoiding race conditions on the following.
+      input1->getRawDataAccess()->forceSync(false);
+      input2->getRawDataAccess()->forceSync(false);
+      partials.getPPALForWrite();
+#endif
+#ifndef NO_OMP
+#pragma omp parallel for if(sched.isParallel())
+#endif
+      for (int k=0; k<M; ++k) {
+        const int i = sched.getSpan(k);
+        const unsigned int first = sched.getFirst(k);
+        inter_span_red_functor(sched.getSize(k),
+                               input1->getRawDataAccess(),
+                               stride1, offsets1[i] + first*stride1,
+                               input2->getRawDataAccess(),
+                               stride2, offsets2[i] + first*stride2,
+                               false,
+                               zero, intra_span_red_functor,
+                               &partials, static_cast<unsigned int>(k),
+                               true);
+      }
+      const O *partials_ptr = partials.getPPALForRead();
+      O result;
+      int k = 0;
+      if (set_dest_to_zero) result = partials_ptr[k++];
+      else dest->getValue(dest_raw_pos, result);
+      for (; k<M; ++k) intra_span_red_functor(result, partials_ptr[k]);
+      dest->putValue(dest_raw_pos, result);
+    }
+
     template<typename T, typename OP>
     void MatrixScalarSumReduce1(const Basics::Matrix<T> *input,
                                 const OP &scalar_red_functor,
@@ -297,8 +421,8 @@ namespace AprilMath {
                                 int N_th, unsigned int SIZE_th) {
       ScalarToSpanReduce1<T,T,OP> span_functor(scalar_red_functor);
       MatrixSpanSumReduce1(input, span_functor, dest, dest_raw_pos,
-                           N_th, SIZE_th,
-                           set_dest_to_zero);
+                           set_dest_to_zero,
+                           N_th, SIZE_th);
     }
 
     template<typename T, typename OP>
@@ -310,8 +434,8 @@ namespace AprilMath {
                                  int N_th, unsigned int SIZE_th) {
       ScalarToSpanReduce1<T,T,OP> span_functor(scalar_red_functor);
       MatrixSpanProdReduce1(input, span_functor, dest, dest_raw_pos,
-                            N_th, SIZE_th,
-                            set_dest_to_one);
+                            set_dest_to_one,
+                            N_th, SIZE_th);
     }
     
     template<typename T, typename O, typename OP1, typename OP2>
@@ -350,13 +474,22 @@ namespace AprilMath {
           // One dimension.
           input_stride = static_cast<unsigned int>(input->getStrideSize(0));
         }
-        inter_span_red_functor(size,
-                               input->getRawDataAccess(),
-                               input_stride, input_offset,
-                               cuda_flag,
-                               zero, intra_span_red_functor,
-                               dest, dest_raw_pos,
-                               set_dest_to_zero);
+        SpanScheduler sched(1, size, cuda_flag);
+        if (sched.isChunked()) {
+          MatrixSpanReduce1Scheduled(input, sched, &input_offset, input_stride,
+                                     inter_span_red_functor,
+                                     intra_span_red_functor, zero,
+                                     dest, dest_raw_pos, set_dest_to_zero);
+        }
+        else {
+          inter_span_red_functor(size,
+                                 input->getRawDataAccess(),
+                                 input_stride, input_offset,
+                                 cuda_flag,
+                                 zero, intra_span_red_functor,
+                                 dest, dest_raw_pos,
+                                 set_dest_to_zero);
+        }
       }
       // General case
       else {
@@ -364,20 +497,31 @@ namespace AprilMath {
         unsigned int size   = static_cast<unsigned int>(span_it.getSize());
         unsigned int stride = static_cast<unsigned int>(span_it.getStride());
         const int N = span_it.numberOfIterations();
-        for (int i=0; i<N; ++i) {
-          april_assert(span_it != input->end_span_iterator());
-          inter_span_red_functor(size,
-                                 input->getRawDataAccess(),
-                                 stride,
-                                 span_it.getOffset(),
-                                 cuda_flag,
-                                 zero, intra_span_red_functor,
-                                 dest, dest_raw_pos,
-                                 set_dest_to_zero);
-          set_dest_to_zero = false; // use only in the first iteration
-          ++span_it;
+        SpanScheduler sched(N, size, cuda_flag);
+        if (!cuda_flag && (sched.isChunked() || sched.isParallel())) {
+          AprilUtils::vector<unsigned int> offsets;
+          computeSpanOffsets(input, offsets);
+          MatrixSpanReduce1Scheduled(input, sched, offsets.begin(), stride,
+                                     inter_span_red_functor,
+                                     intra_span_red_functor, zero,
+                                     dest, dest_raw_pos, set_dest_to_zero);
+        }
+        else {
+          for (int i=0; i<N; ++i) {
+            april_assert(span_it != input->end_span_iterator());
+            inter_span_red_functor(size,
+                                   input->getRawDataAccess(),
+                                   stride,
+                                   span_it.getOffset(),
+                                   cuda_flag,
+                                   zero, intra_span_red_functor,
+                                   dest, dest_raw_pos,
+                                   set_dest_to_zero);
+            set_dest_to_zero = false; // use only in the first iteration
+            ++span_it;
+          }
+          april_assert(span_it == input->end_span_iterator());
         }
-        april_assert(span_it == input->end_span_iterator());
       }
     } // function MatrixSpanReduce1
 
@@ -432,10 +576,6 @@ namespace AprilMath {
                               unsigned int SIZE_th) {
       april_assert(input != 0);
       if (dest == 0) ERROR_EXIT(128, "Expected a non-NULL dest pointer\n");
-#ifdef NO_OMP
-      UNUSED_VARIABLE(N_th);
-      UNUSED_VARIABLE(SIZE_th);
-#endif
       bool cuda_flag = input->getCudaFlag();
       // Contiguous memory block or one dimension.
       if (input->getIsContiguous() || input->getNumDim() == 1) {
@@ -450,14 +590,24 @@ namespace AprilMath {
           // One dimension.
           input_stride = static_cast<unsigned int>(input->getStrideSize(0));
         }
-        inter_span_red_functor(size,
-                               input->getRawDataAccess(),
-                               input_stride, input_offset,
-                               cuda_flag,
-                               AprilMath::Limits<T>::zero(),
-                               AprilMath::Functors::r_add<T,T>(),
-                               dest, dest_raw_pos,
-                               set_dest_to_zero);
+        SpanScheduler sched(1, size, cuda_flag, N_th, SIZE_th);
+        if (sched.isChunked()) {
+          MatrixSpanReduce1Scheduled(input, sched, &input_offset, input_stride,
+                                     inter_span_red_functor,
+                                     AprilMath::Functors::r_add<T,T>(),
+                                     AprilMath::Limits<T>::zero(),
+                                     dest, dest_raw_pos, set_dest_to_zero);
+        }
+        else {
+          inter_span_red_functor(size,
+                                 input->getRawDataAccess(),
+                                 input_stride, input_offset,
+                                 cuda_flag,
+                                 AprilMath::Limits<T>::zero(),
+                                 AprilMath::Functors::r_add<T,T>(),
+                                 dest, dest_raw_pos,
+                                 set_dest_to_zero);
+        }
       }
       // General case
       else {
@@ -465,38 +615,19 @@ namespace AprilMath {
         unsigned int size   = static_cast<unsigned int>(span_it.getSize());
         unsigned int stride = static_cast<unsigned int>(span_it.getStride());
         const int N = span_it.numberOfIterations();
-#ifndef NO_OMP
-        // this if controls the execution using OMP only when the number of threads
-        // is more than 1 and the iterator size is big enough
-        if (OMPUtils::get_num_threads() > 1 && N > N_th && size > SIZE_th) {
-          T result;
-          if (set_dest_to_zero) result = AprilMath::Limits<T>::zero();
-          else dest->getValue(dest_raw_pos, result);
-          GPUMirroredMemoryBlock<T> aux(1);
-          T partial;
-#ifdef USE_CUDA
-          // Forces execution of memory copy from GPU to PPAL or viceversa (if
-          // needed), avoiding race conditions on the following.
-          input->getRawDataAccess()->forceSync(cuda_flag);
-#endif
-#pragma omp parallel for reduction(+:result) firstprivate(span_it)
-          for (int i=0; i<N; ++i) {
-            span_it.setAtIteration(i);
-            inter_span_red_functor(size,
-                                   input->getRawDataAccess(),
-                                   stride,
-                                   span_it.getOffset(),
-                                   cuda_flag,
-                                   AprilMath::Limits<T>::zero(),
-                                   AprilMath::Functors::r_add<T,T>(),
-                                   &aux, 0, true);
-            aux.getValue(0, partial);
-            result += partial;
-          }
-          dest->putValue(dest_raw_pos, result);
+        // The scheduler splits the computation when it is large enough, and
+        // uses OMP only when the number of threads is more than 1.
+        SpanScheduler sched(N, size, cuda_flag, N_th, SIZE_th);
+        if (!cuda_flag && (sched.isChunked() || sched.isParallel())) {
+          AprilUtils::vector<unsigned int> offsets;
+          computeSpanOffsets(input, offsets);
+          MatrixSpanReduce1Scheduled(input, sched, offsets.begin(), stride,
+                                     inter_span_red_functor,
+                                     AprilMath::Functors::r_add<T,T>(),
+                                     AprilMath::Limits<T>::zero(),
+                                     dest, dest_raw_pos, set_dest_to_zero);
         }
         else {
-#endif
           for (int i=0; i<N; ++i) {
             april_assert(span_it != input->end_span_iterator());
             inter_span_red_functor(size,
@@ -512,9 +643,7 @@ namespace AprilMath {
             ++span_it;
           }
           april_assert(span_it == input->end_span_iterator());
-#ifndef NO_OMP
         }
-#endif
       } // General case
     } // function MatrixSpanSumReduce1
 
@@ -528,10 +657,6 @@ namespace AprilMath {
                                unsigned int SIZE_th) {
       april_assert(input != 0);
       if (dest == 0) ERROR_EXIT(128, "Expected a non-NULL dest pointer\n");
-#ifdef NO_OMP
-      UNUSED_VARIABLE(N_th);
-      UNUSED_VARIABLE(SIZE_th);
-#endif
       bool cuda_flag = input->getCudaFlag();
       // Contiguous memory block or one dimension.
       if (input->getIsContiguous() || input->getNumDim() == 1) {
@@ -546,14 +671,24 @@ namespace AprilMath {
           // One dimension.
           input_stride = static_cast<unsigned int>(input->getStrideSize(0));
         }
-        inter_span_red_functor(size,
-                               input->getRawDataAccess(),
-                               input_stride, input_offset,
-                               cuda_flag,
-                               AprilMath::Limits<T>::one(),
-                               AprilMath::Functors::r_mul<T,T>(),
-                               dest, dest_raw_pos,
-                               set_dest_to_one);
+        SpanScheduler sched(1, size, cuda_flag, N_th, SIZE_th);
+        if (sched.isChunked()) {
+          MatrixSpanReduce1Scheduled(input, sched, &input_offset, input_stride,
+                                     inter_span_red_functor,
+                                     AprilMath::Functors::r_mul<T,T>(),
+                                     AprilMath::Limits<T>::one(),
+                                     dest, dest_raw_pos, set_dest_to_one);
+        }
+        else {
+          inter_span_red_functor(size,
+                                 input->getRawDataAccess(),
+                                 input_stride, input_offset,
+                                 cuda_flag,
+                                 AprilMath::Limits<T>::one(),
+                                 AprilMath::Functors::r_mul<T,T>(),
+                                 dest, dest_raw_pos,
+                                 set_dest_to_one);
+        }
       }
       // General case
       else {
@@ -561,38 +696,19 @@ namespace AprilMath {
         unsigned int size   = static_cast<unsigned int>(span_it.getSize());
         unsigned int stride = static_cast<unsigned int>(span_it.getStride());
         const int N = span_it.numberOfIterations();
-#ifndef NO_OMP
-        // this if controls the execution using OMP only when the number of threads
-        // is more than 1 and the iterator size is big enough
-        if (OMPUtils::get_num_threads() > 1 && N > N_th && size > SIZE_th) {
-          T result;
-          if (set_dest_to_one) result = AprilMath::Limits<T>::one();
-          else dest->getValue(dest_raw_pos, result);
-          GPUMirroredMemoryBlock<T> aux(1);
-          T partial;
-#ifdef USE_CUDA
-          // Forces execution of memory copy from GPU to PPAL or viceversa (if
-          // needed), avoiding race conditions on the following.
-          input->getRawDataAccess()->forceSync(cuda_flag);
-#endif
-#pragma omp parallel for reduction(*:result) firstprivate(span_it)
-          for (int i=0; i<N; ++i) {
-            span_it.setAtIteration(i);
-            inter_span_red_functor(size,
-                                   input->getRawDataAccess(),
-                                   stride,
-                                   span_it.getOffset(),
-                                   cuda_flag,
-                                   AprilMath::Limits<T>::one(),
-                                   AprilMath::Functors::r_mul<T,T>(),
-                                   &aux, 0, true);
-            aux.getValue(0, partial);
-            result *= partial;
-          }
-          dest->putValue(dest_raw_pos, result);
+        // The scheduler splits the computation when it is large enough, and
+        // uses OMP only when the number of threads is more than 1.
+        SpanScheduler sched(N, size, cuda_flag, N_th, SIZE_th);
+        if (!cuda_flag && (sched.isChunked() || sched.isParallel())) {
+          AprilUtils::vector<unsigned int> offsets;
+          computeSpanOffsets(input, offsets);
+          MatrixSpanReduce1Scheduled(input, sched, offsets.begin(), stride,
+                                     inter_span_red_functor,
+                                     AprilMath::Functors::r_mul<T,T>(),
+                                     AprilMath::Limits<T>::one(),
+                                     dest, dest_raw_pos, set_dest_to_one);
         }
         else {
-#endif
           for (int i=0; i<N; ++i) {
             april_assert(span_it != input->end_span_iterator());
             inter_span_red_functor(size,
@@ -608,9 +724,7 @@ namespace AprilMath {
             ++span_it;
           }
           april_assert(span_it == input->end_span_iterator());
-#ifndef NO_OMP
         }
-#endif
       } // General case
     } // function MatrixSpanProdReduce1
 
@@ -664,15 +778,26 @@ namespace AprilMath {
           // One dimension.
           input2_stride = static_cast<unsigned int>(input2->getStrideSize(0));
         }
-        inter_span_red_functor(size,
-                               input1->getRawDataAccess(),
-                               input1_stride, input1_offset,
-                               input2->getRawDataAccess(),
-                               input2_stride, input2_offset,
-                               cuda_flag,
-                               zero, intra_span_red_functor,
-                               dest, dest_raw_pos,
-                               set_dest_to_zero);
+        SpanScheduler sched(1, size, cuda_flag);
+        if (sched.isChunked()) {
+          MatrixSpanReduce2Scheduled(input1, input2, sched,
+                                     &input1_offset, input1_stride,
+                                     &input2_offset, input2_stride,
+                                     inter_span_red_functor,
+                                     intra_span_red_functor, zero,
+                                     dest, dest_raw_pos, set_dest_to_zero);
+        }
+        else {
+          inter_span_red_functor(size,
+                                 input1->getRawDataAccess(),
+                                 input1_stride, input1_offset,
+                                 input2->getRawDataAccess(),
+                                 input2_stride, input2_offset,
+                                 cuda_flag,
+                                 zero, intra_span_red_functor,
+                                 dest, dest_raw_pos,
+                                 set_dest_to_zero);
+        }
       }
       // General case
       else {
@@ -684,26 +809,40 @@ namespace AprilMath {
         const unsigned int input1_stride = static_cast<unsigned int>(input1_span_it.getStride());
         const unsigned int input2_stride = static_cast<unsigned int>(input2_span_it.getStride());
         april_assert(size == static_cast<unsigned int>(input2_span_it.getSize()));
-        for (int i=0; i<N; ++i) {
-          april_assert(input1_span_it != input1->end_span_iterator());
-          april_assert(input2_span_it != input2->end_span_iterator());
-          inter_span_red_functor(size,
-                                 input1->getRawDataAccess(),
-                                 input1_stride,
-                                 input1_span_it.getOffset(),
-                                 input2->getRawDataAccess(),
-                                 input2_stride,
-                                 input2_span_it.getOffset(),
-                                 cuda_flag,
-                                 zero, intra_span_red_functor,
-                                 dest, dest_raw_pos,
-                                 set_dest_to_zero);
-          set_dest_to_zero = false; // use only in the first iteration
-          ++input1_span_it;
-          ++input2_span_it;
+        SpanScheduler sched(N, size, cuda_flag);
+        if (!cuda_flag && (sched.isChunked() || sched.isParallel())) {
+          AprilUtils::vector<unsigned int> offsets1, offsets2;
+          computeSpanOffsets(input1, offsets1);
+          computeSpanOffsets(input2, offsets2);
+          MatrixSpanReduce2Scheduled(input1, input2, sched,
+                                     offsets1.begin(), input1_stride,
+                                     offsets2.begin(), input2_stride,
+                                     inter_span_red_functor,
+                                     intra_span_red_functor, zero,
+                                     dest, dest_raw_pos, set_dest_to_zero);
+        }
+        else {
+          for (int i=0; i<N; ++i) {
+            april_assert(input1_span_it != input1->end_span_iterator());
+            april_assert(input2_span_it != input2->end_span_iterator());
+            inter_span_red_functor(size,
+                                   input1->getRawDataAccess(),
+                                   input1_stride,
+                                   input1_span_it.getOffset(),
+                                   input2->getRawDataAccess(),
+                                   input2_stride,
+                                   input2_span_it.getOffset(),
+                                   cuda_flag,
+                                   zero, intra_span_red_functor,
+                                   dest, dest_raw_pos,
+                                   set_dest_to_zero);
+            set_dest_to_zero = false; // use only in the first iteration
+            ++input1_span_it;
+            ++input2_span_it;
+          }
+          april_assert(input1_span_it == input1->end_span_iterator());
+          april_assert(input2_span_it == input2->end_span_iterator());
         }
-        april_assert(input1_span_it == input1->end_span_iterator());
-        april_assert(input2_span_it == input2->end_span_iterator());
       }
     } // function MatrixSpanReduce2
 
@@ -0,0 +1,130 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef SPAN_SCHEDULER_H
+#define SPAN_SCHEDULER_H
+
+#include "omp_utils.h"
+#include "unused_variable.h"
+
+/// Chunk sizes are rounded to this number of elements (a cache line of floats).
+#define SPAN_SCHEDULER_ALIGN 16u
+
+namespace AprilMath {
+
+  namespace MatrixExt {
+
+    /**
+     * @brief Splits the spans of a map/reduce operation into parallel work
+     * items.
+     *
+     * When the operation is in CPU and it has at least
+     * OMPUtils::get_parallel_threshold() elements, every span is split in
+     * chunks of around OMPUtils::get_grain_size() elements. So, the work is
+     * distributed across spans and within a span, and a matrix with a few long
+     * spans scales with the number of cores as well as a matrix with many
+     * short spans. Otherwise, the classical rule is followed: one work item
+     * per span, computed in parallel only if @c N>N_th and @c size>SIZE_th.
+     *
+     * The items decomposition depends on the matrix shape and the grain size,
+     * but not on the number of threads, so reductions which combine the
+     * partial result of every item in order are deterministic.
+     *
+     * @note CUDA operations are never split within a span.
+     */
+    class SpanScheduler {
+    public:
+      /**
+       * @param N - Number of spans.
+       * @param size - Size of every span.
+       * @param cuda_flag - Indicates if the operation is computed with CUDA.
+       * @param N_th - Minimum number of spans for span level parallelism.
+       * @param SIZE_th - Minimum span size for span level parallelism.
+       */
+      SpanScheduler(int N, unsigned int size, bool cuda_flag,
+                    int N_th = 100, unsigned int SIZE_th = 100u) :
+        size(size), chunks_per_span(1), chunk_size(size),
+        num_items(N), chunked(false), parallel(false) {
+        const size_t total = static_cast<size_t>(N) * size;
+        if (!cuda_flag && total > 0u &&
+            total >= OMPUtils::get_parallel_threshold()) {
+          const unsigned int grain = OMPUtils::get_grain_size();
+          chunks_per_span = (size + grain - 1u) / grain;
+          chunk_size = (size + chunks_per_span - 1u) / chunks_per_span;
+          chunk_size = ( (chunk_size + SPAN_SCHEDULER_ALIGN - 1u) /
+                         SPAN_SCHEDULER_ALIGN ) * SPAN_SCHEDULER_ALIGN;
+          chunks_per_span = (size + chunk_size - 1u) / chunk_size;
+          num_items = N * static_cast<int>(chunks_per_span);
+          chunked = true;
+        }
+#ifndef NO_OMP
+        parallel = OMPUtils::get_num_threads() > 1 && num_items > 1 &&
+          (chunked || (N > N_th && size > SIZE_th));
+#else
+        UNUSED_VARIABLE(N_th);
+        UNUSED_VARIABLE(SIZE_th);
+#endif
+      }
+
+      /// Number of work items.
+      int getNumItems() const { return num_items; }
+
+      /// Indicates if the work items will be computed using OMP.
+      bool isParallel() const { return parallel; }
+
+      /**
+       * @brief Indicates if the operation has been split into chunks. In
+       * this case reductions must compute a partial result per item, in
+       * order to be deterministic.
+       */
+      bool isChunked() const { return chunked; }
+
+      /// The span index of the given work item.
+      int getSpan(int item) const {
+        return item / static_cast<int>(chunks_per_span);
+      }
+
+      /// Position of the first element of the given item in its span.
+      unsigned int getFirst(int item) const {
+        return (static_cast<unsigned int>(item) % chunks_per_span) * chunk_size;
+      }
+
+      /// Number of elements of the given item.
+      unsigned int getSize(int item) const {
+        const unsigned int first = getFirst(item);
+        return (size - first < chunk_size) ? (size - first) : chunk_size;
+      }
+
+    private:
+      unsigned int size;
+      unsigned int chunks_per_span;
+      unsigned int chunk_size;
+      int num_items;
+      bool chunked;
+      bool parallel;
+    }; // class SpanScheduler
+
+  } // namespace MatrixExt
+
+} // namespace AprilMath
+
+#undef SPAN_SCHEDULER_ALIGN
+
+#endif // SPAN_SCHEDULER_H
@@ -0,0 +1,147 @@
+-- Fused element-wise expressions. The user function receives symbolic
+-- placeholders instead of matrices, and the expression tree built with them is
+-- compiled into a matrix.__fused_program__ which evaluates the whole chain of
+-- operations in one memory pass.
+do
+  local fused_program = matrix.__fused_program__
+  local node_methods = {}
+  local node_mt = { __index = node_methods }
+
+  local function is_node(x) return getmetatable(x) == node_mt end
+
+  local function make_node(op, ...)
+    return setmetatable({ op = op, n = select('#', ...), ... }, node_mt)
+  end
+
+  local function to_node(x)
+    if is_node(x) then return x end
+    assert(type(x) == "number", "Expected a number or a fused expression")
+    return setmetatable({ op = "const", value = x, n = 0 }, node_mt)
+  end
+
+  local function check_not_reduced(...)
+    for i=1,select('#', ...) do
+      local x = select(i, ...)
+      assert(not is_node(x) or not x.reduction,
+             "Reductions are only allowed as the last fused operation")
+    end
+  end
+
+  local function unary(op)
+    return function(a)
+      check_not_reduced(a)
+      return make_node(op, to_node(a))
+    end
+  end
+
+  local function binary(op)
+    return function(a, b)
+      check_not_reduced(a, b)
+      return make_node(op, to_node(a), to_node(b))
+    end
+  end
+
+  for _,op in ipairs{ "exp", "expm1", "log", "log1p", "sqrt", "abs", "sign",
+                      "tanh", "logistic", "log_logistic", "softplus", "relu",
+                      "sin", "cos", "floor", "ceil", "round", "complement",
+                      "square", "inv" } do
+    node_methods[op] = unary(op)
+  end
+  node_methods.neg = unary("neg")
+  node_methods.lt  = binary("lt")
+  node_methods.gt  = binary("gt")
+  node_methods.eq  = binary("eq")
+  node_methods.add = binary("add")
+  node_methods.mul = binary("mul")
+  node_methods.pow = function(a, b)
+    if b == 2 then return unary("square")(a)
+    elseif b == 0.5 then return unary("sqrt")(a)
+    else return binary("pow")(a, b)
+    end
+  end
+  node_methods.clamp = function(a, lower, upper)
+    check_not_reduced(a, lower, upper)
+    return make_node("clamp", to_node(a), to_node(lower), to_node(upper))
+  end
+  node_methods.select = function(cond, a, b)
+    check_not_reduced(cond, a, b)
+    return make_node("select", to_node(cond), to_node(a), to_node(b))
+  end
+
+  local function reduction(op)
+    return function(a)
+      check_not_reduced(a)
+      local r = make_node(nil, a)
+      r.reduction = op
+      return r
+    end
+  end
+  node_methods.sum  = reduction("sum")
+  node_methods.prod = reduction("prod")
+  -- max and min are binary with an argument, and reductions without it
+  node_methods.max = function(a, b)
+    if b == nil then return reduction("max")(a) end
+    return binary("max")(a, b)
+  end
+  node_methods.min = function(a, b)
+    if b == nil then return reduction("min")(a) end
+    return binary("min")(a, b)
+  end
+
+  node_mt.__add = binary("add")
+  node_mt.__sub = binary("sub")
+  node_mt.__mul = binary("mul")
+  node_mt.__div = binary("div")
+  node_mt.__pow = node_methods.pow
+  node_mt.__unm = unary("neg")
+
+  -- emits the expression tree in postfix order
+  local function compile(node, code)
+    if node.op == "input" then
+      table.insert(code, { "input", node.value })
+    elseif node.op == "const" then
+      table.insert(code, { "const", node.value })
+    else
+      for i=1,node.n do compile(node[i], code) end
+      table.insert(code, { node.op })
+    end
+    return code
+  end
+
+  matrix.fuse =
+    april_doc{
+      class = "function",
+      summary = "Compiles a fused element-wise expression",
+      description = {
+        "The given function receives symbolic placeholders instead of",
+        "matrices and it can use arithmetic operators and methods as",
+        "exp, log, log1p, sqrt, tanh, logistic, relu, clamp, pow, max, min,",
+        "lt, gt, ... The returned object is callable with N matrices",
+        "(and an optional destination matrix), and evaluates the expression",
+        "in one memory pass. The expression can end with a reduction",
+        "(sum, prod, max or min without arguments), in which case",
+        "the call returns a number.",
+      },
+      params = {
+        "A function which receives N placeholders",
+        "Number of inputs [optional], by default the number of parameters of the function",
+      },
+      outputs = { "A callable fused program" },
+    } ..
+    function(f, n)
+      assert(type(f) == "function", "Needs a function as first argument")
+      n = n or debug.getinfo(f, "u").nparams
+      local inputs = {}
+      for i=1,n do
+        inputs[i] = setmetatable({ op = "input", value = i, n = 0 }, node_mt)
+      end
+      local root = f(table.unpack(inputs))
+      assert(is_node(root), "The fused function should return an expression")
+      local red = root.reduction or "none"
+      if root.reduction then root = root[1] end
+      return fused_program(n, compile(root, {}), red)
+    end
+
+  class.extend_metamethod(fused_program, "__call",
+                          function(self, ...) return self:eval(...) end)
+end
@@ -9,6 +9,13 @@ end
 
 matrix.__generic__ = matrix.__generic__ or {}
 
+-- options table for write method given a mode string: "ascii", "binary" or
+-- "raw"
+local function mode_options(mode)
+  return { [matrix.options.ascii] = (mode=="ascii"),
+           [matrix.options.raw]   = (mode=="raw") }
+end
+
 matrix.__generic__.__make_generic_to_lua_string__ = function(matrix_class,
                                                              defmode)
   local name = matrix_class.meta_instance.id
@@ -80,8 +87,7 @@ matrix.__generic__.__make_generic_toFilename__ = function(matrix_class,
                  local mode = mode or defmode
                  local f = april_assert(io.open(filename,"w"),
                                         "Unable to open %s", filename)
-                 local ret = table.pack(self:write(f,
-                                                   { [matrix.options.ascii] = (mode=="ascii") }))
+                 local ret = table.pack(self:write(f, mode_options(mode)))
                  f:close()
                  return table.unpack(ret)
   end)
@@ -130,7 +136,7 @@ matrix.__generic__.__make_generic_toString__ = function(matrix_class, defmode)
   class.extend(matrix_class, "toString",
                function(self,mode)
                  local mode = mode or defmode
-                 return self:write({ [matrix.options.ascii] = (mode=="ascii") })
+                 return self:write(mode_options(mode))
   end)
 end
 
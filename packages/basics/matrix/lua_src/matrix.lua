@@ -572,6 +572,28 @@ april_set_doc(matrix.."toMMap", {
 		  "A filename path.",
 		}, })
 
+april_set_doc(matrix.fromRawMMap, {
+		class = "function", summary = "Matrix fromRawMMap constructor",
+		description ={
+		  "Loads a matrix from a file written in raw mode,",
+		  "i.e. m:toFilename(filename, \"raw\").",
+		  "The matrix data points to the mmapped file, so loading",
+		  "takes constant time and processes mapping the same file",
+		  "share its memory pages.",
+		},
+		params = {
+		  "A filename path.",
+		  {
+		    "A boolean indicating if writing is allowed [optional].",
+		    "By default it is false",
+		  },
+		  {
+		    "A boolean indicating if memory map is shared [optional].",
+		    "By default it is true",
+		  },
+		},
+		outputs = { "A matrix instantiated object" }, })
+
 april_set_doc(matrix.loadImage, {
 		class = "function", summary = "Matrix loadImage constructor",
 		description ={
@@ -1328,7 +1350,36 @@ april_set_doc(matrix.."uniformf",
 		summary = "Initializes with random floats in range [a,b]",
 		params  = { "Lower range value",
 			    "Upper range value",
-			    "A random object instance [optional]" },
+			    "A random or random.philox instance [optional]" },
+		outputs = { "The caller matrix instance" },
+})
+
+april_set_doc(matrix.."normal",
+	      {
+		class = "method",
+		summary = "Initializes with normally distributed random floats",
+		description = {
+		  "When a random.philox instance is given the matrix is",
+		  "filled in parallel, and the result doesn't depend on",
+		  "the number of OMP threads.",
+		},
+		params  = { "Mean [optional], by default 0",
+			    "Standard deviation [optional], by default 1",
+			    "A random or random.philox instance [optional]" },
+		outputs = { "The caller matrix instance" },
+})
+
+april_set_doc(matrix.."bernoulli",
+	      {
+		class = "method",
+		summary = "Initializes with 1 with probability p, 0 otherwise",
+		description = {
+		  "When a random.philox instance is given the matrix is",
+		  "filled in parallel, and the result doesn't depend on",
+		  "the number of OMP threads.",
+		},
+		params  = { "Probability p [optional], by default 0.5",
+			    "A random or random.philox instance [optional]" },
 		outputs = { "The caller matrix instance" },
 })
 
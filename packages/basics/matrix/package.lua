@@ -25,6 +25,8 @@
 	 "test/test_matrix_math.lua",
 	 "test/test_sparse_matrix.lua",
 	 "test/test_convolution.lua",
+	 "test/test_fused.lua",
+	 "test/test_philox.lua",
        },
      },
      -- FIXME: make it compile
@@ -0,0 +1,47 @@
+local check = utest.check
+local T = utest.test
+--
+
+T("FusedMapTest",
+  function()
+    local a = matrix(4,5):linspace(-1,1)
+    local b = matrix(4,5):linspace(1,2)
+    local f = matrix.fuse(function(x,y) return (x - 0.1*y)^2 + x:exp() end)
+    check.eq(f(a,b), (a - b*0.1):pow(2) + a:clone():exp())
+    -- unary functions
+    local g = matrix.fuse(function(x) return x:tanh():log1p():clamp(-0.5,0) end)
+    check.eq(g(a), a:clone():tanh():log1p():clamp(-0.5,0))
+    local h = matrix.fuse(function(x) return x:abs():sqrt():max(0.5) end)
+    check.eq(h(a), a:clone():abs():sqrt():clamp(0.5,math.huge))
+    -- in-place destination
+    local c = a:clone()
+    f(c, b, c)
+    check.eq(c, f(a,b))
+  end)
+
+T("FusedNonContiguousTest",
+  function()
+    local a = matrix(20,30):linspace():t()
+    local b = matrix(30,20):linspace()
+    local f = matrix.fuse(function(x,y) return x*y - y end)
+    check.FALSE(a:is_contiguous())
+    check.eq(f(a,b), a:clone():cmul(b) - b)
+    local sub = matrix(40,60):linspace():slice({1,1},{20,30})
+    local g = matrix.fuse(function(x) return x:tanh() end)
+    check.eq(g(sub), sub:clone():tanh())
+  end)
+
+T("FusedReduceTest",
+  function()
+    local a = matrix(100,200):linspace(-1,1)
+    local b = matrix(100,200):linspace(0,1)
+    local sq = matrix.fuse(function(x,y) return ((x-y)^2):sum() end)
+    check.number_eq(sq(a,b), (a-b):pow(2):sum())
+    local mx = matrix.fuse(function(x) return x:exp():max() end)
+    check.number_eq(mx(a), math.exp(1))
+    local mn = matrix.fuse(function(x) return (-x):min() end)
+    check.number_eq(mn(a:t()), -1)
+    check.errored(function()
+        return matrix.fuse(function(x) return x:sum():exp() end)
+    end)
+  end)
@@ -271,6 +271,40 @@ ascii
       check.eq(matrix.fromTabFilename(tmpname), m, "toTabFilename/fromTabFilename")
       check.eq(matrix(10,20,m:toTable()), m)
   end)
+
+  T("RawSerializationTest", function()
+      local m = matrix(10,20):uniformf()
+      m:toFilename(tmpname, "raw")
+      check.eq(matrix.fromFilename(tmpname), m, "toFilename/fromFilename raw")
+      check.eq(matrix.fromRawMMap(tmpname), m, "toFilename/fromRawMMap")
+      check.eq(matrix.fromString(m:toString("raw")), m, "toString/fromString raw")
+      -- header plus 64 bytes aligned data
+      local f = io.open(tmpname)
+      local size = #f:read("*a")
+      f:close()
+      check.eq(size % 64, (m:size() * 4) % 64, "raw alignment")
+      -- non-contiguous matrices are written as contiguous ones
+      local t = m:transpose()
+      t:toFilename(tmpname, "raw")
+      check.eq(matrix.fromRawMMap(tmpname), t, "transposed raw")
+      -- types are checked by their element size
+      local m2 = matrixDouble(4,5):linspace()
+      m2:toFilename(tmpname, "raw")
+      check.eq(matrixDouble.fromRawMMap(tmpname), m2, "double raw")
+      check.errored(function() return matrixChar.fromRawMMap(tmpname) end)
+      -- read-only mappings don't allow writes
+      local ro = matrixDouble.fromRawMMap(tmpname)
+      check.errored(function() ro:fill(1.0) end)
+      -- truncated data is detected
+      m:toFilename(tmpname, "raw")
+      local f = io.open(tmpname)
+      local content = f:read("*a")
+      f:close()
+      local f = io.open(tmpname, "w")
+      f:write(content:sub(1, #content - 4))
+      f:close()
+      check.errored(function() return matrix.fromRawMMap(tmpname) end)
+  end)
   os.remove(tmpname)
 
   T("EQandNEQTest", function()
@@ -567,7 +601,91 @@ ascii
       check.eq(y:cumprod(),  matrix(2,2,{1,2, 3,8}))
       check.eq(y:cumprod(2), matrix(2,2,{1,2, 3,12}))
   end)
-  
+
+  T("SIMDKernelsTest",
+    function()
+      local best = mathcore.get_simd_level()
+      local rnd = random(1234)
+      local x = matrix(1027):uniformf(-20,20,rnd)
+      local y = matrix(1027):uniformf(0.01,100,rnd)
+      x[5], x[100] = 1/0, -1/0
+      local function compute()
+        return { x:clone():exp(), y:clone():log(), x:clone():tanh(),
+                 x:clone():cmul(y), y:max(1), y:sum() }
+      end
+      mathcore.set_simd_level("none")
+      local expected = compute()
+      mathcore.set_simd_level(best)
+      local result = compute()
+      check.eq(mathcore.get_simd_level(), best)
+      for i=1,#expected-1 do check.eq(result[i], expected[i]) end
+      check.number_eq(result[#result], expected[#expected])
+      check.errored(function() mathcore.set_simd_level("foo") end)
+  end)
+
+  T("OMPSchedulerTest",
+    function()
+      local grain = mathcore.get_omp_grain_size()
+      local threshold = mathcore.get_omp_parallel_threshold()
+      local nth = util.omp_get_num_threads()
+      local rnd = random(4321)
+      local m = matrix(37,1001):uniformf(-1,1,rnd)
+      local function compute()
+        local t = m:transpose()
+        local s = m:slice({3,5},{30,900})
+        return { t:clone():tanh(), s:clone():exp(), t:clone():cmul(t),
+                 t:sum(), s:sum(), t:dot(t), s:norm2() }
+      end
+      local expected = compute()
+      -- splits every span into small chunks
+      mathcore.set_omp_grain_size(17)
+      mathcore.set_omp_parallel_threshold(0)
+      check.eq(mathcore.get_omp_grain_size(), 17)
+      check.eq(mathcore.get_omp_parallel_threshold(), 0)
+      for _,n in ipairs{ 1, 4 } do
+        util.omp_set_num_threads(n)
+        local result = compute()
+        for i=1,3 do check.eq(result[i], expected[i]) end
+        for i=4,#result do check.number_eq(result[i], expected[i], 1e-03) end
+      end
+      check.errored(function() mathcore.set_omp_grain_size(0) end)
+      util.omp_set_num_threads(nth)
+      mathcore.set_omp_grain_size(grain)
+      mathcore.set_omp_parallel_threshold(threshold)
+  end)
+
+  T("MemoryArenaTest",
+    function()
+      mathcore.clear_pool()
+      mathcore.reset_pool_stats()
+      local stats = mathcore.get_pool_stats()
+      if not stats.hits then return end -- compiled with NO_POOL
+      check.eq(stats.hits, 0)
+      check.eq(stats.bytes_held, 0)
+      check.TRUE(mathcore.get_pool_size_class(1000) >= 1000)
+      check.eq(mathcore.get_pool_size_class(1000),
+               mathcore.get_pool_size_class(1001))
+      local m = matrix(250)
+      m = nil
+      collectgarbage("collect")
+      stats = mathcore.get_pool_stats()
+      check.TRUE(stats.releases > 0)
+      check.TRUE(stats.bytes_held >= mathcore.get_pool_size_class(1000))
+      -- same size class, served from the arena
+      local m = matrix(245):fill(3)
+      check.TRUE(mathcore.get_pool_stats().hits > 0)
+      check.eq(m:sum(), 735)
+      mathcore.clear_pool()
+      check.eq(mathcore.get_pool_stats().bytes_held, 0)
+      local max_size = mathcore.get_max_pool_size()
+      mathcore.set_max_pool_size(0)
+      check.eq(mathcore.get_max_pool_size(), 0)
+      m = nil
+      collectgarbage("collect")
+      check.eq(mathcore.get_pool_stats().bytes_held, 0)
+      mathcore.set_max_pool_size(max_size)
+  end)
+
 end
 
 --
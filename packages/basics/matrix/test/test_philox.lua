@@ -0,0 +1,59 @@
+local check = utest.check
+local T = utest.test
+--
+
+local function with_threads(n, f)
+  local old = util.omp_get_num_threads()
+  util.omp_set_num_threads(n)
+  local result = f()
+  util.omp_set_num_threads(old)
+  return result
+end
+
+T("PhiloxSequenceTest",
+  function()
+    local a = random.philox(1234)
+    local b = a:clone()
+    for i=1,20 do check.eq(a:randInt(1,100), b:randInt(1,100)) end
+    local pos = a:get_position()
+    local x = a:rand()
+    a:set_position(pos)
+    check.eq(a:rand(), x)
+    check.errored(function() return random.philox({ key1=1, foo=2 }) end)
+  end)
+
+T("PhiloxThreadsTest",
+  function()
+    local fills = {
+      function(m, rnd) return m:uniformf(-1, 1, rnd) end,
+      function(m, rnd) return m:normal(0, 2, rnd) end,
+      function(m, rnd) return m:bernoulli(0.3, rnd) end,
+    }
+    for _,f in ipairs(fills) do
+      local function fill() return f(matrix(100,200), random.philox(567)) end
+      check.eq(with_threads(1, fill), with_threads(4, fill))
+    end
+  end)
+
+T("PhiloxNonContiguousTest",
+  function()
+    local m = matrix(100,200):t()
+    check.FALSE(m:is_contiguous())
+    m:normal(0, 1, random.philox(89))
+    local n = matrix(200,100):normal(0, 1, random.philox(89))
+    check.eq(m, n)
+  end)
+
+T("PhiloxDistributionsTest",
+  function()
+    local rnd = random.philox(4321)
+    local m = matrix(200,500):uniformf(2, 4, rnd)
+    check.TRUE(m:min() >= 2 and m:max() < 4)
+    check.number_eq(m:sum()/m:size(), 3.0, 0.01)
+    local m = matrix(200,500):normal(1, 2, rnd)
+    local mu = m:sum()/m:size()
+    check.number_eq(mu, 1.0, 0.05)
+    check.number_eq(math.sqrt((m-mu):pow(2):sum()/m:size()), 2.0, 0.05)
+    local m = matrix(200,500):bernoulli(0.25, rnd)
+    check.number_eq(m:sum()/m:size(), 0.25, 0.05)
+  end)
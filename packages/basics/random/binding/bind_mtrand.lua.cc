@@ -21,6 +21,7 @@
 //BIND_HEADER_C
 
 IMPLEMENT_LUA_TABLE_BIND_SPECIALIZATION(MTRand);
+IMPLEMENT_LUA_TABLE_BIND_SPECIALIZATION(PhiloxRand);
 
 //BIND_END
 
@@ -28,9 +29,11 @@ IMPLEMENT_LUA_TABLE_BIND_SPECIALIZATION(MTRand);
 #include "bind_april_io.h"
 #include "MersenneTwister.h"
 #include "dice.h"
+#include "philox.h"
 #include "utilLua.h"
 using Basics::MTRand;
 using Basics::Dice;
+using Basics::PhiloxRand;
 //BIND_END
 
 //BIND_LUACLASSNAME Serializable aprilio.serializable
@@ -328,6 +331,155 @@ using Basics::Dice;
 
 /////////////////////////////////////////////////////////////////////////////
 
+//BIND_LUACLASSNAME PhiloxRand random.philox
+//BIND_CPP_CLASS PhiloxRand
+//BIND_SUBCLASS_OF PhiloxRand Serializable
+
+//BIND_CONSTRUCTOR PhiloxRand
+//DOC_BEGIN
+// random.philox()
+//DOC_END
+//DOC_BEGIN
+// random.philox(uint32_t n)
+/// @param n The seed
+//DOC_END
+//DOC_BEGIN
+// random.philox{ key1=..., key2=..., position=... }
+/// @param key1,key2 The key words
+/// @param position The position in the sequence
+//DOC_END
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  int argn = lua_gettop(L); /* number of arguments */
+  if ( argn == 0 || lua_isnil(L,1) ) {
+    obj = new PhiloxRand(); // auto-initialize with /dev/urandom or time()
+  }
+  else if (lua_istable(L,1)) {
+    unsigned int key1, key2;
+    double position;
+    check_table_fields(L, 1, "key1", "key2", "position", (const char *)0);
+    LUABIND_GET_TABLE_PARAMETER(1, key1, uint, key1);
+    LUABIND_GET_TABLE_PARAMETER(1, key2, uint, key2);
+    LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, position, double, position, 0.0);
+    obj = new PhiloxRand(key1, key2, static_cast<uint64_t>(position));
+  }
+  else {
+    obj = new PhiloxRand((uint32_t)luaL_checknumber(L, 1));
+  }
+  LUABIND_RETURN(PhiloxRand, obj);
+}
+//BIND_END
+
+//BIND_METHOD PhiloxRand rand
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  double n;
+  LUABIND_GET_OPTIONAL_PARAMETER(1,double,n,1);
+  LUABIND_RETURN(number,obj->rand(n));
+}
+//BIND_END
+
+//BIND_METHOD PhiloxRand randExc
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  double n;
+  LUABIND_GET_OPTIONAL_PARAMETER(1,double,n,1);
+  LUABIND_RETURN(number,obj->randExc(n));
+}
+//BIND_END
+
+//BIND_METHOD PhiloxRand randDblExc
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  double n;
+  LUABIND_GET_OPTIONAL_PARAMETER(1,double,n,1);
+  LUABIND_RETURN(number,obj->randDblExc(n));
+}
+//BIND_END
+
+//BIND_METHOD PhiloxRand randInt
+{
+  LUABIND_CHECK_ARGN(<=, 2);
+  int x,y,resul;
+  int argn = lua_gettop(L);  /* number of arguments */
+  if (argn == 2) {
+    LUABIND_GET_PARAMETER(1,int,x);
+    LUABIND_GET_PARAMETER(2,int,y);
+    if (y < x)
+      LUABIND_ERROR("first argument must be <= second argument");
+    resul = x+obj->randInt(y-x);
+  } else if (argn == 1) {
+    LUABIND_GET_PARAMETER(1,int,x);
+    resul = obj->randInt(x);
+  } else
+    resul = obj->randInt();
+  LUABIND_RETURN(number,resul);
+}
+//BIND_END
+
+//BIND_METHOD PhiloxRand randNorm
+{
+  double mean, variance;
+  LUABIND_CHECK_ARGN(==, 2);
+  LUABIND_GET_PARAMETER(1, double, mean);
+  LUABIND_GET_PARAMETER(2, double, variance);
+  LUABIND_RETURN(number,obj->randNorm(mean,variance));
+}
+//BIND_END
+
+//BIND_METHOD PhiloxRand shuffle
+{
+  LUABIND_CHECK_ARGN(==, 1);
+  int size;
+  LUABIND_GET_PARAMETER(1, int, size);
+  if (size <= 0) LUABIND_ERROR("random shuffle: size must be >= 0");
+  int *vector = new int[size];
+  obj->shuffle(size,vector);
+  lua_createtable(L, size, 0);
+  for (int i=0; i < size; i++) {
+    lua_pushnumber(L,vector[i]+1);
+    lua_rawseti(L,-2,i+1);
+  }
+  delete[] vector;
+  return 1;
+}
+//BIND_END
+
+//BIND_METHOD PhiloxRand seed
+{
+  LUABIND_CHECK_ARGN(<=, 1);
+  int argn = lua_gettop(L);
+  if (argn == 0) obj->seed();
+  else obj->seed((uint32_t)luaL_checknumber(L, 1));
+}
+//BIND_END
+
+//BIND_METHOD PhiloxRand clone
+{
+  LUABIND_CHECK_ARGN(==, 0);
+  LUABIND_RETURN(PhiloxRand, new PhiloxRand(*obj));
+}
+//BIND_END
+
+//BIND_METHOD PhiloxRand get_position
+{
+  LUABIND_RETURN(number, static_cast<double>(obj->getPosition()));
+}
+//BIND_END
+
+//BIND_METHOD PhiloxRand set_position
+{
+  LUABIND_CHECK_ARGN(==, 1);
+  double position;
+  LUABIND_GET_PARAMETER(1, double, position);
+  if (position < 0.0) LUABIND_ERROR("Expected a non-negative position");
+  obj->setPosition(static_cast<uint64_t>(position));
+  LUABIND_RETURN(PhiloxRand, obj);
+}
+//BIND_END
+
+/////////////////////////////////////////////////////////////////////////////
+
 //BIND_LUACLASSNAME Dice random.dice
 //BIND_CPP_CLASS Dice
 
@@ -0,0 +1,171 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#include <stdio.h>
+#include <time.h>
+#include "philox.h"
+
+namespace Basics {
+
+  const unsigned int PhiloxRand::BLOCK_SIZE;
+
+  PhiloxRand::PhiloxRand(uint32_t oneSeed) {
+    seed(oneSeed);
+  }
+
+  PhiloxRand::PhiloxRand(uint32_t key0, uint32_t key1, uint64_t position) :
+    position(position), cached_block(0), has_cache(false) {
+    key[0] = key0;
+    key[1] = key1;
+  }
+
+  PhiloxRand::PhiloxRand() {
+    seed();
+  }
+
+  PhiloxRand::PhiloxRand(const PhiloxRand &other) : Serializable(),
+                                                    position(other.position),
+                                                    cached_block(0),
+                                                    has_cache(false) {
+    key[0] = other.key[0];
+    key[1] = other.key[1];
+  }
+
+  PhiloxRand &PhiloxRand::operator=(const PhiloxRand &other) {
+    if (this != &other) {
+      key[0] = other.key[0];
+      key[1] = other.key[1];
+      position = other.position;
+      has_cache = false;
+    }
+    return *this;
+  }
+
+  void PhiloxRand::seed(uint32_t oneSeed) {
+    // the second word of the key is a scrambled version of the seed, so
+    // close seeds give very different keys
+    uint32_t h = oneSeed * 0x9E3779B9u;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    key[0] = oneSeed;
+    key[1] = h;
+    position = 0;
+    has_cache = false;
+  }
+
+  void PhiloxRand::seed() {
+    // use /dev/urandom if available, otherwise time() and clock()
+    uint32_t s[2];
+    FILE* urandom = fopen( "/dev/urandom", "rb" );
+    bool success = false;
+    if (urandom) {
+      success = (fread(s, sizeof(uint32_t), 2, urandom) == 2);
+      fclose(urandom);
+    }
+    if (!success) {
+      s[0] = static_cast<uint32_t>(time(NULL));
+      s[1] = static_cast<uint32_t>(clock());
+    }
+    seed(s[0]);
+    key[1] ^= s[1];
+  }
+
+  uint32_t PhiloxRand::randInt() {
+    uint64_t b = position / BLOCK_SIZE;
+    if (!has_cache || b != cached_block) {
+      block(key, b, cache);
+      cached_block = b;
+      has_cache = true;
+    }
+    return cache[position++ % BLOCK_SIZE];
+  }
+
+  uint32_t PhiloxRand::randInt(const uint32_t &n) {
+    // same rejection method as MTRand
+    uint32_t used = n;
+    used |= used >> 1;
+    used |= used >> 2;
+    used |= used >> 4;
+    used |= used >> 8;
+    used |= used >> 16;
+    uint32_t i;
+    do {
+      i = randInt() & used;
+    } while( i > n );
+    return i;
+  }
+
+  double PhiloxRand::rand() {
+    return randInt() * (1.0/4294967295.0);
+  }
+
+  double PhiloxRand::rand(const double &n) {
+    return rand() * n;
+  }
+
+  double PhiloxRand::randExc() {
+    return toUniform(randInt());
+  }
+
+  double PhiloxRand::randExc(const double &n) {
+    return randExc() * n;
+  }
+
+  double PhiloxRand::randDblExc() {
+    return ( double(randInt()) + 0.5 ) * (1.0/4294967296.0);
+  }
+
+  double PhiloxRand::randDblExc(const double &n) {
+    return randDblExc() * n;
+  }
+
+  double PhiloxRand::randNorm(const double &mean, const double &variance) {
+    // Box-Muller method, as MTRand, variance is used as standard deviation
+    double r = sqrt( -2.0 * log( 1.0-randDblExc()) ) * variance;
+    double phi = 2.0 * 3.14159265358979323846264338328 * randExc();
+    return mean + r * cos(phi);
+  }
+
+  void PhiloxRand::shuffle(int size, int *vector) {
+    for (int i=0; i < size; i++)
+      vector[i] = i;
+    for (int i = size-1; i > 0; i--) {
+      int j = randInt(i);
+      int swap = vector[i];
+      vector[i] = vector[j];
+      vector[j] = swap;
+    }
+  }
+
+  const char *PhiloxRand::luaCtorName() const {
+    return "random.philox";
+  }
+
+  int PhiloxRand::exportParamsToLua(lua_State *L) {
+    AprilUtils::LuaTable t(L);
+    t["key1"] = key[0];
+    t["key2"] = key[1];
+    t["position"] = static_cast<double>(position);
+    t.pushTable(L);
+    return 1;
+  }
+
+} // namespace Basics
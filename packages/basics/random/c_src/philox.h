@@ -0,0 +1,211 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <math.h>
+#include <stdint.h>
+#include "lua_table.h"
+#include "serializable.h"
+
+namespace Basics {
+
+  /**
+   * @brief Counter-based random generator (Philox4x32-10, Salmon et al. 2011).
+   *
+   * Every 128 bits block of the sequence is a bijection of its position,
+   * computed independently of any other block. So, the bulk fill methods
+   * generate the blocks in parallel with OpenMP, and their result is the
+   * same for any number of threads. The state is only the key (given by the
+   * seed) and the position in the sequence, so it is cheap to save and
+   * restore.
+   *
+   * Bulk fill methods start at the next block boundary and consume one 32
+   * bits number per element, therefore elements at the same position of two
+   * fills with the same state receive the same random number.
+   */
+  class PhiloxRand : public AprilIO::Serializable {
+  public:
+    /// Number of 32 bits numbers in every block.
+    static const unsigned int BLOCK_SIZE = 4;
+
+    PhiloxRand(uint32_t seed);
+    PhiloxRand(uint32_t key0, uint32_t key1, uint64_t position=0);
+    PhiloxRand(); // auto-initialize with time() and clock()
+    PhiloxRand(const PhiloxRand &other);
+    PhiloxRand &operator=(const PhiloxRand &other);
+
+    /// Computes the block at the given counter position.
+    static void block(const uint32_t key[2], uint64_t ctr, uint32_t out[4]) {
+      uint32_t k0 = key[0], k1 = key[1];
+      uint32_t c0 = static_cast<uint32_t>(ctr);
+      uint32_t c1 = static_cast<uint32_t>(ctr >> 32);
+      uint32_t c2 = 0u, c3 = 0u;
+      for (int r=0; r<10; ++r) {
+        uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c0;
+        uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c2;
+        uint32_t hi0 = static_cast<uint32_t>(p0 >> 32);
+        uint32_t lo0 = static_cast<uint32_t>(p0);
+        uint32_t hi1 = static_cast<uint32_t>(p1 >> 32);
+        uint32_t lo1 = static_cast<uint32_t>(p1);
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = lo1;
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = lo0;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+      }
+      out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+    }
+
+    /// Number in [0,1).
+    static double toUniform(uint32_t x) {
+      return x * (1.0/4294967296.0);
+    }
+
+    /// Number in (0,1].
+    static double toUniformNonZero(uint32_t x) {
+      return (x + 1.0) * (1.0/4294967296.0);
+    }
+
+    /// @name Sequential access, the same interface as MTRand
+    /// @{
+    uint32_t randInt();                     // integer in [0,2^32-1]
+    uint32_t randInt(const uint32_t &n);    // integer in [0,n] for n < 2^32
+    double rand();                          // real number in [0,1]
+    double rand(const double &n);           // real number in [0,n]
+    double randExc();                       // real number in [0,1)
+    double randExc(const double &n);        // real number in [0,n)
+    double randDblExc();                    // real number in (0,1)
+    double randDblExc(const double &n);     // real number in (0,n)
+    double randNorm(const double &mean = 0.0, const double &variance = 0.0);
+    void seed(uint32_t seed);
+    void seed();
+    void shuffle(int size, int *vector);
+    /// @}
+
+    uint32_t getKey(int i) const { return key[i]; }
+    /// Position of the next 32 bits number in the sequence.
+    uint64_t getPosition() const { return position; }
+    void setPosition(uint64_t pos) { position = pos; }
+
+    /// @name Parallel bulk fill of contiguous arrays
+    /// @{
+
+    /// Uniform numbers in [lower,upper).
+    template<typename T>
+    void fillUniform(T *dest, int N, double lower, double upper) {
+      const double diff = upper - lower;
+      uint64_t first = startBulk(N);
+      const int num_blocks = numBlocks(N);
+#ifndef NO_OMP
+#pragma omp parallel for if(num_blocks > 1024)
+#endif
+      for (int b=0; b<num_blocks; ++b) {
+        uint32_t out[4];
+        block(key, first + b, out);
+        const int k0 = b*BLOCK_SIZE;
+        const int k1 = (k0 + static_cast<int>(BLOCK_SIZE) < N) ?
+          k0 + static_cast<int>(BLOCK_SIZE) : N;
+        for (int k=k0; k<k1; ++k) {
+          dest[k] = T(toUniform(out[k-k0])*diff + lower);
+        }
+      }
+    }
+
+    /// Gaussian numbers with the given mean and standard deviation
+    /// (Box-Muller method, every block gives four numbers).
+    template<typename T>
+    void fillNormal(T *dest, int N, double mean, double stddev) {
+      uint64_t first = startBulk(N);
+      const int num_blocks = numBlocks(N);
+#ifndef NO_OMP
+#pragma omp parallel for if(num_blocks > 1024)
+#endif
+      for (int b=0; b<num_blocks; ++b) {
+        uint32_t out[4];
+        double z[4];
+        block(key, first + b, out);
+        for (int j=0; j<4; j+=2) {
+          double r = sqrt(-2.0 * log(toUniformNonZero(out[j]))) * stddev;
+          double phi = 2.0 * 3.14159265358979323846264338328 *
+            toUniform(out[j+1]);
+          z[j]   = r*cos(phi);
+          z[j+1] = r*sin(phi);
+        }
+        const int k0 = b*BLOCK_SIZE;
+        const int k1 = (k0 + static_cast<int>(BLOCK_SIZE) < N) ?
+          k0 + static_cast<int>(BLOCK_SIZE) : N;
+        for (int k=k0; k<k1; ++k) dest[k] = T(mean + z[k-k0]);
+      }
+    }
+
+    /// Ones with probability p, zeros otherwise.
+    template<typename T>
+    void fillBernoulli(T *dest, int N, double p) {
+      // comparing integers avoids the conversion of every number
+      const double threshold = p * 4294967296.0;
+      uint64_t first = startBulk(N);
+      const int num_blocks = numBlocks(N);
+#ifndef NO_OMP
+#pragma omp parallel for if(num_blocks > 1024)
+#endif
+      for (int b=0; b<num_blocks; ++b) {
+        uint32_t out[4];
+        block(key, first + b, out);
+        const int k0 = b*BLOCK_SIZE;
+        const int k1 = (k0 + static_cast<int>(BLOCK_SIZE) < N) ?
+          k0 + static_cast<int>(BLOCK_SIZE) : N;
+        for (int k=k0; k<k1; ++k) {
+          dest[k] = (out[k-k0] < threshold) ? T(1.0) : T(0.0);
+        }
+      }
+    }
+    /// @}
+
+    virtual const char *luaCtorName() const;
+    virtual int exportParamsToLua(lua_State *L);
+
+  private:
+    uint32_t key[2];
+    uint64_t position;
+    /// Cache of the last computed block for sequential access.
+    uint32_t cache[4];
+    uint64_t cached_block;
+    bool has_cache;
+
+    static int numBlocks(int N) {
+      return (N + static_cast<int>(BLOCK_SIZE) - 1) / BLOCK_SIZE;
+    }
+
+    /// Moves the position after the bulk and returns its first block.
+    uint64_t startBulk(int N) {
+      uint64_t first = (position + BLOCK_SIZE - 1) / BLOCK_SIZE;
+      position = (first + numBlocks(N)) * BLOCK_SIZE;
+      return first;
+    }
+  };
+
+} // namespace Basics
+
+DECLARE_LUA_TABLE_BIND_SPECIALIZATION(Basics::PhiloxRand);
+
+#endif // PHILOX_H
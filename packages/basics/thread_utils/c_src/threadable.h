@@ -38,6 +38,8 @@ class Threadable : public Referenced {
   pthread_t thread_id;
   // nombre
   char *name;
+  // imprime en stderr cuando el thread se para o se une
+  bool verbose;
   
   static void *execute(void *ptr) {
     Threadable *obj = reinterpret_cast<Threadable*>(ptr);
@@ -61,7 +63,8 @@ protected:
   virtual bool threadProcedure() = 0;
   
 public:
-  Threadable(const char *name=0) : running(false), joined(true) {
+  Threadable(const char *name=0) : running(false), joined(true),
+                                   verbose(true) {
     if (name) {
       this->name = new char[strlen(name)+1];
       strcpy(this->name, name);
@@ -76,6 +79,7 @@ public:
   const char *getName() { return name; }
   bool isRunning() { return running; }
   bool isJoined() { return joined; }
+  void setVerbose(bool v) { verbose = v; }
   void startThread() {
     if (!running) {
       if (!joined) waitThread();
@@ -91,15 +95,17 @@ public:
       running = false;
       executeBeforeStop();
       SigIntHandler::remove_thread(this);
-      fprintf(stderr, "\t\t\t%s stopped\n", getName());
+      if (verbose) fprintf(stderr, "\t\t\t%s stopped\n", getName());
     }
   }
   void waitThread() {
     if (!running && !joined) {
       pthread_join(thread_id, 0);
       joined = true;
+      // el thread puede haber terminado sin stopThread()
+      SigIntHandler::remove_thread(this);
       executeAfterWait();
-      fprintf(stderr, "\t\t\t%s joined\n", getName());
+      if (verbose) fprintf(stderr, "\t\t\t%s joined\n", getName());
     }
   }
 };
@@ -929,17 +929,35 @@ FILE **newfile (lua_State *L) {
 //BIND_CONSTRUCTOR MMappedDataReader
 {
   const char *path;
-  bool write, shared;
+  bool write, shared, has_header;
   LUABIND_CHECK_ARGN(>=,1);
-  LUABIND_CHECK_ARGN(<=,3);
+  LUABIND_CHECK_ARGN(<=,4);
   LUABIND_GET_PARAMETER(1, string, path);
   LUABIND_GET_OPTIONAL_PARAMETER(2, bool, write,  true);
   LUABIND_GET_OPTIONAL_PARAMETER(3, bool, shared, true);
-  obj = new MMappedDataReader(path,write,shared);
+  LUABIND_GET_OPTIONAL_PARAMETER(4, bool, has_header, true);
+  obj = new MMappedDataReader(path,write,shared,has_header);
   LUABIND_RETURN(MMappedDataReader, obj);
 }
 //BIND_END
 
+//BIND_METHOD MMappedDataReader seek
+{
+  double offset;
+  LUABIND_CHECK_ARGN(==,1);
+  LUABIND_GET_PARAMETER(1, double, offset);
+  if (offset < 0.0) LUABIND_ERROR("Expected a non-negative offset");
+  obj->seek(static_cast<size_t>(offset));
+  LUABIND_RETURN(MMappedDataReader, obj);
+}
+//BIND_END
+
+//BIND_METHOD MMappedDataReader tell
+{
+  LUABIND_RETURN(double, static_cast<double>(obj->tell()));
+}
+//BIND_END
+
 //BIND_LUACLASSNAME MMappedDataWriter util.mmap.writer
 //BIND_CPP_CLASS    MMappedDataWriter
 
@@ -81,6 +81,20 @@ namespace AprilUtils {
     return static_cast<size_t>(len);
   }
 
+  void LuaTable::getStringKeys(vector<string> &keys) const {
+    int pos, abspos;
+    if ((pos=checkAndGetRef(abspos)) == 0) return;
+    lua_pushnil(L);
+    while (lua_next(L, abspos)) {
+      // only string keys, lua_tostring() would modify number keys
+      if (lua_type(L, -2) == LUA_TSTRING) {
+        keys.push_back(string(lua_tostring(L, -2)));
+      }
+      lua_pop(L, 1);
+    }
+    popRef(pos);
+  }
+
   LuaTable &LuaTable::operator=(const LuaTable &other) {
     luaL_unref(L, LUA_REGISTRYINDEX, ref);
     int abspos;
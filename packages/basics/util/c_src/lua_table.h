@@ -37,6 +37,7 @@ extern "C" {
 #include "remove_pointer.h"
 #include "smart_ptr.h"
 #include "unused_variable.h"
+#include "vector.h"
 
 /**
  * @brief Macro for declaration of template specializations for
@@ -361,6 +362,9 @@ namespace AprilUtils {
     /// Executes length operator in Lua
     size_t length() const;
     
+    /// Appends to the given vector all the string keys of the table.
+    void getStringKeys(vector<string> &keys) const;
+    
     /// Copy operator.
     LuaTable &operator=(const LuaTable &other);
 
@@ -36,8 +36,11 @@ namespace AprilUtils {
   
   MMappedDataReader::MMappedDataReader(const char *path,
 				       bool write,
-				       bool shared) {
-    if ((fd = open(path, O_RDWR)) < 0)
+				       bool shared,
+				       bool has_header) {
+    // private mappings are copy-on-write, so they don't need write access
+    int open_flags = (write && shared) ? O_RDWR : O_RDONLY;
+    if ((fd = open(path, open_flags)) < 0)
       ERROR_EXIT1(128,"Unable to open file %s\n", path);
     // find size of input file
     struct stat statbuf;
@@ -48,6 +51,7 @@ namespace AprilUtils {
     mmapped_data_size = statbuf.st_size;
     int prot = PROT_READ;
     if (write) prot = prot | PROT_WRITE;
+    writable = write;
     int flags;
     if (shared) flags = MAP_SHARED;
     else flags = MAP_PRIVATE;
@@ -55,10 +59,16 @@ namespace AprilUtils {
 						prot, flags,
 						fd, 0)))  == (caddr_t)-1)
       ERROR_EXIT(128, "mmap error\n");
-    int magic = *(reinterpret_cast<int*>(mmapped_data));
-    if (magic != MAGIC_NUMBER) ERROR_EXIT(128, "Incorrect endianism\n");
-    pos = sizeof(int);
-    commit_number = *(this->get<int>());
+    pos = 0;
+    commit_number = 0;
+    if (has_header) {
+      if (mmapped_data_size < 2*sizeof(int))
+        ERROR_EXIT1(128, "Too small mmap file %s\n", path);
+      int magic = *(reinterpret_cast<int*>(mmapped_data));
+      if (magic != MAGIC_NUMBER) ERROR_EXIT(128, "Incorrect endianism\n");
+      pos = sizeof(int);
+      commit_number = *(this->get<int>());
+    }
   }
   
   MMappedDataReader::~MMappedDataReader() {
@@ -41,8 +41,18 @@ namespace AprilUtils {
     size_t  mmapped_data_size;
     size_t  pos;
     int     fd;
+    bool    writable;
   public:
-    MMappedDataReader(const char *path, bool write=true, bool shared=true);
+    /**
+     * @brief Maps the given file into memory.
+     *
+     * When @c has_header=false the file is mapped as is, without the magic
+     * and commit numbers written by MMappedDataWriter, allowing to map raw
+     * data files. The file is opened read-only unless @c write and @c shared
+     * are true.
+     */
+    MMappedDataReader(const char *path, bool write=true, bool shared=true,
+                      bool has_header=true);
     ~MMappedDataReader();
     size_t size() const;
     
@@ -56,6 +66,16 @@ namespace AprilUtils {
       return ptr;
     }
     int getCommitNumber() const { return commit_number; }
+    /// Returns the current reading position from the beginning of the file.
+    size_t tell() const { return pos; }
+    /// Moves the reading position to the given offset from the beginning.
+    void seek(size_t offset) {
+      if (offset > mmapped_data_size)
+	ERROR_EXIT(128, "Overflow seeking mmap\n");
+      pos = offset;
+    }
+    /// Indicates if the mapped memory allows writes.
+    bool isWritable() const { return writable; }
   };
 
   class MMappedDataWriter : public Referenced {
@@ -18,9 +18,19 @@
  * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
  *
  */
+#include "error_print.h"
 #include "omp_utils.h"
 
+#define DEFAULT_GRAIN_SIZE 16384u
+#define DEFAULT_PARALLEL_THRESHOLD 65536u
+
 namespace OMPUtils {
+
+  namespace {
+    unsigned int grain_size = DEFAULT_GRAIN_SIZE;
+    unsigned int parallel_threshold = DEFAULT_PARALLEL_THRESHOLD;
+  }
+
   int get_num_threads() {
     int n;
 #ifndef NO_OMP
@@ -30,4 +40,21 @@ namespace OMPUtils {
 #endif
     return n;
   }
+
+  unsigned int get_grain_size() {
+    return grain_size;
+  }
+
+  void set_grain_size(unsigned int size) {
+    if (size == 0u) ERROR_EXIT(128, "Grain size must be > 0\n");
+    grain_size = size;
+  }
+
+  unsigned int get_parallel_threshold() {
+    return parallel_threshold;
+  }
+
+  void set_parallel_threshold(unsigned int threshold) {
+    parallel_threshold = threshold;
+  }
 }
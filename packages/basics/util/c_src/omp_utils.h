@@ -30,6 +30,23 @@ extern "C" {
 /// Utilities related with Open-MP parallelization.
 namespace OMPUtils {
   int get_num_threads();
+
+  /**
+   * @brief Number of elements processed by every chunk when a map/reduce
+   * operation is split into parallel work items.
+   *
+   * Long spans are divided in chunks of this size, so every thread works
+   * over a cache-friendly piece of memory independently of the matrix shape.
+   */
+  unsigned int get_grain_size();
+  void set_grain_size(unsigned int grain_size);
+
+  /**
+   * @brief Minimum number of elements of a map/reduce operation to be
+   * split into chunks and computed in parallel.
+   */
+  unsigned int get_parallel_threshold();
+  void set_parallel_threshold(unsigned int threshold);
 }
 
 #endif // OMP_UTILS_H
@@ -31,6 +31,7 @@ extern "C" {
 
 #include "base.h"
 #include "referenced.h"
+#include "unused_variable.h"
 #ifdef __DEBUG__
 #include <cstdio>
 #include "error_print.h"
@@ -61,26 +62,29 @@ Referenced::~Referenced() {
   }
 #endif
 }
+// Counters are atomic because objects as weight matrices can be shared by
+// components running in different threads.
 void Referenced::incRef() { 
-  refs++; 
+  int r = __atomic_add_fetch(&refs, 1, __ATOMIC_RELAXED);
+  UNUSED_VARIABLE(r);
 #ifdef __DEBUG__
-  fprintf(stderr," DEBUG IncRef %p to reference %d\n",this,refs);
+  fprintf(stderr," DEBUG IncRef %p to reference %d\n",this,r);
 #ifdef __PRINT_STACK__
   print_CPP_stacktrace();
 #endif
 #endif
 }
 bool Referenced::decRef() { 
-  refs--;
+  int r = __atomic_sub_fetch(&refs, 1, __ATOMIC_ACQ_REL);
 #ifdef __DEBUG__
-  fprintf(stderr," DEBUG DecRef %p to reference %d\n",this,refs);
+  fprintf(stderr," DEBUG DecRef %p to reference %d\n",this,r);
 #ifdef __PRINT_STACK__
   print_CPP_stacktrace();
 #endif
 #endif
-  return (refs <= 0); 
+  return (r <= 0); 
 }
 
 int Referenced::getRef() const {
-  return refs;
+  return __atomic_load_n(&refs, __ATOMIC_RELAXED);
 }
@@ -1,5 +1,8 @@
 local MAGIC = "-- LS0001"
 local FIND_MASK = "^" .. MAGIC:gsub("%-","%%-")
+local BUNDLE_MAGIC = "-- LB0001"
+local BUNDLE_FIND_MASK = "^" .. BUNDLE_MAGIC:gsub("%-","%%-")
+local BUNDLE_ALIGNMENT = 64
 
 local DEFAULT_BLOCK_SIZE = 2^20
 local ENV_TAG = function() return "ENV dummy function" end -- dummy function
@@ -172,7 +175,7 @@ function util.to_lua_string(data,format)
 end
 
 -- forward declaration
-local serialize
+local serialize, serialize_bundle
 do
   local non_structured = {
     string=true,
@@ -214,6 +217,37 @@ do
   local function lua_string_stream()
     return setmetatable({}, lua_string_stream_mt)
   end
+  -- bundle_stream class, as lua_string_stream it keeps Lua code in memory, but
+  -- matrices are written in raw format into the given aprilio stream, aligned
+  -- to allow their load using mmap
+  local bundle_stream_mt = {
+    __index = {
+      write = lua_string_stream_mt.__index.write,
+      concat = lua_string_stream_mt.__index.concat,
+      is_lua_string_stream = true,
+      is_bundle_stream = true,
+      -- returns true if the given object can be stored as raw data
+      accepts = function(self, obj)
+        local cls = class.of(obj)
+        return cls ~= nil and cls.fromRawMMap ~= nil
+      end,
+      -- writes the object and returns the Lua code which loads it, matrix
+      -- write() clones non-contiguous matrices, so they lose their sharing
+      put = function(self, obj)
+        local f = self.f
+        f:flush()
+        local pos = f:seek()
+        local padding = (BUNDLE_ALIGNMENT - pos%BUNDLE_ALIGNMENT) % BUNDLE_ALIGNMENT
+        if padding > 0 then f:write(string.rep("\n", padding)) end
+        obj:write(f, { [matrix.options.raw] = true })
+        return '__bundle__:load("%s",%d)'%{ class.of(obj).meta_instance.id,
+                                            pos + padding }
+      end,
+    },
+  }
+  local function bundle_stream(f)
+    return setmetatable({ f=f }, bundle_stream_mt)
+  end
   -- normalizes values converting them into strings
   local function value2str(data, tt)
     local tt = tt or type(data)
@@ -296,6 +330,9 @@ do
           local func_dump = "%s"%{ builtin[data] }
           destination:write("%s[%d]=%s\n"%{varname,id,func_dump})
         end
+      elseif destination.is_bundle_stream and destination:accepts(data) then
+        -- matrices are stored out of the Lua code
+        destination:write("%s[%d]=%s\n"%{varname,id,destination:put(data)})
       elseif class.of(data) then
         local serialize = getmetatable(data).serialize
         if serialize then
@@ -385,8 +422,106 @@ do
         destination:close()
       end
     end
+
+  serialize_bundle =
+    april_doc{
+      class = "function",
+      summary = "Serializes an object to a bundle filename",
+      description = {
+        "The bundle is a single file with all the matrices of the object",
+        "stored in raw format and the Lua code which rebuilds the object.",
+        "Deserialization maps the matrices using mmap, so loading takes",
+        "constant time and processes loading the same bundle share",
+        "one physical copy of the matrices. Non-contiguous submatrices",
+        "are stored as contiguous copies, so after loading they don't",
+        "share memory with their parent matrix.",
+      },
+      params = {
+        "Any object, table, string, number, ...",
+        "A filename",
+      },
+    } ..
+    function(data, filename)
+      local version = { util.version() } table.insert(version, os.date())
+      local comment = "-- version info { major, minor, commit number, commit hash, date }"
+      local version_info = "\n%s\n-- %s\n"%{ comment,
+                                             util.to_lua_string(version) }
+      --
+      local f = april_assert(io.open(filename, "w"),
+                             "Unable to open %s", filename)
+      -- the header is written at the end, when the code position is known
+      f:write(string.rep(" ", BUNDLE_ALIGNMENT))
+      local map = mapper()
+      local destination = bundle_stream(f)
+      local varname = "_"
+      destination:write("local __bundle__=...\n")
+      destination:write("local %s={}\n"%{varname})
+      local str = transform(map, "_", data, destination)
+      destination:write("return %s%s"%{str,version_info})
+      local code = destination:concat()
+      f:flush()
+      local code_pos = f:seek()
+      f:write(code)
+      local header = "%s %d %d"%{ BUNDLE_MAGIC, code_pos, #code }
+      assert(#header < BUNDLE_ALIGNMENT)
+      f:seek("set", 0)
+      f:write(header, string.rep(" ", BUNDLE_ALIGNMENT - #header - 1), "\n")
+      f:close()
+    end
+end
+
+-- bundle class, it keeps the mmapped file where matrices are loaded from
+local bundle_mt = {
+  __index = {
+    load = function(self, cls_id, offset)
+      local cls = april_assert(class.find(cls_id),
+                               "Unable locate class %s", cls_id)
+      return cls.fromRawMMap(self.reader:seek(offset))
+    end,
+  },
+}
+
+local function is_bundle(filename)
+  local f = io.open(filename)
+  if not f then return false end
+  local line = f:read(#BUNDLE_MAGIC)
+  f:close()
+  return line ~= nil and line:find(BUNDLE_FIND_MASK) ~= nil
 end
 
+local deserialize_bundle =
+  april_doc{
+    class = "function",
+    summary = "Deserializes an object from a bundle filename",
+    description = {
+      "Matrices are mapped copy-on-write, so the file is never modified",
+      "and memory pages are shared until they are written.",
+      "util.deserialize calls this function when it receives a bundle.",
+    },
+    params = {
+      "A bundle filename",
+      { "... a variadic list of arguments to be passed to",
+        "the object during deserialization", },
+    },
+    outputs = {
+      "A deserialized object",
+    },
+  } ..
+  function(filename, ...)
+    local f = april_assert(io.open(filename), "Unable to locate %s\n",
+                           filename)
+    local magic,code_pos,code_len = f:read("*l"):match("^(%S+)%s+(%d+)%s+(%d+)")
+    assert(magic == BUNDLE_MAGIC, "Incorrect bundle header")
+    f:seek("set", tonumber(code_pos))
+    local code = f:read(tonumber(code_len))
+    f:close()
+    local bundle = setmetatable({
+        reader = util.mmap.reader(filename, true, false, false),
+                                }, bundle_mt)
+    local loader = assert( load(code) )
+    return loader(bundle, ...)
+  end
+
 local deserialize
 deserialize =
   april_doc{
@@ -409,6 +544,7 @@ deserialize =
         local loader = assert( load(dest) )
         return loader(...)
       else
+        if is_bundle(dest) then return deserialize_bundle(dest, ...) end
         local f = april_assert(io.open(dest), "Unable to locate %s\n",
                                dest)
         return deserialize(f, ...)
@@ -427,3 +563,5 @@ deserialize =
 
 util.serialize   = serialize
 util.deserialize = deserialize
+util.serialize_bundle   = serialize_bundle
+util.deserialize_bundle = deserialize_bundle
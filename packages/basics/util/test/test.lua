@@ -44,6 +44,29 @@ T("SerializationTest", function()
     check.eq(type(t2.c), "util.stopwatch")
 end)
 
+T("BundleSerializationTest", function()
+    local tmp = os.tmpname()
+    local w = matrix(20,10):uniformf()
+    local t = { w=w, same=w, b=matrixDouble(10):linspace(), name="net",
+                sub=w[{ {2,4}, {1,3} }] }
+    util.serialize_bundle(t, tmp)
+    local t2 = util.deserialize(tmp)
+    check.eq(t2.w, w)
+    check.eq(t2.b, t.b)
+    check.eq(t2.sub, t.sub)
+    check.eq(t2.name, "net")
+    check.TRUE(rawequal(t2.w, t2.same))
+    -- the submatrix is stored as a contiguous copy, it doesn't share memory
+    -- with its loaded parent
+    check.TRUE(t2.sub:is_contiguous())
+    t2.w[{ {2,4}, {1,3} }]:zeros()
+    check.eq(t2.sub, t.sub)
+    -- copy-on-write mapping, the bundle file is never modified
+    t2.w:zeros()
+    check.eq(util.deserialize_bundle(tmp).w, w)
+    os.remove(tmp)
+end)
+
 T("LambdaTest", function()
     local f = lambda'|x|3*x'
     local g = bind(lambda'|f,x|f(x)^2', f)
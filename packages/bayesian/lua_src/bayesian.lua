@@ -15,16 +15,43 @@ function bayesian.get_MAP_weights(eval, samples)
 end
 
 -- returns a model which forwards computation is a combination of N sampled
--- parameters
+-- parameters. When a component is given instead of a forward function, the
+-- N samples are chosen once and the result is a native ann.components.ensemble,
+-- which forwards all of them in parallel threads (in blocks of the given size)
+-- and which can stop early when the average converges up to the given
+-- tolerance
 function bayesian.build_bayes_comb(t)
   local params = get_table_fields(
     {
-      forward = { mandatory = true, type_match = "function" },
-      shuffle = { isa_match = random, mandatory = false, default=nil },
-      samples = { type_match = "table", mandatory = true },
-      N       = { type_match = "number", mandatory = true, default=100 },
+      forward   = { mandatory = false, type_match = "function" },
+      component = { mandatory = false, isa_match = ann.components.base },
+      shuffle   = { isa_match = random, mandatory = false, default=nil },
+      samples   = { type_match = "table", mandatory = true },
+      N         = { type_match = "number", mandatory = true, default=100 },
+      tolerance = { type_match = "number", mandatory = false, default=0 },
+      block     = { type_match = "number", mandatory = false, default=nil },
+      name      = { type_match = "string", mandatory = false, default=nil },
     }, t, true)  
   assert(#params.samples > 0, "samples table is empty")
+  assert(not params.forward ~= not params.component,
+         "Needs one of forward or component fields")
+  if params.component then
+    local rnd = params.shuffle or random()
+    local samples = iterator.range(params.N):
+    map(function()
+        local which = rnd:choose(params.samples)
+        assert(type(which) == "table",
+               "Samples must be tables of weight matrices")
+        return which
+    end):table()
+    return ann.components.ensemble{
+      name      = params.name,
+      component = params.component,
+      samples   = samples,
+      tolerance = params.tolerance,
+      block     = params.block,
+    }
+  end
   return ann.components.wrapper{
     state = {
       N       = params.N,
@@ -0,0 +1,102 @@
+get_table_from_dotted_string("bayesian", true)
+
+-- Runs several independent chains of a MCMC optimizer (hmc, nuts) in parallel
+-- processes, using parallel_foreach. Every chain builds its own model clone
+-- and optimizer by means of the setup function, and receives its own seed,
+-- computed from the given seed or random object, so results don't depend on
+-- the number of processes. The samples of every chain are received by a sink
+-- (see sinks.lua), by default a bayesian.sinks.stats object.
+--
+-- Fields of the given table:
+--
+--   chains     number of chains
+--   iterations number of calls to step function after the burn-in
+--   setup      function(chain, seed) which returns the optimizer and a step
+--              function, which calls (one or more times) the execute method
+--              of the optimizer, e.g. training a trainable object
+--   burnin     number of calls to step function during burn-in (0)
+--   ncores     number of processes (chains)
+--   seed       seed of the random object which computes chain seeds
+--   random     random object which computes chain seeds
+--   sink       function(chain) which returns the sink of the given chain
+--
+-- Returns a table with the sink of every chain, and when all of them are
+-- bayesian.sinks.stats objects, a second sink with all the chains merged.
+-- Errors of the chains are raised by the caller process, once all the chains
+-- have finished.
+function bayesian.run_chains(t)
+  local params = get_table_fields(
+    {
+      chains     = { type_match = "number",   mandatory = true },
+      iterations = { type_match = "number",   mandatory = true },
+      setup      = { type_match = "function", mandatory = true },
+      burnin     = { type_match = "number",   mandatory = false, default = 0 },
+      ncores     = { type_match = "number",   mandatory = false, default = nil },
+      seed       = { type_match = "number",   mandatory = false, default = nil },
+      random     = { isa_match  = random,     mandatory = false, default = nil },
+      sink       = { type_match = "function", mandatory = false, default = nil },
+    }, t)
+  assert(not params.seed or not params.random,
+         "Fields 'seed' and 'random' are forbidden together")
+  assert(params.chains > 0, "Needs a positive number of chains")
+  local rnd   = params.random or random(params.seed)
+  local seeds = iterator.range(params.chains):
+  map(function() return rnd:randInt(0, 2^31 - 1) end):table()
+  -- executed by every process, returns the filename of the serialized sink
+  local run_chain = function(chain)
+    collectgarbage("collect")
+    local opt,step = params.setup(chain, seeds[chain])
+    assert(opt and opt.set_sink, "Setup function must return a MCMC optimizer")
+    assert(iscallable(step), "Setup function must return a step function")
+    local sink = params.sink and params.sink(chain) or bayesian.sinks.stats()
+    opt:set_option("seed", seeds[chain])
+    opt:get_state_table().rng = random(seeds[chain])
+    opt:set_sink(sink)
+    opt:start_burnin()
+    for i=1,params.burnin do step() end
+    opt:finish_burnin()
+    for i=1,params.iterations do step() end
+    local filename = os.tmpname()
+    util.serialize(sink, filename)
+    -- the temporary file of a mmap sink is owned by its deserialized copy
+    if sink.set_temporary then sink:set_temporary(false) end
+    return filename
+  end
+  -- errors are returned as values, a forked process which throws an error
+  -- would continue executing the code of the caller
+  local safe_run_chain = function(chain)
+    local ok,ret = xpcall(run_chain, debug.traceback, chain)
+    if not ok then return { error=ret } end
+    return ret
+  end
+  local result = parallel_foreach(params.ncores or params.chains, params.chains,
+                                  safe_run_chain)
+  local errors = {}
+  for chain=1,params.chains do
+    local ret = result[chain]
+    if type(ret) == "table" then
+      table.insert(errors, "Chain %d failed: %s"%{ chain, tostring(ret.error) })
+    elseif ret == nil then
+      table.insert(errors, "Chain %d failed" % { chain })
+    end
+  end
+  if #errors > 0 then
+    for chain=1,params.chains do
+      if type(result[chain]) == "string" then os.remove(result[chain]) end
+    end
+    error(table.concat(errors, "\n"))
+  end
+  local sinks = iterator.range(params.chains):
+  map(function(chain)
+      local filename = result[chain]
+      local sink = util.deserialize(filename)
+      os.remove(filename)
+      return sink
+  end):table()
+  if iterator(sinks):all(function(s) return class.is_a(s, bayesian.sinks.stats) end) then
+    local merged = bayesian.sinks.stats()
+    for _,sink in ipairs(sinks) do merged:merge(sink) end
+    return sinks,merged
+  end
+  return sinks
+end
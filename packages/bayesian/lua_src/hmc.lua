@@ -149,8 +149,13 @@ local function hmc(self, eval, theta)
   --
   self:count_one()
   if self:get_count() % thin == 0 then
-    table.insert(samples, md.clone(theta))
-    table.insert(energies, energy)
+    if state.sink then
+      -- samples are streamed to the sink, burn-in samples are discarded
+      if not state.burnin then state.sink:push(theta, energy) end
+    else
+      table.insert(samples, md.clone(theta))
+      table.insert(energies, energy)
+    end
   end
   local acceptance_rate
   if state.acceptance_rate then
@@ -259,6 +264,7 @@ function hmc_methods:clone()
   obj.global_options    = table.deep_copy(self.global_options)
   for k,v in pairs(self.state) do obj.state[k] = v end
   for k,v in pairs(self.state.samples) do obj.state.samples[k] = v:clone() end
+  if self.state.sink then obj.state.sink = self.state.sink:clone() end
   return obj
 end
 
@@ -270,21 +276,46 @@ end
 function hmc_methods:start_burnin()
   self.state.samples  = {}
   self.state.energies = {}
+  self.state.burnin   = true
+  if self.state.sink then self.state.sink:clear() end
 end
 
 function hmc_methods:finish_burnin()
   self.state.samples  = {}
   self.state.energies = {}
+  self.state.burnin   = nil
+  if self.state.sink then self.state.sink:clear() end
+end
+
+-- samples are given to the sink instead of being stored at state.samples,
+-- a nil sink restores the default behavior
+function hmc_methods:set_sink(sink)
+  self.state.sink = sink
+  return self
+end
+
+function hmc_methods:get_sink()
+  return self.state.sink
 end
 
 function hmc_methods:get_samples()
+  local sink = self.state.sink
+  if sink then
+    assert(sink.get_samples, "The sink doesn't keep the samples")
+    return sink:get_samples()
+  end
   return self.state.samples
 end
 
+function hmc_methods:get_num_samples()
+  local sink = self.state.sink
+  return (sink and sink:size()) or #self.state.samples
+end
+
 function hmc_methods:get_state_string()
   return "%6d %11g :: %6d %11g %6.2f%% %s"%
   {
-    self:get_count(), self.state.energy, #self.state.samples,
+    self:get_count(), self.state.energy, self:get_num_samples(),
     self.state.epsilon,
     self.state.acceptance_rate*100, (self.state.accepted and "**") or ""
   }
@@ -115,7 +115,12 @@ local function nuts(self, eval, theta)
   --
   self:count_one()
   if self:get_count() % thin == 0 then
-    table.insert(samples, theta:clone())
+    if state.sink then
+      -- samples are streamed to the sink, burn-in samples are discarded
+      if not state.burnin then state.sink:push(theta, energy) end
+    else
+      table.insert(samples, theta:clone())
+    end
   end
   local acceptance_rate = acc_decay * state.acceptance_rate + (1.0 - acc_decay) * accepted
   -- sanity check
@@ -218,6 +223,7 @@ function nuts_methods:clone()
   obj.state             = {}
   for k,v in pairs(self.state) do obj.state[k] = v end
   for k,v in pairs(self.state.samples) do obj.state.samples[k] = v:clone() end
+  if self.state.sink then obj.state.sink = self.state.sink:clone() end
   return obj
 end
 
@@ -228,20 +234,45 @@ end
 
 function nuts_methods:start_burnin()
   self.state.samples = {}
+  self.state.burnin  = true
+  if self.state.sink then self.state.sink:clear() end
 end
 
 function nuts_methods:finish_burnin()
   self.state.samples = {}
+  self.state.burnin  = nil
+  if self.state.sink then self.state.sink:clear() end
+end
+
+-- samples are given to the sink instead of being stored at state.samples,
+-- a nil sink restores the default behavior
+function nuts_methods:set_sink(sink)
+  self.state.sink = sink
+  return self
+end
+
+function nuts_methods:get_sink()
+  return self.state.sink
 end
 
 function nuts_methods:get_samples()
+  local sink = self.state.sink
+  if sink then
+    assert(sink.get_samples, "The sink doesn't keep the samples")
+    return sink:get_samples()
+  end
   return self.state.samples
 end
 
+function nuts_methods:get_num_samples()
+  local sink = self.state.sink
+  return (sink and sink:size()) or #self.state.samples
+end
+
 function nuts_methods:get_state_string()
   return "%5d %12.6f :: %d  %.6f  %6.2f%%  %s"%
   {
-    self:get_count(), self.state.energy, #self.state.samples,
+    self:get_count(), self.state.energy, self:get_num_samples(),
     self.state.epsilon,
     self.state.acceptance_rate*100, (self.state.accept and "**") or ""
   }
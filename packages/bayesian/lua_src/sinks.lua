@@ -0,0 +1,295 @@
+get_table_from_dotted_string("bayesian.sinks", true)
+
+-- Streaming sinks for the samples of MCMC optimizers (hmc, nuts). A sink is
+-- given to the optimizer by means of set_sink() method, and receives every
+-- thinned sample by push(theta, energy) instead of keeping a copy of it in
+-- state.samples table. All sinks implement:
+--
+--   push(theta, energy) receives a matrix or a table of matrices
+--   clear()             forgets all the received samples
+--   size()              number of received samples
+--   clone()             returns an independent copy of the sink
+
+-- theta is a matrix or a table of matrices (matrix.dict), sinks work always
+-- with tables
+local function to_table(theta)
+  if type(theta) == "table" then return theta,false end
+  return { theta },true
+end
+
+local function from_table(tbl, single)
+  if single then return tbl[1] end
+  return tbl
+end
+
+-- sorted keys, the mmapped layout depends on them
+local function sorted_names(tbl)
+  local names = iterator(table.keys(tbl)):table()
+  table.sort(names, function(a,b) return tostring(a) < tostring(b) end)
+  return names
+end
+
+------------------------------------------------------------------------------
+
+-- Keeps the running mean and variance of the samples using Welford's
+-- algorithm, so memory is constant (three copies of the parameters).
+local stats_class,stats_methods = class("bayesian.sinks.stats")
+bayesian.sinks.stats = stats_class -- global environment
+
+function stats_class:constructor(t)
+  local t = t or {}
+  self.n      = t.n or 0
+  self.mean   = t.mean
+  self.m2     = t.m2
+  self.single = t.single or false
+end
+
+function stats_methods:push(theta)
+  local theta,single = to_table(theta)
+  local md = matrix.dict
+  if not self.mean then
+    self.mean   = md.clone_only_dims(theta) md.zeros(self.mean)
+    self.m2     = md.clone_only_dims(theta) md.zeros(self.m2)
+    self.single = single
+  end
+  local n = self.n + 1
+  -- delta = x - mean(n-1), mean(n) = mean(n-1) + delta/n
+  local delta = md.axpy(md.clone(theta), -1.0, self.mean)
+  md.axpy(self.mean, 1.0/n, delta)
+  -- m2(n) = m2(n-1) + delta .* (x - mean(n))
+  local delta2 = md.axpy(md.clone(theta), -1.0, self.mean)
+  md.axpy(self.m2, 1.0, md.cmul(delta, delta2))
+  self.n = n
+end
+
+-- Combines the statistics of other sink into this one, as if all its samples
+-- were received by this sink (Chan et al. parallel variance algorithm).
+function stats_methods:merge(other)
+  assert(class.is_a(other, stats_class), "Needs a bayesian.sinks.stats object")
+  if other.n == 0 then return self end
+  if self.n == 0 then
+    self.n      = other.n
+    self.mean   = matrix.dict.clone(other.mean)
+    self.m2     = matrix.dict.clone(other.m2)
+    self.single = other.single
+    return self
+  end
+  local md = matrix.dict
+  local na,nb = self.n,other.n
+  local n = na + nb
+  local delta = md.axpy(md.clone(other.mean), -1.0, self.mean)
+  md.axpy(self.m2, 1.0, other.m2)
+  md.axpy(self.m2, na*nb/n, md.cmul(md.clone(delta), delta))
+  md.axpy(self.mean, nb/n, delta)
+  self.n = n
+  return self
+end
+
+function stats_methods:clear()
+  self.n, self.mean, self.m2 = 0, nil, nil
+end
+
+function stats_methods:size()
+  return self.n
+end
+
+function stats_methods:get_mean()
+  assert(self.n > 0, "Empty sink")
+  return from_table(self.mean, self.single)
+end
+
+-- unbiased estimation of the variance
+function stats_methods:get_variance()
+  assert(self.n > 1, "Needs at least two samples")
+  local var = matrix.dict.scal(matrix.dict.clone(self.m2), 1.0/(self.n - 1))
+  return from_table(var, self.single)
+end
+
+function stats_methods:clone()
+  local mean = self.mean and matrix.dict.clone(self.mean)
+  local m2   = self.m2 and matrix.dict.clone(self.m2)
+  return stats_class{ n=self.n, mean=mean, m2=m2, single=self.single }
+end
+
+function stats_methods:ctor_name() return "bayesian.sinks.stats" end
+function stats_methods:ctor_params()
+  return { n=self.n, mean=self.mean, m2=self.m2, single=self.single }
+end
+
+------------------------------------------------------------------------------
+
+-- Writes every sample as one row of a raw matrix file (see matrix.fromRawMMap)
+-- which is mapped in memory, so samples live in the page cache instead of
+-- the Lua heap. The file is preallocated for the given number of samples.
+--
+-- When no path is given the sink is temporary, it writes into an
+-- os.tmpname() file which is removed when the sink is garbage collected.
+-- Serialized copies keep this flag, so only one of the copies should remain
+-- temporary, see set_temporary().
+local mmap_class,mmap_methods = class("bayesian.sinks.mmap")
+bayesian.sinks.mmap = mmap_class -- global environment
+
+-- writes the header of a raw matrix file, as m:toFilename(path, "raw") does
+local RAW_ALIGNMENT = 64
+local function create_raw_file(path, rows, cols)
+  local header = "%d %d\nraw 4 le"%{ rows, cols }
+  local padding = (RAW_ALIGNMENT - (#header + 1) % RAW_ALIGNMENT) % RAW_ALIGNMENT
+  header = header .. string.rep(" ", padding) .. "\n"
+  local f = april_assert(io.open(path, "w"), "Unable to open %s", path)
+  f:write(header)
+  -- extends the file up to its final size without writing the data
+  f:seek("set", #header + rows*cols*4 - 1)
+  f:write("\0")
+  f:close()
+end
+
+function mmap_class:constructor(t)
+  local params = get_table_fields(
+    {
+      path      = { type_match = "string", mandatory = false, default = nil },
+      size      = { type_match = "number", mandatory = true },
+      temporary = { type_match = "boolean", mandatory = false, default = nil },
+      -- following fields are used by deserialization
+      count     = { type_match = "number", mandatory = false, default = 0 },
+      names     = { type_match = "table",  mandatory = false, default = nil },
+      shapes    = { type_match = "table",  mandatory = false, default = nil },
+      energies  = { type_match = "table",  mandatory = false, default = nil },
+      single    = { type_match = "boolean", mandatory = false, default = false },
+    }, t)
+  assert(params.size > 0, "Needs a positive size")
+  self.path      = params.path or os.tmpname()
+  self.capacity  = params.size
+  self.temporary = params.temporary
+  if self.temporary == nil then self.temporary = (params.path == nil) end
+  self.count     = params.count
+  self.names     = params.names
+  self.shapes    = params.shapes
+  self.energies  = params.energies or {}
+  self.single    = params.single
+  if self.names then self:open() end
+end
+
+function mmap_class:destructor()
+  if self.temporary then
+    self.data = nil
+    os.remove(self.path)
+  end
+end
+
+-- maps the file, it is created at first push() call, when the number of
+-- columns is known
+function mmap_methods:open()
+  self.data = matrix.fromRawMMap(self.path, true, true)
+  april_assert(self.data:dim(1) == self.capacity,
+               "Incorrect number of rows at %s", self.path)
+end
+
+function mmap_methods:push(theta, energy)
+  local theta,single = to_table(theta)
+  if not self.names then
+    self.names  = sorted_names(theta)
+    self.shapes = iterator(self.names):
+    map(function(name) return theta[name]:dim() end):table()
+    self.single = single
+    create_raw_file(self.path, self.capacity,
+                    iterator(self.names):
+                      map(function(name) return theta[name]:size() end):sum())
+    self:open()
+  end
+  april_assert(self.count < self.capacity,
+               "The mmap sink is full, its size is %d", self.capacity)
+  local n = self.count + 1
+  local row = self.data:select(1, n)
+  local first = 1
+  for _,name in ipairs(self.names) do
+    local w = april_assert(theta[name], "Unable to find key %s", name)
+    local last = first + w:size() - 1
+    row[{ {first, last} }]:copy(w:contiguous():rewrap(w:size()))
+    first = last + 1
+  end
+  self.count = n
+  self.energies[n] = energy
+end
+
+function mmap_methods:clear()
+  self.count    = 0
+  self.energies = {}
+end
+
+function mmap_methods:size()
+  return self.count
+end
+
+-- returns the i-th sample, its matrices point to the mapped memory
+function mmap_methods:get_sample(i)
+  assert(i >= 1 and i <= self.count, "Index out of bounds")
+  local row = self.data:select(1, i)
+  local sample = {}
+  local first = 1
+  for j,name in ipairs(self.names) do
+    local shape = self.shapes[j]
+    local sz = iterator(shape):prod()
+    sample[name] = row[{ {first, first + sz - 1} }]:rewrap(table.unpack(shape))
+    first = first + sz
+  end
+  return from_table(sample, self.single)
+end
+
+-- returns a table with all the samples, compatible with
+-- bayesian.build_bayes_comb and bayesian.get_MAP_weights
+function mmap_methods:get_samples()
+  return iterator.range(self.count):
+  map(function(i) return self:get_sample(i) end):table()
+end
+
+function mmap_methods:get_energies()
+  return self.energies
+end
+
+-- the rows of the mapped matrix in use
+function mmap_methods:get_matrix()
+  assert(self.count > 0, "Empty sink")
+  return self.data[{ {1, self.count}, ':' }]
+end
+
+-- the copy writes into its own temporary file, which receives the samples
+-- pushed up to now, so clones of an optimizer don't overwrite their samples
+function mmap_methods:clone()
+  local obj = mmap_class{ size=self.capacity }
+  if self.names then
+    obj.names  = table.deep_copy(self.names)
+    obj.shapes = table.deep_copy(self.shapes)
+    obj.single = self.single
+    create_raw_file(obj.path, self.capacity, self.data:dim(2))
+    obj:open()
+    if self.count > 0 then
+      obj.data[{ {1, self.count}, ':' }]:copy(self:get_matrix())
+    end
+    obj.count    = self.count
+    obj.energies = table.deep_copy(self.energies)
+  end
+  return obj
+end
+
+-- a temporary sink removes its file when it is garbage collected
+function mmap_methods:set_temporary(v)
+  self.temporary = v
+end
+
+function mmap_methods:is_temporary()
+  return self.temporary
+end
+
+function mmap_methods:ctor_name() return "bayesian.sinks.mmap" end
+function mmap_methods:ctor_params()
+  return {
+    path      = self.path,
+    size      = self.capacity,
+    temporary = self.temporary,
+    count     = self.count,
+    names     = self.names,
+    shapes    = self.shapes,
+    energies  = table.deep_copy(self.energies),
+    single    = self.single,
+  }
+end
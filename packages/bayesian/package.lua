@@ -13,14 +13,14 @@
      delete{ dir = "build" },
      delete{ dir = "include" },
    },
-   -- target{
-   --   name = "test",
-   --   execute_script{
-   --     file={
-   --       "test/test_hmc.lua",
-   --     },
-   --   },
-   -- },
+   target{
+     name = "test",
+     lua_unit_test{
+       file={
+         "test/test_sinks.lua",
+       },
+     },
+   },
    target{
      name = "provide",
      depends = "init",
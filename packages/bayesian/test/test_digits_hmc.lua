@@ -161,6 +161,24 @@ for j=1,#trainers do
                                                   output_dataset=datosentrenar.output_dataset,
                                                 }))
   print("VA", bayesian_trainer:validate_dataset(datosvalidar))
+  -- the same combination with a native ensemble, members are forwarded in
+  -- parallel threads
+  local ensemble_model = bayesian.build_bayes_comb{
+    component = thenet:clone(),
+    N=1000,
+    tolerance=1e-4,
+    shuffle=rnd,
+    samples=hmc:get_samples(),
+  }
+  local ensemble_trainer = trainable.supervised_trainer(ensemble_model,
+                                                        ann.loss.zero_one(),
+                                                        32)
+  ensemble_trainer:build()
+  print("TR", ensemble_trainer:validate_dataset({
+                                                  input_dataset=datosentrenar.input_dataset,
+                                                  output_dataset=datosentrenar.output_dataset,
+                                                }))
+  print("VA", ensemble_trainer:validate_dataset(datosvalidar))
   -- MAP on validation
   trainers[j]:set_loss_function(ann.loss.zero_one())
   local energies = hmc:get_state_table().energies
@@ -0,0 +1,200 @@
+local check = utest.check
+local T = utest.test
+
+local function gen_sample(rnd)
+  return { a = matrix(2,3):uniformf(-1,1,rnd), b = matrix(4):uniformf(-1,1,rnd) }
+end
+
+local function check_sample(s1, s2)
+  check.eq(s1.a, s2.a)
+  check.eq(s1.b, s2.b)
+end
+
+T("MMapSinkCloneTest", function()
+    local rnd  = random(1234)
+    local sink = bayesian.sinks.mmap{ size=4 }
+    local w1   = gen_sample(rnd)
+    sink:push(w1, 1.0)
+    -- the clone receives the pushed samples into its own file
+    local sink2 = sink:clone()
+    check.neq(sink2.path, sink.path)
+    check.TRUE(sink2:is_temporary())
+    check.eq(sink2:size(), 1)
+    check_sample(sink2:get_sample(1), w1)
+    local w2, w3 = gen_sample(rnd), gen_sample(rnd)
+    sink:push(w2, 2.0)
+    sink2:push(w3, 3.0)
+    check_sample(sink:get_sample(2), w2)
+    check_sample(sink2:get_sample(2), w3)
+    check.eq(sink:get_energies()[2], 2.0)
+    check.eq(sink2:get_energies()[2], 3.0)
+    -- temporary files are removed when the sink is collected
+    local path = sink2.path
+    sink2 = nil
+    collectgarbage("collect")
+    check.FALSE(io.open(path))
+    -- a given path is kept
+    local path = os.tmpname()
+    local sink3 = bayesian.sinks.mmap{ path=path, size=2 }
+    check.FALSE(sink3:is_temporary())
+    sink3:push(w1, 1.0)
+    sink3 = nil
+    collectgarbage("collect")
+    local f = io.open(path)
+    check.TRUE(f)
+    if f then f:close() end
+    os.remove(path)
+end)
+
+-- stacks the samples of the given name as rows of a matrix
+local function stack(samples, name)
+  local X = matrix(#samples, samples[1][name]:size())
+  for i,s in ipairs(samples) do X:select(1,i):copy(s[name]:rewrap(s[name]:size())) end
+  return X
+end
+
+T("StatsSinkTest", function()
+    local rnd = random(4321)
+    local samples = iterator.range(20):map(function() return gen_sample(rnd) end):table()
+    local sink = bayesian.sinks.stats()
+    for _,s in ipairs(samples) do sink:push(s) end
+    check.eq(sink:size(), #samples)
+    local mean,var = sink:get_mean(),sink:get_variance()
+    for _,name in ipairs{ "a", "b" } do
+      local X  = stack(samples, name)
+      local sz = X:dim(2)
+      check.eq(mean[name]:rewrap(sz), stats.amean(X,1):rewrap(sz))
+      check.eq(var[name]:rewrap(sz), stats.var(X,1):rewrap(sz))
+    end
+    -- one component against the running mean and variance of stats package
+    local mv = stats.running.mean_var()
+    for _,s in ipairs(samples) do mv:add(s.a:get(2,3)) end
+    local mu,sigma2 = mv:compute()
+    check.number_eq(mean.a:get(2,3), mu, 1e-04)
+    check.number_eq(var.a:get(2,3), sigma2, 1e-04)
+    -- a single matrix is returned as a matrix
+    local single = bayesian.sinks.stats()
+    for _,s in ipairs(samples) do single:push(s.b) end
+    check.TRUE(class.is_a(single:get_mean(), matrix))
+    check.eq(single:get_mean(), mean.b)
+    check.eq(single:get_variance(), var.b)
+end)
+
+T("StatsSinkMergeTest", function()
+    local rnd = random(8765)
+    local samples = iterator.range(17):map(function() return gen_sample(rnd) end):table()
+    local all = bayesian.sinks.stats()
+    for _,s in ipairs(samples) do all:push(s) end
+    -- three streams of different lengths, one of them empty
+    local s1,s2,s3 = bayesian.sinks.stats(),bayesian.sinks.stats(),bayesian.sinks.stats()
+    for i=1,5 do s1:push(samples[i]) end
+    for i=6,#samples do s2:push(samples[i]) end
+    local merged = bayesian.sinks.stats():merge(s1):merge(s3):merge(s2)
+    check.eq(merged:size(), all:size())
+    check_sample(merged:get_mean(), all:get_mean())
+    check_sample(merged:get_variance(), all:get_variance())
+    -- the merged streams are not modified
+    check.eq(s1:size(), 5)
+    check.eq(s2:size(), #samples - 5)
+end)
+
+T("MMapSinkTest", function()
+    local rnd  = random(5678)
+    local samples = iterator.range(6):map(function() return gen_sample(rnd) end):table()
+    local sink = bayesian.sinks.mmap{ size=10 }
+    for i,s in ipairs(samples) do sink:push(s, -i) end
+    check.eq(sink:size(), #samples)
+    for i,s in ipairs(samples) do
+      check_sample(sink:get_sample(i), s)
+      check.eq(sink:get_energies()[i], -i)
+    end
+    check.eq(sink:get_matrix():dim(1), #samples)
+    check.eq(stack(sink:get_samples(), "b"), stack(samples, "b"))
+    -- the serialized copy maps the same file, and it becomes its owner
+    local sink2 = util.deserialize(util.serialize(sink))
+    sink:set_temporary(false)
+    check.TRUE(sink2:is_temporary())
+    check.eq(sink2.path, sink.path)
+    check.eq(sink2:size(), #samples)
+    for i,s in ipairs(samples) do
+      check_sample(sink2:get_sample(i), s)
+      check.eq(sink2:get_energies()[i], -i)
+    end
+    sink2:push(samples[1], 1.0)
+    check_sample(sink2:get_sample(#samples + 1), samples[1])
+    -- a single matrix is returned as a matrix
+    local single = bayesian.sinks.mmap{ size=2 }
+    single:push(samples[1].a, 0.0)
+    check.TRUE(class.is_a(single:get_sample(1), matrix))
+    check.eq(single:get_sample(1), samples[1].a)
+    check.errored(function() single:push(samples[2].a, 0.0) single:push(samples[2].a, 0.0) end)
+end)
+
+T("RunChainsTest", function()
+    local iterations = 20
+    local setup = function(chain, seed)
+      local rnd = random(seed)
+      local x = matrix(1,2):uniformf(-1,1,rnd)
+      local hmc = bayesian.optimizer.hmc()
+      local eval = function(params)
+        local x = params.x
+        return 0.5 * x:dot(x), { x=x:clone() }
+      end
+      return hmc,function() hmc:execute(eval, { x=x }) end
+    end
+    local run = function(ncores, sink)
+      return bayesian.run_chains{ chains=3, iterations=iterations, burnin=5,
+                                  setup=setup, seed=1234, ncores=ncores,
+                                  sink=sink }
+    end
+    -- stats sinks, every chain and the merged one
+    local sinks1,merged1 = run(1)
+    local sinks3,merged3 = run(3)
+    check.eq(#sinks1, 3)
+    check.eq(#sinks3, 3)
+    for i=1,3 do
+      check.eq(sinks1[i]:size(), iterations)
+      check.eq(sinks1[i]:size(), sinks3[i]:size())
+      check.eq(sinks1[i]:get_mean().x, sinks3[i]:get_mean().x)
+      check.eq(sinks1[i]:get_variance().x, sinks3[i]:get_variance().x)
+    end
+    check.eq(merged1:size(), 3*iterations)
+    check.eq(merged1:get_mean().x, merged3:get_mean().x)
+    check.eq(merged1:get_variance().x, merged3:get_variance().x)
+    -- chains with different seeds produce different samples
+    check.neq(sinks1[1]:get_mean().x, sinks1[2]:get_mean().x)
+    -- mmap sinks are received by the caller process
+    local mmap = function() return bayesian.sinks.mmap{ size=iterations } end
+    local msinks1,mmerged1 = run(1, mmap)
+    local msinks3 = run(3, mmap)
+    check.FALSE(mmerged1)
+    for i=1,3 do
+      check.TRUE(msinks1[i]:is_temporary())
+      check.eq(msinks1[i]:get_matrix(), msinks3[i]:get_matrix())
+      check.eq(stats.amean(msinks1[i]:get_matrix(), 1):rewrap(2),
+               sinks1[i]:get_mean().x:rewrap(2))
+      for j=1,iterations do
+        check.eq(msinks1[i]:get_energies()[j], msinks3[i]:get_energies()[j])
+      end
+    end
+end)
+
+T("RunChainsErrorTest", function()
+    local setup = function(chain, seed)
+      if chain == 2 then error("setup error") end
+      local x = matrix(1,2):zeros()
+      local hmc = bayesian.optimizer.hmc()
+      local eval = function(params) return 0.5 * params.x:dot(params.x), { x=params.x:clone() } end
+      return hmc,function() hmc:execute(eval, { x=x }) end
+    end
+    for _,ncores in ipairs{ 1, 3 } do
+      local ok,msg = pcall(bayesian.run_chains,
+                           { chains=3, iterations=2, setup=setup,
+                             seed=1234, ncores=ncores })
+      -- only the caller process receives the error of the failed chain
+      check.FALSE(ok)
+      check.TRUE(tostring(msg):find("Chain 2 failed"))
+      check.TRUE(tostring(msg):find("setup error"))
+      check.FALSE(tostring(msg):find("Chain 1 failed"))
+    end
+end)
@@ -7,6 +7,68 @@ using namespace HMMs;
 
 //BIND_HEADER_C
 using namespace AprilUtils;
+
+// Los vectores devueltos por get_model_list y get_matrix_list son userdata
+// que quedan en la pila de Lua, de forma que Lua los libera aunque se
+// produzca un error antes de terminar el metodo.
+
+// Devuelve el vector de modelos del campo "models" de la tabla en idx, y
+// su talla en n. Todos los modelos deben pertenecer al trainer dado.
+static hmm_trainer_model **get_model_list(lua_State *L, int idx,
+                                          hmm_trainer *trainer, int &n) {
+  lua_getfield(L, idx, "models");
+  if (!lua_istable(L, -1)) {
+    luaL_error(L, "Needs a table at field models");
+  }
+  n = static_cast<int>(luaL_len(L, -1));
+  hmm_trainer_model **models = static_cast<hmm_trainer_model**>
+    (lua_newuserdata(L, n*sizeof(hmm_trainer_model*)));
+  lua_insert(L, -2); // el userdata queda bajo la tabla
+  for (int i=0; i<n; ++i) {
+    lua_rawgeti(L, -1, i+1);
+    if (!lua_ishmm_trainer_model(L, -1)) {
+      luaL_error(L, "Expected a hmm_trainer_model at position %d of models",
+                 i+1);
+    }
+    models[i] = lua_tohmm_trainer_model(L, -1);
+    if (models[i]->get_trainer() != trainer) {
+      luaL_error(L, "The hmm_trainer_model at position %d of models belongs "
+                 "to another hmm_trainer", i+1);
+    }
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+  return models;
+}
+
+// Devuelve el vector de n matrices del campo name de la tabla en idx, o
+// NULL si el campo no existe y no es obligatorio.
+static MatrixFloat **get_matrix_list(lua_State *L, int idx, const char *name,
+                                     int n, bool required) {
+  MatrixFloat **result = 0;
+  lua_getfield(L, idx, name);
+  if (lua_isnil(L, -1)) {
+    if (required) luaL_error(L, "Needs a table at field %s", name);
+  }
+  else {
+    if (!lua_istable(L, -1) || static_cast<int>(luaL_len(L, -1)) != n) {
+      luaL_error(L, "Needs a table with %d matrices at field %s", n, name);
+    }
+    result = static_cast<MatrixFloat**>
+      (lua_newuserdata(L, n*sizeof(MatrixFloat*)));
+    lua_insert(L, -2); // el userdata queda bajo la tabla
+    for (int i=0; i<n; ++i) {
+      lua_rawgeti(L, -1, i+1);
+      if (!lua_isMatrixFloat(L, -1)) {
+        luaL_error(L, "Expected a matrix at position %d of %s", i+1, name);
+      }
+      result[i] = lua_toMatrixFloat(L, -1);
+      lua_pop(L, 1);
+    }
+  }
+  lua_pop(L, 1);
+  return result;
+}
 //BIND_END
 
 //BIND_LUACLASSNAME hmm_trainer hmm_trainer
@@ -179,6 +241,89 @@ using namespace AprilUtils;
 }
 //BIND_END
 
+//BIND_METHOD hmm_trainer batch_viterbi
+// Viterbi en paralelo de una lista de pares (modelo, emisiones), los
+// contadores del EM se acumulan en el trainer. Devuelve una tabla con
+// los log(probabilidad) y otra con las cadenas de salida.
+{
+  LUABIND_CHECK_ARGN(==,1);
+  LUABIND_CHECK_PARAMETER(1, table);
+  check_table_fields(L, 1,
+		     "models",
+		     "input_emissions",
+		     "output_emission_seqs",
+		     "output_emissions",
+		     "do_expectation",
+		     "emission_in_log_base",
+		     "count_value",
+		     "beam",
+		     "max_active",
+		     (const char *)0);
+  bool do_expectation, emission_in_log_base;
+  float count_value, beam;
+  int max_active;
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, do_expectation, bool,
+				       do_expectation, false);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, emission_in_log_base, bool,
+				       emission_in_log_base, false);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, count_value,
+				       float, count_value, 1.0f);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, beam, float, beam, 0.0f);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, max_active, int, max_active, 0);
+  int n;
+  hmm_trainer_model **models = get_model_list(L, 1, obj, n);
+  MatrixFloat **input  = get_matrix_list(L, 1, "input_emissions", n, true);
+  MatrixFloat **seqs   = get_matrix_list(L, 1, "output_emission_seqs", n, false);
+  MatrixFloat **output = get_matrix_list(L, 1, "output_emissions", n, false);
+  char **output_strs   = static_cast<char**>
+    (lua_newuserdata(L, n*sizeof(char*)));
+  float *log_probs     = static_cast<float*>
+    (lua_newuserdata(L, n*sizeof(float)));
+  obj->batch_viterbi(n, models, input, emission_in_log_base, do_expectation,
+		     output, seqs, output_strs, log_probs, count_value,
+		     beam, max_active);
+  lua_createtable(L, n, 0);
+  lua_createtable(L, n, 0);
+  for (int i=0; i<n; ++i) {
+    lua_pushnumber(L, log_probs[i]);
+    lua_rawseti(L, -3, i+1);
+    lua_pushstring(L, output_strs[i]);
+    lua_rawseti(L, -2, i+1);
+    delete[] output_strs[i];
+  }
+  return 2;
+}
+//BIND_END
+
+//BIND_METHOD hmm_trainer batch_forward_backward
+// Forward-backward en paralelo de una lista de pares (modelo, emisiones),
+// por defecto la salida se deja en las mismas matrices de entrada.
+{
+  LUABIND_CHECK_ARGN(==,1);
+  LUABIND_CHECK_PARAMETER(1, table);
+  check_table_fields(L, 1,
+		     "models",
+		     "input_emissions",
+		     "output_emissions",
+		     "do_expectation",
+		     (const char *)0);
+  bool do_expectation;
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, do_expectation, bool,
+				       do_expectation, true);
+  int n;
+  hmm_trainer_model **models = get_model_list(L, 1, obj, n);
+  MatrixFloat **input  = get_matrix_list(L, 1, "input_emissions", n, true);
+  MatrixFloat **output = get_matrix_list(L, 1, "output_emissions", n, false);
+  for (int i=0; i<n; ++i) {
+    if (input[i]->getNumDim() != 2) {
+      LUABIND_FERROR1("hmm_trainer batch_forward_backward method: "
+		      "emission matrix %d must have dim 2", i+1);
+    }
+  }
+  obj->batch_forward_backward(n, models, input, output, do_expectation);
+}
+//BIND_END
+
 //BIND_METHOD hmm_trainer_model new_state
 {
   LUABIND_CHECK_ARGN(==,0);
@@ -259,6 +404,8 @@ using namespace AprilUtils;
 		     "do_expectation",
 		     "emission_in_log_base",
 		     "count_value",
+		     "beam",
+		     "max_active",
 		     (const char *)0);
   //
   MatrixFloat *input_matemi, *output_matemi_seq, *output_matemi;
@@ -281,16 +428,37 @@ using namespace AprilUtils;
   float count_value;
   LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, count_value,
 				       float, count_value, 1.0f);
+  // Poda: beam en escala logaritmica y numero maximo de estados activos,
+  // un valor <= 0 desactiva cada una de ellas
+  float beam;
+  int max_active;
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, beam, float, beam, 0.0f);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, max_active, int, max_active, 0);
   //
   char *output;
-  log_float resul = obj->viterbi(input_matemi,
-				 emission_in_log_base,
-				 do_expectation,
-				 output_matemi,
-				 output_matemi_seq,
-				 state_probabilities,
-				 &output,
-				 count_value);
+  log_float resul;
+  if (beam > 0.0f || max_active > 0) {
+    resul = obj->viterbi_beam(input_matemi,
+			      emission_in_log_base,
+			      do_expectation,
+			      output_matemi,
+			      output_matemi_seq,
+			      state_probabilities,
+			      &output,
+			      count_value,
+			      beam,
+			      max_active);
+  }
+  else {
+    resul = obj->viterbi(input_matemi,
+			 emission_in_log_base,
+			 do_expectation,
+			 output_matemi,
+			 output_matemi_seq,
+			 state_probabilities,
+			 &output,
+			 count_value);
+  }
   LUABIND_RETURN(float, resul.log()); // devuelve log(probabilidad)
   LUABIND_RETURN(string, output);
   delete[] output;
@@ -25,6 +25,11 @@
 #include <cstdlib> // para exit
 #include <cstring>
 #include "april_assert.h"
+#include "maxmin.h"
+#include "min_heap.h"
+#include "omp_utils.h"
+#include "qsort.h"
+#include "vector.h"
 
 using namespace AprilUtils;
 using namespace Basics;
@@ -126,6 +131,128 @@ namespace HMMs {
     }
   }
 
+  hmm_trainer_accumulator::
+  hmm_trainer_accumulator(int num_cls_transitions, int num_cls_emissions) :
+    num_cls_transitions(num_cls_transitions),
+    num_cls_emissions(num_cls_emissions) {
+    acum_tran     = new log_double[num_cls_transitions];
+    acum_emission = new log_double[num_cls_emissions];
+    clear();
+  }
+
+  hmm_trainer_accumulator::~hmm_trainer_accumulator() {
+    delete[] acum_tran;
+    delete[] acum_emission;
+  }
+
+  void hmm_trainer_accumulator::clear() {
+    for (int i=0; i<num_cls_transitions; i++)
+      acum_tran[i] = log_double::zero();
+    for (int i=0; i<num_cls_emissions; i++)
+      acum_emission[i] = log_double::zero();
+  }
+
+  void hmm_trainer::merge_expectation(const hmm_trainer_accumulator &acum) {
+    april_assert(acum.num_cls_transitions == num_cls_transitions &&
+                 acum.num_cls_emissions == num_cls_emissions);
+    for (int i=0;i<num_cls_transitions;i++)
+      cls_transition[i].acum += acum.acum_tran[i];
+    for (int i=0;i<num_cls_emissions;i++)
+      acum_cls_emission[i] += acum.acum_emission[i];
+  }
+
+  // number of sequences processed between two merges of the batch methods,
+  // multiplied by the number of threads
+  static const int BATCH_BLOCK_FACTOR = 4;
+
+  void hmm_trainer::batch_viterbi(int n, hmm_trainer_model **models,
+                                  MatrixFloat **emissions,
+                                  bool emission_in_log_base,
+                                  bool do_expectation,
+                                  MatrixFloat **reest_emissions,
+                                  MatrixFloat **seq_reest_emissions,
+                                  char **output_strs,
+                                  float *log_probs,
+                                  float count_value,
+                                  float beam,
+                                  int max_active) {
+    const int block_size = BATCH_BLOCK_FACTOR * OMPUtils::get_num_threads();
+    // one accumulator per sequence of the block, merged in sequence order so
+    // the sums don't depend on the number of threads
+    hmm_trainer_accumulator **acums = new hmm_trainer_accumulator*[block_size];
+    for (int b=0; b<block_size; b++) {
+      acums[b] = (do_expectation) ?
+        new hmm_trainer_accumulator(num_cls_transitions, num_cls_emissions) : 0;
+    }
+    for (int first=0; first<n; first+=block_size) {
+      const int last = AprilUtils::min(first + block_size, n);
+#ifndef NO_OMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+      for (int i=first; i<last; i++) {
+        hmm_trainer_accumulator *acum = acums[i - first];
+        MatrixFloat *reest = (reest_emissions) ? reest_emissions[i] : 0;
+        MatrixFloat *seq_reest = (seq_reest_emissions) ? seq_reest_emissions[i] : 0;
+        char *output;
+        log_float p;
+        if (beam > 0.0f || max_active > 0) {
+          p = models[i]->viterbi_beam(emissions[i], emission_in_log_base,
+                                      do_expectation, reest, seq_reest, 0,
+                                      &output, count_value, beam, max_active,
+                                      acum);
+        }
+        else {
+          p = models[i]->viterbi(emissions[i], emission_in_log_base,
+                                 do_expectation, reest, seq_reest, 0,
+                                 &output, count_value, acum);
+        }
+        log_probs[i] = p.log();
+        if (output_strs) output_strs[i] = output;
+        else delete[] output;
+      }
+      if (do_expectation) {
+        for (int i=first; i<last; i++) {
+          merge_expectation(*acums[i - first]);
+          acums[i - first]->clear();
+        }
+      }
+    }
+    for (int b=0; b<block_size; b++) delete acums[b];
+    delete[] acums;
+  }
+
+  void hmm_trainer::batch_forward_backward(int n, hmm_trainer_model **models,
+                                           MatrixFloat **input_emissions,
+                                           MatrixFloat **output_emissions,
+                                           bool do_expectation) {
+    const int block_size = BATCH_BLOCK_FACTOR * OMPUtils::get_num_threads();
+    // a priori emission counts are always accumulated by backward(), one
+    // accumulator per sequence of the block, @see batch_viterbi()
+    hmm_trainer_accumulator **acums = new hmm_trainer_accumulator*[block_size];
+    for (int b=0; b<block_size; b++) {
+      acums[b] = new hmm_trainer_accumulator(num_cls_transitions,
+                                             num_cls_emissions);
+    }
+    for (int first=0; first<n; first+=block_size) {
+      const int last = AprilUtils::min(first + block_size, n);
+#ifndef NO_OMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+      for (int i=first; i<last; i++) {
+        MatrixFloat *output = (output_emissions && output_emissions[i]) ?
+          output_emissions[i] : input_emissions[i];
+        models[i]->forward_backward(input_emissions[i], output,
+                                    do_expectation, acums[i - first]);
+      }
+      for (int i=first; i<last; i++) {
+        merge_expectation(*acums[i - first]);
+        acums[i - first]->clear();
+      }
+    }
+    for (int b=0; b<block_size; b++) delete acums[b];
+    delete[] acums;
+  }
+
   void hmm_trainer::begin_expectation() {
     for (int i=0;i<num_cls_transitions;i++)
       cls_transition[i].acum = log_double::zero();
@@ -271,6 +398,9 @@ namespace HMMs {
     list_transitions= 0;
     transition      = 0;
     //ranking         = 0;
+    first_transition= 0;
+    ranked_state    = 0;
+    state_rank      = 0;
     trainer         = the_trainer;
     IncRef(trainer);
   }
@@ -322,6 +452,9 @@ namespace HMMs {
     // calcular orden de los estados que induce un orden sobre las
     // transiciones para que las de tipo lambda funcionen correctamente:
     transition = new hmm_trainer_transition[num_transitions];
+    first_transition = new int[num_states+1];
+    ranked_state     = new int[num_states];
+    state_rank       = new int[num_states];
 
     // lista para guardar, para cada estado, las transiciones
     // que salen de ese estado:
@@ -332,7 +465,6 @@ namespace HMMs {
     // ranking cuenta el camino de lambdas más largo que llega a cada
     // estado:
     // ranking         = new int[num_states];
-    // first_transition= new int[num_states+1];
     for (int i=0;i<num_states;i++) {
       salen_de[i]   = 0;
       numlambdas[i] = 0;
@@ -360,11 +492,17 @@ namespace HMMs {
     // procesar los estados en orden topologico respecto al grafo
     // compuesto unicamente por las transiciones lambda
     int itr = 0;
+    int rank = 0;
     while (listop != 0) {
       list_top_order *a = listop;
       listop = listop->next;
       int st = a->state;
       delete a;
+      // las transiciones de st empiezan en itr (formato CSR)
+      ranked_state[rank]     = st;
+      state_rank[st]         = rank;
+      first_transition[rank] = itr;
+      rank++;
       // procesar todas las transiciones que salen de st
       while (salen_de[st] != 0) {
         int emis              = salen_de[st]->emission;
@@ -389,6 +527,7 @@ namespace HMMs {
         delete aux;
       }
     } // while (listop != 0);
+    first_transition[rank] = itr;
 
     delete[] salen_de;
     delete[] numlambdas;
@@ -397,8 +536,10 @@ namespace HMMs {
     // valer num_transitions
     if (itr != num_transitions) {
       delete[] transition;       transition=0;
+      delete[] first_transition; first_transition=0;
+      delete[] ranked_state;     ranked_state=0;
+      delete[] state_rank;       state_rank=0;
       // delete[] ranking;          ranking=0;
-      //delete[] first_transition; first_transition=0;
       ERROR_PRINT2("prepare_model(): error, itr(%d) != num_transitions(%d)\n",
                    itr, num_transitions);
       return false;
@@ -415,6 +556,9 @@ namespace HMMs {
           delete[] transition[i].output;
       delete[] transition;
     }
+    delete[] first_transition;
+    delete[] ranked_state;
+    delete[] state_rank;
   }
 
   inline log_float hmm_trainer_model::transition_prob(int tr) {
@@ -422,6 +566,19 @@ namespace HMMs {
     return trainer->get_cls_transition_prob(i);
   }
 
+  inline void hmm_trainer_model::acum_tran_prob(hmm_trainer_accumulator *acum,
+                                                int clstr, log_float prob) {
+    if (acum) acum->acum_tran_prob(clstr, prob);
+    else trainer->acum_tran_prob(clstr, prob);
+  }
+
+  template<typename T>
+  inline void hmm_trainer_model::acum_apriori_cls_emission(hmm_trainer_accumulator *acum,
+                                                           int i, T prob) {
+    if (acum) acum->acum_apriori_cls_emission(i, prob);
+    else trainer->acum_cls_emission[i] += prob;
+  }
+
   inline int hmm_trainer_model::transition_emission(int tr) {
     int i = transition[tr].cls_transition;
     return trainer->get_cls_transition_emission(i);
@@ -485,6 +642,79 @@ namespace HMMs {
     list_output *next;
   };
 
+  void hmm_trainer_model::process_best_path(const int *rev_path,
+                                            int path_length,
+                                            int length_sequence,
+                                            bool do_expectation,
+                                            MatrixFloat *reest_emission,
+                                            MatrixFloat *seq_reest_emission,
+                                            char **output_str,
+                                            float count_value,
+                                            hmm_trainer_accumulator *acum) {
+    log_float logf_count_value  = log_float::from_float(count_value);
+    log_double logd_count_value = log_double::from_double((double)count_value);
+
+    // para recuperar la cadena de salida:
+    int outputsz = 0; // longitud de la salida
+    int theoutputlistsize = 0;
+    list_output *theoutputlist = 0;
+
+    if (reest_emission) {
+      AprilMath::MatrixExt::Initializers::matZeros(reest_emission);
+    }
+
+    int sq = length_sequence-1;
+    for (int i=0; i<path_length; ++i) {
+      int tr = rev_path[i];
+
+      if (do_expectation) {
+        // acumular valores para algoritmo EM
+        int clstr = transition[tr].cls_transition;
+        acum_tran_prob(acum, clstr, logf_count_value);
+      }
+
+      int emis  = transition_emission(tr);
+      if (emis >= 0) { 
+        // acumular para calcular prob. a priori de las emisiones
+        if (do_expectation) acum_apriori_cls_emission(acum, emis, logd_count_value);
+        // guardar la emision:
+        if (seq_reest_emission) (*seq_reest_emission)(sq)  = emis+1;
+        if (reest_emission)     (*reest_emission)(sq,emis) = 1.0f;
+        sq--;
+      }
+
+      // salida:
+      if (transition[tr].output != 0) {
+        list_output *aux = new list_output;
+        aux->output = transition[tr].output;
+        aux->next = theoutputlist;
+        theoutputlist = aux;
+        theoutputlistsize++;
+        outputsz += strlen(transition[tr].output);
+      }
+    }
+
+    // generar cadena de salida:
+    if (theoutputlistsize > 0)
+      outputsz += theoutputlistsize-1;
+    outputsz++; // para el '\0'
+
+    char *outputstr = new char[outputsz];
+    char *r = outputstr;
+    while (theoutputlist) {
+      list_output *aux = theoutputlist;
+      theoutputlist = theoutputlist->next;
+      strcpy(r,aux->output);
+      r += strlen(aux->output);
+      if (theoutputlist) {
+        *r = ' '; r++;
+      }
+      delete aux;
+    }
+    *r = '\0';
+    *output_str = outputstr;
+  }
+
   log_float hmm_trainer_model::viterbi(const MatrixFloat *emission,
                                        bool emission_in_log_base,
                                        bool do_expectation,
@@ -492,9 +722,8 @@ namespace HMMs {
                                        MatrixFloat *seq_reest_emission,
                                        MatrixFloat *state_probabilities,
                                        char **output_str,
-                                       float count_value) {
-    log_float logf_count_value  = log_float::from_float(count_value);
-    log_double logd_count_value = log_double::from_double((double)count_value);
+                                       float count_value,
+                                       hmm_trainer_accumulator *acum) {
     //
     int length_sequence  = emission->getDimSize(0);
     int sz_emission_frame= emission->getDimSize(1);
@@ -580,11 +809,6 @@ namespace HMMs {
       }
     } // end for tr recorre transiciones
 
-    // para recuperar la cadena de salida:
-    int outputsz = 0; // longitud de la salida
-    int theoutputlistsize = 0;
-    list_output *theoutputlist = 0;
-
     // devolver las probabilidades de cada estado al finalizar
     if (state_probabilities) {
       april_assert(state_probabilities->getNumDim() == 1 &&
@@ -594,83 +818,254 @@ namespace HMMs {
         *st_prob_it = probnxt[i];
     }
 
-    if (reest_emission) {
-      AprilMath::MatrixExt::Initializers::matZeros(reest_emission);
-    }
-  
     // recuperar prob final:
     //printf("recuperar prob final\n");
     log_float output_prob = probnxt[final_state];
-    // recuperar el camino desde final_state usando la matriz path
-    sq = length_sequence-1; fpath=path+length_sequence*num_states;
+    // recuperar el camino desde final_state usando la matriz path, las
+    // transiciones quedan en orden inverso
+    AprilUtils::vector<int> rev_path;
+    fpath=path+length_sequence*num_states;
     st = final_state;
     tr = fpath[st];
     while (tr >= 0) {
+      rev_path.push_back(tr);
+      // pasar al estado anterior:
+      if (transition_emission(tr) >= 0) fpath-=num_states;
+      st = transition[tr].from;
+      tr = fpath[st];
+    } // while (tr >= 0);
+    process_best_path(rev_path.begin(), static_cast<int>(rev_path.size()),
+                      length_sequence, do_expectation,
+                      reest_emission, seq_reest_emission,
+                      output_str, count_value, acum);
 
-      if (do_expectation) {
-        // acumular valores para algoritmo EM
-        int clstr = transition[tr].cls_transition;
-        trainer->acum_tran_prob(clstr,
-                                logf_count_value);
+    // liberar recursos
+    delete[] path;
+    delete[] probnow;
+    delete[] probnxt;
+    delete[] vemission;
+  
+    // devolver maxprob
+    return output_prob;
+
+  } // end viterbi method
+
+  // nodo de la lista de backpointers de viterbi_beam: transicion tomada y
+  // nodo anterior del camino (-1 al principio)
+  struct hmm_trace_node {
+    int tr;
+    int prev;
+  };
+
+  // Removes the nodes which are not reachable from the given active states,
+  // keeping the order of the remaining ones. The node referenced by prev is
+  // always older than the referencing one, so a single pass is enough.
+  static void compact_trace(AprilUtils::vector<hmm_trace_node> &nodes,
+                            AprilUtils::vector<int> &remap,
+                            int *trace,
+                            const AprilUtils::vector<int> &active) {
+    const int MARKED = -2;
+    remap.resize(nodes.size());
+    for (size_t i=0; i<remap.size(); ++i) remap[i] = -1;
+    for (size_t i=0; i<active.size(); ++i) {
+      for (int n = trace[active[i]]; n >= 0 && remap[n] == -1;
+           n = nodes[n].prev) {
+        remap[n] = MARKED;
+      }
+    }
+    int k = 0;
+    for (size_t i=0; i<nodes.size(); ++i) {
+      if (remap[i] == MARKED) {
+        int prev = nodes[i].prev;
+        nodes[k].tr   = nodes[i].tr;
+        nodes[k].prev = (prev >= 0) ? remap[prev] : -1;
+        remap[i] = k++;
       }
+    }
+    nodes.resize(k);
+    for (size_t i=0; i<active.size(); ++i) {
+      int &n = trace[active[i]];
+      if (n >= 0) n = remap[n];
+    }
+  }
 
-      int emis  = transition_emission(tr);
-      if (emis >= 0) { 
-        // acumular para calcular prob. a priori de las emisiones
-        if (do_expectation) trainer->acum_cls_emission[emis] += logd_count_value;
-        // guardar la emision:
-        if (seq_reest_emission) (*seq_reest_emission)(sq)  = emis+1;
-        if (reest_emission)     (*reest_emission)(sq,emis) = 1.0f;
+  log_float hmm_trainer_model::viterbi_beam(const MatrixFloat *emission,
+                                            bool emission_in_log_base,
+                                            bool do_expectation,
+                                            MatrixFloat *reest_emission,
+                                            MatrixFloat *seq_reest_emission,
+                                            MatrixFloat *state_probabilities,
+                                            char **output_str,
+                                            float count_value,
+                                            float beam,
+                                            int max_active,
+                                            hmm_trainer_accumulator *acum) {
+    // the trace list is compacted when it grows over this size
+    const size_t MIN_TRACE_LIMIT = 1024u;
+    //
+    int length_sequence  = emission->getDimSize(0);
+    int sz_emission_frame= emission->getDimSize(1);
+
+    log_float *probnow   = new log_float[num_states];
+    log_float *probnxt   = new log_float[num_states];
+    int       *tracenow  = new int[num_states];
+    int       *tracenxt  = new int[num_states];
+    bool      *innow     = new bool[num_states];
+    bool      *innxt     = new bool[num_states];
+    log_float *vemission = new log_float[sz_emission_frame];
+    const log_float *apriori = trainer->apriori_cls_emission;
+    for (int st=0; st<num_states; st++) {
+      probnxt[st] = probnow[st] = log_float::zero();
+      innxt[st]   = innow[st]   = false;
+    }
+    // states reached at next frame, and states expanded at current frame
+    AprilUtils::vector<int> active_nxt, active_now;
+    // ranks of the states pending to be expanded at current frame, lambda
+    // transitions always go to states with greater rank
+    AprilUtils::min_heap<int> pending(num_states);
+    AprilUtils::vector<hmm_trace_node> nodes;
+    AprilUtils::vector<int> remap;
+    AprilUtils::vector<log_float> scores;
+    size_t trace_limit = MIN_TRACE_LIMIT;
+
+    probnxt[initial_state]  = log_float::one();
+    tracenxt[initial_state] = -1;
+    innxt[initial_state]    = true;
+    active_nxt.push_back(initial_state);
+
+    // iterator for matrix traversal (each row is a emission frame)
+    MatrixFloat::const_iterator emiss_it(emission->begin());
+    // the last iteration only follows lambda transitions
+    for (int sq=0; sq<=length_sequence; sq++) {
+      const bool emitting = sq < length_sequence;
+      if (emitting) {
+        if (!emission_in_log_base) {
+          for (int i=0; i<sz_emission_frame; i++, ++emiss_it)
+            vemission[i] = log_float::from_float(*emiss_it) / apriori[i];
+        } else {
+          for (int i=0; i<sz_emission_frame; i++, ++emiss_it)
+            vemission[i] = log_float(*emiss_it) / apriori[i];
+        }
       }
 
-      // salida:
-      if (transition[tr].output != 0) {
-        list_output *aux = new list_output;
-        aux->output = transition[tr].output;
-        aux->next = theoutputlist;
-        theoutputlist = aux;
-        theoutputlistsize++;
-        outputsz += strlen(transition[tr].output);
+      AprilUtils::swap(probnow, probnxt);
+      AprilUtils::swap(tracenow, tracenxt);
+      AprilUtils::swap(innow, innxt);
+
+      log_float best = log_float::zero();
+      for (size_t i=0; i<active_nxt.size(); ++i) {
+        int st = active_nxt[i];
+        pending.push(state_rank[st]);
+        if (probnow[st] > best) best = probnow[st];
       }
-    
-      // pasar al estado anterior:
-      if (emis >= 0) {
-        sq--; fpath-=num_states;
+      active_nxt.clear();
+      log_float threshold = (beam > 0.0f) ?
+        log_float(best.log() - beam) : log_float::zero();
+
+      while (!pending.empty()) {
+        int rank = pending.top();
+        pending.pop();
+        int orig = ranked_state[rank];
+        active_now.push_back(orig);
+        log_float score = probnow[orig];
+        if (score < threshold) continue; // beam pruning
+        for (int tr=first_transition[rank]; tr<first_transition[rank+1]; tr++) {
+          int dest = transition[tr].to;
+          int emis = transition_emission(tr);
+          log_float nscr = score * transition_prob(tr);
+          if (emis >= 0) { // transicion no lambda
+            if (!emitting) continue;
+            nscr *= vemission[emis];
+            if (nscr > probnxt[dest]) {
+              probnxt[dest] = nscr;
+              hmm_trace_node node = { tr, tracenow[orig] };
+              tracenxt[dest] = static_cast<int>(nodes.size());
+              nodes.push_back(node);
+              if (!innxt[dest]) {
+                innxt[dest] = true;
+                active_nxt.push_back(dest);
+              }
+            }
+          }
+          else { // transicion lambda
+            if (nscr > probnow[dest]) {
+              probnow[dest] = nscr;
+              hmm_trace_node node = { tr, tracenow[orig] };
+              tracenow[dest] = static_cast<int>(nodes.size());
+              nodes.push_back(node);
+              if (!innow[dest]) {
+                innow[dest] = true;
+                pending.push(state_rank[dest]);
+              }
+            }
+          }
+        } // for tr
+      } // while pending
+
+      if (!emitting) break; // probnow keeps the final scores
+
+      // histogram pruning
+      if (max_active > 0 && static_cast<int>(active_nxt.size()) > max_active) {
+        int n = static_cast<int>(active_nxt.size());
+        scores.resize(n);
+        for (int i=0; i<n; ++i) scores[i] = probnxt[active_nxt[i]];
+        log_float kth = AprilUtils::Selection(scores.begin(), n, n - max_active);
+        int k = 0;
+        for (int i=0; i<n; ++i) {
+          int st = active_nxt[i];
+          if (probnxt[st] >= kth) active_nxt[k++] = st;
+          else {
+            probnxt[st] = log_float::zero();
+            innxt[st]   = false;
+          }
+        }
+        active_nxt.resize(k);
       }
-      st = transition[tr].from;
-      tr = fpath[st];
-    } // while (tr >= 0);
 
-    // generar cadena de salida:
-    if (theoutputlistsize > 0)
-      outputsz += theoutputlistsize-1;
-    outputsz++; // para el '\0'
+      // clear current frame states
+      for (size_t i=0; i<active_now.size(); ++i) {
+        int st = active_now[i];
+        probnow[st] = log_float::zero();
+        innow[st]   = false;
+      }
+      active_now.clear();
 
-    char *outputstr = new char[outputsz];
-    char *r = outputstr;
-    while (theoutputlist) {
-      list_output *aux = theoutputlist;
-      theoutputlist = theoutputlist->next;
-      strcpy(r,aux->output);
-      r += strlen(aux->output);
-      if (theoutputlist) {
-        *r = ' '; r++;
+      if (nodes.size() > trace_limit) {
+        compact_trace(nodes, remap, tracenxt, active_nxt);
+        trace_limit = AprilUtils::max(MIN_TRACE_LIMIT, 2u*nodes.size());
       }
-      delete aux;
+    } // for sq
+
+    if (state_probabilities) {
+      april_assert(state_probabilities->getNumDim() == 1 &&
+                   state_probabilities->getDimSize(0) == num_states);
+      MatrixFloat::iterator st_prob_it(state_probabilities->begin());
+      for (int i=0;i<num_states;i++, ++st_prob_it)
+        *st_prob_it = probnow[i];
     }
-    *r = '\0';
-    *output_str = outputstr;
 
-    // liberar recursos
-    delete[] path;
+    log_float output_prob = probnow[final_state];
+    AprilUtils::vector<int> rev_path;
+    if (innow[final_state]) {
+      for (int n = tracenow[final_state]; n >= 0; n = nodes[n].prev) {
+        rev_path.push_back(nodes[n].tr);
+      }
+    }
+    process_best_path(rev_path.begin(), static_cast<int>(rev_path.size()),
+                      length_sequence, do_expectation,
+                      reest_emission, seq_reest_emission,
+                      output_str, count_value, acum);
+
     delete[] probnow;
     delete[] probnxt;
+    delete[] tracenow;
+    delete[] tracenxt;
+    delete[] innow;
+    delete[] innxt;
     delete[] vemission;
-  
-    // devolver maxprob
-    return output_prob;
 
-  } // end viterbi method
+    return output_prob;
+  } // end viterbi_beam method
 
   void hmm_trainer_model::forward(MatrixFloat *emission,
                                   log_float *alpha) {
@@ -747,7 +1142,8 @@ namespace HMMs {
   void hmm_trainer_model::backward(MatrixFloat *input_emission, 
                                    MatrixFloat *output_emission, 
                                    log_float *alpha,
-                                   bool do_expectation) {
+                                   bool do_expectation,
+                                   hmm_trainer_accumulator *acum) {
 
     // alpha es una matriz de tamanyo: length_sequence+1 filas por
     // num_states columnas creada en el metodo forward_backward donde se
@@ -844,10 +1240,10 @@ namespace HMMs {
             pstar = f_alpha[orig] * transition_prob(tr) * 
               probnow[dest] * vemission[emis];
             desired[emis] += pstar; // salida deseada para entrenar posterioris
-            trainer->acum_tran_prob(clstr, pstar); // prob. transicion
+            acum_tran_prob(acum, clstr, pstar); // prob. transicion
           } else { // transicion lambda utiliza alpha de la fila siguiente:
             pstar = f_alpha[num_states+orig] * transition_prob(tr) * probnow[dest];
-            trainer->acum_tran_prob(clstr, pstar); // prob. transicion
+            acum_tran_prob(acum, clstr, pstar); // prob. transicion
           }
         } // for q recorre transiciones
       else // solamente el calculo de la salida deseada
@@ -864,12 +1260,12 @@ namespace HMMs {
         } // for q recorre transiciones
 
       // ya podemos reescribir la fila con la salida deseada:
-      log_float acum= desired[0];
+      log_float sum = desired[0];
       for (int i=1; i<sz_emission_frame; i++)
-        acum += desired[i];
+        sum += desired[i];
       for (int i=0; i<sz_emission_frame; i++) {
-        log_float aux = desired[i] / acum;
-        trainer->acum_apriori_cls_emission(i,aux);
+        log_float aux = desired[i] / sum;
+        acum_apriori_cls_emission(acum, i, aux);
         desired_emission[i] = aux.to_float();
       }
 
@@ -907,7 +1303,7 @@ namespace HMMs {
         log_float pstar;
         if (emis < 0) { // transicion lambda
           pstar = f_alpha[orig] * transition_prob(tr) * probprv[dest];
-          trainer->acum_tran_prob(clstr, pstar); // prob. transicion
+          acum_tran_prob(acum, clstr, pstar); // prob. transicion
         }
       } // for q recorre transiciones
     }
@@ -921,7 +1317,8 @@ namespace HMMs {
 
   void hmm_trainer_model::forward_backward(MatrixFloat *input_emission, 
                                            MatrixFloat *output_emission, 
-                                           bool do_expectation) {
+                                           bool do_expectation,
+                                           hmm_trainer_accumulator *acum) {
   
     int length_sequence  = input_emission->getDimSize(0);
     // todo: comprobar que output_emission tiene las mismas dim.
@@ -931,7 +1328,7 @@ namespace HMMs {
       alpha[i] = log_float::zero();
   
     forward(input_emission,alpha);
-    backward(input_emission,output_emission,alpha,do_expectation);
+    backward(input_emission,output_emission,alpha,do_expectation,acum);
   
     delete[] alpha;
   }
@@ -60,6 +60,29 @@ namespace HMMs {
 
   class hmm_trainer_model; // forward declaration
 
+  /// EM counters private to one sequence, they are merged into the trainer by
+  /// hmm_trainer::merge_expectation(). Used by the batch methods of
+  /// hmm_trainer to run several models at the same time.
+  class hmm_trainer_accumulator {
+    int num_cls_transitions, num_cls_emissions;
+    AprilUtils::log_double *acum_tran;
+    AprilUtils::log_double *acum_emission;
+    friend class hmm_trainer;
+  public:
+    hmm_trainer_accumulator(int num_cls_transitions, int num_cls_emissions);
+    ~hmm_trainer_accumulator();
+    void clear();
+    void acum_tran_prob(int clstr, AprilUtils::log_float prob) {
+      acum_tran[clstr] += prob;
+    }
+    void acum_apriori_cls_emission(int i, AprilUtils::log_float prob) {
+      acum_emission[i] += prob;
+    }
+    void acum_apriori_cls_emission(int i, AprilUtils::log_double prob) {
+      acum_emission[i] += prob;
+    }
+  };
+
   class hmm_trainer : public Referenced {
     friend class hmm_trainer_model;
     int num_cls_states,      vsz_cls_states;
@@ -115,6 +138,40 @@ namespace HMMs {
     void begin_expectation();
     void end_expectation(bool update_trans_prob=true, 
                          bool update_a_priori_emission=true);
+    // suma los contadores de un acumulador a los del trainer
+    void merge_expectation(const hmm_trainer_accumulator &acum);
+
+    /**
+     * @brief Viterbi of n (model, emission) pairs in parallel.
+     *
+     * Pairs are distributed over OMP threads, the EM counts of every pair
+     * are accumulated into its own hmm_trainer_accumulator, and they are
+     * merged into the trainer in pair order, so the counts don't depend on
+     * the number of threads. Arguments are the same as in
+     * hmm_trainer_model::viterbi_beam() (no pruning when beam and max_active
+     * are <= 0), given as vectors of size n. Any of the matrix vectors and
+     * output_strs can be NULL; NULL entries are also allowed.
+     *
+     * @note Models must belong to this trainer.
+     */
+    void batch_viterbi(int n, hmm_trainer_model **models,
+                       Basics::MatrixFloat **emissions,
+                       bool emission_in_log_base,
+                       bool do_expectation,
+                       Basics::MatrixFloat **reest_emissions,
+                       Basics::MatrixFloat **seq_reest_emissions,
+                       char **output_strs,
+                       float *log_probs,
+                       float count_value,
+                       float beam=0.0f,
+                       int max_active=0);
+
+    /// Forward-backward of n (model, emission) pairs in parallel, @see
+    /// batch_viterbi()
+    void batch_forward_backward(int n, hmm_trainer_model **models,
+                                Basics::MatrixFloat **input_emissions,
+                                Basics::MatrixFloat **output_emissions,
+                                bool do_expectation=true);
 
     // para leer vector apriori_cls_emission;
     // TODO
@@ -143,23 +200,50 @@ namespace HMMs {
     hmm_trainer_transition *transition;
     // vector de talla num_states, de momento no se usa:
     // int *ranking;
-    // vector de talla num_states+1, de momento no se usa:
-    // int *first_transition;
+    // Transitions are grouped by source state in topological order (CSR
+    // layout). The state with rank r is ranked_state[r], and its transitions
+    // are in range [first_transition[r], first_transition[r+1]). Vectors of
+    // size num_states+1 (first_transition) and num_states, created by
+    // prepare_model:
+    int *first_transition;
+    int *ranked_state;
+    int *state_rank;
 
     // auxiliares para algoritmos:
     int transition_emission(int tr);
     AprilUtils::log_float transition_prob(int tr);
 
+    // acumulan en acum, o en el trainer si acum es NULL
+    void acum_tran_prob(hmm_trainer_accumulator *acum, int clstr,
+                        AprilUtils::log_float prob);
+    template<typename T>
+    void acum_apriori_cls_emission(hmm_trainer_accumulator *acum, int i,
+                                   T prob);
+
+    // accumulates EM counts, fills emission matrices and builds the output
+    // string from the transitions of the best path, given in reverse order
+    void process_best_path(const int *rev_path, int path_length,
+                           int length_sequence,
+                           bool do_expectation,
+                           Basics::MatrixFloat *reest_emission,
+                           Basics::MatrixFloat *seq_reest_emission,
+                           char **output_str,
+                           float count_value,
+                           hmm_trainer_accumulator *acum);
+
     void forward (Basics::MatrixFloat *emission, AprilUtils::log_float *alpha);
     void backward(Basics::MatrixFloat *input_emission, 
                   Basics::MatrixFloat *output_emission, 
                   AprilUtils::log_float *alpha,
-                  bool do_expectation);
+                  bool do_expectation,
+                  hmm_trainer_accumulator *acum);
 
   public:
     hmm_trainer_model(hmm_trainer *trainer);
     ~hmm_trainer_model();
 
+    hmm_trainer *get_trainer() const { return trainer; }
+
     // para introducir los modelos:
     int new_state();
     void set_initial_state(int st) { initial_state = st; }
@@ -181,11 +265,40 @@ namespace HMMs {
                                    Basics::MatrixFloat *seq_reest_emission,
                                    Basics::MatrixFloat *state_probabilities,
                                    char **output_str,
-                                   float count_value);
+                                   float count_value,
+                                   hmm_trainer_accumulator *acum=0);
+
+    /**
+     * @brief Viterbi with beam and histogram pruning.
+     *
+     * Only active states are expanded, following transitions by source state.
+     * At every frame, states with a score worse than the best one by more
+     * than @c beam (in log scale) are pruned, and at most @c max_active
+     * states survive to the next frame. A value <= 0 disables each pruning.
+     *
+     * Backpointers are stored in a list of trace nodes which is compacted
+     * when it grows, so memory depends on the number of active paths instead
+     * of length_sequence*num_states.
+     *
+     * @note The result is the same as viterbi() when the best path is not
+     * pruned.
+     */
+    AprilUtils::log_float viterbi_beam(const Basics::MatrixFloat *emission,
+                                       bool emission_in_log_base,
+                                       bool do_expectation,
+                                       Basics::MatrixFloat *reest_emission,
+                                       Basics::MatrixFloat *seq_reest_emission,
+                                       Basics::MatrixFloat *state_probabilities,
+                                       char **output_str,
+                                       float count_value,
+                                       float beam,
+                                       int max_active,
+                                       hmm_trainer_accumulator *acum=0);
 
     void forward_backward(Basics::MatrixFloat *input_emission, 
                           Basics::MatrixFloat *output_emission, 
-                          bool do_expectation=true);
+                          bool do_expectation=true,
+                          hmm_trainer_accumulator *acum=0);
 
     void get_information(int &n_states, int &n_transitions) const {
       n_states = num_states; n_transitions = num_transitions;
@@ -40,6 +40,15 @@
        debug="yes",
      }
    },
+   target{
+     name = "test",
+     lua_unit_test{
+       file={
+         "test/test_batch.lua",
+         "test/test_viterbi_beam.lua",
+       },
+     },
+   },
    target{
      name = "document",
      document_src{
@@ -0,0 +1,162 @@
+local check = utest.check
+local T = utest.test
+
+local IDS = { "t12", "t22", "t23", "t24", "t42", "t44" }
+
+-- model of test_hmm.lua, named transitions are shared by all the C models
+local function new_trainer(num_models)
+  local t = HMMTrainer.trainer()
+  local desc = t:model{
+    name="loop model",
+    transitions={
+      {from="1", to="2", prob=1,   emission=1, output="de1a2", id="t12"},
+      {from="2", to="2", prob=0.3, emission=2, output="de2a2", id="t22"},
+      {from="2", to="3", prob=0.3, emission=2, output="de2a3", id="t23"},
+      {from="2", to="4", prob=0.4, emission=3, output="de2a4", id="t24"},
+      {from="4", to="2", prob=0.5, emission=0, output="de4a2", id="t42"},
+      {from="4", to="4", prob=0.5, emission=4, output="de4a4", id="t44"}
+    },
+    initial="1",
+    final="3"
+  }
+  local models = iterator.range(num_models):
+  map(function() return desc:generate_C_model() end):table()
+  return t,models
+end
+
+local function gen_emissions(n)
+  local rnd = random(2468)
+  return iterator.range(n):
+  map(function(i) return matrix(2 + i%7, 4):uniformf(0.05, 1.0, rnd) end):table()
+end
+
+local function clone_all(list)
+  return iterator(list):map(function(m) return m:clone() end):table()
+end
+
+-- EM counts are compared after end_expectation(), through the re-estimated
+-- transition probabilities and emission a prioris, a nil epsilon compares
+-- for exact equality
+local function check_prob(a, b, epsilon, ...)
+  if epsilon then check.lt(math.abs(a - b), epsilon, ...)
+  else check.eq(a, b, ...)
+  end
+end
+
+local function check_trainers(t1, t2, epsilon)
+  for _,id in ipairs(IDS) do
+    check_prob(t1:get_cls_transition_prob(id),
+               t2:get_cls_transition_prob(id), epsilon, id)
+  end
+  local ap1 = t1.trainer:get_a_priori_emissions()
+  local ap2 = t2.trainer:get_a_priori_emissions()
+  check.eq(#ap1, #ap2)
+  for i=1,#ap1 do check_prob(ap1[i], ap2[i], epsilon) end
+end
+
+local function with_threads(n, f)
+  local old = util.omp_get_num_threads()
+  util.omp_set_num_threads(n)
+  local ok,err = pcall(f)
+  util.omp_set_num_threads(old)
+  if not ok then error(err) end
+end
+
+local N = 23
+
+T("BatchViterbiTest", function()
+    local emissions = gen_emissions(N)
+    -- sequential accumulation
+    local t1,models1 = new_trainer(N)
+    t1.trainer:begin_expectation()
+    local logps,strs = {},{}
+    for i=1,N do
+      logps[i],strs[i] = models1[i]:viterbi{ input_emission=emissions[i],
+                                             do_expectation=true }
+    end
+    t1.trainer:end_expectation()
+    -- batch accumulation with different number of threads
+    local batch = function(nth, params)
+      local t,models = new_trainer(N)
+      local blogps,bstrs
+      with_threads(nth, function()
+          t.trainer:begin_expectation()
+          params.models = models
+          params.input_emissions = emissions
+          params.do_expectation = true
+          blogps,bstrs = t.trainer:batch_viterbi(params)
+          t.trainer:end_expectation()
+      end)
+      return t,blogps,bstrs
+    end
+    local t2,logps2,strs2 = batch(1, {})
+    local t4,logps4,strs4 = batch(4, {})
+    check.eq(#logps2, N)
+    for i=1,N do
+      check.number_eq(logps2[i], logps[i], 1e-05)
+      check.eq(strs2[i], strs[i])
+      check.eq(logps4[i], logps2[i])
+      check.eq(strs4[i], strs2[i])
+    end
+    check_trainers(t1, t2, 1e-05)
+    -- sums don't depend on the number of threads
+    check_trainers(t2, t4)
+    -- beam search without pruning
+    local tb,logpsb,strsb = batch(4, { beam=1e4 })
+    for i=1,N do
+      check.number_eq(logpsb[i], logps[i], 1e-05)
+      check.eq(strsb[i], strs[i])
+    end
+    check_trainers(t1, tb, 1e-05)
+end)
+
+T("BatchForwardBackwardTest", function()
+    local emissions = gen_emissions(N)
+    -- sequential accumulation, output emissions overwrite the input
+    local t1,models1 = new_trainer(N)
+    local outputs1 = clone_all(emissions)
+    t1.trainer:begin_expectation()
+    for i=1,N do models1[i]:forward_backward{ input_emission=outputs1[i] } end
+    t1.trainer:end_expectation()
+    -- batch accumulation with different number of threads
+    local batch = function(nth)
+      local t,models = new_trainer(N)
+      local outputs = iterator(emissions):
+      map(function(m) return matrix(m:dim(1), m:dim(2)) end):table()
+      local inputs = clone_all(emissions)
+      with_threads(nth, function()
+          t.trainer:begin_expectation()
+          t.trainer:batch_forward_backward{ models=models,
+                                            input_emissions=inputs,
+                                            output_emissions=outputs }
+          t.trainer:end_expectation()
+      end)
+      return t,outputs
+    end
+    local t2,outputs2 = batch(1)
+    local t4,outputs4 = batch(4)
+    for i=1,N do
+      check.eq(outputs2[i], outputs1[i])
+      check.eq(outputs4[i], outputs2[i])
+    end
+    check_trainers(t1, t2, 1e-05)
+    check_trainers(t2, t4)
+end)
+
+T("BatchForeignModelTest", function()
+    local emissions = gen_emissions(2)
+    local t1,models1 = new_trainer(1)
+    local t2,models2 = new_trainer(1)
+    -- all the models must belong to the trainer which runs the batch
+    local models = { models1[1], models2[1] }
+    check.errored(function()
+        t1.trainer:batch_viterbi{ models=models, input_emissions=emissions }
+    end)
+    check.errored(function()
+        t1.trainer:batch_forward_backward{ models=models,
+                                           input_emissions=emissions }
+    end)
+    local logps = t2.trainer:batch_viterbi{ models={ models2[1] },
+                                            input_emissions={ emissions[1] } }
+    check.eq(#logps, 1)
+end)
@@ -0,0 +1,90 @@
+local check = utest.check
+local T = utest.test
+
+-- model of test_hmm.lua, with loops and a lambda transition
+local function loop_model(t)
+  return t:model{
+    name="loop model",
+    transitions={
+      {from="1", to="2", prob=1,   emission=1, output="de1a2"},
+      {from="2", to="2", prob=0.3, emission=2, output="de2a2"},
+      {from="2", to="3", prob=0.3, emission=2, output="de2a3"},
+      {from="2", to="4", prob=0.4, emission=3, output="de2a4"},
+      {from="4", to="2", prob=0.5, emission=0, output="de4a2"},
+      {from="4", to="4", prob=0.5, emission=4, output="de4a4"}
+    },
+    initial="1",
+    final="3"
+  }:generate_C_model()
+end
+
+-- two branches, the best one starts with the worst score
+local function branch_model(t)
+  return t:model{
+    name="branch model",
+    transitions={
+      {from="ini", to="a", prob=0.5, emission=1, output="a1"},
+      {from="ini", to="b", prob=0.5, emission=2, output="b1"},
+      {from="a", to="fin", prob=1, emission=3, output="a2"},
+      {from="b", to="fin", prob=1, emission=4, output="b2"},
+    },
+    initial="ini",
+    final="fin"
+  }:generate_C_model()
+end
+
+local function run_viterbi(model, emission, params)
+  local seq = matrix(emission:dim(1))
+  local params = params or {}
+  params.input_emission = emission
+  params.output_emission_seq = seq
+  params.output_emission = matrix(emission:dim(1), emission:dim(2))
+  local logp,str = model:viterbi(params)
+  return logp,str,seq,params.output_emission
+end
+
+T("ViterbiBeamWideTest", function()
+    local rnd = random(1234)
+    local t = HMMTrainer.trainer()
+    local model = loop_model(t)
+    for _,len in ipairs{ 2, 5, 12 } do
+      local emission = matrix(len, 4):uniformf(0.05, 1.0, rnd)
+      local logp,str,seq,emis = run_viterbi(model, emission)
+      for _,params in ipairs{ { beam=1e4 }, { max_active=100 },
+                              { beam=1e4, max_active=100 } } do
+        local blogp,bstr,bseq,bemis = run_viterbi(model, emission, params)
+        check.number_eq(blogp, logp, 1e-05)
+        check.eq(bstr, str)
+        check.eq(bseq, seq)
+        check.eq(bemis, emis)
+      end
+    end
+end)
+
+T("ViterbiBeamPruningTest", function()
+    local t = HMMTrainer.trainer()
+    local model = branch_model(t)
+    local emission = matrix.fromString[[
+2 4
+ascii
+0.9 0.5 0.1 0.1
+0.1 0.1 0.01 0.9
+]]
+    local logp,str,seq = run_viterbi(model, emission)
+    check.eq(str, "b1 b2")
+    check.eq(seq, matrix{ 2, 4 })
+    check.number_eq(logp, math.log(0.5*0.5*0.9), 1e-05)
+    -- the b branch is pruned at first frame, by histogram or beam pruning
+    for _,params in ipairs{ { max_active=1 }, { beam=0.1 } } do
+      local plogp,pstr,pseq = run_viterbi(model, emission, params)
+      check.eq(pstr, "a1 a2")
+      check.eq(pseq, matrix{ 1, 3 })
+      check.number_eq(plogp, math.log(0.5*0.9*0.01), 1e-05)
+      check.lt(plogp, logp)
+    end
+    -- enough active states keep the best path
+    local plogp,pstr,pseq = run_viterbi(model, emission, { max_active=2 })
+    check.number_eq(plogp, logp, 1e-05)
+    check.eq(pstr, str)
+    check.eq(pseq, seq)
+end)
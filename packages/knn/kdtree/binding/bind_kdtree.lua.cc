@@ -20,6 +20,7 @@
  */
 //BIND_HEADER_C
 #include "bind_matrix.h"
+#include "bind_matrix_int32.h"
 #include "bind_mtrand.h"
 #include "matrixFloat.h"
 //BIND_END
@@ -115,6 +116,30 @@ using namespace KNN;
 }
 //BIND_END
 
+//BIND_METHOD KDTreeFloat searchKNNBatch
+{
+  Basics::MatrixFloat *queries;
+  int K;
+  LUABIND_CHECK_ARGN(==,2);
+  LUABIND_GET_PARAMETER(1,int,K);
+  LUABIND_GET_PARAMETER(2,MatrixFloat,queries);
+  if (queries->getNumDim() != 2) {
+    LUABIND_ERROR("Needs a bi-dimensional matrix of queries");
+  }
+  int dims[2] = { queries->getDimSize(0), K };
+  Basics::MatrixInt32 *indices = new Basics::MatrixInt32(2, dims);
+  Basics::MatrixFloat *distances = new Basics::MatrixFloat(2, dims);
+  obj->searchKNN(K, queries, indices, distances);
+  // indices start at 1 in Lua
+  for (Basics::MatrixInt32::iterator it = indices->begin();
+       it != indices->end(); ++it) {
+    ++(*it);
+  }
+  LUABIND_RETURN(MatrixInt32, indices);
+  LUABIND_RETURN(MatrixFloat, distances);
+}
+//BIND_END
+
 //BIND_METHOD KDTreeFloat get_point_matrix
 {
   int index, row;
@@ -22,28 +22,57 @@
 #define KDTREE_H
 
 #include <cfloat>
+#include <climits>
 #include "disallow_class_methods.h"
+#include "error_print.h"
 #include "matrix.h"
+#include "matrixInt32.h"
 #include "maxmin.h"
 #include "MersenneTwister.h"
-#include "min_heap.h"
-#include "pair.h"
 #include "point.h"
 #include "qsort.h"
 #include "referenced.h"
+#include "simd_kernels.h"
 
 /// K-Nearest-Neighbors.
 namespace KNN {
 
+  /// Squared distances between q and the n points of a bucket, stored by
+  /// columns.
+  template<typename T>
+  inline void bucketSqDistances(int n, int D, const T *x, const T *q, T *y) {
+    for (int j=0; j<n; ++j) {
+      T acc = T();
+      for (int d=0; d<D; ++d) {
+        const T diff = x[d*n + j] - q[d];
+        acc += diff * diff;
+      }
+      y[j] = acc;
+    }
+  }
+
+  inline void bucketSqDistances(int n, int D, const float *x, const float *q,
+                                float *y) {
+    AprilMath::SIMD::vecSqDistances(static_cast<unsigned int>(n),
+                                    static_cast<unsigned int>(D),
+                                    x, static_cast<unsigned int>(n), q, y);
+  }
+
   /// KDTree class for KNN search. It is not a complete KDTree, it isn't allow
   /// to insert or remove points. All data is pushed as bi-dimensional matrices,
   /// and after that the KDTree is build.
+  ///
+  /// The tree is stored flat: it is a complete binary tree whose nodes are
+  /// kept in arrays in heap order (children of node i are 2i+1 and 2i+2), the
+  /// splits are the exact medians of the axis with largest spread, so all the
+  /// leaves have the same number of points (up to one) and at most
+  /// BUCKET_SIZE. Points are copied into contiguous leaf buckets, stored by
+  /// columns to compute the distances of a whole bucket with SIMD kernels.
   template<typename T>
   class KDTree : public Referenced {
     APRIL_DISALLOW_COPY_AND_ASSIGN(KDTree);
     
     typedef AprilUtils::vector< Point<T> > PointsList;
-    static const size_t MEDIAN_APPROX_SIZE=40;
     
     // For median computation
     struct MedianCompare {
@@ -53,148 +82,12 @@ namespace KNN {
 	return a[axis] < b[axis];
       }
     };
-    
-    // Node of the KDTree
-    class KDNode {
-      APRIL_DISALLOW_ASSIGN(KDNode);
-      
-      Point<T>    point;
-      KDNode     *left;
-      KDNode     *right;
-      
-      const T split_value; ///< Used to split the hyperspace in two.
-      
-    public:
-      KDNode(Point<T> &point, KDNode *left, KDNode *right, T split_value) :
-	point(point), left(left), right(right), split_value(split_value) {
-      }
-      ~KDNode() {
-	delete left;
-	delete right;
-      }
-      const Point<T> &getPoint() const { return point; }
-      const KDNode *getLeft() const { return left; }
-      const KDNode *getRight() const { return right; }
-      T getSplitValue() const { return split_value; }
-    };
-    
-    /// Class base for KNN search. It implements the interface for searching
-    /// decisions, stores the k-best (or 1-best), and indicates when to stop.
-    class Searcher {
-      APRIL_DISALLOW_COPY_AND_ASSIGN(Searcher);
-      
-    public:
-      Searcher() { }
-      virtual ~Searcher() { }
-      virtual void process(const Point<T> &node_point) = 0;
-      virtual int side(const T split_value, const int axis) const = 0;
-      virtual bool leftIntersection(const T split_value, const int axis) const = 0;
-      virtual bool rightIntersection(const T split_value, const int axis) const = 0;
-    };
-    
-    /// Specialization of Searcher for the NN search
-    class OneBestSearcher : public Searcher {
-      APRIL_DISALLOW_COPY_AND_ASSIGN(OneBestSearcher);
-      
-      Point<T> &X;
-      int best_id;
-      double best_distance;
-      const int D;
-    public:
-      OneBestSearcher(Point<T> &X, const int D) :
-        Searcher(),
-	X(X), best_id(-1), best_distance(DBL_MAX), D(D) {
-      }
-      virtual ~OneBestSearcher() { }
-      virtual void process(const Point<T> &node_point) {
-	const double current_distance = X.dist(node_point, D);
-	if (current_distance < best_distance) {
-	  best_distance = current_distance;
-	  best_id       = node_point.getId();
-	}
-      }
-      virtual int side(const T split_value, const int axis) const {
-	if (X[axis] < split_value) return 0;
-	else return 1;
-      }
-      virtual bool leftIntersection(const T split_value, const int axis) const {
-	const double diff = X[axis] - split_value;
-	const double intersection_distance = diff*diff;
-	return !(intersection_distance > best_distance) || X[axis]<split_value;
-      }
-      virtual bool rightIntersection(const T split_value, const int axis) const {
-	const double diff = X[axis] - split_value;
-	const double intersection_distance = diff*diff;
-	return !(intersection_distance > best_distance) || !(X[axis]<split_value);
-      }
-      int getOneBestIndex() const { return best_id; }
-      double getOneBestDistance() const { return best_distance; }
-    };
-    
-    /// Less functor for min_heap for KBestSearcher
-    struct KbestPairLess {
-      bool operator()(const AprilUtils::pair<int,double> &a,
-		      const AprilUtils::pair<int,double> &b) {
-	// we use > instead of < to convert the min_heap into a max_heap
-	return a.second > b.second;
-      }
-    };
-    
-    /// Specialization of Searcher for the K-NN search. It uses a max_heap where
-    /// the points are ordered by distance (desceding order), allowing to use
-    /// the furthest point to define the hypersphere.
-    class KBestSearcher : public Searcher {
-      APRIL_DISALLOW_COPY_AND_ASSIGN(KBestSearcher);
-      
-      typedef AprilUtils::pair<int,double> HeapNode;
-      typedef AprilUtils::min_heap<HeapNode,KbestPairLess> MaxHeapType;
-      Point<T> &X;
-      double kbest_distance;
-      const int D, K;
-      MaxHeapType max_heap;
-    public:
-      KBestSearcher(const int K, Point<T> &X, const int D) :
-        Searcher(),
-	X(X), kbest_distance(DBL_MAX), D(D), K(K), max_heap(K,KbestPairLess()) {
-      }
-      virtual ~KBestSearcher() { }
-      virtual void process(const Point<T> &node_point) {
-	const double current_distance = X.dist(node_point, D);
-	if (current_distance < kbest_distance || max_heap.size() < K) {
-	  HeapNode e(node_point.getId(), current_distance);
-	  if (max_heap.size() == K) max_heap.pop();
-	  max_heap.push(e);
-	  const HeapNode &top = max_heap.top();
-	  kbest_distance = top.second;
-	}
-      }
-      virtual int side(const T split_value, const int axis) const {
-	if (X[axis] < split_value) return 0;
-	else return 1;
-      }
-      virtual bool leftIntersection(const T split_value, const int axis) const {
-	const double diff = X[axis] - split_value;
-	const double intersection_distance = diff*diff;
-	return !(intersection_distance > kbest_distance) || X[axis]<split_value;
-      }
-      virtual bool rightIntersection(const T split_value, const int axis) const {
-	const double diff = X[axis] - split_value;
-	const double intersection_distance = diff*diff;
-	return !(intersection_distance > kbest_distance) || !(X[axis]<split_value);
-      }
-      void getBestData(AprilUtils::vector<int> &indices,
-		       AprilUtils::vector<double> &distances) {
-	indices.resize(max_heap.size());
-	distances.resize(max_heap.size());
-	for (int i=max_heap.size()-1; i>=0; --i) {
-	  april_assert(!max_heap.empty());
-	  const HeapNode &top = max_heap.top();
-	  indices[i]   = top.first;
-	  distances[i] = top.second;
-	  max_heap.pop();
-	}
-      }
-    };
+
+  public:
+    /// Maximum number of points in a leaf.
+    static const int BUCKET_SIZE = 32;
+
+  private:
     
     // properties
     
@@ -204,112 +97,147 @@ namespace KNN {
     AprilUtils::vector< Basics::Matrix<T>* > matrix_vector;
     /// A vector with indices of first point index in matrix_vector
     AprilUtils::vector<int> first_index;
-    /// The root node of the KDTree
-    KDNode *root;
-    Basics::MTRand *random; ///< A random number generator
+    /// Kept for compatibility, the flat tree is built without sampling.
+    Basics::MTRand *random;
+    
+    /// Depth of the leaves, -1 when the tree is not built.
+    int depth;
+    /// Split axis of every internal node, in heap order.
+    AprilUtils::vector<int> split_axis;
+    /// Split value of every internal node, in heap order.
+    AprilUtils::vector<T> split_value;
+    /// First position of every leaf bucket, plus a sentinel equal to N.
+    AprilUtils::vector<int> leaf_first;
+    /// Point components, the bucket which starts at position p uses the
+    /// D*size values starting at p*D, stored by columns.
+    AprilUtils::vector<T> bucket_data;
+    /// Point index of every position.
+    AprilUtils::vector<int> bucket_ids;
     
     // for stats
     int number_of_processed_points;
     
     // private methods
     
-    /// Builds a point given its index
-    Point<T> makePoint(int index) {
-      int row;
-      Basics::Matrix<T> *m = getMatrixAndRow(index,row);
-      return Point<T>(m, row, index);
+    int numInternalNodes() const { return (1 << depth) - 1; }
+
+    int computeSplitAxis(const PointsList &points, int begin, int end) const {
+      int best_axis = 0;
+      T best_spread = T();
+      for (int d=0; d<D; ++d) {
+        T lo = points[begin][d], hi = lo;
+        for (int i=begin+1; i<end; ++i) {
+          const T v = points[i][d];
+          if (v < lo) lo = v;
+          else if (hi < v) hi = v;
+        }
+        if (best_spread < hi - lo) {
+          best_spread = hi - lo;
+          best_axis   = d;
+        }
+      }
+      return best_axis;
     }
     
-    /// Returns the position of the median given a list of point indices and the
-    /// axis where to compare
-    Point<T> computeMedian(const PointsList *points, const int axis) const {
-      const size_t size = AprilUtils::min(MEDIAN_APPROX_SIZE, points->size());
-      PointsList aux( static_cast<typename PointsList::size_type>(size) );
-      for (size_t i=0; i<size; ++i) aux[i] = (*points)[random->randInt(size-1)];
-      MedianCompare predicate(axis);
-      return AprilUtils::Selection(aux.begin(), size, size/2, predicate);
+    /// Builds recursively the node at the given heap position with the
+    /// points in range [begin,end), reordering them.
+    void build(PointsList &points, int node, int level, int begin, int end) {
+      if (level == depth) {
+        leaf_first[node - numInternalNodes()] = begin;
+        return;
+      }
+      const int mid = begin + (end - begin)/2;
+      int axis = 0;
+      T value  = T();
+      if (end - begin > 1) {
+        axis = computeSplitAxis(points, begin, end);
+        // partial sort, lower values at the left of mid
+        value = AprilUtils::Selection(points.begin() + begin, end - begin,
+                                      mid - begin, MedianCompare(axis))[axis];
+      }
+      else if (end > begin) value = points[begin][axis];
+      split_axis[node]  = axis;
+      split_value[node] = value;
+      build(points, 2*node + 1, level + 1, begin, mid);
+      build(points, 2*node + 2, level + 1, mid, end);
     }
-    
-    /// Splits into two PointsList using the given pivot (excluding it)
-    void split(const PointsList *points_list, const Point<T> which, const int axis,
-	       PointsList *left, PointsList *right) {
-      T value = which[axis];
-      for (const Point<T> *it = points_list->begin();
-	   it != points_list->end(); ++it) {
-	if ( (*it) != which) {
-	  if ( (*it)[axis] < value ) left->push_back( *it );
-	  else right->push_back(*it);
-	}
+
+    /// Inserts a point in a sorted list of at most K nearest points.
+    static void insertKBest(int K, int &count, int *ids, T *dists,
+                            int id, T dist) {
+      if (count == K && !(dist < dists[K-1])) return;
+      int i = (count < K) ? count++ : K-1;
+      while (i > 0 && dist < dists[i-1]) {
+        ids[i]   = ids[i-1];
+        dists[i] = dists[i-1];
+        --i;
       }
+      ids[i]   = id;
+      dists[i] = dist;
     }
     
-    /// Builds recursively the KDTree, returning the node which contains all the
-    /// underlying points
-    KDNode *build(const PointsList *points_list, const int depth) {
-      if (points_list == 0 || points_list->size() == 0) return 0;
-      int axis      = depth%D;
-      Point<T> median = computeMedian(points_list, axis);
-      PointsList *left_split, *right_split;
-      left_split  = new PointsList();
-      right_split = new PointsList();
-      left_split->reserve(points_list->size()/2);
-      right_split->reserve(points_list->size()/2);
-      split(points_list, median, axis, left_split, right_split);
-      //
-      KDNode *node =  new KDNode( median,
-				  build(left_split,  depth+1),
-				  build(right_split, depth+1),
-				  median[axis]);
-      //
-      delete left_split;
-      delete right_split;
-      return node;
+    /// Searches the K nearest points to q, which must be contiguous, in the
+    /// subtree of the given node. Returns the number of processed points.
+    int search(int node, int level, const T *q, int K, int &count,
+               int *ids, T *dists, T *buffer) const {
+      if (level == depth) {
+        const int leaf  = node - numInternalNodes();
+        const int first = leaf_first[leaf];
+        const int n     = leaf_first[leaf + 1] - first;
+        const T *bucket = bucket_data.begin() + static_cast<size_t>(first)*D;
+        bucketSqDistances(n, D, bucket, q, buffer);
+        for (int j=0; j<n; ++j) {
+          insertKBest(K, count, ids, dists, bucket_ids[first + j], buffer[j]);
+        }
+        return n;
+      }
+      const T diff = q[split_axis[node]] - split_value[node];
+      const int near_child = (diff < T()) ? 2*node + 1 : 2*node + 2;
+      const int far_child  = (diff < T()) ? 2*node + 2 : 2*node + 1;
+      int processed = search(near_child, level + 1, q, K, count,
+                             ids, dists, buffer);
+      if (count < K || diff*diff < dists[count-1]) {
+        processed += search(far_child, level + 1, q, K, count,
+                            ids, dists, buffer);
+      }
+      return processed;
     }
 
-    /// Generic search method, uses an instance of Searcher to compute
-    /// intersections with hyperplane and the search hypersphere.
-    void searchKNN(Searcher &searcher,
-		   const KDNode *node,
-		   const int depth) {
-      if (node == 0) return;
-      const Point<T> &node_point = node->getPoint();
-      const T split_value = node->getSplitValue();
-      const KDNode *left  = node->getLeft();
-      const KDNode *right = node->getRight();
-      const int axis      = depth%D;
-      //
-      ++number_of_processed_points;
-      searcher.process(node_point);
-      switch(searcher.side(split_value,axis)) {
-      case 0:
-	searchKNN(searcher, left, depth+1);
-	if (searcher.rightIntersection(split_value,axis))
-	  searchKNN(searcher, right, depth+1);
-	break;
-      case 1:
-	searchKNN(searcher, right, depth+1);
-	if (searcher.leftIntersection(split_value,axis))
-	  searchKNN(searcher, left, depth+1);
-	break;
-      default:
-	;
-      }
+    /// Copies the given row into a contiguous buffer.
+    void copyRow(const Basics::Matrix<T> *m, int row, T *q) const {
+      Point<T> p(m, row, -1);
+      for (int d=0; d<D; ++d) q[d] = p[d];
+    }
+
+    void checkQueryMatrix(const Basics::Matrix<T> *m) const {
+      if (depth < 0)
+	ERROR_EXIT(256, "Build method needs to be called before searching\n");
+      if (m->getNumDim() != 2)
+	ERROR_EXIT(256, "A bi-dimensional matrix is needed\n");
+      if (m->getDimSize(1) != D)
+	ERROR_EXIT2(256, "Incorrect number of columns, expected %d, found %d\n",
+		    D, m->getDimSize(1));
     }
 
     /// For debugging purposes
-    void print(const KDNode *node, int depth) {
-      if (node == 0) return;
-      for (int i=0; i<depth; ++i)
+    void print(int node, int level) const {
+      for (int i=0; i<level; ++i)
 	printf("  ");
-      printf("%d %f\n", node->getPoint().getId(), node->getSplitValue());
-      print(node->getLeft(),  depth+1);
-      print(node->getRight(), depth+1);
+      if (level == depth) {
+        const int leaf = node - numInternalNodes();
+        printf("leaf [%d,%d)\n", leaf_first[leaf], leaf_first[leaf+1]);
+        return;
+      }
+      printf("axis %d %f\n", split_axis[node],
+             static_cast<double>(split_value[node]));
+      print(2*node + 1, level + 1);
+      print(2*node + 2, level + 1);
     }
     
   public:
 
     KDTree(const int D, Basics::MTRand *random) :
-      D(D), N(0), root(0), random(random) {
+      D(D), N(0), random(random), depth(-1), number_of_processed_points(0) {
       IncRef(random);
       first_index.push_back(0);
     }
@@ -319,7 +247,6 @@ namespace KNN {
       for (typename AprilUtils::vector< Basics::Matrix<T>* >::iterator it=matrix_vector.begin();
 	   it != matrix_vector.end(); ++it)
 	DecRef(*it);
-      delete root;
     }
     
     /// Returns a matrix and a row from an index point
@@ -357,18 +284,36 @@ namespace KNN {
     /// Builds the KDTree with all the pushed matrix data. Previous computation
     /// will be deleted if exists.
     void build() {
-      delete root;
-      PointsList *points_list = new PointsList(N);
+      PointsList points(N);
       int i=0;
       for (size_t j=0; j<matrix_vector.size(); ++j) {
 	Basics::Matrix<T> *m = matrix_vector[j];
 	for (int row=0; row<m->getDimSize(0); ++row, ++i) {
 	  april_assert(i<N);
-	  (*points_list)[i] = Point<T>(m, row, i);
+	  points[i] = Point<T>(m, row, i);
 	}
       }
-      root = build(points_list, 0);
-      delete points_list;
+      // smallest depth with leaves of at most BUCKET_SIZE points
+      depth = 0;
+      while ( ((N + (1 << depth) - 1) >> depth) > BUCKET_SIZE ) ++depth;
+      split_axis.resize(numInternalNodes());
+      split_value.resize(numInternalNodes());
+      leaf_first.resize((1 << depth) + 1);
+      leaf_first[1 << depth] = N;
+      build(points, 0, 0, 0, N);
+      // copy the points into their buckets
+      bucket_data.resize(static_cast<size_t>(N)*D);
+      bucket_ids.resize(N);
+      for (int leaf=0; leaf < (1 << depth); ++leaf) {
+        const int first = leaf_first[leaf];
+        const int n     = leaf_first[leaf + 1] - first;
+        T *dest = bucket_data.begin() + static_cast<size_t>(first)*D;
+        for (int j=0; j<n; ++j) {
+          const Point<T> &p = points[first + j];
+          for (int d=0; d<D; ++d) dest[d*n + j] = p[d];
+          bucket_ids[first + j] = p.getId();
+        }
+      }
     }
     
     /// Method for 1-NN search, it receives a matrix with one point, and returns
@@ -378,70 +323,92 @@ namespace KNN {
     int searchNN(Basics::Matrix<T> *point_matrix,
 		 double &distance,
 		 Basics::Matrix<T> **result) {
-      if (root == 0)
-	ERROR_EXIT(256, "Build method needs to be called before searching\n");
-      if (point_matrix->getNumDim() != 2 || point_matrix->getDimSize(0) != 1)
-	ERROR_EXIT(256, "A bi-dimensional matrix with one row is needed\n");
-      if (point_matrix->getDimSize(1) != D)
-	ERROR_EXIT2(256, "Incorrect number of columns, expected %d, found %d\n",
-		    D, point_matrix->getDimSize(1));
-      Point<T> point(point_matrix, 0, -1);
-      OneBestSearcher one_best(point,D);
-      number_of_processed_points = 0;
-      searchKNN(one_best, root, 0);
-      int best_id = one_best.getOneBestIndex();
-      distance = one_best.getOneBestDistance();
-      if (result != 0) {
-	int best_row;
-	Basics::Matrix<T> *best_matrix = getMatrixAndRow(best_id, best_row);
-	int coords[2] = { best_row, 0 };
-	int sizes[2]  = { 1, D };
-	*result = new Basics::Matrix<T>(best_matrix, coords, sizes, false);
-      }
-      return best_id;
+      AprilUtils::vector<int> indices;
+      AprilUtils::vector<double> distances;
+      AprilUtils::vector< Basics::Matrix<T> *> result_vector;
+      searchKNN(1, point_matrix, indices, distances,
+                (result != 0) ? (&result_vector) : 0);
+      distance = distances[0];
+      if (result != 0) *result = result_vector[0];
+      return indices[0];
     }
 
-    /// Method for K-NN search (with K>1). Tt receives a matrix with one point
-    /// and the K value, and returns a vector of indices, a vector of distances,
-    /// and a vector of matrices (if needed, that is, result pointer != 0).
+    /// Method for K-NN search. Tt receives a matrix with one point and the K
+    /// value, and returns a vector of indices, a vector of distances, and a
+    /// vector of matrices (if needed, that is, result pointer != 0).
     void searchKNN(int K,
 		   Basics::Matrix<T> *point_matrix,
 		   AprilUtils::vector<int> &indices,
 		   AprilUtils::vector<double> &distances,
 		   AprilUtils::vector< Basics::Matrix<T> *> *result=0) {
-      if (root == 0)
-	ERROR_EXIT(256, "Build method needs to be called before searching\n");
-      if (K == 1) {
-	double distance;
-	Basics::Matrix<T> *resultM;
-	int best_id = searchNN(point_matrix,distance,(result!=0)?(&resultM):0);
-	indices.push_back(best_id);
-	distances.push_back(distance);
-	if (result) result->push_back(resultM);
+      checkQueryMatrix(point_matrix);
+      if (point_matrix->getDimSize(0) != 1)
+        ERROR_EXIT(256, "A bi-dimensional matrix with one row is needed\n");
+      if (K < 1) ERROR_EXIT(256, "K must be greater than 0\n");
+      AprilUtils::vector<T> q(D), buffer(BUCKET_SIZE), dists(K);
+      AprilUtils::vector<int> ids(K);
+      int count = 0;
+      copyRow(point_matrix, 0, q.begin());
+      number_of_processed_points = search(0, 0, q.begin(), K, count,
+                                          ids.begin(), dists.begin(),
+                                          buffer.begin());
+      for (int i=0; i<count; ++i) {
+        indices.push_back(ids[i]);
+        distances.push_back(static_cast<double>(dists[i]));
+        if (result != 0) {
+          int best_row;
+          Basics::Matrix<T> *best_matrix = getMatrixAndRow(ids[i], best_row);
+          int coords[2] = { best_row, 0 };
+          int sizes[2]  = { 1, D };
+          result->push_back(new Basics::Matrix<T>(best_matrix, coords,
+                                                  sizes, false));
+        }
       }
-      else {
-	if (point_matrix->getNumDim() != 2 || point_matrix->getDimSize(0) != 1)
-	  ERROR_EXIT(256, "A bi-dimensional matrix with one row is needed\n");
-	if (point_matrix->getDimSize(1) != D)
-	  ERROR_EXIT2(256, "Incorrect number of columns, expected %d, found %d\n",
-		      D, point_matrix->getDimSize(1));
-	Point<T> point(point_matrix, 0, -1);
-	KBestSearcher k_best(K,point,D);
-	number_of_processed_points = 0;
-	searchKNN(k_best, root, 0);
-	k_best.getBestData(indices,distances);
-	if (result != 0) {
-	  result->reserve(static_cast<size_t>(indices.size()));
-	  for (size_t i=0; i<indices.size(); ++i) {
-	    int best_id = indices[i];
-	    int best_row;
-	    Basics::Matrix<T> *best_matrix = getMatrixAndRow(best_id, best_row);
-	    int coords[2] = { best_row, 0 };
-	    int sizes[2]  = { 1, D };
-	    result->push_back(new Basics::Matrix<T>(best_matrix, coords,
-                                                    sizes, false));
-	  }
-	}
+    }
+
+    /**
+     * @brief Batched K-NN search of every row of the given queries matrix.
+     *
+     * Queries are processed in parallel with OpenMP. The given contiguous
+     * matrices of size num_queries x K receive the point indices (in the
+     * order they were pushed, starting at 0) and the squared distances,
+     * sorted by distance.
+     */
+    void searchKNN(int K, const Basics::Matrix<T> *queries,
+                   Basics::Matrix<int32_t> *indices,
+                   Basics::Matrix<T> *distances) const {
+      checkQueryMatrix(queries);
+      const int Q = queries->getDimSize(0);
+      if (K < 1 || K > N)
+        ERROR_EXIT2(256, "K must be in range [1,%d], found %d\n", N, K);
+      if (indices->getNumDim() != 2 || distances->getNumDim() != 2 ||
+          indices->getDimSize(0) != Q || indices->getDimSize(1) != K ||
+          distances->getDimSize(0) != Q || distances->getDimSize(1) != K ||
+          !indices->getIsContiguous() || !distances->getIsContiguous())
+        ERROR_EXIT2(256, "Expected contiguous result matrices of size %dx%d\n",
+                    Q, K);
+      int32_t *ids_ptr = indices->getRawDataAccess()->getPPALForWrite() +
+        indices->getOffset();
+      T *dists_ptr = distances->getRawDataAccess()->getPPALForWrite() +
+        distances->getOffset();
+#ifndef NO_OMP
+#pragma omp parallel
+#endif
+      {
+        AprilUtils::vector<T> q(D), buffer(BUCKET_SIZE);
+        AprilUtils::vector<int> ids(K);
+#ifndef NO_OMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+        for (int i=0; i<Q; ++i) {
+          int count = 0;
+          copyRow(queries, i, q.begin());
+          search(0, 0, q.begin(), K, count, ids.begin(),
+                 dists_ptr + static_cast<size_t>(i)*K, buffer.begin());
+          for (int k=0; k<K; ++k) {
+            ids_ptr[static_cast<size_t>(i)*K + k] = ids[k];
+          }
+        }
       }
     }
   
@@ -451,9 +418,9 @@ namespace KNN {
     
     /// For debugging purposes
     void print() {
-      if (root == 0)
+      if (depth < 0)
 	ERROR_EXIT(256, "Build method needs to be called before print\n");
-      print(root, 0);
+      print(0, 0);
     }
     
     int getNumProcessedPoints() const {
@@ -81,4 +81,14 @@ T("KDTreeTest", function()
       end
     end
     -- print(100*errors/val_data:dim(1) .. "%", errors)
+    -- BATCHED SEARCH
+    local indices,distances = kdt:searchKNNBatch(KNN,val_data)
+    check.eq(indices:dim(), {val_data:dim(1), KNN})
+    for i=1,val_data:dim(1) do
+      local result = kdt:searchKNN(KNN,val_data(i,':'))
+      for j=1,KNN do
+        check.eq(indices:get(i,j), result[j][1])
+        check.number_eq(distances:get(i,j), result[j][2])
+      end
+    end
 end)
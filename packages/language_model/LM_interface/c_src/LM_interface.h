@@ -103,6 +103,11 @@ namespace LanguageModels {
         id_key(id_key), id_word(id_word) {}
       Burden(const Burden &other) :
         id_key(other.id_key), id_word(other.id_word) { }
+      Burden &operator=(const Burden &other) {
+        id_key  = other.id_key;
+        id_word = other.id_word;
+        return *this;
+      }
     };
     
     /**
@@ -136,10 +136,22 @@ using namespace LanguageModels;
   check_table_fields(L, 1, 
 		     "filename",
 		     "vocabulary",
+		     // bits of the quantized probabilities, 0 for the plain
+		     // binary format
+		     "prob_bits",
+		     "backoff_bits",
 		     (const char *)0); // 0 para terminar el check_table_fields
   //
   const char *filename;
+  unsigned int prob_bits, backoff_bits;
   LUABIND_GET_TABLE_PARAMETER(1, filename, string, filename);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, prob_bits, uint, prob_bits, 0);
+  LUABIND_GET_TABLE_OPTIONAL_PARAMETER(1, backoff_bits, uint, backoff_bits,
+				       prob_bits);
+  if (prob_bits > 16 || backoff_bits > 16) {
+    LUABIND_ERROR("save_binary method: prob_bits and backoff_bits must be "
+		  "in range [0,16]");
+  }
   lua_getfield(L,1,"vocabulary");
   if (lua_isnil(L,-1)) {
     LUABIND_ERROR("error save_binary method requires vocabulary table");
@@ -151,7 +163,9 @@ using namespace LanguageModels;
   
   obj->saveBinary(filename,
 		  (unsigned int)vocabulary_size,
-		  vocabulary_vector);
+		  vocabulary_vector,
+		  prob_bits,
+		  backoff_bits);
   delete[] vocabulary_vector;
 }
 //BIND_END
@@ -204,6 +218,23 @@ using namespace LanguageModels;
 }
 //BIND_END
 
+//BIND_METHOD NgramLiraInterface set_cache_size
+// number of (state,word) lookups kept in the interface cache, 0 disables it
+{
+  LUABIND_CHECK_ARGN(==, 1);
+  unsigned int size;
+  LUABIND_GET_PARAMETER(1, uint, size);
+  obj->setCacheSize(size);
+  LUABIND_RETURN(NgramLiraInterface, obj);
+}
+//BIND_END
+
+//BIND_METHOD NgramLiraInterface get_cache_size
+{
+  LUABIND_RETURN(uint, obj->getCacheSize());
+}
+//BIND_END
+
 //////////////////////////////////////////////////////////////////////////
 
 //BIND_LUACLASSNAME HistoryBasedNgramLiraLM ngram.lira.history_based_model
@@ -23,7 +23,9 @@
 #include "april_assert.h"
 #include "c_string.h"
 #include "error_print.h"        // print errors
+#include "maxmin.h"
 #include "ngram_lira.h"
+#include "qsort.h"
 #include "smart_ptr.h"
 #include "uncommented_line.h" // read data
 
@@ -44,6 +46,80 @@ using namespace AprilIO;
 
 namespace LanguageModels {
 
+  namespace {
+    const unsigned int PLAIN_MAGIC     = 12345u;
+    const unsigned int QUANTIZED_MAGIC = 12346u;
+
+    size_t align8(size_t sz) {
+      return (sz + 7u) & ~static_cast<size_t>(7u);
+    }
+
+    bool isLogZero(float v) {
+      return v <= NgramLiraModel::Score::zero().log();
+    }
+
+    /// Builds a sorted codebook with at most 2^bits entries for the given
+    /// log values, the first entry is reserved to zero. Non-zero values are
+    /// splitted in bins of equal frequency represented by their mean, or by
+    /// their maximum when upper_bound is true. The codebook is lossless when
+    /// the number of different values fits on it.
+    void buildCodebook(vector<float> &values, unsigned int bits,
+                       bool upper_bound, vector<float> &codebook) {
+      codebook.clear();
+      codebook.push_back(NgramLiraModel::Score::zero().log());
+      vector<float> sorted;
+      for (unsigned int i=0; i<values.size(); ++i) {
+        if (!isLogZero(values[i])) sorted.push_back(values[i]);
+      }
+      if (sorted.size() == 0) return;
+      Sort(sorted.begin(), static_cast<int>(sorted.size()));
+      unsigned int num_bins = (1u << bits) - 1u;
+      unsigned int num_different = 1;
+      for (unsigned int i=1; i<sorted.size(); ++i) {
+        if (sorted[i] != sorted[i-1]) ++num_different;
+      }
+      if (num_different <= num_bins) {
+        codebook.push_back(sorted[0]);
+        for (unsigned int i=1; i<sorted.size(); ++i) {
+          if (sorted[i] != sorted[i-1]) codebook.push_back(sorted[i]);
+        }
+        return;
+      }
+      size_t n = sorted.size();
+      for (unsigned int k=0; k<num_bins; ++k) {
+        size_t first = (n*k)/num_bins, last = (n*(k+1))/num_bins;
+        if (first == last) continue;
+        float repr;
+        if (upper_bound) repr = sorted[last-1];
+        else {
+          double sum = 0.0;
+          for (size_t i=first; i<last; ++i) sum += sorted[i];
+          repr = static_cast<float>(sum/(last - first));
+        }
+        if (codebook.size() == 1u || codebook.back() < repr) {
+          codebook.push_back(repr);
+        }
+      }
+    }
+
+    /// Returns the codebook index of the nearest entry, or of the smallest
+    /// entry which is greater or equal than v when upper_bound is true.
+    uint64_t encodeValue(const vector<float> &codebook, float v,
+                         bool upper_bound) {
+      if (isLogZero(v) || codebook.size() == 1u) return 0u;
+      unsigned int left = 1, right = codebook.size();
+      while (left < right) {
+        unsigned int mid = (left + right)/2;
+        if (codebook[mid] < v) left = mid + 1;
+        else right = mid;
+      }
+      if (left == codebook.size()) return left - 1u;
+      if (!upper_bound && left > 1u &&
+          v - codebook[left-1] < codebook[left] - v) return left - 1u;
+      return left;
+    }
+  } // anonymous namespace
+
   // format errors are NOT checked!!!
   NgramLiraModel::NgramLiraModel(StreamInterface *fd,
                                  unsigned int expected_vocabulary_size,
@@ -53,6 +129,7 @@ namespace LanguageModels {
                                  bool ignore_extra_words_in_dictionary) :
     ignore_extra_words_in_dictionary(ignore_extra_words_in_dictionary),
     fan_out_threshold(fan_out_threshold),
+    is_quantized(false),
     is_mmapped(false),
     final_word(final_word) {
   
@@ -220,6 +297,7 @@ namespace LanguageModels {
   }
 
   NgramLiraModel::NgramLiraModel(int vocabulary_size, WordType final_word) :
+    is_quantized(false),
     is_mmapped(false),
     final_word(final_word) {
     
@@ -303,7 +381,9 @@ namespace LanguageModels {
 
   void NgramLiraModel::saveBinary(const char *filename,
                                   unsigned int expected_vocabulary_size,
-                                  const char *expected_vocabulary[]) {
+                                  const char *expected_vocabulary[],
+                                  unsigned int prob_bits,
+                                  unsigned int backoff_bits) {
     
     if (expected_vocabulary_size != vocabulary_size) {
       ERROR_PRINT2("Error expected vocabulary is %d instead of %d\n",
@@ -311,6 +391,15 @@ namespace LanguageModels {
                    expected_vocabulary_size);
       exit(1);
     }
+    if (prob_bits > 0) {
+      saveQuantizedBinary(filename, expected_vocabulary,
+                          prob_bits, backoff_bits);
+      return;
+    }
+    if (is_quantized) {
+      ERROR_PRINT("A quantized model can only be saved quantized\n");
+      exit(1);
+    }
 
     //--------------------------------------------------
     // trying to open file in write mode
@@ -324,7 +413,7 @@ namespace LanguageModels {
     //--------------------------------------------------
     // fill the header
     NgramLiraBinaryHeader header;
-    header.magic                     = 12345u;
+    header.magic                     = PLAIN_MAGIC;
     header.ngram_value               = ngram_value;
     header.vocabulary_size            = vocabulary_size;   
     header.initial_state             = initial_state;
@@ -443,6 +532,7 @@ namespace LanguageModels {
                                  WordType final_word,
                                  bool ignore_extra_words_in_dictionary) :
     ignore_extra_words_in_dictionary(ignore_extra_words_in_dictionary),
+    is_quantized(false),
     final_word(final_word) {
     //----------------------------------------------------------------------
     // open file:
@@ -466,24 +556,40 @@ namespace LanguageModels {
     }
     is_mmapped = true;
 
-    NgramLiraBinaryHeader *header = (NgramLiraBinaryHeader *) filemapped;
-    if (header->magic != 12345u) {
-      ERROR_PRINT("Error magic value, endianism problem?\n");
-      exit(1);
+    size_t offset_vocabulary_vector;
+    unsigned int magic = *((unsigned int *) filemapped);
+    if (magic == QUANTIZED_MAGIC) {
+      offset_vocabulary_vector = loadQuantizedBinary();
+    }
+    else {
+      NgramLiraBinaryHeader *header = (NgramLiraBinaryHeader *) filemapped;
+      if (magic != PLAIN_MAGIC) {
+        ERROR_PRINT("Error magic value, endianism problem?\n");
+        exit(1);
+      }
+      ngram_value               = header->ngram_value;
+      vocabulary_size           = header->vocabulary_size;
+      initial_state             = header->initial_state;
+      final_state               = header->final_state;
+      lowest_state              = header->lowest_state;
+      num_states                = header->num_states;
+      num_transitions           = header->num_transitions;
+      different_number_of_trans = header->different_number_of_trans;
+      linear_search_size        = header->linear_search_size;
+      fan_out_threshold         = header->fan_out_threshold;
+      first_state_binary_search = header->first_state_binary_search;
+      size_first_transition     = header->size_first_transition;
+      best_prob                 = header->best_prob;
+      offset_vocabulary_vector  = header->offset_vocabulary_vector;
+
+      // assign vector pointers:
+      transition_words_table = (WordType *)(filemapped + header->offset_transition_words_table);
+      transition_table       = (NgramLiraTransition *)(filemapped + header->offset_transition_table);
+      linear_search_table    = (LinearSearchInfo*)(filemapped + header->offset_linear_search_table);
+      backoff_table          = (NgramBackoffInfo*)(filemapped + header->offset_backoff_table);
+      max_out_prob           = (Score*)(filemapped + header->offset_max_out_prob);
+      first_transition       = (unsigned int*)(filemapped + header->offset_first_transition) - first_state_binary_search;
     }
-    ngram_value               = header->ngram_value;
-    vocabulary_size            = header->vocabulary_size;   
-    initial_state             = header->initial_state;
-    final_state               = header->final_state;
-    lowest_state              = header->lowest_state;
-    num_states                = header->num_states;
-    num_transitions           = header->num_transitions;
-    different_number_of_trans = header->different_number_of_trans;
-    linear_search_size        = header->linear_search_size;
-    fan_out_threshold         = header->fan_out_threshold;
-    first_state_binary_search = header->first_state_binary_search;
-    size_first_transition     = header->size_first_transition;
-    best_prob                 = header->best_prob;
 
     // checking vocabulary:
     if (expected_vocabulary) {
@@ -495,7 +601,7 @@ namespace LanguageModels {
           exit(1);
         }
       }
-      char *dest_voc = filemapped+header->offset_vocabulary_vector;
+      char *dest_voc = filemapped+offset_vocabulary_vector;
       for (unsigned int i=0;i<vocabulary_size;++i) {
         if (strcmp(dest_voc,expected_vocabulary[i])!=0) {
           ERROR_PRINT3("word %u is '%s' instead of '%s'\n",
@@ -506,15 +612,260 @@ namespace LanguageModels {
       }
     }
 
-    // assign vector pointers:
-    transition_words_table = (WordType *)(filemapped + header->offset_transition_words_table);
-    transition_table       = (NgramLiraTransition *)(filemapped + header->offset_transition_table);
+    // at this point, all seems to be ok :)
+  }
+
+  void NgramLiraModel::saveQuantizedBinary(const char *filename,
+                                           const char *expected_vocabulary[],
+                                           unsigned int prob_bits,
+                                           unsigned int backoff_bits) {
+    if (backoff_bits == 0) backoff_bits = prob_bits;
+    if (prob_bits > 16 || backoff_bits > 16) {
+      ERROR_PRINT2("Quantization bits must be in range [1,16], found %u and %u\n",
+                   prob_bits, backoff_bits);
+      exit(1);
+    }
+
+    //--------------------------------------------------
+    // codebooks, max_out_prob is rounded up to keep it as an upper bound of
+    // the quantized transition probabilities
+    vector<float> values(num_transitions), prob_codebook_vec;
+    for (unsigned int i=0; i<num_transitions; ++i) {
+      values[i] = getTransitionProb(i).log();
+    }
+    buildCodebook(values, prob_bits, false, prob_codebook_vec);
+    vector<uint64_t> prob_codes(num_transitions);
+    WordType max_word = 0;
+    for (unsigned int i=0; i<num_transitions; ++i) {
+      prob_codes[i] = encodeValue(prob_codebook_vec, values[i], false);
+      if (getTransitionWord(i) > max_word) max_word = getTransitionWord(i);
+    }
+    values.resize(num_states);
+    vector<float> backoff_codebook_vec;
+    for (unsigned int st=0; st<num_states; ++st) {
+      values[st] = getBackoffProb(st).log();
+    }
+    buildCodebook(values, backoff_bits, false, backoff_codebook_vec);
+    vector<uint64_t> backoff_codes(num_states);
+    for (unsigned int st=0; st<num_states; ++st) {
+      backoff_codes[st] = encodeValue(backoff_codebook_vec, values[st], false);
+    }
+    for (unsigned int st=0; st<num_states; ++st) {
+      values[st] = getMaxOutProb(st).log();
+    }
+    for (unsigned int k=0; k<linear_search_size; ++k) {
+      const LinearSearchInfo &info = linear_search_table[k];
+      for (unsigned int st=info.first_state;
+           st<linear_search_table[k+1].first_state; ++st) {
+        unsigned int first = (st - info.first_state)*info.fan_out + info.first_index;
+        for (unsigned int tr=first; tr<first+info.fan_out; ++tr) {
+          values[st] = AprilUtils::max(values[st], prob_codebook_vec[prob_codes[tr]]);
+        }
+      }
+    }
+    for (unsigned int st=first_state_binary_search; st<num_states; ++st) {
+      for (unsigned int tr=getFirstTransition(st);
+           tr<getFirstTransition(st+1); ++tr) {
+        values[st] = AprilUtils::max(values[st], prob_codebook_vec[prob_codes[tr]]);
+      }
+    }
+    vector<float> max_out_codebook_vec;
+    buildCodebook(values, prob_bits, true, max_out_codebook_vec);
+    vector<uint64_t> max_out_codes(num_states);
+    float best_prob_value = best_prob.log();
+    for (unsigned int st=0; st<num_states; ++st) {
+      max_out_codes[st] = encodeValue(max_out_codebook_vec, values[st], true);
+      best_prob_value = AprilUtils::max(best_prob_value,
+                                        max_out_codebook_vec[max_out_codes[st]]);
+    }
+    vector<uint64_t> first_transition_values(size_first_transition + 1);
+    for (unsigned int i=0; i<=size_first_transition; ++i) {
+      first_transition_values[i] = getFirstTransition(first_state_binary_search + i);
+    }
+
+    //--------------------------------------------------
+    // fill the header
+    NgramLiraQuantizedHeader header = NgramLiraQuantizedHeader();
+    header.magic                     = QUANTIZED_MAGIC;
+    header.ngram_value               = ngram_value;
+    header.vocabulary_size           = vocabulary_size;
+    header.initial_state             = initial_state;
+    header.final_state               = final_state;
+    header.lowest_state              = lowest_state;
+    header.num_states                = num_states;
+    header.num_transitions           = num_transitions;
+    header.different_number_of_trans = different_number_of_trans;
+    header.linear_search_size        = linear_search_size;
+    header.fan_out_threshold         = fan_out_threshold;
+    header.first_state_binary_search = first_state_binary_search;
+    header.size_first_transition     = size_first_transition;
+    header.best_prob                 = Score(best_prob_value);
+    header.word_bits                 = bitsForValue(max_word);
+    header.state_bits                = bitsForValue(num_states - 1);
+    header.prob_bits                 = bitsForValue(prob_codebook_vec.size() - 1);
+    header.backoff_bits              = bitsForValue(backoff_codebook_vec.size() - 1);
+    header.max_out_bits              = bitsForValue(max_out_codebook_vec.size() - 1);
+    header.first_transition_low_bits =
+      EliasFanoArray::computeLowBits(size_first_transition + 1, num_transitions);
+    header.prob_codebook_size        = prob_codebook_vec.size();
+    header.backoff_codebook_size     = backoff_codebook_vec.size();
+    header.max_out_codebook_size     = max_out_codebook_vec.size();
+
+    size_t sz = align8(sizeof(NgramLiraQuantizedHeader));
+    header.offset_vocabulary_vector = sz;
+    header.size_vocabulary_vector   = 0;
+    for (unsigned int i=0;i<vocabulary_size;++i)
+      header.size_vocabulary_vector += strlen(expected_vocabulary[i])+1;
+    sz = align8(sz + header.size_vocabulary_vector);
+    header.offset_prob_codebook     = sz;
+    sz = align8(sz + sizeof(float)*header.prob_codebook_size);
+    header.offset_backoff_codebook  = sz;
+    sz = align8(sz + sizeof(float)*header.backoff_codebook_size);
+    header.offset_max_out_codebook  = sz;
+    sz = align8(sz + sizeof(float)*header.max_out_codebook_size);
+    header.offset_transition_words  = sz;
+    sz += sizeof(uint64_t)*PackedArray::sizeInWords(num_transitions, header.word_bits);
+    header.offset_transition_states = sz;
+    sz += sizeof(uint64_t)*PackedArray::sizeInWords(num_transitions, header.state_bits);
+    header.offset_transition_probs  = sz;
+    sz += sizeof(uint64_t)*PackedArray::sizeInWords(num_transitions, header.prob_bits);
+    header.offset_backoff_states    = sz;
+    sz += sizeof(uint64_t)*PackedArray::sizeInWords(num_states, header.state_bits);
+    header.offset_backoff_probs     = sz;
+    sz += sizeof(uint64_t)*PackedArray::sizeInWords(num_states, header.backoff_bits);
+    header.offset_max_out_probs     = sz;
+    sz += sizeof(uint64_t)*PackedArray::sizeInWords(num_states, header.max_out_bits);
+    header.offset_linear_search_table = sz;
+    sz = align8(sz + sizeof(LinearSearchInfo)*(different_number_of_trans+1));
+    header.offset_first_transition_low = sz;
+    sz += sizeof(uint64_t)*PackedArray::sizeInWords(size_first_transition + 1,
+                                                    header.first_transition_low_bits);
+    header.offset_first_transition_high = sz;
+    sz += sizeof(uint64_t)*EliasFanoArray::highSizeInWords(size_first_transition + 1,
+                                                           num_transitions,
+                                                           header.first_transition_low_bits);
+    header.offset_first_transition_samples = sz;
+    sz += sizeof(uint64_t)*EliasFanoArray::samplesSize(size_first_transition + 1);
+    header.filesize = sz;
+
+    //--------------------------------------------------
+    // make file of desired size, filled with zeroes
+    int f_descr;
+    mode_t writemode = S_IRUSR | S_IWUSR | S_IRGRP;
+    if ((f_descr = open(filename, O_RDWR | O_CREAT | O_TRUNC, writemode)) < 0) {
+      ERROR_PRINT1("Error creating file %s\n",filename);
+      exit(1);
+    }
+    if (lseek(f_descr, sz-1, SEEK_SET) == -1) {
+      ERROR_PRINT1("lseek error, position %u was tried\n",
+                   (unsigned int)(sz-1));
+      exit(1);
+    }
+    if (write(f_descr,"",1) != 1) {
+      ERROR_PRINT("write error\n");
+      exit(1);
+    }
+    char *mapped;
+    if ((mapped = (char*)mmap(0, sz,
+                              PROT_READ|PROT_WRITE, MAP_SHARED,
+                              f_descr, 0))  == (caddr_t)-1) {
+      ERROR_PRINT("mmap error\n");
+      exit(1);
+    }
+
+    memcpy(mapped, &header, sizeof(NgramLiraQuantizedHeader));
+    char *dest_voc = mapped + header.offset_vocabulary_vector;
+    for (unsigned int i=0;i<vocabulary_size;++i) {
+      strcpy(dest_voc,expected_vocabulary[i]);
+      dest_voc += strlen(expected_vocabulary[i])+1;
+    }
+    memcpy(mapped + header.offset_prob_codebook, prob_codebook_vec.begin(),
+           sizeof(float)*header.prob_codebook_size);
+    memcpy(mapped + header.offset_backoff_codebook, backoff_codebook_vec.begin(),
+           sizeof(float)*header.backoff_codebook_size);
+    memcpy(mapped + header.offset_max_out_codebook, max_out_codebook_vec.begin(),
+           sizeof(float)*header.max_out_codebook_size);
+    uint64_t *words  = (uint64_t*)(mapped + header.offset_transition_words);
+    uint64_t *states = (uint64_t*)(mapped + header.offset_transition_states);
+    uint64_t *probs  = (uint64_t*)(mapped + header.offset_transition_probs);
+    for (unsigned int i=0; i<num_transitions; ++i) {
+      PackedArray::set(words, i, header.word_bits, getTransitionWord(i));
+      PackedArray::set(states, i, header.state_bits, getTransitionState(i));
+      PackedArray::set(probs, i, header.prob_bits, prob_codes[i]);
+    }
+    uint64_t *bo_states = (uint64_t*)(mapped + header.offset_backoff_states);
+    uint64_t *bo_probs  = (uint64_t*)(mapped + header.offset_backoff_probs);
+    uint64_t *max_outs  = (uint64_t*)(mapped + header.offset_max_out_probs);
+    for (unsigned int st=0; st<num_states; ++st) {
+      PackedArray::set(bo_states, st, header.state_bits, getBackoffState(st));
+      PackedArray::set(bo_probs, st, header.backoff_bits, backoff_codes[st]);
+      PackedArray::set(max_outs, st, header.max_out_bits, max_out_codes[st]);
+    }
+    memcpy(mapped + header.offset_linear_search_table, linear_search_table,
+           sizeof(LinearSearchInfo)*(different_number_of_trans+1));
+    EliasFanoArray::build(first_transition_values.begin(),
+                          size_first_transition + 1,
+                          header.first_transition_low_bits,
+                          (uint64_t*)(mapped + header.offset_first_transition_low),
+                          (uint64_t*)(mapped + header.offset_first_transition_high),
+                          (uint64_t*)(mapped + header.offset_first_transition_samples));
+
+    if (munmap(mapped, sz) == -1) {
+      ERROR_PRINT("munmap error\n");
+      exit(1);
+    }
+    close(f_descr);
+  }
+
+  size_t NgramLiraModel::loadQuantizedBinary() {
+    const NgramLiraQuantizedHeader *header =
+      (const NgramLiraQuantizedHeader *) filemapped;
+    if (filesize < sizeof(NgramLiraQuantizedHeader) ||
+        filesize < header->filesize) {
+      ERROR_PRINT("Truncated quantized binary file\n");
+      exit(1);
+    }
+    ngram_value               = header->ngram_value;
+    vocabulary_size           = header->vocabulary_size;
+    initial_state             = header->initial_state;
+    final_state               = header->final_state;
+    lowest_state              = header->lowest_state;
+    num_states                = header->num_states;
+    num_transitions           = header->num_transitions;
+    different_number_of_trans = header->different_number_of_trans;
+    linear_search_size        = header->linear_search_size;
+    fan_out_threshold         = header->fan_out_threshold;
+    first_state_binary_search = header->first_state_binary_search;
+    size_first_transition     = header->size_first_transition;
+    best_prob                 = header->best_prob;
+
+    // plain vectors are not available
+    transition_words_table = 0;
+    transition_table       = 0;
+    backoff_table          = 0;
+    max_out_prob           = 0;
+    first_transition       = 0;
     linear_search_table    = (LinearSearchInfo*)(filemapped + header->offset_linear_search_table);
-    backoff_table          = (NgramBackoffInfo*)(filemapped + header->offset_backoff_table);
-    max_out_prob           = (Score*)(filemapped + header->offset_max_out_prob);
-    first_transition       = (unsigned int*)(filemapped + header->offset_first_transition) - first_state_binary_search;
 
-    // at this point, all seems to be ok :)
+    prob_codebook    = (const float*)(filemapped + header->offset_prob_codebook);
+    backoff_codebook = (const float*)(filemapped + header->offset_backoff_codebook);
+    max_out_codebook = (const float*)(filemapped + header->offset_max_out_codebook);
+#define PACKED(offset, bits) \
+    PackedArray((const uint64_t*)(filemapped + header->offset), header->bits)
+    packed_words     = PACKED(offset_transition_words, word_bits);
+    packed_states    = PACKED(offset_transition_states, state_bits);
+    packed_probs     = PACKED(offset_transition_probs, prob_bits);
+    packed_bo_states = PACKED(offset_backoff_states, state_bits);
+    packed_bo_probs  = PACKED(offset_backoff_probs, backoff_bits);
+    packed_max_out   = PACKED(offset_max_out_probs, max_out_bits);
+#undef PACKED
+    packed_first_transition =
+      EliasFanoArray((const uint64_t*)(filemapped + header->offset_first_transition_low),
+                     (const uint64_t*)(filemapped + header->offset_first_transition_high),
+                     (const uint64_t*)(filemapped + header->offset_first_transition_samples),
+                     header->first_transition_low_bits);
+    is_quantized = true;
+    return header->offset_vocabulary_vector;
   }
 
   LMInterfaceUInt32LogFloat* NgramLiraModel::getInterface() {
@@ -523,13 +874,9 @@ namespace LanguageModels {
   
   ///////////////////////////////////////////////////////////////////////////
 
-  void NgramLiraInterface::get(Key state,
-                               WordType word, Burden burden,
-                               vector<KeyScoreBurdenTuple> &result,
-                               Score threshold) {
+  void NgramLiraInterface::resolve(unsigned int state, WordType word,
+                                   unsigned int &dest, Score &score) {
     NgramLiraModel *lira_model = static_cast<NgramLiraModel*>(model);
-    april_assert(word != 0);
-    UNUSED_VARIABLE(threshold);
     Score accum_backoff     = Score::one();
     unsigned int st         = state;
     
@@ -545,27 +892,23 @@ namespace LanguageModels {
         unsigned int last_tr_index  = first_tr_index + info->fan_out;
         // lineal search:
         for (unsigned int tr_index = first_tr_index; tr_index < last_tr_index; tr_index++)
-          if (lira_model->transition_words_table[tr_index] == word) {
-            result.push_back(KeyScoreBurdenTuple(lira_model->transition_table[tr_index].state,
-                             accum_backoff *
-                             lira_model->transition_table[tr_index].prob,
-                             burden));
+          if (lira_model->getTransitionWord(tr_index) == word) {
+            dest  = lira_model->getTransitionState(tr_index);
+            score = accum_backoff * lira_model->getTransitionProb(tr_index);
             return;
           }
       } else {
         // the dichotomic search of the transition index is not based
         // on the binary_search template in order to be able to return
         // as soon as the word is found
-        unsigned int left  = lira_model->first_transition[st];
-        unsigned int right = lira_model->first_transition[st+1] - 1;
+        unsigned int left  = lira_model->getFirstTransition(st);
+        unsigned int right = lira_model->getFirstTransition(st+1) - 1;
         while (left <= right) {
           unsigned int tr_index     = (left+right)/2;
-          unsigned int current_word = lira_model->transition_words_table[tr_index];
+          unsigned int current_word = lira_model->getTransitionWord(tr_index);
           if (current_word == word) {
-            result.push_back(KeyScoreBurdenTuple(lira_model->transition_table[tr_index].state,
-                             accum_backoff *
-                             lira_model->transition_table[tr_index].prob,
-                             burden));
+            dest  = lira_model->getTransitionState(tr_index);
+            score = accum_backoff * lira_model->getTransitionProb(tr_index);
             return;
           } else if (current_word < word) {
             left  = tr_index+1;
@@ -580,14 +923,138 @@ namespace LanguageModels {
         ERROR_EXIT(128, "Transition not found!!!\n");
         return;
       }
-      accum_backoff *= lira_model->backoff_table[st].bo_prob;
-      st             = lira_model->backoff_table[st].bo_dest_state;
+      accum_backoff *= lira_model->getBackoffProb(st);
+      st             = lira_model->getBackoffState(st);
     }
     ERROR_EXIT(256, "This should never happen\n");
   }
   
+  void NgramLiraInterface::get(Key state,
+                               WordType word, Burden burden,
+                               vector<KeyScoreBurdenTuple> &result,
+                               Score threshold) {
+    april_assert(word != 0);
+    UNUSED_VARIABLE(threshold);
+    unsigned int dest;
+    Score score;
+    if (!cache.find(state, word, dest, score)) {
+      resolve(state, word, dest, score);
+      cache.insert(state, word, dest, score);
+    }
+    result.push_back(KeyScoreBurdenTuple(dest, score, burden));
+  }
+
   void NgramLiraInterface::clearQueries() {
     LMInterface::clearQueries();
+    pending_queries.clear();
+    pending_burdens.clear();
+  }
+
+  void NgramLiraInterface::insertQuery(Key key, WordType word, Burden burden,
+                                       Score threshold) {
+    april_assert(word != 0);
+    UNUSED_VARIABLE(threshold);
+    PendingQuery q;
+    q.state   = key;
+    q.word    = word;
+    q.backoff = Score::one();
+    q.index   = pending_burdens.size();
+    pending_queries.push_back(q);
+    pending_burdens.push_back(burden);
+  }
+
+  const vector<NgramLiraInterface::KeyScoreBurdenTuple> &
+  NgramLiraInterface::getQueries() {
+    if (pending_burdens.size() > 0) resolvePendingQueries();
+    return result;
+  }
+
+  void NgramLiraInterface::resolvePendingQueries() {
+    NgramLiraModel *lira_model = static_cast<NgramLiraModel*>(model);
+    const unsigned int n = pending_burdens.size();
+    vector<unsigned int> dests(n);
+    vector<Score> scores(n);
+    vector<unsigned int> orig_states(n);
+    // cached queries are resolved directly
+    vector<PendingQuery> todo, next;
+    for (unsigned int i=0; i<pending_queries.size(); ++i) {
+      const PendingQuery &q = pending_queries[i];
+      orig_states[q.index] = q.state;
+      if (!cache.find(q.state, q.word, dests[q.index], scores[q.index])) {
+        todo.push_back(q);
+      }
+    }
+    // every round looks for the words in their current state, the missing
+    // ones back off to the next round
+    vector<unsigned int> groups;
+    while (todo.size() > 0) {
+      Sort(todo.begin(), static_cast<int>(todo.size()));
+      groups.clear();
+      for (unsigned int i=0; i<todo.size(); ++i) {
+        if (i == 0 || todo[i].state != todo[i-1].state) groups.push_back(i);
+      }
+      groups.push_back(todo.size());
+      const unsigned int num_groups = groups.size() - 1;
+      next.clear();
+      unsigned int next_first = 0, next_last = 0;
+      if (num_groups > 0) {
+        lira_model->getTransitionRange(todo[0].state, next_first, next_last);
+      }
+      for (unsigned int g=0; g<num_groups; ++g) {
+        const unsigned int st = todo[groups[g]].state;
+        const unsigned int first = next_first, last = next_last;
+        // software pipeline: index data two groups ahead and transitions of
+        // the next group are requested before searching in the current one
+        if (g + 2 < num_groups) lira_model->prefetchState(todo[groups[g+2]].state);
+        if (g + 1 < num_groups) {
+          lira_model->getTransitionRange(todo[groups[g+1]].state,
+                                         next_first, next_last);
+          lira_model->prefetchTransitions(next_first, next_last);
+        }
+        // words are sorted, so the binary search range shrinks from the left
+        unsigned int lo = first;
+        for (unsigned int i=groups[g]; i<groups[g+1]; ++i) {
+          PendingQuery &q = todo[i];
+          unsigned int left = lo, right = last;
+          if (st < lira_model->first_state_binary_search) {
+            // few transitions, linearly searched as they may be unsorted
+            for (left = first; left < last; ++left) {
+              if (lira_model->getTransitionWord(left) == q.word) break;
+            }
+          }
+          else {
+            while (left < right) {
+              unsigned int mid = (left + right)/2;
+              if (lira_model->getTransitionWord(mid) < q.word) left = mid + 1;
+              else right = mid;
+            }
+            lo = left;
+          }
+          if (left < last && lira_model->getTransitionWord(left) == q.word) {
+            dests[q.index]  = lira_model->getTransitionState(left);
+            scores[q.index] = q.backoff * lira_model->getTransitionProb(left);
+            cache.insert(orig_states[q.index], q.word,
+                         dests[q.index], scores[q.index]);
+          }
+          else {
+            if (st == lira_model->lowest_state) {
+              // this is impossible, throws an error
+              ERROR_EXIT(128, "Transition not found!!!\n");
+            }
+            q.backoff *= lira_model->getBackoffProb(st);
+            q.state    = lira_model->getBackoffState(st);
+            next.push_back(q);
+          }
+        }
+      }
+      todo.swap(next);
+    }
+    for (unsigned int i=0; i<n; ++i) {
+      result.push_back(KeyScoreBurdenTuple(dests[i], scores[i],
+                                           pending_burdens[i]));
+    }
+    pending_queries.clear();
+    pending_burdens.clear();
   }
  
  // void NgramLiraInterface::insertQueries(const Key &key, int32_t idKey,
@@ -615,21 +1082,21 @@ namespace LanguageModels {
         unsigned int last_tr_index  = first_tr_index + info->fan_out;
         // lineal search:
         for (unsigned int tr_index = first_tr_index; tr_index < last_tr_index; tr_index++) {
-          if (lira_model->transition_words_table[tr_index] == word) {
-            return lira_model->transition_table[tr_index].state;
+          if (lira_model->getTransitionWord(tr_index) == word) {
+            return lira_model->getTransitionState(tr_index);
           }
         }
       } else {
         // the dichotomic search of the transition index is not based
         // on the binary_search template in order to be able to return
         // as soon as the word is found
-        unsigned int left  = lira_model->first_transition[st];
-        unsigned int right = lira_model->first_transition[st+1] - 1;
+        unsigned int left  = lira_model->getFirstTransition(st);
+        unsigned int right = lira_model->getFirstTransition(st+1) - 1;
         while (left <= right) {
           unsigned int tr_index     = (left+right)/2;
-          unsigned int current_word = lira_model->transition_words_table[tr_index];
+          unsigned int current_word = lira_model->getTransitionWord(tr_index);
           if (current_word == word) {
-            return lira_model->transition_table[tr_index].state;
+            return lira_model->getTransitionState(tr_index);
           } else if (current_word < word) {
             left  = tr_index+1;
           } else {
@@ -638,7 +1105,7 @@ namespace LanguageModels {
         }
       }
       // apply backoff when the transition is not found:
-      st = lira_model->backoff_table[st].bo_dest_state;      
+      st = lira_model->getBackoffState(st);
     } while (1);
     return st;
   }
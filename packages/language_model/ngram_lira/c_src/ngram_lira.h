@@ -29,6 +29,7 @@
 #include <cmath>
 #include <climits> // UINT_MAX
 #include "logbase.h"
+#include "packed_vectors.h"
 
 namespace LanguageModels {
 
@@ -83,6 +84,52 @@ namespace LanguageModels {
     size_t       size_max_out_prob;
   };
 
+  /// Header of the quantized binary format, identified by a different magic
+  /// number. Every section is aligned to 8 bytes.
+  struct NgramLiraQuantizedHeader {
+    unsigned int magic;
+    unsigned int ngram_value;
+    unsigned int vocabulary_size;
+    unsigned int initial_state;
+    unsigned int final_state;
+    unsigned int lowest_state;
+    unsigned int num_states;
+    unsigned int num_transitions;
+    unsigned int different_number_of_trans;
+    unsigned int linear_search_size;
+    unsigned int fan_out_threshold;
+    unsigned int first_state_binary_search;
+    unsigned int size_first_transition;
+    AprilUtils::log_float best_prob;
+    // bits of every packed field
+    unsigned int word_bits;
+    unsigned int state_bits;
+    unsigned int prob_bits;
+    unsigned int backoff_bits;
+    unsigned int max_out_bits;
+    unsigned int first_transition_low_bits;
+    // codebooks sizes, in number of floats
+    unsigned int prob_codebook_size;
+    unsigned int backoff_codebook_size;
+    unsigned int max_out_codebook_size;
+    size_t       offset_vocabulary_vector;
+    size_t       size_vocabulary_vector;
+    size_t       offset_prob_codebook;
+    size_t       offset_backoff_codebook;
+    size_t       offset_max_out_codebook;
+    size_t       offset_transition_words;
+    size_t       offset_transition_states;
+    size_t       offset_transition_probs;
+    size_t       offset_backoff_states;
+    size_t       offset_backoff_probs;
+    size_t       offset_max_out_probs;
+    size_t       offset_linear_search_table;
+    size_t       offset_first_transition_low;
+    size_t       offset_first_transition_high;
+    size_t       offset_first_transition_samples;
+    size_t       filesize;
+  };
+
   class NgramLiraModel : public LMModelUInt32LogFloat {
   public:
     
@@ -130,6 +177,15 @@ namespace LanguageModels {
     /// best_prob is the max of max_tr_prob_table
     Score best_prob; ///< loaded from .lira
 
+    //----------------------------------------------------------------------
+    // data in case the quantized binary format is mapped, transition words
+    // and states, backoff states and the first_transition vector are
+    // bit-packed, probabilities are indices into codebooks
+    bool is_quantized;
+    PackedArray packed_words, packed_states, packed_probs;
+    PackedArray packed_bo_states, packed_bo_probs, packed_max_out;
+    EliasFanoArray packed_first_transition;
+    const float *prob_codebook, *backoff_codebook, *max_out_codebook;
     //----------------------------------------------------------------------
     // data in case vectors are mapped:
     bool   is_mmapped;
@@ -143,10 +199,15 @@ namespace LanguageModels {
     
     virtual ~NgramLiraModel();
 
-    /// generates the binary data useful for mmaped version
+    /// generates the binary data useful for mmaped version, when prob_bits
+    /// is not zero probabilities are quantized with codebooks of
+    /// 2^prob_bits (2^backoff_bits for backoffs) entries and integers are
+    /// bit-packed
     void saveBinary(const char *filename,
                     unsigned int expected_vocabulary_size,
-                    const char *expected_vocabulary[]);
+                    const char *expected_vocabulary[],
+                    unsigned int prob_bits=0,
+                    unsigned int backoff_bits=0);
     
     /// constructor for binary mmaped data
     NgramLiraModel(const char *filename,
@@ -180,9 +241,168 @@ namespace LanguageModels {
 
     virtual LMInterface<Key,Score>* getInterface();
 
+    // accessors valid for plain and quantized data
+    WordType getTransitionWord(unsigned int tr) const {
+      if (is_quantized) return static_cast<WordType>(packed_words.get(tr));
+      return transition_words_table[tr];
+    }
+    unsigned int getTransitionState(unsigned int tr) const {
+      if (is_quantized) return static_cast<unsigned int>(packed_states.get(tr));
+      return transition_table[tr].state;
+    }
+    Score getTransitionProb(unsigned int tr) const {
+      if (is_quantized) return Score(prob_codebook[packed_probs.get(tr)]);
+      return transition_table[tr].prob;
+    }
+    unsigned int getBackoffState(unsigned int st) const {
+      if (is_quantized) return static_cast<unsigned int>(packed_bo_states.get(st));
+      return backoff_table[st].bo_dest_state;
+    }
+    Score getBackoffProb(unsigned int st) const {
+      if (is_quantized) return Score(backoff_codebook[packed_bo_probs.get(st)]);
+      return backoff_table[st].bo_prob;
+    }
+    Score getMaxOutProb(unsigned int st) const {
+      if (is_quantized) return Score(max_out_codebook[packed_max_out.get(st)]);
+      return max_out_prob[st];
+    }
+    /// only valid for st >= first_state_binary_search
+    unsigned int getFirstTransition(unsigned int st) const {
+      if (is_quantized) {
+        return static_cast<unsigned int>
+          (packed_first_transition.get(st - first_state_binary_search));
+      }
+      return first_transition[st];
+    }
+
+    /// computes the range [first,last) of non-backoff transitions of st
+    void getTransitionRange(unsigned int st,
+                            unsigned int &first, unsigned int &last) const {
+      if (st < first_state_binary_search) {
+        int linear_index = 0;
+        while(linear_search_table[linear_index].first_state <= st)
+          linear_index++;
+        // -1 because the search stopped too late ;)
+        const LinearSearchInfo *info = &(linear_search_table[linear_index-1]);
+        first = (st - info->first_state)*info->fan_out + info->first_index;
+        last  = first + info->fan_out;
+      } else {
+        first = getFirstTransition(st);
+        last  = getFirstTransition(st+1);
+      }
+    }
+
+    /// hints the processor to load the index data of state st
+    void prefetchState(unsigned int st) const {
+      if (st < first_state_binary_search) return;
+      if (is_quantized) {
+        __builtin_prefetch(packed_first_transition.
+                           getSampleAddress(st - first_state_binary_search));
+      }
+      else __builtin_prefetch(first_transition + st);
+    }
+
+    /// hints the processor to load the first probes of a search over the
+    /// given transitions range
+    void prefetchTransitions(unsigned int first, unsigned int last) const {
+      if (first >= last) return;
+      unsigned int middle = (first + last - 1)/2;
+      if (is_quantized) {
+        __builtin_prefetch(packed_words.getAddress(middle));
+        __builtin_prefetch(packed_words.getAddress(first));
+      }
+      else {
+        __builtin_prefetch(transition_words_table + middle);
+        __builtin_prefetch(transition_words_table + first);
+      }
+    }
+
+  private:
+    void saveQuantizedBinary(const char *filename,
+                             const char *expected_vocabulary[],
+                             unsigned int prob_bits,
+                             unsigned int backoff_bits);
+    /// returns the offset of the vocabulary vector
+    size_t loadQuantizedBinary();
     
   }; // closes class NgramLiraModel
   
+  /**
+   * @brief A small cache of (state,word) lookups with their destination state
+   * and score, including backoff steps.
+   *
+   * The cache is set-associative, every (state,word) pair is hashed to a set
+   * of WAYS entries which are kept in least recently used order, so hits
+   * move the entry to the front and insertions evict the last one.
+   */
+  class NgramLiraQueryCache {
+  public:
+    static const unsigned int WAYS = 4u;
+    static const unsigned int DEFAULT_SIZE = 1024u;
+
+    explicit NgramLiraQueryCache(unsigned int size = DEFAULT_SIZE) {
+      resize(size);
+    }
+
+    /// The size is rounded up to a power of two, zero disables the cache.
+    void resize(unsigned int size) {
+      unsigned int num_sets = 1u;
+      while (num_sets*WAYS < size) num_sets <<= 1;
+      set_mask = num_sets - 1u;
+      entries.resize( (size > 0u) ? num_sets*WAYS : 0u );
+      clear();
+    }
+
+    unsigned int size() const { return entries.size(); }
+
+    void clear() {
+      for (unsigned int i=0; i<entries.size(); ++i) entries[i].word = 0u;
+    }
+
+    bool find(unsigned int state, WordType word,
+              unsigned int &dest, NgramLiraModel::Score &score) {
+      if (entries.size() == 0u) return false;
+      Entry *set = getSet(state, word);
+      for (unsigned int i=0; i<WAYS; ++i) {
+        if (set[i].word == word && set[i].state == state) {
+          Entry hit = set[i];
+          for (unsigned int j=i; j>0; --j) set[j] = set[j-1];
+          set[0] = hit;
+          dest  = hit.dest;
+          score = hit.score;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void insert(unsigned int state, WordType word,
+                unsigned int dest, NgramLiraModel::Score score) {
+      if (entries.size() == 0u) return;
+      Entry *set = getSet(state, word);
+      for (unsigned int j=WAYS-1; j>0; --j) set[j] = set[j-1];
+      set[0].state = state;
+      set[0].word  = word;
+      set[0].dest  = dest;
+      set[0].score = score;
+    }
+
+  private:
+    struct Entry {
+      unsigned int state;
+      WordType word; ///< zero for empty entries
+      unsigned int dest;
+      NgramLiraModel::Score score;
+    };
+    AprilUtils::vector<Entry> entries;
+    unsigned int set_mask;
+
+    Entry *getSet(unsigned int state, WordType word) {
+      unsigned int h = (state*2654435761u) ^ (word*2246822519u);
+      return entries.begin() + ((h ^ (h >> 15)) & set_mask)*WAYS;
+    }
+  };
+
   class NgramLiraInterface : public LMInterface<NgramLiraModel::Key,
                                                 NgramLiraModel::Score> {
   public:
@@ -235,7 +455,7 @@ namespace LanguageModels {
         NgramLiraModel* m = static_cast<NgramLiraModel*>(lm->getLMModel());
         while (current_transition < last_transition) {
           ++current_transition;
-          if (m->transition_table[current_transition].prob >= threshold)
+          if (m->getTransitionProb(current_transition) >= threshold)
             return;
         }
         return;
@@ -243,8 +463,7 @@ namespace LanguageModels {
       
       virtual WordType getWord(LMInterface *lm) {
         NgramLiraModel* lira_model = static_cast<NgramLiraModel*>(lm->getLMModel());
-        WordType *twt = lira_model->transition_words_table;
-        return twt[current_transition];
+        return lira_model->getTransitionWord(current_transition);
       }
       
       virtual bool isEnd(LMInterface *lm) const {
@@ -257,11 +476,39 @@ namespace LanguageModels {
     NgramLiraInterface(NgramLiraModel *lira_model) :
       LMInterface<Key,Score>(lira_model) {
     }
+
+  private:
+    /// A query of the bunch mode, it backs off until the word is found.
+    struct PendingQuery {
+      unsigned int state;
+      WordType word;
+      Score backoff;       ///< accumulated backoff weight
+      unsigned int index;  ///< position in insertion order
+      bool operator<(const PendingQuery &other) const {
+        return (state < other.state ||
+                (state == other.state && word < other.word));
+      }
+    };
+
+    NgramLiraQueryCache cache;
+    AprilUtils::vector<PendingQuery> pending_queries;
+    AprilUtils::vector<Burden> pending_burdens;
+
+    /// Follows transitions and backoffs of a single (state,word) query.
+    void resolve(unsigned int state, WordType word,
+                 unsigned int &dest, Score &score);
+    /// Resolves all the pending queries, appending them to result.
+    void resolvePendingQueries();
     
   public:
     virtual ~NgramLiraInterface() {
     }
 
+    /// Changes the number of entries of the (state,word) cache, zero
+    /// disables it.
+    void setCacheSize(unsigned int size) { cache.resize(size); }
+    unsigned int getCacheSize() const { return cache.size(); }
+
     /// Returns an ArcsIterator to non-backoff transitions.
     virtual ArcsIterator beginNonBackoffArcs(Key key, Score threshold) {
       NgramLiraModel* lira_model = static_cast<NgramLiraModel*>(getLMModel());
@@ -279,8 +526,8 @@ namespace LanguageModels {
         first_tr = (key - info->first_state)*info->fan_out + info->first_index;
         last_tr  = first_tr + info->fan_out;
       } else {
-        first_tr  = lira_model->first_transition[key];
-        last_tr = lira_model->first_transition[key + 1] - 1;
+        first_tr  = lira_model->getFirstTransition(key);
+        last_tr = lira_model->getFirstTransition(key + 1) - 1;
       }
 
       AprilUtils::UniquePtr<LMInterface::ArcsIterator::StateControl> st;
@@ -293,13 +540,18 @@ namespace LanguageModels {
                      Score threshold);
     
     virtual void clearQueries();
+
+    /// Queries are delayed until getQueries(), which resolves them in bunch:
+    /// grouped by state, with the transitions of the next groups prefetched,
+    /// and backing off all the missing words of every round together.
+    virtual void insertQuery(Key key, WordType word, Burden burden,
+                             Score threshold);
+
+    virtual const AprilUtils::vector<KeyScoreBurdenTuple> &getQueries();
     
     /*
       Implemented by default in parent class:
       
-      virtual void insertQuery(Key key, Word word, Burden burden,
-      Score threshold);
-      
       virtual void insertQueries(Key key, int32_t id_key,
       vector<WordIdScoreTuple> words, bool is_sorted=false);
     */
@@ -308,7 +560,7 @@ namespace LanguageModels {
       return static_cast<NgramLiraModel*>(model)->best_prob;
     }
     virtual Score getBestProb(Key k) {
-      return static_cast<NgramLiraModel*>(model)->max_out_prob[k];
+      return static_cast<NgramLiraModel*>(model)->getMaxOutProb(k);
     }
     virtual bool getZeroKey(Key &k) const {
       k = static_cast<NgramLiraModel*>(model)->lowest_state;
@@ -0,0 +1,160 @@
+/*
+ * This file is part of APRIL-ANN toolkit (A
+ * Pattern Recognizer In Lua with Artificial Neural Networks).
+ *
+ * Copyright 2015, Francisco Zamora-Martinez
+ *
+ * The APRIL-ANN toolkit is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef PACKED_VECTORS_H
+#define PACKED_VECTORS_H
+
+#include <stdint.h>
+#include <cstddef>
+
+namespace LanguageModels {
+
+  /// Returns the number of bits needed to represent values in [0,max_value].
+  inline unsigned int bitsForValue(uint64_t max_value) {
+    unsigned int bits = 0;
+    while (max_value > 0) { ++bits; max_value >>= 1; }
+    return bits;
+  }
+
+  /**
+   * @brief Read-only view of an array of integers of @c bits bits each, packed
+   * into 64 bit words.
+   *
+   * The view doesn't own the memory, which is usually mmapped from a file.
+   * Arrays of @c n values need sizeInWords(n,bits) words, the last word is a
+   * padding which allows to read any value with at most two word accesses.
+   */
+  class PackedArray {
+    const uint64_t *data;
+    unsigned int bits;
+    uint64_t mask;
+  public:
+    PackedArray() : data(0), bits(0), mask(0) { }
+    PackedArray(const uint64_t *data, unsigned int bits) :
+      data(data), bits(bits), mask((static_cast<uint64_t>(1u)<<bits) - 1u) { }
+
+    uint64_t get(size_t i) const {
+      size_t pos = i*bits;
+      size_t idx = pos >> 6;
+      unsigned int sh = static_cast<unsigned int>(pos & 63u);
+      uint64_t v = data[idx] >> sh;
+      if (sh + bits > 64u) v |= data[idx+1] << (64u - sh);
+      return v & mask;
+    }
+
+    unsigned int getBits() const { return bits; }
+
+    /// Address of the word which contains the i-th value, for prefetching.
+    const uint64_t *getAddress(size_t i) const { return data + ((i*bits) >> 6); }
+
+    static size_t sizeInWords(size_t n, unsigned int bits) {
+      return (n*bits + 63u)/64u + 1u;
+    }
+
+    /// Writes a value into a zero initialized array of sizeInWords() words.
+    static void set(uint64_t *data, size_t i, unsigned int bits, uint64_t v) {
+      if (bits == 0u) return;
+      size_t pos = i*bits;
+      size_t idx = pos >> 6;
+      unsigned int sh = static_cast<unsigned int>(pos & 63u);
+      data[idx] |= v << sh;
+      if (sh + bits > 64u) data[idx+1] |= v >> (64u - sh);
+    }
+  };
+
+  /**
+   * @brief Read-only view of a non-decreasing sequence of integers stored
+   * with Elias-Fano encoding.
+   *
+   * Every value is splitted in @c low_bits low bits, stored in a PackedArray,
+   * and the high part, stored in unary as a bit vector where the i-th value
+   * sets the bit (high_i + i). The position of every SAMPLE_STEP-th set bit
+   * is sampled, so get(i) scans at most a few words. The encoding needs about
+   * 2 + log2(universe/n) bits per value.
+   */
+  class EliasFanoArray {
+    PackedArray low;
+    const uint64_t *high;
+    const uint64_t *samples;
+    unsigned int low_bits;
+  public:
+    static const size_t SAMPLE_STEP = 64u;
+
+    EliasFanoArray() : high(0), samples(0), low_bits(0) { }
+    EliasFanoArray(const uint64_t *low_data, const uint64_t *high,
+                   const uint64_t *samples, unsigned int low_bits) :
+      low(low_data, low_bits), high(high), samples(samples),
+      low_bits(low_bits) { }
+
+    /// Address of the sampled position needed by get(i), for prefetching.
+    const uint64_t *getSampleAddress(size_t i) const {
+      return samples + i / SAMPLE_STEP;
+    }
+
+    uint64_t get(size_t i) const {
+      // select the i-th set bit of the high bit vector
+      uint64_t pos = samples[i / SAMPLE_STEP];
+      size_t remaining = i % SAMPLE_STEP;
+      size_t idx = static_cast<size_t>(pos >> 6);
+      uint64_t word = high[idx] & (~static_cast<uint64_t>(0u) << (pos & 63u));
+      for (;;) {
+        size_t count = static_cast<size_t>(__builtin_popcountll(word));
+        if (remaining < count) break;
+        remaining -= count;
+        word = high[++idx];
+      }
+      for (size_t k=0; k<remaining; ++k) word &= word - 1u;
+      uint64_t high_pos = (static_cast<uint64_t>(idx) << 6) +
+        static_cast<uint64_t>(__builtin_ctzll(word));
+      return ((high_pos - i) << low_bits) | low.get(i);
+    }
+
+    /// Number of low bits for @c n values lower or equal than @c universe.
+    static unsigned int computeLowBits(size_t n, uint64_t universe) {
+      unsigned int l = 0;
+      while (n > 0u && (universe / n) >> (l+1) > 0u) ++l;
+      return l;
+    }
+    static size_t highSizeInWords(size_t n, uint64_t universe,
+                                  unsigned int low_bits) {
+      return static_cast<size_t>(((universe >> low_bits) + n + 63u)/64u + 1u);
+    }
+    static size_t samplesSize(size_t n) {
+      return (n + SAMPLE_STEP - 1u)/SAMPLE_STEP + 1u;
+    }
+
+    /// Encodes the sequence into zero initialized arrays with the sizes
+    /// given by the static methods above.
+    static void build(const uint64_t *values, size_t n, unsigned int low_bits,
+                      uint64_t *low_data, uint64_t *high_data,
+                      uint64_t *samples_data) {
+      uint64_t low_mask = (static_cast<uint64_t>(1u) << low_bits) - 1u;
+      for (size_t i=0; i<n; ++i) {
+        PackedArray::set(low_data, i, low_bits, values[i] & low_mask);
+        uint64_t pos = (values[i] >> low_bits) + i;
+        high_data[pos >> 6] |= static_cast<uint64_t>(1u) << (pos & 63u);
+        if (i % SAMPLE_STEP == 0u) samples_data[i / SAMPLE_STEP] = pos;
+      }
+    }
+  };
+
+} // namespace LanguageModels
+
+#endif // PACKED_VECTORS_H
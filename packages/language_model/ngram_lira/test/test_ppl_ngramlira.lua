@@ -40,3 +40,65 @@ local result2 = language_models.test_set_ppl{
 }
 
 for i,v in pairs(result) do check.eq( v, result2[i] ) end
+
+-----------------------------------------------------------------------------
+
+-- bunch mode queries are resolved together, they should give the same
+-- results as individual queries, which use the cache
+do
+  local lmi = model:get_interface()
+  local ref = model:get_interface():set_cache_size(0)
+  check.eq( ref:get_cache_size(), 0 )
+  local rnd = random(1234)
+  local keys, words = {}, {}
+  local key = lmi:get_initial_key()
+  for i=1,2000 do
+    local w = rnd:randInt(3, #vocab:getWordVocabulary())
+    keys[i], words[i] = key, w
+    lmi:insert_query(key, w, { id_key = i })
+    key = ref:next_keys(key, w):get(1)
+    if i % 20 == 0 then key = lmi:get_initial_key() end
+  end
+  local result = lmi:get_queries()
+  check.eq( result:size(), #keys )
+  for i=1,#keys do
+    local k,p,b = result:get(i)
+    local k2,p2 = ref:get(keys[i], words[i]):get(1)
+    local k3,p3 = lmi:get(keys[i], words[i]):get(1)
+    check.eq( b, i )
+    check.eq( k, k2 )
+    check.eq( p, p2 )
+    check.eq( k3, k2 )
+    check.eq( p3, p2 )
+  end
+  lmi:clear_queries()
+end
+
+-----------------------------------------------------------------------------
+
+-- the quantized binary format is lossless when the number of different
+-- probabilities fits in the codebooks
+local blira_filename = os.tmpname()
+model:save_binary{
+  filename = blira_filename,
+  vocabulary = vocab:getWordVocabulary(),
+  prob_bits = 16,
+}
+local blira_model = ngram.lira.model{
+  binary = true,
+  filename = blira_filename,
+  vocabulary = vocab:getWordVocabulary(),
+  final_word = vocab:getWordId("</s>"),
+}
+
+local result3 = language_models.test_set_ppl{
+  lm = blira_model,
+  vocab = vocab,
+  testset = path .. "frase",
+  debug_flag = -1,
+  use_bcc = true,
+  use_ecc = true,
+}
+
+for i,v in pairs(result) do check.eq( v, result3[i] ) end
+os.remove(blira_filename)
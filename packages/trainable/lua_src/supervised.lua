@@ -1050,6 +1050,7 @@ trainable_supervised_trainer_methods.train_dataset =
           "Bunch size (mini-batch). It is [optional] if bunch_size",
           "was set at constructor, otherwise it is mandatory.",
         }, 
+      ["prefetch"]       = "Number of bunches prepared in background [optional]",
     },
     outputs = {
       "A number with the mean loss of each training step",
@@ -1078,6 +1079,7 @@ trainable_supervised_trainer_methods.train_dataset =
           "Bunch size (mini-batch). It is [optional] if bunch_size",
           "was set at constructor, otherwise it is mandatory.",
         }, 
+      ["prefetch"]       = "Number of bunches prepared in background [optional]",
     },
     outputs = {
       "A number with the mean loss of each training step",
@@ -1108,6 +1110,7 @@ trainable_supervised_trainer_methods.train_dataset =
           "Bunch size (mini-batch). It is [optional] if bunch_size",
           "was set at constructor, otherwise it is mandatory.",
         }, 
+      ["prefetch"]       = "Number of bunches prepared in background [optional]",
     },
     outputs = {
       "A number with the mean loss of each training step",
@@ -1154,6 +1157,7 @@ trainable_supervised_trainer_methods.train_dataset =
         --
         -- shuffle        = { isa_match  = random,   mandatory = false, default=nil },
         -- replacement    = { type_match = "number", mandatory = false, default=nil },
+        -- prefetch       = { type_match = "number", mandatory = false, default=nil },
         -- input_dataset  = { mandatory = false, default=nil },
         -- output_dataset = { mandatory = false, default=nil },
         -- distribution   = { type_match="table", mandatory = false, default=nil,
@@ -1309,6 +1313,7 @@ trainable_supervised_trainer_methods.validate_dataset =
           "Bunch size (mini-batch). It is [optional] if bunch_size",
           "was set at constructor, otherwise it is mandatory.",
         }, 
+      ["prefetch"]       = "Number of bunches prepared in background [optional]",
     },
     outputs = {
       "A number with the mean loss of each validate step",
@@ -1336,6 +1341,7 @@ trainable_supervised_trainer_methods.validate_dataset =
           "Bunch size (mini-batch). It is [optional] if bunch_size",
           "was set at constructor, otherwise it is mandatory.",
         }, 
+      ["prefetch"]       = "Number of bunches prepared in background [optional]",
     },
     outputs = {
       "A number with the mean loss of each validate step",
@@ -1365,6 +1371,7 @@ trainable_supervised_trainer_methods.validate_dataset =
           "Bunch size (mini-batch). It is [optional] if bunch_size",
           "was set at constructor, otherwise it is mandatory.",
         }, 
+      ["prefetch"]       = "Number of bunches prepared in background [optional]",
     },
     outputs = {
       "A number with the mean loss of each validate step",
@@ -1386,6 +1393,7 @@ trainable_supervised_trainer_methods.validate_dataset =
                            default=self.loss_function },
         shuffle        = { isa_match  = random, mandatory = false, default=nil },
         replacement    = { type_match = "number", mandatory = false, default=nil },
+        prefetch       = { type_match = "number", mandatory = false, default=nil },
       }, t)
     assert(self.is_built,
            "Execute build method before call this method")
@@ -63,6 +63,7 @@ trainable.dataset_pair_iterator =
         replacement    = { type_match = "number", mandatory = false, default=nil },
         assert_input_size = { type_match = "number", mandatory = false, default=0 },
         assert_output_size = { type_match = "number", mandatory = false, default=0 },
+        prefetch       = { type_match = "number", mandatory = false, default=nil },
       }, t)
     -- ERROR CHECKING
     assert(params.input_dataset ~= not params.output_dataset,
@@ -105,6 +106,9 @@ trainable.dataset_multiple_iterator =
       "returning a token with bunch_size patterns.",
       "It admits the following traversals: sequential, shuffled,",
       "shuffled with replacement, shuffled with distribution.",
+      "If prefetch=N is given, up to N bunches are assembled in",
+      "a background thread (see dataset.prefetcher), it is not",
+      "available with distribution.",
     },
   } ..
   function(t)
@@ -131,12 +135,15 @@ trainable.dataset_multiple_iterator =
         replacement    = { type_match = "number", mandatory = false, default=nil },
         assert_pattern_sizes = { type_match = "table", mandatory = false,
                                  default={ } },
+        prefetch       = { type_match = "number", mandatory = false, default=nil },
       }, t)
     -- ERROR CHECKING
     assert(not params.datasets or not params.distribution,
            "datasets field is forbidden with distribution")
     assert(params.datasets or params.distribution,
            "datasets or distribution are needed")
+    assert(not params.prefetch or not params.distribution,
+           "prefetch is forbidden with distribution")
     --
     local bunch_size = params.bunch_size
     --
@@ -204,8 +211,12 @@ trainable.dataset_multiple_iterator =
       local num_patterns
       params.datasets,num_patterns = to_dataset_token(params.datasets)
       -- generate training tables depending on training mode (replacement,
-      -- shuffled, or sequential)
-      if params.replacement then
+      -- shuffled, or sequential), with prefetch they are generated by the
+      -- dataset.prefetcher thread
+      if params.prefetch then
+        assert(not params.replacement or params.shuffle,
+               "shuffle is mandatory with replacement")
+      elseif params.replacement then
         assert(params.shuffle,"shuffle is mandatory with replacement")
         local i=1
         ds_idx_func = function()
@@ -242,6 +253,30 @@ trainable.dataset_multiple_iterator =
 		       k, ds_psize, psize)
       end)
     --
+    if params.prefetch then
+      iterator(ipairs(params.datasets)):
+        apply(function(k,ds)
+            april_assert(is_a(ds,dataset.token),
+                         "Dataset %d is not available with prefetch", k)
+        end)
+      local prefetcher = dataset.prefetcher{
+        datasets    = params.datasets,
+        bunch_size  = bunch_size,
+        shuffle     = params.shuffle,
+        replacement = params.replacement,
+        size        = params.prefetch,
+      }
+      local pattern_size = iterator(ipairs(params.datasets)):select(2):
+        call('patternSize'):reduce(math.add, 0)
+      local bunch_mb_size = bunch_size * pattern_size * 4
+      local k=0
+      return function()
+        k=k+bunch_mb_size
+        if k >= MAX_SIZE_WO_COLLECT_GARBAGE then cgarbage("collect") k=0 end
+        return prefetcher:next()
+      end
+    end
+    --
     -- ITERATOR USING ds_idx_func
     local k=0
     local bunch_indexes = {}
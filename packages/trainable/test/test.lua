@@ -118,6 +118,16 @@ for input,bunch_indexes in trainable.dataset_multiple_iterator{
 			out_ds:getPattern(bunch_indexes[1]))
   assert(out:equals(target))
 end
+-- bunches prefetched in background give the same training
+local tr1,tr2 = best:clone(),best:clone()
+local loss1 = tr1:train_dataset{ input_dataset  = train_input,
+                                 output_dataset = train_output,
+                                 shuffle        = random(1234) }
+local loss2 = tr2:train_dataset{ input_dataset  = train_input,
+                                 output_dataset = train_output,
+                                 shuffle        = random(1234),
+                                 prefetch       = 4 }
+assert(math.abs(loss1 - loss2) < 1e-5)
 --printf("# Wall total time: %.3f    per epoch: %.3f\n", wall, wall/num_epochs)
 --printf("# CPU  total time: %.3f    per epoch: %.3f\n", cpu, cpu/num_epochs)
 --printf("# Validation error: %f  +-  %f\n", val_error, val_variance)
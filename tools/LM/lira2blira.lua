@@ -1,7 +1,12 @@
 -- se limita a generar un fichero .blira a partir de un fichero .lira
+-- uso: lira2blira.lua dictionary lira blira [prob_bits [backoff_bits]]
+-- con prob_bits > 0 se genera el formato cuantizado (codebooks de
+-- 2^prob_bits probabilidades y enteros empaquetados a nivel de bit)
 dictionary_filename = arg[1]
 lira_filename       = arg[2]
 binary_filename     = arg[3]
+prob_bits           = tonumber(arg[4] or 0)
+backoff_bits        = tonumber(arg[5] or prob_bits)
 
 -- cargar diccionario
 dictionary = lexClass.load(io.open(dictionary_filename))
@@ -16,6 +21,6 @@ lira_model = language_models.load(lira_filename,
 lira_model:save_binary{
   filename=binary_filename,
   vocabulary=dictionary:getWordVocabulary(),
+  prob_bits=prob_bits,
+  backoff_bits=backoff_bits,
 }
-
-